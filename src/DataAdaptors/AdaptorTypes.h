@@ -31,6 +31,7 @@ typedef struct ChromosomeAdaptorStruct ChromosomeAdaptor;
 typedef struct CloneAdaptorStruct CloneAdaptor;
 typedef struct DBAdaptorStruct DBAdaptor;
 typedef struct DBConnectionStruct DBConnection;
+typedef struct DBConnectionPoolStruct DBConnectionPool;
 typedef struct DBEntryAdaptorStruct DBEntryAdaptor;
 typedef struct DNAAlignFeatureAdaptorStruct DNAAlignFeatureAdaptor;
 typedef struct ExonAdaptorStruct ExonAdaptor;
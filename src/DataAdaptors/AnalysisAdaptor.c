@@ -40,6 +40,27 @@ AnalysisAdaptor *AnalysisAdaptor_new(DBAdaptor *dba) {
   return aa;
 }
 
+/*
+  Makes an AnalysisAdaptor for dba (a clone of aa's DBAdaptor) without
+  refetching the analysis table. The Analysis objects are shared with aa but
+  the caches are copies, so analyses fetched or stored later through the
+  clone only go into the clone's caches.
+*/
+AnalysisAdaptor *AnalysisAdaptor_clone(AnalysisAdaptor *aa, DBAdaptor *dba) {
+  AnalysisAdaptor *clone;
+
+  if ((clone = (AnalysisAdaptor *)calloc(1,sizeof(AnalysisAdaptor))) == NULL) {
+    fprintf(stderr, "ERROR: Failed allocating space for AnalysisAdaptor clone\n");
+    return NULL;
+  }
+  BaseAdaptor_init((BaseAdaptor *)clone, dba, ANALYSIS_ADAPTOR);
+
+  clone->analCache      = IDHash_copy(aa->analCache);
+  clone->logicNameCache = StringHash_copy(aa->logicNameCache);
+
+  return clone;
+}
+
 Analysis **AnalysisAdaptor_fetchAll(AnalysisAdaptor *aa) {
   char qStr[256];
   StatementHandle *sth;
@@ -31,6 +31,7 @@ struct AnalysisAdaptorStruct {
 
 IDType AnalysisAdaptor_analysisExists(AnalysisAdaptor *aa, Analysis *anal);
 AnalysisAdaptor *AnalysisAdaptor_new(DBAdaptor *dba);
+AnalysisAdaptor *AnalysisAdaptor_clone(AnalysisAdaptor *aa, DBAdaptor *dba);
 Analysis *AnalysisAdaptor_fetchByDbID(AnalysisAdaptor *aa, IDType dbID);
 Analysis *AnalysisAdaptor_fetchByLogicName(AnalysisAdaptor *aa, char *logicName);
 Analysis *AnalysisAdaptor_analysisFromRow(AnalysisAdaptor *aa, ResultRow *row);
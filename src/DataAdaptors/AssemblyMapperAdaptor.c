@@ -30,6 +30,7 @@
 #include "ResultRow.h"
 #include "CoordPair.h"
 #include "StrUtil.h"
+#include "MetaContainer.h"
 
 int CHUNKFACTOR = 20;  // 2^20 = approx. 10^6
 
@@ -37,6 +38,15 @@ int CHUNKFACTOR = 20;  // 2^20 = approx. 10^6
 static char *AMA_FIRST = "first";
 static char *AMA_LAST  = "last";
 
+static AssemblySnapshot *AssemblyMapperAdaptor_getSnapshot(AssemblyMapperAdaptor *ama);
+static AssemblySnapshot *AssemblyMapperAdaptor_buildSnapshot(AssemblyMapperAdaptor *ama, char *fileName, uint64_t key);
+static int   AssemblyMapperAdaptor_compRegionId(const void *a, const void *b);
+static void *AssemblyMapperAdaptor_growArray(void *array, long n, long *nAlloc, size_t size);
+static void AssemblyMapperAdaptor_registerAllRow(AssemblyMapperAdaptor *ama, AssemblyMapper *asmMapper, IDHash *asmRegistered,
+                                                 IDType cmpSeqRegionId, char *cmpSeqRegion, long cmpLength, long cmpStart, long cmpEnd,
+                                                 int ori,
+                                                 IDType asmSeqRegionId, char *asmSeqRegion, long asmLength, long asmStart, long asmEnd);
+
 AssemblyMapperAdaptor *AssemblyMapperAdaptor_new(DBAdaptor *dba) {
   AssemblyMapperAdaptor *ama;
 
@@ -56,9 +66,227 @@ AssemblyMapperAdaptor *AssemblyMapperAdaptor_new(DBAdaptor *dba) {
 
   ama->multSeqIdCache = NULL;
 
+  // Optionally load whole assembly mappings from a local snapshot rather than the assembly table
+  char *snapshotDir = getenv("ENSC_SNAPSHOT_DIR");
+  if (snapshotDir != NULL && snapshotDir[0] != '\0') {
+    AssemblyMapperAdaptor_setSnapshotDir(ama, snapshotDir);
+  }
+
   return ama;
 }
 
+/*
+  Sets the directory for a local snapshot of the assembly table (joined to
+  seq_region), used by registerAll, and so by the mapping caches built at
+  startup, instead of querying the database. The snapshot is generated from
+  the database the first time it's needed, and regenerated when the server,
+  database name, schema_version or assembly.default no longer match the ones
+  it was made from. Also settable with the ENSC_SNAPSHOT_DIR environment
+  variable. NULL turns it off.
+  Only the assembly table is snapshotted - the top level seq region query in
+  SliceAdaptor still goes to the database, and mappers are still sorted after
+  loading.
+*/
+void AssemblyMapperAdaptor_setSnapshotDir(AssemblyMapperAdaptor *ama, char *dir) {
+  if (ama->snapshot) {
+    AssemblySnapshot_close(ama->snapshot);
+    ama->snapshot = NULL;
+  }
+  if (ama->snapshotDir) {
+    free(ama->snapshotDir);
+    ama->snapshotDir = NULL;
+  }
+  ama->snapshotTried = 0;
+
+  if (dir != NULL) {
+    StrUtil_copyString(&ama->snapshotDir, dir, 0);
+  }
+}
+
+/*
+  Returns the snapshot, opening it (or generating it if it's missing or stale)
+  the first time it's asked for. NULL means use the database - either there's
+  no snapshot dir or the file couldn't be written.
+*/
+static AssemblySnapshot *AssemblyMapperAdaptor_getSnapshot(AssemblyMapperAdaptor *ama) {
+  char fileName[FILENAME_MAX];
+  char keyStr[2048];
+
+  if (ama->snapshotDir == NULL || ama->snapshotTried) {
+    return ama->snapshot;
+  }
+  ama->snapshotTried = 1;
+
+  MetaContainer *mc = DBAdaptor_getMetaContainer(ama->dba);
+  char *dbName = DBConnection_getDbName(ama->dba->dbc);
+  char *host = DBConnection_getHost(ama->dba->dbc);
+  unsigned int port = DBConnection_getPort(ama->dba->dbc);
+  int schemaVersion = 0;
+  MetaContainer_getIntValueByKey(mc, "schema_version", &schemaVersion);
+  char *assembly = MetaContainer_getDefaultAssembly(mc);
+
+  // Same named databases on different servers can differ, so the server is in both the key and the file name
+  sprintf(keyStr, "%s\t%u\t%s\t%d\t%d\t%s", host ? host : "", port, dbName, DBAdaptor_getSpeciesId(ama->dba),
+          schemaVersion, assembly ? assembly : "");
+  uint64_t key = AssemblySnapshot_makeKey(keyStr);
+  free(assembly);
+
+  char hostStr[256];
+  char *chP;
+  snprintf(hostStr, sizeof(hostStr), "%s", host ? host : "localhost");
+  for (chP = hostStr; *chP; chP++) {
+    if (*chP == '/') *chP = '_';
+  }
+  snprintf(fileName, sizeof(fileName), "%s/%s_%u_%s_%d.asmsnap", ama->snapshotDir, hostStr, port, dbName,
+           DBAdaptor_getSpeciesId(ama->dba));
+
+  if ((ama->snapshot = AssemblySnapshot_open(fileName, key)) == NULL) {
+    ama->snapshot = AssemblyMapperAdaptor_buildSnapshot(ama, fileName, key);
+  }
+
+  return ama->snapshot;
+}
+
+static int AssemblyMapperAdaptor_compRegionId(const void *a, const void *b) {
+  const AssemblySnapshotRegion *r1 = a;
+  const AssemblySnapshotRegion *r2 = b;
+
+  return r1->id < r2->id ? -1 : (r1->id > r2->id ? 1 : 0);
+}
+
+static void *AssemblyMapperAdaptor_growArray(void *array, long n, long *nAlloc, size_t size) {
+  if (n < *nAlloc) {
+    return array;
+  }
+  *nAlloc = *nAlloc ? *nAlloc * 2 : 1024;
+  if ((array = realloc(array, *nAlloc * size)) == NULL) {
+    fprintf(stderr, "ERROR: Failed reallocating assembly snapshot array\n");
+    exit(1);
+  }
+  return array;
+}
+
+/*
+  Reads the whole assembly table, with the seq regions on both sides, writes
+  it to fileName and opens the result
+*/
+static AssemblySnapshot *AssemblyMapperAdaptor_buildSnapshot(AssemblyMapperAdaptor *ama, char *fileName, uint64_t key) {
+  AssemblySnapshotRegion *regions = NULL;
+  AssemblySnapshotSection *sections = NULL;
+  AssemblySnapshotRow *rows = NULL;
+  char *names = NULL;
+  long nRegion = 0, nRegionAlloc = 0;
+  long nSection = 0, nSectionAlloc = 0;
+  long nRow = 0, nRowAlloc = 0;
+  long nNameByte = 0, nNameAlloc = 0;
+  long i;
+
+  char *qStr = "SELECT"
+                  " asm.asm_seq_region_id,"
+                  " asm_sr.coord_system_id,"
+                  " asm_sr.name,"
+                  " asm_sr.length,"
+                  " asm.asm_start,"
+                  " asm.asm_end,"
+                  " asm.cmp_seq_region_id,"
+                  " cmp_sr.coord_system_id,"
+                  " cmp_sr.name,"
+                  " cmp_sr.length,"
+                  " asm.cmp_start,"
+                  " asm.cmp_end,"
+                  " asm.ori"
+              " FROM"
+                  " assembly asm, seq_region asm_sr, seq_region cmp_sr"
+              " WHERE"
+                  " asm.cmp_seq_region_id = cmp_sr.seq_region_id AND"
+                  " asm.asm_seq_region_id = asm_sr.seq_region_id"
+              " ORDER BY asm_sr.coord_system_id, cmp_sr.coord_system_id";
+
+  StatementHandle *sth = ama->prepare((BaseAdaptor *)ama,qStr,strlen(qStr));
+  sth->execute(sth);
+
+  IDHash *seenRegions = IDHash_new(IDHASH_LARGE);
+
+  ResultRow *row;
+  while ((row = sth->fetchRow(sth))) {
+    IDType asmCsId = row->getLongLongAt(row,1);
+    IDType cmpCsId = row->getLongLongAt(row,7);
+    int side;
+
+    if (nSection == 0 || sections[nSection-1].asmCsId != asmCsId || sections[nSection-1].cmpCsId != cmpCsId) {
+      sections = AssemblyMapperAdaptor_growArray(sections, nSection, &nSectionAlloc, sizeof(AssemblySnapshotSection));
+      sections[nSection].asmCsId  = asmCsId;
+      sections[nSection].cmpCsId  = cmpCsId;
+      sections[nSection].firstRow = nRow;
+      sections[nSection].nRow     = 0;
+      nSection++;
+    }
+
+    // The two seq regions are in columns 0-3 (assembled) and 6-9 (component)
+    for (side=0; side<=6; side+=6) {
+      IDType srId = row->getLongLongAt(row,side);
+
+      if (!IDHash_contains(seenRegions, srId)) {
+        IDHash_add(seenRegions, srId, &trueVal);
+
+        char *srName = row->getStringAt(row,side+2);
+        long lenName = strlen(srName) + 1;
+
+        while (nNameByte + lenName > nNameAlloc) {
+          names = AssemblyMapperAdaptor_growArray(names, nNameAlloc, &nNameAlloc, sizeof(char));
+        }
+        memcpy(&names[nNameByte], srName, lenName);
+
+        regions = AssemblyMapperAdaptor_growArray(regions, nRegion, &nRegionAlloc, sizeof(AssemblySnapshotRegion));
+        regions[nRegion].id         = srId;
+        regions[nRegion].csId       = row->getLongLongAt(row,side+1);
+        regions[nRegion].length     = row->getLongAt(row,side+3);
+        regions[nRegion].nameOffset = nNameByte;
+        nRegion++;
+        nNameByte += lenName;
+      }
+    }
+
+    // Region ids for now - turned into indexes once the regions are sorted
+    rows = AssemblyMapperAdaptor_growArray(rows, nRow, &nRowAlloc, sizeof(AssemblySnapshotRow));
+    rows[nRow].asmRegion = row->getLongLongAt(row,0);
+    rows[nRow].asmStart  = row->getLongAt(row,4);
+    rows[nRow].asmEnd    = row->getLongAt(row,5);
+    rows[nRow].cmpRegion = row->getLongLongAt(row,6);
+    rows[nRow].cmpStart  = row->getLongAt(row,10);
+    rows[nRow].cmpEnd    = row->getLongAt(row,11);
+    rows[nRow].ori       = row->getIntAt(row,12);
+    nRow++;
+    sections[nSection-1].nRow++;
+  }
+  sth->finish(sth);
+  IDHash_free(seenRegions, NULL);
+
+  qsort(regions, nRegion, sizeof(AssemblySnapshotRegion), AssemblyMapperAdaptor_compRegionId);
+
+  // Reuse the reader's lookup on the sorted regions to turn ids into indexes
+  AssemblySnapshot sorted;
+  memset(&sorted, 0, sizeof(AssemblySnapshot));
+  sorted.regions = regions;
+  sorted.nRegion = nRegion;
+  for (i=0; i<nRow; i++) {
+    rows[i].asmRegion = AssemblySnapshot_findRegion(&sorted, rows[i].asmRegion);
+    rows[i].cmpRegion = AssemblySnapshot_findRegion(&sorted, rows[i].cmpRegion);
+  }
+
+  AssemblySnapshot *snap = NULL;
+  if (AssemblySnapshot_write(fileName, key, regions, nRegion, sections, nSection, rows, nRow, names, nNameByte) == 0) {
+    snap = AssemblySnapshot_open(fileName, key);
+  }
+
+  free(regions);
+  free(sections);
+  free(rows);
+  free(names);
+
+  return snap;
+}
+
 
 /*
 =head2  cache_seq_ids_with_mult_assemblys
@@ -533,6 +761,16 @@ char *AssemblyMapperAdaptor_seqRegionIdToName(AssemblyMapperAdaptor *ama, IDType
     return cacheData->regionName;
   }
 
+  // Only look in the snapshot if it's already loaded - not worth generating it for one name
+  long snapInd;
+  if (ama->snapshot != NULL && (snapInd = AssemblySnapshot_findRegion(ama->snapshot, srId)) >= 0) {
+    AssemblySnapshotRegion *region = &ama->snapshot->regions[snapInd];
+    DBAdaptor_addToSrCaches(ama->dba, srId, AssemblySnapshot_getRegionName(ama->snapshot, region), region->csId, region->length);
+
+    SeqRegionCacheEntry *cacheData = IDHash_getValue(ama->srIdCache, srId);
+    return cacheData->regionName;
+  }
+
   // Get the seq_region name via the id.  This would be quicker if we just
   // used internal ids instead but stored but then we lose the ability
   // the transform across databases with different internal ids
@@ -1386,6 +1624,32 @@ void AssemblyMapperAdaptor_registerAll(AssemblyMapperAdaptor *ama, AssemblyMappe
   IDType cmpCsId = CoordSystem_getDbID(AssemblyMapper_getComponentCoordSystem(asmMapper));
   IDType asmCsId = CoordSystem_getDbID(AssemblyMapper_getAssembledCoordSystem(asmMapper));
 
+  IDHash *asmRegistered = IDHash_new(IDHASH_MEDIUM);
+
+  // The snapshot has every row in the assembly table, so no section for
+  // these coord systems means there's nothing to register
+  AssemblySnapshot *snap = AssemblyMapperAdaptor_getSnapshot(ama);
+  if (snap != NULL) {
+    AssemblySnapshotSection *section = AssemblySnapshot_findSection(snap, asmCsId, cmpCsId);
+    long i;
+
+    for (i=0; section != NULL && i<section->nRow; i++) {
+      AssemblySnapshotRow *snapRow = &snap->rows[section->firstRow + i];
+      AssemblySnapshotRegion *cmpRegion = &snap->regions[snapRow->cmpRegion];
+      AssemblySnapshotRegion *asmRegion = &snap->regions[snapRow->asmRegion];
+
+      AssemblyMapperAdaptor_registerAllRow(ama, asmMapper, asmRegistered,
+                                           cmpRegion->id, AssemblySnapshot_getRegionName(snap, cmpRegion), cmpRegion->length,
+                                           snapRow->cmpStart, snapRow->cmpEnd,
+                                           snapRow->ori,
+                                           asmRegion->id, AssemblySnapshot_getRegionName(snap, asmRegion), asmRegion->length,
+                                           snapRow->asmStart, snapRow->asmEnd);
+    }
+
+    IDHash_free(asmRegistered, NULL);
+    return;
+  }
+
   // retrieve every relevant assembled/component pair from the assembly table
 
   char qStr[1024];
@@ -1414,8 +1678,6 @@ void AssemblyMapperAdaptor_registerAll(AssemblyMapperAdaptor *ama, AssemblyMappe
   sth->execute(sth);
 
   // load the asmMapper with the assembly information
-  IDHash *asmRegistered = IDHash_new(IDHASH_MEDIUM);
-
   ResultRow *row;
   while ((row = sth->fetchRow(sth))) {
     long cmpStart         = row->getLongAt(row,0);
@@ -1430,36 +1692,50 @@ void AssemblyMapperAdaptor_registerAll(AssemblyMapperAdaptor *ama, AssemblyMappe
     char *asmSeqRegion    = row->getStringAt(row,9);
     long asmLength        = row->getLongAt(row,10);
 
-    AssemblyMapper_registerComponent(asmMapper, cmpSeqRegionId);
+    AssemblyMapperAdaptor_registerAllRow(ama, asmMapper, asmRegistered,
+                                         cmpSeqRegionId, cmpSeqRegion, cmpLength, cmpStart, cmpEnd,
+                                         ori,
+                                         asmSeqRegionId, asmSeqRegion, asmLength, asmStart, asmEnd);
+  }
 
-    Mapper *mapper = AssemblyMapper_getMapper(asmMapper);
+  IDHash_free(asmRegistered, NULL);
 
-    Mapper_addMapCoordinates(mapper,
-                 asmSeqRegionId, asmStart, asmEnd, ori,
-                 cmpSeqRegionId, cmpStart, cmpEnd);
+  sth->finish(sth);
+
+  return;
+}
 
-    DBAdaptor_addToSrCaches(ama->dba, cmpSeqRegionId, cmpSeqRegion, cmpCsId, cmpLength);
+// Adds one row of the assembly table to asmMapper, whether it came from the database or the snapshot
+static void AssemblyMapperAdaptor_registerAllRow(AssemblyMapperAdaptor *ama, AssemblyMapper *asmMapper, IDHash *asmRegistered,
+                                                 IDType cmpSeqRegionId, char *cmpSeqRegion, long cmpLength, long cmpStart, long cmpEnd,
+                                                 int ori,
+                                                 IDType asmSeqRegionId, char *asmSeqRegion, long asmLength, long asmStart, long asmEnd) {
+  IDType cmpCsId = CoordSystem_getDbID(AssemblyMapper_getComponentCoordSystem(asmMapper));
+  IDType asmCsId = CoordSystem_getDbID(AssemblyMapper_getAssembledCoordSystem(asmMapper));
 
-    // only register each asm seq_region once since it requires some work
-    if ( ! IDHash_contains(asmRegistered, asmSeqRegionId)) {
-      IDHash_add(asmRegistered, asmSeqRegionId, &trueVal);
+  AssemblyMapper_registerComponent(asmMapper, cmpSeqRegionId);
 
-      // register all chunks from start of seq region to end
-      int endChunk = asmLength >> CHUNKFACTOR;
-      int i;
-      for (i=0; i<=endChunk; i++) {
-        AssemblyMapper_registerAssembled(asmMapper, asmSeqRegionId, i);
-      }
+  Mapper *mapper = AssemblyMapper_getMapper(asmMapper);
 
-      DBAdaptor_addToSrCaches(ama->dba, asmSeqRegionId, asmSeqRegion, asmCsId, asmLength);
-    }
-  }
+  Mapper_addMapCoordinates(mapper,
+               asmSeqRegionId, asmStart, asmEnd, ori,
+               cmpSeqRegionId, cmpStart, cmpEnd);
 
-  IDHash_free(asmRegistered, NULL);
+  DBAdaptor_addToSrCaches(ama->dba, cmpSeqRegionId, cmpSeqRegion, cmpCsId, cmpLength);
 
-  sth->finish(sth);
+  // only register each asm seq_region once since it requires some work
+  if ( ! IDHash_contains(asmRegistered, asmSeqRegionId)) {
+    IDHash_add(asmRegistered, asmSeqRegionId, &trueVal);
 
-  return;
+    // register all chunks from start of seq region to end
+    int endChunk = asmLength >> CHUNKFACTOR;
+    int i;
+    for (i=0; i<=endChunk; i++) {
+      AssemblyMapper_registerAssembled(asmMapper, asmSeqRegionId, i);
+    }
+
+    DBAdaptor_addToSrCaches(ama->dba, asmSeqRegionId, asmSeqRegion, asmCsId, asmLength);
+  }
 }
 
 
@@ -26,6 +26,7 @@
 
 #include "StringHash.h"
 #include "SeqRegionRange.h"
+#include "AssemblySnapshot.h"
 
 
 struct AssemblyMapperAdaptorStruct {
@@ -34,10 +35,14 @@ struct AssemblyMapperAdaptorStruct {
   StringHash *srNameCache;
   IDHash *srIdCache;
   IDHash *multSeqIdCache;
+  char *snapshotDir;
+  AssemblySnapshot *snapshot;
+  int snapshotTried;
 };
 
 AssemblyMapperAdaptor *AssemblyMapperAdaptor_new(DBAdaptor *dba);
 
+void AssemblyMapperAdaptor_setSnapshotDir(AssemblyMapperAdaptor *ama, char *dir);
 void AssemblyMapperAdaptor_cacheSeqIdsWithMultAssemblies(AssemblyMapperAdaptor *ama);
 AssemblyMapper *AssemblyMapperAdaptor_fetchByCoordSystems(AssemblyMapperAdaptor *ama, CoordSystem *cs1, CoordSystem *cs2);
 SeqRegionRange *AssemblyMapperAdaptor_addToRangeVector(Vector *ranges, IDType id, long start, long end, char *name);
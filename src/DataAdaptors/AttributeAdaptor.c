@@ -64,6 +64,13 @@ NOTE: In perl this adaptor is implemented using the horrid AUTOLOAD lazyness. Ob
 
 #include "StatementHandle.h"
 #include "ResultRow.h"
+#include "IDHash.h"
+
+static Attribute *AttributeAdaptor_attributeFromRow(ResultRow *row, int firstCol);
+static IDHash *AttributeAdaptor_fetchAllByTypeAndTableAndIDList(AttributeAdaptor *ata, char *type, char *table, IDType *objectIds, int nObjectId);
+
+// Ids in each IN (...) list, as in BaseAdaptor_fetchAllByDbIDList
+#define ATTRIBUTEADAPTOR_MAXINSIZE 16384
 
 /*
 =head2 new
@@ -369,30 +376,137 @@ Vector *AttributeAdaptor_fetchAllByMiscFeature(AttributeAdaptor *ata, MiscFeatur
 */
 
 Vector *AttributeAdaptor_doFetchAllByTypeAndTableAndID(AttributeAdaptor *ata, char *type, char *table, IDType objectId, char *code) {
-  char qStr[1024];
+  StrBuf *qStr = StrBuf_new(STRBUF_DEFAULTSIZE);
 
-  sprintf(qStr, "SELECT at.code, at.name, at.description, t.value "
-                  "FROM %s_attrib t, attrib_type at "
-                 "WHERE at.attrib_type_id = t.attrib_type_id", table);
+  StrBuf_appendf(qStr, "SELECT at.code, at.name, at.description, t.value "
+                         "FROM %s_attrib t, attrib_type at "
+                        "WHERE at.attrib_type_id = t.attrib_type_id", table);
 
   if (code != NULL){
-    sprintf(qStr,"%s AND at.code like '%s'", qStr, code);
+    StrBuf_appendf(qStr, " AND at.code like '%s'", code);
   }
 
 //  if(defined($object_id)){
-  sprintf(qStr,"%s AND t.%s_id = "IDFMTSTR, qStr, type, objectId);
+  StrBuf_appendf(qStr, " AND t.%s_id = "IDFMTSTR, type, objectId);
 //  }
 		   
-  StatementHandle *sth = ata->prepare((BaseAdaptor *)ata,qStr,strlen(qStr));
+  StatementHandle *sth = ata->prepare((BaseAdaptor *)ata,StrBuf_getString(qStr),StrBuf_getLength(qStr));
   sth->execute(sth);
 
   Vector *results = AttributeAdaptor_objectsFromStatementHandle(ata, sth);
 
   sth->finish(sth);
+  StrBuf_free(qStr);
 
   return results;
 }
 
+/*
+ Loads the attributes of all the transcripts in the list, and of their
+ translations, with a few IN (...) queries rather than one query per object,
+ and attaches them. Transcript_getAllAttributes and
+ Translation_getAllAttributes (used when translating and applying seq edits)
+ then don't go back to the database for each one. Objects which already have
+ their attributes are left alone, and ones without any get an empty list.
+*/
+void AttributeAdaptor_prefetchForTranscripts(AttributeAdaptor *ata, Vector *transcripts) {
+  IDHash *transHash = IDHash_new(IDHASH_LARGE);
+  IDHash *translHash = IDHash_new(IDHASH_LARGE);
+  IDHash *attribs;
+  IDType *ids;
+  int nId;
+  int i;
+
+  for (i=0; i<Vector_getNumElement(transcripts); i++) {
+    Transcript *trans = Vector_getElementAt(transcripts, i);
+    Translation *transl = trans->translation;
+
+    if (trans->attributes == NULL && !IDHash_contains(transHash, Transcript_getDbID(trans))) {
+      IDHash_add(transHash, Transcript_getDbID(trans), trans);
+    }
+    // Only translations which are already loaded - loading them is a job for TranslationAdaptor_fetchAllByTranscriptList
+    if (transl && transl->attributes == NULL && Translation_getDbID(transl) &&
+        !IDHash_contains(translHash, Translation_getDbID(transl))) {
+      IDHash_add(translHash, Translation_getDbID(transl), transl);
+    }
+  }
+
+  ids = IDHash_getKeys(transHash);
+  nId = IDHash_getNumValues(transHash);
+  attribs = AttributeAdaptor_fetchAllByTypeAndTableAndIDList(ata, "transcript", "transcript", ids, nId);
+  for (i=0; i<nId; i++) {
+    Transcript *trans = IDHash_getValue(transHash, ids[i]);
+    Vector *transAttribs = IDHash_getValue(attribs, ids[i]);
+
+    trans->attributes = transAttribs ? transAttribs : Vector_new();
+  }
+  IDHash_free(attribs, NULL);
+  free(ids);
+
+  ids = IDHash_getKeys(translHash);
+  nId = IDHash_getNumValues(translHash);
+  attribs = AttributeAdaptor_fetchAllByTypeAndTableAndIDList(ata, "translation", "translation", ids, nId);
+  for (i=0; i<nId; i++) {
+    Translation *transl = IDHash_getValue(translHash, ids[i]);
+    Vector *translAttribs = IDHash_getValue(attribs, ids[i]);
+
+    transl->attributes = translAttribs ? translAttribs : Vector_new();
+  }
+  IDHash_free(attribs, NULL);
+  free(ids);
+
+  IDHash_free(transHash, NULL);
+  IDHash_free(translHash, NULL);
+}
+
+/*
+ Set oriented version of AttributeAdaptor_doFetchAllByTypeAndTableAndID.
+ Returns a hash from object id to a Vector of its attributes, which only has
+ entries for objects with attributes.
+*/
+static IDHash *AttributeAdaptor_fetchAllByTypeAndTableAndIDList(AttributeAdaptor *ata, char *type, char *table, IDType *objectIds, int nObjectId) {
+  IDHash *attribs = IDHash_new(IDHASH_LARGE);
+  StrBuf *qStr;
+  int i;
+
+  if (!nObjectId) {
+    return attribs;
+  }
+
+  qStr = StrBuf_new(STRBUF_DEFAULTSIZE);
+
+  for (i=0; i<nObjectId; i+=ATTRIBUTEADAPTOR_MAXINSIZE) {
+    StrBuf_clear(qStr);
+    StrBuf_appendf(qStr, "SELECT at.code, at.name, at.description, t.value, t.%s_id "
+                           "FROM %s_attrib t, attrib_type at "
+                          "WHERE at.attrib_type_id = t.attrib_type_id "
+                            "AND t.%s_id IN (", type, table, type);
+    StrBuf_appendIDList(qStr, &objectIds[i], nObjectId-i < ATTRIBUTEADAPTOR_MAXINSIZE ? nObjectId-i : ATTRIBUTEADAPTOR_MAXINSIZE);
+    StrBuf_appendChar(qStr, ')');
+
+    StatementHandle *sth = ata->prepare((BaseAdaptor *)ata,StrBuf_getString(qStr),StrBuf_getLength(qStr));
+    sth->execute(sth);
+
+    ResultRow *row;
+    while ((row = sth->fetchRow(sth))) {
+      IDType objectId = row->getLongLongAt(row, 4);
+      Vector *objAttribs = IDHash_getValue(attribs, objectId);
+
+      if (objAttribs == NULL) {
+        objAttribs = Vector_new();
+        IDHash_add(attribs, objectId, objAttribs);
+      }
+      Vector_addElement(objAttribs, AttributeAdaptor_attributeFromRow(row, 0));
+    }
+
+    sth->finish(sth);
+  }
+
+  StrBuf_free(qStr);
+
+  return attribs;
+}
+
 /* Equivalent will be AttributeAdaptor_free
 sub DESTROY{
 }
@@ -493,19 +607,24 @@ Vector *AttributeAdaptor_objectsFromStatementHandle(AttributeAdaptor *ata, State
   ResultRow *row;
 // Note extra parentheses are to keep mac compiler happy
   while ((row = sth->fetchRow(sth))) {
-    char *code  = row->getStringAt(row, 0);
-    char *name  = row->getStringAt(row, 1);
-    char *desc  = row->getStringAt(row, 2);
-    char *value = row->getStringAt(row, 3);
-
-    Attribute *attr = Attribute_new();
-    Attribute_setCode(attr, code);
-    Attribute_setName(attr, name);
-    Attribute_setDescription(attr, desc);
-    Attribute_setValue(attr, value);
-    
-    Vector_addElement(results, attr);
+    Vector_addElement(results, AttributeAdaptor_attributeFromRow(row, 0));
   }
 
   return results;
 }
+
+// Makes an Attribute from the code, name, description and value columns starting at firstCol
+static Attribute *AttributeAdaptor_attributeFromRow(ResultRow *row, int firstCol) {
+  char *code  = row->getStringAt(row, firstCol);
+  char *name  = row->getStringAt(row, firstCol+1);
+  char *desc  = row->getStringAt(row, firstCol+2);
+  char *value = row->getStringAt(row, firstCol+3);
+
+  Attribute *attr = Attribute_new();
+  Attribute_setCode(attr, code);
+  Attribute_setName(attr, name);
+  Attribute_setDescription(attr, desc);
+  Attribute_setValue(attr, value);
+
+  return attr;
+}
@@ -31,6 +31,7 @@ Vector *AttributeAdaptor_fetchAllByTranscript(AttributeAdaptor *ata, Transcript
 Vector *AttributeAdaptor_fetchAllByGene(AttributeAdaptor *ata, Gene *gene, char *code);
 Vector *AttributeAdaptor_fetchAllBySlice(AttributeAdaptor *ata, Slice *slice, char *code);
 Vector *AttributeAdaptor_fetchAllByTranslation(AttributeAdaptor *ata, Translation *translation, char *code);
+void AttributeAdaptor_prefetchForTranscripts(AttributeAdaptor *ata, Vector *transcripts);
 
 Vector *AttributeAdaptor_doFetchAllByTypeAndTableAndID(AttributeAdaptor *ata, char *type, char *table, IDType objectId, char *code);
 Vector *AttributeAdaptor_objectsFromStatementHandle(AttributeAdaptor *ata, StatementHandle *sth);
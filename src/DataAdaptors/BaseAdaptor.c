@@ -221,25 +221,42 @@ sub _bind_param_generic_fetch {
 */
 Vector *BaseAdaptor_genericFetch(BaseAdaptor *ba, char *constraint, AssemblyMapper *mapper, Slice *slice) {
   Vector *res = NULL;
-  char *qStr = NULL;
 
-  if ((qStr = (char *)calloc(655500,sizeof(char))) == NULL) {
-    fprintf(stderr,"Failed allocating qStr\n");
-    return res;
+  StrBuf *sql = StrBuf_new(STRBUF_DEFAULTSIZE + (constraint ? strlen(constraint) : 0));
+  BaseAdaptor_generateSql(ba, constraint, NULL, sql);
+  char *qStr = StrBuf_getString(sql);
+
+  // Whole table fetches have the same SQL every time, so where the adaptor uses the standard
+  // connection they go through the connection's prepared statement cache and get their rows over
+  // the binary protocol, without parsing every numeric column from text. Anything with a
+  // constraint has its values in the SQL and only runs once, so a prepared statement would just
+  // add two round trips (prepare and close) - those stay on the text protocol.
+  // Note the query is NOT used as a format string in the prepared case.
+  StatementHandle *sth = NULL;
+  if (constraint == NULL && ba->prepare == BaseAdaptor_prepare && ba->dba && ba->dba->dbc) {
+    sth = DBConnection_tryPrepareStatement(ba->dba->dbc, qStr, strlen(qStr));
+  }
+  if (sth == NULL) {
+    sth = ba->prepare((BaseAdaptor *)ba,qStr,strlen(qStr));
   }
-
-  qStr[0] = '\0';
-
-  BaseAdaptor_generateSql(ba, constraint, NULL, qStr);
-
-  StatementHandle *sth = ba->prepare((BaseAdaptor *)ba,qStr,strlen(qStr));
 
   sth->execute(sth);
 
+  // If the DBAdaptor has an arena the objects made from the rows come from it
+  Arena *arena = ba->dba ? DBAdaptor_getArena(ba->dba) : NULL;
+  Arena *prevArena = NULL;
+  if (arena) {
+    prevArena = Arena_setCurrent(arena);
+  }
+
   res = ba->objectsFromStatementHandle(ba, sth, mapper, slice);
   sth->finish(sth);
 
-  free(qStr);
+  if (arena) {
+    Arena_setCurrent(prevArena);
+  }
+
+  StrBuf_free(sql);
   return res;
 }
 
@@ -260,32 +277,27 @@ Vector *BaseAdaptor_genericFetch(BaseAdaptor *ba, char *constraint, AssemblyMapp
 char *countCols[] = {"count(*)", NULL};
 
 int BaseAdaptor_genericCount(BaseAdaptor *ba, char *constraint) {
-  char *qStr = NULL;
-
-  if ((qStr = (char *)calloc(655500,sizeof(char))) == NULL) {
-    fprintf(stderr,"Failed allocating qStr\n");
-    return 0;
-  }
-
-  qStr[0] = '\0';
-
-  BaseAdaptor_generateSql(ba, constraint, countCols, qStr);
+  StrBuf *sql = StrBuf_new(STRBUF_DEFAULTSIZE + (constraint ? strlen(constraint) : 0));
+  BaseAdaptor_generateSql(ba, constraint, countCols, sql);
+  char *qStr = StrBuf_getString(sql);
 
   StatementHandle *sth = ba->prepare(ba,qStr,strlen(qStr));
   sth->execute(sth);
 
   if (sth->numRows(sth) != 1) {
     fprintf(stderr, "genericCount didn't return a row - bye!\n");
+    StrBuf_free(sql);
     return 0;
   }
   ResultRow *row = sth->fetchRow(sth);
   int count = row->getLongAt(row, 0);
 
-  free(qStr);
+  StrBuf_free(sql);
   return count;
 }
 
-void BaseAdaptor_generateSql(BaseAdaptor *ba, char *constraint, char **inputColumns, char *sql) {
+// Appends the SELECT statement for constraint to sql
+void BaseAdaptor_generateSql(BaseAdaptor *ba, char *constraint, char **inputColumns, StrBuf *sql) {
   NameTableType *tables = ba->getTables();
   char tmpStr[1024];
   char extraDefaultWhere[1024];
@@ -446,13 +458,15 @@ void BaseAdaptor_generateSql(BaseAdaptor *ba, char *constraint, char **inputColu
     if (tableNamesStr[0]) {
       strcat(tableNamesStr, ",");
     }
-    sprintf(tableNamesStr, "%s coord_system %s", tableNamesStr, csAlias);
+    strcat(tableNamesStr, " coord_system ");
+    strcat(tableNamesStr, csAlias);
   }
   if (needSrTab) {
     if (tableNamesStr[0]) {
       strcat(tableNamesStr, ",");
     }
-    sprintf(tableNamesStr, "%s seq_region %s", tableNamesStr, srAlias);
+    strcat(tableNamesStr, " seq_region ");
+    strcat(tableNamesStr, srAlias);
   }
 
   char straightJoin[128];
@@ -464,9 +478,9 @@ void BaseAdaptor_generateSql(BaseAdaptor *ba, char *constraint, char **inputColu
     strcpy(straightJoin, "STRAIGHT_JOIN");
   }
 
-  sprintf(sql, "SELECT %s %s\n"
-               " FROM %s (%s) %s",
-               straightJoin, columnsStr, leftJoinPrefix, tableNamesStr, leftJoin);
+  StrBuf_appendf(sql, "SELECT %s %s\n"
+                      " FROM %s (%s) %s",
+                      straightJoin, columnsStr, leftJoinPrefix, tableNamesStr, leftJoin);
 
   char defaultWhereStr[4128];
   strcpy(defaultWhereStr, ba->defaultWhereClause());
@@ -482,19 +496,22 @@ void BaseAdaptor_generateSql(BaseAdaptor *ba, char *constraint, char **inputColu
 
   // append a where clause if it was defined
   if (constraint) {
-    sprintf(sql, "%s\n WHERE %s", sql, constraint);
+    StrBuf_append(sql, "\n WHERE ");
+    StrBuf_append(sql, constraint);
     if (defaultWhereStr[0]) {
-      sprintf(sql, "%s AND \n    %s", sql, defaultWhereStr);
+      StrBuf_append(sql, " AND \n    ");
+      StrBuf_append(sql, defaultWhereStr);
     }
   } else if (defaultWhereStr[0]) {
-    sprintf(sql, "%s\n WHERE %s", sql, defaultWhereStr);
+    StrBuf_append(sql, "\n WHERE ");
+    StrBuf_append(sql, defaultWhereStr);
   }
 
   //append additional clauses which may have been defined
-  if ((ba->finalClause())[0]) strcat(sql, ba->finalClause());
+  if ((ba->finalClause())[0]) StrBuf_append(sql, ba->finalClause());
   
   // FOR DEBUG:
-  //fprintf(stderr, "SQL:\n%s\n", sql);
+  //fprintf(stderr, "SQL:\n%s\n", StrBuf_getString(sql));
   
   return;
 }
@@ -654,44 +671,29 @@ Vector *BaseAdaptor_uncachedFetchAllByDbIDList(BaseAdaptor *ba, Vector *idList,
 
   Vector *out = Vector_new();
 
-  int lenNum;
+  // One builder reused for every chunk
+  StrBuf *constraint = StrBuf_new(STRBUF_DEFAULTSIZE);
   for (i=0; i<nUniqueId; i+=maxSize) {
-    char *constraint = NULL;
-
-    if ((constraint = (char *)calloc(655500,sizeof(char))) == NULL) {
-      fprintf(stderr,"Failed allocating constraint\n");
-      return out;
-    }
-
-    strcpy(constraint, constraintPref);
+    StrBuf_clear(constraint);
+    StrBuf_append(constraint, constraintPref);
   
     // Special case for one remaining Id
     if (i == nUniqueId-1) {
-      sprintf(constraint, "%s = "IDFMTSTR, constraint, uniqueIds[i]);
+      StrBuf_append(constraint, " = ");
+      StrBuf_appendID(constraint, uniqueIds[i]);
     } else {
-      char tmpStr[1024];
-      int endPoint = sprintf(constraint, "%s IN (", constraint);
-      int j;
-      for (j=0; j<maxSize && j+i<nUniqueId; j++) {
-        if (j!=0) {
-          constraint[endPoint++] = ',';
-          constraint[endPoint++] = ' ';
-        }
-        lenNum = sprintf(tmpStr, IDFMTSTR, uniqueIds[i+j]);
-        memcpy(&(constraint[endPoint]), tmpStr, lenNum);
-        endPoint+=lenNum;
-      }
-      constraint[endPoint++] = ')';
-      constraint[endPoint] = '\0';
+      StrBuf_append(constraint, " IN (");
+      StrBuf_appendIDList(constraint, &uniqueIds[i], nUniqueId-i < maxSize ? nUniqueId-i : maxSize);
+      StrBuf_appendChar(constraint, ')');
     }
 
-    Vector *resChunk = BaseAdaptor_genericFetch(ba, constraint, NULL, slice);
+    Vector *resChunk = BaseAdaptor_genericFetch(ba, StrBuf_getString(constraint), NULL, slice);
 
     Vector_append(out, resChunk);
 
     Vector_free(resChunk);
-    free(constraint);
   }
+  StrBuf_free(constraint);
   free(uniqueIds);
 
   return out;
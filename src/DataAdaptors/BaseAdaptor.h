@@ -28,6 +28,7 @@
 #include "Vector.h"
 #include "Slice.h"
 #include "AssemblyMapper.h"
+#include "StrBuf.h"
 
 
 #ifdef __MAIN_C__
@@ -160,7 +161,7 @@ Vector *BaseAdaptor_objectsFromStatementHandle(BaseAdaptor *bfa, StatementHandle
 Vector *BaseAdaptor_genericFetch(BaseAdaptor *ba, char *constraint, AssemblyMapper *mapper, Slice *slice);
 Vector *BaseAdaptor_listDbIDs(BaseAdaptor *ba, char *table, char *pk, int ordered);
 int BaseAdaptor_genericCount(BaseAdaptor *ba, char *constraint);
-void BaseAdaptor_generateSql(BaseAdaptor *ba, char *constraint, char **inputColumns, char *sql);
+void BaseAdaptor_generateSql(BaseAdaptor *ba, char *constraint, char **inputColumns, StrBuf *sql);
 SeqFeature *BaseAdaptor_fetchByDbID(BaseAdaptor *ba, IDType id);
 Vector *BaseAdaptor_fetchAllByDbIDList(BaseAdaptor *ba, Vector *idList, Slice *slice);
 Vector *BaseAdaptor_uncachedFetchAllByDbIDList(BaseAdaptor *ba, Vector *idList, Slice *slice);
@@ -32,6 +32,7 @@ struct BaseDBAdaptorStruct {
 
 
 #define BaseDBAdaptor_prepare(dba,qStr,qLen) (dba)->dbc->prepare((dba)->dbc,(qStr),(qLen))
+#define BaseDBAdaptor_prepareStatement(dba,qStr,qLen) (dba)->dbc->prepareStatement((dba)->dbc,(qStr),(qLen))
 
 
 #endif
@@ -26,6 +26,8 @@
 #include "MetaCoordContainer.h"
 #include "Object.h"
 #include "Slice.h"
+#include "FeaturePair.h"
+#include "MysqlPreparedStatementHandle.h"
 
 #include "DNAAlignFeature.h"
 
@@ -52,9 +54,40 @@ common to all feature adaptors.
 */
 
 
-static int SLICE_FEATURE_CACHE_SIZE    = 4;
+static size_t SLICE_FEATURE_CACHE_SIZE = 64 * 1024 * 1024; // bytes of cached features per adaptor
+static double SLICE_FEATURE_CACHE_COST = 100.0; // Relative cost of a feature query (for the cache manager)
 static int MAX_SPLIT_QUERY_SEQ_REGIONS = 3;
 static int SILENCE_CACHE_WARNINGS      = 0;
+static int STREAM_WINDOW_ROWS          = 256; // rows made into features at a time by iterateBySlice
+
+// State for BaseFeatureAdaptor_iterateBySlice
+typedef struct BaseFeatureAdaptorIteratorStruct {
+  BaseFeatureAdaptor_IterateFunc func;
+  void *userData;
+  Slice *slice;
+  int symlinked;
+  long offset;
+  long *bounds;
+  int nBound;
+  long nFeature;
+  int stopped;
+} BaseFeatureAdaptorIterator;
+
+// Statement handle which gives out at most nLeft of the rows of another one
+#define FUNCSTRUCTTYPE StatementHandleFuncs
+typedef struct BaseFeatureAdaptorRowWindowStruct {
+  STATEMENTHANDLE_DATA
+  StatementHandle *inner;
+  int nLeft;
+  int exhausted;
+} BaseFeatureAdaptorRowWindow;
+#undef FUNCSTRUCTTYPE
+
+static ResultRow *BaseFeatureAdaptor_rowWindowFetchRow(StatementHandle *sth);
+static unsigned long long BaseFeatureAdaptor_rowWindowNumRows(StatementHandle *sth);
+static void BaseFeatureAdaptor_iterateFeature(BaseFeatureAdaptorIterator *iter, SeqFeature *f);
+static Vector *BaseFeatureAdaptor_getBySliceImpl(BaseFeatureAdaptor *bfa, Slice *slice, char *origConstraint, char *queryType,
+                                                 BaseFeatureAdaptorIterator *iter);
 
 
 /*
@@ -75,7 +108,11 @@ static int SILENCE_CACHE_WARNINGS      = 0;
 void BaseFeatureAdaptor_init(BaseFeatureAdaptor *bfa, DBAdaptor *dba, int adaptorType) {
   BaseAdaptor_init((BaseAdaptor *)bfa,dba,adaptorType);
 
-  bfa->sliceFeatureCache = Cache_new(SLICE_FEATURE_CACHE_SIZE);
+  bfa->sliceFeatureCache = FeatureCache_new(SLICE_FEATURE_CACHE_SIZE);
+
+  char cacheName[1024];
+  sprintf(cacheName, "Slice features (adaptor type %d)", adaptorType);
+  FeatureCache_setManager(bfa->sliceFeatureCache, DBAdaptor_getCacheManager(dba), cacheName, SLICE_FEATURE_CACHE_COST);
 
   if ( DBAdaptor_noCache(bfa->dba) && ! SILENCE_CACHE_WARNINGS) {
     fprintf(stderr, "You are using the API without caching most recent features. "
@@ -174,7 +211,7 @@ void BaseFeatureAdaptor_clearCache(BaseFeatureAdaptor *bfa) {
 }
 
 void BaseFeatureAdaptor_clearSliceFeatureCache(BaseFeatureAdaptor *bfa) {
-  Cache_empty(bfa->sliceFeatureCache);
+  FeatureCache_empty(bfa->sliceFeatureCache);
 
   return;
 }
@@ -435,37 +472,26 @@ Vector *BaseFeatureAdaptor_fetchAllBySliceAndScore(BaseFeatureAdaptor *bfa, Slic
 
 Vector *BaseFeatureAdaptor_fetchAllBySliceConstraint(BaseFeatureAdaptor *bfa, Slice *slice, char *constraint, char *logicName) {
   Vector *result = Vector_new();
+  StrBuf *allConstraintBuf = StrBuf_new(STRBUF_DEFAULTSIZE);
   char *allConstraint = NULL;
-  char *key = NULL;
+  FeatureCacheKey key;
+  int useCache = FALSE;
   int done = FALSE;
 
-  if (!done && (allConstraint = (char *)calloc(655500,sizeof(char))) == NULL) {
-    fprintf(stderr,"Failed allocating allConstraint\n");
-    done = TRUE;
+  if (constraint != NULL && *constraint != '\0') {
+    StrBuf_append(allConstraintBuf, constraint);
   }
 
-  if (!done && (key = (char *)calloc(655500,sizeof(char))) == NULL) {
-    fprintf(stderr,"Failed allocating key\n");
+  if ( ! BaseFeatureAdaptor_logicNameToConstraint(bfa, allConstraintBuf, logicName)) {
+    // If the logic name was invalid, undef was returned
     done = TRUE;
   }
+  allConstraint = StrBuf_getString(allConstraintBuf);
 
   if (!done) {
-    allConstraint[0] = '\0';
-    key[0] = '\0';
-
-    if (constraint != NULL && *constraint != '\0') {
-      strcpy(allConstraint, constraint);
-    }
-
-    if ( ! BaseFeatureAdaptor_logicNameToConstraint(bfa, allConstraint, logicName)) {
-      // If the logic name was invalid, undef was returned
-      done = TRUE;
-    }
-  }
-
-  if (!done) {
-    // Will only use feature_cache if hasn't got no_cache attribute set
-    if ( !DBAdaptor_noCache(bfa->dba)) {
+    // Will only use feature_cache if hasn't got no_cache attribute set.
+    // Features allocated from an arena can't be cached as they go with it
+    if ( !DBAdaptor_noCache(bfa->dba) && DBAdaptor_getArena(bfa->dba) == NULL && Arena_getCurrent() == NULL) {
 
       /*
       // strain test and add to constraint if so to stop caching.
@@ -482,15 +508,18 @@ Vector *BaseFeatureAdaptor_fetchAllBySliceConstraint(BaseFeatureAdaptor *bfa, Sl
       */
 
       // Check the cache and return the cached results if we have already
-      // done this query.  The cache key is the made up from the slice
-      // name, the constraint, and the bound parameters (if there are any).
-      ECOSTRING slice_name = Slice_getName(slice);
-      if (slice_name)
-        sprintf(key, "%s:%s", slice_name, allConstraint);
-      else
-        fprintf(stderr, "Error getting slice name");
-
-      StrUtil_strupr(key);
+      // done this query.  The cache key is made up from the slice's region
+      // and the constraint (which the logic name has been added to). Perl
+      // uses the slice name, but the seq_region_id, start, end and strand
+      // identify the region without building a string.
+      IDType seqRegionId = Slice_getSeqRegionId(slice);
+      if (seqRegionId) {
+        FeatureCacheKey_init(&key, seqRegionId, Slice_getStart(slice), Slice_getEnd(slice),
+                             Slice_getStrand(slice), allConstraint);
+        useCache = TRUE;
+      } else {
+        fprintf(stderr, "Error getting seq region id for slice cache key\n");
+      }
     
       /* In C I don't have bound params, I put them into the constraint, so there should be no need for this bit of the key
          if ( defined($bind_params) ) {
@@ -499,9 +528,13 @@ Vector *BaseFeatureAdaptor_fetchAllBySliceConstraint(BaseFeatureAdaptor *bfa, Sl
          }
       */
 
-      if (Cache_contains(bfa->sliceFeatureCache, key)) {
+      // The caller gets its own reference to a cached result, as a put into any
+      // cache sharing the DBAdaptor's budget can evict it from this one
+      Vector *cached;
+      if (useCache && (cached = FeatureCache_get(bfa->sliceFeatureCache, &key)) != NULL) {
         Vector_free(result);
-        result = Cache_findElem(bfa->sliceFeatureCache, key);
+        Object_incRefCount(cached);
+        result = cached;
         done = TRUE;
       }
     }
@@ -563,22 +596,22 @@ Vector *BaseFeatureAdaptor_fetchAllBySliceConstraint(BaseFeatureAdaptor *bfa, Sl
     free(bounds);
 
     // Will only use feature_cache when set attribute no_cache in DBAdaptor
-    // Condition looks slightly odd, but key will have only been set to something if
-    // the code entered the noCache controlled condition above
-    if (key[0]) {
+    // useCache will only have been set if the code entered the noCache
+    // controlled condition above
+    if (useCache) {
       // Was null free func
       // Make null free func again for now
       //Vector_setFreeFunc(result, Object_freeImpl);
       Vector_setFreeFunc(result, NULL);
-      Cache_addElement(bfa->sliceFeatureCache, key, result, (Cache_FreeFunc)Object_freeImpl);
+
+      // Features don't know their own size so count each as a basic SeqFeature
+      size_t nBytes = sizeof(Vector) + Vector_getNumElement(result) * (sizeof(void *) + sizeof(SeqFeature));
+      Object_incRefCount(result);
+      FeatureCache_put(bfa->sliceFeatureCache, &key, result, (FeatureCache_FreeFunc)Object_freeImpl, nBytes);
     }
   }
 
-  if (allConstraint)
-    free(allConstraint);
-
-  if (key)
-    free(key);
+  StrBuf_free(allConstraintBuf);
 
   return result;
 }
@@ -608,14 +641,18 @@ Vector *BaseFeatureAdaptor_fetchAllByLogicName(BaseFeatureAdaptor *bfa, char *lo
     fprintf(stderr,"Need a logic_name\n");
     return NULL;
   }
-  char constraint[1024];
+  StrBuf *constraint = StrBuf_new(STRBUF_DEFAULTSIZE);
 
   if (!BaseFeatureAdaptor_logicNameToConstraint(bfa, constraint, logicName )) {
     fprintf(stderr, "Invalid logic name: %s\n", logicName);
+    StrBuf_free(constraint);
     return Vector_new();
   }
 
-  return BaseAdaptor_genericFetch((BaseAdaptor *)bfa, constraint, NULL, NULL);
+  Vector *features = BaseAdaptor_genericFetch((BaseAdaptor *)bfa, StrBuf_getString(constraint), NULL, NULL);
+  StrBuf_free(constraint);
+
+  return features;
 }
 
 /*
@@ -692,20 +729,15 @@ int BaseFeatureAdaptor_countBySliceConstraint(BaseFeatureAdaptor *bfa, Slice *sl
   char *tableSynonym = primTab[SYN];
   
   //Constraints
-  char *allConstraint = NULL;
-  if ((allConstraint = (char *)calloc(655500,sizeof(char))) == NULL) {
-    fprintf(stderr,"Failed allocating allConstraint\n");
-    return 0;
-  }
-
-  allConstraint[0] = '\0';
+  StrBuf *allConstraint = StrBuf_new(STRBUF_DEFAULTSIZE);
 
   if (constraint != NULL) {
-    strcpy(allConstraint, constraint);
+    StrBuf_append(allConstraint, constraint);
   }
 
   if ( ! BaseFeatureAdaptor_logicNameToConstraint(bfa, allConstraint, logicName)) {
   // If the logic name was invalid, undef was returned
+    StrBuf_free(allConstraint);
     return 0;
   }
 
@@ -740,26 +772,23 @@ int BaseFeatureAdaptor_countBySliceConstraint(BaseFeatureAdaptor *bfa, Slice *sl
         limitEnd   = 0; // don't check end as we are on the final projection
       }
 
-      if (allConstraint[0]) {
-        strcat(allConstraint, " AND ");
+      if (StrBuf_getLength(allConstraint)) {
+        StrBuf_append(allConstraint, " AND ");
       }
 
-      char tmpStr[1024];
       //Do not cross the start boundary so our feature must be less than slice end on all counts
       if (limitStart) {
-        sprintf(tmpStr,"%s.seq_region_start >= %ld", tableSynonym, Slice_getStart(segSlice));
-        strcat(allConstraint, tmpStr);
+        StrBuf_appendf(allConstraint, "%s.seq_region_start >= %ld", tableSynonym, Slice_getStart(segSlice));
       }
       //Do not cross the start boundary so our feature must be larger than slice start on all counts
       if (limitEnd) {
-        if (limitStart) strcat(allConstraint, " AND ");
+        if (limitStart) StrBuf_append(allConstraint, " AND ");
 
-        sprintf(tmpStr, "%s.seq_region_end <= %ld", tableSynonym, Slice_getEnd(segSlice));
-        strcat(allConstraint, tmpStr);
+        StrBuf_appendf(allConstraint, "%s.seq_region_end <= %ld", tableSynonym, Slice_getEnd(segSlice));
       }
     }
     
-    Vector *countVec = BaseFeatureAdaptor_getBySlice(bfa, segSlice, allConstraint, "count");
+    Vector *countVec = BaseFeatureAdaptor_getBySlice(bfa, segSlice, StrBuf_getString(allConstraint), "count");
 
     // Data comes out as an array
     int j;
@@ -769,11 +798,383 @@ int BaseFeatureAdaptor_countBySliceConstraint(BaseFeatureAdaptor *bfa, Slice *sl
     }
   }
 
-  free(allConstraint);
+  StrBuf_free(allConstraint);
   
   return count;
 }
 
+/*
+=head2 fetchBatchBySlice
+
+  Arg [1]    : BaseFeatureAdaptor *bfa
+  Arg [2]    : Slice *slice - the slice to fetch features on
+  Arg [3]    : char *constraint - extra SQL constraint, or NULL
+  Arg [4]    : char *logicName - only features with this analysis, or NULL
+  Example    : FeatureBatch *batch = BaseFeatureAdaptor_fetchBatchBySlice(dafa, slice, NULL, "rnaseq");
+               for (i=0; i<FeatureBatch_getNumFeature(batch); i++) {
+                 coverage += FeatureBatch_getEndAt(batch, i) - FeatureBatch_getStartAt(batch, i) + 1;
+               }
+  Description: Columnar alternative to fetchAllBySliceConstraint for jobs
+               which only need coordinates. The same features come back, in
+               slice coordinates, but as arrays of dbID, seq region id,
+               start, end, strand, score (0 where the table hasn't got one),
+               analysis id and hit name (align features only) in a
+               FeatureBatch, with no objects made.
+               When the features are all stored in the slice's coordinate
+               system, only those columns are selected and the rows go
+               straight into the batch. Otherwise (features needing mapping,
+               or slices with symlinked projections) the features are fetched
+               as usual and copied into the batch.
+               Use fetchFeatureFromBatch for the full object for any feature.
+  Returntype : FeatureBatch * - to be freed with FeatureBatch_free
+  Exceptions : none
+  Caller     : general
+  Status     : At risk
+
+=cut
+*/
+FeatureBatch *BaseFeatureAdaptor_fetchBatchBySlice(BaseFeatureAdaptor *bfa, Slice *slice, char *constraint, char *logicName) {
+  FeatureBatch *batch = FeatureBatch_new(slice);
+  NameTableType *tables = bfa->getTables();
+  char *tableName = (*tables)[0][NAME];
+  char *tableSynonym = (*tables)[0][SYN];
+  StrBuf *allConstraint = StrBuf_new(STRBUF_DEFAULTSIZE);
+  int i;
+
+  if (constraint != NULL) {
+    StrBuf_append(allConstraint, constraint);
+  }
+
+  if ( ! BaseFeatureAdaptor_logicNameToConstraint(bfa, allConstraint, logicName)) {
+    // If the logic name was invalid, there are no features
+    StrBuf_free(allConstraint);
+    return batch;
+  }
+
+  // Can only read the rows straight into the batch if no mapping is needed
+  MetaCoordContainer *mcc = DBAdaptor_getMetaCoordContainer(bfa->dba);
+  Vector *featureCoordSystems = MetaCoordContainer_fetchAllCoordSystemsByFeatureType(mcc, tableName);
+  Vector *projVec = BaseFeatureAdaptor_getAndFilterSliceProjections(bfa, slice);
+  IDType seqRegionId = Slice_getSeqRegionId(slice);
+
+  int direct = seqRegionId && Vector_getNumElement(projVec) == 1 &&
+               !EcoString_strcmp(Slice_getName(ProjectionSegment_getToSlice((ProjectionSegment *)Vector_getElementAt(projVec, 0))),
+                                 Slice_getName(slice));
+  for (i=0; i<Vector_getNumElement(featureCoordSystems) && direct; i++) {
+    if (CoordSystem_compare(Vector_getElementAt(featureCoordSystems, i), Slice_getCoordSystem(slice))) {
+      direct = 0;
+    }
+  }
+  Vector_free(featureCoordSystems);
+  Vector_setFreeFunc(projVec, ProjectionSegment_free);
+  Vector_free(projVec);
+
+  if (!direct) {
+    Vector *features = BaseFeatureAdaptor_fetchAllBySliceConstraint(bfa, slice, constraint, logicName);
+
+    FeatureBatch_reserve(batch, Vector_getNumElement(features));
+    for (i=0; i<Vector_getNumElement(features); i++) {
+      SeqFeature *sf = Vector_getElementAt(features, i);
+      char *hitName = NULL;
+
+      if (Class_isDescendent(CLASS_FEATUREPAIR, sf->objectType)) {
+        hitName = FeaturePair_getHitSeqName((FeaturePair *)sf);
+      }
+      FeatureBatch_add(batch, SeqFeature_getDbID(sf), Slice_getSeqRegionId(SeqFeature_getSlice(sf)),
+                       SeqFeature_getStart(sf), SeqFeature_getEnd(sf), SeqFeature_getStrand(sf),
+                       SeqFeature_getScore(sf), SeqFeature_getAnalysis(sf) ? Analysis_getDbID(SeqFeature_getAnalysis(sf)) : 0,
+                       hitName, hitName ? strlen(hitName) : 0);
+    }
+
+    // Unless they went into the slice feature cache (which needs a seq region
+    // id for the key) the features are ours to free. Either way our reference
+    // to the vector is
+    if (DBAdaptor_noCache(bfa->dba) || DBAdaptor_getArena(bfa->dba) != NULL || Arena_getCurrent() != NULL ||
+        !seqRegionId) {
+      Vector_setFreeFunc(features, Object_freeImpl);
+    }
+    Vector_free(features);
+
+    StrBuf_free(allConstraint);
+    return batch;
+  }
+
+  char tmpStr[1024];
+  if (StrBuf_getLength(allConstraint)) {
+    StrBuf_append(allConstraint, " AND ");
+  }
+  StrBuf_appendf(allConstraint, "%s.seq_region_id = "IDFMTSTR" AND %s.seq_region_start <= %ld AND %s.seq_region_end >= %ld",
+                 tableSynonym, seqRegionId, tableSynonym, Slice_getEnd(slice), tableSynonym, Slice_getStart(slice));
+
+  long maxLen = BaseFeatureAdaptor_getMaxFeatureLength(bfa);
+  if (!maxLen) {
+    maxLen = MetaCoordContainer_fetchMaxLengthByCoordSystemFeatureType(mcc, Slice_getCoordSystem(slice), tableName);
+  }
+  if (maxLen) {
+    StrBuf_appendf(allConstraint, " AND %s.seq_region_start >= %ld", tableSynonym, Slice_getStart(slice) - maxLen);
+  }
+
+  // The first of the adaptor's columns is always its primary key. Score and
+  // hit name are only selected if the adaptor has them
+  char **adaptorColumns = bfa->getColumns();
+  char columnStrs[8][128];
+  char *columns[9];
+  int nColumn = 0;
+  int hasScore = 0;
+  int hasHitName = 0;
+
+  strcpy(columnStrs[nColumn++], adaptorColumns[0]);
+  sprintf(columnStrs[nColumn++], "%s.seq_region_id", tableSynonym);
+  sprintf(columnStrs[nColumn++], "%s.seq_region_start", tableSynonym);
+  sprintf(columnStrs[nColumn++], "%s.seq_region_end", tableSynonym);
+  sprintf(columnStrs[nColumn++], "%s.seq_region_strand", tableSynonym);
+  sprintf(columnStrs[nColumn++], "%s.analysis_id", tableSynonym);
+
+  sprintf(tmpStr, "%s.score", tableSynonym);
+  for (i=0; adaptorColumns[i] != NULL && !hasScore; i++) {
+    hasScore = !strcmp(adaptorColumns[i], tmpStr);
+  }
+  if (hasScore) {
+    strcpy(columnStrs[nColumn++], tmpStr);
+  }
+
+  sprintf(tmpStr, "%s.hit_name", tableSynonym);
+  for (i=0; adaptorColumns[i] != NULL && !hasHitName; i++) {
+    hasHitName = !strcmp(adaptorColumns[i], tmpStr);
+  }
+  if (hasHitName) {
+    strcpy(columnStrs[nColumn++], tmpStr);
+  }
+
+  for (i=0; i<nColumn; i++) {
+    columns[i] = columnStrs[i];
+  }
+  columns[nColumn] = NULL;
+
+  StrBuf *sql = StrBuf_new(STRBUF_DEFAULTSIZE + StrBuf_getLength(allConstraint));
+  BaseAdaptor_generateSql((BaseAdaptor *)bfa, StrBuf_getString(allConstraint), columns, sql);
+  char *qStr = StrBuf_getString(sql);
+
+  // The slice constraint is in the SQL so it only runs once - as in BaseAdaptor_genericFetch
+  // that stays on the text protocol rather than paying for a one off prepared statement
+  StatementHandle *sth = bfa->prepare((BaseAdaptor *)bfa, qStr, strlen(qStr));
+
+  sth->execute(sth);
+
+  FeatureBatch_reserve(batch, sth->numRows(sth));
+
+  long sliceStart  = Slice_getStart(slice);
+  long sliceEnd    = Slice_getEnd(slice);
+  int  sliceStrand = Slice_getStrand(slice);
+  long sliceLength = Slice_getLength(slice);
+
+  ResultRow *row;
+  while ((row = sth->fetchRow(sth))) {
+    IDType dbId     = row->getLongLongAt(row, 0);
+    IDType srId     = row->getLongLongAt(row, 1);
+    long start      = row->getLongAt(row, 2);
+    long end        = row->getLongAt(row, 3);
+    int strand      = row->getIntAt(row, 4);
+    IDType analysisId = row->getLongLongAt(row, 5);
+    double score    = hasScore ? row->getDoubleAt(row, 6) : 0.0;
+    char *hitName   = NULL;
+    unsigned long hitNameLen = 0;
+
+    if (hasHitName) {
+      hitName = row->getStringViewAt(row, hasScore ? 7 : 6, &hitNameLen);
+    }
+
+    // Into slice coordinates, as the objectsFromStatementHandle functions do
+    if (sliceStart != 1 || sliceStrand != 1) {
+      if (sliceStrand == 1) {
+        start = start - sliceStart + 1;
+        end   = end - sliceStart + 1;
+      } else {
+        long tmpStart = start;
+        start  = sliceEnd - end + 1;
+        end    = sliceEnd - tmpStart + 1;
+        strand = -strand;
+      }
+    }
+    if (end < 1 || start > sliceLength) {
+      continue;
+    }
+
+    FeatureBatch_add(batch, dbId, srId, start, end, strand, score, analysisId, hitName, hitNameLen);
+  }
+  sth->finish(sth);
+
+  StrBuf_free(sql);
+  StrBuf_free(allConstraint);
+
+  return batch;
+}
+
+/*
+=head2 fetchFeatureFromBatch
+
+  Arg [1]    : BaseFeatureAdaptor *bfa - the adaptor the batch was fetched with
+  Arg [2]    : FeatureBatch *batch
+  Arg [3]    : int ind - index of the feature in batch
+  Example    : SeqFeature *sf = BaseFeatureAdaptor_fetchFeatureFromBatch(dafa, batch, i);
+  Description: Makes the full feature object for one feature in a batch, on
+               the batch's slice. This is a query per feature, so is meant
+               for the few features a bulk job finds it's interested in.
+  Returntype : SeqFeature *, or NULL if the feature is no longer in the database
+  Exceptions : none
+  Caller     : general
+  Status     : At risk
+
+=cut
+*/
+SeqFeature *BaseFeatureAdaptor_fetchFeatureFromBatch(BaseFeatureAdaptor *bfa, FeatureBatch *batch, int ind) {
+  SeqFeature *sf = BaseAdaptor_fetchByDbID((BaseAdaptor *)bfa, FeatureBatch_getDbIDAt(batch, ind));
+
+  if (sf != NULL && FeatureBatch_getSlice(batch) != NULL && SeqFeature_getSlice(sf) != FeatureBatch_getSlice(batch)) {
+    SeqFeature *transferred = SeqFeature_transfer(sf, FeatureBatch_getSlice(batch));
+    if (transferred != sf) {
+      Object_free(sf);
+    }
+    sf = transferred;
+  }
+
+  return sf;
+}
+
+/*
+=head2 iterateBySlice
+
+  Arg [1]    : BaseFeatureAdaptor *bfa
+  Arg [2]    : Slice *slice - the slice to fetch features on
+  Arg [3]    : char *constraint - extra SQL constraint, or NULL
+  Arg [4]    : char *logicName - only features with this analysis, or NULL
+  Arg [5]    : BaseFeatureAdaptor_IterateFunc func - called with each feature
+  Arg [6]    : void *userData - passed on to func
+  Example    : long nFeature = BaseFeatureAdaptor_iterateBySlice(rfa, chrSlice, NULL, "repeatmask", addToCoverage, coverage);
+  Description: Streaming alternative to fetchAllBySliceConstraint for scans
+               too big to hold all at once, such as all the repeat or align
+               features on a chromosome. The same features are passed to func,
+               in slice coordinates, one at a time. func owns each feature it's
+               passed (Object_free it when done with it), and can return 0 to
+               stop the scan.
+               Rows are read from the server as they're used, through a second
+               connection (see DBAdaptor_getStreamConnection) so the object
+               making code can still look things up as it goes, and made into
+               features STREAM_WINDOW_ROWS at a time. So neither the whole
+               result set nor all its features are ever held. Features aren't
+               put in the slice feature cache, and streamed ones aren't made in
+               the DBAdaptor's arena.
+               Adaptors with their own prepare functions read all the rows of
+               each query in one go, as fetchAllBySliceConstraint does.
+  Returntype : long - the number of features passed to func
+  Exceptions : none
+  Caller     : general
+  Status     : At risk
+
+=cut
+*/
+long BaseFeatureAdaptor_iterateBySlice(BaseFeatureAdaptor *bfa, Slice *slice, char *constraint, char *logicName,
+                                       BaseFeatureAdaptor_IterateFunc func, void *userData) {
+  BaseFeatureAdaptorIterator iter;
+  StrBuf *allConstraint = StrBuf_new(STRBUF_DEFAULTSIZE);
+  int i;
+
+  if (constraint != NULL && *constraint != '\0') {
+    StrBuf_append(allConstraint, constraint);
+  }
+
+  if ( ! BaseFeatureAdaptor_logicNameToConstraint(bfa, allConstraint, logicName)) {
+    // If the logic name was invalid, there are no features
+    StrBuf_free(allConstraint);
+    return 0;
+  }
+
+  memset(&iter, 0, sizeof(BaseFeatureAdaptorIterator));
+  iter.func     = func;
+  iter.userData = userData;
+  iter.slice    = slice;
+
+  // As fetchAllBySliceConstraint, for the primary slice and all symlinked slices
+  Vector *projVec = BaseFeatureAdaptor_getAndFilterSliceProjections(bfa, slice);
+  iter.bounds = BaseFeatureAdaptor_generateFeatureBounds(bfa, slice, &iter.nBound);
+
+  for (i=0; i<Vector_getNumElement(projVec) && !iter.stopped; i++) {
+    ProjectionSegment *seg = Vector_getElementAt(projVec, i);
+    Slice *segSlice = ProjectionSegment_getToSlice(seg);
+
+    iter.offset    = ProjectionSegment_getFromStart(seg);
+    iter.symlinked = EcoString_strcmp(Slice_getName(segSlice), Slice_getName(slice)) != 0;
+
+    Vector *none = BaseFeatureAdaptor_getBySliceImpl(bfa, segSlice, StrBuf_getString(allConstraint), "fetch", &iter);
+    Vector_free(none);
+  }
+
+  Vector_setFreeFunc(projVec, ProjectionSegment_free);
+  Vector_free(projVec);
+  free(iter.bounds);
+  StrBuf_free(allConstraint);
+
+  return iter.nFeature;
+}
+
+/*
+ Applies the symlinked slice offset and boundary check to f, as
+ fetchAllBySliceConstraint does, and passes it on to the iterator's func.
+ Features func doesn't get are freed.
+*/
+static void BaseFeatureAdaptor_iterateFeature(BaseFeatureAdaptorIterator *iter, SeqFeature *f) {
+  if (iter->stopped) {
+    Object_free(f);
+    return;
+  }
+
+  if (iter->symlinked) {
+    int k;
+
+    if (iter->offset != 1) {
+      SeqFeature_setStart(f, (SeqFeature_getStart(f) + (iter->offset-1)));
+      SeqFeature_setEnd(f, (SeqFeature_getEnd(f) + (iter->offset-1)));
+    }
+
+    // discard boundary crossing features from symlinked regions
+    for (k=0; k<iter->nBound; k++) {
+      if (SeqFeature_getStart(f) < iter->bounds[k] && SeqFeature_getEnd(f) >= iter->bounds[k]) {
+        Object_free(f);
+        return;
+      }
+    }
+    SeqFeature_setSlice(f, iter->slice);
+  }
+
+  iter->nFeature++;
+  if (!iter->func(f, iter->userData)) {
+    iter->stopped = 1;
+  }
+}
+
+static ResultRow *BaseFeatureAdaptor_rowWindowFetchRow(StatementHandle *sth) {
+  BaseFeatureAdaptorRowWindow *window = (BaseFeatureAdaptorRowWindow *)sth;
+  ResultRow *row;
+
+  if (window->exhausted || window->nLeft <= 0) {
+    return NULL;
+  }
+
+  if ((row = window->inner->fetchRow(window->inner)) == NULL) {
+    window->exhausted = 1;
+    return NULL;
+  }
+  window->nLeft--;
+
+  return row;
+}
+
+static unsigned long long BaseFeatureAdaptor_rowWindowNumRows(StatementHandle *sth) {
+  BaseFeatureAdaptorRowWindow *window = (BaseFeatureAdaptorRowWindow *)sth;
+
+  return window->inner->numRows(window->inner);
+}
+
 /*
 =head2 _get_and_filter_Slice_projections
 
@@ -863,6 +1264,10 @@ typedef struct queryAccumDataStruct {
   Slice *slice;
 } QueryAccumData;
 
+static void BaseFeatureAdaptor_streamQuery(BaseFeatureAdaptor *bfa, QueryAccumData *qad, BaseFeatureAdaptorIterator *iter);
+static void BaseFeatureAdaptor_iterateFeatures(BaseFeatureAdaptor *bfa, Vector *features, QueryAccumData *qad,
+                                               BaseFeatureAdaptorIterator *iter);
+
 QueryAccumData *QueryAccumData_new(char *constraint, AssemblyMapper *mapper, Slice *slice) {
   QueryAccumData *qad;
   if ((qad = calloc(1,sizeof(QueryAccumData))) == NULL) {
@@ -883,6 +1288,15 @@ void QueryAccumData_free(QueryAccumData *qad) {
 }
 
 Vector *BaseFeatureAdaptor_getBySlice(BaseFeatureAdaptor *bfa, Slice *slice, char *origConstraint, char *queryType) {
+  return BaseFeatureAdaptor_getBySliceImpl(bfa, slice, origConstraint, queryType, NULL);
+}
+
+/*
+ getBySlice, which instead passes the features to iter (and returns an
+ empty Vector) if iter isn't NULL
+*/
+static Vector *BaseFeatureAdaptor_getBySliceImpl(BaseFeatureAdaptor *bfa, Slice *slice, char *origConstraint, char *queryType,
+                                                 BaseFeatureAdaptorIterator *iter) {
   // features can be scattered across multiple coordinate systems
   NameTableType *tables = bfa->getTables();
   char **primTab = (*tables)[0];
@@ -896,12 +1310,7 @@ Vector *BaseFeatureAdaptor_getBySlice(BaseFeatureAdaptor *bfa, Slice *slice, cha
 
   Vector *featureCoordSystems;
 
-  char *tmpStr = NULL;
-  if ((tmpStr = (char *)calloc(655500,sizeof(char))) == NULL) {
-    fprintf(stderr,"Failed allocating tmpStr\n");
-    return NULL;
-  }
-
+  char tmpStr[1024];
   sprintf(tmpStr, "%sbuild.level", tableName);  
   Vector *metaValues = MetaContainer_listValueByKey(metaContainer, tmpStr);
 
@@ -929,16 +1338,11 @@ Vector *BaseFeatureAdaptor_getBySlice(BaseFeatureAdaptor *bfa, Slice *slice, cha
     Vector *queryAccumulator = Vector_new();
 
     // Build up a combination of query constraints that will quickly establish the result set
-    char *constraint;
-    // Note allocated because stored in struct for later execution
-    if ((constraint = calloc(655500, sizeof(char))) == NULL) {
-      fprintf(stderr,"Failed allocating constraint\n");
-      return NULL;
-    }
+    // Note detached from the builder when it's stored in a QueryAccumData for later execution
+    StrBuf *constraint = StrBuf_new(STRBUF_DEFAULTSIZE);
 
-    constraint[0] = '\0';
     if (origConstraint) {
-      strcpy(constraint, origConstraint);
+      StrBuf_append(constraint, origConstraint);
     }
 
     if ( ! CoordSystem_compare(coordSystem, Slice_getCoordSystem(slice))) {
@@ -971,33 +1375,30 @@ Vector *BaseFeatureAdaptor_getBySlice(BaseFeatureAdaptor *bfa, Slice *slice, cha
 
       if (!seqRegionId) {
         fprintf(stderr, "Error getting sequence region ID for slice.");
+        StrBuf_free(constraint);
         continue;
       }
 
-      if (constraint[0]) {
-        strcat(constraint," AND ");
+      if (StrBuf_getLength(constraint)) {
+        StrBuf_append(constraint," AND ");
       }
 
-      sprintf(tmpStr, "%s.seq_region_id = "IDFMTSTR" AND ", tableSynonym, seqRegionId);
-      strcat(constraint, tmpStr);
+      StrBuf_appendf(constraint, "%s.seq_region_id = "IDFMTSTR" AND ", tableSynonym, seqRegionId);
 
       //faster query for 1bp slices where SNP data is not compressed
       if (BaseFeatureAdaptor_getStartEqualsEnd(bfa) && Slice_getStart(slice) == Slice_getEnd(slice)) {
-        sprintf(tmpStr, " AND %s.seq_region_start = %ld AND %s.seq_region_end = %ld",
-                tableSynonym, Slice_getEnd(slice), tableSynonym, Slice_getStart(slice));;
-        strcat(constraint, tmpStr);
+        StrBuf_appendf(constraint, " AND %s.seq_region_start = %ld AND %s.seq_region_end = %ld",
+                       tableSynonym, Slice_getEnd(slice), tableSynonym, Slice_getStart(slice));
       } else {
         //if ( !$slice->is_circular() ) 
           if (1) {
             // Deal with the default case of a non-circular chromosome.
-            sprintf(tmpStr,"%s.seq_region_start <= %ld AND %s.seq_region_end >= %ld", 
-                    tableSynonym, Slice_getEnd(slice), tableSynonym, Slice_getStart(slice));
-            strcat(constraint, tmpStr);
+            StrBuf_appendf(constraint, "%s.seq_region_start <= %ld AND %s.seq_region_end >= %ld", 
+                           tableSynonym, Slice_getEnd(slice), tableSynonym, Slice_getStart(slice));
             
             if (maxLen) {
               long minStart = Slice_getStart(slice) - maxLen;
-              sprintf(tmpStr," AND %s.seq_region_start >= %ld", tableSynonym, minStart);
-              strcat(constraint, tmpStr);
+              StrBuf_appendf(constraint, " AND %s.seq_region_start >= %ld", tableSynonym, minStart);
             }
           } else {
             /* Don't deal with circular - not supported in C implementation
@@ -1019,12 +1420,15 @@ Vector *BaseFeatureAdaptor_getBySlice(BaseFeatureAdaptor *bfa, Slice *slice, cha
           }
       }
 
-      Vector_addElement(queryAccumulator, QueryAccumData_new(constraint, NULL, slice));
+      Vector_addElement(queryAccumulator, QueryAccumData_new(StrBuf_detach(constraint), NULL, slice));
     } else { 
       //coordinate systems do not match
       mapper = AssemblyMapperAdaptor_fetchByCoordSystems(ama, Slice_getCoordSystem(slice), coordSystem);
 
-      if (mapper == NULL) continue;
+      if (mapper == NULL) {
+        StrBuf_free(constraint);
+        continue;
+      }
 
       // Get list of coordinates and corresponding internal ids for
       // regions the slice spans
@@ -1039,30 +1443,31 @@ Vector *BaseFeatureAdaptor_getBySlice(BaseFeatureAdaptor *bfa, Slice *slice, cha
       if ( ! MapperRangeSet_getNumRange(coords)) {
         // Do the 'next COORD_SYSTEM' with this flag
         doneCoordSystem = 1;
+        StrBuf_free(constraint);
 
       } else {
         if ( MapperRangeSet_getNumRange(coords) > MAX_SPLIT_QUERY_SEQ_REGIONS //&& ! $slice->isa('Bio::EnsEMBL::LRGSlice') 
                       && strcmp(Slice_getCoordSystemName(slice), "lrg")) {
 
 // Think this is already done above         $constraint = $orig_constraint;
-          if (constraint[0]) {
-            strcat(constraint, " AND ");
+          if (StrBuf_getLength(constraint)) {
+            StrBuf_append(constraint, " AND ");
           }
 
-          sprintf(tmpStr, "%s.seq_region_id IN (", tableSynonym);
+          StrBuf_append(constraint, tableSynonym);
+          StrBuf_append(constraint, ".seq_region_id IN (");
           int length = MapperRangeSet_getNumRange(coords);
           int j;
           for (j = 0; j < length; j++ ) {
             MapperCoordinate *coord = (MapperCoordinate *)MapperRangeSet_getRangeAt(coords, j);
             if (j!=0) {
-              strcat(tmpStr,", ");
+              StrBuf_append(constraint, ", ");
             }
-            sprintf(tmpStr,"%s"IDFMTSTR, tmpStr, coord->id);
+            StrBuf_appendID(constraint, coord->id);
           }
-          strcat(tmpStr, ")");
-          strcat(constraint, tmpStr);
+          StrBuf_appendChar(constraint, ')');
                   
-          Vector_addElement(queryAccumulator, QueryAccumData_new(constraint, mapper, slice));
+          Vector_addElement(queryAccumulator, QueryAccumData_new(StrBuf_detach(constraint), mapper, slice));
 
         } else if (strcmp(Slice_getCoordSystemName(slice), "lrg")) {
           long maxLen = BaseFeatureAdaptor_getMaxFeatureLength(bfa);
@@ -1070,43 +1475,36 @@ Vector *BaseFeatureAdaptor_getBySlice(BaseFeatureAdaptor *bfa, Slice *slice, cha
             maxLen = MetaCoordContainer_fetchMaxLengthByCoordSystemFeatureType(metaCoordContainer,  coordSystem, tableName);
           }
   
-          // Free constraint because its going to be reallocated each time through loop
-          free(constraint);
+          // Free constraint because there's a new one for each range
+          StrBuf_free(constraint);
 
           int length = MapperRangeSet_getNumRange(coords);
           int j;
           for (j = 0; j < length; j++ ) {
             MapperCoordinate *coord = (MapperCoordinate *)MapperRangeSet_getRangeAt(coords, j);
   
-            // Note allocated because stored in struct for later execution
-            if ((constraint = calloc(655500, sizeof(char))) == NULL) {
-              fprintf(stderr,"Failed allocating constraint\n");
-              return NULL;
-            }
-        
-            constraint[0] = '\0';
+            constraint = StrBuf_new(STRBUF_DEFAULTSIZE);
             if (origConstraint) {
-              strcpy(constraint, origConstraint);
+              StrBuf_append(constraint, origConstraint);
             }
 
-            if (constraint[0]) {
-              strcat(constraint, " AND ");
+            if (StrBuf_getLength(constraint)) {
+              StrBuf_append(constraint, " AND ");
             }
-            sprintf(tmpStr," %s.seq_region_id = "IDFMTSTR" AND %s.seq_region_start <= %ld AND %s.seq_region_end >= %ld",
-                    tableSynonym, coord->id, tableSynonym, coord->end, tableSynonym, coord->start);
-            strcat(constraint, tmpStr);
+            StrBuf_appendf(constraint, " %s.seq_region_id = "IDFMTSTR" AND %s.seq_region_start <= %ld AND %s.seq_region_end >= %ld",
+                           tableSynonym, coord->id, tableSynonym, coord->end, tableSynonym, coord->start);
   
             if (maxLen) {
               long minStart = coord->start - maxLen;
-              sprintf(tmpStr, " AND %s.seq_region_start >= %ld", tableSynonym, minStart);
-              strcat(constraint, tmpStr);
+              StrBuf_appendf(constraint, " AND %s.seq_region_start >= %ld", tableSynonym, minStart);
             }
                       
             /* queryaccumdata takes ownership of constraint here */
-            Vector_addElement(queryAccumulator, QueryAccumData_new(constraint, mapper, slice));
+            Vector_addElement(queryAccumulator, QueryAccumData_new(StrBuf_detach(constraint), mapper, slice));
           }
         } else { // LRG - ignore this stuff
           fprintf(stderr,"Ignoring lrg coord system\n");
+          StrBuf_free(constraint);
         }
       }
       // NIY: Free mapper range set
@@ -1129,6 +1527,9 @@ Vector *BaseFeatureAdaptor_getBySlice(BaseFeatureAdaptor *bfa, Slice *slice, cha
         *countP = count;
         Vector_addElement(panCoordFeatures, countP);
 
+      } else if (iter != NULL) {
+        BaseFeatureAdaptor_streamQuery(bfa, qad, iter);
+
       } else {
         Vector *features = BaseAdaptor_genericFetch((BaseAdaptor *)bfa, qad->constraint, qad->mapper,  qad->slice);
         //fprintf(stderr,"Here!!!!!!!!!!!!!!!!!! with %d features and %d pan coord features\n", Vector_getNumElement(features),  Vector_getNumElement(panCoordFeatures));
@@ -1153,9 +1554,106 @@ Vector *BaseFeatureAdaptor_getBySlice(BaseFeatureAdaptor *bfa, Slice *slice, cha
   }
   Vector_free(featureCoordSystems);
 
-  free(tmpStr);
   return panCoordFeatures;
 }
+
+/*
+ Runs qad's query for BaseFeatureAdaptor_iterateBySlice, reading the rows
+ from the server as they're made into features. objectsFromStatementHandle
+ is given STREAM_WINDOW_ROWS rows at a time through a BaseFeatureAdaptorRowWindow.
+*/
+static void BaseFeatureAdaptor_streamQuery(BaseFeatureAdaptor *bfa, QueryAccumData *qad, BaseFeatureAdaptorIterator *iter) {
+  StatementHandle *sth = NULL;
+  StrBuf *sql = NULL;
+
+  if (iter->stopped) {
+    return;
+  }
+
+  // Needs the standard prepare, as the query goes on the stream connection. It's
+  // prepared uncached as it runs once, but it's big enough that the binary
+  // protocol is worth the extra round trips. If it can't be prepared the
+  // features are fetched in one go instead.
+  DBConnection *streamDbc = NULL;
+  if (bfa->prepare == BaseAdaptor_prepare && bfa->dba) {
+    streamDbc = DBAdaptor_getStreamConnection(bfa->dba);
+  }
+  if (streamDbc != NULL) {
+    sql = StrBuf_new(STRBUF_DEFAULTSIZE + strlen(qad->constraint));
+    BaseAdaptor_generateSql((BaseAdaptor *)bfa, qad->constraint, NULL, sql);
+    sth = MysqlPreparedStatementHandle_new(streamDbc, StrBuf_getString(sql), StrBuf_getLength(sql), 0);
+  }
+
+  if (sth == NULL) {
+    Vector *features = BaseAdaptor_genericFetch((BaseAdaptor *)bfa, qad->constraint, qad->mapper, qad->slice);
+    BaseFeatureAdaptor_iterateFeatures(bfa, features, qad, iter);
+    if (sql) {
+      StrBuf_free(sql);
+    }
+    return;
+  }
+
+  sth->addFlag(sth, MYSQLFLAG_USE_RESULT);
+  sth->execute(sth);
+
+  // func owns and frees each feature, so they come from the heap even if the
+  // DBAdaptor has an arena - otherwise none would be released until the scan
+  // (or the arena's owner) was done, which is what streaming is to avoid
+  Arena *prevArena = Arena_setCurrent(NULL);
+
+  BaseFeatureAdaptorRowWindow window;
+  memset(&window, 0, sizeof(BaseFeatureAdaptorRowWindow));
+  window.objectType      = CLASS_STATEMENTHANDLE;
+  window.statementFormat = sth->statementFormat;
+  window.dbc             = sth->dbc;
+  window.fetchRow        = BaseFeatureAdaptor_rowWindowFetchRow;
+  window.numRows         = BaseFeatureAdaptor_rowWindowNumRows;
+  window.inner           = sth;
+
+  while (!window.exhausted && !iter->stopped) {
+    window.nLeft = STREAM_WINDOW_ROWS;
+
+    Vector *features = bfa->objectsFromStatementHandle((BaseAdaptor *)bfa, (StatementHandle *)&window, qad->mapper, qad->slice);
+    BaseFeatureAdaptor_iterateFeatures(bfa, features, qad, iter);
+  }
+
+  // Any rows left (if func stopped the scan) are thrown away
+  sth->finish(sth);
+
+  Arena_setCurrent(prevArena);
+
+  StrBuf_free(sql);
+}
+
+/*
+ Remaps a Vector of features from qad's query and passes them to iter. The
+ ones remap drops are freed, and so is the Vector.
+*/
+static void BaseFeatureAdaptor_iterateFeatures(BaseFeatureAdaptor *bfa, Vector *features, QueryAccumData *qad,
+                                               BaseFeatureAdaptorIterator *iter) {
+  Vector *remappedFeatures = BaseFeatureAdaptor_remap(bfa, features, qad->mapper, qad->slice);
+  int nRemapped = remappedFeatures ? Vector_getNumElement(remappedFeatures) : 0;
+  int i;
+  int j = 0;
+
+  // remap keeps the features it doesn't drop in order, so step through both
+  for (i=0; i<Vector_getNumElement(features); i++) {
+    SeqFeature *f = Vector_getElementAt(features, i);
+
+    if (j < nRemapped && Vector_getElementAt(remappedFeatures, j) == f) {
+      j++;
+      BaseFeatureAdaptor_iterateFeature(iter, f);
+    } else {
+      Object_free(f);
+    }
+  }
+
+  if (remappedFeatures != NULL && remappedFeatures != features) {
+    Vector_free(remappedFeatures);
+  }
+  Vector_setFreeFunc(features, NULL);
+  Vector_free(features);
+}
 /*
 #
 # helper function used by fetch_all_by_Slice_constraint method
@@ -1416,6 +1914,7 @@ Vector *BaseFeatureAdaptor_remap(BaseFeatureAdaptor *bfa, Vector *features, Asse
 
   IDType sliceSeqRegionId = Slice_getSeqRegionId(slice);
   char *sliceSeqRegion = Slice_getSeqRegionName(slice);
+  IDHash *missingIds = NULL;
 
   int nFeat = Vector_getNumElement(features);
 
@@ -1438,24 +1937,51 @@ Vector *BaseFeatureAdaptor_remap(BaseFeatureAdaptor *bfa, Vector *features, Asse
     if (CoordSystem_compare(sliceCs, fCs)) {
       // slice of feature in different coord system, mapping required
 
-      // Note my implementation of fastMap is different to perl, in that it returns a MapperRangeSet rather than a list specifying a single location
-      MapperRangeSet *mrs = AssemblyMapper_fastMap(mapper, fSeqRegion, SeqFeature_getStart(f), SeqFeature_getEnd(f), SeqFeature_getStrand(f), fCs, NULL);
+      if (mapper->objectType == CLASS_ASSEMBLYMAPPER) {
+        // Plain assembly mappers can map into a result without allocating anything, which adds up over lots of features
+        MapperResult result;
+        int mapped = AssemblyMapper_fastMapInto(mapper, fSeqRegion, SeqFeature_getStart(f), SeqFeature_getEnd(f), SeqFeature_getStrand(f), fCs, &result);
 
-      // empty set means gap
-      if (MapperRangeSet_getNumRange(mrs) == 0) {
-        MapperRangeSet_free(mrs);
-        continue;
-      }
+        if (mapped < 0) {
+          // Registered but not in the mapper - fastMap would exit, but these
+          // are just features which can't be placed, so warn once per seq region
+          if (missingIds == NULL) {
+            missingIds = IDHash_new(IDHASH_SMALL);
+          }
+          if (!IDHash_contains(missingIds, fSeqRegionId)) {
+            fprintf(stderr, "WARNING: Seq region %s (id " IDFMTSTR ") isn't in the assembly mapper - skipping its features\n",
+                    fSeqRegion, fSeqRegionId);
+            IDHash_add(missingIds, fSeqRegionId, &missingIds);
+          }
+        }
+        if (mapped <= 0) {
+          continue;
+        }
 
-      MapperCoordinate *mc = (MapperCoordinate *)MapperRangeSet_getRangeAt(mrs, 0);
-    
-      //seqRegion = mc->
-      seqRegionId = mc->id;
-      start       = mc->start;
-      end         = mc->end;
-      strand      = mc->strand;
+        seqRegionId = result.id;
+        start       = result.start;
+        end         = result.end;
+        strand      = result.strand;
+      } else {
+        // Note my implementation of fastMap is different to perl, in that it returns a MapperRangeSet rather than a list specifying a single location
+        MapperRangeSet *mrs = AssemblyMapper_fastMap(mapper, fSeqRegion, SeqFeature_getStart(f), SeqFeature_getEnd(f), SeqFeature_getStrand(f), fCs, NULL);
 
-      MapperRangeSet_free(mrs);
+        // empty set means gap
+        if (MapperRangeSet_getNumRange(mrs) == 0) {
+          MapperRangeSet_free(mrs);
+          continue;
+        }
+
+        MapperCoordinate *mc = (MapperCoordinate *)MapperRangeSet_getRangeAt(mrs, 0);
+      
+        //seqRegion = mc->
+        seqRegionId = mc->id;
+        start       = mc->start;
+        end         = mc->end;
+        strand      = mc->strand;
+
+        MapperRangeSet_free(mrs);
+      }
     } else {
       start       = SeqFeature_getStart(f);
       end         = SeqFeature_getEnd(f);
@@ -1488,6 +2014,10 @@ Vector *BaseFeatureAdaptor_remap(BaseFeatureAdaptor *bfa, Vector *features, Asse
     Vector_addElement(out, f);
   }
 
+  if (missingIds != NULL) {
+    IDHash_free(missingIds, NULL);
+  }
+
   return out;
 }
 
@@ -1500,7 +2030,7 @@ Vector *BaseFeatureAdaptor_remap(BaseFeatureAdaptor *bfa, Vector *features, Asse
 # constraint is added at all
 #
 */
-char *BaseFeatureAdaptor_logicNameToConstraint(BaseFeatureAdaptor *bfa, char *constraint, char *logicName) {
+StrBuf *BaseFeatureAdaptor_logicNameToConstraint(BaseFeatureAdaptor *bfa, StrBuf *constraint, char *logicName) {
 
   if (logicName == NULL) {
     return constraint;
@@ -1556,12 +2086,10 @@ char *BaseFeatureAdaptor_logicNameToConstraint(BaseFeatureAdaptor *bfa, char *co
 
   IDType anId = Analysis_getDbID(an);
 
-  if (constraint[0]) {
-    strcat(constraint, " AND");
+  if (StrBuf_getLength(constraint)) {
+    StrBuf_append(constraint, " AND");
   }
-  char tmpStr[1024];
-  sprintf(tmpStr, " %s.analysis_id = "IDFMTSTR, primSynonym, anId);
-  strcat(constraint, tmpStr);
+  StrBuf_appendf(constraint, " %s.analysis_id = "IDFMTSTR, primSynonym, anId);
 
   return constraint;
 }
@@ -23,9 +23,10 @@
 #include "Vector.h"
 #include "RawContig.h"
 #include "StatementHandle.h"
-#include "Cache.h"
+#include "FeatureCache.h"
 #include "Slice.h"
 #include "AssemblyMapper.h"
+#include "FeatureBatch.h"
 
 //typedef char * NameTableType[][2];
 
@@ -37,11 +38,13 @@ typedef Vector *    (*BaseFeatureAdaptor_ObjectsFromStatementHandleFunc)(BaseFea
 typedef char *   (*BaseFeatureAdaptor_FinalClauseFunc)(void);
 typedef char *   (*BaseFeatureAdaptor_DefaultWhereClauseFunc)(void);
 typedef char **  (*BaseFeatureAdaptor_LeftJoinFunc)(void);
+// Called for each feature by BaseFeatureAdaptor_iterateBySlice - return 0 to stop
+typedef int      (*BaseFeatureAdaptor_IterateFunc)(SeqFeature *feature, void *userData);
 
 
 #define BASEFEATUREADAPTOR_DATA \
   BASEADAPTOR_DATA \
-  Cache *sliceFeatureCache; \
+  FeatureCache *sliceFeatureCache; \
   int startEqualsEnd; \
   long maxFeatureLen;
 /*
@@ -85,13 +88,17 @@ Vector *BaseFeatureAdaptor_fetchAllBySliceAndScore(BaseFeatureAdaptor *bfa, Slic
 Vector *BaseFeatureAdaptor_fetchAllBySliceConstraint(BaseFeatureAdaptor *bfa, Slice *slice, char *constraint, char *logicName);
 Vector *BaseFeatureAdaptor_fetchAllByLogicName(BaseFeatureAdaptor *bfa, char *logicName);
 Vector *BaseFeatureAdaptor_fetchAllByStableIdList(BaseFeatureAdaptor *bfa, Vector *ids, Slice *slice);
+FeatureBatch *BaseFeatureAdaptor_fetchBatchBySlice(BaseFeatureAdaptor *bfa, Slice *slice, char *constraint, char *logicName);
+SeqFeature *BaseFeatureAdaptor_fetchFeatureFromBatch(BaseFeatureAdaptor *bfa, FeatureBatch *batch, int ind);
+long BaseFeatureAdaptor_iterateBySlice(BaseFeatureAdaptor *bfa, Slice *slice, char *constraint, char *logicName,
+                                       BaseFeatureAdaptor_IterateFunc func, void *userData);
 int BaseFeatureAdaptor_countBySliceConstraint(BaseFeatureAdaptor *bfa, Slice *slice, char *constraint, char *logicName);
 Vector *BaseFeatureAdaptor_getAndFilterSliceProjections(BaseFeatureAdaptor *bfa, Slice *slice);
 long *BaseFeatureAdaptor_generateFeatureBounds(BaseFeatureAdaptor *bfa, Slice *slice, int *nBound);
 Vector *BaseFeatureAdaptor_getBySlice(BaseFeatureAdaptor *bfa, Slice *slice, char *origConstraint, char *queryType);
 Vector *BaseFeatureAdaptor_sliceFetch(BaseFeatureAdaptor *bfa, Slice *slice, char *origConstraint);
 Vector *BaseFeatureAdaptor_remap(BaseFeatureAdaptor *bfa, Vector *features, AssemblyMapper *mapper, Slice *slice);
-char *BaseFeatureAdaptor_logicNameToConstraint(BaseFeatureAdaptor *bfa, char *constraint, char *logicName);
+StrBuf *BaseFeatureAdaptor_logicNameToConstraint(BaseFeatureAdaptor *bfa, StrBuf *constraint, char *logicName);
 Vector *BaseFeatureAdaptor_listSeqRegionIds(BaseFeatureAdaptor *bfa, char *table);
 IDType BaseFeatureAdaptor_preStore(BaseFeatureAdaptor *bfa, SeqFeature *feature);
 
@@ -0,0 +1,495 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BatchInsertWriter.h"
+#include "DBConnection.h"
+#include "StatementHandle.h"
+#include "ResultRow.h"
+#include "StrUtil.h"
+
+#include <string.h>
+#include <mysql.h>
+
+static void BatchInsertWriter_append(BatchInsertWriter *biw, char *str, size_t len);
+static void BatchInsertWriter_reserve(BatchInsertWriter *biw, size_t extra);
+static void BatchInsertWriter_startValue(BatchInsertWriter *biw);
+static void BatchInsertWriter_writeStatement(BatchInsertWriter *biw, char *valuesBuf, size_t valuesLen, int nRow);
+static int  BatchInsertWriter_getConsecutiveIdIncrement(BatchInsertWriter *biw);
+static long BatchInsertWriter_fetchAutoIncInfo(BatchInsertWriter *biw);
+
+
+BatchInsertWriter *BatchInsertWriter_new(DBAdaptor *dba, char *tableName, char **columns, int batchSize) {
+  BatchInsertWriter *biw;
+
+  if ((biw = (BatchInsertWriter *)calloc(1,sizeof(BatchInsertWriter))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating BatchInsertWriter\n");
+    exit(1);
+  }
+
+  biw->dba = dba;
+  StrUtil_copyString(&(biw->tableName), tableName, 0);
+
+  while (columns[biw->nColumn] != NULL) {
+    biw->nColumn++;
+  }
+  if ((biw->columns = (char **)calloc(biw->nColumn, sizeof(char *))) == NULL ||
+      (biw->isUnixTime = (int *)calloc(biw->nColumn, sizeof(int))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating BatchInsertWriter columns\n");
+    exit(1);
+  }
+  int i;
+  for (i=0; i<biw->nColumn; i++) {
+    StrUtil_copyString(&(biw->columns[i]), columns[i], 0);
+  }
+
+  if (batchSize <= 0) {
+    batchSize = DBAdaptor_getInsertBatchSize(dba);
+  }
+  if (batchSize <= 0) {
+    batchSize = BATCHINSERT_DEFAULTBATCHSIZE;
+  }
+  biw->batchSize = batchSize;
+  biw->mode = BATCHINSERT_VALUES;
+  biw->curCol = -1;
+
+  return biw;
+}
+
+void BatchInsertWriter_setMode(BatchInsertWriter *biw, BatchInsertMode mode) {
+  if (biw->nRow) {
+    BatchInsertWriter_flush(biw);
+  }
+  biw->mode = mode;
+}
+
+// Values for this column are given as seconds since the epoch and stored with FROM_UNIXTIME
+void BatchInsertWriter_setUnixTimeColumn(BatchInsertWriter *biw, int colInd) {
+  if (colInd < 0 || colInd >= biw->nColumn) {
+    fprintf(stderr,"ERROR: Column index %d out of range for BatchInsertWriter on %s\n", colInd, biw->tableName);
+    exit(1);
+  }
+  biw->isUnixTime[colInd] = 1;
+}
+
+static void BatchInsertWriter_reserve(BatchInsertWriter *biw, size_t extra) {
+  if (biw->bufLen + extra + 1 > biw->bufAlloc) {
+    size_t newAlloc = biw->bufAlloc ? biw->bufAlloc : 4096;
+    while (newAlloc < biw->bufLen + extra + 1) {
+      newAlloc *= 2;
+    }
+    if ((biw->buf = (char *)realloc(biw->buf, newAlloc)) == NULL) {
+      fprintf(stderr,"ERROR: Failed allocating BatchInsertWriter buffer of size %lu\n", (unsigned long)newAlloc);
+      exit(1);
+    }
+    biw->bufAlloc = newAlloc;
+  }
+}
+
+static void BatchInsertWriter_append(BatchInsertWriter *biw, char *str, size_t len) {
+  BatchInsertWriter_reserve(biw, len);
+  memcpy(&(biw->buf[biw->bufLen]), str, len);
+  biw->bufLen += len;
+  biw->buf[biw->bufLen] = '\0';
+}
+
+void BatchInsertWriter_startRow(BatchInsertWriter *biw) {
+  if (biw->curCol != -1) {
+    fprintf(stderr,"ERROR: startRow called before previous row ended in BatchInsertWriter on %s\n", biw->tableName);
+    exit(1);
+  }
+
+  if (biw->mode == BATCHINSERT_VALUES) {
+    if (biw->nRow) {
+      BatchInsertWriter_append(biw, ",", 1);
+    }
+    biw->curRowStart = biw->bufLen;
+    BatchInsertWriter_append(biw, "(", 1);
+  } else {
+    biw->curRowStart = biw->bufLen;
+  }
+  biw->curCol = 0;
+}
+
+static void BatchInsertWriter_startValue(BatchInsertWriter *biw) {
+  if (biw->curCol < 0 || biw->curCol >= biw->nColumn) {
+    fprintf(stderr,"ERROR: Too many values (or no startRow) for BatchInsertWriter on %s\n", biw->tableName);
+    exit(1);
+  }
+
+  if (biw->curCol > 0) {
+    if (biw->mode == BATCHINSERT_VALUES) {
+      BatchInsertWriter_append(biw, ",", 1);
+    } else {
+      BatchInsertWriter_append(biw, "\t", 1);
+    }
+  }
+}
+
+static void BatchInsertWriter_addNumberString(BatchInsertWriter *biw, char *numStr, int len) {
+  BatchInsertWriter_startValue(biw);
+
+  if (biw->isUnixTime[biw->curCol] && biw->mode == BATCHINSERT_VALUES) {
+    BatchInsertWriter_append(biw, "FROM_UNIXTIME(", 14);
+    BatchInsertWriter_append(biw, numStr, len);
+    BatchInsertWriter_append(biw, ")", 1);
+  } else {
+    BatchInsertWriter_append(biw, numStr, len);
+  }
+  biw->curCol++;
+}
+
+void BatchInsertWriter_addInt(BatchInsertWriter *biw, int val) {
+  char numStr[64];
+  int len = sprintf(numStr, "%d", val);
+
+  BatchInsertWriter_addNumberString(biw, numStr, len);
+}
+
+void BatchInsertWriter_addLong(BatchInsertWriter *biw, long val) {
+  char numStr[64];
+  int len = sprintf(numStr, "%ld", val);
+
+  BatchInsertWriter_addNumberString(biw, numStr, len);
+}
+
+void BatchInsertWriter_addLongLong(BatchInsertWriter *biw, IDType val) {
+  char numStr[64];
+  int len = sprintf(numStr, IDFMTSTR, val);
+
+  BatchInsertWriter_addNumberString(biw, numStr, len);
+}
+
+void BatchInsertWriter_addDouble(BatchInsertWriter *biw, double val) {
+  char numStr[64];
+  // %.15g keeps small values such as evalues which %f would round to 0
+  int len = sprintf(numStr, "%.15g", val);
+
+  BatchInsertWriter_addNumberString(biw, numStr, len);
+}
+
+void BatchInsertWriter_addString(BatchInsertWriter *biw, char *val) {
+  if (val == NULL) {
+    BatchInsertWriter_addNull(biw);
+    return;
+  }
+
+  BatchInsertWriter_startValue(biw);
+
+  size_t len = strlen(val);
+
+  if (biw->mode == BATCHINSERT_VALUES) {
+    BatchInsertWriter_reserve(biw, len*2 + 2);
+    biw->buf[biw->bufLen++] = '\'';
+    biw->bufLen += mysql_real_escape_string(biw->dba->dbc->mysql, &(biw->buf[biw->bufLen]), val, len);
+    biw->buf[biw->bufLen++] = '\'';
+    biw->buf[biw->bufLen] = '\0';
+  } else {
+    // LOAD DATA default escaping - tab, newline, NUL and the escape character itself
+    BatchInsertWriter_reserve(biw, len*2);
+    size_t i;
+    for (i=0; i<len; i++) {
+      switch (val[i]) {
+        case '\\':
+          biw->buf[biw->bufLen++] = '\\';
+          biw->buf[biw->bufLen++] = '\\';
+          break;
+        case '\t':
+          biw->buf[biw->bufLen++] = '\\';
+          biw->buf[biw->bufLen++] = 't';
+          break;
+        case '\n':
+          biw->buf[biw->bufLen++] = '\\';
+          biw->buf[biw->bufLen++] = 'n';
+          break;
+        case '\0':
+          biw->buf[biw->bufLen++] = '\\';
+          biw->buf[biw->bufLen++] = '0';
+          break;
+        default:
+          biw->buf[biw->bufLen++] = val[i];
+      }
+    }
+    biw->buf[biw->bufLen] = '\0';
+  }
+  biw->curCol++;
+}
+
+void BatchInsertWriter_addNull(BatchInsertWriter *biw) {
+  BatchInsertWriter_startValue(biw);
+
+  if (biw->mode == BATCHINSERT_VALUES) {
+    BatchInsertWriter_append(biw, "NULL", 4);
+  } else {
+    BatchInsertWriter_append(biw, "\\N", 2);
+  }
+  biw->curCol++;
+}
+
+/*
+  obj and setDbID may be NULL for tables without an auto_increment key (or
+  where the caller doesn't need the ids).
+*/
+void BatchInsertWriter_endRow(BatchInsertWriter *biw, void *obj, BatchInsertWriter_SetDbIDFunc setDbID) {
+  if (biw->curCol != biw->nColumn) {
+    fprintf(stderr,"ERROR: Row has %d values but BatchInsertWriter on %s has %d columns\n",
+            biw->curCol, biw->tableName, biw->nColumn);
+    exit(1);
+  }
+
+  if (biw->mode == BATCHINSERT_VALUES) {
+    BatchInsertWriter_append(biw, ")", 1);
+  } else {
+    BatchInsertWriter_append(biw, "\n", 1);
+  }
+
+  if (biw->nRow == biw->nRowAlloced) {
+    biw->nRowAlloced = biw->nRowAlloced ? biw->nRowAlloced * 2 : 64;
+    if ((biw->rowObjs = (void **)realloc(biw->rowObjs, biw->nRowAlloced * sizeof(void *))) == NULL ||
+        (biw->rowSetDbIDs = (BatchInsertWriter_SetDbIDFunc *)realloc(biw->rowSetDbIDs,
+                                      biw->nRowAlloced * sizeof(BatchInsertWriter_SetDbIDFunc))) == NULL ||
+        (biw->rowStarts = (size_t *)realloc(biw->rowStarts, biw->nRowAlloced * sizeof(size_t))) == NULL ||
+        (biw->rowEnds = (size_t *)realloc(biw->rowEnds, biw->nRowAlloced * sizeof(size_t))) == NULL) {
+      fprintf(stderr,"ERROR: Failed allocating BatchInsertWriter row arrays\n");
+      exit(1);
+    }
+  }
+  biw->rowObjs[biw->nRow]     = obj;
+  biw->rowSetDbIDs[biw->nRow] = setDbID;
+  // Row boundaries are kept so flush can write rows singly without re-parsing the values
+  biw->rowStarts[biw->nRow]   = biw->curRowStart;
+  biw->rowEnds[biw->nRow]     = biw->bufLen;
+  if (setDbID) {
+    biw->needIds = 1;
+  }
+
+  biw->nRow++;
+  biw->curCol = -1;
+
+  if (biw->nRow >= biw->batchSize || biw->bufLen >= BATCHINSERT_MAXBUFFERSIZE) {
+    BatchInsertWriter_flush(biw);
+  }
+}
+
+/*
+  Returns the auto_increment_increment to step ids by if a single multi-row
+  statement on this table in biw's mode is guaranteed to get consecutive ids,
+  or 0 if not. What the server allows is cached per table on the connection:
+  the increment if any multi-row statement gets consecutive ids, minus it if
+  only multi-row INSERT ... VALUES does, or 0 if none do.
+*/
+static int BatchInsertWriter_getConsecutiveIdIncrement(BatchInsertWriter *biw) {
+  DBConnection *dbc = biw->dba->dbc;
+  long *cachedVal;
+  long increment;
+
+  if (dbc->autoIncInfoCache == NULL) {
+    dbc->autoIncInfoCache = StringHash_new(STRINGHASH_SMALL);
+  }
+  if ((cachedVal = StringHash_getValue(dbc->autoIncInfoCache, biw->tableName)) != NULL) {
+    increment = *cachedVal;
+  } else {
+    increment = BatchInsertWriter_fetchAutoIncInfo(biw);
+    StringHash_add(dbc->autoIncInfoCache, biw->tableName, long_new(increment));
+  }
+
+  if (increment < 0) {
+    return biw->mode == BATCHINSERT_LOADDATA ? 0 : (int)-increment;
+  }
+  return (int)increment;
+}
+
+/*
+  Asks the server what getConsecutiveIdIncrement caches for biw's table
+*/
+static long BatchInsertWriter_fetchAutoIncInfo(BatchInsertWriter *biw) {
+  DBConnection *dbc = biw->dba->dbc;
+  long increment = 1;
+  char *engine = NULL;
+  ResultRow *row;
+  char qStr[1024];
+
+  strcpy(qStr, "SELECT @@auto_increment_increment");
+  StatementHandle *sth = dbc->prepare(dbc, qStr, strlen(qStr));
+  sth->execute(sth);
+  if ((row = sth->fetchRow(sth))) {
+    increment = row->getLongAt(row, 0);
+  }
+  sth->finish(sth);
+
+  sprintf(qStr, "SELECT ENGINE FROM information_schema.TABLES "
+                "WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = '%s'", biw->tableName);
+  sth = dbc->prepare(dbc, qStr, strlen(qStr));
+  sth->execute(sth);
+  if ((row = sth->fetchRow(sth))) {
+    engine = row->getStringCopyAt(row, 0);
+  }
+  sth->finish(sth);
+
+  if (engine == NULL) {
+    // No such table (or it's a view) - nothing to go on, so take the safe route and let the insert report any error
+    fprintf(stderr, "Warning: Couldn't find the engine for table %s - rows needing ids will be inserted one at a time\n",
+            biw->tableName);
+    return 0;
+  }
+
+  // InnoDB gives a multi-row INSERT ... VALUES (a "simple insert") consecutive
+  // ids in every lock mode, but in "interleaved" mode (2, the MySQL 8 default)
+  // bulk inserts such as LOAD DATA can get gaps when other sessions are inserting
+  if (!strcasecmp(engine, "InnoDB")) {
+    strcpy(qStr, "SELECT @@innodb_autoinc_lock_mode");
+    sth = dbc->prepare(dbc, qStr, strlen(qStr));
+    sth->execute(sth);
+    if ((row = sth->fetchRow(sth)) == NULL || row->getIntAt(row, 0) >= 2) {
+      increment = -increment;
+    }
+    sth->finish(sth);
+  }
+
+  free(engine);
+
+  return increment;
+}
+
+static void BatchInsertWriter_writeStatement(BatchInsertWriter *biw, char *valuesBuf, size_t valuesLen, int nRow) {
+  DBConnection *dbc = biw->dba->dbc;
+  unsigned long long nAffected = 0;
+  char *qStr;
+  size_t headerLen = strlen(biw->tableName) + 128;
+  int i;
+
+  for (i=0; i<biw->nColumn; i++) {
+    headerLen += strlen(biw->columns[i])*3 + 32;
+  }
+
+  if (biw->mode == BATCHINSERT_VALUES) {
+    if ((qStr = (char *)malloc(headerLen + valuesLen + 1)) == NULL) {
+      fprintf(stderr,"ERROR: Failed allocating BatchInsertWriter statement\n");
+      exit(1);
+    }
+    size_t len = sprintf(qStr, "INSERT INTO %s (", biw->tableName);
+    for (i=0; i<biw->nColumn; i++) {
+      len += sprintf(&(qStr[len]), "%s%s", i ? "," : "", biw->columns[i]);
+    }
+    len += sprintf(&(qStr[len]), ") VALUES ");
+    memcpy(&(qStr[len]), valuesBuf, valuesLen);
+    len += valuesLen;
+    qStr[len] = '\0';
+
+    if (!DBConnection_do(dbc, qStr, len, &nAffected)) {
+      fprintf(stderr, "Failed writing batch of %d rows to %s\n", nRow, biw->tableName);
+      exit(1);
+    }
+  } else {
+    if ((qStr = (char *)malloc(headerLen*2)) == NULL) {
+      fprintf(stderr,"ERROR: Failed allocating BatchInsertWriter statement\n");
+      exit(1);
+    }
+    size_t len = sprintf(qStr, "LOAD DATA LOCAL INFILE 'ensc_batch_insert' INTO TABLE %s (", biw->tableName);
+    for (i=0; i<biw->nColumn; i++) {
+      len += sprintf(&(qStr[len]), "%s%s%s", i ? "," : "", biw->isUnixTime[i] ? "@" : "", biw->columns[i]);
+    }
+    len += sprintf(&(qStr[len]), ")");
+    int nSet = 0;
+    for (i=0; i<biw->nColumn; i++) {
+      if (biw->isUnixTime[i]) {
+        len += sprintf(&(qStr[len]), "%s%s = FROM_UNIXTIME(@%s)", nSet ? ", " : " SET ",
+                       biw->columns[i], biw->columns[i]);
+        nSet++;
+      }
+    }
+
+    DBConnection_setLocalInfileBuffer(dbc, valuesBuf, valuesLen);
+    if (!DBConnection_do(dbc, qStr, len, &nAffected)) {
+      DBConnection_setLocalInfileBuffer(dbc, NULL, 0);
+      fprintf(stderr, "Failed loading batch of %d rows into %s\n", nRow, biw->tableName);
+      exit(1);
+    }
+  }
+  free(qStr);
+
+  // LOAD DATA LOCAL turns errors (eg. duplicate keys) into warnings, so check every row went in
+  if (nAffected != (unsigned long long)nRow) {
+    fprintf(stderr, "Error: Expected to write %d rows to %s but %llu were written\n", nRow, biw->tableName, nAffected);
+    exit(1);
+  }
+
+  biw->nWritten += nAffected;
+}
+
+void BatchInsertWriter_flush(BatchInsertWriter *biw) {
+  int i;
+
+  if (biw->curCol != -1) {
+    fprintf(stderr,"ERROR: flush called part way through a row in BatchInsertWriter on %s\n", biw->tableName);
+    exit(1);
+  }
+
+  if (biw->nRow == 0) {
+    return;
+  }
+
+  int increment = 1;
+  if (biw->needIds && biw->nRow > 1) {
+    increment = BatchInsertWriter_getConsecutiveIdIncrement(biw);
+  }
+
+  if (increment == 0) {
+    // Ids can't be derived from a multi-row statement so write each row on its own
+    for (i=0; i<biw->nRow; i++) {
+      BatchInsertWriter_writeStatement(biw, &(biw->buf[biw->rowStarts[i]]), biw->rowEnds[i] - biw->rowStarts[i], 1);
+      if (biw->rowSetDbIDs[i]) {
+        biw->rowSetDbIDs[i](biw->rowObjs[i], (IDType)mysql_insert_id(biw->dba->dbc->mysql));
+      }
+    }
+  } else {
+    BatchInsertWriter_writeStatement(biw, biw->buf, biw->bufLen, biw->nRow);
+
+    if (biw->needIds) {
+      // For a multi-row statement the insert id is the id of the first row
+      IDType firstId = (IDType)mysql_insert_id(biw->dba->dbc->mysql);
+      for (i=0; i<biw->nRow; i++) {
+        if (biw->rowSetDbIDs[i]) {
+          biw->rowSetDbIDs[i](biw->rowObjs[i], firstId + (IDType)i * increment);
+        }
+      }
+    }
+  }
+
+  biw->nRow    = 0;
+  biw->bufLen  = 0;
+  biw->needIds = 0;
+}
+
+void BatchInsertWriter_free(BatchInsertWriter *biw) {
+  int i;
+
+  BatchInsertWriter_flush(biw);
+
+  for (i=0; i<biw->nColumn; i++) {
+    free(biw->columns[i]);
+  }
+  free(biw->columns);
+  free(biw->isUnixTime);
+  free(biw->tableName);
+
+  if (biw->buf)         free(biw->buf);
+  if (biw->rowObjs)     free(biw->rowObjs);
+  if (biw->rowSetDbIDs) free(biw->rowSetDbIDs);
+  if (biw->rowStarts)   free(biw->rowStarts);
+  if (biw->rowEnds)     free(biw->rowEnds);
+
+  free(biw);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BATCHINSERTWRITER_H__
+#define __BATCHINSERTWRITER_H__
+
+#include "AdaptorTypes.h"
+#include "DBAdaptor.h"
+#include "EnsC.h"
+
+/*
+ Accumulates rows for a single table and writes them with one round trip per
+ batch, either as a multi-row INSERT ... VALUES (...),(...) statement or as a
+ LOAD DATA LOCAL INFILE streamed from an in-memory buffer.
+
+ Usage:
+   BatchInsertWriter *biw = BatchInsertWriter_new(dba, "exon", cols, 0);
+   for each object {
+     BatchInsertWriter_startRow(biw);
+     BatchInsertWriter_addLongLong(biw, seqRegionId);
+     ...
+     BatchInsertWriter_endRow(biw, obj, setDbIDFunc);
+   }
+   BatchInsertWriter_free(biw); // flushes any remaining rows
+
+ For tables with an auto_increment primary key the setDbID callback is called
+ with each row's new dbID when its batch is flushed. The ids are calculated
+ from the first insert id of the batch, so multi-row batches are only used
+ where the server hands out consecutive ids for a single statement. That's
+ always true for INSERT ... VALUES, but LOAD DATA on InnoDB needs
+ innodb_autoinc_lock_mode < 2. Otherwise rows which need ids are written one
+ per statement.
+*/
+
+typedef enum BatchInsertModeEnum {
+  BATCHINSERT_VALUES,
+  BATCHINSERT_LOADDATA
+} BatchInsertMode;
+
+#define BATCHINSERT_DEFAULTBATCHSIZE 1000
+
+// Flush early if the statement gets this big, to stay well under max_allowed_packet
+#define BATCHINSERT_MAXBUFFERSIZE (1<<20)
+
+typedef void (*BatchInsertWriter_SetDbIDFunc)(void *obj, IDType dbID);
+
+typedef struct BatchInsertWriterStruct {
+  DBAdaptor *dba;
+  char *tableName;
+  char **columns;
+  int nColumn;
+  int *isUnixTime;
+  BatchInsertMode mode;
+  int batchSize;
+
+  int nRow;
+  int curCol;
+  char *buf;
+  size_t bufLen;
+  size_t bufAlloc;
+
+  size_t curRowStart;
+
+  void **rowObjs;
+  BatchInsertWriter_SetDbIDFunc *rowSetDbIDs;
+  size_t *rowStarts;
+  size_t *rowEnds;
+  int nRowAlloced;
+  int needIds;
+
+  unsigned long long nWritten;
+} BatchInsertWriter;
+
+BatchInsertWriter *BatchInsertWriter_new(DBAdaptor *dba, char *tableName, char **columns, int batchSize);
+void BatchInsertWriter_setMode(BatchInsertWriter *biw, BatchInsertMode mode);
+void BatchInsertWriter_setUnixTimeColumn(BatchInsertWriter *biw, int colInd);
+
+void BatchInsertWriter_startRow(BatchInsertWriter *biw);
+void BatchInsertWriter_addInt(BatchInsertWriter *biw, int val);
+void BatchInsertWriter_addLong(BatchInsertWriter *biw, long val);
+void BatchInsertWriter_addLongLong(BatchInsertWriter *biw, IDType val);
+void BatchInsertWriter_addDouble(BatchInsertWriter *biw, double val);
+void BatchInsertWriter_addString(BatchInsertWriter *biw, char *val);
+void BatchInsertWriter_addNull(BatchInsertWriter *biw);
+void BatchInsertWriter_endRow(BatchInsertWriter *biw, void *obj, BatchInsertWriter_SetDbIDFunc setDbID);
+
+void BatchInsertWriter_flush(BatchInsertWriter *biw);
+void BatchInsertWriter_free(BatchInsertWriter *biw);
+
+#define BatchInsertWriter_getNumWritten(biw) (biw)->nWritten
+#define BatchInsertWriter_getBatchSize(biw) (biw)->batchSize
+
+#endif
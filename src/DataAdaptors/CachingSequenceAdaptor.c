@@ -24,6 +24,8 @@
 #include "StrUtil.h"
 #include "LRUCache.h"
 
+#include <limits.h>
+
 
 /*
 =head1 DESCRIPTION
@@ -31,7 +33,9 @@
 An adaptor for the retrieval of DNA sequence from a string 
 */
 
-static long const CACHING_SEQ_CACHE_SZ  = 20; // Number of seq region sequences to cache
+// Whole seq region sequences are cached, so the limit is just the DBAdaptor's cache budget
+static int const CACHING_SEQ_CACHE_MAX = INT_MAX;
+static double const CACHING_SEQ_COST   = 1000.0; // Refetching means getting the whole seq region
 
 /*
 =head2 new
@@ -57,7 +61,19 @@ CachingSequenceAdaptor *CachingSequenceAdaptor_new(DBAdaptor *dba) {
   BaseAdaptor_init((BaseAdaptor *)csa, dba, CACHINGSEQUENCE_ADAPTOR);
 
   // use an LRU cache to limit the size
-  csa->seqCache = LRUCache_new(CACHING_SEQ_CACHE_SZ);
+  csa->seqCache = LRUCache_new(CACHING_SEQ_CACHE_MAX);
+
+  // The cache is shared by anything using this DBAdaptor, which can include
+  // several threads, so all access to it is done holding cacheLock. It's
+  // recursive because adding can make the cache manager evict from it
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&(csa->cacheLock), &attr);
+  pthread_mutexattr_destroy(&attr);
+
+  LRUCache_setManager(csa->seqCache, DBAdaptor_getCacheManager(dba), "Seq region sequences",
+                      CACHING_SEQ_COST, &(csa->cacheLock));
 
   return csa;
 }
@@ -76,7 +92,9 @@ CachingSequenceAdaptor *CachingSequenceAdaptor_new(DBAdaptor *dba) {
 
 void CachingSequenceAdaptor_clearCache(CachingSequenceAdaptor *csa) {
   //fprintf(stderr,"clearCache called\n");
+  pthread_mutex_lock(&(csa->cacheLock));
   LRUCache_empty(csa->seqCache);
+  pthread_mutex_unlock(&(csa->cacheLock));
 
   return;
 }
@@ -168,6 +186,10 @@ char *CachingSequenceAdaptor_fetchBySliceStartEndStrand(CachingSequenceAdaptor *
   long  seqRegLen;
 
   //fprintf(stderr,"idStr = %s\n", idStr);
+  // Held until the copy out of the cached sequence is done, so it can't be
+  // evicted underneath us
+  pthread_mutex_lock(&(csa->cacheLock));
+
 // Is this region in the cache
   if (!LRUCache_contains(csa->seqCache, idStr)) {
 //   Get from underlying sequence adaptor
@@ -208,6 +230,8 @@ char *CachingSequenceAdaptor_fetchBySliceStartEndStrand(CachingSequenceAdaptor *
   // fprintf(stderr,"startOffet = %ld startPos = %ld endPos = %ld\n", startOffset, startPos, endPos);
   memcpy(&seq[startOffset], &seqRegSeq[startPos], endPos-startPos+1);
 
+  pthread_mutex_unlock(&(csa->cacheLock));
+
   // if they asked for the negative slice strand revcomp the whole thing
   if (strand == -1) {
     SeqUtil_reverseComplement(seq, endPos-startPos+1);
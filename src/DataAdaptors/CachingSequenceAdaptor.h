@@ -23,10 +23,13 @@
 
 #include "LRUCache.h"
 
+#include <pthread.h>
+
 struct CachingSequenceAdaptorStruct {
   BASEADAPTOR_DATA
 
   LRUCache *seqCache;
+  pthread_mutex_t cacheLock;
 };
 
 CachingSequenceAdaptor *CachingSequenceAdaptor_new(DBAdaptor *dba);
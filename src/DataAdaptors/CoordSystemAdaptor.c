@@ -147,6 +147,34 @@ CoordSystemAdaptor *CoordSystemAdaptor_new(DBAdaptor *dba) {
   return csa;
 }
 
+/*
+  Makes a CoordSystemAdaptor for dba (a clone of csa's DBAdaptor) without
+  going back to the database. The CoordSystem objects (and the name cache
+  Vectors and mapping paths) are shared with csa, but the lookup tables are
+  copies so mapping paths added lazily by getMappingPath only go into this
+  adaptor's tables. Nothing in csa is modified, so csa and its clones can be
+  used from different threads.
+*/
+CoordSystemAdaptor *CoordSystemAdaptor_clone(CoordSystemAdaptor *csa, DBAdaptor *dba) {
+  CoordSystemAdaptor *clone;
+
+  if ((clone = (CoordSystemAdaptor *)calloc(1,sizeof(CoordSystemAdaptor))) == NULL) {
+    fprintf(stderr, "ERROR: Failed allocating space for CoordSystemAdaptor clone\n");
+    return NULL;
+  }
+  memcpy(clone, csa, sizeof(CoordSystemAdaptor));
+  clone->dba = dba;
+
+  clone->dbIDCache             = IDHash_copy(csa->dbIDCache);
+  clone->rankCache             = IDHash_copy(csa->rankCache);
+  clone->nameCache             = StringHash_copy(csa->nameCache);
+  clone->isSeqLevelCache       = IDHash_copy(csa->isSeqLevelCache);
+  clone->isDefaultVersionCache = IDHash_copy(csa->isDefaultVersionCache);
+  clone->mappingPaths          = StringHash_copy(csa->mappingPaths);
+
+  return clone;
+}
+
 void CoordSystemAdaptor_dumpCachedMappings(CoordSystemAdaptor *csa) {
   char **keys = StringHash_getKeys(csa->mappingPaths);
 
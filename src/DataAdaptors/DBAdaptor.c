@@ -49,6 +49,13 @@
 
 #include "ProcUtil.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+static size_t DEFAULT_CACHE_SIZE = 512 * 1024 * 1024; // bytes, overridden by ENSC_CACHE_MB
+
+static void DBAdaptor_initCacheManager(DBAdaptor *dba, size_t maxSize);
+
 DBAdaptor *DBAdaptor_new(char *host, char *user, char *pass, char *dbname,
                          unsigned int port, DBAdaptor *dnadb) {
   DBAdaptor *dba;
@@ -68,9 +75,149 @@ DBAdaptor *DBAdaptor_new(char *host, char *user, char *pass, char *dbname,
 
   dba->srIdCache = IDHash_new(IDHASH_MEDIUM);
   dba->srNameCache = StringHash_new(STRINGHASH_MEDIUM);
+
+  size_t cacheSize = DEFAULT_CACHE_SIZE;
+  char *cacheMb = getenv("ENSC_CACHE_MB");
+  if (cacheMb != NULL && atol(cacheMb) > 0) {
+    cacheSize = (size_t)atol(cacheMb) * 1024 * 1024;
+  }
+  DBAdaptor_initCacheManager(dba, cacheSize);
+
   return dba;
 }
 
+/*
+ The seq region caches are counted against the budget, but their entries are
+ referenced from all over so are never evicted.
+*/
+static void DBAdaptor_initCacheManager(DBAdaptor *dba, size_t maxSize) {
+  dba->cacheManager  = CacheManager_new(maxSize);
+  dba->srCacheClient = CacheManager_register(dba->cacheManager, "Seq region cache", dba->srIdCache, 0.0, NULL, NULL);
+}
+
+/*
+=head2 setCacheSize
+
+  Arg [1]    : DBAdaptor *dba
+  Arg [2]    : size_t maxSize - bytes
+  Example    : DBAdaptor_setCacheSize(dba, 2048L * 1024 * 1024);
+  Description: Sets the memory budget shared by the caches of all the
+               adaptors made from dba (sequence chunks, slice features,
+               seq regions ...), evicting straight away if they're already
+               over it. The default is 512MB, or ENSC_CACHE_MB megabytes if
+               that's set in the environment.
+  Returntype : none
+  Exceptions : none
+  Caller     : general
+  Status     : At risk
+
+=cut
+*/
+void DBAdaptor_setCacheSize(DBAdaptor *dba, size_t maxSize) {
+  CacheManager_setMaxSize(dba->cacheManager, maxSize);
+}
+
+void DBAdaptor_printCacheStats(DBAdaptor *dba, FILE *fp) {
+  CacheManager_printStats(dba->cacheManager, fp);
+}
+
+/*
+ Second connection to dba's database, opened on first use, for queries whose
+ rows are read from the server as they're used. Other queries can't be run on
+ a connection until all of such a query's rows have been read, so this keeps
+ dba's own connection free for them. Not copied to clones. Returns NULL if the
+ connection couldn't be opened, which is only tried (and reported) once.
+*/
+DBConnection *DBAdaptor_getStreamConnection(DBAdaptor *dba) {
+  if (dba->streamDbc == NULL && !dba->streamDbcFailed) {
+    DBConnection *dbc = dba->dbc;
+
+    dba->streamDbc = DBConnection_new(DBConnection_getHost(dbc), DBConnection_getUser(dbc),
+                                      DBConnection_getPass(dbc), DBConnection_getDbName(dbc),
+                                      DBConnection_getPort(dbc));
+    if (dba->streamDbc == NULL) {
+      fprintf(stderr,"ERROR: Failed opening stream connection for %s - reading all rows at once instead\n",
+              DBConnection_getDbName(dbc));
+      dba->streamDbcFailed = 1;
+    }
+  }
+  return dba->streamDbc;
+}
+
+/*
+=head2 clone
+
+  Arg [1]    : DBAdaptor *dba - the adaptor to clone
+  Arg [2]    : DBConnection *dbc - connection for the clone to use, or NULL
+               to open a new one to the same database
+  Example    : DBAdaptor *threadDba = DBAdaptor_clone(dba, NULL);
+  Description: Makes a DBAdaptor for the same database as dba with its own
+               connection, for use from another thread. The read-only caches
+               built by dba (coord systems and mapping paths, the seq region
+               caches and analyses) are shared rather than being rebuilt from
+               the database: the clone gets its own copies of the lookup
+               tables but the cached objects themselves are the same ones dba
+               uses, and must not be freed while any clone is in use.
+               All other adaptors are created afresh on the clone's connection
+               as they are asked for, so objects fetched through a clone
+               belong to that clone (and thread).
+               A dna db other than dba itself is cloned too.
+  Returntype : DBAdaptor *
+  Exceptions : none
+  Caller     : DBConnectionPool
+  Status     : At risk
+
+=cut
+*/
+DBAdaptor *DBAdaptor_clone(DBAdaptor *dba, DBConnection *dbc) {
+  DBAdaptor *clone;
+
+  if ((clone = (DBAdaptor *)calloc(1,sizeof(DBAdaptor))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating DBAdaptor clone\n");
+    return NULL;
+  }
+
+  if (dbc == NULL) {
+    DBConnection *parentDbc = dba->dbc;
+    dbc = DBConnection_new(DBConnection_getHost(parentDbc), DBConnection_getUser(parentDbc),
+                           DBConnection_getPass(parentDbc), DBConnection_getDbName(parentDbc),
+                           DBConnection_getPort(parentDbc));
+    if (dbc == NULL) {
+      fprintf(stderr,"ERROR: Failed opening connection for DBAdaptor clone\n");
+      free(clone);
+      return NULL;
+    }
+  }
+  clone->dbc = dbc;
+
+  if (dba->dnadb == dba) {
+    clone->dnadb = clone;
+  } else {
+    clone->dnadb = DBAdaptor_clone(dba->dnadb, NULL);
+  }
+
+  if (dba->assemblyType) {
+    StrUtil_copyString(&(clone->assemblyType), dba->assemblyType, 0);
+  }
+  clone->noCache         = dba->noCache;
+  clone->speciesId       = dba->speciesId;
+  clone->insertBatchSize = dba->insertBatchSize;
+
+  clone->srIdCache   = IDHash_copy(dba->srIdCache);
+  clone->srNameCache = StringHash_copy(dba->srNameCache);
+
+  // Own manager (with the same budget) as the clone's caches are only used from its thread
+  DBAdaptor_initCacheManager(clone, CacheManager_getMaxSize(dba->cacheManager));
+
+  // Make sure the shared caches are built in the parent (once) before copying them
+  DBConnection_addAdaptor(clone->dbc,
+                          (BaseAdaptor *)CoordSystemAdaptor_clone(DBAdaptor_getCoordSystemAdaptor(dba), clone));
+  DBConnection_addAdaptor(clone->dbc,
+                          (BaseAdaptor *)AnalysisAdaptor_clone(DBAdaptor_getAnalysisAdaptor(dba), clone));
+
+  return clone;
+}
+
 void DBAdaptor_addToSrCaches(DBAdaptor *dba, IDType regionId, char *regionName, IDType csId, long regionLength) {
   char key[1024];
   SeqRegionCacheEntry *cacheData;
@@ -89,6 +236,8 @@ void DBAdaptor_addToSrCaches(DBAdaptor *dba, IDType regionId, char *regionName,
   StringHash_add(dba->srNameCache, key, cacheData);
   IDHash_add(dba->srIdCache, regionId, cacheData);
 
+  CacheManagerClient_addSize(dba->srCacheClient, sizeof(SeqRegionCacheEntry) + strlen(regionName) + 1 + strlen(key) + 1);
+
   return;
 }
 
@@ -23,6 +23,8 @@
 #include "EnsC.h"
 #include "IDHash.h"
 #include "StringHash.h"
+#include "CacheManager.h"
+#include "Arena.h"
 
 struct DBAdaptorStruct {
   BASEDBADAPTOR_DATA
@@ -30,17 +32,27 @@ struct DBAdaptorStruct {
   char          *assemblyType;
   IDHash        *srIdCache;
   StringHash    *srNameCache;
+  CacheManager  *cacheManager;
+  CacheManagerClient *srCacheClient;
+  Arena         *arena;
   int            noCache;
   int            speciesId;
+  int            insertBatchSize;
+  DBConnection  *streamDbc;
+  int            streamDbcFailed;
 };
 
 DBAdaptor *DBAdaptor_new(char *host, char *user, char *pass, char *dbname,
                          unsigned int port, DBAdaptor *dnadb);
+DBAdaptor *DBAdaptor_clone(DBAdaptor *dba, DBConnection *dbc);
 
 char *DBAdaptor_setAssemblyType(DBAdaptor *dba, char *type);
 char *DBAdaptor_getAssemblyType(DBAdaptor *dba);
 
 void DBAdaptor_addToSrCaches(DBAdaptor *dba, IDType regionId, char *regionName, IDType csId, long regionLength);
+void DBAdaptor_setCacheSize(DBAdaptor *dba, size_t maxSize);
+void DBAdaptor_printCacheStats(DBAdaptor *dba, FILE *fp);
+DBConnection *DBAdaptor_getStreamConnection(DBAdaptor *dba);
 
 AnalysisAdaptor             *DBAdaptor_getAnalysisAdaptor(DBAdaptor *dba);
 AssemblyMapperAdaptor       *DBAdaptor_getAssemblyMapperAdaptor(DBAdaptor *dba);
@@ -76,13 +88,26 @@ TranslationAdaptor          *DBAdaptor_getTranslationAdaptor(DBAdaptor *dba);
 #define DBAdaptor_getSeqRegionIdCache(dba) (dba)->srIdCache
 #define DBAdaptor_getSeqRegionNameCache(dba) (dba)->srNameCache
 
+// Budget shared by the caches of all the adaptors made from this DBAdaptor
+#define DBAdaptor_getCacheManager(dba) (dba)->cacheManager
+
+// Arena the objects fetched through this DBAdaptor are allocated from (NULL for the heap).
+// Not copied to clones - an arena must only be used from one thread
+#define DBAdaptor_setArena(dba, val) (dba)->arena = (val)
+#define DBAdaptor_getArena(dba) (dba)->arena
+
 #define DBAdaptor_setNoCache(dba, val) (dba)->noCache = (val)
 #define DBAdaptor_noCache(dba) (dba)->noCache
 
 #define DBAdaptor_setSpeciesId(dba, val) (dba)->speciesId = (val)
 #define DBAdaptor_getSpeciesId(dba) (dba)->speciesId
 
+// Number of rows store methods write per INSERT statement (0 means use BATCHINSERT_DEFAULTBATCHSIZE)
+#define DBAdaptor_setInsertBatchSize(dba, val) (dba)->insertBatchSize = (val)
+#define DBAdaptor_getInsertBatchSize(dba) (dba)->insertBatchSize
+
 #define DBAdaptor_prepare(dba,qStr,qLen) BaseDBAdaptor_prepare((dba),(qStr),(qLen))
+#define DBAdaptor_prepareStatement(dba,qStr,qLen) BaseDBAdaptor_prepareStatement((dba),(qStr),(qLen))
 
 
 
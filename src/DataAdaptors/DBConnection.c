@@ -18,9 +18,16 @@
 #include "StrUtil.h"
 #include "Error.h"
 #include "MysqlStatementHandle.h"
+#include "MysqlPreparedStatementHandle.h"
 #include "BaseAdaptor.h"
 #include "EcoString.h"
 
+int  DBConnection_localInfileInit(void **ptr, const char *fileName, void *userData);
+int  DBConnection_localInfileRead(void *ptr, char *buf, unsigned int bufLen);
+void DBConnection_localInfileEnd(void *ptr);
+int  DBConnection_localInfileError(void *ptr, char *errorMsg, unsigned int errorMsgLen);
+static StatementHandle *DBConnection_prepareCachedStatement(DBConnection *dbc, char *queryStr, int queryLen, int reportErrors);
+
 DBConnection *DBConnection_new(char *host, char *user, char *pass, 
                                char *dbname, unsigned int port) {
   DBConnection *dbc;
@@ -45,6 +52,11 @@ DBConnection *DBConnection_new(char *host, char *user, char *pass,
     mysql_options(mysql, MYSQL_OPT_PROTOCOL, &arg) ;
   }
 
+  /* LOAD DATA LOCAL is used by BatchInsertWriter. The handler installed below only ever
+   * reads from a buffer registered with DBConnection_setLocalInfileBuffer, never from a file. */
+  unsigned int localInfile = 1;
+  mysql_options(mysql, MYSQL_OPT_LOCAL_INFILE, &localInfile);
+
   if ((mysql_real_connect(mysql,host, user, pass, dbname, port, NULL, 0)) == NULL) {
     Error_write(EMYSQLCONN, "DBConnection_new", ERR_SEVERE,
                 " dbname %s (host %s user %s pass %s port %d), mysql error %s",
@@ -62,6 +74,14 @@ DBConnection *DBConnection_new(char *host, char *user, char *pass,
   dbc->mysql   = mysql;
   dbc->prepare = DBConnection_prepare;
 
+  mysql_set_local_infile_handler(mysql,
+                                 DBConnection_localInfileInit,
+                                 DBConnection_localInfileRead,
+                                 DBConnection_localInfileEnd,
+                                 DBConnection_localInfileError,
+                                 dbc);
+  dbc->prepareStatement = DBConnection_prepareStatement;
+
   if (!dbc->host   || 
       !dbc->user   || 
       !dbc->dbName ||
@@ -81,6 +101,149 @@ StatementHandle *DBConnection_prepare(DBConnection *dbc, char *queryStr, int que
   return (StatementHandle *)MysqlStatementHandle_new(dbc,queryStr);
 }
 
+/*
+  Server side prepared statement version of prepare. The SQL should use ?
+  placeholders with values supplied through the sth->bind* functions.
+
+  Statements are cached per connection keyed on the SQL text, so preparing
+  the same SQL again (eg. in a store loop or for each sequence chunk) reuses
+  the already parsed statement. finish() on a cached handle just resets it.
+  If the cached statement is still in use (nested use of the same SQL) an
+  uncached handle is returned instead, which finish() will free.
+*/
+StatementHandle *DBConnection_prepareStatement(DBConnection *dbc, char *queryStr, int queryLen) {
+  return DBConnection_prepareCachedStatement(dbc, queryStr, queryLen, 1);
+}
+
+/*
+  As DBConnection_prepareStatement, but returns NULL without printing an error
+  if the server won't prepare the SQL, for callers that then fall back to the
+  text protocol.
+*/
+StatementHandle *DBConnection_tryPrepareStatement(DBConnection *dbc, char *queryStr, int queryLen) {
+  return DBConnection_prepareCachedStatement(dbc, queryStr, queryLen, 0);
+}
+
+static StatementHandle *DBConnection_prepareCachedStatement(DBConnection *dbc, char *queryStr, int queryLen, int reportErrors) {
+  MysqlPreparedStatementHandle *m_sth;
+
+  if (dbc->statementCache == NULL) {
+    dbc->statementCache = StringHash_new(STRINGHASH_SMALL);
+  }
+
+  if ((m_sth = StringHash_getValue(dbc->statementCache, queryStr)) != NULL) {
+    if (!MysqlPreparedStatementHandle_isInUse(m_sth)) {
+      MysqlPreparedStatementHandle_setInUse(m_sth, 1);
+      return (StatementHandle *)m_sth;
+    }
+    return MysqlPreparedStatementHandle_new(dbc, queryStr, queryLen, reportErrors);
+  }
+
+  if ((m_sth = (MysqlPreparedStatementHandle *)MysqlPreparedStatementHandle_new(dbc, queryStr, queryLen, reportErrors)) == NULL) {
+    return NULL;
+  }
+
+  MysqlPreparedStatementHandle_setCached(m_sth, 1);
+  MysqlPreparedStatementHandle_setInUse(m_sth, 1);
+  StringHash_add(dbc->statementCache, queryStr, m_sth);
+
+  return (StatementHandle *)m_sth;
+}
+
+void DBConnection_clearStatementCache(DBConnection *dbc) {
+  if (dbc->statementCache) {
+    StringHash_free(dbc->statementCache, MysqlPreparedStatementHandle_free);
+    dbc->statementCache = NULL;
+  }
+}
+
+/*
+  Closes the connection to the server, first releasing the cached prepared
+  statements (which have to be closed while the connection is still open).
+  The DBConnection itself is not freed, as adaptors may still point to it.
+*/
+void DBConnection_close(DBConnection *dbc) {
+  DBConnection_clearStatementCache(dbc);
+  if (dbc->mysql) {
+    mysql_close(dbc->mysql);
+    dbc->mysql = NULL;
+  }
+}
+
+/*
+  Equivalent of DBI's $dbc->do() - runs a complete SQL statement which doesn't
+  return rows. Unlike sth->execute the SQL is not used as a format string, so
+  it can be of any length and contain '%' characters.
+  Returns 0 on failure.
+*/
+int DBConnection_do(DBConnection *dbc, char *qStr, unsigned long qLen, unsigned long long *affectedRowsP) {
+  if (mysql_real_query(dbc->mysql, qStr, qLen) != 0) {
+    fprintf(stderr, "Could not execute query (length %lu): %.1000s\n\n", qLen, qStr);
+    fprintf(stderr, "Mysql error: %s\n", mysql_error(dbc->mysql));
+    fprintf(stderr, "Database %s host %s user %s port %d\n",
+            DBConnection_getDbName(dbc),
+            DBConnection_getHost(dbc),
+            DBConnection_getUser(dbc),
+            DBConnection_getPort(dbc));
+    return 0;
+  }
+
+  if (affectedRowsP) {
+    *affectedRowsP = mysql_affected_rows(dbc->mysql);
+  }
+
+  return 1;
+}
+
+/*
+  Register the data to be sent for the next LOAD DATA LOCAL INFILE statement
+  on this connection. The buffer is not copied and must stay valid until the
+  statement completes. It is cleared once the server has read it.
+*/
+void DBConnection_setLocalInfileBuffer(DBConnection *dbc, char *buf, size_t len) {
+  dbc->localInfileBuf = buf;
+  dbc->localInfileLen = len;
+  dbc->localInfilePos = 0;
+}
+
+int DBConnection_localInfileInit(void **ptr, const char *fileName, void *userData) {
+  DBConnection *dbc = (DBConnection *)userData;
+
+  *ptr = dbc;
+
+  // Refuse anything other than our own in-memory data
+  if (dbc == NULL || dbc->localInfileBuf == NULL) {
+    return 1;
+  }
+  dbc->localInfilePos = 0;
+
+  return 0;
+}
+
+int DBConnection_localInfileRead(void *ptr, char *buf, unsigned int bufLen) {
+  DBConnection *dbc = (DBConnection *)ptr;
+  size_t remaining = dbc->localInfileLen - dbc->localInfilePos;
+  size_t toCopy = remaining < bufLen ? remaining : bufLen;
+
+  memcpy(buf, &(dbc->localInfileBuf[dbc->localInfilePos]), toCopy);
+  dbc->localInfilePos += toCopy;
+
+  return (int)toCopy;
+}
+
+void DBConnection_localInfileEnd(void *ptr) {
+  DBConnection *dbc = (DBConnection *)ptr;
+
+  if (dbc) {
+    DBConnection_setLocalInfileBuffer(dbc, NULL, 0);
+  }
+}
+
+int DBConnection_localInfileError(void *ptr, char *errorMsg, unsigned int errorMsgLen) {
+  snprintf(errorMsg, errorMsgLen, "LOAD DATA LOCAL is only supported from an EnsC in-memory buffer");
+  return 2000; // CR_UNKNOWN_ERROR
+}
+
 BaseAdaptor *DBConnection_getAdaptor(DBConnection *dbc, int type) {
   int i;
   BaseAdaptor *ad = NULL;
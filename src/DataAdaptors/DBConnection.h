@@ -21,6 +21,7 @@
 #include "AdaptorTypes.h"
 #include "StatementHandle.h"
 #include "EcoString.h"
+#include "StringHash.h"
 
 #include <mysql.h>
 
@@ -35,6 +36,12 @@ struct DBConnectionStruct {
   ECOSTRING dbName;
   MYSQL *mysql;
   DBConnection_PrepareFunc prepare;
+  DBConnection_PrepareFunc prepareStatement;
+  StringHash *statementCache;
+  StringHash *autoIncInfoCache;
+  char  *localInfileBuf;
+  size_t localInfileLen;
+  size_t localInfilePos;
   BaseAdaptor **adaptors;
   int nAdaptor;
 };
@@ -42,6 +49,12 @@ struct DBConnectionStruct {
 DBConnection    *DBConnection_new(char *host, char *user, char *pass, char *dbname, unsigned int port);
 BaseAdaptor     *DBConnection_getAdaptor(DBConnection *dbc, int type);
 StatementHandle *DBConnection_prepare(DBConnection *dbc, char *queryStr, int queryLen);
+StatementHandle *DBConnection_prepareStatement(DBConnection *dbc, char *queryStr, int queryLen);
+StatementHandle *DBConnection_tryPrepareStatement(DBConnection *dbc, char *queryStr, int queryLen);
+void DBConnection_clearStatementCache(DBConnection *dbc);
+void DBConnection_close(DBConnection *dbc);
+int DBConnection_do(DBConnection *dbc, char *qStr, unsigned long qLen, unsigned long long *affectedRowsP);
+void DBConnection_setLocalInfileBuffer(DBConnection *dbc, char *buf, size_t len);
 int DBConnection_addAdaptor(DBConnection *dbc, BaseAdaptor *ba);
 char *DBConnection_getDriverName(DBConnection *dbc);
 void DBConnection_fromDateToSeconds(DBConnection *dbc, char *column, char *wrappedColumn);
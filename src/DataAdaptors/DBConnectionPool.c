@@ -0,0 +1,191 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DBConnectionPool.h"
+#include "AnalysisAdaptor.h"
+#include "CoordSystemAdaptor.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mysql.h>
+
+static void DBConnectionPool_releaseEntry(DBConnectionPoolEntry *entry);
+static void DBConnectionPool_threadExit(void *value);
+
+
+DBConnectionPool *DBConnectionPool_new(DBAdaptor *templateDba, int maxConnections) {
+  DBConnectionPool *pool;
+
+  if (maxConnections < 1) {
+    fprintf(stderr,"ERROR: DBConnectionPool needs at least one connection (asked for %d)\n", maxConnections);
+    exit(1);
+  }
+
+  if ((pool = (DBConnectionPool *)calloc(1,sizeof(DBConnectionPool))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating DBConnectionPool\n");
+    exit(1);
+  }
+
+  if ((pool->entries = (DBConnectionPoolEntry **)calloc(maxConnections, sizeof(DBConnectionPoolEntry *))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating DBConnectionPool entries\n");
+    exit(1);
+  }
+
+  // Needs to be done before any other threads use the client library
+  mysql_library_init(0, NULL, NULL);
+  if (!mysql_thread_safe()) {
+    fprintf(stderr,"Warning: mysql client library is not thread safe - DBConnectionPool connections should only be used from one thread at a time\n");
+  }
+
+  pool->templateDba    = templateDba;
+  pool->maxConnections = maxConnections;
+
+  // Build the shared caches now, in this thread, rather than in whichever
+  // thread asks for the first connection
+  DBAdaptor_getCoordSystemAdaptor(templateDba);
+  DBAdaptor_getAnalysisAdaptor(templateDba);
+  if (DBAdaptor_getDNADBAdaptor(templateDba) != templateDba) {
+    DBAdaptor_getCoordSystemAdaptor(DBAdaptor_getDNADBAdaptor(templateDba));
+    DBAdaptor_getAnalysisAdaptor(DBAdaptor_getDNADBAdaptor(templateDba));
+  }
+
+  pthread_mutex_init(&(pool->lock), NULL);
+  pthread_cond_init(&(pool->released), NULL);
+  if (pthread_key_create(&(pool->threadKey), DBConnectionPool_threadExit) != 0) {
+    fprintf(stderr,"ERROR: Failed creating thread key for DBConnectionPool\n");
+    exit(1);
+  }
+
+  return pool;
+}
+
+/*
+  Returns the calling thread's DBAdaptor, taking an idle one from the pool
+  or making a new clone of the template if it doesn't have one yet.
+*/
+DBAdaptor *DBConnectionPool_getDBAdaptor(DBConnectionPool *pool) {
+  DBConnectionPoolEntry *entry;
+
+  if ((entry = pthread_getspecific(pool->threadKey)) != NULL) {
+    return entry->dba;
+  }
+
+  pthread_mutex_lock(&(pool->lock));
+
+  while (pool->idle == NULL && pool->nConnection >= pool->maxConnections) {
+    pthread_cond_wait(&(pool->released), &(pool->lock));
+  }
+
+  if (pool->idle) {
+    entry = pool->idle;
+    pool->idle = entry->nextIdle;
+    entry->nextIdle = NULL;
+  } else {
+    if ((entry = (DBConnectionPoolEntry *)calloc(1,sizeof(DBConnectionPoolEntry))) == NULL) {
+      fprintf(stderr,"ERROR: Failed allocating DBConnectionPool entry\n");
+      exit(1);
+    }
+    entry->pool = pool;
+
+    // Cloning reads the template's caches, so is done holding the lock
+    if ((entry->dba = DBAdaptor_clone(pool->templateDba, NULL)) == NULL) {
+      fprintf(stderr,"ERROR: Failed making connection %d for DBConnectionPool\n", pool->nConnection+1);
+      exit(1);
+    }
+    pool->entries[pool->nConnection++] = entry;
+  }
+  entry->inUse = 1;
+
+  pthread_mutex_unlock(&(pool->lock));
+
+  mysql_thread_init();
+  pthread_setspecific(pool->threadKey, entry);
+
+  return entry->dba;
+}
+
+DBConnection *DBConnectionPool_getConnection(DBConnectionPool *pool) {
+  return DBConnectionPool_getDBAdaptor(pool)->dbc;
+}
+
+static void DBConnectionPool_releaseEntry(DBConnectionPoolEntry *entry) {
+  DBConnectionPool *pool = entry->pool;
+
+  mysql_thread_end();
+
+  pthread_mutex_lock(&(pool->lock));
+
+  entry->inUse    = 0;
+  entry->nextIdle = pool->idle;
+  pool->idle      = entry;
+
+  pthread_cond_signal(&(pool->released));
+  pthread_mutex_unlock(&(pool->lock));
+}
+
+/*
+  Gives the calling thread's connection back to the pool. Anything fetched
+  with it should be finished with (its adaptors and caches go to the next
+  thread which gets the connection).
+*/
+void DBConnectionPool_releaseConnection(DBConnectionPool *pool) {
+  DBConnectionPoolEntry *entry;
+
+  if ((entry = pthread_getspecific(pool->threadKey)) == NULL) {
+    return;
+  }
+
+  pthread_setspecific(pool->threadKey, NULL);
+  DBConnectionPool_releaseEntry(entry);
+}
+
+// Called when a thread which still holds a connection exits
+static void DBConnectionPool_threadExit(void *value) {
+  DBConnectionPool_releaseEntry((DBConnectionPoolEntry *)value);
+}
+
+/*
+  Closes all the pool's connections. Must only be called once every thread
+  has released its connection (or exited). There's no DBAdaptor_free, so the
+  clones themselves (and anything cached in them) are not freed.
+*/
+void DBConnectionPool_free(DBConnectionPool *pool) {
+  int i;
+
+  pthread_mutex_lock(&(pool->lock));
+  for (i=0; i<pool->nConnection; i++) {
+    DBConnectionPoolEntry *entry = pool->entries[i];
+
+    if (entry->inUse) {
+      fprintf(stderr,"ERROR: DBConnectionPool freed while connection %d is still in use\n", i);
+      exit(1);
+    }
+
+    if (DBAdaptor_getDNADBAdaptor(entry->dba) != entry->dba) {
+      DBConnection_close(DBAdaptor_getDNADBAdaptor(entry->dba)->dbc);
+    }
+    DBConnection_close(entry->dba->dbc);
+    free(entry);
+  }
+  pthread_mutex_unlock(&(pool->lock));
+
+  pthread_key_delete(pool->threadKey);
+  pthread_cond_destroy(&(pool->released));
+  pthread_mutex_destroy(&(pool->lock));
+
+  free(pool->entries);
+  free(pool);
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DBCONNECTIONPOOL_H__
+#define __DBCONNECTIONPOOL_H__
+
+#include <pthread.h>
+
+#include "AdaptorTypes.h"
+#include "DBAdaptor.h"
+#include "DBConnection.h"
+
+/*
+ Hands out one database connection per thread, each wrapped in a clone of a
+ template DBAdaptor (see DBAdaptor_clone). The clones share the template's
+ coord system, seq region and analysis caches, so they are only built once
+ per process, but each has its own connection and its own adaptors.
+
+ Usage:
+   DBConnectionPool *pool = DBConnectionPool_new(dba, nThread);
+
+   // in each thread
+   DBAdaptor *threadDba = DBConnectionPool_getDBAdaptor(pool);
+   Slice *slice = SliceAdaptor_fetchByRegion(DBAdaptor_getSliceAdaptor(threadDba), ...);
+   ...
+   DBConnectionPool_releaseConnection(pool);
+
+   // once all threads are finished
+   DBConnectionPool_free(pool);
+
+ A thread gets the same DBAdaptor each time it asks until it releases it (or
+ exits, which releases it automatically). Released connections are reused by
+ later threads. If maxConnections are all in use, getDBAdaptor waits until
+ one is released.
+
+ Objects fetched through a thread's DBAdaptor belong to that thread and must
+ not be used from other threads while it is still fetching. The template
+ DBAdaptor must not be used for fetching while the pool is in use.
+*/
+
+typedef struct DBConnectionPoolEntryStruct DBConnectionPoolEntry;
+
+struct DBConnectionPoolEntryStruct {
+  DBConnectionPool *pool;
+  DBAdaptor *dba;
+  int inUse;
+  DBConnectionPoolEntry *nextIdle;
+};
+
+struct DBConnectionPoolStruct {
+  DBAdaptor *templateDba;
+  int maxConnections;
+  int nConnection;
+  DBConnectionPoolEntry **entries;
+  DBConnectionPoolEntry *idle;
+  pthread_mutex_t lock;
+  pthread_cond_t  released;
+  pthread_key_t   threadKey;
+};
+
+DBConnectionPool *DBConnectionPool_new(DBAdaptor *templateDba, int maxConnections);
+DBAdaptor        *DBConnectionPool_getDBAdaptor(DBConnectionPool *pool);
+DBConnection     *DBConnectionPool_getConnection(DBConnectionPool *pool);
+void              DBConnectionPool_releaseConnection(DBConnectionPool *pool);
+void              DBConnectionPool_free(DBConnectionPool *pool);
+
+#define DBConnectionPool_getMaxConnections(pool) (pool)->maxConnections
+#define DBConnectionPool_getNumConnection(pool) (pool)->nConnection
+
+#endif
@@ -25,6 +25,14 @@
 #include "Translation.h"
 
 Vector *DBEntryAdaptor_fetchByObjectType(DBEntryAdaptor *dbea, IDType ensObj, char *ensType);
+static IDHash *DBEntryAdaptor_fetchByObjectTypeList(DBEntryAdaptor *dbea, IDType *ensObjs, int nEnsObj, char *ensType);
+static DBEntry *DBEntryAdaptor_dbEntryFromRow(DBEntryAdaptor *dbea, ResultRow *row);
+static int DBEntryAdaptor_fetchTranscriptTranslationIds(DBEntryAdaptor *dbea, char *idColumn, IDType *ids, int nId,
+                                                        IDType **ownerIdsP, IDType **transcriptIdsP, IDType **translationIdsP);
+static void DBEntryAdaptor_freeLinksHash(IDHash *links);
+
+// Ids in each IN (...) list, as in BaseAdaptor_fetchAllByDbIDList
+#define DBENTRYADAPTOR_MAXINSIZE 16384
 
 
 DBEntryAdaptor *DBEntryAdaptor_new(DBAdaptor *dba) {
@@ -474,25 +482,7 @@ Vector *DBEntryAdaptor_fetchByObjectType(DBEntryAdaptor *dbea, IDType ensObj, ch
     // this is easy enough; all the 'extra' bits are synonyms
 
     if (!IDHash_contains(seen,refID))  {
-      exDB = DBEntry_new();
-      DBEntry_setAdaptor(exDB,(BaseAdaptor *)dbea);
-      DBEntry_setDbID(exDB, refID);
-      DBEntry_setPrimaryId(exDB, row->getStringAt(row,1));
-      DBEntry_setDisplayId(exDB, row->getStringAt(row,2));
-      DBEntry_setVersion(exDB, row->getStringAt(row,3));
-      DBEntry_setDbName(exDB, row->getStringAt(row,5));
-      DBEntry_setRelease(exDB, row->getStringAt(row,6));
-
-      if (row->col(row,10)) {
-        IdentityXref *idx = IdentityXref_new();
-        DBEntry_setIdentityXref(exDB,idx);
-	IdentityXref_setQueryIdentity(idx, row->getDoubleAt(row,10));
-	IdentityXref_setTargetIdentity(idx, row->getDoubleAt(row,11));
-      }
-      
-      if (row->col(row,4)) DBEntry_setDescription(exDB, row->getStringAt(row,4));
-      if (row->col(row,7)) DBEntry_setStatus(exDB, row->getStringAt(row,7));
-      
+      exDB = DBEntryAdaptor_dbEntryFromRow(dbea, row);
       Vector_addElement(out, exDB);
       IDHash_add(seen, refID, exDB);
     } 
@@ -511,6 +501,362 @@ Vector *DBEntryAdaptor_fetchByObjectType(DBEntryAdaptor *dbea, IDType ensObj, ch
   return out;
 }
 
+// Makes a DBEntry from the xref columns selected by the fetchByObjectType queries
+static DBEntry *DBEntryAdaptor_dbEntryFromRow(DBEntryAdaptor *dbea, ResultRow *row) {
+  DBEntry *exDB = DBEntry_new();
+
+  DBEntry_setAdaptor(exDB,(BaseAdaptor *)dbea);
+  DBEntry_setDbID(exDB, row->getLongLongAt(row,0));
+  DBEntry_setPrimaryId(exDB, row->getStringAt(row,1));
+  DBEntry_setDisplayId(exDB, row->getStringAt(row,2));
+  DBEntry_setVersion(exDB, row->getStringAt(row,3));
+  DBEntry_setDbName(exDB, row->getStringAt(row,5));
+  DBEntry_setRelease(exDB, row->getStringAt(row,6));
+
+  if (row->col(row,10)) {
+    IdentityXref *idx = IdentityXref_new();
+    DBEntry_setIdentityXref(exDB,idx);
+    IdentityXref_setQueryIdentity(idx, row->getDoubleAt(row,10));
+    IdentityXref_setTargetIdentity(idx, row->getDoubleAt(row,11));
+  }
+
+  if (row->col(row,4)) DBEntry_setDescription(exDB, row->getStringAt(row,4));
+  if (row->col(row,7)) DBEntry_setStatus(exDB, row->getStringAt(row,7));
+
+  return exDB;
+}
+
+/*
+ Set oriented version of DBEntryAdaptor_fetchByObjectType. Fetches the
+ xrefs for all nEnsObj objects of ensType with one query per
+ DBENTRYADAPTOR_MAXINSIZE ids, rather than one per object. Returns a hash
+ from object id to a Vector of its DBEntrys, which only has entries for
+ objects with xrefs.
+*/
+static IDHash *DBEntryAdaptor_fetchByObjectTypeList(DBEntryAdaptor *dbea, IDType *ensObjs, int nEnsObj, char *ensType) {
+  IDHash *links = IDHash_new(IDHASH_LARGE);
+  StrBuf *qStr;
+  int i;
+
+  if (!nEnsObj) {
+    return links;
+  }
+
+  qStr = StrBuf_new(STRBUF_DEFAULTSIZE);
+
+  for (i=0; i<nEnsObj; i+=DBENTRYADAPTOR_MAXINSIZE) {
+    StatementHandle *sth;
+    ResultRow *row;
+    IDHash *seen = NULL;
+    Vector *objLinks = NULL;
+    IDType lastEnsObj = 0;
+
+    // Ordered on the object so its rows come together, and duplicates can be
+    // filtered per object as fetchByObjectType does
+    StrBuf_clear(qStr);
+    StrBuf_appendf(qStr,
+      "SELECT xref.xref_id, xref.dbprimary_acc, xref.display_label, xref.version,"
+      "       xref.description,"
+      "       exDB.db_name, exDB.db_release, exDB.status,"
+      "       oxr.object_xref_id,"
+      "       es.synonym,"
+      "       idt.xref_identity, idt.ensembl_identity,"
+      "       oxr.ensembl_id"
+      " FROM  (external_db exDB, object_xref oxr, xref xref)"
+      " LEFT JOIN external_synonym es on es.xref_id = xref.xref_id"
+      " LEFT JOIN identity_xref idt on idt.object_xref_id = oxr.object_xref_id"
+      " WHERE  xref.xref_id = oxr.xref_id"
+      "  AND  xref.external_db_id = exDB.external_db_id"
+      "  AND  oxr.ensembl_object_type = '%s'"
+      "  AND  oxr.ensembl_id IN (",
+      ensType);
+    StrBuf_appendIDList(qStr, &ensObjs[i], nEnsObj-i < DBENTRYADAPTOR_MAXINSIZE ? nEnsObj-i : DBENTRYADAPTOR_MAXINSIZE);
+    StrBuf_append(qStr, ") ORDER BY oxr.ensembl_id");
+
+    sth = dbea->prepare((BaseAdaptor *)dbea,StrBuf_getString(qStr),StrBuf_getLength(qStr));
+    sth->execute(sth);
+
+    while ((row = sth->fetchRow(sth))) {
+      IDType ensObj = row->getLongLongAt(row,12);
+      IDType refID  = row->getLongLongAt(row,0);
+      DBEntry *exDB;
+
+      if (objLinks == NULL || ensObj != lastEnsObj) {
+        if (seen) {
+          IDHash_free(seen, NULL);
+        }
+        seen = IDHash_new(IDHASH_SMALL);
+
+        if ((objLinks = IDHash_getValue(links, ensObj)) == NULL) {
+          objLinks = Vector_new();
+          IDHash_add(links, ensObj, objLinks);
+        }
+        lastEnsObj = ensObj;
+      }
+
+      if ((exDB = IDHash_getValue(seen, refID)) == NULL) {
+        exDB = DBEntryAdaptor_dbEntryFromRow(dbea, row);
+        Vector_addElement(objLinks, exDB);
+        IDHash_add(seen, refID, exDB);
+      }
+
+      if (row->col(row,9)) {
+        DBEntry_addSynonym(exDB,row->getStringAt(row,9));
+      }
+    }
+
+    if (seen) {
+      IDHash_free(seen, NULL);
+    }
+    sth->finish(sth);
+  }
+
+  StrBuf_free(qStr);
+
+  return links;
+}
+
+// Frees the Vectors in a hash from DBEntryAdaptor_fetchByObjectTypeList, but not the DBEntrys in them
+static void DBEntryAdaptor_freeLinksHash(IDHash *links) {
+  IDHash_free(links, Vector_free);
+}
+
+/*
+ Fetches the transcript and canonical translation ids for the transcripts
+ whose idColumn (gene_id or transcript_id) is in ids, one query per
+ DBENTRYADAPTOR_MAXINSIZE ids. Fills in parallel arrays of the idColumn
+ value, transcript id and translation id (0 if none) for each transcript,
+ returning how many there are.
+*/
+static int DBEntryAdaptor_fetchTranscriptTranslationIds(DBEntryAdaptor *dbea, char *idColumn, IDType *ids, int nId,
+                                                        IDType **ownerIdsP, IDType **transcriptIdsP, IDType **translationIdsP) {
+  IDType *ownerIds = NULL;
+  IDType *transcriptIds = NULL;
+  IDType *translationIds = NULL;
+  int nAlloc = 0;
+  int nTrans = 0;
+  StrBuf *qStr = StrBuf_new(STRBUF_DEFAULTSIZE);
+  int i;
+
+  for (i=0; i<nId; i+=DBENTRYADAPTOR_MAXINSIZE) {
+    StatementHandle *sth;
+    ResultRow *row;
+
+    StrBuf_clear(qStr);
+    StrBuf_appendf(qStr,
+      "SELECT t.%s, t.transcript_id, t.canonical_translation_id"
+      " FROM   transcript t"
+      " WHERE  t.%s IN (",
+      idColumn, idColumn);
+    StrBuf_appendIDList(qStr, &ids[i], nId-i < DBENTRYADAPTOR_MAXINSIZE ? nId-i : DBENTRYADAPTOR_MAXINSIZE);
+    StrBuf_appendChar(qStr, ')');
+
+    sth = dbea->prepare((BaseAdaptor *)dbea,StrBuf_getString(qStr),StrBuf_getLength(qStr));
+    sth->execute(sth);
+
+    while ((row = sth->fetchRow(sth))) {
+      if (nTrans == nAlloc) {
+        nAlloc = nAlloc ? nAlloc * 2 : 1024;
+        if ((ownerIds       = (IDType *)realloc(ownerIds,       nAlloc * sizeof(IDType))) == NULL ||
+            (transcriptIds  = (IDType *)realloc(transcriptIds,  nAlloc * sizeof(IDType))) == NULL ||
+            (translationIds = (IDType *)realloc(translationIds, nAlloc * sizeof(IDType))) == NULL) {
+          fprintf(stderr,"ERROR: Failed allocating transcript id arrays\n");
+          exit(1);
+        }
+      }
+
+      ownerIds[nTrans]       = row->getLongLongAt(row,0);
+      transcriptIds[nTrans]  = row->getLongLongAt(row,1);
+      translationIds[nTrans] = row->col(row,2) ? row->getLongLongAt(row,2) : 0;
+      nTrans++;
+    }
+
+    sth->finish(sth);
+  }
+
+  StrBuf_free(qStr);
+
+  *ownerIdsP       = ownerIds;
+  *transcriptIdsP  = transcriptIds;
+  *translationIdsP = translationIds;
+
+  return nTrans;
+}
+
+/*
+ Set oriented DBEntryAdaptor_fetchAllByGene: adds the transcript and
+ translation xrefs of all the genes in the list to them, in a handful of
+ IN (...) queries rather than a couple per transcript. Genes which already
+ have their xrefs loaded are left alone, and genes without any get an empty
+ list so they aren't fetched again one at a time.
+*/
+int DBEntryAdaptor_fetchAllByGeneList(DBEntryAdaptor *dbea, Vector *genes) {
+  IDHash *geneHash = IDHash_new(IDHASH_LARGE);
+  IDType *geneIds;
+  IDType *ownerIds;
+  IDType *transcriptIds;
+  IDType *translationIds;
+  IDHash *transcriptLinks;
+  IDHash *translationLinks;
+  int nGeneId;
+  int nTrans;
+  int nTranslation = 0;
+  int i;
+  int j;
+
+  for (i=0; i<Vector_getNumElement(genes); i++) {
+    Gene *gene = Vector_getElementAt(genes, i);
+
+    if (gene->dbLinks == NULL && !IDHash_contains(geneHash, Gene_getDbID(gene))) {
+      IDHash_add(geneHash, Gene_getDbID(gene), gene);
+    }
+  }
+
+  geneIds = IDHash_getKeys(geneHash);
+  nGeneId = IDHash_getNumValues(geneHash);
+
+  nTrans = DBEntryAdaptor_fetchTranscriptTranslationIds(dbea, "gene_id", geneIds, nGeneId,
+                                                        &ownerIds, &transcriptIds, &translationIds);
+  free(geneIds);
+
+  // Translation ids packed down into their own list for the query (keeping the per transcript ones)
+  IDType *queryTranslationIds = NULL;
+  if (nTrans && (queryTranslationIds = (IDType *)calloc(nTrans, sizeof(IDType))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating translation ids\n");
+    exit(1);
+  }
+  for (i=0; i<nTrans; i++) {
+    if (translationIds[i]) {
+      queryTranslationIds[nTranslation++] = translationIds[i];
+    }
+  }
+
+  translationLinks = DBEntryAdaptor_fetchByObjectTypeList(dbea, queryTranslationIds, nTranslation, "Translation");
+  transcriptLinks  = DBEntryAdaptor_fetchByObjectTypeList(dbea, transcriptIds, nTrans, "Transcript");
+  free(queryTranslationIds);
+
+  // Same order as fetchAllByGene - translation links and then transcript links for each transcript
+  for (i=0; i<nTrans; i++) {
+    Gene *gene = IDHash_getValue(geneHash, ownerIds[i]);
+    Vector *links;
+
+    if (translationIds[i] && (links = IDHash_getValue(translationLinks, translationIds[i])) != NULL) {
+      for (j=0; j<Vector_getNumElement(links); j++) {
+        Gene_addDBLink(gene, Vector_getElementAt(links, j));
+      }
+    }
+
+    if ((links = IDHash_getValue(transcriptLinks, transcriptIds[i])) != NULL) {
+      for (j=0; j<Vector_getNumElement(links); j++) {
+        Gene_addDBLink(gene, Vector_getElementAt(links, j));
+      }
+    }
+  }
+
+  for (i=0; i<Vector_getNumElement(genes); i++) {
+    Gene *gene = Vector_getElementAt(genes, i);
+
+    if (gene->dbLinks == NULL && IDHash_getValue(geneHash, Gene_getDbID(gene)) == gene) {
+      gene->dbLinks = Vector_newFor(gene);
+    }
+  }
+
+  DBEntryAdaptor_freeLinksHash(translationLinks);
+  DBEntryAdaptor_freeLinksHash(transcriptLinks);
+  IDHash_free(geneHash, NULL);
+  free(ownerIds);
+  free(transcriptIds);
+  free(translationIds);
+
+  return 1;
+}
+
+/*
+ Set oriented DBEntryAdaptor_fetchAllByTranscript: adds the xrefs of each
+ transcript, and of its canonical translation, to the transcripts in the list.
+ As for DBEntryAdaptor_fetchAllByGeneList, transcripts which already have their
+ xrefs are left alone and ones without any get an empty list.
+*/
+int DBEntryAdaptor_fetchAllByTranscriptList(DBEntryAdaptor *dbea, Vector *transcripts) {
+  IDHash *transHash = IDHash_new(IDHASH_LARGE);
+  IDType *queryIds;
+  IDType *ownerIds;
+  IDType *transcriptIds;
+  IDType *translationIds;
+  IDType *queryTranslationIds = NULL;
+  IDHash *transcriptLinks;
+  IDHash *translationLinks;
+  int nQueryId;
+  int nTrans;
+  int nTranslation = 0;
+  int i;
+  int j;
+
+  for (i=0; i<Vector_getNumElement(transcripts); i++) {
+    Transcript *trans = Vector_getElementAt(transcripts, i);
+
+    if (trans->dbLinks == NULL && !IDHash_contains(transHash, Transcript_getDbID(trans))) {
+      IDHash_add(transHash, Transcript_getDbID(trans), trans);
+    }
+  }
+
+  queryIds = IDHash_getKeys(transHash);
+  nQueryId = IDHash_getNumValues(transHash);
+
+  nTrans = DBEntryAdaptor_fetchTranscriptTranslationIds(dbea, "transcript_id", queryIds, nQueryId,
+                                                        &ownerIds, &transcriptIds, &translationIds);
+
+  if (nTrans && (queryTranslationIds = (IDType *)calloc(nTrans, sizeof(IDType))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating translation ids\n");
+    exit(1);
+  }
+  for (i=0; i<nTrans; i++) {
+    if (translationIds[i]) {
+      queryTranslationIds[nTranslation++] = translationIds[i];
+    }
+  }
+
+  translationLinks = DBEntryAdaptor_fetchByObjectTypeList(dbea, queryTranslationIds, nTranslation, "Translation");
+  transcriptLinks  = DBEntryAdaptor_fetchByObjectTypeList(dbea, queryIds, nQueryId, "Transcript");
+  free(queryTranslationIds);
+
+  // Same order as fetchAllByTranscript - translation links and then transcript links
+  for (i=0; i<nTrans; i++) {
+    Transcript *trans = IDHash_getValue(transHash, transcriptIds[i]);
+    Vector *links;
+
+    if (translationIds[i] && (links = IDHash_getValue(translationLinks, translationIds[i])) != NULL) {
+      for (j=0; j<Vector_getNumElement(links); j++) {
+        Transcript_addDBLink(trans, Vector_getElementAt(links, j));
+      }
+    }
+
+    if ((links = IDHash_getValue(transcriptLinks, transcriptIds[i])) != NULL) {
+      for (j=0; j<Vector_getNumElement(links); j++) {
+        Transcript_addDBLink(trans, Vector_getElementAt(links, j));
+      }
+    }
+  }
+
+  for (i=0; i<Vector_getNumElement(transcripts); i++) {
+    Transcript *trans = Vector_getElementAt(transcripts, i);
+
+    if (trans->dbLinks == NULL && IDHash_getValue(transHash, Transcript_getDbID(trans)) == trans) {
+      trans->dbLinks = Vector_newFor(trans);
+    }
+  }
+
+  DBEntryAdaptor_freeLinksHash(translationLinks);
+  DBEntryAdaptor_freeLinksHash(transcriptLinks);
+  IDHash_free(transHash, NULL);
+  free(queryIds);
+  free(ownerIds);
+  free(transcriptIds);
+  free(translationIds);
+
+  return 1;
+}
+
 #ifdef DONE
 /*
 =head2 list_gene_ids_by_extids
@@ -32,6 +32,8 @@ IDType DBEntryAdaptor_store(DBEntryAdaptor *dbea, DBEntry *exObj,
                          IDType ensObject, char *ensType, int ignoreRelease);
 int DBEntryAdaptor_fetchAllByTranscript(DBEntryAdaptor *dbea, Transcript *trans);
 int DBEntryAdaptor_fetchAllByGene(DBEntryAdaptor *dbea, Gene *gene);
+int DBEntryAdaptor_fetchAllByGeneList(DBEntryAdaptor *dbea, Vector *genes);
+int DBEntryAdaptor_fetchAllByTranscriptList(DBEntryAdaptor *dbea, Vector *transcripts);
 Vector *DBEntryAdaptor_fetchAllByTranslation(DBEntryAdaptor *dbea, Translation *trans);
 
 
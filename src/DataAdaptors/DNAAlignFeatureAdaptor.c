@@ -27,6 +27,7 @@ superclasses.
 #include "DNAAlignFeatureAdaptor.h"
 
 #include "AnalysisAdaptor.h"
+#include "BatchInsertWriter.h"
 #include "DNAAlignFeature.h"
 #include "SliceAdaptor.h"
 #include "ChainedAssemblyMapper.h"
@@ -145,6 +146,10 @@ char **DNAAlignFeatureAdaptor_getColumns(void) {
 
 =cut
 */
+static void DNAAlignFeatureAdaptor_setFeatureDbID(void *feat, IDType dbID) {
+  DNAAlignFeature_setDbID((DNAAlignFeature *)feat, dbID);
+}
+
 int DNAAlignFeatureAdaptor_store(BaseFeatureAdaptor *bfa, Vector *features) {
 
   if (features == NULL || Vector_getNumElement(features) == 0) {
@@ -158,30 +163,26 @@ int DNAAlignFeatureAdaptor_store(BaseFeatureAdaptor *bfa, Vector *features) {
   DBAdaptor *db                    = bfa->dba;
   AnalysisAdaptor *analysisAdaptor = DBAdaptor_getAnalysisAdaptor(db);
 
-// Not very happy with this way of doing this - the undef values cause this to be ugly. Maybe should use bind parameters for storing
-  char qStr[1024];
-  sprintf(qStr,
-    "INSERT INTO %s (seq_region_id,"
-                    "seq_region_start,"
-                    "seq_region_end,"
-                    "seq_region_strand,"
-                    "hit_start,"
-                    "hit_end,"
-                    "hit_strand,"
-                    "hit_name,"
-                    "cigar_line,"
-                    "analysis_id,"
-                    "score,"
-                    "evalue,"
-                    "perc_ident,"
-                    "external_db_id,"
-                    "hcoverage) "
-          //"pair_dna_align_feature_id) "
-                    "VALUES (%" IDFMTSTR ",%%d,%%d,%%d,%%d,%%d,%%d,'%%s','%%s',%"IDFMTSTR
-                             ",%%s,%%s,%%s,%%s,%%s)", tableName);
-                            // changed to strings to allow for nulls ",%%f,%%f,%%f,%" IDFMTSTR ",%%f,%" IDFMTSTR ")", tableName);
-
-  StatementHandle *sth = bfa->prepare((BaseAdaptor *)bfa, qStr,strlen(qStr));
+// Rows are written in multi-row batches - the dbIDs get set on the features when each batch is flushed
+  char *columns[] = { "seq_region_id",
+                      "seq_region_start",
+                      "seq_region_end",
+                      "seq_region_strand",
+                      "hit_start",
+                      "hit_end",
+                      "hit_strand",
+                      "hit_name",
+                      "cigar_line",
+                      "analysis_id",
+                      "score",
+                      "evalue",
+                      "perc_ident",
+                      "external_db_id",
+                      "hcoverage",
+                      //"pair_dna_align_feature_id"
+                      NULL };
+
+  BatchInsertWriter *biw = BatchInsertWriter_new(db, tableName, columns, 0);
 
   int i;
   for (i=0; i<Vector_getNumElement(features); i++) {
@@ -240,58 +241,55 @@ int DNAAlignFeatureAdaptor_store(BaseFeatureAdaptor *bfa, Vector *features) {
     // ( $feat, $seq_region_id ) = $self->_pre_store($feat);
     IDType seqRegionId = BaseFeatureAdaptor_preStore(bfa, (SeqFeature*)feat);
 
-    char scoreString[1024];
-    DNAAlignFeature_getScore(feat) != FLOAT_UNDEF ? sprintf(scoreString,"%f",DNAAlignFeature_getScore(feat)) : sprintf(scoreString,"NULL");
-
-    char pValueString[1024];
-    DNAAlignFeature_getpValue(feat) != FLOAT_UNDEF ? sprintf(pValueString,"%f",DNAAlignFeature_getpValue(feat)) : sprintf(pValueString,"NULL");
-
-    char percIdString[1024];
-    DNAAlignFeature_getPercId(feat) != FLOAT_UNDEF ? sprintf(percIdString,"%f",DNAAlignFeature_getPercId(feat)) : sprintf(percIdString,"NULL");
-
-    char hCoverageString[1024];
-    DNAAlignFeature_gethCoverage(feat) != FLOAT_UNDEF ? sprintf(hCoverageString,"%f",DNAAlignFeature_gethCoverage(feat)) : sprintf(hCoverageString,"NULL");
+// Note using SeqRegionStart etc here rather than Start - should have same effect as perl's transfer
+    BatchInsertWriter_startRow(biw);
+    BatchInsertWriter_addLongLong(biw, seqRegionId);
+    BatchInsertWriter_addLong(biw, DNAAlignFeature_getSeqRegionStart((SeqFeature*)feat));
+    BatchInsertWriter_addLong(biw, DNAAlignFeature_getSeqRegionEnd((SeqFeature*)feat));
+    BatchInsertWriter_addInt(biw, DNAAlignFeature_getSeqRegionStrand((SeqFeature*)feat));
+    BatchInsertWriter_addInt(biw, DNAAlignFeature_getHitStart(feat));
+    BatchInsertWriter_addInt(biw, DNAAlignFeature_getHitEnd(feat));
+    BatchInsertWriter_addInt(biw, DNAAlignFeature_getHitStrand(feat));
+    BatchInsertWriter_addString(biw, DNAAlignFeature_getHitSeqName(feat));
+    BatchInsertWriter_addString(biw, cigarString);
+    BatchInsertWriter_addLongLong(biw, (IDType)Analysis_getDbID(analysis));
+
+    if (DNAAlignFeature_getScore(feat) != FLOAT_UNDEF) {
+      BatchInsertWriter_addDouble(biw, DNAAlignFeature_getScore(feat));
+    } else {
+      BatchInsertWriter_addNull(biw);
+    }
 
-    char externalDbIDString[1024];
-    DNAAlignFeature_getExternalDbID(feat) != 0 ? sprintf(externalDbIDString,IDFMTSTR,DNAAlignFeature_getExternalDbID(feat)) : sprintf(externalDbIDString,"NULL");
+    if (DNAAlignFeature_getpValue(feat) != FLOAT_UNDEF) {
+      BatchInsertWriter_addDouble(biw, DNAAlignFeature_getpValue(feat));
+    } else {
+      BatchInsertWriter_addNull(biw);
+    }
 
-    char pairDNAAlignIDString[1024];
-    DNAAlignFeature_getPairDNAAlignFeatureId(feat) != 0 ? sprintf(pairDNAAlignIDString,IDFMTSTR,DNAAlignFeature_getPairDNAAlignFeatureId(feat)) : sprintf(pairDNAAlignIDString,"NULL");
+    if (DNAAlignFeature_getPercId(feat) != FLOAT_UNDEF) {
+      BatchInsertWriter_addDouble(biw, DNAAlignFeature_getPercId(feat));
+    } else {
+      BatchInsertWriter_addNull(biw);
+    }
 
-// Note using SeqRegionStart etc here rather than Start - should have same effect as perl's transfer
-    
-    sth->execute(sth, (IDType)seqRegionId,
-                 DNAAlignFeature_getSeqRegionStart((SeqFeature*)feat),
-                 DNAAlignFeature_getSeqRegionEnd((SeqFeature*)feat),
-                 DNAAlignFeature_getSeqRegionStrand((SeqFeature*)feat),
-                      DNAAlignFeature_getHitStart(feat),
-                      DNAAlignFeature_getHitEnd(feat),
-                      DNAAlignFeature_getHitStrand(feat),
-                      DNAAlignFeature_getHitSeqName(feat),
-                      cigarString,
-                      (IDType)Analysis_getDbID(analysis),
-                      scoreString,
-                      pValueString,
-                      percIdString,
-                      externalDbIDString,
-                      hCoverageString,
-                      pairDNAAlignIDString);
-       
-/*
-                      DNAAlignFeature_getScore(feat),
-                      DNAAlignFeature_getpValue(feat),
-                      DNAAlignFeature_getPercId(feat),
-                      (IDType)DNAAlignFeature_getExternalDbID(feat),
-                      DNAAlignFeature_gethCoverage(feat),
-                      (IDType)DNAAlignFeature_getPairDNAAlignFeatureId(feat));
-*/
+    if (DNAAlignFeature_getExternalDbID(feat) != 0) {
+      BatchInsertWriter_addLongLong(biw, DNAAlignFeature_getExternalDbID(feat));
+    } else {
+      BatchInsertWriter_addNull(biw);
+    }
 
+    if (DNAAlignFeature_gethCoverage(feat) != FLOAT_UNDEF) {
+      BatchInsertWriter_addDouble(biw, DNAAlignFeature_gethCoverage(feat));
+    } else {
+      BatchInsertWriter_addNull(biw);
+    }
 
-    DNAAlignFeature_setDbID(feat,sth->getInsertId(sth));
     DNAAlignFeature_setAdaptor(feat, (BaseAdaptor *)bfa);
+    BatchInsertWriter_endRow(biw, feat, DNAAlignFeatureAdaptor_setFeatureDbID);
   }
 
-  sth->finish(sth);
+  // Flushes any remaining rows
+  BatchInsertWriter_free(biw);
 
   return 1;
 }
@@ -17,6 +17,7 @@
 #include "ExonAdaptor.h"
 #include "AnalysisAdaptor.h"
 #include "AssemblyMapperAdaptor.h"
+#include "BatchInsertWriter.h"
 #include "DBAdaptor.h"
 #include "DBEntryAdaptor.h"
 #include "StrUtil.h"
@@ -297,14 +298,74 @@ IDType ExonAdaptor_store(ExonAdaptor *ea, Exon *exon) {
     exit(1);
   }
 
-  Class_assertType(CLASS_EXON, exon->objectType);
+  Vector *exons = Vector_new();
+  Vector_addElement(exons, exon);
+
+  ExonAdaptor_storeAll(ea, exons);
+
+  Vector_free(exons);
+
+  return Exon_getDbID(exon);
+}
+
+static void ExonAdaptor_setExonDbID(void *exon, IDType dbID) {
+  Exon_setDbID((Exon *)exon, dbID);
+}
 
+/*
+=head2 storeAll
+
+  Arg [1]    : Vector of Exons
+  Example    : ExonAdaptor_storeAll(exonAdaptor, Transcript_getAllExons(transcript));
+  Description: As store, but the exon rows are written in multi-row batches
+               rather than one INSERT per exon. Exons which are already stored
+               (or which appear more than once in the Vector) are skipped.
+               The dbIDs and adaptors of the exons are set on return.
+  Returntype : none
+  Exceptions : as for store
+  Caller     : TranscriptAdaptor_store, general
+
+=cut
+*/
+void ExonAdaptor_storeAll(ExonAdaptor *ea, Vector *exons) {
   DBAdaptor *db = ea->dba;
 
-  if (Exon_isStored(exon, db)) {
-    fprintf(stderr, "Exon ["IDFMTSTR"] is already stored in this database.\n", Exon_getDbID(exon) );
-    return Exon_getDbID(exon);
-  }
+  char *columns[] = { "seq_region_id", "seq_region_start", "seq_region_end", "seq_region_strand",
+                      "phase", "end_phase", "is_current", "is_constitutive", NULL };
+  char *stableIdColumns[] = { "seq_region_id", "seq_region_start", "seq_region_end", "seq_region_strand",
+                              "phase", "end_phase", "is_current", "is_constitutive",
+                              "stable_id", "version", "created_date", "modified_date", NULL };
+
+  // Exons with and without stable ids have different column lists so need separate writers
+  BatchInsertWriter *biw         = BatchInsertWriter_new(db, "exon", columns, 0);
+  BatchInsertWriter *stableIdBiw = BatchInsertWriter_new(db, "exon", stableIdColumns, 0);
+  BatchInsertWriter_setUnixTimeColumn(stableIdBiw, 10);
+  BatchInsertWriter_setUnixTimeColumn(stableIdBiw, 11);
+
+  Vector *newExons = Vector_new();
+  // Keyed on exon pointer so shared exons only get written once
+  IDHash *seenExons = IDHash_new(IDHASH_SMALL);
+
+  int i;
+  for (i=0; i<Vector_getNumElement(exons); i++) {
+    Exon *exon = Vector_getElementAt(exons, i);
+
+    if (exon == NULL) {
+      fprintf(stderr, "feature is NULL in Exon_store\n");
+      exit(1);
+    }
+
+    Class_assertType(CLASS_EXON, exon->objectType);
+
+    if (Exon_isStored(exon, db)) {
+      fprintf(stderr, "Exon ["IDFMTSTR"] is already stored in this database.\n", Exon_getDbID(exon) );
+      continue;
+    }
+
+    if (IDHash_contains(seenExons, (IDType)(size_t)exon)) {
+      continue;
+    }
+    IDHash_add(seenExons, (IDType)(size_t)exon, exon);
 
 /* This check is odd - 0 would be OK for start or end if its on a slice which doesn't start at 1 in the seq region
    so this method is relying on being called after a transfer has been done in GeneAdaptor or TranscriptAdaptor.
@@ -314,19 +375,19 @@ IDType ExonAdaptor_store(ExonAdaptor *ea, Exon *exon) {
     throw("Exon does not have all attributes to store");
   }
 */
-  if (!Exon_getStrand(exon) || Exon_getPhase(exon) < -1 || Exon_getPhase(exon) > 2) {
-    fprintf(stderr,"Exon does not have all attributes to store\n");
-    exit(1);
-  }
+    if (!Exon_getStrand(exon) || Exon_getPhase(exon) < -1 || Exon_getPhase(exon) > 2) {
+      fprintf(stderr,"Exon does not have all attributes to store\n");
+      exit(1);
+    }
 
-  // Default to is_current = 1 if this attribute is not set
-  int isCurrent = Exon_getIsCurrent(exon);
+    // Default to is_current = 1 if this attribute is not set
+    int isCurrent = Exon_getIsCurrent(exon);
 /* Note in C isCurrent is initialised to 1 in Exon_new, so this check should be unnecessary 
   if ( !defined($is_current) ) { $is_current = 1 }
 */
 
-  // Default to is_constitutive = 0 if this attribute is not set
-  int isConstitutive = Exon_getIsConstitutive(exon);
+    // Default to is_constitutive = 0 if this attribute is not set
+    int isConstitutive = Exon_getIsConstitutive(exon);
 /* Note in C isConstitutive will be 0 by default because Exon_new uses calloc to allocate the Exon
   if ( !defined($is_constitutive) ) { $is_constitutive = 0 }
 */
@@ -337,70 +398,59 @@ IDType ExonAdaptor_store(ExonAdaptor *ea, Exon *exon) {
   my $seq_region_id;
   ($exon, $seq_region_id) = $self->_pre_store($exon);
 */
-  IDType seqRegionId = BaseFeatureAdaptor_preStore((BaseFeatureAdaptor *)ea, (SeqFeature*)exon);
+    IDType seqRegionId = BaseFeatureAdaptor_preStore((BaseFeatureAdaptor *)ea, (SeqFeature*)exon);
+
+    BatchInsertWriter *rowBiw = Exon_getStableId(exon) != NULL ? stableIdBiw : biw;
 
-  char qStr[2048];
-  strcpy(qStr,"INSERT into exon ( seq_region_id, seq_region_start, "
-		       "seq_region_end, seq_region_strand, phase, "
-		       "end_phase, is_current, is_constitutive");
+    BatchInsertWriter_startRow(rowBiw);
+    BatchInsertWriter_addLongLong(rowBiw, seqRegionId);
+    BatchInsertWriter_addLong(rowBiw, Exon_getSeqRegionStart((SeqFeature*)exon));
+    BatchInsertWriter_addLong(rowBiw, Exon_getSeqRegionEnd((SeqFeature*)exon));
+    BatchInsertWriter_addInt(rowBiw, Exon_getSeqRegionStrand((SeqFeature*)exon));
+    BatchInsertWriter_addInt(rowBiw, Exon_getPhase(exon));
+    BatchInsertWriter_addInt(rowBiw, Exon_getEndPhase(exon));
+    BatchInsertWriter_addInt(rowBiw, isCurrent);
+    BatchInsertWriter_addInt(rowBiw, isConstitutive);
 
-  int version;
-  if (Exon_getStableId(exon) != NULL) {
+    if (Exon_getStableId(exon) != NULL) {
 /*
     my $created = $self->db->dbc->from_seconds_to_date($exon->created_date());
     my $modified = $self->db->dbc->from_seconds_to_date($exon->modified_date());
 */
-    version = Exon_getVersion(exon) > 0 ? Exon_getVersion(exon) : 1;
-    strcat(qStr,", stable_id, version, created_date, modified_date");
-  }
-
-  sprintf(qStr, "%s) VALUES ("IDFMTSTR", %ld, %ld, %d, %d, %d, %d, %d",
-          qStr,
-          (IDType)seqRegionId,
-          Exon_getSeqRegionStart((SeqFeature*)exon),
-          Exon_getSeqRegionEnd((SeqFeature*)exon),
-          Exon_getSeqRegionStrand((SeqFeature*)exon),
-          Exon_getPhase(exon),
-          Exon_getEndPhase(exon),
-          isCurrent,
-          isConstitutive);
-          
-  if (Exon_getStableId(exon) != NULL) {
-    sprintf(qStr, "%s, '%s', %d, FROM_UNIXTIME(%ld), FROM_UNIXTIME(%ld))",
-            qStr,
-            Exon_getStableId(exon),
-            version,
-            Exon_getCreated(exon),
-            Exon_getModified(exon));
-  } else {
-    strcat(qStr,")");
-  }
-
-  StatementHandle *sth = ea->prepare((BaseAdaptor *)ea,qStr,strlen(qStr));
+      BatchInsertWriter_addString(rowBiw, Exon_getStableId(exon));
+      BatchInsertWriter_addInt(rowBiw, Exon_getVersion(exon) > 0 ? Exon_getVersion(exon) : 1);
+      BatchInsertWriter_addLong(rowBiw, Exon_getCreated(exon));
+      BatchInsertWriter_addLong(rowBiw, Exon_getModified(exon));
+    }
 
-  IDType exonId = 0;
+    BatchInsertWriter_endRow(rowBiw, exon, ExonAdaptor_setExonDbID);
 
-  // store the exon
-  sth->execute(sth);
+    Vector_addElement(newExons, exon);
+  }
 
-  exonId = sth->getInsertId(sth);
-  sth->finish(sth);
+  // Freeing flushes the remaining rows, which sets the dbIDs
+  BatchInsertWriter_free(biw);
+  BatchInsertWriter_free(stableIdBiw);
+  IDHash_free(seenExons, NULL);
 
   // Now the supporting evidence
   SupportingFeatureAdaptor *esfAdaptor = DBAdaptor_getSupportingFeatureAdaptor(db);
-  SupportingFeatureAdaptor_store(esfAdaptor, exonId, Exon_getAllSupportingFeatures(exon));
+  for (i=0; i<Vector_getNumElement(newExons); i++) {
+    Exon *exon = Vector_getElementAt(newExons, i);
 
-  // HISTORIC NOTE: This comment (the component exon bit) must be the last remnant of StickyExon code in
-  // the API - aaahhhh. Thank goodness the little b***ers are gone.
+    SupportingFeatureAdaptor_store(esfAdaptor, Exon_getDbID(exon), Exon_getAllSupportingFeatures(exon));
 
-  //
-  // Finally, update the dbID and adaptor of the exon (and any component exons)
-  // to point to the new database
-  //
-  Exon_setAdaptor(exon, (BaseAdaptor *)ea);
-  Exon_setDbID(exon, exonId);
+    // HISTORIC NOTE: This comment (the component exon bit) must be the last remnant of StickyExon code in
+    // the API - aaahhhh. Thank goodness the little b***ers are gone.
+
+    //
+    // Finally, update the adaptor of the exon (and any component exons)
+    // to point to the new database
+    //
+    Exon_setAdaptor(exon, (BaseAdaptor *)ea);
+  }
 
-  return exonId;
+  Vector_free(newExons);
 }
 
 
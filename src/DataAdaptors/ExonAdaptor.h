@@ -36,6 +36,7 @@ Exon *ExonAdaptor_fetchByStableId(ExonAdaptor *ea, char *stableId);
 Vector *ExonAdaptor_fetchAllVersionsByStableId(ExonAdaptor *ea, char *stableId);
 Vector *ExonAdaptor_fetchAllByTranscript(ExonAdaptor *ea, Transcript *transcript);
 IDType ExonAdaptor_store(ExonAdaptor *ea, Exon *exon);
+void ExonAdaptor_storeAll(ExonAdaptor *ea, Vector *exons);
 Vector *ExonAdaptor_listDbIDs(ExonAdaptor *ea, int ordered);
 Vector *ExonAdaptor_listStableIDs(ExonAdaptor *ea);
 Vector *ExonAdaptor_objectsFromStatementHandle(ExonAdaptor *ea, StatementHandle *sth, AssemblyMapper *assMapper, Slice *destSlice);
@@ -314,11 +314,14 @@ Gene *GeneAdaptor_fetchByStableId(GeneAdaptor *ga, char *stableId) {
 =cut
 */
 Vector *GeneAdaptor_fetchAllByBiotype(GeneAdaptor *ga, Vector *biotypes) {
-  char constraint[1024];
+  StrBuf *constraint = StrBuf_new(STRBUF_DEFAULTSIZE);
 
   GeneAdaptor_biotypeConstraint(ga, biotypes, constraint);
   
-  return GeneAdaptor_genericFetch(ga, constraint, NULL, NULL);
+  Vector *genes = GeneAdaptor_genericFetch(ga, StrBuf_getString(constraint), NULL, NULL);
+  StrBuf_free(constraint);
+
+  return genes;
 }
 
 
@@ -337,7 +340,8 @@ Vector *GeneAdaptor_fetchAllByBiotype(GeneAdaptor *ga, Vector *biotypes) {
 
 =cut
 */
-void GeneAdaptor_biotypeConstraint(GeneAdaptor *ga, Vector *biotypes, char *constraint) {
+// Appends the constraint for biotypes to constraint
+void GeneAdaptor_biotypeConstraint(GeneAdaptor *ga, Vector *biotypes, StrBuf *constraint) {
   
   if (biotypes == NULL || Vector_getNumElement(biotypes) == 0) {
     fprintf(stderr,"list of biotypes expected\n");
@@ -345,23 +349,25 @@ void GeneAdaptor_biotypeConstraint(GeneAdaptor *ga, Vector *biotypes, char *cons
   }
 
   if (Vector_getNumElement(biotypes) > 1) {
-    strcpy(constraint, "g.biotype IN (");
+    StrBuf_append(constraint, "g.biotype IN (");
 
     int i;
     for (i=0;i<Vector_getNumElement(biotypes); i++) {
       char *biotype = Vector_getElementAt(biotypes, i);
       
       if (i>0) {
-        strcat(constraint, ", ");
+        StrBuf_append(constraint, ", ");
       }
-      sprintf(constraint, "%s'%s'", constraint, biotype);
+      StrBuf_appendChar(constraint, '\'');
+      StrBuf_append(constraint, biotype);
+      StrBuf_appendChar(constraint, '\'');
     }
-    strcat(constraint, ") and g.is_current = 1");
+    StrBuf_append(constraint, ") and g.is_current = 1");
 
   } else { // just one
     char *biotype = Vector_getElementAt(biotypes, 0);
 
-    sprintf(constraint, "g.biotype = '%s' and g.is_current = 1", biotype);
+    StrBuf_appendf(constraint, "g.biotype = '%s' and g.is_current = 1", biotype);
   }
 
   return;
@@ -384,11 +390,14 @@ void GeneAdaptor_biotypeConstraint(GeneAdaptor *ga, Vector *biotypes, char *cons
 =cut
 */
 int GeneAdaptor_countAllByBiotype(GeneAdaptor *ga, Vector *biotypes) {
-  char constraint[1024];
+  StrBuf *constraint = StrBuf_new(STRBUF_DEFAULTSIZE);
 
   GeneAdaptor_biotypeConstraint(ga, biotypes, constraint);
   
-  return GeneAdaptor_genericCount(ga, constraint);
+  int count = GeneAdaptor_genericCount(ga, StrBuf_getString(constraint));
+  StrBuf_free(constraint);
+
+  return count;
 }
 
 Vector *GeneAdaptor_fetchAll(GeneAdaptor *ga) {
@@ -645,20 +654,21 @@ Vector *GeneAdaptor_fetchAllBySliceAndExternalDbnameLink(GeneAdaptor *ga, Slice
 */
 
 Vector *GeneAdaptor_fetchAllBySlice(GeneAdaptor *ga, Slice *slice, char *logicName, int loadTranscripts, char *source, char *biotype) {
-  char constraint[1024];
+  StrBuf *constraint = StrBuf_new(STRBUF_DEFAULTSIZE);
 
-  strcpy(constraint, "g.is_current = 1");
+  StrBuf_append(constraint, "g.is_current = 1");
 
   if (source != NULL) {
-    sprintf(constraint,"%s and g.source = '%s'", constraint, source);
+    StrBuf_appendf(constraint, " and g.source = '%s'", source);
   }
   if (biotype != NULL) {
-    sprintf(constraint,"%s and g.biotype = '%s'", constraint, biotype);
+    StrBuf_appendf(constraint, " and g.biotype = '%s'", biotype);
   }
 
   // Perl did a direct SUPER::fetch_all_by_Slice_constraint - not sure why???
 
-  Vector *genes = GeneAdaptor_fetchAllBySliceConstraint(ga, slice, constraint, logicName);
+  Vector *genes = GeneAdaptor_fetchAllBySliceConstraint(ga, slice, StrBuf_getString(constraint), logicName);
+  StrBuf_free(constraint);
 
   // If there are less than two genes, still do lazy-loading.
 // SMJS Tweaked so never does lazy loading
@@ -716,24 +726,15 @@ Vector *GeneAdaptor_fetchAllBySlice(GeneAdaptor *ga, Slice *slice, char *logicNa
 
   IDType *uniqueIds = IDHash_getKeys(gHash);
 
-  char *qStr = NULL;
-  if ((qStr = (char *)calloc(655500,sizeof(char))) == NULL) {
-    fprintf(stderr,"Failed allocating qStr\n");
-    return genes;
-  }
+  StrBuf *qStr = StrBuf_new(STRBUF_DEFAULTSIZE);
 
-  strcpy(qStr, "SELECT gene_id, transcript_id FROM   transcript WHERE  gene_id IN (");
-  for (i=0; i<IDHash_getNumValues(gHash); i++) {
-    if (i!=0) {
-      strcat(qStr, ", ");
-    }
-    sprintf(qStr, "%s"IDFMTSTR, qStr, uniqueIds[i]);
-  }
-  strcat(qStr,")");
+  StrBuf_append(qStr, "SELECT gene_id, transcript_id FROM   transcript WHERE  gene_id IN (");
+  StrBuf_appendIDList(qStr, uniqueIds, IDHash_getNumValues(gHash));
+  StrBuf_appendChar(qStr, ')');
 
   free(uniqueIds);
 
-  StatementHandle *sth = ga->prepare((BaseAdaptor *)ga,qStr,strlen(qStr));
+  StatementHandle *sth = ga->prepare((BaseAdaptor *)ga,StrBuf_getString(qStr),StrBuf_getLength(qStr));
   sth->execute(sth);
 
   IDHash *trGHash = IDHash_new(IDHASH_MEDIUM);
@@ -759,28 +760,14 @@ Vector *GeneAdaptor_fetchAllBySlice(GeneAdaptor *ga, Slice *slice, char *logicNa
 //sprintf("t.transcript_id IN (%s)", join(',', sort { $a <=> $b } keys(%tr_g_hash))));
 
 
-  char tmpStr[1024];
-  int lenNum;
-  int endPoint = sprintf(qStr, "t.transcript_id IN (");
-  for (i=0; i<IDHash_getNumValues(trGHash); i++) {
-    if (i!=0) {
-      qStr[endPoint++] = ',';
-      qStr[endPoint++] = ' ';
-      //strcat(qStr, ", ");
-    }
-    //fprintf(stderr, "id %d %s\n", i, tmpStr);
-    //sprintf(qStr, "%s"IDFMTSTR, qStr, uniqueIds[i]);
-    lenNum = sprintf(tmpStr,IDFMTSTR,uniqueIds[i]);
-    memcpy(&(qStr[endPoint]), tmpStr, lenNum);
-    endPoint+=lenNum;
-  }
-  //strcat(qStr,")");
-  qStr[endPoint++] = ')';
-  qStr[endPoint] = '\0';
+  StrBuf_clear(qStr);
+  StrBuf_append(qStr, "t.transcript_id IN (");
+  StrBuf_appendIDList(qStr, uniqueIds, IDHash_getNumValues(trGHash));
+  StrBuf_appendChar(qStr, ')');
 
   free(uniqueIds);
 
-  Vector *transcripts = TranscriptAdaptor_fetchAllBySlice(ta, extSlice, 1, NULL, qStr /*which is transcript constraint*/);
+  Vector *transcripts = TranscriptAdaptor_fetchAllBySlice(ta, extSlice, 1, NULL, StrBuf_getString(qStr) /*which is transcript constraint*/);
 
   // Move transcripts onto gene slice, and add them to genes.
   Vector *exons = Vector_new();
@@ -814,7 +801,7 @@ Vector *GeneAdaptor_fetchAllBySlice(GeneAdaptor *ga, Slice *slice, char *logicNa
   Vector *tmpVec = SupportingFeatureAdaptor_fetchAllByExonList(sfa, exons, slice);
   Vector_free(tmpVec);
   Vector_free(exons);
-  free(qStr);
+  StrBuf_free(qStr);
 
   return genes;
 }
@@ -837,19 +824,21 @@ Vector *GeneAdaptor_fetchAllBySlice(GeneAdaptor *ga, Slice *slice, char *logicNa
 =cut
 */
 int GeneAdaptor_countAllBySlice(GeneAdaptor *ga, Slice *slice, Vector *biotypes, char *source) {
-  char constraint[1024];
+  StrBuf *constraint = StrBuf_new(STRBUF_DEFAULTSIZE);
 
-  strcpy(constraint, "g.is_current = 1");
+  StrBuf_append(constraint, "g.is_current = 1");
   if (source != NULL) {
-    sprintf(constraint,"%s and g.source = '%s'", constraint, source);
+    StrBuf_appendf(constraint, " and g.source = '%s'", source);
   }
   if (biotypes != NULL) {
-    char biotypeConstraint[1024];
-    GeneAdaptor_biotypeConstraint(ga, biotypes, biotypeConstraint);
-    sprintf(constraint, "%s AND %s", constraint, biotypeConstraint);
+    StrBuf_append(constraint, " AND ");
+    GeneAdaptor_biotypeConstraint(ga, biotypes, constraint);
   }
 
-  return GeneAdaptor_countBySliceConstraint(ga, slice, constraint, NULL);
+  int count = GeneAdaptor_countBySliceConstraint(ga, slice, StrBuf_getString(constraint), NULL);
+  StrBuf_free(constraint);
+
+  return count;
 }
 
 /*
@@ -1415,7 +1404,7 @@ IDType GeneAdaptor_store(GeneAdaptor *ga, Gene *gene, int ignoreRelease)  {
   IDType seqRegionId = BaseFeatureAdaptor_preStore((BaseFeatureAdaptor *)ga, (SeqFeature*)gene); 
 
   char fmtStr[1024];
-  char qStr[1024];
+  StrBuf *qStr = StrBuf_new(STRBUF_DEFAULTSIZE);
  
   // Canonical transcript ID will be updated later.
   // Set it to zero for now.
@@ -1458,7 +1447,7 @@ IDType GeneAdaptor_store(GeneAdaptor *ga, Gene *gene, int ignoreRelease)  {
   char statusQStr[1024];
   Gene_getStatus(gene) ? sprintf(statusQStr,"'%s'", Gene_getStatus(gene)) : sprintf(statusQStr, "NULL");
 
-  sprintf(qStr, fmtStr, descQStr, sourceQStr, statusQStr);
+  StrBuf_appendf(qStr, fmtStr, descQStr, sourceQStr, statusQStr);
 
   if (Gene_getStableId(gene)) {
 /* Use FROM_UNIXTIME for now
@@ -1467,11 +1456,11 @@ IDType GeneAdaptor_store(GeneAdaptor *ga, Gene *gene, int ignoreRelease)  {
 */
   
     int version = Gene_getVersion(gene) > 0 ? Gene_getVersion(gene) : 1; // Assume version will be positive, Gene sets it to -1 when initialised
-    sprintf(qStr,"%s, stable_id = '%s', version = %d, created_date = FROM_UNIXTIME(%ld), modified_date = FROM_UNIXTIME(%ld)",
-            qStr, Gene_getStableId(gene), version, Gene_getCreated(gene), Gene_getModified(gene));
+    StrBuf_appendf(qStr, ", stable_id = '%s', version = %d, created_date = FROM_UNIXTIME(%ld), modified_date = FROM_UNIXTIME(%ld)",
+                   Gene_getStableId(gene), version, Gene_getCreated(gene), Gene_getModified(gene));
   }
 
-  StatementHandle *sth = ga->prepare((BaseAdaptor *)ga,qStr,strlen(qStr));
+  StatementHandle *sth = ga->prepare((BaseAdaptor *)ga,StrBuf_getString(qStr),StrBuf_getLength(qStr));
 
   sth->execute(sth);
 // NIY??? Finish was before insert id call?? Moved before
@@ -1551,9 +1540,10 @@ IDType GeneAdaptor_store(GeneAdaptor *ga, Gene *gene, int ignoreRelease)  {
   if (newCanonicalTranscriptId) {
     // Now the canonical transcript has been stored, so update the
     // canonical_transcript_id of this gene with the new dbID.
-    sprintf(qStr,"UPDATE gene SET canonical_transcript_id = "IDFMTSTR" WHERE gene_id = "IDFMTSTR,newCanonicalTranscriptId, geneId);
+    StrBuf_clear(qStr);
+    StrBuf_appendf(qStr,"UPDATE gene SET canonical_transcript_id = "IDFMTSTR" WHERE gene_id = "IDFMTSTR,newCanonicalTranscriptId, geneId);
 
-    sth = ga->prepare((BaseAdaptor *)ga,qStr,strlen(qStr));
+    sth = ga->prepare((BaseAdaptor *)ga,StrBuf_getString(qStr),StrBuf_getLength(qStr));
 
     sth->execute(sth);
     sth->finish(sth);
@@ -1573,9 +1563,10 @@ IDType GeneAdaptor_store(GeneAdaptor *ga, Gene *gene, int ignoreRelease)  {
 
 //    if (defined($dxref_id)) {
     if (dxrefId) {
-      sprintf(qStr, "UPDATE gene SET display_xref_id = "IDFMTSTR" WHERE gene_id = "IDFMTSTR, dxrefId, geneId);
+      StrBuf_clear(qStr);
+      StrBuf_appendf(qStr, "UPDATE gene SET display_xref_id = "IDFMTSTR" WHERE gene_id = "IDFMTSTR, dxrefId, geneId);
 
-      StatementHandle *sth = ga->prepare((BaseAdaptor *)ga,qStr,strlen(qStr));
+      StatementHandle *sth = ga->prepare((BaseAdaptor *)ga,StrBuf_getString(qStr),StrBuf_getLength(qStr));
 
       sth->execute(sth);
       sth->finish(sth);
@@ -1614,6 +1605,8 @@ IDType GeneAdaptor_store(GeneAdaptor *ga, Gene *gene, int ignoreRelease)  {
   Gene_setAdaptor(gene, (BaseAdaptor *)ga);
   Gene_setDbID(gene,geneId);
 
+  StrBuf_free(qStr);
+
   return Gene_getDbID(gene);
 }
 
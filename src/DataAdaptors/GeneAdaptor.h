@@ -42,7 +42,7 @@ Gene *GeneAdaptor_fetchByDisplayLabel(GeneAdaptor *ga, char *label);
 Vector *GeneAdaptor_fetchAllByDisplayLabel(GeneAdaptor *ga, char *label);
 Gene *GeneAdaptor_fetchByStableId(GeneAdaptor *ga, char *stableId);
 Vector *GeneAdaptor_fetchAllByBiotype(GeneAdaptor *ga, Vector *biotypes);
-void GeneAdaptor_biotypeConstraint(GeneAdaptor *ga, Vector *biotypes, char *constraint);
+void GeneAdaptor_biotypeConstraint(GeneAdaptor *ga, Vector *biotypes, StrBuf *constraint);
 int GeneAdaptor_countAllByBiotype(GeneAdaptor *ga, Vector *biotypes);
 Vector *GeneAdaptor_fetchAll(GeneAdaptor *ga);
 Vector *GeneAdaptor_fetchAllVersionsByStableId(GeneAdaptor *ga, char *stableId);
@@ -16,6 +16,7 @@
 
 #include "MetaCoordContainer.h"
 #include "StrUtil.h"
+#include "StrBuf.h"
 #include "BaseAdaptor.h"
 #include "MysqlUtil.h"
 #include "StatementHandle.h"
@@ -43,10 +44,9 @@ MetaCoordContainer *MetaCoordContainer_new(DBAdaptor *dba) {
   Vector *coordSystems = CoordSystemAdaptor_fetchAll(csa);
 
   StatementHandle *sth;
-  char tmpStr[1024];
-  char qStr[1024];
+  StrBuf *qStr = StrBuf_new(STRBUF_DEFAULTSIZE);
 
-  sprintf(qStr,
+  StrBuf_append(qStr,
           "SELECT mc.table_name, mc.coord_system_id, mc.max_length "
                  "FROM meta_coord mc "
                  "WHERE mc.coord_system_id in (");
@@ -55,14 +55,14 @@ MetaCoordContainer *MetaCoordContainer_new(DBAdaptor *dba) {
   for (i=0; i<Vector_getNumElement(coordSystems); i++) {
     CoordSystem *cs = Vector_getElementAt(coordSystems, i);
     if (i!=0) {
-      strcat(qStr,", ");
+      StrBuf_append(qStr,", ");
     }
-    sprintf(tmpStr,IDFMTSTR,CoordSystem_getDbID(cs));
-    strcat(qStr, tmpStr);
+    StrBuf_appendf(qStr,IDFMTSTR,CoordSystem_getDbID(cs));
   }
-  strcat(qStr,")");
+  StrBuf_append(qStr,")");
 
-  sth = mcc->prepare((BaseAdaptor *)mcc,qStr,strlen(qStr)); 
+  sth = mcc->prepare((BaseAdaptor *)mcc,StrBuf_getString(qStr),StrBuf_getLength(qStr)); 
+  StrBuf_free(qStr);
   sth->execute(sth);
 
   ResultRow *row;
@@ -0,0 +1,394 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define __MYSQLBINARYRESULTROW_MAIN__
+#include "MysqlBinaryResultRow.h"
+#undef __MYSQLBINARYRESULTROW_MAIN__
+
+#include "StrUtil.h"
+#include "Class.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Initial size of string column buffers - grown when a value is truncated
+#define BINROW_INITIAL_BUFSIZE 64
+
+static char *MysqlBinaryResultRow_formatNumber(MysqlBinaryColumn *col);
+static double MysqlBinaryResultRow_floatToDouble(float f);
+static double MysqlBinaryResultRow_floatToDoubleSlow(float f);
+
+
+MysqlBinaryResultRow *MysqlBinaryResultRow_new(MYSQL_FIELD *fields, int nField, MYSQL_BIND *binds) {
+  MysqlBinaryResultRow *rr;
+  int i;
+
+  if ((rr = (MysqlBinaryResultRow *)calloc(1,sizeof(MysqlBinaryResultRow))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating space for binary rr\n");
+    return NULL;
+  }
+
+  rr->objectType = CLASS_MYSQLBINARYRESULTROW;
+
+  rr->funcs = &mysqlBinaryResultRowFuncs;
+
+  rr->getStringAt     = MysqlBinaryResultRow_getStringAt;
+  rr->getStringAllowNullAt = MysqlBinaryResultRow_getStringAllowNullAt;
+  rr->getStringCopyAt = MysqlBinaryResultRow_getStringCopyAt;
+  rr->getIntAt        = MysqlBinaryResultRow_getIntAt;
+  rr->getLongAt       = MysqlBinaryResultRow_getLongAt;
+  rr->getLongLongAt   = MysqlBinaryResultRow_getLongLongAt;
+  rr->getDoubleAt     = MysqlBinaryResultRow_getDoubleAt;
+  rr->col             = MysqlBinaryResultRow_col;
+  rr->getStringViewAt = MysqlBinaryResultRow_getStringViewAt;
+  rr->isNullAt        = MysqlBinaryResultRow_isNullAt;
+
+  rr->nField = nField;
+
+  if ((rr->cols = (MysqlBinaryColumn *)calloc(nField, sizeof(MysqlBinaryColumn))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating binary row columns\n");
+    free(rr);
+    return NULL;
+  }
+
+  for (i=0; i<nField; i++) {
+    MysqlBinaryColumn *col = &(rr->cols[i]);
+    MYSQL_BIND *bind = &(binds[i]);
+
+    memset(bind, 0, sizeof(MYSQL_BIND));
+
+    switch (fields[i].type) {
+      case MYSQL_TYPE_TINY:
+      case MYSQL_TYPE_SHORT:
+      case MYSQL_TYPE_LONG:
+      case MYSQL_TYPE_INT24:
+      case MYSQL_TYPE_LONGLONG:
+      case MYSQL_TYPE_YEAR:
+        col->type        = MYSQLBINCOL_INT;
+        col->isUnsigned  = (fields[i].flags & UNSIGNED_FLAG) ? 1 : 0;
+        bind->buffer_type = MYSQL_TYPE_LONGLONG;
+        bind->buffer      = &(col->val.intVal);
+        bind->is_unsigned = col->isUnsigned;
+        break;
+
+      case MYSQL_TYPE_FLOAT:
+        col->type        = MYSQLBINCOL_FLOAT;
+        bind->buffer_type = MYSQL_TYPE_FLOAT;
+        bind->buffer      = &(col->val.floatVal);
+        break;
+
+      case MYSQL_TYPE_DOUBLE:
+      case MYSQL_TYPE_DECIMAL:
+      case MYSQL_TYPE_NEWDECIMAL:
+        col->type        = MYSQLBINCOL_DOUBLE;
+        bind->buffer_type = MYSQL_TYPE_DOUBLE;
+        bind->buffer      = &(col->val.doubleVal);
+        break;
+
+      default:
+        // Strings, blobs, enums, sets, dates and times all come back as text
+        col->type        = MYSQLBINCOL_STRING;
+        bind->buffer_type = MYSQL_TYPE_STRING;
+        if (!MysqlBinaryResultRow_growStringBuffer(rr, i, bind, BINROW_INITIAL_BUFSIZE)) {
+          MysqlBinaryResultRow_free(rr);
+          return NULL;
+        }
+        break;
+    }
+
+    bind->length  = &(col->length);
+    bind->is_null = &(col->isNull);
+    bind->error   = &(col->error);
+  }
+
+  return rr;
+}
+
+int MysqlBinaryResultRow_growStringBuffer(MysqlBinaryResultRow *row, int ind, MYSQL_BIND *bind, unsigned long size) {
+  MysqlBinaryColumn *col = &(row->cols[ind]);
+
+  if (size <= col->bufSize) {
+    return 1;
+  }
+
+  if ((col->buf = (char *)realloc(col->buf, size)) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating result buffer of size %lu for column %d\n", size, ind);
+    return 0;
+  }
+  col->bufSize = size;
+
+  // Leave space for a terminating '\0'
+  bind->buffer        = col->buf;
+  bind->buffer_length = size-1;
+
+  return 1;
+}
+
+/*
+ Called by the statement handle once a row has been fetched into the bound
+ buffers - terminates the strings and invalidates any formatted numbers from
+ the previous row.
+*/
+void MysqlBinaryResultRow_startRow(MysqlBinaryResultRow *row) {
+  int i;
+
+  for (i=0; i<row->nField; i++) {
+    MysqlBinaryColumn *col = &(row->cols[i]);
+
+    if (col->type == MYSQLBINCOL_STRING) {
+      if (col->isNull) {
+        col->length = 0;
+      } else if (col->length > col->bufSize-1) {
+        col->length = col->bufSize-1;
+      }
+      col->buf[col->length] = '\0';
+    } else {
+      col->numStrValid = 0;
+    }
+  }
+}
+
+/*
+ Gives the shortest decimal representation which converts back to the same
+ float, which is what the text protocol sends, so eg. 0.3f comes back as 0.3
+ rather than 0.30000001192092896
+
+ This is on the path of every FLOAT column read (scores, percent ids) so it is
+ done arithmetically rather than by printing and reparsing. Rounding to an
+ integer digit string n and dividing by an exactly representable power of ten
+ (<= 1e22) is a single correctly rounded operation, so gives the same double
+ as strtod would for that digit string.
+*/
+static double floatPow10[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+#define FLOATPOW10MAX 22
+
+// Used for the rare values too large or small for the power of ten table
+static double MysqlBinaryResultRow_floatToDoubleSlow(float f) {
+  char tmp[32];
+  int prec;
+
+  for (prec = 6; prec <= 9; prec++) {
+    sprintf(tmp, "%.*g", prec, (double)f);
+    double d = strtod(tmp, NULL);
+    if ((float)d == f) {
+      return d;
+    }
+  }
+  return (double)f;
+}
+
+static double MysqlBinaryResultRow_floatToDouble(float f) {
+  double d = (double)f;
+  double absD = d < 0.0 ? -d : d;
+  int exp10 = 0;
+  int prec;
+
+  if (absD == 0.0 || absD != absD || absD > 3.5e38) {
+    return d;
+  }
+
+  if (absD >= floatPow10[FLOATPOW10MAX] || absD < 1.0 / floatPow10[FLOATPOW10MAX]) {
+    return MysqlBinaryResultRow_floatToDoubleSlow(f);
+  }
+
+  // Decimal exponent of the leading digit
+  if (absD >= 1.0) {
+    while (absD >= floatPow10[exp10+1]) exp10++;
+  } else {
+    while (absD < 1.0 / floatPow10[-exp10]) exp10--;
+  }
+
+  for (prec = 6; prec <= 9; prec++) {
+    int nDecimal = prec - 1 - exp10;
+    double scaled;
+    double n;
+    double r;
+
+    if (nDecimal > FLOATPOW10MAX || nDecimal < -FLOATPOW10MAX) {
+      return MysqlBinaryResultRow_floatToDoubleSlow(f);
+    }
+    scaled = nDecimal >= 0 ? absD * floatPow10[nDecimal] : absD / floatPow10[-nDecimal];
+    n = (double)(long long)(scaled + 0.5);
+    // Ties go to even, as printf does
+    if (n - scaled == 0.5 && ((long long)n & 1)) n -= 1.0;
+    r = nDecimal >= 0 ? n / floatPow10[nDecimal] : n * floatPow10[-nDecimal];
+    if (d < 0.0) r = -r;
+
+    if ((float)r == f) {
+      return r;
+    }
+  }
+  return d;
+}
+
+static char *MysqlBinaryResultRow_formatNumber(MysqlBinaryColumn *col) {
+  if (!col->numStrValid) {
+    if (col->type == MYSQLBINCOL_INT) {
+      if (col->isUnsigned) {
+        sprintf(col->numStr, "%llu", (unsigned long long)col->val.intVal);
+      } else {
+        sprintf(col->numStr, "%lld", col->val.intVal);
+      }
+    } else if (col->type == MYSQLBINCOL_FLOAT) {
+      sprintf(col->numStr, "%.9g", MysqlBinaryResultRow_floatToDouble(col->val.floatVal));
+    } else {
+      int prec;
+      for (prec = 15; prec <= 17; prec++) {
+        sprintf(col->numStr, "%.*g", prec, col->val.doubleVal);
+        if (strtod(col->numStr, NULL) == col->val.doubleVal) break;
+      }
+    }
+    col->numStrValid = 1;
+  }
+  return col->numStr;
+}
+
+char *MysqlBinaryResultRow_getStringViewAt(ResultRow *row, int ind, unsigned long *lenP) {
+  MysqlBinaryResultRow *b_row;
+  MysqlBinaryColumn *col;
+
+  Class_assertType(CLASS_MYSQLBINARYRESULTROW, row->objectType);
+
+  b_row = (MysqlBinaryResultRow *)row;
+  col = &(b_row->cols[ind]);
+
+  if (col->isNull) {
+    *lenP = 0;
+    return NULL;
+  }
+
+  if (col->type == MYSQLBINCOL_STRING) {
+    *lenP = col->length;
+    return col->buf;
+  }
+
+  char *numStr = MysqlBinaryResultRow_formatNumber(col);
+  *lenP = strlen(numStr);
+  return numStr;
+}
+
+int MysqlBinaryResultRow_isNullAt(ResultRow *row, int ind) {
+  Class_assertType(CLASS_MYSQLBINARYRESULTROW, row->objectType);
+
+  return ((MysqlBinaryResultRow *)row)->cols[ind].isNull;
+}
+
+char *MysqlBinaryResultRow_col(ResultRow *row, int ind) {
+  unsigned long len;
+
+  return MysqlBinaryResultRow_getStringViewAt(row, ind, &len);
+}
+
+char *MysqlBinaryResultRow_getStringAllowNullAt(ResultRow *row, int ind) {
+  unsigned long len;
+
+  return MysqlBinaryResultRow_getStringViewAt(row, ind, &len);
+}
+
+// Doesn't make a copy of string
+char *MysqlBinaryResultRow_getStringAt(ResultRow *row, int ind) {
+  unsigned long len;
+  char *str = MysqlBinaryResultRow_getStringViewAt(row, ind, &len);
+
+  return str ? str : "";
+}
+
+// Makes a copy of string
+char *MysqlBinaryResultRow_getStringCopyAt(ResultRow *row, int ind) {
+  unsigned long len;
+  char *str = MysqlBinaryResultRow_getStringViewAt(row, ind, &len);
+  char *copy;
+
+  if (str == NULL) {
+    str = "";
+  }
+
+  if ((copy = (char *)malloc(len+1)) == NULL) {
+    fprintf(stderr,"ERROR: Failed copying mysql col\n");
+    return NULL;
+  }
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+
+  return copy;
+}
+
+IDType MysqlBinaryResultRow_getLongLongAt(ResultRow *row, int ind) {
+  MysqlBinaryColumn *col;
+
+  Class_assertType(CLASS_MYSQLBINARYRESULTROW, row->objectType);
+
+  col = &(((MysqlBinaryResultRow *)row)->cols[ind]);
+
+  if (col->isNull) {
+    return 0;
+  }
+
+  switch (col->type) {
+    case MYSQLBINCOL_INT:
+      return (IDType)col->val.intVal;
+    case MYSQLBINCOL_FLOAT:
+      return (IDType)col->val.floatVal;
+    case MYSQLBINCOL_DOUBLE:
+      return (IDType)col->val.doubleVal;
+    default:
+      return (IDType)strtoll(col->buf, NULL, 10);
+  }
+}
+
+int MysqlBinaryResultRow_getIntAt(ResultRow *row, int ind) {
+  return (int)MysqlBinaryResultRow_getLongLongAt(row, ind);
+}
+
+long MysqlBinaryResultRow_getLongAt(ResultRow *row, int ind) {
+  return (long)MysqlBinaryResultRow_getLongLongAt(row, ind);
+}
+
+double MysqlBinaryResultRow_getDoubleAt(ResultRow *row, int ind) {
+  MysqlBinaryColumn *col;
+
+  Class_assertType(CLASS_MYSQLBINARYRESULTROW, row->objectType);
+
+  col = &(((MysqlBinaryResultRow *)row)->cols[ind]);
+
+  if (col->isNull) {
+    return 0.0;
+  }
+
+  switch (col->type) {
+    case MYSQLBINCOL_INT:
+      return col->isUnsigned ? (double)(unsigned long long)col->val.intVal : (double)col->val.intVal;
+    case MYSQLBINCOL_FLOAT:
+      return MysqlBinaryResultRow_floatToDouble(col->val.floatVal);
+    case MYSQLBINCOL_DOUBLE:
+      return col->val.doubleVal;
+    default:
+      return atof(col->buf);
+  }
+}
+
+void MysqlBinaryResultRow_free(MysqlBinaryResultRow *row) {
+  int i;
+
+  if (row->cols) {
+    for (i=0; i<row->nField; i++) {
+      if (row->cols[i].buf) free(row->cols[i].buf);
+    }
+    free(row->cols);
+  }
+  free(row);
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MYSQLBINARYRESULTROW_H__
+#define __MYSQLBINARYRESULTROW_H__
+
+#include <mysql.h>
+#include "ResultRow.h"
+
+// MySQL 8 dropped the my_bool typedef in favour of bool
+#if !defined(MARIADB_BASE_VERSION) && defined(MYSQL_VERSION_ID) && MYSQL_VERSION_ID >= 80001
+ #include <stdbool.h>
+ typedef bool my_bool;
+#endif
+
+/*
+ ResultRow for binary protocol (prepared statement) results.
+
+ Each column is bound to a buffer of its natural type, chosen from the
+ result metadata when the statement is prepared: integer columns are
+ decoded straight into a long long and float/double/decimal columns into
+ a float or double, so the numeric accessors don't do any text parsing.
+ String, blob, date and enum columns are bound to growable char buffers
+ which getStringAt and getStringViewAt return without copying.
+
+ Numeric columns asked for as strings are formatted on demand into a small
+ per column buffer. The same value is returned as would have come back as
+ text, eg. a FLOAT column holding 0.3 gives "0.3" and 0.3 not 0.300000012.
+
+ All pointers returned are only valid until the next fetchRow.
+*/
+
+typedef enum MysqlBinaryColumnTypeEnum {
+  MYSQLBINCOL_INT,
+  MYSQLBINCOL_FLOAT,
+  MYSQLBINCOL_DOUBLE,
+  MYSQLBINCOL_STRING
+} MysqlBinaryColumnType;
+
+typedef struct MysqlBinaryColumnStruct {
+  MysqlBinaryColumnType type;
+  union {
+    long long intVal;
+    float     floatVal;
+    double    doubleVal;
+  } val;
+  char         *buf;
+  unsigned long bufSize;
+  unsigned long length;
+  my_bool       isNull;
+  my_bool       error;
+  my_bool       isUnsigned;
+  int           numStrValid;
+  char          numStr[32];
+} MysqlBinaryColumn;
+
+typedef struct MysqlBinaryResultRowStruct MysqlBinaryResultRow;
+
+MysqlBinaryResultRow *MysqlBinaryResultRow_new(MYSQL_FIELD *fields, int nField, MYSQL_BIND *binds);
+int       MysqlBinaryResultRow_growStringBuffer(MysqlBinaryResultRow *row, int ind, MYSQL_BIND *bind, unsigned long size);
+void      MysqlBinaryResultRow_startRow(MysqlBinaryResultRow *row);
+
+char *    MysqlBinaryResultRow_getStringAt(ResultRow *row, int ind);
+char *    MysqlBinaryResultRow_getStringCopyAt(ResultRow *row, int ind);
+char *    MysqlBinaryResultRow_getStringAllowNullAt(ResultRow *row, int ind);
+int       MysqlBinaryResultRow_getIntAt(ResultRow *row, int ind);
+long      MysqlBinaryResultRow_getLongAt(ResultRow *row, int ind);
+IDType    MysqlBinaryResultRow_getLongLongAt(ResultRow *row, int ind);
+double    MysqlBinaryResultRow_getDoubleAt(ResultRow *row, int ind);
+char *    MysqlBinaryResultRow_col(ResultRow *row, int ind);
+char *    MysqlBinaryResultRow_getStringViewAt(ResultRow *row, int ind, unsigned long *lenP);
+int       MysqlBinaryResultRow_isNullAt(ResultRow *row, int ind);
+
+void      MysqlBinaryResultRow_free(MysqlBinaryResultRow *row);
+
+OBJECTFUNC_TYPES(MysqlBinaryResultRow)
+
+typedef struct MysqlBinaryResultRowFuncsStruct {
+  OBJECTFUNCS_DATA(MysqlBinaryResultRow)
+} MysqlBinaryResultRowFuncs;
+
+
+#define MYSQLBINARYRESULTROW_DATA \
+  RESULTROW_DATA \
+  int nField; \
+  MysqlBinaryColumn *cols;
+
+#define FUNCSTRUCTTYPE MysqlBinaryResultRowFuncs
+struct MysqlBinaryResultRowStruct {
+  MYSQLBINARYRESULTROW_DATA
+};
+#undef FUNCSTRUCTTYPE
+
+#define MysqlBinaryResultRow_getNumField(row) (row)->nField
+
+#ifdef __MYSQLBINARYRESULTROW_MAIN__
+  MysqlBinaryResultRowFuncs
+    mysqlBinaryResultRowFuncs = {
+                      MysqlBinaryResultRow_free,
+                      NULL, // shallowCopy
+                      NULL  // deepCopy
+                     };
+#else
+  extern MysqlBinaryResultRowFuncs mysqlBinaryResultRowFuncs;
+#endif
+
+
+#endif
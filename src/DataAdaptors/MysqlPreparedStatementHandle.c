@@ -0,0 +1,453 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define __MYSQLPREPAREDSTATEMENTHANDLE_MAIN__
+#include "MysqlPreparedStatementHandle.h"
+#undef __MYSQLPREPAREDSTATEMENTHANDLE_MAIN__
+#include "MysqlStatementHandle.h"
+#include "MysqlBinaryResultRow.h"
+#include "StrUtil.h"
+#include "mysql.h"
+#include "EnsC.h"
+
+#include "Error.h"
+#include "Class.h"
+
+#include <string.h>
+
+static void MysqlPreparedStatementHandle_reportError(MysqlPreparedStatementHandle *m_sth, char *action);
+static void MysqlPreparedStatementHandle_checkParamNum(MysqlPreparedStatementHandle *m_sth, int paramNum);
+static void MysqlPreparedStatementHandle_resetParams(MysqlPreparedStatementHandle *m_sth);
+static int MysqlPreparedStatementHandle_checkParamsBound(MysqlPreparedStatementHandle *m_sth);
+
+
+/*
+ reportErrors is 0 for callers which fall back to the text protocol when the
+ server won't prepare the statement, so a failed prepare is returned as NULL
+ without complaint.
+*/
+StatementHandle *MysqlPreparedStatementHandle_new(DBConnection *dbc, char *query, int queryLen, int reportErrors) {
+  MysqlPreparedStatementHandle *sth;
+
+  if ((sth = (MysqlPreparedStatementHandle *)calloc(1,sizeof(MysqlPreparedStatementHandle))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating space for prepared sth\n");
+    return NULL;
+  }
+
+  sth->objectType = CLASS_MYSQLPREPAREDSTATEMENTHANDLE;
+
+  sth->funcs = &mysqlPreparedStatementHandleFuncs;
+
+  sth->execute      = MysqlPreparedStatementHandle_execute;
+  sth->fetchRow     = MysqlPreparedStatementHandle_fetchRow;
+  sth->numRows      = MysqlPreparedStatementHandle_numRows;
+  sth->finish       = MysqlPreparedStatementHandle_finish;
+  sth->getInsertId  = MysqlPreparedStatementHandle_getInsertId;
+  sth->addFlag      = MysqlStatementHandle_addFlag;
+  sth->bindInt      = MysqlPreparedStatementHandle_bindInt;
+  sth->bindLong     = MysqlPreparedStatementHandle_bindLong;
+  sth->bindLongLong = MysqlPreparedStatementHandle_bindLongLong;
+  sth->bindDouble   = MysqlPreparedStatementHandle_bindDouble;
+  sth->bindString   = MysqlPreparedStatementHandle_bindString;
+  sth->bindNull     = MysqlPreparedStatementHandle_bindNull;
+
+  sth->dbc = dbc;
+
+  // On failure from here on everything allocated so far goes with MysqlPreparedStatementHandle_free
+  if ((sth->statementFormat = StrUtil_copyString(&(sth->statementFormat),
+                                                 query,0)) == NULL) {
+    Error_trace("MysqlPreparedStatementHandle_new", NULL);
+    MysqlPreparedStatementHandle_free(sth);
+    return NULL;
+  }
+
+  if ((sth->stmt = mysql_stmt_init(dbc->mysql)) == NULL) {
+    fprintf(stderr,"ERROR: mysql_stmt_init failed for %s: %s\n", query, mysql_error(dbc->mysql));
+    MysqlPreparedStatementHandle_free(sth);
+    return NULL;
+  }
+
+  if (mysql_stmt_prepare(sth->stmt, query, queryLen) != 0) {
+    if (reportErrors) {
+      MysqlPreparedStatementHandle_reportError(sth, "prepare");
+    }
+    MysqlPreparedStatementHandle_free(sth);
+    return NULL;
+  }
+
+  sth->nParam = mysql_stmt_param_count(sth->stmt);
+  if (sth->nParam) {
+    if ((sth->paramBinds  = (MYSQL_BIND *)calloc(sth->nParam, sizeof(MYSQL_BIND))) == NULL ||
+        (sth->paramValues = (MysqlBindValue *)calloc(sth->nParam, sizeof(MysqlBindValue))) == NULL) {
+      fprintf(stderr,"ERROR: Failed allocating param binds for prepared sth\n");
+      MysqlPreparedStatementHandle_free(sth);
+      return NULL;
+    }
+    MysqlPreparedStatementHandle_resetParams(sth);
+  }
+
+  // Statements which return rows get one buffer per column, typed from the
+  // result metadata. The buffers are kept for the lifetime of the handle so
+  // repeated executions of a cached statement don't reallocate them.
+  if ((sth->metadata = mysql_stmt_result_metadata(sth->stmt)) != NULL) {
+    sth->nField = mysql_num_fields(sth->metadata);
+
+    if ((sth->resultBinds = (MYSQL_BIND *)calloc(sth->nField, sizeof(MYSQL_BIND))) == NULL) {
+      fprintf(stderr,"ERROR: Failed allocating result binds for prepared sth\n");
+      MysqlPreparedStatementHandle_free(sth);
+      return NULL;
+    }
+
+    if ((sth->b_row = MysqlBinaryResultRow_new(mysql_fetch_fields(sth->metadata), sth->nField, sth->resultBinds)) == NULL) {
+      MysqlPreparedStatementHandle_free(sth);
+      return NULL;
+    }
+
+    if (mysql_stmt_bind_result(sth->stmt, sth->resultBinds) != 0) {
+      MysqlPreparedStatementHandle_reportError(sth, "bind result");
+      MysqlPreparedStatementHandle_free(sth);
+      return NULL;
+    }
+  }
+
+  return (StatementHandle *)sth;
+}
+
+static void MysqlPreparedStatementHandle_reportError(MysqlPreparedStatementHandle *m_sth, char *action) {
+  fprintf(stderr, "Could not %s prepared statement %s\n\n", action, m_sth->statementFormat);
+  fprintf(stderr, "Mysql error: %s\n", mysql_stmt_error(m_sth->stmt));
+  fprintf(stderr, "Database %s host %s user %s port %d\n",
+          DBConnection_getDbName(m_sth->dbc),
+          DBConnection_getHost(m_sth->dbc),
+          DBConnection_getUser(m_sth->dbc),
+          DBConnection_getPort(m_sth->dbc));
+}
+
+static void MysqlPreparedStatementHandle_checkParamNum(MysqlPreparedStatementHandle *m_sth, int paramNum) {
+  if (paramNum < 1 || paramNum > m_sth->nParam) {
+    fprintf(stderr, "ERROR: Parameter number %d out of range (1 to %d) for statement %s\n",
+            paramNum, m_sth->nParam, m_sth->statementFormat);
+    exit(1);
+  }
+  // Every bind function comes through here, so this is where a param becomes bound
+  m_sth->paramValues[paramNum-1].isBound = 1;
+}
+
+/*
+ Puts every parameter back to the state prepare leaves it in - unbound, with
+ no buffer - so a cached handle never holds on to a previous caller's values
+ (bindString doesn't copy, so those may no longer be valid).
+*/
+static void MysqlPreparedStatementHandle_resetParams(MysqlPreparedStatementHandle *m_sth) {
+  int i;
+  for (i=0; i<m_sth->nParam; i++) {
+    MysqlBindValue *value = &(m_sth->paramValues[i]);
+    MYSQL_BIND     *bind  = &(m_sth->paramBinds[i]);
+
+    memset(value, 0, sizeof(MysqlBindValue));
+    memset(bind, 0, sizeof(MYSQL_BIND));
+
+    value->isNull     = 1;
+    bind->buffer_type = MYSQL_TYPE_NULL;
+    bind->buffer      = NULL;
+    bind->is_null     = &(value->isNull);
+    bind->length      = &(value->length);
+  }
+}
+
+static int MysqlPreparedStatementHandle_checkParamsBound(MysqlPreparedStatementHandle *m_sth) {
+  int i;
+  for (i=0; i<m_sth->nParam; i++) {
+    if (!m_sth->paramValues[i].isBound) {
+      fprintf(stderr, "ERROR: Parameter %d not bound for prepared statement %s\n",
+              i+1, m_sth->statementFormat);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void MysqlPreparedStatementHandle_bindInt(StatementHandle *sth, int paramNum, int val) {
+  MysqlPreparedStatementHandle *m_sth;
+
+  Class_assertType(CLASS_MYSQLPREPAREDSTATEMENTHANDLE,sth->objectType);
+
+  m_sth = (MysqlPreparedStatementHandle *)sth;
+  MysqlPreparedStatementHandle_checkParamNum(m_sth, paramNum);
+
+  MysqlBindValue *value = &(m_sth->paramValues[paramNum-1]);
+  MYSQL_BIND     *bind  = &(m_sth->paramBinds[paramNum-1]);
+
+  value->val.intVal = val;
+  value->isNull     = 0;
+
+  bind->buffer_type = MYSQL_TYPE_LONG;
+  bind->buffer      = &(value->val.intVal);
+}
+
+void MysqlPreparedStatementHandle_bindLong(StatementHandle *sth, int paramNum, long val) {
+  MysqlPreparedStatementHandle_bindLongLong(sth, paramNum, (IDType)val);
+}
+
+void MysqlPreparedStatementHandle_bindLongLong(StatementHandle *sth, int paramNum, IDType val) {
+  MysqlPreparedStatementHandle *m_sth;
+
+  Class_assertType(CLASS_MYSQLPREPAREDSTATEMENTHANDLE,sth->objectType);
+
+  m_sth = (MysqlPreparedStatementHandle *)sth;
+  MysqlPreparedStatementHandle_checkParamNum(m_sth, paramNum);
+
+  MysqlBindValue *value = &(m_sth->paramValues[paramNum-1]);
+  MYSQL_BIND     *bind  = &(m_sth->paramBinds[paramNum-1]);
+
+  value->val.longLongVal = val;
+  value->isNull          = 0;
+
+  bind->buffer_type = MYSQL_TYPE_LONGLONG;
+  bind->buffer      = &(value->val.longLongVal);
+}
+
+void MysqlPreparedStatementHandle_bindDouble(StatementHandle *sth, int paramNum, double val) {
+  MysqlPreparedStatementHandle *m_sth;
+
+  Class_assertType(CLASS_MYSQLPREPAREDSTATEMENTHANDLE,sth->objectType);
+
+  m_sth = (MysqlPreparedStatementHandle *)sth;
+  MysqlPreparedStatementHandle_checkParamNum(m_sth, paramNum);
+
+  MysqlBindValue *value = &(m_sth->paramValues[paramNum-1]);
+  MYSQL_BIND     *bind  = &(m_sth->paramBinds[paramNum-1]);
+
+  value->val.doubleVal = val;
+  value->isNull        = 0;
+
+  bind->buffer_type = MYSQL_TYPE_DOUBLE;
+  bind->buffer      = &(value->val.doubleVal);
+}
+
+// Note: val is not copied
+void MysqlPreparedStatementHandle_bindString(StatementHandle *sth, int paramNum, char *val, unsigned long len) {
+  MysqlPreparedStatementHandle *m_sth;
+
+  Class_assertType(CLASS_MYSQLPREPAREDSTATEMENTHANDLE,sth->objectType);
+
+  if (val == NULL) {
+    MysqlPreparedStatementHandle_bindNull(sth, paramNum);
+    return;
+  }
+
+  m_sth = (MysqlPreparedStatementHandle *)sth;
+  MysqlPreparedStatementHandle_checkParamNum(m_sth, paramNum);
+
+  MysqlBindValue *value = &(m_sth->paramValues[paramNum-1]);
+  MYSQL_BIND     *bind  = &(m_sth->paramBinds[paramNum-1]);
+
+  value->length = len;
+  value->isNull = 0;
+
+  bind->buffer_type   = MYSQL_TYPE_STRING;
+  bind->buffer        = val;
+  bind->buffer_length = len;
+}
+
+void MysqlPreparedStatementHandle_bindNull(StatementHandle *sth, int paramNum) {
+  MysqlPreparedStatementHandle *m_sth;
+
+  Class_assertType(CLASS_MYSQLPREPAREDSTATEMENTHANDLE,sth->objectType);
+
+  m_sth = (MysqlPreparedStatementHandle *)sth;
+  MysqlPreparedStatementHandle_checkParamNum(m_sth, paramNum);
+
+  m_sth->paramValues[paramNum-1].isNull = 1;
+  m_sth->paramBinds[paramNum-1].buffer_type = MYSQL_TYPE_NULL;
+  m_sth->paramBinds[paramNum-1].buffer      = NULL;
+}
+
+/*
+ Varargs are accepted so the function matches StatementHandle_ExecuteFunc,
+ but the values come from the bind* calls.
+*/
+unsigned long long MysqlPreparedStatementHandle_execute(StatementHandle *sth, ...) {
+  MysqlPreparedStatementHandle *m_sth;
+
+  Class_assertType(CLASS_MYSQLPREPAREDSTATEMENTHANDLE,sth->objectType);
+
+  m_sth = (MysqlPreparedStatementHandle *)sth;
+
+  if (m_sth->haveResults) {
+    mysql_stmt_free_result(m_sth->stmt);
+    m_sth->haveResults = 0;
+  }
+
+  if (!MysqlPreparedStatementHandle_checkParamsBound(m_sth)) {
+    return 0;
+  }
+
+  if (m_sth->nParam && mysql_stmt_bind_param(m_sth->stmt, m_sth->paramBinds) != 0) {
+    MysqlPreparedStatementHandle_reportError(m_sth, "bind params for");
+    return 0;
+  }
+
+  if (mysql_stmt_execute(m_sth->stmt) != 0) {
+    MysqlPreparedStatementHandle_reportError(m_sth, "execute");
+    return 0;
+  }
+
+  if (m_sth->nField) {
+    // Buffer whole result client side unless caller asked to stream
+    if (!(m_sth->flags & MYSQLFLAG_USE_RESULT)) {
+      if (mysql_stmt_store_result(m_sth->stmt) != 0) {
+        MysqlPreparedStatementHandle_reportError(m_sth, "store result for");
+        return 0;
+      }
+    }
+    m_sth->haveResults = 1;
+  }
+
+  return mysql_stmt_affected_rows(m_sth->stmt);
+}
+
+ResultRow *MysqlPreparedStatementHandle_fetchRow(StatementHandle *sth) {
+  MysqlPreparedStatementHandle *m_sth;
+  int status;
+  int i;
+
+  Class_assertType(CLASS_MYSQLPREPAREDSTATEMENTHANDLE,sth->objectType);
+
+  m_sth = (MysqlPreparedStatementHandle *)sth;
+
+  if (!m_sth->haveResults) {
+    fprintf(stderr,"ERROR: Tried to fetch a row for a StatementHandle with no results for %s\n",
+            sth->statementFormat);
+    return NULL;
+  }
+
+  status = mysql_stmt_fetch(m_sth->stmt);
+
+  if (status == MYSQL_NO_DATA) {
+    return NULL;
+  } else if (status == 1) {
+    MysqlPreparedStatementHandle_reportError(m_sth, "fetch from");
+    return NULL;
+  } else if (status == MYSQL_DATA_TRUNCATED) {
+    // Grow any string buffers which were too small and fetch those columns again
+    int needRebind = 0;
+    for (i=0; i<m_sth->nField; i++) {
+      MysqlBinaryColumn *col = &(m_sth->b_row->cols[i]);
+
+      if (col->error && !col->isNull && col->type == MYSQLBINCOL_STRING) {
+        unsigned long needed = col->length + 1;
+        unsigned long newSize = col->bufSize;
+
+        while (newSize < needed) newSize *= 2;
+
+        if (!MysqlBinaryResultRow_growStringBuffer(m_sth->b_row, i, &(m_sth->resultBinds[i]), newSize)) {
+          return NULL;
+        }
+        if (mysql_stmt_fetch_column(m_sth->stmt, &(m_sth->resultBinds[i]), i, 0) != 0) {
+          MysqlPreparedStatementHandle_reportError(m_sth, "fetch column from");
+          return NULL;
+        }
+        needRebind = 1;
+      }
+    }
+    if (needRebind && mysql_stmt_bind_result(m_sth->stmt, m_sth->resultBinds) != 0) {
+      MysqlPreparedStatementHandle_reportError(m_sth, "rebind result for");
+      return NULL;
+    }
+  }
+
+  MysqlBinaryResultRow_startRow(m_sth->b_row);
+
+  return (ResultRow *)(m_sth->b_row);
+}
+
+unsigned long long MysqlPreparedStatementHandle_numRows(StatementHandle *sth) {
+  MysqlPreparedStatementHandle *m_sth;
+
+  Class_assertType(CLASS_MYSQLPREPAREDSTATEMENTHANDLE,sth->objectType);
+
+  m_sth = (MysqlPreparedStatementHandle *)sth;
+
+  if (!m_sth->haveResults) {
+    fprintf(stderr,"ERROR: Tried to fetch number of rows for a StatementHandle with no results for %s\n",
+            sth->statementFormat);
+    return 0;
+  }
+
+  return mysql_stmt_num_rows(m_sth->stmt);
+}
+
+IDType MysqlPreparedStatementHandle_getInsertId(StatementHandle *sth) {
+  MysqlPreparedStatementHandle *m_sth;
+  IDType insertId;
+
+  Class_assertType(CLASS_MYSQLPREPAREDSTATEMENTHANDLE,sth->objectType);
+
+  m_sth = (MysqlPreparedStatementHandle *)sth;
+
+  insertId = mysql_stmt_insert_id(m_sth->stmt);
+
+  if (insertId == 0) {
+    fprintf(stderr, "Warning: Insert id was 0\n");
+  }
+
+  return insertId;
+}
+
+/*
+ Cached handles are only reset here - they are freed when the owning
+ DBConnection's statement cache is cleared.
+*/
+void MysqlPreparedStatementHandle_finish(StatementHandle *sth) {
+  MysqlPreparedStatementHandle *m_sth;
+
+  Class_assertType(CLASS_MYSQLPREPAREDSTATEMENTHANDLE,sth->objectType);
+
+  m_sth = (MysqlPreparedStatementHandle *)sth;
+
+  if (m_sth->isCached) {
+    if (m_sth->haveResults) {
+      mysql_stmt_free_result(m_sth->stmt);
+      m_sth->haveResults = 0;
+    }
+    MysqlPreparedStatementHandle_resetParams(m_sth);
+    m_sth->flags = 0;
+    m_sth->inUse = 0;
+  } else {
+    MysqlPreparedStatementHandle_free(m_sth);
+  }
+}
+
+void MysqlPreparedStatementHandle_free(MysqlPreparedStatementHandle *m_sth) {
+  if (m_sth->stmt) {
+    if (m_sth->haveResults) {
+      mysql_stmt_free_result(m_sth->stmt);
+    }
+    mysql_stmt_close(m_sth->stmt);
+  }
+  if (m_sth->metadata) mysql_free_result(m_sth->metadata);
+
+  if (m_sth->resultBinds) free(m_sth->resultBinds);
+  if (m_sth->b_row)       MysqlBinaryResultRow_free(m_sth->b_row);
+
+  if (m_sth->paramBinds)  free(m_sth->paramBinds);
+  if (m_sth->paramValues) free(m_sth->paramValues);
+
+  if (m_sth->statementFormat) free(m_sth->statementFormat);
+
+  free(m_sth);
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MYSQLPREPAREDSTATEMENTHANDLE_H__
+#define __MYSQLPREPAREDSTATEMENTHANDLE_H__
+
+#include "mysql.h"
+#include "StatementHandle.h"
+#include "MysqlBinaryResultRow.h"
+#include "MysqlStatementHandle.h"
+
+/*
+ Server side prepared statement built on the mysql_stmt_* API.
+
+ The statement text uses ? placeholders. Values are bound with the bind*
+ functions in the StatementHandle function table and the statement is then
+ run with sth->execute(sth) (any varargs are ignored). Rows are fetched with
+ sth->fetchRow as for a MysqlStatementHandle, but come back over the binary
+ protocol as a MysqlBinaryResultRow, so numeric columns aren't parsed from text.
+
+ Handles returned from DBConnection_prepareStatement are owned by the
+ connection's statement cache: finish() only releases the current result set
+ so the next prepare of the same SQL can reuse the server side statement.
+ It also unbinds every parameter, and execute refuses to run (returning 0)
+ until each parameter has been bound again - use bindNull for NULLs.
+
+ Note bindString does NOT copy the string - it must stay valid until execute
+ has been called.
+*/
+
+typedef struct MysqlPreparedStatementHandleStruct MysqlPreparedStatementHandle;
+
+typedef struct MysqlBindValueStruct {
+  union {
+    int       intVal;
+    long long longLongVal;
+    double    doubleVal;
+  } val;
+  unsigned long length;
+  my_bool       isNull;
+  int           isBound;
+} MysqlBindValue;
+
+StatementHandle *MysqlPreparedStatementHandle_new(DBConnection *dbc, char *query, int queryLen, int reportErrors);
+unsigned long long MysqlPreparedStatementHandle_execute(StatementHandle *sth, ...);
+ResultRow *MysqlPreparedStatementHandle_fetchRow(StatementHandle *sth);
+IDType MysqlPreparedStatementHandle_getInsertId(StatementHandle *sth);
+unsigned long long MysqlPreparedStatementHandle_numRows(StatementHandle *sth);
+void MysqlPreparedStatementHandle_finish(StatementHandle *sth);
+void MysqlPreparedStatementHandle_free(MysqlPreparedStatementHandle *m_sth);
+
+void MysqlPreparedStatementHandle_bindInt(StatementHandle *sth, int paramNum, int val);
+void MysqlPreparedStatementHandle_bindLong(StatementHandle *sth, int paramNum, long val);
+void MysqlPreparedStatementHandle_bindLongLong(StatementHandle *sth, int paramNum, IDType val);
+void MysqlPreparedStatementHandle_bindDouble(StatementHandle *sth, int paramNum, double val);
+void MysqlPreparedStatementHandle_bindString(StatementHandle *sth, int paramNum, char *val, unsigned long len);
+void MysqlPreparedStatementHandle_bindNull(StatementHandle *sth, int paramNum);
+
+OBJECTFUNC_TYPES(MysqlPreparedStatementHandle)
+
+typedef struct MysqlPreparedStatementHandleFuncsStruct {
+  OBJECTFUNCS_DATA(MysqlPreparedStatementHandle)
+} MysqlPreparedStatementHandleFuncs;
+
+
+#define MYSQLPREPAREDSTATEMENTHANDLE_DATA \
+  STATEMENTHANDLE_DATA \
+  MYSQL_STMT *stmt; \
+  MYSQL_RES *metadata; \
+  int nParam; \
+  MYSQL_BIND *paramBinds; \
+  MysqlBindValue *paramValues; \
+  int nField; \
+  MYSQL_BIND *resultBinds; \
+  MysqlBinaryResultRow *b_row; \
+  int haveResults; \
+  int isCached; \
+  int inUse;
+
+#define FUNCSTRUCTTYPE MysqlPreparedStatementHandleFuncs
+struct MysqlPreparedStatementHandleStruct {
+  MYSQLPREPAREDSTATEMENTHANDLE_DATA
+};
+#undef FUNCSTRUCTTYPE
+
+#define MysqlPreparedStatementHandle_isCached(m_sth) (m_sth)->isCached
+#define MysqlPreparedStatementHandle_setCached(m_sth, val) (m_sth)->isCached = (val)
+
+#define MysqlPreparedStatementHandle_isInUse(m_sth) (m_sth)->inUse
+#define MysqlPreparedStatementHandle_setInUse(m_sth, val) (m_sth)->inUse = (val)
+
+#ifdef __MYSQLPREPAREDSTATEMENTHANDLE_MAIN__
+  MysqlPreparedStatementHandleFuncs
+    mysqlPreparedStatementHandleFuncs = {
+                            MysqlPreparedStatementHandle_free,
+                            NULL, // shallowCopy
+                            NULL  // deepCopy
+                           };
+#else
+  extern MysqlPreparedStatementHandleFuncs mysqlPreparedStatementHandleFuncs;
+#endif
+
+#endif
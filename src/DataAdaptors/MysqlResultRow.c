@@ -22,6 +22,7 @@
 #include "Class.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 MysqlResultRow *MysqlResultRow_new() {
   MysqlResultRow *rr;
@@ -43,6 +44,8 @@ MysqlResultRow *MysqlResultRow_new() {
   rr->getLongLongAt   = MysqlResultRow_getLongLongAt;
   rr->getDoubleAt     = MysqlResultRow_getDoubleAt;
   rr->col             = MysqlResultRow_col;
+  rr->getStringViewAt = MysqlResultRow_getStringViewAt;
+  rr->isNullAt        = MysqlResultRow_isNullAt;
 
   return rr;
 }
@@ -87,6 +90,35 @@ char * MysqlResultRow_col(ResultRow *row, int ind) {
   return m_row->mysql_row[ind];
 }
 
+// lengths is set by the statement handle from mysql_fetch_lengths - if it isn't available fall back to strlen
+char * MysqlResultRow_getStringViewAt(ResultRow *row, int ind, unsigned long *lenP) {
+  MysqlResultRow *m_row;
+
+  Class_assertType(CLASS_MYSQLRESULTROW, row->objectType);
+
+  m_row = (MysqlResultRow *)row;
+
+  if (m_row->mysql_row[ind] == NULL) {
+    *lenP = 0;
+  } else if (m_row->lengths) {
+    *lenP = m_row->lengths[ind];
+  } else {
+    *lenP = strlen(m_row->mysql_row[ind]);
+  }
+
+  return m_row->mysql_row[ind];
+}
+
+int MysqlResultRow_isNullAt(ResultRow *row, int ind) {
+  MysqlResultRow *m_row;
+
+  Class_assertType(CLASS_MYSQLRESULTROW, row->objectType);
+
+  m_row = (MysqlResultRow *)row;
+
+  return (m_row->mysql_row[ind] == NULL);
+}
+
 int MysqlResultRow_getIntAt(ResultRow *row, int ind) {
   MysqlResultRow *m_row;
 
@@ -32,6 +32,8 @@ long      MysqlResultRow_getLongAt(ResultRow *row, int ind);
 IDType    MysqlResultRow_getLongLongAt(ResultRow *row, int ind);
 double    MysqlResultRow_getDoubleAt(ResultRow *row, int ind);
 char *    MysqlResultRow_col(ResultRow *row, int ind);
+char *    MysqlResultRow_getStringViewAt(ResultRow *row, int ind, unsigned long *lenP);
+int       MysqlResultRow_isNullAt(ResultRow *row, int ind);
 
 OBJECTFUNC_TYPES(MysqlResultRow)
 
@@ -42,7 +44,8 @@ typedef struct MysqlResultRowFuncsStruct {
 
 #define MYSQLRESULTROW_DATA \
   RESULTROW_DATA \
-  MYSQL_ROW mysql_row;
+  MYSQL_ROW mysql_row; \
+  unsigned long *lengths;
 
 #define FUNCSTRUCTTYPE MysqlResultRowFuncs
 struct MysqlResultRowStruct {
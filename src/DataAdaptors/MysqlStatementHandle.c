@@ -82,25 +82,24 @@ unsigned long long MysqlStatementHandle_execute(StatementHandle *sth, ...) {
   MYSQL_RES *results;
   MysqlStatementHandle *m_sth;
 
-  if ((statement = (char *)calloc(655500,sizeof(char))) == NULL) {
-    fprintf(stderr,"Failed allocating statment\n");
-    return 0;
-  }
-
   Class_assertType(CLASS_MYSQLSTATEMENTHANDLE,sth->objectType);
 
   //printf("Statement = %s\n",sth->statementFormat);
 
   m_sth = (MysqlStatementHandle *)sth;
 
+  // Formatted into a buffer kept with the handle, so executing it again reuses the space
+  if (m_sth->statement == NULL) {
+    m_sth->statement = StrBuf_new(strlen(m_sth->statementFormat) + 1);
+  }
+  StrBuf_clear(m_sth->statement);
+
   va_start(args, sth);
-  qlen = vsnprintf(statement, 655500, m_sth->statementFormat, args);
+  StrBuf_vappendf(m_sth->statement, m_sth->statementFormat, args);
   va_end(args);
 
-  if (qlen < 0 || qlen > 655500) {
-    fprintf(stderr, "ERROR: vsnprintf call failed during statement execution (qlen = %d)\n", qlen);
-    return 0;
-  }
+  statement = StrBuf_getString(m_sth->statement);
+  qlen = StrBuf_getLength(m_sth->statement);
 
   //fprintf(stderr, "Statement after formatting = %s\n",statement);
 
@@ -148,7 +147,6 @@ unsigned long long MysqlStatementHandle_execute(StatementHandle *sth, ...) {
     }
   }
 
-  free(statement);
   return mysql_affected_rows(m_sth->dbc->mysql);
 }
 
@@ -178,6 +176,7 @@ ResultRow *MysqlStatementHandle_fetchRow(StatementHandle *sth) {
     if (mysql_row != NULL) {
       //m_row = MysqlResultRow_new();
       m_sth->m_row->mysql_row = mysql_row;
+      m_sth->m_row->lengths   = mysql_fetch_lengths(m_sth->results);
       result = (ResultRow *)(m_sth->m_row);
     }
   }
@@ -233,6 +232,7 @@ void MysqlStatementHandle_finish(StatementHandle *sth) {
 
   if (m_sth->statementFormat) free(m_sth->statementFormat);
   if (m_sth->m_row) free(m_sth->m_row);
+  if (m_sth->statement) StrBuf_free(m_sth->statement);
 
   free(m_sth);
 }
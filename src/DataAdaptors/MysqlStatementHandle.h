@@ -20,6 +20,7 @@
 #include "mysql.h"
 #include "StatementHandle.h"
 #include "MysqlResultRow.h"
+#include "StrBuf.h"
 
 // flag 
 #define MYSQLFLAG_USE_RESULT 2
@@ -52,7 +53,8 @@ typedef struct MysqlStatementHandleFuncsStruct {
 #define MYSQLSTATEMENTHANDLE_DATA \
   STATEMENTHANDLE_DATA \
   MYSQL_RES *results; \
-  MysqlResultRow *m_row;
+  MysqlResultRow *m_row; \
+  StrBuf *statement;
 
 #define FUNCSTRUCTTYPE MysqlStatementHandleFuncs
 struct MysqlStatementHandleStruct {
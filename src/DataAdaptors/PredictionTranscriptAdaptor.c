@@ -230,30 +230,15 @@ Vector *PredictionTranscriptAdaptor_fetchAllBySlice(PredictionTranscriptAdaptor
 
   IDType *uniqueIds = IDHash_getKeys(trHash);
 
-  char tmpStr[1024];
-  char *qStr = NULL;
-  if ((qStr = (char *)calloc(655500,sizeof(char))) == NULL) {
-    fprintf(stderr,"Failed allocating qStr\n");
-    return transcripts;
-  }
+  StrBuf *qStr = StrBuf_new(STRBUF_DEFAULTSIZE);
 
-  int lenNum;
-  int endPoint = sprintf(qStr, "SELECT prediction_transcript_id, prediction_exon_id, exon_rank FROM prediction_exon WHERE  prediction_transcript_id IN (");
-  for (i=0; i<IDHash_getNumValues(trHash); i++) {
-    if (i!=0) {
-      qStr[endPoint++] = ',';
-      qStr[endPoint++] = ' ';
-    }
-    lenNum = sprintf(tmpStr,IDFMTSTR,uniqueIds[i]);
-    memcpy(&(qStr[endPoint]), tmpStr, lenNum);
-    endPoint+=lenNum;
-  }
-  qStr[endPoint++] = ')';
-  qStr[endPoint] = '\0';
+  StrBuf_append(qStr, "SELECT prediction_transcript_id, prediction_exon_id, exon_rank FROM prediction_exon WHERE  prediction_transcript_id IN (");
+  StrBuf_appendIDList(qStr, uniqueIds, IDHash_getNumValues(trHash));
+  StrBuf_appendChar(qStr, ')');
 
   free(uniqueIds);
 
-  StatementHandle *sth = pta->prepare((BaseAdaptor *)pta,qStr,strlen(qStr));
+  StatementHandle *sth = pta->prepare((BaseAdaptor *)pta,StrBuf_getString(qStr),StrBuf_getLength(qStr));
   sth->execute(sth);
 
   IDHash *exTrHash = IDHash_new(IDHASH_MEDIUM);
@@ -307,7 +292,7 @@ Vector *PredictionTranscriptAdaptor_fetchAllBySlice(PredictionTranscriptAdaptor
   }
 
   IDHash_free(exTrHash, Vector_free);
-  free(qStr);
+  StrBuf_free(qStr);
 
   return transcripts;
 }
@@ -81,37 +81,28 @@ RepeatConsensus *RepeatConsensusAdaptor_fetchByNameAndClass(RepeatConsensusAdapt
 
 Vector *RepeatConsensusAdaptor_fetchByClassAndSeq(RepeatConsensusAdaptor *rca, char *class, char *seq) {
   Vector *result = NULL;
-  char *constraintStr = NULL;
+  // Consensus sequences can be long, so sized to fit rather than fixed
+  StrBuf *constraintStr = StrBuf_new(strlen(class) + strlen(seq) + 64);
 
-  if ((constraintStr = (char *)calloc(655500,sizeof(char))) == NULL) {
-    fprintf(stderr,"Failed allocating constraintStr\n");
-    return result;
-  }
-  
-  sprintf(constraintStr,"repeat_class = \'%s\' AND repeat_consensus = \'%s\'", class, seq);
-  result = RepeatConsensusAdaptor_genericFetch(rca, constraintStr); 
+  StrBuf_appendf(constraintStr,"repeat_class = \'%s\' AND repeat_consensus = \'%s\'", class, seq);
+  result = RepeatConsensusAdaptor_genericFetch(rca, StrBuf_getString(constraintStr)); 
   
-  free(constraintStr);
+  StrBuf_free(constraintStr);
   return result;
 }
 
 Vector *RepeatConsensusAdaptor_genericFetch(RepeatConsensusAdaptor *rca, char *whereClause) {
   StatementHandle *sth;
   ResultRow *row;
-  char *qStr = NULL;
+  StrBuf *qStr = StrBuf_new(STRBUF_DEFAULTSIZE + strlen(whereClause));
   Vector *consensi;
-    
-  if ((qStr = (char *)calloc(655500,sizeof(char))) == NULL) {
-    fprintf(stderr,"Failed allocating qStr\n");
-    return NULL;
-  }
 
-  sprintf(qStr,"SELECT repeat_consensus_id, repeat_name,"
+  StrBuf_appendf(qStr,"SELECT repeat_consensus_id, repeat_name,"
                "       repeat_class, LENGTH(repeat_consensus)"
                " FROM repeat_consensus"
                " WHERE %s", whereClause);
 
-  sth = rca->prepare((BaseAdaptor *)rca,qStr,strlen(qStr));
+  sth = rca->prepare((BaseAdaptor *)rca,StrBuf_getString(qStr),StrBuf_getLength(qStr));
   sth->execute(sth);
 
   consensi = Vector_new();
@@ -128,7 +119,7 @@ Vector *RepeatConsensusAdaptor_genericFetch(RepeatConsensusAdaptor *rca, char *w
     Vector_addElement(consensi, rc);
   }
 
-  free(qStr);
+  StrBuf_free(qStr);
   return consensi;
 }
 
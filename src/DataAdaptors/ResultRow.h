@@ -30,6 +30,8 @@ typedef long      (*ResultRow_getLongAtFunc)(ResultRow *row, int ind);
 typedef IDType     (*ResultRow_getLongLongAtFunc)(ResultRow *row, int ind);
 typedef double    (*ResultRow_getDoubleAtFunc)(ResultRow *row, int ind);
 typedef char *    (*ResultRow_colFunc)(ResultRow *row,int ind);
+typedef char *    (*ResultRow_getStringViewAtFunc)(ResultRow *row, int ind, unsigned long *lenP);
+typedef int       (*ResultRow_isNullAtFunc)(ResultRow *row, int ind);
 
 OBJECTFUNC_TYPES(ResultRow)
 
@@ -38,6 +40,13 @@ typedef struct ResultRowFuncsStruct {
 } ResultRowFuncs;
 
 
+/*
+ getStringViewAt returns a pointer into the row's own buffer (NULL for a NULL
+ column) and sets *lenP to the number of bytes, so blobs and long strings can
+ be used without a copy or a strlen. Like getStringAt the pointer is only
+ valid until the next fetchRow on the statement handle.
+*/
+
 #define RESULTROW_DATA \
   OBJECT_DATA \
   ResultRow_getStringAtFunc   getStringAt; \
@@ -47,7 +56,9 @@ typedef struct ResultRowFuncsStruct {
   ResultRow_getLongAtFunc     getLongAt; \
   ResultRow_getLongLongAtFunc getLongLongAt; \
   ResultRow_getDoubleAtFunc   getDoubleAt; \
-  ResultRow_colFunc           col;
+  ResultRow_colFunc           col; \
+  ResultRow_getStringViewAtFunc getStringViewAt; \
+  ResultRow_isNullAtFunc      isNullAt;
 
 #define FUNCSTRUCTTYPE ResultRowFuncs
 struct ResultRowStruct {
@@ -28,11 +28,13 @@
 #include "StrUtil.h"
 #include "LRUCache.h"
 #include "StringHash.h"
+#include "PackedSeq.h"
 
 #include "ProjectionSegment.h"
 #include "StatementHandle.h"
 #include "ResultRow.h"
 #include <math.h>
+#include <limits.h>
 
 /*
 =head1 DESCRIPTION
@@ -42,7 +44,9 @@ An adaptor for the retrieval of DNA sequence from the EnsEMBL database
 
 static long const SEQ_CHUNK_PWR = 18; // 2^18 = approx. 250KB
 //static long const SEQ_CHUNK_PWR = 1; // Basically means don't cache
-static long const SEQ_CACHE_SZ  = 20;
+static long const SEQ_CACHE_SZ  = 20; // chunks - longer fetches aren't cached
+static double const SEQ_CHUNK_COST = 10.0; // One query per chunk
+static long const PACKED_SEQ_READ_CHUNK = 1<<22; // dna read in 4MB pieces when generating packed files
 static long SEQ_CACHE_MAX;
 
 static int init = 0;
@@ -54,7 +58,9 @@ void SequenceAdaptor_initFunc() {
 }
 
 char * SequenceAdaptor_fetchSeq(SequenceAdaptor *sa, IDType seqRegionId, long start, long length);
+StatementHandle *SequenceAdaptor_prepareSubstrStatement(SequenceAdaptor *sa);
 void SequenceAdaptor_rnaEdit(SequenceAdaptor *sa, Slice *slice, char **seqPP, int recLev);
+PackedSeq *SequenceAdaptor_getPackedSeq(SequenceAdaptor *sa, IDType seqRegionId);
 /*
 =head2 new
 
@@ -83,8 +89,9 @@ SequenceAdaptor *SequenceAdaptor_new(DBAdaptor *dba) {
 
   ((BaseAdaptor*)sa)->prepare = SequenceAdaptor_prepare;
 
-  // use an LRU cache to limit the size
-  sa->seqCache = LRUCache_new(SEQ_CACHE_MAX);
+  // use an LRU cache, limited by the DBAdaptor's cache budget
+  sa->seqCache = LRUCache_new(INT_MAX);
+  LRUCache_setManager(sa->seqCache, DBAdaptor_getCacheManager(dba), "Sequence chunks", SEQ_CHUNK_COST, NULL);
 //  sa->seqCache = StringHash_new(STRINGHASH_MEDIUM);
 
 //
@@ -125,10 +132,39 @@ SequenceAdaptor *SequenceAdaptor_new(DBAdaptor *dba) {
   } else {
     IDHash_free(edits, NULL);
   }
+
+  // Optionally read sequence from local 2 bit packed files rather than the dna table
+  char *packedSeqDir = getenv("ENSC_PACKED_SEQ_DIR");
+  if (packedSeqDir != NULL && packedSeqDir[0] != '\0') {
+    SequenceAdaptor_setPackedSeqDir(sa, packedSeqDir);
+  }
   
   return sa;
 }
 
+/*
+  Sets the directory for local 2 bit packed copies of the dna table, one file
+  per seq region. Files are generated from the dna table the first time a seq
+  region is fetched and after that the sequence comes from the (memory mapped)
+  files without going to the database. Also settable with the
+  ENSC_PACKED_SEQ_DIR environment variable. NULL turns it off.
+*/
+void SequenceAdaptor_setPackedSeqDir(SequenceAdaptor *sa, char *dir) {
+  if (sa->packedSeqs) {
+    IDHash_free(sa->packedSeqs, PackedSeq_close);
+    sa->packedSeqs = NULL;
+  }
+  if (sa->packedSeqDir) {
+    free(sa->packedSeqDir);
+    sa->packedSeqDir = NULL;
+  }
+
+  if (dir != NULL) {
+    StrUtil_copyString(&sa->packedSeqDir, dir, 0);
+    sa->packedSeqs = IDHash_new(IDHASH_SMALL);
+  }
+}
+
 
 
 StatementHandle *SequenceAdaptor_prepare(BaseAdaptor *ba, char *qStr, size_t len) {
@@ -633,9 +669,113 @@ void SequenceAdaptor_rnaEdit(SequenceAdaptor *sa, Slice *slice, char **seqPP, in
 }
 
 
+/*
+  The dna substring query is run for every uncached chunk, so use a server side
+  prepared statement (cached on the dnadb connection) rather than formatting
+  and parsing the SQL each time.
+*/
+StatementHandle *SequenceAdaptor_prepareSubstrStatement(SequenceAdaptor *sa) {
+  char *qStr = "SELECT SUBSTRING(d.sequence, ?, ?) "
+               "FROM dna d "
+               "WHERE d.seq_region_id = ?";
+
+  StatementHandle *sth = DBAdaptor_prepareStatement(sa->dba->dnadb, qStr, strlen(qStr));
+  if (sth == NULL) {
+    fprintf(stderr, "Failed preparing dna substring statement\n");
+    exit(1);
+  }
+  return sth;
+}
+
+/*
+  Returns the packed sequence for seqRegionId, opening or generating its file
+  if this is the first request for it. NULL means use the dna table - either
+  there's no packed sequence dir, the seq region has no dna, or the file
+  couldn't be written.
+*/
+PackedSeq *SequenceAdaptor_getPackedSeq(SequenceAdaptor *sa, IDType seqRegionId) {
+  char fileName[FILENAME_MAX];
+  PackedSeq *ps;
+
+  if (sa->packedSeqDir == NULL) {
+    return NULL;
+  }
+
+  // Failures are stored as NULL so they're only tried once
+  if (IDHash_contains(sa->packedSeqs, seqRegionId)) {
+    return IDHash_getValue(sa->packedSeqs, seqRegionId);
+  }
+
+  // seq_region_ids are only unique within a database so it's part of the name
+  sprintf(fileName, "%s/%s_"IDFMTSTR".2bit", sa->packedSeqDir,
+          DBConnection_getDbName(sa->dba->dnadb->dbc), seqRegionId);
+
+  if ((ps = PackedSeq_open(fileName)) == NULL) {
+    char *seq = NULL;
+    long length = 0;
+    long nAlloc = 0;
+    int done = 0;
+    int haveDna = 0;
+
+    // Read the dna in pieces so the client never has to buffer a whole chromosome row
+    StatementHandle *sth = SequenceAdaptor_prepareSubstrStatement(sa);
+    while (!done) {
+      sth->bindLong(sth, 1, length+1);
+      sth->bindLong(sth, 2, PACKED_SEQ_READ_CHUNK);
+      sth->bindLongLong(sth, 3, seqRegionId);
+
+      sth->execute(sth);
+      ResultRow *row = sth->fetchRow(sth);
+
+      unsigned long lenChunk = 0;
+      char *chunk = NULL;
+      if (row) {
+        haveDna = 1;
+        chunk = row->getStringViewAt(row, 0, &lenChunk);
+      }
+      if (chunk != NULL && lenChunk > 0) {
+        if (length + lenChunk > nAlloc) {
+          nAlloc = nAlloc ? nAlloc * 2 : PACKED_SEQ_READ_CHUNK;
+          if ((seq = realloc(seq, nAlloc)) == NULL) {
+            fprintf(stderr,"Failed reallocating sequence for packed sequence file\n");
+            exit(1);
+          }
+        }
+        memcpy(&seq[length], chunk, lenChunk);
+        length += lenChunk;
+      }
+      done = (lenChunk < PACKED_SEQ_READ_CHUNK);
+    }
+    sth->finish(sth);
+
+    if (haveDna && PackedSeq_write(fileName, seq, length) == 0) {
+      ps = PackedSeq_open(fileName);
+    }
+    free(seq);
+  }
+
+  IDHash_add(sa->packedSeqs, seqRegionId, ps);
+
+  return ps;
+}
+
 char * SequenceAdaptor_fetchSeq(SequenceAdaptor *sa, IDType seqRegionId, long start, long length) {
   int status = 0;
 
+  PackedSeq *ps = SequenceAdaptor_getPackedSeq(sa, seqRegionId);
+  if (ps != NULL) {
+    // Straight from the mapped file - no chunk cache needed
+    char *seq;
+    if ((seq = malloc(length+1)) == NULL) {
+      fprintf(stderr,"Failed allocating seq\n");
+      exit(1);
+    }
+    PackedSeq_fetch(ps, start, length, seq);
+    seq[length] = '\0';
+
+    return seq;
+  }
+
   if (length < SEQ_CACHE_MAX) {
     long chunkMin = (start-1) >> SEQ_CHUNK_PWR;
     long chunkMax = (start + length - 1) >> SEQ_CHUNK_PWR;
@@ -667,32 +807,36 @@ char * SequenceAdaptor_fetchSeq(SequenceAdaptor *sa, IDType seqRegionId, long st
         
       } else {
         // retrieve uncached portions of the sequence
-        char qStr[1024];
-        // Modified from perl to also return the length of the substring
-        sprintf(qStr,"SELECT SUBSTRING(d.sequence, %ld, %ld) "
-                     "FROM dna d "
-                     "WHERE d.seq_region_id = "IDFMTSTR, min, 1L<<SEQ_CHUNK_PWR, seqRegionId);
-//        sprintf(qStr,"SELECT SUBSTRING(d.sequence, %ld, %ld), LENGTH(SUBSTRING(d.sequence, %ld, %ld)) "
-//                     "FROM dna d "
-//                     "WHERE d.seq_region_id = "IDFMTSTR, min, 1L<<SEQ_CHUNK_PWR, min, 1L<<SEQ_CHUNK_PWR, seqRegionId);
-//        sprintf(qStr,"SELECT SUBSTRING(d.sequence, %ld, %ld), if (sr.length-%ld+1 >  %ld, %ld, sr.length-%ld+1) "
-//                     "FROM dna d, seq_region sr "
-//                     "WHERE sr.seq_region_id = d.seq_region_id and d.seq_region_id = "IDFMTSTR, min, 1L<<SEQ_CHUNK_PWR, min, 1L<<SEQ_CHUNK_PWR, 1L<<SEQ_CHUNK_PWR, min, seqRegionId);
-
-        StatementHandle *sth = sa->prepare((BaseAdaptor *)sa,qStr,strlen(qStr));
+        StatementHandle *sth = SequenceAdaptor_prepareSubstrStatement(sa);
+
+        sth->bindLong(sth, 1, min);
+        sth->bindLong(sth, 2, 1L<<SEQ_CHUNK_PWR);
+        sth->bindLongLong(sth, 3, seqRegionId);
 
         sth->execute(sth);
         ResultRow *row = sth->fetchRow(sth);
 
         if (row) {
-            char *tmpSeq   = row->getStringCopyAt(row, 0);
-            //long lenTmpSeq = row->getLongAt(row, 1);
-            long lenTmpSeq = strlen(tmpSeq);
+            // Borrowed view of the row buffer - the length comes with it so no strlen, and
+            // the only copies made are the one into entireSeq and the one the cache keeps
+            unsigned long lenTmpSeq;
+            char *rowSeq = row->getStringViewAt(row, 0, &lenTmpSeq);
+            if (rowSeq == NULL) {
+              rowSeq = "";
+            }
 
             // always give back uppercased sequence so it can be properly softmasked
             //StrUtil_strupr(tmpSeq);
 
-            memcpy(&(entireSeq[min-minChunkMin]), tmpSeq, lenTmpSeq);
+            memcpy(&(entireSeq[min-minChunkMin]), rowSeq, lenTmpSeq);
+
+            char *tmpSeq;
+            if ((tmpSeq = malloc(lenTmpSeq+1)) == NULL) {
+              fprintf(stderr,"Failed allocating sequence chunk\n");
+              exit(1);
+            }
+            memcpy(tmpSeq, rowSeq, lenTmpSeq);
+            tmpSeq[lenTmpSeq] = '\0';
             //StrUtil_appendString(entireSeq,tmpSeq);
             LRUCache_put(sa->seqCache, chunkKey, tmpSeq, free, lenTmpSeq);
             //StringHash_add(sa->seqCache, chunkKey, tmpSeq);
@@ -724,12 +868,11 @@ char * SequenceAdaptor_fetchSeq(SequenceAdaptor *sa, IDType seqRegionId, long st
   } else {
     // do not do any caching for requests of very large sequences
 
-    char qStr[1024];
-    sprintf(qStr,"SELECT SUBSTRING(d.sequence, %ld, %ld) "
-                 "FROM dna d "
-                 "WHERE d.seq_region_id = "IDFMTSTR, start, length, seqRegionId);
+    StatementHandle *sth = SequenceAdaptor_prepareSubstrStatement(sa);
 
-    StatementHandle *sth = sa->prepare((BaseAdaptor *)sa,qStr,strlen(qStr));
+    sth->bindLong(sth, 1, start);
+    sth->bindLong(sth, 2, length);
+    sth->bindLongLong(sth, 3, seqRegionId);
 
     sth->execute(sth);
     ResultRow *row = sth->fetchRow(sth);
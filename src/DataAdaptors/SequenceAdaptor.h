@@ -32,10 +32,15 @@ struct SequenceAdaptorStruct {
   LRUCache *seqCache;
 //  StringHash *seqCache;
   IDHash *rnaEditsCache;
+
+  // Local 2 bit packed sequence files, used instead of the dna table when set
+  char *packedSeqDir;
+  IDHash *packedSeqs;
 };
 
 SequenceAdaptor *SequenceAdaptor_new(DBAdaptor *dba);
 StatementHandle *SequenceAdaptor_prepare(BaseAdaptor *ba, char *qStr, size_t len);
+void SequenceAdaptor_setPackedSeqDir(SequenceAdaptor *sa, char *dir);
 
 char *SequenceAdaptor_fetchByRawContigStartEndStrand(SequenceAdaptor *sa,
                                                      //RawContig *rc,
@@ -28,6 +28,15 @@ typedef unsigned long long (*StatementHandle_NumRowsFunc)(StatementHandle *sth);
 typedef IDType (*StatementHandle_GetInsertIdFunc)(StatementHandle *sth);
 typedef void (*StatementHandle_addFlagFunc)(StatementHandle *sth, unsigned long flag);
 
+// Parameter binding - only implemented by server side prepared statement handles
+// (see DBConnection_prepareStatement). paramNum counts from 1 as in DBI bind_param.
+typedef void (*StatementHandle_BindIntFunc)(StatementHandle *sth, int paramNum, int val);
+typedef void (*StatementHandle_BindLongFunc)(StatementHandle *sth, int paramNum, long val);
+typedef void (*StatementHandle_BindLongLongFunc)(StatementHandle *sth, int paramNum, IDType val);
+typedef void (*StatementHandle_BindDoubleFunc)(StatementHandle *sth, int paramNum, double val);
+typedef void (*StatementHandle_BindStringFunc)(StatementHandle *sth, int paramNum, char *val, unsigned long len);
+typedef void (*StatementHandle_BindNullFunc)(StatementHandle *sth, int paramNum);
+
 
 OBJECTFUNC_TYPES(StatementHandle)
 
@@ -47,6 +56,12 @@ typedef struct StatementHandleFuncsStruct {
   StatementHandle_FinishFunc finish; \
   StatementHandle_GetInsertIdFunc getInsertId; \
   StatementHandle_addFlagFunc addFlag; \
+  StatementHandle_BindIntFunc bindInt; \
+  StatementHandle_BindLongFunc bindLong; \
+  StatementHandle_BindLongLongFunc bindLongLong; \
+  StatementHandle_BindDoubleFunc bindDouble; \
+  StatementHandle_BindStringFunc bindString; \
+  StatementHandle_BindNullFunc bindNull; \
   unsigned long flags;
   
 #define FUNCSTRUCTTYPE StatementHandleFuncs
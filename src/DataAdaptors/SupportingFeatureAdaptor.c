@@ -24,6 +24,7 @@ features from the database.
 
 #include "SupportingFeatureAdaptor.h"
 
+#include "BatchInsertWriter.h"
 #include "DNAAlignFeatureAdaptor.h"
 #include "ProteinAlignFeatureAdaptor.h"
 #include "BaseAlignFeature.h"
@@ -155,38 +156,21 @@ Vector *SupportingFeatureAdaptor_fetchAllByExonList(SupportingFeatureAdaptor *sf
   int nUniqueId = IDHash_getNumValues(exHash);
   
 
-  char tmpStr[1024];
-  char *qStr = NULL;
-  int lenNum;
+  StrBuf *qStr = StrBuf_new(STRBUF_DEFAULTSIZE);
   int maxSize = 16384;
 
-  if ((qStr = (char *)calloc(655500,sizeof(char))) == NULL) {
-    fprintf(stderr,"Failed allocating qStr\n");
-    return NULL;
-  }
-
   IDHash *dnaFeatIdToExHash  = IDHash_new(IDHASH_MEDIUM);
   IDHash *protFeatIdToExHash = IDHash_new(IDHASH_MEDIUM);
   IDHash *idToEx;
 
   for (i=0; i<nUniqueId; i+=maxSize) {
-    int endPoint = sprintf(qStr, "SELECT sf.feature_type, sf.feature_id, sf.exon_id FROM supporting_feature sf WHERE sf.exon_id IN (" );
-
-    int j;
-    for (j=0; j<maxSize && j+i<nUniqueId; j++) {
-      if (j!=0) {
-        qStr[endPoint++] = ',';
-        qStr[endPoint++] = ' ';
-      }
-      lenNum = sprintf(tmpStr,IDFMTSTR,uniqueIds[i+j]);
-      memcpy(&(qStr[endPoint]), tmpStr, lenNum);
-      endPoint+=lenNum;
-    }
-    qStr[endPoint++] = ')';
-    qStr[endPoint] = '\0';
+    StrBuf_clear(qStr);
+    StrBuf_append(qStr, "SELECT sf.feature_type, sf.feature_id, sf.exon_id FROM supporting_feature sf WHERE sf.exon_id IN (" );
+    StrBuf_appendIDList(qStr, &uniqueIds[i], nUniqueId-i < maxSize ? nUniqueId-i : maxSize);
+    StrBuf_appendChar(qStr, ')');
   
   
-    StatementHandle *sth = sfa->prepare((BaseAdaptor *)sfa,qStr,strlen(qStr));
+    StatementHandle *sth = sfa->prepare((BaseAdaptor *)sfa,StrBuf_getString(qStr),StrBuf_getLength(qStr));
     sth->execute(sth);
   
     ResultRow *row;
@@ -287,7 +271,7 @@ Vector *SupportingFeatureAdaptor_fetchAllByExonList(SupportingFeatureAdaptor *sf
     if (exon->supportingFeatures == NULL) exon->supportingFeatures = emptyVector;
   }
 
-  free(qStr);
+  StrBuf_free(qStr);
   return out;
 }
 
@@ -314,7 +298,6 @@ void SupportingFeatureAdaptor_store(SupportingFeatureAdaptor *sfa, IDType exonDb
   char pepCheckSql[1024];
   char dnaCheckSql[1024];
   char assocCheckSql[1024];
-  char assocWriteSql[1024];
 
 // Note added in hcoverage so transcript_supporting_feature and supporting_feature code match
   sprintf(pepCheckSql,
@@ -353,18 +336,35 @@ void SupportingFeatureAdaptor_store(SupportingFeatureAdaptor *sfa, IDType exonDb
       " AND   feature_type = '%%s'"
       " AND   feature_id   = %"IDFMTSTR, exonDbID);
 
-  sprintf(assocWriteSql, 
-          "INSERT into supporting_feature (exon_id, feature_id, feature_type) values(%"IDFMTSTR", %"IDFMTSTR", '%%s')");
-
   StatementHandle *pepCheckSth   = sfa->prepare((BaseAdaptor *)sfa, pepCheckSql, strlen(pepCheckSql));
   StatementHandle *dnaCheckSth   = sfa->prepare((BaseAdaptor *)sfa, dnaCheckSql, strlen(dnaCheckSql));
   StatementHandle *assocCheckSth = sfa->prepare((BaseAdaptor *)sfa, assocCheckSql, strlen(assocCheckSql));
-  StatementHandle *sfSth         = sfa->prepare((BaseAdaptor *)sfa, assocWriteSql, strlen(assocWriteSql));
 
   DNAAlignFeatureAdaptor *dnaAdaptor     = DBAdaptor_getDNAAlignFeatureAdaptor(sfa->dba);
   ProteinAlignFeatureAdaptor *pepAdaptor = DBAdaptor_getProteinAlignFeatureAdaptor(sfa->dba);
   SliceAdaptor *sliceAdaptor             = DBAdaptor_getSliceAdaptor(sfa->dba);
 
+// Features which aren't in the db yet are collected and stored with one (batched) store call per type,
+// and the association rows are batched too, rather than a round trip per feature for each
+  Vector *newDnaFeatures = Vector_new();
+  Vector *newPepFeatures = Vector_new();
+
+  // Keyed on feature pointer, so a feature which is in alnObjs more than once is only handled once
+  IDHash *seenFeatures = IDHash_new(IDHASH_SMALL);
+
+  // The (type, feature) pairs to associate with the exon. For features which were already in the db
+  // the feature id is filled in here, for new ones it is taken from the feature once it has been stored
+  int nAssoc = 0;
+  int nAssocAlloced = Vector_getNumElement(alnObjs) ? Vector_getNumElement(alnObjs) : 1;
+  BaseAlignFeature **assocFeatures = (BaseAlignFeature **)calloc(nAssocAlloced, sizeof(BaseAlignFeature *));
+  IDType *assocDbIDs               = (IDType *)calloc(nAssocAlloced, sizeof(IDType));
+  char **assocTypes                = (char **)calloc(nAssocAlloced, sizeof(char *));
+
+  if (assocFeatures == NULL || assocDbIDs == NULL || assocTypes == NULL) {
+    fprintf(stderr, "ERROR: Failed allocating supporting feature association arrays\n");
+    exit(1);
+  }
+
   int i;
   for (i=0; i < Vector_getNumElement(alnObjs); i++) {
     BaseAlignFeature *f = Vector_getElementAt(alnObjs, i);
@@ -396,10 +396,14 @@ void SupportingFeatureAdaptor_store(SupportingFeatureAdaptor *sfa, IDType exonDb
             "it can't be stored");
     }
 */
+
+    if (IDHash_contains(seenFeatures, (IDType)(size_t)f)) {
+      continue;
+    }
+    IDHash_add(seenFeatures, (IDType)(size_t)f, f);
     
-    IDType sfDbID;
     char *type = NULL;
-    BaseFeatureAdaptor *adap;
+    Vector *newFeatures;
     StatementHandle *checkSth;
 
     IDType seqRegionId = SliceAdaptor_getSeqRegionId(sliceAdaptor, BaseAlignFeature_getSlice(f));
@@ -407,8 +411,8 @@ void SupportingFeatureAdaptor_store(SupportingFeatureAdaptor *sfa, IDType exonDb
 // Note - moved the checkSth execute into the condition because I can't do the variable args
     if (seqRegionId) {
       if (f->objectType == CLASS_DNADNAALIGNFEATURE) {
-        adap     = (BaseFeatureAdaptor*)dnaAdaptor;      
-        type     = "dna_align_feature";
+        newFeatures = newDnaFeatures;
+        type        = "dna_align_feature";
 
       checkSth = dnaCheckSth;
       checkSth->execute(checkSth, seqRegionId, 
@@ -424,8 +428,8 @@ void SupportingFeatureAdaptor_store(SupportingFeatureAdaptor *sfa, IDType exonDb
                                   DNAAlignFeature_getHitStrand((DNAAlignFeature *)f));
 
       } else if (f->objectType == CLASS_DNAPEPALIGNFEATURE) {
-        adap     = (BaseFeatureAdaptor*)pepAdaptor;
-        type     = "protein_align_feature";
+        newFeatures = newPepFeatures;
+        type        = "protein_align_feature";
 
       checkSth = pepCheckSth;
       checkSth->execute(checkSth, seqRegionId, 
@@ -447,35 +451,81 @@ void SupportingFeatureAdaptor_store(SupportingFeatureAdaptor *sfa, IDType exonDb
       /// HOW?? - moved into conditions above
       //    checkSth->execute(@check_args);
 
+      assocTypes[nAssoc] = type;
+
       if (checkSth->numRows(checkSth) > 0) {
         ResultRow *row = checkSth->fetchRow(checkSth);
-        sfDbID = row->getLongLongAt(row, 0);
+        assocDbIDs[nAssoc] = row->getLongLongAt(row, 0);
 
       } else {
-        Vector *vec = Vector_new();
-        Vector_addElement(vec, f);
-        //BaseFeatureAdaptor_store(adap, vec);
-        adap->store((BaseAdaptor*)adap, vec);
-        Vector_free(vec);
-     
-        sfDbID = BaseAlignFeature_getDbID(f);
+        // Stored below - a newly stored feature can't already be associated with the exon
+        Vector_addElement(newFeatures, f);
+        assocFeatures[nAssoc] = f;
       }
+      nAssoc++;
+    } else {
+      fprintf(stderr, "Error getting sequence region ID for slice");
+    }
+  }
 
-    // now check association
-    assocCheckSth->execute(assocCheckSth, type, sfDbID);
+  if (Vector_getNumElement(newDnaFeatures)) {
+    dnaAdaptor->store((BaseAdaptor*)dnaAdaptor, newDnaFeatures);
+  }
+  if (Vector_getNumElement(newPepFeatures)) {
+    pepAdaptor->store((BaseAdaptor*)pepAdaptor, newPepFeatures);
+  }
 
-    if (checkSth->numRows(assocCheckSth) == 0) {
-      sfSth->execute(sfSth, exonDbID, sfDbID, type);
-    }
+  char *assocColumns[] = { "exon_id", "feature_id", "feature_type", NULL };
+  BatchInsertWriter *biw = BatchInsertWriter_new(sfa->dba, "supporting_feature", assocColumns, 0);
 
-    dnaCheckSth->finish(dnaCheckSth);
-    pepCheckSth->finish(pepCheckSth);
-    assocCheckSth->finish(assocCheckSth);
-    sfSth->finish(sfSth);
+  // Two input features can match the same db feature, so also track which associations have been written
+  IDHash *dnaAssocIds = IDHash_new(IDHASH_SMALL);
+  IDHash *pepAssocIds = IDHash_new(IDHASH_SMALL);
+
+  for (i=0; i < nAssoc; i++) {
+    IDType sfDbID;
+    char *type = assocTypes[i];
+    IDHash *assocIds = !strcmp(type, "dna_align_feature") ? dnaAssocIds : pepAssocIds;
+
+    if (assocFeatures[i] != NULL) {
+      sfDbID = BaseAlignFeature_getDbID(assocFeatures[i]);
     } else {
-      fprintf(stderr, "Error getting sequence region ID for slice");
+      sfDbID = assocDbIDs[i];
+
+      // now check association
+      assocCheckSth->execute(assocCheckSth, type, sfDbID);
+
+      if (assocCheckSth->numRows(assocCheckSth) != 0) {
+        continue;
+      }
+    }
+
+    if (IDHash_contains(assocIds, sfDbID)) {
+      continue;
     }
+    IDHash_add(assocIds, sfDbID, &(assocDbIDs[i]));
+
+    BatchInsertWriter_startRow(biw);
+    BatchInsertWriter_addLongLong(biw, exonDbID);
+    BatchInsertWriter_addLongLong(biw, sfDbID);
+    BatchInsertWriter_addString(biw, type);
+    BatchInsertWriter_endRow(biw, NULL, NULL);
   }
 
+  BatchInsertWriter_free(biw);
+
+  dnaCheckSth->finish(dnaCheckSth);
+  pepCheckSth->finish(pepCheckSth);
+  assocCheckSth->finish(assocCheckSth);
+
+  IDHash_free(dnaAssocIds, NULL);
+  IDHash_free(pepAssocIds, NULL);
+  IDHash_free(seenFeatures, NULL);
+  Vector_free(newDnaFeatures);
+  Vector_free(newPepFeatures);
+  free(assocFeatures);
+  free(assocDbIDs);
+  free(assocTypes);
+
   return;
 }
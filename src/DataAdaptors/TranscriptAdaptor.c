@@ -20,6 +20,7 @@
 #include "DBAdaptor.h"
 #include "DBEntryAdaptor.h"
 #include "StrUtil.h"
+#include "StrBuf.h"
 #include "BaseAdaptor.h"
 #include "MysqlUtil.h"
 #include "Exon.h"
@@ -419,20 +420,18 @@ void TranscriptRankPair_free(TranscriptRankPair *trp) {
 }
 
 Vector *TranscriptAdaptor_fetchAllBySlice(TranscriptAdaptor *ta, Slice *slice, int loadExons, char *logicName, char *inputConstraint) {
-  char *constraint = NULL;
-  if ((constraint = (char *)calloc(655500,sizeof(char))) == NULL) {
-    fprintf(stderr,"Failed allocating constraint\n");
-    return NULL;
-  }
+  StrBuf *constraint = StrBuf_new(STRBUF_DEFAULTSIZE + (inputConstraint ? strlen(inputConstraint) : 0));
 
-  strcpy(constraint, "t.is_current = 1");
+  StrBuf_append(constraint, "t.is_current = 1");
   //fprintf(stderr, "Length of input constraint = %ld\n", strlen(inputConstraint));
 
   if (inputConstraint != NULL && inputConstraint[0] != '\0') {
-    sprintf(constraint,"%s AND %s", constraint, inputConstraint);
+    StrBuf_append(constraint, " AND ");
+    StrBuf_append(constraint, inputConstraint);
   }
     
-  Vector *transcripts = TranscriptAdaptor_fetchAllBySliceConstraint(ta, slice, constraint, logicName);
+  Vector *transcripts = TranscriptAdaptor_fetchAllBySliceConstraint(ta, slice, StrBuf_getString(constraint), logicName);
+  StrBuf_free(constraint);
 
   // if there are 0 or 1 transcripts still do lazy-loading
 // SMJS Tweaked so never does lazy loading
@@ -491,37 +490,20 @@ Vector *TranscriptAdaptor_fetchAllBySlice(TranscriptAdaptor *ta, Slice *slice, i
 
   int maxSize = 16384;
 
-  char tmpStr[1024];
-  char *qStr = NULL;
-  int lenNum;
+  // One builder reused for all the chunks of both queries
+  StrBuf *qStr = StrBuf_new(STRBUF_DEFAULTSIZE);
   IDHash *exTrHash = IDHash_new(IDHASH_LARGE);
-  int endPoint;
-//  bzero(qStr,655500);
-
-  if ((qStr = (char *)calloc(655500,sizeof(char))) == NULL) {
-    fprintf(stderr,"Failed allocating qStr\n");
-    return transcripts;
-  }
 
 
 // Divide query if a lot of ids - Not done in perl
   for (i=0; i<nUniqueId; i+=maxSize) {
     //fprintf(stderr,"Transcript loop i = %d\n", i);
-    endPoint = sprintf(qStr, "SELECT transcript_id, exon_id, rank FROM exon_transcript WHERE transcript_id IN (" );
-    int j;
-    for (j=0; j<maxSize && j+i<nUniqueId; j++) {
-      if (j!=0) {
-        qStr[endPoint++] = ',';
-        qStr[endPoint++] = ' ';
-      }
-      lenNum = sprintf(tmpStr,IDFMTSTR,uniqueIds[i+j]);
-      memcpy(&(qStr[endPoint]), tmpStr, lenNum);
-      endPoint+=lenNum;
-    }
-    qStr[endPoint++] = ')';
-    qStr[endPoint] = '\0';
+    StrBuf_clear(qStr);
+    StrBuf_append(qStr, "SELECT transcript_id, exon_id, rank FROM exon_transcript WHERE transcript_id IN (" );
+    StrBuf_appendIDList(qStr, &uniqueIds[i], nUniqueId-i < maxSize ? nUniqueId-i : maxSize);
+    StrBuf_appendChar(qStr, ')');
   
-    StatementHandle *sth = ta->prepare((BaseAdaptor *)ta,qStr,strlen(qStr));
+    StatementHandle *sth = ta->prepare((BaseAdaptor *)ta,StrBuf_getString(qStr),StrBuf_getLength(qStr));
     sth->execute(sth);
   
     ResultRow *row;
@@ -556,31 +538,20 @@ Vector *TranscriptAdaptor_fetchAllBySlice(TranscriptAdaptor *ta, Slice *slice, i
 
   Vector *exons = Vector_new();
 
-//  bzero(qStr,655500);
   // Divide query if a lot of ids - Not done in perl
   for (i=0; i<nUniqueId; i+=maxSize) {
     //fprintf(stderr,"Exon loop i = %d\n", i);
-    endPoint = sprintf(qStr, "e.exon_id IN (");
-    int j;
-    for (j=0; j<maxSize && j+i<nUniqueId; j++) {
-      if (j!=0) {
-        qStr[endPoint++] = ',';
-        qStr[endPoint++] = ' ';
-      }
-      
-      lenNum = sprintf(tmpStr,IDFMTSTR,uniqueIds[j+i]);
-      memcpy(&(qStr[endPoint]), tmpStr, lenNum);
-      endPoint+=lenNum;
-    }
-    qStr[endPoint++] = ')';
-    qStr[endPoint] = '\0';
+    StrBuf_clear(qStr);
+    StrBuf_append(qStr, "e.exon_id IN (");
+    StrBuf_appendIDList(qStr, &uniqueIds[i], nUniqueId-i < maxSize ? nUniqueId-i : maxSize);
+    StrBuf_appendChar(qStr, ')');
 
-    //fprintf(stderr, "qStr = %s\n", qStr);
+    //fprintf(stderr, "qStr = %s\n", StrBuf_getString(qStr));
   
     // Interaction with slice feature fetch cache can be horrid - it frees the oldest cached features vector (and the features!) after cachce fills
    
     ExonAdaptor *ea = DBAdaptor_getExonAdaptor(ta->dba);
-    Vector *tmpVec = ExonAdaptor_fetchAllBySliceConstraint(ea, extSlice, qStr, NULL);  
+    Vector *tmpVec = ExonAdaptor_fetchAllBySliceConstraint(ea, extSlice, StrBuf_getString(qStr), NULL);  
     
     //fprintf(stderr,"Adding %d elements from tmpVec to exons. Num in exons before = %d\n", Vector_getNumElement(tmpVec), Vector_getNumElement(exons));
     
@@ -638,8 +609,7 @@ Vector *TranscriptAdaptor_fetchAllBySlice(TranscriptAdaptor *ta, Slice *slice, i
   // Free stuff
   IDHash_free(exTrHash, Vector_free);
 
-  free(qStr);
-  free(constraint);
+  StrBuf_free(qStr);
   
   return transcripts;
 }
@@ -891,39 +861,45 @@ Vector *TranscriptAdaptor_fetchByExonStableId(TranscriptAdaptor *ta, char *stabl
 =cut
 */
 Vector *TranscriptAdaptor_fetchAllByBiotype(TranscriptAdaptor *ta, Vector *biotypes) {
-  char constraint[1024];
+  StrBuf *constraint = StrBuf_new(STRBUF_DEFAULTSIZE);
 
   TranscriptAdaptor_biotypeConstraint(ta, biotypes, constraint);
 
-  return TranscriptAdaptor_genericFetch(ta, constraint, NULL, NULL);
+  Vector *transcripts = TranscriptAdaptor_genericFetch(ta, StrBuf_getString(constraint), NULL, NULL);
+  StrBuf_free(constraint);
+
+  return transcripts;
 }
 
 
 
-void TranscriptAdaptor_biotypeConstraint(TranscriptAdaptor *ta, Vector *biotypes, char *constraint) {
+// Appends the constraint for biotypes to constraint
+void TranscriptAdaptor_biotypeConstraint(TranscriptAdaptor *ta, Vector *biotypes, StrBuf *constraint) {
   if (biotypes == NULL || Vector_getNumElement(biotypes) == 0) {
     fprintf(stderr,"list of biotypes expected\n");
     exit(1);
   }
 
   if (Vector_getNumElement(biotypes) > 1) {
-    strcpy(constraint, "t.biotype IN (");
+    StrBuf_append(constraint, "t.biotype IN (");
 
     int i;
     for (i=0;i<Vector_getNumElement(biotypes); i++) {
       char *biotype = Vector_getElementAt(biotypes, i);
 
       if (i>0) {
-        strcat(constraint, ", ");
+        StrBuf_append(constraint, ", ");
       }
-      sprintf(constraint, "%s'%s'", constraint, biotype);
+      StrBuf_appendChar(constraint, '\'');
+      StrBuf_append(constraint, biotype);
+      StrBuf_appendChar(constraint, '\'');
     }
-    strcat(constraint, ") and t.is_current = 1");
+    StrBuf_append(constraint, ") and t.is_current = 1");
 
   } else { // just one
     char *biotype = Vector_getElementAt(biotypes, 0);
 
-    sprintf(constraint, "t.biotype = '%s' and t.is_current = 1", biotype);
+    StrBuf_appendf(constraint, "t.biotype = '%s' and t.is_current = 1", biotype);
   }
 
   return;
@@ -1021,10 +997,7 @@ IDType TranscriptAdaptor_store(TranscriptAdaptor *ta, Transcript *transcript, ID
   // 
   ExonAdaptor *exonAdaptor = DBAdaptor_getExonAdaptor(db);
   int i;
-  for (i=0; i<Transcript_getExonCount(transcript); i++) {
-    Exon *exon = Transcript_getExonAt(transcript, i);
-    ExonAdaptor_store(exonAdaptor, exon);
-  }
+  ExonAdaptor_storeAll(exonAdaptor, Transcript_getAllExons(transcript));
 
 /* Not doing transfers - don't think they should be necessary (hopefully)
   my $original_translation = $transcript->translation();
@@ -1041,54 +1014,39 @@ IDType TranscriptAdaptor_store(TranscriptAdaptor *ta, Transcript *transcript, ID
   //
   // Store transcript
   // 
-  char fmtStr[1024];
   char qStr[1024];
-  sprintf(fmtStr, "INSERT INTO transcript "
+  StrBuf *insertQStr = StrBuf_new(STRBUF_DEFAULTSIZE);
+  StrBuf_appendf(insertQStr, "INSERT INTO transcript "
                 "SET gene_id = "IDFMTSTR", "
                     "analysis_id = "IDFMTSTR", "
                     "seq_region_id = "IDFMTSTR", " 
                     "seq_region_start = %ld, "
                     "seq_region_end = %ld, "
-                    "seq_region_strand = %d, " 
-                    "biotype = %%s, "
-                    "status = %%s, "
-                    "description = %%s, "
-                    //"biotype = '%s', "
-                    //"status = '%s', "
-                    //"description = '%s', "
-                    "is_current = %d, "
-                    "canonical_translation_id = NULL",
+                    "seq_region_strand = %d, ",
          geneDbID,
          newAnalysisId,
          seqRegionId,
          Transcript_getSeqRegionStart((SeqFeature*)transcript),
           Transcript_getSeqRegionEnd((SeqFeature*)transcript),
-          Transcript_getSeqRegionStrand((SeqFeature*)transcript),
-         //Transcript_getBiotype(transcript),
-         //Transcript_getStatus(transcript),
-         //Transcript_getDescription(transcript),
-         isCurrent); 
+          Transcript_getSeqRegionStrand((SeqFeature*)transcript));
 
-  char bioTypeQStr[1024];
   if (Transcript_getBiotype(transcript)) {
-    sprintf(bioTypeQStr,"'%s'", Transcript_getBiotype(transcript));
+    StrBuf_appendf(insertQStr, "biotype = '%s', ", Transcript_getBiotype(transcript));
   } else {
-    sprintf(bioTypeQStr, "NULL");
+    StrBuf_append(insertQStr, "biotype = NULL, ");
   }
-  char statusQStr[1024];
   if (Transcript_getStatus(transcript)) {
-    sprintf(statusQStr,"'%s'", Transcript_getStatus(transcript));
+    StrBuf_appendf(insertQStr, "status = '%s', ", Transcript_getStatus(transcript));
   } else {
-    sprintf(statusQStr, "NULL");
+    StrBuf_append(insertQStr, "status = NULL, ");
   }
-  char descQStr[1024];
   if (Transcript_getDescription(transcript)) {
-    sprintf(descQStr,"'%s'", Transcript_getDescription(transcript));
+    StrBuf_appendf(insertQStr, "description = '%s', ", Transcript_getDescription(transcript));
   } else {
-    sprintf(descQStr, "NULL");
+    StrBuf_append(insertQStr, "description = NULL, ");
   }
 
-  sprintf(qStr, fmtStr, bioTypeQStr, statusQStr, descQStr);
+  StrBuf_appendf(insertQStr, "is_current = %d, canonical_translation_id = NULL", isCurrent);
 
   if (Transcript_getStableId(transcript)) {
 /* Use FROM_UNIXTIME for now
@@ -1098,11 +1056,12 @@ IDType TranscriptAdaptor_store(TranscriptAdaptor *ta, Transcript *transcript, ID
 
     // Assume version will be positive, Transcript sets it to -1 when initialised
     int version = Transcript_getVersion(transcript) > 0 ? Transcript_getVersion(transcript) : 1; 
-    sprintf(qStr,"%s, stable_id = '%s', version = %d, created_date = FROM_UNIXTIME(%ld), modified_date = FROM_UNIXTIME(%ld)",
-            qStr, Transcript_getStableId(transcript), version, Transcript_getCreated(transcript), Transcript_getModified(transcript));
+    StrBuf_appendf(insertQStr, ", stable_id = '%s', version = %d, created_date = FROM_UNIXTIME(%ld), modified_date = FROM_UNIXTIME(%ld)",
+                   Transcript_getStableId(transcript), version, Transcript_getCreated(transcript), Transcript_getModified(transcript));
   }
 
-  StatementHandle *tst = ta->prepare((BaseAdaptor *)ta,qStr,strlen(qStr));
+  StatementHandle *tst = ta->prepare((BaseAdaptor *)ta,StrBuf_getString(insertQStr),StrBuf_getLength(insertQStr));
+  StrBuf_free(insertQStr);
 
   tst->execute(tst);
 
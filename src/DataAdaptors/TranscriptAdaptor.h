@@ -41,7 +41,7 @@ Vector *           TranscriptAdaptor_fetchAllBySlice(TranscriptAdaptor *ta, Slic
 Transcript *       TranscriptAdaptor_fetchByDisplayLabel(TranscriptAdaptor *ta, char *label);
 Vector *           TranscriptAdaptor_fetchByExonStableId(TranscriptAdaptor *ta, char *stableId);
 Vector *           TranscriptAdaptor_fetchAllByBiotype(TranscriptAdaptor *ta, Vector *biotypes);
-void               TranscriptAdaptor_biotypeConstraint(TranscriptAdaptor *ta, Vector *biotypes, char *constraint);
+void               TranscriptAdaptor_biotypeConstraint(TranscriptAdaptor *ta, Vector *biotypes, StrBuf *constraint);
 int                TranscriptAdaptor_isTranscriptCanonical(TranscriptAdaptor *ta, Transcript *transcript);
 Vector *           TranscriptAdaptor_listDbIDs(TranscriptAdaptor *ta, int ordered);
 Vector *           TranscriptAdaptor_listStableIDs(TranscriptAdaptor *ta);
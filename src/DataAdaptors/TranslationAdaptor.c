@@ -32,6 +32,7 @@ Translation.
 #include "BaseAdaptor.h"
 #include "MysqlUtil.h"
 #include "Exon.h"
+#include "StrBuf.h"
 
 #include "StatementHandle.h"
 #include "ResultRow.h"
@@ -379,8 +380,8 @@ IDType TranslationAdaptor_store(TranslationAdaptor *tlna, Translation *translati
     fprintf(stderr, "end_Exon must have a dbID for Translation to be stored.\n");
   }
 
-  char qStr[1024];
-  sprintf(qStr,
+  StrBuf *qStr = StrBuf_new(STRBUF_DEFAULTSIZE);
+  StrBuf_appendf(qStr,
          "INSERT INTO translation " 
              "SET seq_start = %d,"
                 " start_exon_id = "IDFMTSTR","
@@ -400,11 +401,12 @@ IDType TranslationAdaptor_store(TranslationAdaptor *tlna, Translation *translati
 */
     // Assume version will be positive, Translation sets it to -1 when initialised
     int version = Translation_getVersion(translation) > 0 ? Translation_getVersion(translation) : 1; 
-    sprintf(qStr,"%s, stable_id = '%s', version = %d, created_date = FROM_UNIXTIME(%ld), modified_date = FROM_UNIXTIME(%ld)",
-            qStr, Translation_getStableId(translation), version, Translation_getCreated(translation), Translation_getModified(translation));
+    StrBuf_appendf(qStr, ", stable_id = '%s', version = %d, created_date = FROM_UNIXTIME(%ld), modified_date = FROM_UNIXTIME(%ld)",
+                   Translation_getStableId(translation), version, Translation_getCreated(translation), Translation_getModified(translation));
   }
 
-  StatementHandle *sth = tlna->prepare((BaseAdaptor *)tlna,qStr,strlen(qStr));
+  StatementHandle *sth = tlna->prepare((BaseAdaptor *)tlna,StrBuf_getString(qStr),StrBuf_getLength(qStr));
+  StrBuf_free(qStr);
 
   sth->execute(sth);
  
@@ -728,31 +730,20 @@ Vector *TranslationAdaptor_fetchAllByTranscriptList(TranslationAdaptor *tlna, Ve
 
   // Unused in perlmy %ex_hash;
 
-  for (i=0; i<nUniqueId; i+=maxSize) {
-    char *idStr = NULL;
-
-    if ((idStr = (char *)calloc(655500,sizeof(char))) == NULL) {
-      fprintf(stderr,"Failed allocating idStr\n");
-      return out;
-    }
+  StrBuf *idStr = StrBuf_new(STRBUF_DEFAULTSIZE);
+  StrBuf *qStr  = StrBuf_new(STRBUF_DEFAULTSIZE);
 
-    idStr[0] = '\0';
+  for (i=0; i<nUniqueId; i+=maxSize) {
+    StrBuf_clear(idStr);
 
     // Special case for one remaining Id
     if (i == nUniqueId-1) {
-      sprintf(idStr, " = "IDFMTSTR, uniqueIds[i]);
+      StrBuf_append(idStr, " = ");
+      StrBuf_appendID(idStr, uniqueIds[i]);
     } else {
-      char tmpStr[1024];
-      strcat(idStr, " IN (");
-      int j;
-      for (j=0; j<maxSize && j+i<nUniqueId; j++) {
-        if (j!=0) {
-          strcat(idStr,", ");
-        }
-        sprintf(tmpStr, IDFMTSTR, uniqueIds[i+j]);
-        strcat(idStr, tmpStr);
-      }
-      strcat(idStr, ")");
+      StrBuf_append(idStr, " IN (");
+      StrBuf_appendIDList(idStr, &uniqueIds[i], nUniqueId-i < maxSize ? nUniqueId-i : maxSize);
+      StrBuf_appendChar(idStr, ')');
     }
     
     IDHash *canonicalLookup = IDHash_new(IDHASH_SMALL);
@@ -761,15 +752,10 @@ Vector *TranslationAdaptor_fetchAllByTranscriptList(TranslationAdaptor *tlna, Ve
     //  -SQL => 'SELECT transcript_id, canonical_translation_id FROM transcript WHERE transcript_id '.$id_str
     //);
     
-    char *qStr = NULL;
-
-    if ((qStr = (char *)calloc(655500,sizeof(char))) == NULL) {
-      fprintf(stderr,"Failed allocating qStr\n");
-      return out;
-    }
-
-    sprintf(qStr,"SELECT transcript_id, canonical_translation_id FROM transcript WHERE transcript_id %s", idStr);
-    StatementHandle *sth = tlna->prepare((BaseAdaptor *)tlna,qStr,strlen(qStr));
+    StrBuf_clear(qStr);
+    StrBuf_append(qStr, "SELECT transcript_id, canonical_translation_id FROM transcript WHERE transcript_id ");
+    StrBuf_append(qStr, StrBuf_getString(idStr));
+    StatementHandle *sth = tlna->prepare((BaseAdaptor *)tlna,StrBuf_getString(qStr),StrBuf_getLength(qStr));
     sth->execute(sth);
     ResultRow *row;
     while ((row = sth->fetchRow(sth))) {
@@ -794,13 +780,15 @@ Vector *TranslationAdaptor_fetchAllByTranscriptList(TranslationAdaptor *tlna, Ve
     // Can't be arsed my $created_date = $self->db->dbc->from_date_to_seconds("tl.created_date");
     // Can't be arsed my $modified_date = $self->db->dbc->from_date_to_seconds("tl.modified_date");
 
-    sprintf(qStr,"SELECT tl.transcript_id, tl.translation_id, tl.start_exon_id, "
-                        "tl.end_exon_id, tl.seq_start, tl.seq_end, "
-                        "tl.stable_id, tl.version, UNIX_TIMESTAMP(tl.created_date), UNIX_TIMESTAMP(tl.modified_date) "
-                   "FROM translation tl "
-                  "WHERE tl.transcript_id %s", idStr);
+    StrBuf_clear(qStr);
+    StrBuf_append(qStr, "SELECT tl.transcript_id, tl.translation_id, tl.start_exon_id, "
+                               "tl.end_exon_id, tl.seq_start, tl.seq_end, "
+                               "tl.stable_id, tl.version, UNIX_TIMESTAMP(tl.created_date), UNIX_TIMESTAMP(tl.modified_date) "
+                          "FROM translation tl "
+                         "WHERE tl.transcript_id ");
+    StrBuf_append(qStr, StrBuf_getString(idStr));
 
-    sth = tlna->prepare((BaseAdaptor *)tlna,qStr,strlen(qStr));
+    sth = tlna->prepare((BaseAdaptor *)tlna,StrBuf_getString(qStr),StrBuf_getLength(qStr));
     sth->execute(sth);
 
     while ((row = sth->fetchRow(sth))) {
@@ -819,10 +807,10 @@ Vector *TranslationAdaptor_fetchAllByTranscriptList(TranslationAdaptor *tlna, Ve
     }
     sth->finish(sth);
     IDHash_free(canonicalLookup, free);
-    free(idStr);
-    free(qStr);
   }
 
+  StrBuf_free(idStr);
+  StrBuf_free(qStr);
   free(uniqueIds);
   IDHash_free(transHash,NULL);
 
@@ -67,7 +67,7 @@ struct AnnotatedSeqFeatureStruct {
 #define AnnotatedSeqFeature_setStrand(asf,strand) SeqFeature_setStrand((asf),(strand))
 #define AnnotatedSeqFeature_getStrand(asf) SeqFeature_getStrand((asf))
 
-#define AnnotatedSeqFeature_setStableId(asf,stableId)  StableIdInfo_setStableId(&((asf)->si),(stableId))
+#define AnnotatedSeqFeature_setStableId(asf,stableId)  StableIdInfo_setStableId(&((asf)->si),(stableId),Object_isInArena(asf))
 #define AnnotatedSeqFeature_getStableId(asf)  StableIdInfo_getStableId(&((asf)->si))
 
 #define AnnotatedSeqFeature_setVersion(asf,ver)  StableIdInfo_setVersion(&((asf)->si),(ver))
@@ -19,6 +19,8 @@
 #undef  __ASSEMBLYMAPPER_MAIN__
 #include "AssemblyMapperAdaptor.h"
 
+static char *AssemblyMapper_registerForFastMap(AssemblyMapper *am, IDType seqRegionId, long frmStart, long frmEnd, CoordSystem *frmCs);
+
 /*
 =head1 DESCRIPTION
 
@@ -206,18 +208,8 @@ MapperRangeSet *AssemblyMapper_mapImpl(AssemblyMapper *am, char *frmSeqRegionNam
 */
 // HACK HACK HACK - freeing an IDHash within an IDHash
 void freeRegisterIDHash(IDHash *idHash) {
-  int i;
-
-  for (i=0; i<idHash->size; i++) {
-    if (idHash->bucketCounts[i]) {
-      // No need to free values because they weren't allocated 
-      free(idHash->buckets[i]);
-    }
-  }
-
-  free(idHash->buckets);
-  free(idHash->bucketCounts);
-  free(idHash);
+  // No need to free values because they weren't allocated 
+  IDHash_free(idHash, NULL);
 }
 
 void AssemblyMapper_flushImpl(AssemblyMapper *am) {
@@ -286,13 +278,32 @@ int AssemblyMapper_getSize(AssemblyMapper *am) {
 
 MapperRangeSet *AssemblyMapper_fastMapImpl(AssemblyMapper *am, char *frmSeqRegionName, long frmStart, long frmEnd, int frmStrand, CoordSystem *frmCs, Slice *toSlice) {
   Mapper *mapper  = AssemblyMapper_getMapper(am);
-  CoordSystem *asmCs  = AssemblyMapper_getAssembledCoordSystem(am);
-  CoordSystem *cmpCs  = AssemblyMapper_getComponentCoordSystem(am);
-  AssemblyMapperAdaptor *adaptor = AssemblyMapper_getAdaptor(am);
-  char *frm;
+  IDType seqRegionId = AssemblyMapper_getSeqRegionId(am, frmSeqRegionName, frmCs);
+  char *frm = AssemblyMapper_registerForFastMap(am, seqRegionId, frmStart, frmEnd, frmCs);
+
+  return Mapper_fastMap( mapper, seqRegionId, frmStart, frmEnd, frmStrand, frm );
+}
 
+/*
+ As fastMap, but into result with no allocation, for mapping lots of
+ features. The region is registered first, as fastMap does. Returns 1 if
+ the region mapped, 0 if not (result is a gap) and -1 if even after
+ registering the seq region has nothing in the mapper (where fastMap exits).
+*/
+int AssemblyMapper_fastMapInto(AssemblyMapper *am, char *frmSeqRegionName, long frmStart, long frmEnd, int frmStrand, CoordSystem *frmCs, MapperResult *result) {
+  Mapper *mapper  = AssemblyMapper_getMapper(am);
   IDType seqRegionId = AssemblyMapper_getSeqRegionId(am, frmSeqRegionName, frmCs);
+  char *frm = AssemblyMapper_registerForFastMap(am, seqRegionId, frmStart, frmEnd, frmCs);
 
+  return Mapper_fastMapInto( mapper, seqRegionId, frmStart, frmEnd, frmStrand, frm, result );
+}
+
+// Registers the region for mapping from frmCs, returning the mapper type to map from
+static char *AssemblyMapper_registerForFastMap(AssemblyMapper *am, IDType seqRegionId, long frmStart, long frmEnd, CoordSystem *frmCs) {
+  CoordSystem *asmCs  = AssemblyMapper_getAssembledCoordSystem(am);
+  CoordSystem *cmpCs  = AssemblyMapper_getComponentCoordSystem(am);
+  AssemblyMapperAdaptor *adaptor = AssemblyMapper_getAdaptor(am);
+  char *frm = NULL;
 
   // Speed critical section:
   // Try to do simple pointer equality comparisons of the coord system
@@ -318,7 +329,7 @@ MapperRangeSet *AssemblyMapper_fastMapImpl(AssemblyMapper *am, char *frmSeqRegio
 
   }
 
-  return Mapper_fastMap( mapper, seqRegionId, frmStart, frmEnd, frmStrand, frm );
+  return frm;
 }
 
 /*
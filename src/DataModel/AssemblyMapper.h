@@ -118,6 +118,7 @@ MapperRangeSet *AssemblyMapper_fastToAssemblyImpl(AssemblyMapper *am, char *cont
 MapperRangeSet *AssemblyMapper_mapCoordinatesToRawContigImpl(AssemblyMapper *am, char *chrName, long start, long end, int strand);
 Vector *AssemblyMapper_listContigIdsImpl(AssemblyMapper *am, char *chrName, long start, long end, int strand);
 MapperRangeSet *AssemblyMapper_fastMapImpl(AssemblyMapper *am, char *frmSeqRegionName, long frmStart, long frmEnd, int frmStrand, CoordSystem *frmCs, Slice *toSlice);
+int AssemblyMapper_fastMapInto(AssemblyMapper *am, char *frmSeqRegionName, long frmStart, long frmEnd, int frmStrand, CoordSystem *frmCs, MapperResult *result);
 void AssemblyMapper_registerAllImpl(AssemblyMapper *am);
 
 int AssemblyMapper_getSize(AssemblyMapper *am);
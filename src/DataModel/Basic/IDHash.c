@@ -15,10 +15,36 @@
  */
 
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
 #include "IDHash.h"
 #include "Vector.h"
 
-#define IDHash_getBucketNum(idHash,key) ((key)%(idHash)->size);
+// Grow once more than MAXLOAD_NUM/MAXLOAD_DEN of the slots are in use
+#define IDHASH_MAXLOAD_NUM 4
+#define IDHASH_MAXLOAD_DEN 5
+// Longest probe length a slot can record, before the table is grown instead
+#define IDHASH_MAXPROBELEN 255
+
+static int  IDHash_findSlot(IDHash *idHash, IDType id);
+static void IDHash_insert(IDHash *idHash, IDKeyValuePair *kvp);
+static void IDHash_resize(IDHash *idHash, int newSize);
+
+/*
+ IDs are often small and consecutive, so they're mixed (MurmurHash3's
+ finaliser) to spread them over the whole table
+*/
+static inline unsigned int IDHash_hashKey(IDType id) {
+  uint64_t hash = (uint64_t)id;
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+
+  return (unsigned int)hash;
+}
 
 IDHash *IDHash_new(IDHashSizes size) {
   IDHash *idHash;
@@ -28,38 +54,149 @@ IDHash *IDHash_new(IDHashSizes size) {
     return NULL;
   }
 
+  // Only starting sizes now as the table grows as needed
   switch (size) {
     case IDHASH_SMALL:
-      idHash->size = 257; 
+      idHash->size = 16; 
       break;
     case IDHASH_LARGE:
-      idHash->size = 104711; 
+      idHash->size = 4096; 
       break;
     case IDHASH_MEDIUM:
     default:
-      idHash->size = 32353; 
+      idHash->size = 256; 
   }
 
-  if ((idHash->buckets = (IDKeyValuePair **)calloc(idHash->size,sizeof(IDKeyValuePair *))) == NULL) {
-    fprintf(stderr,"ERROR: Failed allocating space for idHash->buckets\n");
+  if ((idHash->slots = (IDKeyValuePair *)calloc(idHash->size,sizeof(IDKeyValuePair))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating space for idHash->slots\n");
     return NULL;
   }
 
-  if ((idHash->bucketCounts = (int *)calloc(idHash->size,sizeof(int))) == NULL) {
-    fprintf(stderr,"ERROR: Failed allocating space for idHash->buckets\n");
+  if ((idHash->probeLens = (unsigned char *)calloc(idHash->size,sizeof(unsigned char))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating space for idHash->probeLens\n");
     return NULL;
   }
 
   return idHash;
 }
 
+/*
+ Makes room for nValue IDs in total, so adding up to that many doesn't have
+ to grow the table step by step
+*/
+void IDHash_reserve(IDHash *idHash, int nValue) {
+  long newSize = idHash->size;
+
+  while (nValue * (long)IDHASH_MAXLOAD_DEN > newSize * IDHASH_MAXLOAD_NUM) {
+    newSize *= 2;
+  }
+  if (newSize != idHash->size) {
+    IDHash_resize(idHash, newSize);
+  }
+}
+
+static void IDHash_resize(IDHash *idHash, int newSize) {
+  IDKeyValuePair *oldSlots     = idHash->slots;
+  unsigned char  *oldProbeLens = idHash->probeLens;
+  int             oldSize      = idHash->size;
+  int i;
+
+  if ((idHash->slots = (IDKeyValuePair *)calloc(newSize,sizeof(IDKeyValuePair))) == NULL ||
+      (idHash->probeLens = (unsigned char *)calloc(newSize,sizeof(unsigned char))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating space for resized idHash\n");
+    exit(1);
+  }
+  idHash->size = newSize;
+
+  for (i=0; i<oldSize; i++) {
+    if (oldProbeLens[i]) {
+      IDHash_insert(idHash, &oldSlots[i]);
+    }
+  }
+
+  free(oldSlots);
+  free(oldProbeLens);
+}
+
+/*
+ Puts kvp (whose key mustn't already be in the hash) into the table, moving
+ along any entries it passes which are nearer their home slot than it is
+*/
+static void IDHash_insert(IDHash *idHash, IDKeyValuePair *kvp) {
+  IDKeyValuePair cur = *kvp;
+  int mask = idHash->size - 1;
+  int slot = IDHash_hashKey(cur.key) & mask;
+  int probeLen = 1;
+
+  while (idHash->probeLens[slot]) {
+    if (idHash->probeLens[slot] < probeLen) {
+      IDKeyValuePair tmp = idHash->slots[slot];
+      int tmpProbeLen = idHash->probeLens[slot];
+
+      idHash->slots[slot]     = cur;
+      idHash->probeLens[slot] = probeLen;
+      cur      = tmp;
+      probeLen = tmpProbeLen;
+    }
+    slot = (slot + 1) & mask;
+    probeLen++;
+
+    if (probeLen == IDHASH_MAXPROBELEN) {
+      // Very unlikely with a decent hash, but the probe length can't be stored
+      IDHash_resize(idHash, idHash->size * 2);
+      IDHash_insert(idHash, &cur);
+      return;
+    }
+  }
+
+  idHash->slots[slot]     = cur;
+  idHash->probeLens[slot] = probeLen;
+}
+
+// Returns the slot holding id, or -1 if it isn't there
+static int IDHash_findSlot(IDHash *idHash, IDType id) {
+  int mask = idHash->size - 1;
+  int slot = IDHash_hashKey(id) & mask;
+  int probeLen = 1;
+
+  // Once an entry is nearer its home than id would be, id can't be further on
+  while (idHash->probeLens[slot] >= probeLen) {
+    if (idHash->slots[slot].key == id) {
+      return slot;
+    }
+    slot = (slot + 1) & mask;
+    probeLen++;
+  }
+
+  return -1;
+}
+
 int IDHash_getNumValues(IDHash *idHash) {
   return idHash->nValue;
 }
 
+/*
+ Steps through the entries without copying anything. Start with *iterP = 0;
+ returns 0 when there are no more.
+*/
+int IDHash_next(IDHash *idHash, int *iterP, IDType *keyP, void **valP) {
+  int i;
+
+  for (i=*iterP; i<idHash->size; i++) {
+    if (idHash->probeLens[i]) {
+      if (keyP) *keyP = idHash->slots[i].key;
+      if (valP) *valP = idHash->slots[i].value;
+      *iterP = i+1;
+      return 1;
+    }
+  }
+  *iterP = idHash->size;
+
+  return 0;
+}
+
 void **IDHash_getValues(IDHash *idHash) {
   int i;
-  int j;
   void **values;
   int valCnt = 0;
   
@@ -73,10 +210,8 @@ void **IDHash_getValues(IDHash *idHash) {
   }
 
   for (i=0; i<idHash->size; i++) {
-    if (idHash->bucketCounts[i]) {
-      for (j=0; j<idHash->bucketCounts[i]; j++) {
-        values[valCnt++] = idHash->buckets[i][j].value;
-      }
+    if (idHash->probeLens[i]) {
+      values[valCnt++] = idHash->slots[i].value;
     }
   }
   if (valCnt != idHash->nValue) {
@@ -87,7 +222,6 @@ void **IDHash_getValues(IDHash *idHash) {
 
 Vector *IDHash_getValuesVector(IDHash *idHash) {
   int i;
-  int j;
   
   if (!idHash->nValue) {
     return NULL;
@@ -96,10 +230,8 @@ Vector *IDHash_getValuesVector(IDHash *idHash) {
   Vector *values = Vector_new();
 
   for (i=0; i<idHash->size; i++) {
-    if (idHash->bucketCounts[i]) {
-      for (j=0; j<idHash->bucketCounts[i]; j++) {
-        Vector_addElement(values, idHash->buckets[i][j].value);
-      }
+    if (idHash->probeLens[i]) {
+      Vector_addElement(values, idHash->slots[i].value);
     }
   }
   if (Vector_getNumElement(values) != idHash->nValue) {
@@ -110,7 +242,6 @@ Vector *IDHash_getValuesVector(IDHash *idHash) {
 
 IDType *IDHash_getKeys(IDHash *idHash) {
   int i;
-  int j;
   IDType *keys;
   int keyCnt = 0;
   
@@ -124,10 +255,8 @@ IDType *IDHash_getKeys(IDHash *idHash) {
   }
 
   for (i=0; i<idHash->size; i++) {
-    if (idHash->bucketCounts[i]) {
-      for (j=0; j<idHash->bucketCounts[i]; j++) {
-        keys[keyCnt++] = idHash->buckets[i][j].key;
-      }
+    if (idHash->probeLens[i]) {
+      keys[keyCnt++] = idHash->slots[i].key;
     }
   }
   if (keyCnt != idHash->nValue) {
@@ -137,114 +266,107 @@ IDType *IDHash_getKeys(IDHash *idHash) {
 }
 
 void *IDHash_getValue(IDHash *idHash, IDType id) {
-  int bucketNum = IDHash_getBucketNum(idHash,id);
-  int i;
-
-  for (i=0; i<idHash->bucketCounts[bucketNum]; i++) {
-    if (id == idHash->buckets[bucketNum][i].key) {
-      return idHash->buckets[bucketNum][i].value;
-    }
-  }
+  int slot = IDHash_findSlot(idHash, id);
 
+  if (slot < 0) {
 //  fprintf(stderr,"ERROR: Didn't find key " IDFMTSTR " in IDHash\n",id);
-  return NULL;
+    return NULL;
+  }
+  return idHash->slots[slot].value;
 }
 
 int IDHash_contains(IDHash *idHash, IDType id) {
-  int bucketNum = IDHash_getBucketNum(idHash,id);
-  int i;
-
-  for (i=0; i<idHash->bucketCounts[bucketNum]; i++) {
-    if (id == idHash->buckets[bucketNum][i].key) {
-      return 1;
-    }
-  }
-
-  return 0;
+  return IDHash_findSlot(idHash, id) >= 0;
 }
 
 int IDHash_remove(IDHash *idHash, IDType id, void freeFunc()) {
-  int bucketNum = IDHash_getBucketNum(idHash,id);
-  int i;
-  int cnt = 0;
-  void *toRemove = NULL;
-
-  for (i=0; i<idHash->bucketCounts[bucketNum]; i++) {
-    if (id == idHash->buckets[bucketNum][i].key) {
-      if (toRemove) {
-        fprintf(stderr,"Error: " IDFMTSTR " found more than once in hash\n",id);
-        exit(1);
-      }
-      toRemove = idHash->buckets[bucketNum][i].value;
-    } else {
-      idHash->buckets[bucketNum][cnt].key   = idHash->buckets[bucketNum][i].key;
-      idHash->buckets[bucketNum][cnt].value = idHash->buckets[bucketNum][i].value;
-      cnt++;
-    }
+  int slot = IDHash_findSlot(idHash, id);
+  int mask = idHash->size - 1;
+
+  if (slot < 0) {
+    return 0;
   }
 
-  if (toRemove) {
-    idHash->bucketCounts[bucketNum]--;
-    if (freeFunc) {
-      freeFunc(toRemove);
-    }
+  if (freeFunc) {
+    freeFunc(idHash->slots[slot].value);
+  }
+
+  // Shift following displaced entries back one, so there's no gap in their probe sequences
+  int next = (slot + 1) & mask;
+  while (idHash->probeLens[next] > 1) {
+    idHash->slots[slot]     = idHash->slots[next];
+    idHash->probeLens[slot] = idHash->probeLens[next] - 1;
+    slot = next;
+    next = (next + 1) & mask;
   }
+  idHash->probeLens[slot] = 0;
+
   idHash->nValue--;
   
   return 0;
 }
 
 int IDHash_add(IDHash *idHash, IDType id, void *val) {
-  int bucketNum = IDHash_getBucketNum(idHash,id);
-  int count = idHash->bucketCounts[bucketNum];
-
-  if (IDHash_contains(idHash,id)) {
-    int i;
+  int slot = IDHash_findSlot(idHash, id);
 
+  if (slot >= 0) {
     fprintf(stderr,"WARNING: Duplicate key " IDFMTSTR " - value will be overwritten\n",id);
-    for (i=0; i<idHash->bucketCounts[bucketNum]; i++) {
-      if (id == idHash->buckets[bucketNum][i].key) {
-        idHash->buckets[bucketNum][i].value = val;
-        return 1;
-      }
-    }
-    
-  } else {
-    if (!count || !(count%10)) {
-      if ((idHash->buckets[bucketNum] = 
-           (IDKeyValuePair *)realloc(idHash->buckets[bucketNum],
-                                   (count+10) * sizeof(IDKeyValuePair))) == NULL) {
-        fprintf(stderr,"ERROR: Failed allocating space for idHash bucket\n");
-        return 0;
-      }
-    }
-    
-    idHash->buckets[bucketNum][count].key   = id;
-    idHash->buckets[bucketNum][count].value = val;
-
-    idHash->nValue++;
-    idHash->bucketCounts[bucketNum]++;
+    idHash->slots[slot].value = val;
+    return 1;
   }
 
+  IDKeyValuePair kvp;
+  kvp.key   = id;
+  kvp.value = val;
+
+  IDHash_reserve(idHash, idHash->nValue+1);
+  IDHash_insert(idHash, &kvp);
+  idHash->nValue++;
+
   return 1; 
 }
 
+/*
+  Makes a new hash with the same keys and values as idHash. The values are
+  shared not copied, so the new hash can be added to (or removed from)
+  without affecting idHash, but the objects it points at are the same.
+*/
+IDHash *IDHash_copy(IDHash *idHash) {
+  IDHash *copy;
+
+  if ((copy = (IDHash *)calloc(1,sizeof(IDHash))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating space for idHash copy\n");
+    return NULL;
+  }
+
+  copy->size   = idHash->size;
+  copy->nValue = idHash->nValue;
+
+  if ((copy->slots = (IDKeyValuePair *)malloc(copy->size * sizeof(IDKeyValuePair))) == NULL ||
+      (copy->probeLens = (unsigned char *)malloc(copy->size * sizeof(unsigned char))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating space for idHash copy slots\n");
+    return NULL;
+  }
+
+  // Same size so every entry goes in the same slot
+  memcpy(copy->slots, idHash->slots, copy->size * sizeof(IDKeyValuePair));
+  memcpy(copy->probeLens, idHash->probeLens, copy->size * sizeof(unsigned char));
+
+  return copy;
+}
+
 void IDHash_free(IDHash *idHash, void freeFunc()) {
   int i;
-  int j;
   
-  for (i=0; i<idHash->size; i++) {
-    if (idHash->bucketCounts[i]) {
-      if (freeFunc) {
-        for (j=0; j<idHash->bucketCounts[i]; j++) {
-          freeFunc(idHash->buckets[i][j].value);
-        }
+  if (freeFunc) {
+    for (i=0; i<idHash->size; i++) {
+      if (idHash->probeLens[i]) {
+        freeFunc(idHash->slots[i].value);
       }
-      free(idHash->buckets[i]);
     }
   }
   
-  free(idHash->buckets);
-  free(idHash->bucketCounts);
+  free(idHash->slots);
+  free(idHash->probeLens);
   free(idHash);
 }
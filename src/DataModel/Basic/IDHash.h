@@ -20,6 +20,14 @@
 #include "EnsC.h"
 #include "Vector.h"
 
+/*
+ Open addressing (Robin Hood) hash from IDs to pointers, laid out as
+ StringHash is: a power of 2 sized table of slots with a probe length byte
+ each, which doubles once it's more than 80% full. The size passed to
+ IDHash_new is only a starting point, and IDHash_reserve makes room for a
+ known number of IDs in one go.
+*/
+
 typedef enum IDHashSizesEnum {
   IDHASH_SMALL,
   IDHASH_MEDIUM,
@@ -32,21 +40,24 @@ typedef struct IDKeyValuePairStruct {
 } IDKeyValuePair;
 
 typedef struct IDHashStruct {
-  IDKeyValuePair **buckets;
-  int  *bucketCounts;
+  IDKeyValuePair *slots;
+  unsigned char  *probeLens;
   int   size;
   int   nValue;
 } IDHash;
 
 
 IDHash * IDHash_new(IDHashSizes size);
+void     IDHash_reserve(IDHash *idHash, int nValue);
 int      IDHash_add(IDHash *idHash, IDType id, void *val);
 int      IDHash_contains(IDHash *idHash, IDType id);
+IDHash * IDHash_copy(IDHash *idHash);
 void     IDHash_free(IDHash *idHash, void freeFunc());
 int      IDHash_getNumValues(IDHash *idHash);
 IDType * IDHash_getKeys(IDHash *idHash);
 void *   IDHash_getValue(IDHash *idHash, IDType id);
 void **  IDHash_getValues(IDHash *idHash);
+int      IDHash_next(IDHash *idHash, int *iterP, IDType *keyP, void **valP);
 int      IDHash_remove(IDHash *idHash, IDType id, void freeFunc());
 Vector *IDHash_getValuesVector(IDHash *idHash);
 
@@ -38,16 +38,53 @@ Vector *Vector_new() {
 
   vector->batchSize = VECTOR_DEFAULTBATCHSIZE;
 
+  vector->elements = vector->inlineElements;
+  vector->nAlloced = VECTOR_NINLINE;
+
+  return vector;
+}
+
+/*
+ Vector to hang off owner (a Gene's transcripts, an Exon's supporting
+ features ...): from the current arena if owner was allocated from it, so it
+ goes with the rest of owner's graph, otherwise just Vector_new().
+*/
+Vector *Vector_newFor(void *owner) {
+  Arena *arena = Arena_getCurrent();
+  Vector *vector;
+
+  if (arena == NULL || !Object_isInArena((Object *)owner)) {
+    return Vector_new();
+  }
+#ifdef DBG
+  if (!Arena_contains(arena, owner)) {
+    fprintf(stderr,"ERROR: Arena object %p isn't from the current arena\n", owner);
+    exit(1);
+  }
+#endif
+
+  vector = (Vector *)Arena_calloc(arena, sizeof(Vector));
+
+  vector->objectType = CLASS_VECTOR;
+
+  Object_incRefCount(vector);
+  Object_setInArena(vector);
+
+  vector->funcs = &vectorFuncs;
+
+  vector->batchSize = VECTOR_DEFAULTBATCHSIZE;
+
+  vector->elements = vector->inlineElements;
+  vector->nAlloced = VECTOR_NINLINE;
+  vector->arena    = arena;
+
   return vector;
 }
 
 Vector *Vector_newFromArray(void **array, int nInArray) {
   Vector *vector = Vector_new();
 
-  int i;
-  for (i=0;i<nInArray;i++) {
-    Vector_addElement(vector, array[i]);
-  }
+  Vector_appendArray(vector, array, nInArray);
 
   return vector;
 }
@@ -96,7 +133,6 @@ void *Vector_setElementAt(Vector *v, int ind, void *elem) {
 
 void *Vector_removeElementAt(Vector *v, int ind) {
   void *removed;
-  int i;
 
   if (ind < 0) {
     fprintf(stderr,"ERROR: Invalid element index %d in Vector_removeElementAt\n",ind);
@@ -110,18 +146,16 @@ void *Vector_removeElementAt(Vector *v, int ind) {
   
   removed = v->elements[ind];
   
-  for (i=ind+1; i<v->nElement; i++) {
-    v->elements[i-1] = v->elements[i];
-  }
+  memmove(&(v->elements[ind]), &(v->elements[ind+1]), (v->nElement-ind-1) * sizeof(void *));
 
   //Vector_setNumElement(v, v->nElement-1);
   v->nElement--;
+  v->elements[v->nElement] = NULL;
 
   return removed;
 }
 
 void *Vector_insertElementAt(Vector *v, int ind, void *elem) {
-  int i;
 
   if (ind < 0) {
     fprintf(stderr,"ERROR: Invalid element index %d in Vector_insertElementAt\n",ind);
@@ -133,9 +167,7 @@ void *Vector_insertElementAt(Vector *v, int ind, void *elem) {
   
   Vector_setNumElement(v, v->nElement+1);
 
-  for (i=v->nElement-2; i>=ind; i--) {
-    v->elements[i+1] = v->elements[i];
-  }
+  memmove(&(v->elements[ind+1]), &(v->elements[ind]), (v->nElement-ind-1) * sizeof(void *));
 
   return Vector_setElementAt(v, ind, elem);
 }
@@ -153,11 +185,22 @@ void Vector_reverse(Vector *v) {
 }
 
 void Vector_append(Vector *dest, Vector *src) {
-  int i;
+  Vector_appendArray(dest, src->elements, src->nElement);
+
+  return;
+}
 
-  for (i=0; i<Vector_getNumElement(src); i++) {
-    Vector_addElement(dest, Vector_getElementAt(src,i));
+/*
+ Adds the nInArray pointers in array to the end of v, growing it at most once
+*/
+void Vector_appendArray(Vector *v, void **array, int nInArray) {
+  if (nInArray <= 0) {
+    return;
   }
+  Vector_reserve(v, v->nElement + nInArray);
+
+  memcpy(&(v->elements[v->nElement]), array, nInArray * sizeof(void *));
+  v->nElement += nInArray;
 
   return;
 }
@@ -174,27 +217,60 @@ void *Vector_addElement(Vector *v, void *elem) {
 
 // Why??  if (!v->nElement) v->elements = NULL;
 
-  Vector_setNumElement(v,v->nElement+1);
+  if (v->nElement == v->nAlloced) {
+    Vector_reserve(v, v->nElement+1);
+  }
 
-  v->elements[v->nElement-1] = elem;
+  v->elements[v->nElement++] = elem;
 
   return elem;
 }
 
-void Vector_setNumElement(Vector *v, int nElem) {
-  int batchSize = v->batchSize;
+/*
+ Makes sure there's room for nElem elements without growing again. Growing
+ at least doubles the allocation, and any new space is zeroed.
+*/
+void Vector_reserve(Vector *v, int nElem) {
+  int newNAlloced;
+
+  if (nElem <= v->nAlloced) {
+    return;
+  }
+
+  newNAlloced = v->nAlloced * 2;
+  if (newNAlloced < v->batchSize) {
+    newNAlloced = v->batchSize;
+  }
+  if (newNAlloced < nElem) {
+    newNAlloced = nElem;
+  }
 
-  if (v->nAlloced <= nElem) {
-    v->nAlloced = nElem-(nElem % batchSize)+batchSize;
-    //fprintf(stderr, "v->nAlloced = %d nElem = %d\n", v->nAlloced, nElem);
-    if ((v->elements = (void **)realloc(v->elements,v->nAlloced*sizeof(void *))) == NULL) {
+  if (v->arena != NULL) {
+    // Old array is left in the arena
+    void **elements = (void **)Arena_calloc(v->arena, newNAlloced*sizeof(void *));
+    memcpy(elements, v->elements, v->nAlloced*sizeof(void *));
+    v->elements = elements;
+  } else if (v->elements == v->inlineElements) {
+    void **elements;
+    if ((elements = (void **)malloc(newNAlloced*sizeof(void *))) == NULL) {
       fprintf(stderr,"ERROR: Failed allocating space for elem array\n");
-      return;
+      exit(1);
     }
-      
-    memset(&(v->elements[v->nElement]), 0, sizeof(void *) * (v->nAlloced - v->nElement));
+    memcpy(elements, v->inlineElements, v->nAlloced*sizeof(void *));
+    v->elements = elements;
+  } else if ((v->elements = (void **)realloc(v->elements,newNAlloced*sizeof(void *))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating space for elem array\n");
+    exit(1);
   }
 
+  memset(&(v->elements[v->nAlloced]), 0, sizeof(void *) * (newNAlloced - v->nAlloced));
+  v->nAlloced = newNAlloced;
+}
+
+void Vector_setNumElement(Vector *v, int nElem) {
+
+  Vector_reserve(v, nElem);
+
 /*
   if ((v->elements = (void **)realloc(v->elements,nElem*sizeof(void *))) == NULL) {
     fprintf(stderr,"ERROR: Failed allocating space for elem array\n");
@@ -213,10 +289,7 @@ void Vector_setNumElement(Vector *v, int nElem) {
 Vector *Vector_copy(Vector *v) {
   Vector *newV = Vector_new();
 
-
-  Vector_setNumElement(newV, v->nElement);
-
-  memcpy(newV->elements,v->elements,v->nElement*sizeof(void *));
+  Vector_appendArray(newV, v->elements, v->nElement);
 
   return newV;
 }
@@ -274,7 +347,9 @@ void Vector_free(Vector *v) {
       }
     }
   }
-  free(v->elements);
+  if (v->elements != v->inlineElements) {
+    free(v->elements);
+  }
   free(v);
   //printf(" - done freeing vector\n");
 }
@@ -20,6 +20,7 @@
 #include "EnsC.h"
 #include "Class.h"
 #include "Object.h"
+#include "Arena.h"
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -33,6 +34,19 @@ typedef struct VectorFuncsStruct {
   OBJECTFUNCS_DATA(Vector)
 } VectorFuncs;
 
+// Elements held in the Vector itself before any are allocated - most vectors
+// (supporting features, exons of a transcript ...) are this small
+#define VECTOR_NINLINE 4
+
+/*
+ elements starts off pointing at inlineElements, and is moved to the heap
+ when that fills up, doubling in size each time it has to grow so adding N
+ elements costs O(N) copying overall. batchSize is only the smallest heap
+ allocation now.
+
+ Vectors made by Vector_newFor for an object in an arena come from the arena
+ too (arena is set), and so do their element arrays when they grow.
+*/
 #define FUNCSTRUCTTYPE VectorFuncs
 struct VectorStruct {
   OBJECT_DATA
@@ -42,12 +56,15 @@ struct VectorStruct {
   int batchSize;
   int isSpecial;
   Vector_ElementFreeFunc freeElement;  
+  void *inlineElements[VECTOR_NINLINE];
+  Arena *arena;
 };
 #undef FUNCSTRUCTTYPE
 
 #define VECTOR_DEFAULTBATCHSIZE 10
 
 Vector *Vector_new();
+Vector *Vector_newFor(void *owner);
 void *Vector_addElement(Vector *vector, void *elem);
 #define Vector_getNumElement(v) (v)->nElement
 //void *Vector_getElementAt(Vector *v, int ind);
@@ -58,7 +75,9 @@ void Vector_setFreeFunc(Vector *vector, void freeFunc());
 void Vector_setBatchSize(Vector *vector, int batchSize);
 Vector *Vector_newFromArray(void **array, int nInArray);
 
+void Vector_reserve(Vector *v, int nElem);
 void Vector_append(Vector *dest, Vector *src);
+void Vector_appendArray(Vector *v, void **array, int nInArray);
 void Vector_reverse(Vector *v);
 void *Vector_setElementAt(Vector *v, int ind, void *elem);
 void Vector_sort(Vector *v, SortCompFunc sortFunc);
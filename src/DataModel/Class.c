@@ -30,8 +30,10 @@ char * hierarchyString =
   " VECTOR\n"
   " STATEMENTHANDLE\n"
   "  MYSQLSTATEMENTHANDLE\n"
+  "  MYSQLPREPAREDSTATEMENTHANDLE\n"
   " RESULTROW\n"
   "  MYSQLRESULTROW\n"
+  "  MYSQLBINARYRESULTROW\n"
   " ENSROOT\n"
   "  DBENTRY\n"
   "  ANALYSIS\n"
@@ -122,7 +124,9 @@ Class classArray[CLASS_NUMCLASS] =
   {CLASS_COORDSYSTEM, "COORDSYSTEM"},
   {CLASS_ATTRIBUTE, "ATTRIBUTE"},
   {CLASS_SEQEDIT, "SEQEDIT"},
-  {CLASS_PREDICTIONEXON, "PREDICTIONEXON"}
+  {CLASS_PREDICTIONEXON, "PREDICTIONEXON"},
+  {CLASS_MYSQLPREPAREDSTATEMENTHANDLE, "MYSQLPREPAREDSTATEMENTHANDLE"},
+  {CLASS_MYSQLBINARYRESULTROW, "MYSQLBINARYRESULTROW"}
   };
 
 ClassHierarchyNode *root = NULL;
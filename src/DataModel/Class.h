@@ -68,6 +68,8 @@ typedef enum ClassTypeEnum {
   CLASS_ATTRIBUTE,
   CLASS_SEQEDIT,
   CLASS_PREDICTIONEXON,
+  CLASS_MYSQLPREPAREDSTATEMENTHANDLE,
+  CLASS_MYSQLBINARYRESULTROW,
   CLASS_NUMCLASS
 } ClassType;
 
@@ -16,6 +16,7 @@
 
 #define __DNAALIGNFEATURE_MAIN__
 #include "DNAAlignFeature.h"
+#include "Arena.h"
 #undef __DNAALIGNFEATURE_MAIN__
 //#include "ProcUtil.h"
 
@@ -23,8 +24,9 @@
 
 DNAAlignFeature *DNAAlignFeature_new() {
   DNAAlignFeature *daf;
+  Arena *arena = Arena_getCurrent();
 
-  if ((daf = (DNAAlignFeature *)calloc(1,sizeof(DNAAlignFeature))) == NULL) {
+  if ((daf = (DNAAlignFeature *)(arena ? Arena_calloc(arena, sizeof(DNAAlignFeature)) : calloc(1,sizeof(DNAAlignFeature)))) == NULL) {
     fprintf(stderr,"ERROR: Failed allocating space for dna align feature\n");
     return NULL;
   }
@@ -33,6 +35,7 @@ DNAAlignFeature *DNAAlignFeature_new() {
 //  Object_incRefCount(daf);
 
   daf->funcs = &dnaAlignFeatureFuncs;
+  if (arena) Object_setInArena(daf);
 
 // Not very happy with this way of signifying values not set, but for now can't think of a better way which is efficient
   DNAAlignFeature_setpValue(daf, FLOAT_UNDEF);
@@ -83,14 +86,17 @@ void DNAAlignFeature_freeImpl(DNAAlignFeature *daf) {
 
 DNAAlignFeature *DNAAlignFeature_shallowCopyImpl(DNAAlignFeature *daf) {
   DNAAlignFeature *newDNAAlignFeature = DNAAlignFeature_new();
+  int inArena = Object_isInArena(newDNAAlignFeature);
 
   memcpy(newDNAAlignFeature,daf,sizeof(DNAAlignFeature));
+  Object_setArenaState(newDNAAlignFeature, inArena);
 
   return newDNAAlignFeature;
 }
 
 DNAAlignFeature *DNAAlignFeature_deepCopyImpl(DNAAlignFeature *daf) {
   DNAAlignFeature *newDNAAlignFeature = DNAAlignFeature_new();
+  int inArena = Object_isInArena(newDNAAlignFeature);
 
   memcpy(newDNAAlignFeature,daf,sizeof(DNAAlignFeature));
 
@@ -98,6 +104,7 @@ DNAAlignFeature *DNAAlignFeature_deepCopyImpl(DNAAlignFeature *daf) {
   
 
   newDNAAlignFeature->referenceCount = 0;
+  if (inArena) Object_setInArena(newDNAAlignFeature);
 
   return newDNAAlignFeature;
 }
@@ -33,6 +33,7 @@ typedef struct DNAAlignFeatureStruct DNAAlignFeature;
 typedef struct DNAPepAlignFeatureStruct DNAPepAlignFeature;
 typedef struct EnsRootStruct EnsRoot;
 typedef struct ExonStruct Exon;
+typedef struct FeatureBatchStruct FeatureBatch;
 typedef struct FeaturePairStruct FeaturePair;
 typedef struct FeatureSetStruct FeatureSet;
 typedef struct GeneStruct Gene;
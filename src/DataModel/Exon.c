@@ -34,11 +34,13 @@
 #include "Object.h"
 #include "translate.h"
 #include "StableIdInfo.h"
+#include "Arena.h"
 
 Exon *Exon_new() {
   Exon *exon;
+  Arena *arena = Arena_getCurrent();
 
-  if ((exon = (Exon *)calloc(1,sizeof(Exon))) == NULL) {
+  if ((exon = (Exon *)(arena ? Arena_calloc(arena, sizeof(Exon)) : calloc(1,sizeof(Exon)))) == NULL) {
     fprintf(stderr,"ERROR: Failed allocating space for exon\n");
     return NULL;
   }
@@ -47,6 +49,7 @@ Exon *Exon_new() {
 //  Object_incRefCount(exon);
 
   exon->funcs = &exonFuncs;
+  if (arena) Object_setInArena(exon);
 
 /* Set to empty values */
   Exon_setModified(exon,0);
@@ -146,18 +149,20 @@ void Exon_flushSupportingFeatures(Exon *exon) {
     Vector_free(exon->supportingFeatures);
   }
 
-  exon->supportingFeatures = Vector_new();
+  exon->supportingFeatures = Vector_newFor(exon);
 }
 
 
 Exon *Exon_shallowCopyImpl(Exon *exon) {
   Exon *newExon = Exon_new();
+  int inArena = Object_isInArena(newExon);
 
   memcpy(newExon,exon,sizeof(Exon));
+  Object_setArenaState(newExon, inArena);
 
 // Make a copy of this string
   
-  if (exon->si.stableId) StrUtil_copyString(&(newExon->si.stableId), exon->si.stableId, 0);
+  if (exon->si.stableId) newExon->si.stableId = Arena_copyStringFor(newExon, inArena, exon->si.stableId);
 
   return newExon;
 }
@@ -596,7 +601,7 @@ Vector *Exon_getAllSupportingFeaturesImpl(Exon *exon) {
 
 void Exon_addSupportingFeaturesImpl(Exon *exon, Vector *v) {
   if (!exon->supportingFeatures || exon->supportingFeatures == emptyVector) {
-    exon->supportingFeatures = Vector_new();
+    exon->supportingFeatures = Vector_newFor(exon);
   }
   int i;
   for (i=0; i<Vector_getNumElement(v); i++) {
@@ -608,7 +613,7 @@ void Exon_addSupportingFeaturesImpl(Exon *exon, Vector *v) {
 
 void Exon_addSupportingFeature(Exon *exon, SeqFeature *sf) {
   if (!exon->supportingFeatures || exon->supportingFeatures == emptyVector) {
-    exon->supportingFeatures = Vector_new();
+    exon->supportingFeatures = Vector_newFor(exon);
   }
   //fprintf(stderr,"Adding support "IDFMTSTR" to exon "IDFMTSTR" %p\n",SeqFeature_getDbID(sf),Exon_getDbID(exon),exon);
   Object_incRefCount(sf);
@@ -772,30 +777,7 @@ char  *Exon_getSeqStringImpl(Exon *exon) {
 
     //fprintf(stderr,"fetched exon seq str %s\n", seq);
     if (Exon_getStrand(exon) == -1){
-//      SeqUtil_reverseComplement(seq,strlen(seq));
-      
-      if (Exon_getLength(exon) > 1000000) {
-        char *tmpSeq;
-        if ((tmpSeq = (char *)calloc(Exon_getLength(exon) + 3, sizeof(char))) == NULL) {
-          fprintf(stderr, "Failed allocating temporary buffer for exon rev comp seq string\n");
-          exit(1);
-        }
-        rev_comp(seq, tmpSeq, Exon_getLength(exon));
-        strcpy(seq,tmpSeq);
-        free(tmpSeq);
-      } else {
-        char *tmpSeq = NULL;
-
-        if ((tmpSeq = (char *)calloc(1000002,sizeof(char))) == NULL) {
-          fprintf(stderr,"Failed allocating tmpSeq\n");
-          return NULL;
-        }
-
-        rev_comp(seq, tmpSeq, Exon_getLength(exon));
-        strcpy(seq,tmpSeq);
-
-        free(tmpSeq);
-      }
+      SeqUtil_reverseComplement(seq, Exon_getLength(exon));
     }
   }
   Exon_setSeqCacheString(exon, seq);
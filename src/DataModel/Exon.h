@@ -102,7 +102,7 @@ struct ExonStruct {
 #define Exon_setStrand(exon,strand) AnnotatedSeqFeature_setStrand((exon),(strand))
 #define Exon_getStrand(exon) AnnotatedSeqFeature_getStrand((exon))
 
-#define Exon_setStableId(exon,stableId)  StableIdInfo_setStableId(&((exon)->si),(stableId))
+#define Exon_setStableId(exon,stableId)  StableIdInfo_setStableId(&((exon)->si),(stableId),Object_isInArena(exon))
 char *Exon_getStableId(Exon *exon);
 
 #define Exon_setVersion(exon,ver)  StableIdInfo_setVersion(&((exon)->si),(ver))
@@ -0,0 +1,133 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FeatureBatch.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FEATUREBATCH_INITIALSIZE 256
+
+static void *FeatureBatch_growColumn(void *column, int nAlloced, size_t elemSize);
+
+
+FeatureBatch *FeatureBatch_new(Slice *slice) {
+  FeatureBatch *batch;
+
+  if ((batch = (FeatureBatch *)calloc(1,sizeof(FeatureBatch))) == NULL) {
+    fprintf(stderr, "ERROR: Failed allocating FeatureBatch\n");
+    exit(1);
+  }
+
+  batch->slice = slice;
+
+  return batch;
+}
+
+static void *FeatureBatch_growColumn(void *column, int nAlloced, size_t elemSize) {
+  if ((column = realloc(column, nAlloced * elemSize)) == NULL) {
+    fprintf(stderr, "ERROR: Failed allocating FeatureBatch column\n");
+    exit(1);
+  }
+  return column;
+}
+
+/*
+ Makes room for nFeature features in every column, doubling at least
+*/
+void FeatureBatch_reserve(FeatureBatch *batch, int nFeature) {
+  int nAlloced;
+
+  if (nFeature <= batch->nAlloced) {
+    return;
+  }
+
+  nAlloced = batch->nAlloced ? batch->nAlloced * 2 : FEATUREBATCH_INITIALSIZE;
+  if (nAlloced < nFeature) {
+    nAlloced = nFeature;
+  }
+
+  batch->dbIds          = FeatureBatch_growColumn(batch->dbIds, nAlloced, sizeof(IDType));
+  batch->seqRegionIds   = FeatureBatch_growColumn(batch->seqRegionIds, nAlloced, sizeof(IDType));
+  batch->starts         = FeatureBatch_growColumn(batch->starts, nAlloced, sizeof(long));
+  batch->ends           = FeatureBatch_growColumn(batch->ends, nAlloced, sizeof(long));
+  batch->strands        = FeatureBatch_growColumn(batch->strands, nAlloced, sizeof(signed char));
+  batch->scores         = FeatureBatch_growColumn(batch->scores, nAlloced, sizeof(double));
+  batch->analysisIds    = FeatureBatch_growColumn(batch->analysisIds, nAlloced, sizeof(IDType));
+  batch->hitNameOffsets = FeatureBatch_growColumn(batch->hitNameOffsets, nAlloced, sizeof(long));
+
+  batch->nAlloced = nAlloced;
+}
+
+/*
+ Appends a feature, returning its index. hitName can be NULL, and needn't be
+ NUL terminated (hitNameLen bytes are copied).
+*/
+int FeatureBatch_add(FeatureBatch *batch, IDType dbId, IDType seqRegionId, long start, long end, int strand,
+                     double score, IDType analysisId, char *hitName, long hitNameLen) {
+  int ind = batch->nFeature;
+
+  if (ind == batch->nAlloced) {
+    FeatureBatch_reserve(batch, ind+1);
+  }
+
+  batch->dbIds[ind]        = dbId;
+  batch->seqRegionIds[ind] = seqRegionId;
+  batch->starts[ind]       = start;
+  batch->ends[ind]         = end;
+  batch->strands[ind]      = strand;
+  batch->scores[ind]       = score;
+  batch->analysisIds[ind]  = analysisId;
+
+  if (hitName != NULL) {
+    if (batch->hitNamesLen + hitNameLen + 1 > batch->hitNamesAlloced) {
+      long newAlloced = batch->hitNamesAlloced ? batch->hitNamesAlloced * 2 : FEATUREBATCH_INITIALSIZE * 16;
+      while (newAlloced < batch->hitNamesLen + hitNameLen + 1) {
+        newAlloced *= 2;
+      }
+      if ((batch->hitNames = (char *)realloc(batch->hitNames, newAlloced)) == NULL) {
+        fprintf(stderr, "ERROR: Failed allocating FeatureBatch hit names\n");
+        exit(1);
+      }
+      batch->hitNamesAlloced = newAlloced;
+    }
+    memcpy(&batch->hitNames[batch->hitNamesLen], hitName, hitNameLen);
+    batch->hitNames[batch->hitNamesLen + hitNameLen] = '\0';
+
+    batch->hitNameOffsets[ind] = batch->hitNamesLen;
+    batch->hitNamesLen += hitNameLen + 1;
+  } else {
+    batch->hitNameOffsets[ind] = -1;
+  }
+
+  batch->nFeature++;
+
+  return ind;
+}
+
+void FeatureBatch_free(FeatureBatch *batch) {
+  free(batch->dbIds);
+  free(batch->seqRegionIds);
+  free(batch->starts);
+  free(batch->ends);
+  free(batch->strands);
+  free(batch->scores);
+  free(batch->analysisIds);
+  free(batch->hitNameOffsets);
+  free(batch->hitNames);
+  free(batch);
+}
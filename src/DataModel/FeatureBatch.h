@@ -0,0 +1,76 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FEATUREBATCH_H__
+#define __FEATUREBATCH_H__
+
+#include "DataModelTypes.h"
+#include "EnsC.h"
+
+/*
+ Features held column-wise: one contiguous array per field rather than a
+ Vector of SeqFeature pointers, for jobs (coverage, overlap) which scan
+ hundreds of thousands of features but only look at their coordinates.
+
+ Coordinates are relative to slice, as they would be on fetched features.
+ Hit names (for align features) are packed one after another, NUL
+ terminated, into hitNames, with each feature's offset into it in
+ hitNameOffsets (-1 for none).
+
+ BaseFeatureAdaptor_fetchBatchBySlice fills these, and
+ BaseFeatureAdaptor_fetchFeatureFromBatch makes the full object for a feature
+ when one's needed.
+*/
+
+struct FeatureBatchStruct {
+  int     nFeature;
+  int     nAlloced;
+
+  IDType *dbIds;
+  IDType *seqRegionIds;
+  long   *starts;
+  long   *ends;
+  signed char *strands;
+  double *scores;
+  IDType *analysisIds;
+  long   *hitNameOffsets;
+
+  char   *hitNames;
+  long    hitNamesLen;
+  long    hitNamesAlloced;
+
+  Slice  *slice;
+};
+
+FeatureBatch *FeatureBatch_new(Slice *slice);
+void FeatureBatch_reserve(FeatureBatch *batch, int nFeature);
+int  FeatureBatch_add(FeatureBatch *batch, IDType dbId, IDType seqRegionId, long start, long end, int strand,
+                      double score, IDType analysisId, char *hitName, long hitNameLen);
+void FeatureBatch_free(FeatureBatch *batch);
+
+#define FeatureBatch_getNumFeature(b) (b)->nFeature
+#define FeatureBatch_getSlice(b) (b)->slice
+
+#define FeatureBatch_getDbIDAt(b, ind) (b)->dbIds[(ind)]
+#define FeatureBatch_getSeqRegionIdAt(b, ind) (b)->seqRegionIds[(ind)]
+#define FeatureBatch_getStartAt(b, ind) (b)->starts[(ind)]
+#define FeatureBatch_getEndAt(b, ind) (b)->ends[(ind)]
+#define FeatureBatch_getStrandAt(b, ind) (b)->strands[(ind)]
+#define FeatureBatch_getScoreAt(b, ind) (b)->scores[(ind)]
+#define FeatureBatch_getAnalysisIdAt(b, ind) (b)->analysisIds[(ind)]
+#define FeatureBatch_getHitNameAt(b, ind) ((b)->hitNameOffsets[(ind)] < 0 ? NULL : &(b)->hitNames[(b)->hitNameOffsets[(ind)]])
+
+#endif
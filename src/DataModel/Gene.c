@@ -24,11 +24,13 @@
 #include "IDHash.h"
 
 #include "DBEntryAdaptor.h"
+#include "Arena.h"
 
 Gene *Gene_new() {
   Gene *gene;
+  Arena *arena = Arena_getCurrent();
 
-  if ((gene = (Gene *)calloc(1,sizeof(Gene))) == NULL) {
+  if ((gene = (Gene *)(arena ? Arena_calloc(arena, sizeof(Gene)) : calloc(1,sizeof(Gene)))) == NULL) {
     fprintf(stderr,"ERROR: Failed allocating space for gene\n");
     return NULL;
   }
@@ -38,10 +40,11 @@ Gene *Gene_new() {
   Gene_setVersion(gene,-1);
   Gene_setIsCurrent(gene,1);
 
-  gene->transcripts = Vector_new();
-
   gene->objectType = CLASS_GENE;
   Object_incRefCount(gene);
+  if (arena) Object_setInArena(gene);
+
+  gene->transcripts = Vector_newFor(gene);
 
   gene->funcs = &geneFuncs;
 
@@ -53,8 +56,10 @@ Gene *Gene_new() {
 
 Gene *Gene_shallowCopy(Gene *gene) {
   Gene *newGene = Gene_new();
+  int inArena = Object_isInArena(newGene);
 
   memcpy(newGene,gene,sizeof(Gene));
+  Object_setArenaState(newGene, inArena);
 
   return newGene;
 }
@@ -269,7 +274,7 @@ Vector *Gene_getAllDBEntries(Gene *g) {
 
 int Gene_addDBLink(Gene *g, DBEntry *dbe) {
   if (!g->dbLinks) {
-    g->dbLinks = Vector_new();
+    g->dbLinks = Vector_newFor(g);
   }
 
   Vector_addElement(g->dbLinks, dbe); 
@@ -288,13 +293,11 @@ char *Gene_getStableId(Gene *gene) {
 }
 
 char *Gene_setDescription(Gene *g, char *description) {
-  if ((g->description = (char *)malloc(strlen(description)+1)) == NULL) {
+  if ((g->description = Arena_copyStringFor(g, Object_isInArena(g), description)) == NULL) {
     fprintf(stderr,"ERROR: Failed allocating space for description\n");
     return NULL;
   }
 
-  strcpy(g->description,description);
-
   return g->description;
 }
 
@@ -370,13 +373,11 @@ char *Gene_setExternalName(Gene *g, char *externalName) {
     g->externalName = NULL;
     return NULL;
   }
-  if ((g->externalName = (char *)malloc(strlen(externalName)+1)) == NULL) {
+  if ((g->externalName = Arena_copyStringFor(g, Object_isInArena(g), externalName)) == NULL) {
     fprintf(stderr,"ERROR: Failed allocating space for externalName\n");
     return NULL;
   }
 
-  strcpy(g->externalName,externalName);
-
   return g->externalName;
 }
 
@@ -554,7 +555,7 @@ void Gene_free(Gene *gene) {
 void Gene_addTranscript(Gene *gene, Transcript *trans) {
 
   if (gene->transcripts == NULL) {
-    gene->transcripts = Vector_new();
+    gene->transcripts = Vector_newFor(gene);
   }
 
   Vector_addElement(gene->transcripts, trans);
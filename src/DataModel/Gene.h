@@ -82,7 +82,7 @@ Gene *Gene_new(void);
 #define Gene_getSeqRegionEnd(g) SeqFeature_getSeqRegionEnd((g))
 #define Gene_getSeqRegionStrand(g) SeqFeature_getSeqRegionStrand((g))
 
-#define Gene_setStableId(gene,stableId)  StableIdInfo_setStableId(&((gene)->si),stableId)
+#define Gene_setStableId(gene,stableId)  StableIdInfo_setStableId(&((gene)->si),stableId,Object_isInArena(gene))
 char *Gene_getStableId(Gene *gene);
 
 ECOSTRING Gene_setBiotype(Gene *gene, char *biotype);
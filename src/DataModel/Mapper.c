@@ -20,6 +20,17 @@
 #include "StrUtil.h"
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+
+static int  Mapper_getFromInd(Mapper *m, char *type, int strict, CoordSystem **csP);
+static void Mapper_buildFlatPairs(Mapper *m, int from);
+static void Mapper_freeFlatPairs(Mapper *m);
+static void MapperFlatPairSet_free(MapperFlatPairSet *fps);
+static int  Mapper_fastMapFlat(MapperFlatPairSet *fps, long start, long end, int strand, CoordSystem *cs,
+                               MapperResult *result);
+static void Mapper_setGapResult(MapperResult *result, long start, long end, int rank);
+static void Mapper_rangeToResult(MapperRange *range, MapperResult *result);
+static MapperRangeSet *Mapper_resultsToRangeSet(MapperResult *results, int nResult);
 
 /*
 =head2 new
@@ -98,7 +109,10 @@ void Mapper_flush(Mapper *m)  {
   Mapper_setPairHash(m, MAPPER_FROM_IND, IDHash_new(IDHASH_MEDIUM));
   Mapper_setPairHash(m, MAPPER_TO_IND,   IDHash_new(IDHASH_MEDIUM));
 
+  Mapper_freeFlatPairs(m);
+
   Mapper_setPairCount(m, 0);
+  Mapper_setIsSorted(m, 0);
 }
 
 /*
@@ -125,79 +139,99 @@ void Mapper_flush(Mapper *m)  {
 */
 
 MapperRangeSet *Mapper_mapCoordinates(Mapper *m, IDType id, long start, long end, int strand, char *type) {
-
+  MapperResult resultBuf[MAPPER_RESULTBUFSIZE];
+  MapperResult *results = resultBuf;
+  MapperRangeSet *mrs;
+  int nResult;
 
   // special case for handling inserts:
   if ( start == end+1 ) {
     return Mapper_mapInsert(m, id, start, end, strand, type, 0 /*fastmap flag */);
-  } else if (start > end+1) {
-    fprintf(stderr,"ERROR: Start is greater than end for id " IDFMTSTR ", start %ld, end %ld\n",id,start,end);
-    exit(1);
   }
 
+  nResult = Mapper_mapCoordinatesInto(m, id, start, end, strand, type, results, MAPPER_RESULTBUFSIZE);
 
-  IDHash *hash;
-  CoordSystem *cs;
-  if( Mapper_getIsSorted(m) == 0 ) {
-    Mapper_sort(m);
+  if (nResult > MAPPER_RESULTBUFSIZE) {
+    if ((results = (MapperResult *)malloc(nResult * sizeof(MapperResult))) == NULL) {
+      fprintf(stderr,"ERROR: Failed allocating space for mapper results\n");
+      exit(1);
+    }
+    Mapper_mapCoordinatesInto(m, id, start, end, strand, type, results, nResult);
   }
 
-  int from, to;
-  if (!Mapper_compareType(type,Mapper_getTo(m))) {
-    from = MAPPER_TO_IND;
-    to   = MAPPER_FROM_IND;
-    cs   = Mapper_getFromCoordSystem(m);
-  } else if (!Mapper_compareType(type,Mapper_getFrom(m))) {
-    from = MAPPER_FROM_IND;
-    to   = MAPPER_TO_IND;
-    cs   = Mapper_getToCoordSystem(m);
-  } else {
-    fprintf(stderr, "Invalid type [%s] in mapper (not from [%s] or to [%s])\n", type, Mapper_getFrom(m), Mapper_getTo(m));
-    exit(1);
+  mrs = Mapper_resultsToRangeSet(results, nResult);
+
+  if (results != resultBuf) {
+    free(results);
   }
 
-  hash = Mapper_getPairHash(m, from);
+  return mrs;
+}
 
-  if (!hash) {
-    fprintf(stderr,"ERROR: Type %s is neither to or from coordinate system\n",type);
-    exit(1);
-  }
+/*
+ As Mapper_mapCoordinates, but the results go into the caller's results
+ array (maxResult long) rather than into newly allocated ranges. Returns the
+ number of results. If that's more than maxResult only the first maxResult
+ were stored, not reversed for strand -1, so the call should be repeated with
+ a big enough array.
+*/
+int Mapper_mapCoordinatesInto(Mapper *m, IDType id, long start, long end, int strand, char *type,
+                              MapperResult *results, int maxResult) {
+  MapperFlatPairSet *fps;
+  MapperResult spare;
+  MapperResult *res;
+  CoordSystem *cs;
+  int nResult = 0;
+  int from;
 
+  // special case for handling inserts, which are rare enough to leave to the MapperRangeSet code
+  if ( start == end+1 ) {
+    MapperRangeSet *mrs = Mapper_mapInsert(m, id, start, end, strand, type, 0 /*fastmap flag */);
+    int i;
 
-  MapperRangeSet *results = MapperRangeSet_new();
+    nResult = MapperRangeSet_getNumRange(mrs);
+    for (i=0; i<nResult && i<maxResult; i++) {
+      Mapper_rangeToResult(MapperRangeSet_getRangeAt(mrs, i), &results[i]);
+    }
+    MapperRangeSet_free(mrs);
 
+    return nResult;
+  } else if (start > end+1) {
+    fprintf(stderr,"ERROR: Start is greater than end for id " IDFMTSTR ", start %ld, end %ld\n",id,start,end);
+    exit(1);
+  }
 
-// Was upcasing the id - its a number in C, I haven't found a case yet where its a string
-  if (!IDHash_contains(hash, id)) {
-    // one big gap!
-    MapperRange *gap = (MapperRange *)MapperGap_new(start,end,0); // Perl didn't set rank so use 0
-    MapperRangeSet_addRange(results,gap);
-    return results;
+  if( Mapper_getIsSorted(m) == 0 ) {
+    Mapper_sort(m);
   }
 
+  from = Mapper_getFromInd(m, type, 1, &cs);
 
-  MapperPairSet *pairs = IDHash_getValue(hash,id); //my $lr = $hash->{ uc($id) };
+// Was upcasing the id - its a number in C, I haven't found a case yet where its a string
+  fps = IDHash_getValue(Mapper_getFlatPairHash(m, from), id);
 
+  if (fps == NULL) {
+    // one big gap!
+    if (maxResult > 0) {
+      Mapper_setGapResult(&results[0], start, end, 0); // Perl didn't set rank so use 0
+    }
+    return 1;
+  }
 
-  MapperPair *lastUsedPair = NULL;
+  MapperFlatPair *pairs = fps->pairs;
+  MapperFlatPair *lastUsedPair = NULL;
 
   int startIdx, endIdx, midIdx;
-  MapperPair *pair;
-  MapperUnit *selfCoord;
-
 
   startIdx = 0;
-  endIdx   = MapperPairSet_getNumPair(pairs)-1;
+  endIdx   = fps->nPair-1;
 
   // binary search the relevant pairs
   // helps if the list is big
   while ( ( endIdx - startIdx ) > 1 ) {
     midIdx = ( startIdx + endIdx ) >> 1;
-    pair   = MapperPairSet_getPairAt(pairs, midIdx);
-
-    selfCoord = MapperPair_getUnit(pair, from);
 
-    if ( selfCoord->end < start ) {
+    if ( pairs[midIdx].end < start ) {
       startIdx = midIdx;
     } else {
       endIdx = midIdx;
@@ -206,14 +240,12 @@ MapperRangeSet *Mapper_mapCoordinates(Mapper *m, IDType id, long start, long end
 
   int rank       = 0;
   long origStart = start;
-  IDType lastTargetCoord;
-  int lastTargetCoordIsSet = 0;
+  IDType lastTargetId = 0;
+  int lastTargetIdIsSet = 0;
 
   int i;
-  for (i=startIdx; i<MapperPairSet_getNumPair(pairs); i++) {
-    MapperPair *pair = MapperPairSet_getPairAt(pairs,i);
-    MapperUnit *selfCoord   = MapperPair_getUnit(pair, from);
-    MapperUnit *targetCoord = MapperPair_getUnit(pair, to);
+  for (i=startIdx; i<fps->nPair; i++) {
+    MapperFlatPair *pair = &pairs[i];
 
     //
     // But not the case for haplotypes!! need to test for this case???
@@ -225,116 +257,192 @@ MapperRangeSet *Mapper_mapCoordinates(Mapper *m, IDType id, long start, long end
     //       $rank++;
     //     }
 
-    if ( lastTargetCoordIsSet && targetCoord->id != lastTargetCoord ) {
-      if ( selfCoord->start < start ) {    // i.e. the same bit is being mapped to another assembled bit
+    if ( lastTargetIdIsSet && pair->targetId != lastTargetId ) {
+      if ( pair->start < start ) {    // i.e. the same bit is being mapped to another assembled bit
         start = origStart;
       }
     } else {
-      lastTargetCoord = targetCoord->id;
-      lastTargetCoordIsSet = 1;
+      lastTargetId = pair->targetId;
+      lastTargetIdIsSet = 1;
     }
 
     // if we haven't even reached the start, move on
-    if (selfCoord->end < origStart) {
+    if (pair->end < origStart) {
       continue;
     }
 
     // if we have over run, break
-    if (selfCoord->start > end) {
+    if (pair->start > end) {
       break;
     }
 
 // Check is start not origStart
-    if (start < selfCoord->start) {
+    if (start < pair->start) {
       // gap detected
-      MapperRange *gap = (MapperRange *)MapperGap_new(start, selfCoord->start-1, rank);
-      MapperRangeSet_addRange(results,gap);
-      start = gap->end+1;
+      res = nResult < maxResult ? &results[nResult] : &spare;
+      nResult++;
+      Mapper_setGapResult(res, start, pair->start-1, rank);
+      start = pair->start;
     }
 
-    long targetStart, targetEnd;
+    res = nResult < maxResult ? &results[nResult] : &spare;
+    nResult++;
 
-    MapperRange *res;
+    res->id          = pair->targetId;
+    res->strand      = pair->ori * strand;
+    res->coordSystem = cs;
 
-    if ( MapperPair_isIndel(pair) ) {
+    if ( pair->isIndel ) {
       // When next pair is an IndelPair and not a Coordinate, create the
       // new mapping Coordinate, the IndelCoordinate.
-      targetStart = targetCoord->start;
-      targetEnd   = targetCoord->end;
-
-      // create a Gap object
-      MapperGap *gap = MapperGap_new(start,
-                                     selfCoord->end < end ? selfCoord->end : end,
-                                     0); // Perl didn't set rank - don't know if need to
-
-      // create the Coordinate object
-      MapperCoordinate *coord = MapperCoordinate_new(targetCoord->id,
-                                                     targetStart,
-                                                     targetEnd,
-                                                     pair->ori * strand, 
-                                                     cs, 
-                                                     0); // Perl didn't set rank - don't know if need to
-
-      //and finally, the IndelCoordinate object with
-      res = (MapperRange *)IndelCoordinate_new(gap, coord);
+      res->rangeType = MAPPERRANGE_INDEL;
+      res->start     = pair->targetStart;
+      res->end       = pair->targetEnd;
+      res->rank      = 0; // Perl didn't set rank - don't know if need to
+      res->gapStart  = start;
+      res->gapEnd    = pair->end < end ? pair->end : end;
     } else {
+      long targetStart = 0;
+      long targetEnd   = 0;
+
       // start is somewhere inside the region
       if (pair->ori == 1) {
-        targetStart = targetCoord->start + (start - selfCoord->start);
+        targetStart = pair->targetStart + (start - pair->start);
       } else {
-        targetEnd = targetCoord->end - (start - selfCoord->start);
+        targetEnd = pair->targetEnd - (start - pair->start);
       }
 
       // Either we are enveloping this map or not.  If yes, then end
       // point (self perspective) is determined solely by target.  If
       // not we need to adjust.
-      if (end > selfCoord->end) {
+      if (end > pair->end) {
         // enveloped
         if( pair->ori == 1 ) {
-          targetEnd = targetCoord->end;
+          targetEnd = pair->targetEnd;
         } else {
-          targetStart = targetCoord->start;
+          targetStart = pair->targetStart;
         }
       } else {
         // need to adjust end
         if (pair->ori == 1) {
-          targetEnd = targetCoord->start + (end - selfCoord->start);
+          targetEnd = pair->targetStart + (end - pair->start);
         } else {
-          targetStart = targetCoord->end - (end - selfCoord->start);
+          targetStart = pair->targetEnd - (end - pair->start);
         }
       }
 
-      res = (MapperRange *)MapperCoordinate_new(targetCoord->id,
-                                                targetStart,
-                                                targetEnd,
-                                                pair->ori * strand, 
-                                                cs, 
-                                                rank);
-    } // end else [ if ( exists $pair->{'indel'...})]
-
-    MapperRangeSet_addRange(results, res);
+      res->rangeType = MAPPERRANGE_COORD;
+      res->start     = targetStart;
+      res->end       = targetEnd;
+      res->rank      = rank;
+      res->gapStart  = res->gapEnd = 0;
+    }
 
     lastUsedPair = pair;
-    start = selfCoord->end+1;
+    start = pair->end+1;
   }
 
   if (lastUsedPair == NULL) {
-    MapperRange *gap = (MapperRange *)MapperGap_new(start,end, 0); // Perl doesn't set rank, so use 0
-    MapperRangeSet_addRange(results,gap);
+    res = nResult < maxResult ? &results[nResult] : &spare;
+    nResult++;
+    Mapper_setGapResult(res, start, end, 0); // Perl doesn't set rank, so use 0
 
-  } else if (MapperPair_getUnit(lastUsedPair, from)->end < end) {
+  } else if (lastUsedPair->end < end) {
     // gap at the end
-    MapperRange *gap = (MapperRange *)MapperGap_new(
-                           MapperPair_getUnit(lastUsedPair,from)->end + 1,
-                           end, 0 ); // Perl didn't set rank so use 0
-    MapperRangeSet_addRange(results,gap);
+    res = nResult < maxResult ? &results[nResult] : &spare;
+    nResult++;
+    Mapper_setGapResult(res, lastUsedPair->end + 1, end, 0); // Perl didn't set rank so use 0
   }
 
-  if (strand == -1) {
-    MapperRangeSet_reverse(results);
+  if (strand == -1 && nResult <= maxResult) {
+    for (i=0; i<nResult/2; i++) {
+      MapperResult tmp = results[i];
+      results[i] = results[nResult-1-i];
+      results[nResult-1-i] = tmp;
+    }
   }
 
-  return results;
+  return nResult;
+}
+
+static void Mapper_setGapResult(MapperResult *result, long start, long end, int rank) {
+  memset(result, 0, sizeof(MapperResult));
+  result->rangeType = MAPPERRANGE_GAP;
+  result->start     = start;
+  result->end       = end;
+  result->rank      = rank;
+}
+
+static void Mapper_rangeToResult(MapperRange *range, MapperResult *result) {
+  memset(result, 0, sizeof(MapperResult));
+  result->rangeType = range->rangeType;
+  result->start     = range->start;
+  result->end       = range->end;
+
+  if (range->rangeType == MAPPERRANGE_COORD) {
+    MapperCoordinate *mc = (MapperCoordinate *)range;
+    result->id          = mc->id;
+    result->strand      = mc->strand;
+    result->rank        = mc->rank;
+    result->coordSystem = mc->coordSystem;
+  } else if (range->rangeType == MAPPERRANGE_INDEL) {
+    IndelCoordinate *ic = (IndelCoordinate *)range;
+    result->id          = ic->id;
+    result->strand      = ic->strand;
+    result->rank        = ic->rank;
+    result->coordSystem = ic->coordSystem;
+    result->gapStart    = ic->gapStart;
+    result->gapEnd      = ic->gapEnd;
+  } else {
+    result->rank = ((MapperGap *)range)->rank;
+  }
+}
+
+static MapperRangeSet *Mapper_resultsToRangeSet(MapperResult *results, int nResult) {
+  MapperRangeSet *mrs = MapperRangeSet_new();
+  int i;
+
+  for (i=0; i<nResult; i++) {
+    MapperResult *res = &results[i];
+    MapperRange *range;
+
+    if (res->rangeType == MAPPERRANGE_COORD) {
+      range = (MapperRange *)MapperCoordinate_new(res->id, res->start, res->end, res->strand, res->coordSystem, res->rank);
+    } else if (res->rangeType == MAPPERRANGE_INDEL) {
+      // IndelCoordinate_new only copies from these
+      MapperGap gap;
+      MapperCoordinate coord;
+
+      gap.start         = res->gapStart;
+      gap.end           = res->gapEnd;
+      coord.id          = res->id;
+      coord.start       = res->start;
+      coord.end         = res->end;
+      coord.strand      = res->strand;
+      coord.coordSystem = res->coordSystem;
+
+      range = (MapperRange *)IndelCoordinate_new(&gap, &coord);
+    } else {
+      range = (MapperRange *)MapperGap_new(res->start, res->end, res->rank);
+    }
+    MapperRangeSet_addRange(mrs, range);
+  }
+
+  return mrs;
+}
+
+// Index of the hashes to map from for type. Anything other than the 'to' type is 'from' unless strict is set
+static int Mapper_getFromInd(Mapper *m, char *type, int strict, CoordSystem **csP) {
+  if (!Mapper_compareType(type,Mapper_getTo(m))) {
+    *csP = Mapper_getFromCoordSystem(m);
+    return MAPPER_TO_IND;
+  } else if (!strict || !Mapper_compareType(type,Mapper_getFrom(m))) {
+    *csP = Mapper_getToCoordSystem(m);
+    return MAPPER_FROM_IND;
+  }
+
+  fprintf(stderr, "Invalid type [%s] in mapper (not from [%s] or to [%s])\n", type, Mapper_getFrom(m), Mapper_getTo(m));
+  exit(1);
 }
 
 
@@ -494,99 +602,163 @@ MapperRangeSet *Mapper_mapInsert(Mapper *m, IDType id, long start, long end, int
 // NIY: May need some reworking to handle mapInsert because I'd changed the way it returns data
 // Change back to returning MapperRangeSet
 MapperRangeSet *Mapper_fastMap(Mapper *m, IDType id, long start, long end, int strand, char *type) {
-  MapperPairSet *pairs;
-  int i;
-  IDHash *hash;
-  int from, to;
-  CoordSystem *cs;
+  MapperResult result;
+  int mapped;
 
   if(end+1 == start) {
     return Mapper_mapInsert(m, id, start, end, strand, type, 1);
   }
 
-  if(!Mapper_compareType(type, Mapper_getTo(m))) {
-    from = MAPPER_TO_IND;
-    to   = MAPPER_FROM_IND;
-    cs   = Mapper_getFromCoordSystem(m);
+  mapped = Mapper_fastMapInto(m, id, start, end, strand, type, &result);
 
-  } else {
-    from = MAPPER_FROM_IND;
-    to   = MAPPER_TO_IND;
-    cs   = Mapper_getToCoordSystem(m);
+  if (mapped < 0) {
+    fprintf(stderr,"ERROR: Fastmap expects to be able to find an id. It couldnt for " IDFMTSTR "\n",id);
+    exit(1);
   }
 
-  hash = Mapper_getPairHash(m, from);
+  MapperRangeSet *retSet = MapperRangeSet_new();
 
-  if (!hash) {
-    fprintf(stderr,"ERROR: Type %s is neither to or from coordinate system\n",type);
-    exit(1);
+  if (mapped) {
+    MapperRangeSet_addRange(retSet, (MapperRange *)MapperCoordinate_new(result.id, result.start, result.end, result.strand,
+                                                                        result.coordSystem, 0)); // Perl didn't set rank, so use 0
+  }
+
+  // NIY: Here we return empty set, in mapInsert it returns NULL for empty fastmap - need to work out which is right
+  return retSet;
+}
+
+/*
+ As Mapper_fastMap, but fills in result rather than allocating. Returns 1 if
+ the region mapped, 0 if it didn't (result is then a gap covering it) and -1
+ if id isn't in the mapper at all.
+*/
+int Mapper_fastMapInto(Mapper *m, IDType id, long start, long end, int strand, char *type, MapperResult *result) {
+  MapperFlatPairSet *fps;
+  CoordSystem *cs;
+  int from;
+
+  if(end+1 == start) {
+    MapperRangeSet *mrs = Mapper_mapInsert(m, id, start, end, strand, type, 1);
+    int mapped = mrs != NULL && MapperRangeSet_getNumRange(mrs) > 0;
+
+    if (mapped) {
+      Mapper_rangeToResult(MapperRangeSet_getRangeAt(mrs, 0), result);
+    } else {
+      Mapper_setGapResult(result, start, end, 0);
+    }
+    if (mrs) {
+      MapperRangeSet_free(mrs);
+    }
+    return mapped;
   }
 
   if (Mapper_getIsSorted(m) == 0) {
     Mapper_sort(m);
   }
 
-  if (!IDHash_contains(hash, id)) {
-    fprintf(stderr,"ERROR: Fastmap expects to be able to find an id. It couldnt for " IDFMTSTR "\n",id);
-    exit(1);
+  from = Mapper_getFromInd(m, type, 0, &cs);
+
+  if ((fps = IDHash_getValue(Mapper_getFlatPairHash(m, from), id)) == NULL) {
+    Mapper_setGapResult(result, start, end, 0);
+    return -1;
   }
 
-  pairs = IDHash_getValue(hash,id);
+  return Mapper_fastMapFlat(fps, start, end, strand, cs, result);
+}
 
-  MapperRangeSet *retSet = MapperRangeSet_new();
+/*
+ Fast maps nCoord regions in one go, all from type, into results (which
+ must have nCoord elements). Regions which don't map, including those on ids
+ which aren't in the mapper, get a gap result. Runs of regions on the same id
+ only look the id up once. Returns the number of regions which mapped.
+*/
+int Mapper_fastMapMany(Mapper *m, char *type, int nCoord, IDType *ids, long *starts, long *ends,
+                       int *strands, MapperResult *results) {
+  MapperFlatPairSet *fps = NULL;
+  IDType lastId = 0;
+  int haveLastId = 0;
+  CoordSystem *cs;
+  int nMapped = 0;
+  int from;
+  int i;
 
-  for (i=0;i<MapperPairSet_getNumPair(pairs);i++) {
-    MapperPair *pair = MapperPairSet_getPairAt(pairs,i);
-    MapperUnit *selfCoord   = MapperPair_getUnit(pair, from);
-    MapperUnit *targetCoord = MapperPair_getUnit(pair, to);
+  if (Mapper_getIsSorted(m) == 0) {
+    Mapper_sort(m);
+  }
 
-    // only super easy mapping is done
-    if(start < selfCoord->start ||
-       end   > selfCoord->end ) {
+  from = Mapper_getFromInd(m, type, 0, &cs);
+
+  for (i=0; i<nCoord; i++) {
+    if (ends[i]+1 == starts[i]) {
+      if (Mapper_fastMapInto(m, ids[i], starts[i], ends[i], strands[i], type, &results[i]) > 0) {
+        nMapped++;
+      }
       continue;
     }
 
-    if (pair->ori == 1) {
-      MapperCoordinate *retRange = MapperCoordinate_new(targetCoord->id, 
-                                                        targetCoord->start + start - selfCoord->start, 
-                                                        targetCoord->start + end   - selfCoord->start,
-                                                        strand,
-                                                        cs, 
-                                                        0); // Perl didn't set rank, so use 0 
+    if (!haveLastId || ids[i] != lastId) {
+      fps        = IDHash_getValue(Mapper_getFlatPairHash(m, from), ids[i]);
+      lastId     = ids[i];
+      haveLastId = 1;
+    }
+
+    if (fps == NULL) {
+      Mapper_setGapResult(&results[i], starts[i], ends[i], 0);
+    } else {
+      nMapped += Mapper_fastMapFlat(fps, starts[i], ends[i], strands[i], cs, &results[i]);
+    }
+  }
+
+  return nMapped;
+}
 
 /*
-      retRange->id     = targetCoord->id;
-      retRange->start  = targetCoord->start + start - selfCoord->start;
-      retRange->end    = targetCoord->start + end   - selfCoord->start;
-      retRange->strand = strand;
-      retRange->coordSystem = cs;
+ Only super easy mapping is done - the first pair (in start order) which
+ contains the whole region. Pairs before the first one whose maxEnd reaches
+ end can't contain it, and neither can any starting after start.
 */
+static int Mapper_fastMapFlat(MapperFlatPairSet *fps, long start, long end, int strand, CoordSystem *cs,
+                              MapperResult *result) {
+  MapperFlatPair *pairs = fps->pairs;
+  int lo = 0;
+  int hi = fps->nPair;
+  int i;
 
-      MapperRangeSet_addRange(retSet, (MapperRange *)retRange);
-      break;
+  while (lo < hi) {
+    int mid = (lo + hi) >> 1;
+    if (pairs[mid].maxEnd < end) {
+      lo = mid + 1;
     } else {
-      MapperCoordinate *retRange = MapperCoordinate_new(targetCoord->id, 
-                                                        targetCoord->end - (end - selfCoord->start),
-                                                        targetCoord->end - (start - selfCoord->start),
-                                                        -strand,
-                                                        cs, 
-                                                        0); // Perl didn't set rank, so use 0 
+      hi = mid;
+    }
+  }
 
-/*
-      retRange->id     = targetCoord->id;
-      retRange->start  = targetCoord->end - (end - selfCoord->start);
-      retRange->end    = targetCoord->end - (start - selfCoord->start);
-      retRange->strand = -strand;
-      retRange->coordSystem = cs;
-*/
+  for (i=lo; i<fps->nPair && pairs[i].start <= start; i++) {
+    MapperFlatPair *pair = &pairs[i];
 
-      MapperRangeSet_addRange(retSet, (MapperRange *)retRange);
-      break;
+    if (end > pair->end) {
+      continue;
     }
+
+    memset(result, 0, sizeof(MapperResult));
+    result->rangeType   = MAPPERRANGE_COORD;
+    result->id          = pair->targetId;
+    result->coordSystem = cs;
+
+    if (pair->ori == 1) {
+      result->start  = pair->targetStart + start - pair->start;
+      result->end    = pair->targetStart + end   - pair->start;
+      result->strand = strand;
+    } else {
+      result->start  = pair->targetEnd - (end - pair->start);
+      result->end    = pair->targetEnd - (start - pair->start);
+      result->strand = -strand;
+    }
+    return 1;
   }
 
-  // NIY: Here we return empty set, in mapInsert it returns NULL for empty fastmap - need to work out which is right
-  return retSet;
+  Mapper_setGapResult(result, start, end, 0);
+  return 0;
 }
 
 
@@ -1071,10 +1243,83 @@ void Mapper_sort(Mapper *m) {
 // MergePairs yet to do
   Mapper_mergePairs(m);
 
+  Mapper_freeFlatPairs(m);
+  Mapper_buildFlatPairs(m, MAPPER_FROM_IND);
+  Mapper_buildFlatPairs(m, MAPPER_TO_IND);
+
   Mapper_setIsSorted(m, 1);
 
 }
 
+// Copies the (sorted and merged) pairs for each id into a MapperFlatPairSet
+static void Mapper_buildFlatPairs(Mapper *m, int from) {
+  IDHash *pairHash = Mapper_getPairHash(m, from);
+  IDHash *flatHash = IDHash_new(IDHASH_MEDIUM);
+  int to = (from == MAPPER_FROM_IND) ? MAPPER_TO_IND : MAPPER_FROM_IND;
+  IDType id;
+  void *val;
+  int iter = 0;
+
+  IDHash_reserve(flatHash, IDHash_getNumValues(pairHash));
+
+  while (IDHash_next(pairHash, &iter, &id, &val)) {
+    MapperPairSet *pairs = val;
+    MapperFlatPairSet *fps;
+    long maxEnd = LONG_MIN;
+    int i;
+
+    if ((fps = (MapperFlatPairSet *)calloc(1,sizeof(MapperFlatPairSet))) == NULL) {
+      fprintf(stderr,"ERROR: Failed allocating space for flat pair set\n");
+      exit(1);
+    }
+    fps->nPair = MapperPairSet_getNumPair(pairs);
+    if ((fps->pairs = (MapperFlatPair *)calloc(fps->nPair ? fps->nPair : 1, sizeof(MapperFlatPair))) == NULL) {
+      fprintf(stderr,"ERROR: Failed allocating space for flat pairs\n");
+      exit(1);
+    }
+
+    for (i=0; i<fps->nPair; i++) {
+      MapperPair *pair        = MapperPairSet_getPairAt(pairs, i);
+      MapperUnit *selfCoord   = MapperPair_getUnit(pair, from);
+      MapperUnit *targetCoord = MapperPair_getUnit(pair, to);
+      MapperFlatPair *flat    = &fps->pairs[i];
+
+      if (selfCoord->end > maxEnd) {
+        maxEnd = selfCoord->end;
+      }
+
+      flat->start       = selfCoord->start;
+      flat->end         = selfCoord->end;
+      flat->maxEnd      = maxEnd;
+      flat->targetStart = targetCoord->start;
+      flat->targetEnd   = targetCoord->end;
+      flat->targetId    = targetCoord->id;
+      flat->ori         = pair->ori;
+      flat->isIndel     = MapperPair_isIndel(pair) ? 1 : 0;
+    }
+
+    IDHash_add(flatHash, id, fps);
+  }
+
+  m->flatHashes[from] = flatHash;
+}
+
+static void MapperFlatPairSet_free(MapperFlatPairSet *fps) {
+  free(fps->pairs);
+  free(fps);
+}
+
+static void Mapper_freeFlatPairs(Mapper *m) {
+  int i;
+
+  for (i=0; i<2; i++) {
+    if (m->flatHashes[i]) {
+      IDHash_free(m->flatHashes[i], MapperFlatPairSet_free);
+      m->flatHashes[i] = NULL;
+    }
+  }
+}
+
 // this function merges pairs that are adjacent into one
 // This function is a pain in the arse to implement in C
 void Mapper_mergePairs(Mapper *m) {
@@ -30,8 +30,52 @@
 #include "MapperRange.h"
 #include "MapperGap.h"
 
+/*
+ Flat copy of the pairs for one id in one direction, built by Mapper_sort so
+ mapping walks a contiguous sorted array rather than chasing MapperPair and
+ MapperUnit pointers. maxEnd is the largest end of this and all the earlier
+ pairs, which is never decreasing so can be binary searched even when pairs
+ overlap.
+*/
+typedef struct MapperFlatPairStruct {
+  long   start;
+  long   end;
+  long   maxEnd;
+  long   targetStart;
+  long   targetEnd;
+  IDType targetId;
+  signed char ori;
+  signed char isIndel;
+} MapperFlatPair;
+
+typedef struct MapperFlatPairSetStruct {
+  MapperFlatPair *pairs;
+  int nPair;
+} MapperFlatPairSet;
+
+/*
+ One mapped range, in a caller supplied buffer. rangeType is one of the
+ MAPPERRANGE_ types. For gaps only start, end and rank are set, for indels
+ gapStart and gapEnd are the gap in the source coordinates.
+*/
+typedef struct MapperResultStruct {
+  int    rangeType;
+  long   start;
+  long   end;
+  IDType id;
+  signed char strand;
+  int    rank;
+  long   gapStart;
+  long   gapEnd;
+  CoordSystem *coordSystem;
+} MapperResult;
+
+// Results that fit on the stack in the MapperRangeSet returning calls
+#define MAPPER_RESULTBUFSIZE 64
+
 struct MapperStruct {
   IDHash *hashes[2];
+  IDHash *flatHashes[2];
   char *from;
   char *to;
   CoordSystem *toSystem;
@@ -52,6 +96,8 @@ struct MapperStruct {
 #define Mapper_setPairHash(m, ind, h) (m)->hashes[(ind)] = (h)
 #define Mapper_getPairHash(m, ind) (m)->hashes[(ind)]
 
+#define Mapper_getFlatPairHash(m, ind) (m)->flatHashes[(ind)]
+
 #define Mapper_setIsSorted(m, i) (m)->isSorted = (i)
 #define Mapper_getIsSorted(m) (m)->isSorted
 #define Mapper_isSorted(m) (m)->isSorted
@@ -75,6 +121,15 @@ MapperRangeSet *Mapper_mapCoordinates(Mapper *m, IDType id, long start, long end
 MapperRangeSet *Mapper_fastMap(Mapper *m, IDType id, long start, long end, int strand, 
                                char *type);
 
+int Mapper_mapCoordinatesInto(Mapper *m, IDType id, long start, long end, int strand, char *type,
+                              MapperResult *results, int maxResult);
+
+int Mapper_fastMapInto(Mapper *m, IDType id, long start, long end, int strand, char *type,
+                       MapperResult *result);
+
+int Mapper_fastMapMany(Mapper *m, char *type, int nCoord, IDType *ids, long *starts, long *ends,
+                       int *strands, MapperResult *results);
+
 void Mapper_addMapCoordinates(Mapper *m, IDType contigId, int contigStart, int contigEnd,
                               int contigOri, IDType chrId, int chrStart, int chrEnd);
 
@@ -55,13 +55,28 @@ struct ObjectStruct {
 void Object_freeImpl(Object *obj);
 void Object_errorUnimplementedMethod(Object *obj, char *methodName);
 
-#define Object_incRefCount(obj) (obj)->referenceCount++
+// Atomic so objects shared between threads (analyses, slices) keep correct counts
+#define Object_incRefCount(obj) __sync_fetch_and_add(&((obj)->referenceCount), 1)
 //void Object_incRefCount(Object *obj);
-#define Object_decRefCount(obj) (obj)->referenceCount--
+#define Object_decRefCount(obj) __sync_fetch_and_sub(&((obj)->referenceCount), 1)
 //void Object_decRefCount(Object *obj);
 
 #define Object_getRefCount(obj) (obj)->referenceCount
 
+/*
+ Objects allocated from an Arena (see Arena.h) are released with it, never
+ one by one. They get OBJECT_ARENAREFCOUNT added to their reference count,
+ so the usual decrement-and-test in their free functions never reaches zero
+ and freeing them (or a heap object holding them) is a harmless no-op.
+*/
+#define OBJECT_ARENAREFCOUNT (1<<30)
+#define Object_setInArena(obj) __sync_fetch_and_add(&((obj)->referenceCount), OBJECT_ARENAREFCOUNT)
+#define Object_isInArena(obj) ((obj)->referenceCount >= OBJECT_ARENAREFCOUNT/2)
+// For copies made with memcpy, which take the source's reference count
+#define Object_setArenaState(obj, inArena) \
+  ((inArena) != Object_isInArena(obj) ? \
+     __sync_fetch_and_add(&((obj)->referenceCount), (inArena) ? OBJECT_ARENAREFCOUNT : -OBJECT_ARENAREFCOUNT) : 0)
+
 // Comment out to reduce warnings void Object_errorUnimplementedMethod(Object *obj, char *methodName);
 
 #define Object_free(obj) \
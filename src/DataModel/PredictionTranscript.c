@@ -338,9 +338,7 @@ int PredictionTranscript_setExonCount(PredictionTranscript *trans, int count) {
 char *PredictionTranscript_translate(PredictionTranscript *trans) {
   char *dna;
   int lenDNA;
-  int lengths[6];
-  char *frm[6];
-  int i;
+  char *peptide;
 
   dna = PredictionTranscript_getcDNA(trans);
 
@@ -353,23 +351,20 @@ char *PredictionTranscript_translate(PredictionTranscript *trans) {
         !strcmp(lastCodon,"TGA") ||
         !strcmp(lastCodon,"TAA")) {
       *lastCodon = '\0';
+      lenDNA -= 3;
     }
   }
 
-  for (i=0;i<6;i++) {
-    frm[i] = (char *)malloc(lenDNA/3 + 2);
+  if ((peptide = (char *)malloc(lenDNA/3 + 2)) == NULL) {
+    fprintf(stderr,"Failed allocating peptide\n");
+    exit(1);
   }
 
-  translate(dna, frm, lengths, 1, lenDNA);
+  translate_frame(dna, peptide, 0, 1, lenDNA);
 
   free(dna);
 
-  // Note don't free frame 0
-  for (i=1;i<6;i++) {
-    free(frm[i]);
-  }
-
-  return frm[0];
+  return peptide;
 }
 
 /*
@@ -56,7 +56,7 @@ PredictionTranscript *PredictionTranscript_new(void);
 ECOSTRING PredictionTranscript_setDisplayLabel(PredictionTranscript *pt, char *label);
 #define PredictionTranscript_getDisplayLabel(transcript) (transcript)->displayLabel
 
-#define PredictionTranscript_setStableId(transcript,sid)  StableIdInfo_setStableId(&((transcript)->si),(sid))
+#define PredictionTranscript_setStableId(transcript,sid)  StableIdInfo_setStableId(&((transcript)->si),(sid),Object_isInArena(transcript))
 #define PredictionTranscript_getStableId(transcript)  StableIdInfo_getStableId(&((transcript)->si))
 
 int PredictionTranscript_setStart(PredictionTranscript *transcript, int start);
@@ -15,18 +15,19 @@
  */
 
 #include "StableIdInfo.h"
+#include "Arena.h"
 
 #include <stdlib.h>
 #include <string.h>
 
-char *StableIdInfo_setStableId(StableIdInfo *si, char *sid) {
-  if ((si->stableId = (char *)malloc(strlen(sid)+1)) == NULL) {
+char *StableIdInfo_setStableId(StableIdInfo *si, char *sid, int inArena) {
+  // From the current arena if the object si is part of came from it
+  if ((si->stableId = Arena_copyStringFor(si, inArena, sid)) == NULL) {
     fprintf(stderr,"ERROR: Failed allocating space for stableid\n");
     return NULL;
   }
 
   // fprintf(stderr,"Allocated stable id string %p in stable id object %p for stable id %s\n", si->stableId, si, sid);
-  strcpy(si->stableId,sid);
 
   return si->stableId;
 }
@@ -30,7 +30,8 @@ struct StableIdInfoStruct {
   char isCurrent;
 };
 
-char *StableIdInfo_setStableId(StableIdInfo *si, char *sid); 
+// inArena is Object_isInArena for the object si is embedded in
+char *StableIdInfo_setStableId(StableIdInfo *si, char *sid, int inArena); 
 #define StableIdInfo_getStableId(si)  (si)->stableId
 
 #define StableIdInfo_setCreated(si,cd)  (si)->created = (cd)
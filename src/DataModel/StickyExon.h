@@ -74,7 +74,7 @@ struct StickyExonStruct {
 #define StickyExon_setStrand(exon,strand) Exon_setStrand((exon),(strand))
 #define StickyExon_getStrand(exon) Exon_getStrand((exon))
 
-#define Exon_setStableId(exon,stableId)  StableIdInfo_setStableId(&((exon)->si),(stableId))
+#define Exon_setStableId(exon,stableId)  StableIdInfo_setStableId(&((exon)->si),(stableId),Object_isInArena(exon))
 char *Exon_getStableId(Exon *exon);
 
 #define Exon_setVersion(exon,ver)  StableIdInfo_setVersion(&((exon)->si),(ver))
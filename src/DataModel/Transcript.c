@@ -29,6 +29,7 @@
 #include "StrUtil.h"
 #include "SeqUtil.h"
 #include "translate.h"
+#include "Arena.h"
 
 #include "Attribute.h"
 
@@ -36,8 +37,9 @@
 
 Transcript *Transcript_new() {
   Transcript *transcript;
+  Arena *arena = Arena_getCurrent();
 
-  if ((transcript = (Transcript *)calloc(1,sizeof(Transcript))) == NULL) {
+  if ((transcript = (Transcript *)(arena ? Arena_calloc(arena, sizeof(Transcript)) : calloc(1,sizeof(Transcript)))) == NULL) {
     fprintf(stderr,"ERROR: Failed allocating space for transcripe\n");
     return NULL;
   }
@@ -49,10 +51,11 @@ Transcript *Transcript_new() {
 // -1 is invalid is canonical value, when call getIsCanonical value will be retrieved from db
   Transcript_setIsCanonical(transcript,-1);
 
-  transcript->exons = Vector_new();
-
   transcript->objectType = CLASS_TRANSCRIPT;
   Object_incRefCount(transcript);
+  if (arena) Object_setInArena(transcript);
+
+  transcript->exons = Vector_newFor(transcript);
 
   transcript->funcs = &transcriptFuncs;
 
@@ -65,7 +68,9 @@ Transcript *Transcript_shallowCopy(Transcript *transcript) {
   // Exons will come in mem copy so free vector just created in Transcript_new
   Vector_free(newTranscript->exons);
 
+  int inArena = Object_isInArena(newTranscript);
   memcpy(newTranscript,transcript,sizeof(Transcript));
+  Object_setArenaState(newTranscript, inArena);
 
   return newTranscript;
 }
@@ -87,7 +92,7 @@ Transcript *Transcript_shallowCopy(Transcript *transcript) {
 // New
 void Transcript_addExon(Transcript *transcript, Exon *exon, int rank) {
   if (transcript->exons == NULL) {
-    transcript->exons = Vector_new();
+    transcript->exons = Vector_newFor(transcript);
   }
 
   if (rank > 0) {
@@ -452,7 +457,7 @@ Vector *Transcript_getAllDBEntries(Transcript *t) {
 
 int Transcript_addDBLink(Transcript *t, DBEntry *dbe) {
   if (!t->dbLinks) {
-    t->dbLinks = Vector_new();
+    t->dbLinks = Vector_newFor(t);
   }
 
   Vector_addElement(t->dbLinks, dbe); 
@@ -499,13 +504,11 @@ ECOSTRING Transcript_setStatus(Transcript *t, char *status) {
 }
 
 char *Transcript_setDescription(Transcript *t, char *description) {
-  if ((t->description = (char *)malloc(strlen(description)+1)) == NULL) {
+  if ((t->description = Arena_copyStringFor(t, Object_isInArena(t), description)) == NULL) {
     fprintf(stderr,"ERROR: Failed allocating space for description\n");
     return NULL;
   }
 
-  strcpy(t->description,description);
-
   return t->description;
 }
 
@@ -536,13 +539,11 @@ char *Transcript_setExternalName(Transcript *t, char *externalName) {
     t->externalName = NULL;
     return NULL;
   }
-  if ((t->externalName = (char *)malloc(strlen(externalName)+1)) == NULL) {
+  if ((t->externalName = Arena_copyStringFor(t, Object_isInArena(t), externalName)) == NULL) {
     fprintf(stderr,"ERROR: Failed allocating space for externalName\n");
     return NULL;
   }
 
-  strcpy(t->externalName,externalName);
-
   return t->externalName;
 }
 
@@ -782,7 +783,7 @@ int Transcript_addIntronSupportingEvidence(Transcript *transcript, IntronSupport
   int unique = 1;
 
   if (transcript->iseVector == NULL) {
-    transcript->iseVector = Vector_new();
+    transcript->iseVector = Vector_newFor(transcript);
   } else {
     int i;
     for (i=0; i<Vector_getNumElement(transcript->iseVector); i++) {
@@ -1190,9 +1191,7 @@ Vector *Transcript_getAllTranslateableExons(Transcript *trans) {
 char *Transcript_translate(Transcript *trans) {
   char *mRNA;
   int lenmRNA;
-  int lengths[6];
-  char *frm[6];
-  int i;
+  char *peptide;
 
   mRNA = Transcript_getTranslateableSeq(trans);
 
@@ -1239,21 +1238,18 @@ char *Transcript_translate(Transcript *trans) {
   // if you want to have a terminal stop codon either comment this line out
   // or call translatable seq directly and produce a translation from it
 
-  for (i=0;i<6;i++) {
-    frm[i] = (char *)malloc(lenmRNA/3 + 2);
+  if ((peptide = (char *)malloc(lenmRNA/3 + 2)) == NULL) {
+    fprintf(stderr,"Failed allocating peptide\n");
+    exit(1);
   }
 
+  // Only frame 0 is wanted so don't translate the other five
   //fprintf(stderr, "translateable seq = %s\n",mRNA);
-  translate(mRNA, frm, lengths, codonTableId, lenmRNA);
+  translate_frame(mRNA, peptide, 0, codonTableId, lenmRNA);
 
   free(mRNA);
 
-  // Note don't free frame 0
-  for (i=1;i<6;i++) {
-    free(frm[i]);
-  }
-
-  return Translation_modifyTranslation(Transcript_getTranslation(trans), frm[0]);
+  return Translation_modifyTranslation(Transcript_getTranslation(trans), peptide);
 }
 
 
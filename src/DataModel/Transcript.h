@@ -92,7 +92,7 @@ int Transcript_getIsCanonical(Transcript *transcript);
 #define Transcript_setAnalysis(trans,ana) AnnotatedSeqFeature_setAnalysis((trans),(ana))
 #define Transcript_getAnalysis(trans) AnnotatedSeqFeature_getAnalysis((trans))
 
-#define Transcript_setStableId(transcript,sid)  StableIdInfo_setStableId(&((transcript)->si),(sid))
+#define Transcript_setStableId(transcript,sid)  StableIdInfo_setStableId(&((transcript)->si),(sid),Object_isInArena(transcript))
 char *Transcript_getStableId(Transcript *transcript);
 
 #define Transcript_setVersion(transcript,ver)  StableIdInfo_setVersion(&((transcript)->si),(ver))
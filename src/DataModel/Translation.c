@@ -21,13 +21,15 @@
 #include "AttributeAdaptor.h"
 #include "SeqEdit.h"
 #include "DBEntryAdaptor.h"
+#include "Arena.h"
 
 #include <strings.h>
 
 Translation *Translation_new() {
   Translation *t;
+  Arena *arena = Arena_getCurrent();
 
-  if ((t = (Translation *)calloc(1,sizeof(Translation))) == NULL) {
+  if ((t = (Translation *)(arena ? Arena_calloc(arena, sizeof(Translation)) : calloc(1,sizeof(Translation)))) == NULL) {
     fprintf(stderr,"ERROR: Failed allocating space for t\n");
     return NULL;
   }
@@ -39,6 +41,7 @@ Translation *Translation_new() {
   t->funcs = &translationFuncs;
 
   Object_incRefCount(t);
+  if (arena) Object_setInArena(t);
 
   return t;
 }
@@ -66,7 +66,7 @@ struct TranslationStruct {
 #define Translation_setModified(translation,mod)  StableIdInfo_setModified(&((translation)->si),mod)
 #define Translation_getModified(translation)  StableIdInfo_getModified(&((translation)->si))
 
-#define Translation_setStableId(translation,sid)  StableIdInfo_setStableId(&((translation)->si),(sid))
+#define Translation_setStableId(translation,sid)  StableIdInfo_setStableId(&((translation)->si),(sid),Object_isInArena(translation))
 char *Translation_getStableId(Translation *translation);
 
 #define Translation_setVersion(translation,ver)  StableIdInfo_setVersion(&((translation)->si),(ver))
@@ -16,6 +16,11 @@
 
 #include "RefineSolexaGenes.h"
 #include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "EnsC.h"
 
@@ -37,6 +42,7 @@
 #include "IntronSupportingEvidence.h"
 #include "Transcript.h"
 #include "translate.h"
+#include "WorkPool.h"
 #include "Attribute.h"
 #include "MetaContainer.h"
 
@@ -58,9 +64,7 @@ Bio::EnsEMBL::Analysis::Config::Databases and the configuration for the
 module is defined in Bio::EnsEMBL::Analysis::Config::GeneBuild::RefineSolexaGenes
 */
 
-// Used for counting recursive calls in processPaths and processTree
-static int limit = 0;
-
+// Counted from all the refine threads, so updated atomically
 static int nExonClone = 0;
 
 FILE *logfp;
@@ -155,7 +159,24 @@ IntronBamConfig *IntronBamConfig_new(char *fileName, int mixedBam, int depth, Ve
   return ibc;
 }
 
+void IntronBamConfig_closeBam(IntronBamConfig *ibc) {
+  if (ibc->idx) {
+    hts_idx_destroy(ibc->idx);
+    ibc->idx = NULL;
+  }
+  if (ibc->header) {
+    bam_hdr_destroy(ibc->header);
+    ibc->header = NULL;
+  }
+  if (ibc->sam) {
+    hts_close(ibc->sam);
+    ibc->sam = NULL;
+  }
+}
+
 void IntronBamConfig_free(IntronBamConfig *ibc) {
+  IntronBamConfig_closeBam(ibc);
+
   if (ibc->fileName) free(ibc->fileName);
   
   if (ibc->groupNames) {
@@ -295,6 +316,369 @@ void IntronCoords_free(IntronCoords *ic) {
   free(ic);
 }
 
+typedef struct JunctionTableStruct {
+  Junction *slots;
+  int nAlloc;
+  int nUsed;
+} JunctionTable;
+
+JunctionTable *JunctionTable_new(int nAlloc) {
+  JunctionTable *jt;
+
+  if ((jt = (JunctionTable *)calloc(1,sizeof(JunctionTable))) == NULL) {
+    fprintf(stderr,"Failed allocating JunctionTable\n");
+    exit(1);
+  }
+  if ((jt->slots = (Junction *)calloc(nAlloc, sizeof(Junction))) == NULL) {
+    fprintf(stderr,"Failed allocating JunctionTable slots\n");
+    exit(1);
+  }
+  jt->nAlloc = nAlloc;
+
+  return jt;
+}
+
+unsigned long Junction_hash(long prevExonEnd, long nextExonStart, int strand, int fileNum) {
+  unsigned long h = (unsigned long)prevExonEnd * 0x9E3779B97F4A7C15UL;
+
+  h ^= (unsigned long)nextExonStart * 0xC2B2AE3D27D4EB4FUL;
+  h ^= (unsigned long)(fileNum * 2 + (strand == 1)) * 0x165667B19E3779F9UL;
+  h ^= h >> 29;
+
+  return h;
+}
+
+Junction *JunctionTable_findSlot(Junction *slots, int nAlloc, long prevExonEnd, long nextExonStart, int strand, int fileNum) {
+  unsigned long mask = nAlloc - 1;
+  unsigned long ind = Junction_hash(prevExonEnd, nextExonStart, strand, fileNum) & mask;
+
+  while (slots[ind].score != 0) {
+    Junction *j = &slots[ind];
+    if (j->prevExonEnd == prevExonEnd && j->nextExonStart == nextExonStart &&
+        j->strand == strand && j->fileNum == fileNum) {
+      break;
+    }
+    ind = (ind + 1) & mask;
+  }
+  return &slots[ind];
+}
+
+void JunctionTable_grow(JunctionTable *jt) {
+  int nAlloc = jt->nAlloc * 2;
+  Junction *slots;
+  int i;
+
+  if ((slots = (Junction *)calloc(nAlloc, sizeof(Junction))) == NULL) {
+    fprintf(stderr,"Failed allocating JunctionTable slots\n");
+    exit(1);
+  }
+  for (i=0; i<jt->nAlloc; i++) {
+    Junction *j = &jt->slots[i];
+    if (j->score != 0) {
+      *JunctionTable_findSlot(slots, nAlloc, j->prevExonEnd, j->nextExonStart, j->strand, j->fileNum) = *j;
+    }
+  }
+  free(jt->slots);
+  jt->slots  = slots;
+  jt->nAlloc = nAlloc;
+}
+
+void JunctionTable_add(JunctionTable *jt, long prevExonEnd, long nextExonStart, int strand, int fileNum) {
+  // Keep load below 0.7
+  if ((jt->nUsed + 1) * 10 > jt->nAlloc * 7) {
+    JunctionTable_grow(jt);
+  }
+
+  Junction *j = JunctionTable_findSlot(jt->slots, jt->nAlloc, prevExonEnd, nextExonStart, strand, fileNum);
+  if (j->score == 0) {
+    j->prevExonEnd   = prevExonEnd;
+    j->nextExonStart = nextExonStart;
+    j->strand        = strand;
+    j->fileNum       = fileNum;
+    jt->nUsed++;
+  }
+  j->score++;
+}
+
+int Junction_coordCompFunc(const void *a, const void *b) {
+  const Junction *j1 = (const Junction *)a;
+  const Junction *j2 = (const Junction *)b;
+
+  if (j1->prevExonEnd != j2->prevExonEnd) {
+    return j1->prevExonEnd < j2->prevExonEnd ? -1 : 1;
+  }
+  if (j1->nextExonStart != j2->nextExonStart) {
+    return j1->nextExonStart < j2->nextExonStart ? -1 : 1;
+  }
+  return j1->strand - j2->strand;
+}
+
+/*
+  Drops junctions below their file's depth, then sorts the rest on coords and
+  merges the counts for the same junction from different files. The table is
+  compacted in place: the result is the first return value slots of jt->slots,
+  and the table can't be added to afterwards.
+*/
+int JunctionTable_collapse(JunctionTable *jt, Vector *intronBamFiles) {
+  int nJunction = 0;
+  int nMerged = 0;
+  int i;
+
+  for (i=0; i<jt->nAlloc; i++) {
+    Junction *j = &jt->slots[i];
+    if (j->score != 0) {
+      IntronBamConfig *intronBamConf = Vector_getElementAt(intronBamFiles, j->fileNum);
+
+      if (!intronBamConf->depth || intronBamConf->depth <= j->score) {
+        jt->slots[nJunction++] = *j;
+      }
+    }
+  }
+
+  qsort(jt->slots, nJunction, sizeof(Junction), Junction_coordCompFunc);
+
+  for (i=0; i<nJunction; i++) {
+    if (nMerged > 0 && !Junction_coordCompFunc(&jt->slots[nMerged-1], &jt->slots[i])) {
+      jt->slots[nMerged-1].score += jt->slots[i].score;
+    } else {
+      jt->slots[nMerged++] = jt->slots[i];
+    }
+  }
+
+  return nMerged;
+}
+
+void JunctionTable_free(JunctionTable *jt) {
+  free(jt->slots);
+  free(jt);
+}
+
+/*
+  Min heap of file numbers ordered on the position of each file's current read,
+  used to merge the reads from several sorted BAMs into one position ordered stream.
+*/
+int BamMerge_isBefore(bam1_t **reads, int fileA, int fileB) {
+  if (reads[fileA]->core.pos != reads[fileB]->core.pos) {
+    return reads[fileA]->core.pos < reads[fileB]->core.pos;
+  }
+  return fileA < fileB;
+}
+
+void BamMerge_siftDown(int *heap, int nHeap, bam1_t **reads, int ind) {
+  while (1) {
+    int smallest = ind;
+    int left = 2*ind + 1;
+    int right = left + 1;
+
+    if (left < nHeap && BamMerge_isBefore(reads, heap[left], heap[smallest])) {
+      smallest = left;
+    }
+    if (right < nHeap && BamMerge_isBefore(reads, heap[right], heap[smallest])) {
+      smallest = right;
+    }
+    if (smallest == ind) {
+      return;
+    }
+    int tmp = heap[ind];
+    heap[ind] = heap[smallest];
+    heap[smallest] = tmp;
+    ind = smallest;
+  }
+}
+
+void BamMerge_push(int *heap, int *nHeap, bam1_t **reads, int fileNum) {
+  int ind = (*nHeap)++;
+
+  heap[ind] = fileNum;
+  while (ind > 0) {
+    int parent = (ind - 1) / 2;
+    if (!BamMerge_isBefore(reads, heap[ind], heap[parent])) {
+      break;
+    }
+    int tmp = heap[ind];
+    heap[ind] = heap[parent];
+    heap[parent] = tmp;
+    ind = parent;
+  }
+}
+
+/*
+  The header's counts are used as array bounds, so check each one against the
+  bytes left in the file (dividing rather than multiplying, so huge counts
+  can't overflow), and that the extra exons' coords all lie in the coords
+  array. Returns 0 if they don't match a file of fileSize bytes.
+*/
+int JunctionIndex_checkCounts(JunctionIndexHeader *header, size_t fileSize) {
+  size_t remaining = fileSize - sizeof(JunctionIndexHeader);
+  int64_t i;
+
+  if (header->nJunction < 0 || header->nExtraExon < 0 || header->nExtraCoord < 0) {
+    return 0;
+  }
+
+  if ((uint64_t)header->nJunction > remaining / sizeof(Junction)) {
+    return 0;
+  }
+  remaining -= header->nJunction * sizeof(Junction);
+
+  if ((uint64_t)header->nExtraExon > remaining / sizeof(JunctionIndexExtraExon)) {
+    return 0;
+  }
+  remaining -= header->nExtraExon * sizeof(JunctionIndexExtraExon);
+
+  if ((uint64_t)header->nExtraCoord != remaining / sizeof(int64_t) || remaining % sizeof(int64_t)) {
+    return 0;
+  }
+
+  // Coords are copied into fixed size arrays in JunctionIndex_addExtraExons
+  JunctionIndexExtraExon *extraExons = (JunctionIndexExtraExon *)((Junction *)(header + 1) + header->nJunction);
+  for (i=0; i<header->nExtraExon; i++) {
+    if (extraExons[i].nCoord < 0 || extraExons[i].nCoord > JUNCTIONINDEX_MAXCOORD ||
+        extraExons[i].coordOffset < 0 || extraExons[i].coordOffset > header->nExtraCoord - extraExons[i].nCoord) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/*
+  Returns NULL if fileName doesn't exist or isn't a valid index for key
+*/
+JunctionIndex *JunctionIndex_open(char *fileName, uint64_t key, char *seqRegionName) {
+  JunctionIndex *ji;
+  struct stat st;
+  int fd;
+
+  if ((fd = open(fileName, O_RDONLY)) < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st) != 0 || st.st_size < sizeof(JunctionIndexHeader)) {
+    close(fd);
+    return NULL;
+  }
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+
+  JunctionIndexHeader *header = (JunctionIndexHeader *)map;
+
+  if (memcmp(header->magic, JUNCTIONINDEX_MAGIC, 8) || header->key != key) {
+    fprintf(stderr, "Junction index %s is not valid for these bam files - ignoring it\n", fileName);
+    munmap(map, st.st_size);
+    return NULL;
+  }
+
+  if (!JunctionIndex_checkCounts(header, st.st_size)) {
+    fprintf(stderr, "Junction index %s is corrupt (counts don't match its size) - ignoring it\n", fileName);
+    munmap(map, st.st_size);
+    return NULL;
+  }
+
+  if ((ji = (JunctionIndex *)calloc(1,sizeof(JunctionIndex))) == NULL) {
+    fprintf(stderr,"Failed allocating JunctionIndex\n");
+    exit(1);
+  }
+  StrUtil_copyString(&ji->seqRegionName, seqRegionName, 0);
+  ji->map         = map;
+  ji->mapLen      = st.st_size;
+  ji->header      = header;
+  ji->junctions   = (Junction *)(header + 1);
+  ji->extraExons  = (JunctionIndexExtraExon *)(ji->junctions + header->nJunction);
+  ji->extraCoords = (int64_t *)(ji->extraExons + header->nExtraExon);
+
+  return ji;
+}
+
+void JunctionIndex_close(JunctionIndex *ji) {
+  munmap(ji->map, ji->mapLen);
+  free(ji->seqRegionName);
+  free(ji);
+}
+
+/*
+  Returns a newly allocated array (which the caller frees) of the junctions
+  overlapping start to end, sorted on prevExonEnd
+*/
+Junction *JunctionIndex_fetchRange(JunctionIndex *ji, long start, long end, int *retNJunction) {
+  Junction *junctions;
+  int64_t nJunction = ji->header->nJunction;
+  int64_t lo = 0;
+  int64_t hi = nJunction;
+  int nFound = 0;
+
+  // First junction with prevExonEnd >= start - maxJunctionSpan
+  while (lo < hi) {
+    int64_t mid = (lo + hi) / 2;
+    if (ji->junctions[mid].prevExonEnd < start - ji->header->maxJunctionSpan) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  for (hi = lo; hi < nJunction && ji->junctions[hi].prevExonEnd <= end; hi++);
+
+  if ((junctions = (Junction *)calloc(hi - lo + 1, sizeof(Junction))) == NULL) {
+    fprintf(stderr,"Failed allocating junctions\n");
+    exit(1);
+  }
+  for (; lo < hi; lo++) {
+    if (ji->junctions[lo].nextExonStart >= start) {
+      junctions[nFound++] = ji->junctions[lo];
+    }
+  }
+
+  *retNJunction = nFound;
+  return junctions;
+}
+
+/*
+  Adds the extra exons overlapping start to end to extraExons, in the same form
+  as they're made from reads
+*/
+void JunctionIndex_addExtraExons(JunctionIndex *ji, long start, long end, StringHash *extraExons) {
+  int64_t nExtraExon = ji->header->nExtraExon;
+  int64_t lo = 0;
+  int64_t hi = nExtraExon;
+
+  while (lo < hi) {
+    int64_t mid = (lo + hi) / 2;
+    if (ji->extraExons[mid].start < start - ji->header->maxExtraExonSpan) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  for (; lo < nExtraExon && ji->extraExons[lo].start <= end; lo++) {
+    JunctionIndexExtraExon *jiee = &ji->extraExons[lo];
+    char keyString[JUNCTIONINDEX_MAXCOORD * 24];
+    long coords[JUNCTIONINDEX_MAXCOORD];
+    int keyLen = 0;
+    int i;
+
+    if (jiee->end < start) {
+      continue;
+    }
+
+    for (i=0; i<jiee->nCoord; i++) {
+      coords[i] = ji->extraCoords[jiee->coordOffset + i];
+      keyLen += sprintf(keyString+keyLen, "%ld:", coords[i]);
+    }
+
+    ExtraExonData *eed = StringHash_getValue(extraExons, keyString);
+    if (!eed) {
+      eed = ExtraExonData_new(coords, jiee->nCoord);
+      StringHash_add(extraExons, keyString, eed);
+    }
+    eed->score += jiee->score;
+  }
+}
+
 ModelCluster *ModelCluster_new() {
   ModelCluster *mc;
 
@@ -356,7 +740,10 @@ void SetFuncData_free(SetFuncData *sfd) {
 
 
 
+// Tests build this file with RSG_NO_DRIVER so they can call its functions without main
+#ifndef RSG_NO_DRIVER
 #define RSG_DRIVER
+#endif
 #ifdef RSG_DRIVER
 
 void RefineSolexaGenes_usage() {
@@ -366,8 +753,13 @@ void RefineSolexaGenes_usage() {
          "  -l --logic_name  Logic name for analysis block to run from configuration file\n"
          "  -d --dry_run     If specified, don't write to output db\n"
          "  -u --ucsc_naming If specified, add chr the name of sequence\n"
-         "  -t --threads     Number of threads to use when reading the BAM files, default is 1\n"
+         "  -t --threads     Number of threads to use when reading the BAM files and refining genes, default is 1\n"
          "  -v --verbosity   Verbosity level (int)\n"
+         "  -q --queue_file  Whole genome mode: work through all the toplevel sequence using this work queue file.\n"
+         "                   If the file doesn't exist it is created, otherwise the run resumes from where it stopped.\n"
+         "                   The input id is ignored in this mode\n"
+         "  -s --unit_size   Approximate length of the work units made for a new work queue, default is 5000000\n"
+         "  -p --unit_pad    Extra sequence fetched either side of each work unit, default is 100000\n"
          "\n"
 //         "Notes:\n"
 //         "  -v Default verbosity level is 1. You can make it quieter by setting this to 0, or noisier by setting it > 1.\n"
@@ -398,6 +790,9 @@ int main(int argc, char *argv[]) {
   int   threads  = 1;
   int   verbosity  = 1;
   int   ucsc_naming = 0;
+  char *queueFile  = NULL;
+  long  unitSize   = 5000000;
+  long  unitPad    = 100000;
 
   int argNum = 1;
   while (argNum < argc) {
@@ -429,6 +824,12 @@ int main(int argc, char *argv[]) {
         threads = atoi(val);
       } else if (!strcmp(arg, "-v") || !strcmp(arg,"--verbosity")) {
         verbosity = atoi(val);
+      } else if (!strcmp(arg, "-q") || !strcmp(arg,"--queue_file")) {
+        StrUtil_copyString(&queueFile,val,0);
+      } else if (!strcmp(arg, "-s") || !strcmp(arg,"--unit_size")) {
+        unitSize = atol(val);
+      } else if (!strcmp(arg, "-p") || !strcmp(arg,"--unit_pad")) {
+        unitPad = atol(val);
       } else {
         fprintf(stderr,"Error in command line at %s\n\n",arg);
         RefineSolexaGenes_usage();
@@ -457,7 +858,6 @@ int main(int argc, char *argv[]) {
 //  double consLims[]    = { 5.0 };
 //  double nonConsLims[] = { 5.0 };
 
-  Vector *consLims = RefineSolexaGenes_getConsLims(rsg);
   Vector *nonConsLims = RefineSolexaGenes_getNonConsLims(rsg);
   double restartNonConsLim = RefineSolexaGenes_getRestartNonConsLim(rsg);
 
@@ -475,12 +875,53 @@ int main(int argc, char *argv[]) {
       fprintf(stderr, "Error: Didn't find restartNonConsLim %lf in nonConsLims\n",restartNonConsLim);
       exit(1);
     }
-// Don't write introns on a restart - they should already have been written
-    RefineSolexaGenes_setWriteIntrons(rsg, 0);
   }
   
 
-  //Vector *outputSets = Vector_new();
+  if (queueFile != NULL) {
+    RefineSolexaGenes_runWorkQueue(rsg, queueFile, unitSize, unitPad, logicName, restartNonConsLim);
+  } else {
+    RefineSolexaGenes_runInputId(rsg, logicName, restartNonConsLim);
+  }
+
+  RefineSolexaGenes_closeIntronBams(rsg);
+
+/*
+  for (i=0;i<Vector_getNumElement(outputSets); i++) {
+    Vector *set = Vector_getElementAt(outputSets, i);
+    if (set != NULL) {
+      //dumpGenes(set, 1);
+    } else {
+      fprintf(stderr,"Empty output set\n");
+    }
+  }
+  //EcoString_getInfo(ecoSTable);
+*/
+  tc_malloc_stats();
+  return 0;
+}
+#endif
+
+/*
+  Runs all the consLim and nonConsLim combinations on the current input id, writing
+  the output for each unless it's a dry run. The type names are made from the
+  configured ones each time so it can be called for more than one input id.
+*/
+void RefineSolexaGenes_runInputId(RefineSolexaGenes *rsg, char *logicName, double restartNonConsLim) {
+  Vector *consLims = RefineSolexaGenes_getConsLims(rsg);
+  Vector *nonConsLims = RefineSolexaGenes_getNonConsLims(rsg);
+  int verbosity = RefineSolexaGenes_getVerbosity(rsg);
+  int writeIntrons = RefineSolexaGenes_writeIntrons(rsg);
+  char *bestScoreType = NULL;
+  char *singleExonModelType = NULL;
+
+  StrUtil_copyString(&bestScoreType, RefineSolexaGenes_getBestScoreType(rsg), 0);
+  StrUtil_copyString(&singleExonModelType, RefineSolexaGenes_getSingleExonModelType(rsg), 0);
+
+  // Don't write introns on a restart - they should already have been written
+  if (restartNonConsLim > -0.1) {
+    RefineSolexaGenes_setWriteIntrons(rsg, 0);
+  }
 
   int i;
   for (i=0; i<Vector_getNumElement(consLims); i++) {
@@ -500,13 +941,13 @@ int main(int argc, char *argv[]) {
       char typeName[1024];
       char *typePref = RefineSolexaGenes_getTypePrefix(rsg);
 
-      sprintf(typeName, "%s_%sc%d_nc%d", RefineSolexaGenes_getBestScoreType(rsg), typePref, (int)consLim, (int)nonConsLim);
+      sprintf(typeName, "%s_%sc%d_nc%d", bestScoreType, typePref, (int)consLim, (int)nonConsLim);
       RefineSolexaGenes_setBestScoreType(rsg, typeName);
 
-      sprintf(typeName, "%s_%sc%d_nc%d", RefineSolexaGenes_getSingleExonModelType(rsg), typePref, (int)consLim, (int)nonConsLim);
+      sprintf(typeName, "%s_%sc%d_nc%d", singleExonModelType, typePref, (int)consLim, (int)nonConsLim);
       RefineSolexaGenes_setSingleExonModelType(rsg, typeName);
 
-      sprintf(typeName, "%s_%sc%d_nc%d", logicName, typePref, (int)consLim, (int)nonConsLim);
+      RefineSolexaGenes_makeOutputLogicName(rsg, typeName, logicName, consLim, nonConsLim);
       RefineSolexaGenes_setAnalysis(rsg, RefineSolexaGenes_createAnalysisObject(rsg, typeName));
 
       RefineSolexaGenes_fetchInput(rsg);
@@ -529,6 +970,7 @@ int main(int argc, char *argv[]) {
         tc_malloc_stats();
         ProcUtil_timeInfo("end of loop iter");
         if (verbosity > 0) fprintf(stderr,"Number of exon clone calls = %d\n",nExonClone);
+        if (verbosity > 0) DBAdaptor_printCacheStats(RefineSolexaGenes_getDb(rsg), stderr);
 
         // HACK HACK HACK
         // For now only write introns for first iteration by setting WriteIntrons to 0 after it.
@@ -561,69 +1003,493 @@ int main(int argc, char *argv[]) {
     }
   }
 
+
+  RefineSolexaGenes_setBestScoreType(rsg, bestScoreType);
+  RefineSolexaGenes_setSingleExonModelType(rsg, singleExonModelType);
+  RefineSolexaGenes_setWriteIntrons(rsg, writeIntrons);
+
+  free(bestScoreType);
+  free(singleExonModelType);
+}
+
 /*
-  for (i=0;i<Vector_getNumElement(outputSets); i++) {
-    Vector *set = Vector_getElementAt(outputSets, i);
-    if (set != NULL) {
-      //dumpGenes(set, 1);
-    } else {
-      fprintf(stderr,"Empty output set\n");
-    }
-  }
-  //EcoString_getInfo(ecoSTable);
+  The analysis logic name genes (and introns) are written with for one pair of
+  consLim and nonConsLim values
 */
-  tc_malloc_stats();
-  return 0;
+void RefineSolexaGenes_makeOutputLogicName(RefineSolexaGenes *rsg, char *typeName, char *logicName, double consLim, double nonConsLim) {
+  sprintf(typeName, "%s_%sc%d_nc%d", logicName, RefineSolexaGenes_getTypePrefix(rsg), (int)consLim, (int)nonConsLim);
 }
-#endif
 
-void RefineSolexaGenes_dumpOutput(RefineSolexaGenes *rsg) {
-  Vector *output = RefineSolexaGenes_getOutput(rsg);
+/*
+  Frees the per input id data (prelim genes, intron features and extra exons,
+  with the sorted arrays cached from the extra exons hash) so the next input id
+  fetches its own. Everything else (config, db adaptors, open BAM files,
+  chromosome slice and sequence cache) is kept.
+*/
+void RefineSolexaGenes_clearInput(RefineSolexaGenes *rsg) {
+  if (rsg->prelimGenes) {
+    Vector_setFreeFunc(rsg->prelimGenes, Gene_free);
+    Vector_free(rsg->prelimGenes);
+    rsg->prelimGenes = NULL;
+  }
 
-  Vector_sort(output, SeqFeature_startCompFunc);
+  if (rsg->intronFeatures) {
+    Vector_setFreeFunc(rsg->intronFeatures, DNAAlignFeature_freeImpl);
+    Vector_free(rsg->intronFeatures);
+    rsg->intronFeatures = NULL;
+  }
+
+  // The cached keys and values are sized for the old hash, so must go with it
+  if (rsg->extraExonsKeys) {
+    free(rsg->extraExonsKeys);
+    rsg->extraExonsKeys = NULL;
+  }
+  if (rsg->extraExonsValues) {
+    free(rsg->extraExonsValues);
+    rsg->extraExonsValues = NULL;
+  }
+  if (rsg->extraExons) {
+    StringHash_free(rsg->extraExons, ExtraExonData_free);
+    rsg->extraExons = NULL;
+  }
+}
 
+void RefineSolexaGenes_closeIntronBams(RefineSolexaGenes *rsg) {
+  Vector *intronBamFiles = RefineSolexaGenes_getIntronBamFiles(rsg);
   int i;
-  for (i=0;i<Vector_getNumElement(output);i++) {
-    Gene *gene = Vector_getElementAt(output, i);
-    fprintf(stderr, "Gene\t%ld\t%ld\t%d\n", Gene_getStart(gene), Gene_getEnd(gene), Gene_getStrand(gene));
-    int j;
-    for (j=0; j<Gene_getTranscriptCount(gene); j++) {
-      Transcript *trans = Gene_getTranscriptAt(gene, j);
-      fprintf(stderr, "Transcript\t%ld\t%ld\t%d\n", Transcript_getStart(trans), Transcript_getEnd(trans), Transcript_getStrand(trans));
-      int k;
-      for (k=0;k<Transcript_getExonCount(trans);k++) {
-        Exon *exon = Transcript_getExonAt(trans, k);
-        fprintf(stderr, "Exon\t%ld\t%ld\t%d\n", Exon_getStart(exon), Exon_getEnd(exon), Exon_getStrand(exon));
-      }
-    }
-    fprintf(stderr,"\n");
+
+  for (i=0; intronBamFiles && i<Vector_getNumElement(intronBamFiles); i++) {
+    IntronBamConfig_closeBam(Vector_getElementAt(intronBamFiles, i));
+  }
+
+  if (rsg->junctionIndex != NULL) {
+    JunctionIndex_close(rsg->junctionIndex);
+    rsg->junctionIndex = NULL;
   }
 }
 
-void RefineSolexaGenes_initSetFuncs(RefineSolexaGenes *rsg) {
-  rsg->funcHash = StringHash_new(STRINGHASH_SMALL);
+WorkUnit *WorkUnit_new(int unitNum, char *inputId, long coreStart, long coreEnd) {
+  WorkUnit *unit;
 
-  StringHash_add(rsg->funcHash, "OUTPUT_DB", SetFuncData_new(RefineSolexaGenes_setOutputDb, CONFIG_TYPE_STRING));
-  StringHash_add(rsg->funcHash, "INTRON_DB", SetFuncData_new(RefineSolexaGenes_setIntronDb, CONFIG_TYPE_STRING));
-  StringHash_add(rsg->funcHash, "MODEL_DB", SetFuncData_new(RefineSolexaGenes_setModelDb, CONFIG_TYPE_STRING));
-  StringHash_add(rsg->funcHash, "WRITE_INTRONS", SetFuncData_new(RefineSolexaGenes_setWriteIntrons, CONFIG_TYPE_INT));
-  StringHash_add(rsg->funcHash, "MAX_RECURSIONS", SetFuncData_new(RefineSolexaGenes_setMaxRecursions, CONFIG_TYPE_INT));
+  if ((unit = (WorkUnit *)calloc(1,sizeof(WorkUnit))) == NULL) {
+    fprintf(stderr,"Failed allocating WorkUnit\n");
+    exit(1);
+  }
+  unit->unitNum   = unitNum;
+  StrUtil_copyString(&unit->inputId, inputId, 0);
+  unit->coreStart = coreStart;
+  unit->coreEnd   = coreEnd;
 
-  SetFuncData *logicNameFuncData = SetFuncData_new(RefineSolexaGenes_setLogicNames, CONFIG_TYPE_ARRAY);
-  logicNameFuncData->subType = CONFIG_TYPE_STRING;
-  StringHash_add(rsg->funcHash, "LOGICNAME", logicNameFuncData);
-  
-  SetFuncData *intronBamFilesFuncData = SetFuncData_new(RefineSolexaGenes_setIntronBamFiles, CONFIG_TYPE_LIST);
-  intronBamFilesFuncData->subType = CONFIG_TYPE_GROUP;
-  intronBamFilesFuncData->subFunc = RefineSolexaGenes_parseIntronBamFilesConfig;
-  StringHash_add(rsg->funcHash, "INTRON_BAM_FILES", intronBamFilesFuncData);
+  return unit;
+}
 
-  StringHash_add(rsg->funcHash, "MODEL_LN", SetFuncData_new(RefineSolexaGenes_setModelLogicName, CONFIG_TYPE_STRING));
-  StringHash_add(rsg->funcHash, "RETAINED_INTRON_PENALTY", SetFuncData_new(RefineSolexaGenes_setRetainedIntronPenalty, CONFIG_TYPE_FLOAT));
-  StringHash_add(rsg->funcHash, "MIN_INTRON_SIZE", SetFuncData_new(RefineSolexaGenes_setMinIntronSize, CONFIG_TYPE_INT));
-  StringHash_add(rsg->funcHash, "MAX_INTRON_SIZE", SetFuncData_new(RefineSolexaGenes_setMaxIntronSize, CONFIG_TYPE_INT));
-  StringHash_add(rsg->funcHash, "SINGLE_EXON_MODEL", SetFuncData_new(RefineSolexaGenes_setSingleExonModelType, CONFIG_TYPE_STRING));
-  StringHash_add(rsg->funcHash, "MIN_SINGLE_EXON", SetFuncData_new(RefineSolexaGenes_setMinSingleExonLength, CONFIG_TYPE_INT));
+void WorkUnit_free(WorkUnit *unit) {
+  free(unit->inputId);
+  free(unit);
+}
+
+/*
+  Splits all the toplevel sequence into work units of roughly unitSize. Units are
+  only cut in the gaps between clusters of overlapping prelim genes (cutting half
+  way across the gap), so no gene is split between units. Each unit's slice is padded
+  by unitPad either side so introns near the edges are seen, but only genes starting
+  in the unit's core are refined by it. Seq regions with no prelim genes are skipped.
+*/
+Vector *RefineSolexaGenes_makeWorkUnits(RefineSolexaGenes *rsg, long unitSize, long unitPad) {
+  Vector *units = Vector_new();
+  int verbosity = RefineSolexaGenes_getVerbosity(rsg);
+  char *modelLogicName = RefineSolexaGenes_getModelLogicName(rsg);
+
+  SliceAdaptor *sa = DBAdaptor_getSliceAdaptor(BaseGeneBuild_getDbAdaptor(rsg, "REFERENCE_DB", 0, 0));
+  SliceAdaptor *geneSliceAdaptor = DBAdaptor_getSliceAdaptor(BaseGeneBuild_getDbAdaptor(rsg, RefineSolexaGenes_getModelDb(rsg), 0, 0));
+
+  Vector *regions = SliceAdaptor_fetchAll(sa, "toplevel", NULL, 0);
+
+  int i;
+  for (i=0; i<Vector_getNumElement(regions); i++) {
+    Slice *region = Vector_getElementAt(regions, i);
+    char *regionName = Slice_getSeqRegionName(region);
+    long regionLength = Slice_getSeqRegionLength(region);
+
+    Slice *geneSlice = SliceAdaptor_fetchByRegion(geneSliceAdaptor, "toplevel", regionName, POS_UNDEF, POS_UNDEF, 1, NULL, 0);
+    if (geneSlice == NULL) {
+      continue;
+    }
+
+    Vector *genes = Slice_getAllGenes(geneSlice, modelLogicName, NULL, 0, NULL, NULL);
+    if (Vector_getNumElement(genes) == 0) {
+      Vector_free(genes);
+      continue;
+    }
+    Vector_sort(genes, SeqFeature_startCompFunc);
+
+    // Gene slice is the whole seq region, so gene coords are seq region coords
+    Vector *cuts = Vector_new();
+    Vector_setFreeFunc(cuts, free);
+
+    long unitStart = 1;
+    long clusterEnd = Gene_getEnd((Gene *)Vector_getElementAt(genes, 0));
+    int j;
+    for (j=1; j<Vector_getNumElement(genes); j++) {
+      Gene *gene = Vector_getElementAt(genes, j);
+
+      if (Gene_getStart(gene) > clusterEnd && clusterEnd - unitStart + 1 >= unitSize) {
+        long cut = clusterEnd + (Gene_getStart(gene) - clusterEnd) / 2;
+        Vector_addElement(cuts, long_new(cut));
+        unitStart = cut + 1;
+      }
+      if (Gene_getEnd(gene) > clusterEnd) {
+        clusterEnd = Gene_getEnd(gene);
+      }
+    }
+    Vector_addElement(cuts, long_new(regionLength));
+    Vector_free(genes);
+
+    long coreStart = 1;
+    for (j=0; j<Vector_getNumElement(cuts); j++) {
+      long coreEnd = *((long *)Vector_getElementAt(cuts, j));
+      long padStart = coreStart - unitPad > 1 ? coreStart - unitPad : 1;
+      long padEnd = coreEnd + unitPad < regionLength ? coreEnd + unitPad : regionLength;
+
+      Slice *unitSlice = SliceAdaptor_fetchByRegion(sa, "toplevel", regionName, padStart, padEnd, 1, NULL, 0);
+      Vector_addElement(units, WorkUnit_new(Vector_getNumElement(units), Slice_getName(unitSlice), coreStart, coreEnd));
+
+      coreStart = coreEnd + 1;
+    }
+    Vector_free(cuts);
+
+    if (verbosity > 0) fprintf(stderr, "Made work units for %s - now have %d units\n", regionName, Vector_getNumElement(units));
+  }
+  Vector_free(regions);
+
+  return units;
+}
+
+/*
+  The work queue file has one tab separated line per unit:
+    unitNum inputId coreStart coreEnd
+  Written to a temporary file which is renamed into place, so a crash while
+  making the queue doesn't leave a partial one to resume from.
+*/
+void RefineSolexaGenes_writeWorkQueue(char *queueFile, Vector *units) {
+  char tmpFile[FILENAME_MAX];
+  FILE *fp;
+  int i;
+
+  sprintf(tmpFile, "%s.tmp", queueFile);
+
+  if ((fp = fopen(tmpFile, "w")) == NULL) {
+    fprintf(stderr, "Error: Failed opening work queue file %s for writing\n", tmpFile);
+    exit(1);
+  }
+
+  for (i=0; i<Vector_getNumElement(units); i++) {
+    WorkUnit *unit = Vector_getElementAt(units, i);
+    fprintf(fp, "%d\t%s\t%ld\t%ld\n", unit->unitNum, unit->inputId, unit->coreStart, unit->coreEnd);
+  }
+
+  if (fflush(fp) != 0 || fsync(fileno(fp)) != 0 || fclose(fp) != 0) {
+    fprintf(stderr, "Error: Failed writing work queue file %s\n", tmpFile);
+    exit(1);
+  }
+
+  if (rename(tmpFile, queueFile) != 0) {
+    fprintf(stderr, "Error: Failed renaming %s to %s\n", tmpFile, queueFile);
+    exit(1);
+  }
+}
+
+Vector *RefineSolexaGenes_readWorkQueue(char *queueFile) {
+  Vector *units = Vector_new();
+  char line[4096];
+  char inputId[4096];
+  FILE *fp;
+
+  if ((fp = fopen(queueFile, "r")) == NULL) {
+    fprintf(stderr, "Error: Failed opening work queue file %s\n", queueFile);
+    exit(1);
+  }
+
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    int unitNum;
+    long coreStart;
+    long coreEnd;
+
+    if (sscanf(line, "%d\t%s\t%ld\t%ld", &unitNum, inputId, &coreStart, &coreEnd) != 4 ||
+        unitNum != Vector_getNumElement(units)) {
+      fprintf(stderr, "Error: Invalid line in work queue file %s: %s\n", queueFile, line);
+      exit(1);
+    }
+    Vector_addElement(units, WorkUnit_new(unitNum, inputId, coreStart, coreEnd));
+  }
+  fclose(fp);
+
+  return units;
+}
+
+/*
+  Reads a file of unit numbers, one per line (the queue's done and started files),
+  setting flags[unitNum] for each. Returns the number of distinct units read.
+*/
+int RefineSolexaGenes_readUnitNumFile(char *fileName, char *flags, int nUnit) {
+  char line[1024];
+  FILE *fp;
+  int nRead = 0;
+
+  if ((fp = fopen(fileName, "r")) != NULL) {
+    while (fgets(line, sizeof(line), fp) != NULL) {
+      int unitNum = atoi(line);
+      if (unitNum >= 0 && unitNum < nUnit && !flags[unitNum]) {
+        flags[unitNum] = 1;
+        nRead++;
+      }
+    }
+    fclose(fp);
+  }
+
+  return nRead;
+}
+
+void RefineSolexaGenes_appendUnitNum(FILE *fp, char *fileName, int unitNum) {
+  fprintf(fp, "%d\n", unitNum);
+  if (fflush(fp) != 0 || fsync(fileno(fp)) != 0) {
+    fprintf(stderr, "Error: Failed writing to work queue file %s\n", fileName);
+    exit(1);
+  }
+}
+
+/*
+  Removes whatever a previous, interrupted, run of unit wrote to the output db,
+  so running it again doesn't store its genes and introns twice. Genes are
+  stored by the unit which has their prelim gene's start in its core, and units
+  are cut half way across gaps between prelim gene clusters, so the unit's genes
+  are the ones with the unit's analyses starting in its core. Introns are stored
+  by start (+1 as written) in the same way, with the first analysis run.
+  Only the analyses which runInputId will write with the same arguments are
+  cleared.
+*/
+void RefineSolexaGenes_deleteUnitOutput(RefineSolexaGenes *rsg, WorkUnit *unit, char *logicName, double restartNonConsLim) {
+  DBAdaptor *outdb = BaseGeneBuild_getDbAdaptor(rsg, RefineSolexaGenes_getOutputDb(rsg), 0, 0);
+  Vector *consLims = RefineSolexaGenes_getConsLims(rsg);
+  Vector *nonConsLims = RefineSolexaGenes_getNonConsLims(rsg);
+  SliceAdaptor *sa = DBAdaptor_getSliceAdaptor(outdb);
+  char qStr[4096];
+  char typeName[1024];
+  int doIntrons = RefineSolexaGenes_writeIntrons(rsg) && restartNonConsLim < -0.1;
+  unsigned long long nGeneRow = 0;
+  unsigned long long nIntron = 0;
+  int i;
+
+  Slice *unitSlice = SliceAdaptor_fetchByName(sa, unit->inputId);
+  if (unitSlice == NULL) {
+    fprintf(stderr, "Error: Failed fetching slice %s from output db to clear work unit %d\n", unit->inputId, unit->unitNum);
+    exit(1);
+  }
+  IDType seqRegionId = SliceAdaptor_getSeqRegionId(sa, unitSlice);
+
+  for (i=0; i<Vector_getNumElement(consLims); i++) {
+    double consLim = *(double *)Vector_getElementAt(consLims,i);
+    int j;
+    for (j=0; j<Vector_getNumElement(nonConsLims); j++) {
+      double nonConsLim = *(double *)Vector_getElementAt(nonConsLims, j);
+      unsigned long long nAffected = 0;
+
+      // Same skip as in runInputId
+      if (restartNonConsLim > -0.1 && i==0 && restartNonConsLim != nonConsLim) {
+        continue;
+      }
+
+      RefineSolexaGenes_makeOutputLogicName(rsg, typeName, logicName, consLim, nonConsLim);
+
+      AnalysisAdaptor *aa = DBAdaptor_getAnalysisAdaptor(outdb);
+      Analysis *analysis = AnalysisAdaptor_fetchByLogicName(aa, typeName);
+      if (analysis == NULL) {
+        // Nothing has been written with it
+        doIntrons = 0;
+        continue;
+      }
+      IDType analysisId = Analysis_getDbID(analysis);
+
+      // One multi table delete so the gene and everything stored with it goes together
+      sprintf(qStr, "DELETE g, t, tl, et, e, sf, edaf, tsf, tdaf, tise"
+                    " FROM gene g"
+                    " JOIN transcript t ON t.gene_id = g.gene_id"
+                    " LEFT JOIN translation tl ON tl.transcript_id = t.transcript_id"
+                    " LEFT JOIN exon_transcript et ON et.transcript_id = t.transcript_id"
+                    " LEFT JOIN exon e ON e.exon_id = et.exon_id"
+                    " LEFT JOIN supporting_feature sf ON sf.exon_id = e.exon_id"
+                    " LEFT JOIN dna_align_feature edaf ON sf.feature_type = 'dna_align_feature' AND edaf.dna_align_feature_id = sf.feature_id"
+                    " LEFT JOIN transcript_supporting_feature tsf ON tsf.transcript_id = t.transcript_id"
+                    " LEFT JOIN dna_align_feature tdaf ON tsf.feature_type = 'dna_align_feature' AND tdaf.dna_align_feature_id = tsf.feature_id"
+                    " LEFT JOIN transcript_intron_supporting_evidence tise ON tise.transcript_id = t.transcript_id"
+                    " WHERE g.analysis_id = "IDFMTSTR" AND g.seq_region_id = "IDFMTSTR
+                    " AND g.seq_region_start BETWEEN %ld AND %ld",
+              analysisId, seqRegionId, unit->coreStart, unit->coreEnd);
+      if (!DBConnection_do(outdb->dbc, qStr, strlen(qStr), &nAffected)) {
+        fprintf(stderr, "Error: Failed clearing genes for work unit %d\n", unit->unitNum);
+        exit(1);
+      }
+      nGeneRow += nAffected;
+
+      if (doIntrons) {
+        sprintf(qStr, "DELETE FROM dna_align_feature WHERE analysis_id = "IDFMTSTR" AND seq_region_id = "IDFMTSTR
+                      " AND seq_region_start BETWEEN %ld AND %ld",
+                analysisId, seqRegionId, unit->coreStart + 1, unit->coreEnd + 1);
+        if (!DBConnection_do(outdb->dbc, qStr, strlen(qStr), &nIntron)) {
+          fprintf(stderr, "Error: Failed clearing introns for work unit %d\n", unit->unitNum);
+          exit(1);
+        }
+        // Introns are only written with the first analysis
+        doIntrons = 0;
+      }
+    }
+  }
+
+  fprintf(stderr, "Cleared %llu gene model rows and %llu introns left by interrupted work unit %d\n", nGeneRow, nIntron, unit->unitNum);
+}
+
+/*
+  Whole genome mode. Runs every unit in the work queue file which isn't already
+  listed in the queue's done file (queueFile.done), making the queue first if it
+  doesn't exist. Units are marked done once their output has been written, so a
+  run which stops part way through can be restarted with the same command and will
+  carry on from the unit it was on. Units are also listed in queueFile.started
+  before they run, and a started unit which isn't done has whatever it wrote
+  removed before it is run again from its start.
+
+  Config, db connections, BAM files and indexes, and the chromosome slice and its
+  sequence are all kept from one unit to the next.
+*/
+void RefineSolexaGenes_runWorkQueue(RefineSolexaGenes *rsg, char *queueFile, long unitSize, long unitPad, char *logicName, double restartNonConsLim) {
+  char doneFile[FILENAME_MAX];
+  char startedFile[FILENAME_MAX];
+  Vector *units;
+  char *isDone;
+  char *isStarted;
+  FILE *doneFp;
+  FILE *startedFp;
+  int nDone;
+  int i;
+
+  if (access(queueFile, F_OK) == 0) {
+    units = RefineSolexaGenes_readWorkQueue(queueFile);
+    fprintf(stderr, "Resuming work queue %s with %d units\n", queueFile, Vector_getNumElement(units));
+  } else {
+    units = RefineSolexaGenes_makeWorkUnits(rsg, unitSize, unitPad);
+    RefineSolexaGenes_writeWorkQueue(queueFile, units);
+    fprintf(stderr, "Made work queue %s with %d units\n", queueFile, Vector_getNumElement(units));
+  }
+  Vector_setFreeFunc(units, WorkUnit_free);
+
+  if ((isDone = (char *)calloc(Vector_getNumElement(units)+1, sizeof(char))) == NULL ||
+      (isStarted = (char *)calloc(Vector_getNumElement(units)+1, sizeof(char))) == NULL) {
+    fprintf(stderr, "Failed allocating isDone\n");
+    exit(1);
+  }
+
+  sprintf(doneFile, "%s.done", queueFile);
+  sprintf(startedFile, "%s.started", queueFile);
+  nDone = RefineSolexaGenes_readUnitNumFile(doneFile, isDone, Vector_getNumElement(units));
+  RefineSolexaGenes_readUnitNumFile(startedFile, isStarted, Vector_getNumElement(units));
+  fprintf(stderr, "%d of %d work units already done\n", nDone, Vector_getNumElement(units));
+
+  if ((doneFp = fopen(doneFile, "a")) == NULL) {
+    fprintf(stderr, "Error: Failed opening work queue done file %s\n", doneFile);
+    exit(1);
+  }
+  if ((startedFp = fopen(startedFile, "a")) == NULL) {
+    fprintf(stderr, "Error: Failed opening work queue started file %s\n", startedFile);
+    exit(1);
+  }
+
+  for (i=0; i<Vector_getNumElement(units); i++) {
+    WorkUnit *unit = Vector_getElementAt(units, i);
+
+    if (isDone[unit->unitNum]) {
+      continue;
+    }
+
+    fprintf(stderr, "Starting work unit %d: %s core %ld - %ld\n", unit->unitNum, unit->inputId, unit->coreStart, unit->coreEnd);
+
+    if (isStarted[unit->unitNum]) {
+      if (!RefineSolexaGenes_isDryRun(rsg)) {
+        RefineSolexaGenes_deleteUnitOutput(rsg, unit, logicName, restartNonConsLim);
+      }
+    } else {
+      RefineSolexaGenes_appendUnitNum(startedFp, startedFile, unit->unitNum);
+    }
+
+    RefineSolexaGenes_setInputId(rsg, unit->inputId);
+    rsg->coreStart = unit->coreStart;
+    rsg->coreEnd   = unit->coreEnd;
+
+    RefineSolexaGenes_runInputId(rsg, logicName, restartNonConsLim);
+    RefineSolexaGenes_clearInput(rsg);
+
+    // A restart only applies to the unit which was interrupted
+    restartNonConsLim = -1.0;
+
+    RefineSolexaGenes_appendUnitNum(doneFp, doneFile, unit->unitNum);
+  }
+  fclose(doneFp);
+  fclose(startedFp);
+
+  rsg->coreStart = 0;
+  rsg->coreEnd   = 0;
+
+  free(isDone);
+  free(isStarted);
+  Vector_free(units);
+}
+
+void RefineSolexaGenes_dumpOutput(RefineSolexaGenes *rsg) {
+  Vector *output = RefineSolexaGenes_getOutput(rsg);
+
+  Vector_sort(output, SeqFeature_startCompFunc);
+
+  int i;
+  for (i=0;i<Vector_getNumElement(output);i++) {
+    Gene *gene = Vector_getElementAt(output, i);
+    fprintf(stderr, "Gene\t%ld\t%ld\t%d\n", Gene_getStart(gene), Gene_getEnd(gene), Gene_getStrand(gene));
+    int j;
+    for (j=0; j<Gene_getTranscriptCount(gene); j++) {
+      Transcript *trans = Gene_getTranscriptAt(gene, j);
+      fprintf(stderr, "Transcript\t%ld\t%ld\t%d\n", Transcript_getStart(trans), Transcript_getEnd(trans), Transcript_getStrand(trans));
+      int k;
+      for (k=0;k<Transcript_getExonCount(trans);k++) {
+        Exon *exon = Transcript_getExonAt(trans, k);
+        fprintf(stderr, "Exon\t%ld\t%ld\t%d\n", Exon_getStart(exon), Exon_getEnd(exon), Exon_getStrand(exon));
+      }
+    }
+    fprintf(stderr,"\n");
+  }
+}
+
+void RefineSolexaGenes_initSetFuncs(RefineSolexaGenes *rsg) {
+  rsg->funcHash = StringHash_new(STRINGHASH_SMALL);
+
+  StringHash_add(rsg->funcHash, "OUTPUT_DB", SetFuncData_new(RefineSolexaGenes_setOutputDb, CONFIG_TYPE_STRING));
+  StringHash_add(rsg->funcHash, "INTRON_DB", SetFuncData_new(RefineSolexaGenes_setIntronDb, CONFIG_TYPE_STRING));
+  StringHash_add(rsg->funcHash, "MODEL_DB", SetFuncData_new(RefineSolexaGenes_setModelDb, CONFIG_TYPE_STRING));
+  StringHash_add(rsg->funcHash, "WRITE_INTRONS", SetFuncData_new(RefineSolexaGenes_setWriteIntrons, CONFIG_TYPE_INT));
+  StringHash_add(rsg->funcHash, "MAX_RECURSIONS", SetFuncData_new(RefineSolexaGenes_setMaxRecursions, CONFIG_TYPE_INT));
+  StringHash_add(rsg->funcHash, "TOP_PATHS", SetFuncData_new(RefineSolexaGenes_setTopPaths, CONFIG_TYPE_INT));
+
+  SetFuncData *logicNameFuncData = SetFuncData_new(RefineSolexaGenes_setLogicNames, CONFIG_TYPE_ARRAY);
+  logicNameFuncData->subType = CONFIG_TYPE_STRING;
+  StringHash_add(rsg->funcHash, "LOGICNAME", logicNameFuncData);
+  
+  SetFuncData *intronBamFilesFuncData = SetFuncData_new(RefineSolexaGenes_setIntronBamFiles, CONFIG_TYPE_LIST);
+  intronBamFilesFuncData->subType = CONFIG_TYPE_GROUP;
+  intronBamFilesFuncData->subFunc = RefineSolexaGenes_parseIntronBamFilesConfig;
+  StringHash_add(rsg->funcHash, "INTRON_BAM_FILES", intronBamFilesFuncData);
+
+  StringHash_add(rsg->funcHash, "MODEL_LN", SetFuncData_new(RefineSolexaGenes_setModelLogicName, CONFIG_TYPE_STRING));
+  StringHash_add(rsg->funcHash, "RETAINED_INTRON_PENALTY", SetFuncData_new(RefineSolexaGenes_setRetainedIntronPenalty, CONFIG_TYPE_FLOAT));
+  StringHash_add(rsg->funcHash, "MIN_INTRON_SIZE", SetFuncData_new(RefineSolexaGenes_setMinIntronSize, CONFIG_TYPE_INT));
+  StringHash_add(rsg->funcHash, "MAX_INTRON_SIZE", SetFuncData_new(RefineSolexaGenes_setMaxIntronSize, CONFIG_TYPE_INT));
+  StringHash_add(rsg->funcHash, "SINGLE_EXON_MODEL", SetFuncData_new(RefineSolexaGenes_setSingleExonModelType, CONFIG_TYPE_STRING));
+  StringHash_add(rsg->funcHash, "MIN_SINGLE_EXON", SetFuncData_new(RefineSolexaGenes_setMinSingleExonLength, CONFIG_TYPE_INT));
   StringHash_add(rsg->funcHash, "SINGLE_EXON_CDS", SetFuncData_new(RefineSolexaGenes_setMinSingleExonCDSPercLength, CONFIG_TYPE_FLOAT));
   StringHash_add(rsg->funcHash, "STRICT_INTERNAL_SPLICE_SITES", SetFuncData_new(RefineSolexaGenes_setStrictInternalSpliceSites, CONFIG_TYPE_INT));
   StringHash_add(rsg->funcHash, "STRICT_INTERNAL_END_EXON_SPLICE_SITES", SetFuncData_new(RefineSolexaGenes_setStrictInternalEndSpliceSites, CONFIG_TYPE_INT));
@@ -639,6 +1505,7 @@ void RefineSolexaGenes_initSetFuncs(RefineSolexaGenes *rsg) {
   StringHash_add(rsg->funcHash, "MAX_5PRIME_LENGTH", SetFuncData_new(RefineSolexaGenes_setMax5PrimeLength, CONFIG_TYPE_INT));
   StringHash_add(rsg->funcHash, "REJECT_INTRON_CUTOFF", SetFuncData_new(RefineSolexaGenes_setRejectIntronCutoff, CONFIG_TYPE_FLOAT));
   StringHash_add(rsg->funcHash, "TYPE_PREFIX", SetFuncData_new(RefineSolexaGenes_setTypePrefix, CONFIG_TYPE_STRING));
+  StringHash_add(rsg->funcHash, "JUNCTION_INDEX_DIR", SetFuncData_new(RefineSolexaGenes_setJunctionIndexDir, CONFIG_TYPE_STRING));
 
   SetFuncData *consLimsFuncData = SetFuncData_new(RefineSolexaGenes_setConsLims, CONFIG_TYPE_ARRAY);
   consLimsFuncData->subType = CONFIG_TYPE_FLOAT;
@@ -657,6 +1524,7 @@ void RefineSolexaGenes_dumpConfig(RefineSolexaGenes *rsg) {
   fprintf(stderr, "MODEL_DB\t\t%s\n", RefineSolexaGenes_getModelDb(rsg));
   fprintf(stderr, "WRITE_INTRONS\t\t%d\n", RefineSolexaGenes_writeIntrons(rsg));
   fprintf(stderr, "MAX_RECURSIONS\t\t%d\n", RefineSolexaGenes_getMaxRecursions(rsg));
+  fprintf(stderr, "TOP_PATHS\t\t%d\n", RefineSolexaGenes_getTopPaths(rsg));
 
   fprintf(stderr,"LOGICNAME\t\t["); 
   Vector *logicNames = RefineSolexaGenes_getLogicNames(rsg);
@@ -713,6 +1581,7 @@ void RefineSolexaGenes_dumpConfig(RefineSolexaGenes *rsg) {
   fprintf(stderr, "MAX_5PRIME_LENGTH\t\t%d\n", RefineSolexaGenes_getMax5PrimeLength(rsg));
   fprintf(stderr, "REJECT_INTRON_CUTOFF\t\t%lf\n", RefineSolexaGenes_getRejectIntronCutoff(rsg));
   fprintf(stderr, "TYPE_PREFIX\t\t%s\n", RefineSolexaGenes_getTypePrefix(rsg));
+  fprintf(stderr, "JUNCTION_INDEX_DIR\t\t%s\n", RefineSolexaGenes_getJunctionIndexDir(rsg));
 
   fprintf(stderr,"CONSLIMS\t\t["); 
   Vector *consLims = RefineSolexaGenes_getConsLims(rsg);
@@ -893,7 +1762,9 @@ void RefineSolexaGenes_fetchInput(RefineSolexaGenes *rsg) {
   Slice *slice = RefineSolexaGenes_fetchSequence(rsg, RefineSolexaGenes_getInputId(rsg), NULL, NULL, 0);
 
   Slice *chrSlice = NULL;
-  if (RefineSolexaGenes_getChrSlice(rsg) == NULL) {
+  // In whole genome mode the input ids move from one seq region to another
+  if (RefineSolexaGenes_getChrSlice(rsg) == NULL ||
+      strcmp(Slice_getSeqRegionName(RefineSolexaGenes_getChrSlice(rsg)), Slice_getSeqRegionName(slice))) {
     chrSlice = SliceAdaptor_fetchByRegion(DBAdaptor_getSliceAdaptor(db), 
                                                  "toplevel", 
                                                  Slice_getSeqRegionName(slice),
@@ -961,6 +1832,11 @@ void RefineSolexaGenes_fetchInput(RefineSolexaGenes *rsg) {
         }
         continue;
       } 
+
+      // genes which start outside the core of a work unit belong to the neighbouring unit
+      if (rsg->coreEnd > 0 && (Gene_getStart(gene) < rsg->coreStart || Gene_getStart(gene) > rsg->coreEnd)) {
+        continue;
+      }
       Vector_addElement(prelimGenes, gene);
     }
     fprintf(stderr, "Got %d genes after filtering boundary overlaps\n", Vector_getNumElement(prelimGenes)); 
@@ -1021,45 +1897,58 @@ void RefineSolexaGenes_fetchInput(RefineSolexaGenes *rsg) {
 
   if (Vector_getNumElement(intronBamFiles) > 0) {
     int i;
-    for (i=0; i<Vector_getNumElement(intronBamFiles); i++) {
+    int nFile = Vector_getNumElement(intronBamFiles);
+    int *refs;
+    int begRange;
+    int endRange;
+
+    if ((refs = (int *)calloc(nFile, sizeof(int))) == NULL) {
+      fprintf(stderr, "Failed allocating refs\n");
+      exit(1);
+    }
+
+    for (i=0; i<nFile; i++) {
       IntronBamConfig *intronBamConf = Vector_getElementAt(intronBamFiles, i);
       char *intronFile = intronBamConf->fileName;
       char region[2048];
       char region_name[1024];
       int ref;
-      int begRange;
-      int endRange;
     
-      htsFile *sam = hts_open(intronFile, "rb");
-      if (sam == NULL) {
-        fprintf(stderr, "Bam file %s not found\n", intronFile);
-        exit(1);
-      }
-      fprintf(stderr,"Opened bam file %s\n", intronFile);
+      // The file, its header and index are kept open in the IntronBamConfig so they're only read once when
+      // running many input ids
+      if (intronBamConf->sam == NULL) {
+        intronBamConf->sam = hts_open(intronFile, "rb");
+        if (intronBamConf->sam == NULL) {
+          fprintf(stderr, "Bam file %s not found\n", intronFile);
+          exit(1);
+        }
+        fprintf(stderr,"Opened bam file %s\n", intronFile);
 
-      hts_set_threads(sam, RefineSolexaGenes_getThreads(rsg));
-      if (verbosity > 0) fprintf(stderr,"Setting number of threads to %d\n", RefineSolexaGenes_getThreads(rsg));
-      hts_idx_t *idx;
-      idx = sam_index_load(sam, intronFile); // load BAM index
-      if (idx == 0) {
-        fprintf(stderr, "BAM index file is not available.\n");
-        exit(1);
+        hts_set_threads(intronBamConf->sam, RefineSolexaGenes_getThreads(rsg));
+        if (verbosity > 0) fprintf(stderr,"Setting number of threads to %d\n", RefineSolexaGenes_getThreads(rsg));
+
+        intronBamConf->idx = sam_index_load(intronBamConf->sam, intronFile); // load BAM index
+        if (intronBamConf->idx == 0) {
+          fprintf(stderr, "BAM index file is not available.\n");
+          exit(1);
+        }
+        if (verbosity > 0) fprintf(stderr,"Opened bam index for %s\n", intronFile);
+
+        intronBamConf->header = bam_hdr_read(intronBamConf->sam->fp.bgzf);
       }
-      if (verbosity > 0) fprintf(stderr,"Opened bam index for %s\n", intronFile);
+      bam_hdr_t *header = intronBamConf->header;
 
-      long long count = 0;
       if (RefineSolexaGenes_getUcscNaming(rsg) == 0) {
         sprintf(region_name,"%s", Slice_getSeqRegionName(slice));
       } else {
         sprintf(region_name,"chr%s", Slice_getSeqRegionName(slice));
       }
-      bam_hdr_t *header = bam_hdr_init();
-      header = bam_hdr_read(sam->fp.bgzf);
       ref = bam_name2id(header, region_name);
       if (ref < 0) {
         fprintf(stderr, "Invalid region %s\n", region_name);
         exit(1);
       }
+      refs[i] = ref;
       sprintf(region,"%s:%ld-%ld", region_name, Slice_getSeqRegionStart(slice),
                                  Slice_getSeqRegionEnd(slice));
 
@@ -1068,16 +1957,11 @@ void RefineSolexaGenes_fetchInput(RefineSolexaGenes *rsg) {
         exit(2);
       }
       if (verbosity > 0) fprintf(stderr,"Parsed region for region %s\n", region);
-
-      // need to seamlessly merge here with the dna2simplefeatures code
-      RefineSolexaGenes_bamToIntronFeatures(rsg, intronBamConf, sam, header, idx, ref, begRange, endRange);
-
-      hts_idx_destroy(idx);
-      bam_hdr_destroy(header);
-      if (verbosity > 1) fprintf(stderr,"after index destroy\n");
-      hts_close(sam);
-      if (verbosity > 1) fprintf(stderr,"after sam close\n");
     }
+
+    // need to seamlessly merge here with the dna2simplefeatures code
+    RefineSolexaGenes_bamToIntronFeatures(rsg, intronBamFiles, refs, begRange, endRange);
+    free(refs);
   } else {
     // pre fetch all the intron features
     RefineSolexaGenes_dnaToIntronFeatures(rsg, Slice_getStart(slice), Slice_getEnd(slice));
@@ -1105,53 +1989,119 @@ void  RefineSolexaGenes_run(RefineSolexaGenes *rsg) {
 void RefineSolexaGenes_refineGenes(RefineSolexaGenes *rsg) {
   Vector *prelimGenes = RefineSolexaGenes_getPrelimGenes(rsg);
   int verbosity = RefineSolexaGenes_getVerbosity(rsg);
+  int nGene = Vector_getNumElement(prelimGenes);
+  RefineGenesTaskData taskData;
+  Vector **geneOutputs;
 
-  int i;
-// GENE:
-  for (i=0; i<Vector_getNumElement(prelimGenes); i++) {
+  if (nGene == 0) {
+    return;
+  }
 
-    if (verbosity > 1) fprintf(stderr,"STARTING NEW PRELIM GENE\n");
-    Gene *gene = Vector_getElementAt(prelimGenes, i);
-    Transcript *transcript = Gene_getTranscriptAt(gene, 0);
-    int giveUpFlag = 0; // Note: This is used a long way down this routine - if set results in skipping to next gene which is why I put it here
-   
-    // hack taking out weeny models
+  if ((geneOutputs = (Vector **)calloc(nGene, sizeof(Vector *))) == NULL) {
+    fprintf(stderr, "Failed allocating geneOutputs\n");
+    exit(1);
+  }
 
-    if (Transcript_getLength(transcript) < 300) {
-      continue;
+  RefineSolexaGenes_prepareForThreads(rsg);
+
+  taskData.rsg         = rsg;
+  taskData.prelimGenes = prelimGenes;
+  taskData.geneOutputs = geneOutputs;
+
+  WorkPool *pool = WorkPool_new(RefineSolexaGenes_getThreads(rsg));
+  WorkPool_run(pool, nGene, RefineSolexaGenes_refineGeneTask, &taskData);
+
+  int i;
+  if (verbosity > 0 && WorkPool_getNumWorker(pool) > 1) {
+    for (i=0; i<WorkPool_getNumWorker(pool); i++) {
+      fprintf(stderr, "Refine thread %d processed %d genes (%d stolen)\n", 
+              i, WorkPool_getNumTaskRun(pool, i), WorkPool_getNumStolen(pool, i));
     }
+  }
+  WorkPool_free(pool);
+
+  // Add to output in prelim gene order, so the output is the same whichever
+  // thread ran each gene
+  for (i=0; i<nGene; i++) {
+    if (geneOutputs[i] != NULL) {
+      int j;
+      for (j=0; j<Vector_getNumElement(geneOutputs[i]); j++) {
+        RefineSolexaGenes_addToOutput(rsg, Vector_getElementAt(geneOutputs[i], j));
+      }
+      Vector_free(geneOutputs[i]);
+    }
+  }
+  free(geneOutputs);
+}
+
+/*
+  Runs refineGene for one prelim gene. Each task has its own copy of the
+  RefineSolexaGenes settings so the recursion limit it works with, and the
+  output it makes, aren't shared with any other gene. Everything
+  else in the copy (intron features, extra exons, config) is only read.
+*/
+void RefineSolexaGenes_refineGeneTask(void *data, int taskNum, int workerNum) {
+  RefineGenesTaskData *taskData = (RefineGenesTaskData *)data;
+  RefineSolexaGenes taskRsg;
 
-    Vector *models = Vector_new();
+  memcpy(&taskRsg, taskData->rsg, sizeof(RefineSolexaGenes));
+  taskRsg.output = NULL;
 
-    int singleExon = 0;
-    // first run on the rev strand then on the fwd
+  RefineSolexaGenes_refineGene(&taskRsg, Vector_getElementAt(taskData->prelimGenes, taskNum));
+
+  taskData->geneOutputs[taskNum] = taskRsg.output;
+}
+
+/*
+  Does all the work for one prelim gene - anything it keeps goes onto the
+  output of the rsg it's given
+*/
+void RefineSolexaGenes_refineGene(RefineSolexaGenes *rsg, Gene *gene) {
+  int verbosity = RefineSolexaGenes_getVerbosity(rsg);
+
+  if (verbosity > 1) fprintf(stderr,"STARTING NEW PRELIM GENE\n");
+  Transcript *transcript = Gene_getTranscriptAt(gene, 0);
+  int giveUpFlag = 0; // Note: This is used a long way down this routine - if set results in skipping to next gene which is why I put it here
+ 
+  // hack taking out weeny models
+
+  if (Transcript_getLength(transcript) < 300) {
+    return;
+  }
+
+  Vector *models = Vector_new();
+
+  // This gene's copies of the intron features it uses, keyed on hit seq name (see localiseIntrons)
+  StringHash *geneIntrons = StringHash_new(STRINGHASH_SMALL);
+
+  int singleExon = 0;
+  // first run on the rev strand then on the fwd
 
 //  STRAND: 
-    int strand;
-    for (strand = -1; strand<=1 && !giveUpFlag; strand+=2) {
+  int strand;
+  for (strand = -1; strand<=1 && !giveUpFlag; strand+=2) {
 // SMJS Maybe raise these defaults to 100000
-      if ( RefineSolexaGenes_getRecursiveLimit(rsg) > RefineSolexaGenes_getMaxRecursions(rsg) ) {
-        // set recursion to 10000 in case it was raised for a tricky gene
-        RefineSolexaGenes_setRecursiveLimit(rsg, RefineSolexaGenes_getMaxRecursions(rsg));
-        fprintf(stderr, "Warning: lowering recursive limit after complex gene\n"); 
-      }
+    if ( RefineSolexaGenes_getRecursiveLimit(rsg) > RefineSolexaGenes_getMaxRecursions(rsg) ) {
+      // set recursion to 10000 in case it was raised for a tricky gene
+      RefineSolexaGenes_setRecursiveLimit(rsg, RefineSolexaGenes_getMaxRecursions(rsg));
+      fprintf(stderr, "Warning: lowering recursive limit after complex gene\n"); 
+    }
 
-      if (verbosity > 1) fprintf(stderr,"Running on strand %d\n", strand);
+    if (verbosity > 1) fprintf(stderr,"Running on strand %d\n", strand);
 
 // Doesn't seem to be used      StringHash *intronCount = StringHash_new(STRINGHASH_SMALL);
-      Vector *exonIntron = Vector_new(); // A Vector of Vectors. Each Vector lists the possible introns for a particular exon
-      
-      StringHash *intronHash = StringHash_new(STRINGHASH_SMALL); // A hash containing all the introns, keyed on intron HitSeqName.
+    Vector *exonIntron = Vector_new(); // A Vector of Vectors. Each Vector lists the possible introns for a particular exon
+    
 // Doesn't seem to be used      Vector *exonPrevIntron = Vector_new();
-      StringHash *intronExon = StringHash_new(STRINGHASH_SMALL); // A Hash of Vectors. keyed on intron HitSeqName. Each element is a list of exons
+    StringHash *intronExon = StringHash_new(STRINGHASH_SMALL); // A Hash of Vectors. keyed on intron HitSeqName. Each element is a list of exons
 
-      int mostRealIntrons = 0;
-      double highestScore = 0;
+    int mostRealIntrons = 0;
+    double highestScore = 0;
 
-      if (verbosity > 1) fprintf(stderr, "Gene %s : %ld %ld:\n", Gene_getStableId(gene), Gene_getStart(gene), Gene_getEnd(gene));
+    if (verbosity > 1) fprintf(stderr, "Gene %s : %ld %ld:\n", Gene_getStableId(gene), Gene_getStart(gene), Gene_getEnd(gene));
 
-      Vector *exons = RefineSolexaGenes_mergeExons(rsg, gene, strand);
-      Vector_sort(exons, SeqFeature_startCompFunc);
+    Vector *exons = RefineSolexaGenes_mergeExons(rsg, gene, strand);
+    Vector_sort(exons, SeqFeature_startCompFunc);
 
 /*
 #      foreach my $exon ( @exons ) {
@@ -1163,816 +2113,744 @@ void RefineSolexaGenes_refineGenes(RefineSolexaGenes *rsg) {
 #                  if $exon->{"_extra"} ;
 #      }
 */
-   
-      int exonCount = Vector_getNumElement(exons);
+ 
+    int exonCount = Vector_getNumElement(exons);
 // Doesn't seem to be used      Vector *fakeIntrons = Vector_new();
-      StringHash *knownExons = StringHash_new(STRINGHASH_SMALL);
+    StringHash *knownExons = StringHash_new(STRINGHASH_SMALL);
 
-      long offset = 0;
+    long offset = 0;
 
-      //fprintf(stderr,"exonCount = %d\n", exonCount);
+    //fprintf(stderr,"exonCount = %d\n", exonCount);
 
 //    EXON:   
-      int j;
-      for (j=0; j<exonCount; j++) {
-        Exon *origExon = Vector_getElementAt(exons, j);
-        Exon *exon = ExonUtils_cloneExon(origExon);
-        int exonUsed = 0; // Has this cloned exon been added to exons (used for memory management)
+    int j;
+    for (j=0; j<exonCount; j++) {
+      Exon *origExon = Vector_getElementAt(exons, j);
+      Exon *exon = ExonUtils_cloneExon(origExon);
+      int exonUsed = 0; // Has this cloned exon been added to exons (used for memory management)
  
-        int retainedIntron = 0;
-        int leftIntrons = 0;
-        int rightIntrons = 0;
+      int retainedIntron = 0;
+      int leftIntrons = 0;
+      int rightIntrons = 0;
 
 // Don't seem to be used so commented out
 //        $exon->{'left_mask'} = 0;
 //        $exon->{'right_mask'} = $exon->length;
 
 
-        //fprintf(logfp, "Ex: %d : %ld %ld\n",j, Exon_getStart(exon), Exon_getEnd(exon));
-        // make intron features by collapsing the dna_align_features
+      //fprintf(logfp, "Ex: %d : %ld %ld\n",j, Exon_getStart(exon), Exon_getEnd(exon));
+      // make intron features by collapsing the dna_align_features
 
 // Note in perl introns and offset are both returned - in C change to pass offset as pointer so can be modified
-        Vector *introns = RefineSolexaGenes_fetchIntronFeatures(rsg, Exon_getSeqRegionStart(exon), Exon_getSeqRegionEnd(exon), &offset);
+      Vector *introns = RefineSolexaGenes_fetchIntronFeatures(rsg, Exon_getSeqRegionStart(exon), Exon_getSeqRegionEnd(exon), &offset);
+      RefineSolexaGenes_localiseIntrons(rsg, introns, geneIntrons);
 
-        Vector *leftConsIntrons = Vector_new();
-        Vector *rightConsIntrons = Vector_new();
-        Vector *leftNonConsIntrons = Vector_new();
-        Vector *rightNonConsIntrons = Vector_new();
-        Vector *filteredIntrons = Vector_new();
-        Vector *retainedIntrons = Vector_new();
+      Vector *leftConsIntrons = Vector_new();
+      Vector *rightConsIntrons = Vector_new();
+      Vector *leftNonConsIntrons = Vector_new();
+      Vector *rightNonConsIntrons = Vector_new();
+      Vector *filteredIntrons = Vector_new();
+      Vector *retainedIntrons = Vector_new();
 
-        int intronOverlap = 0;
+      int intronOverlap = 0;
 
 //        fprintf(stderr, "Have %d introns\n", Vector_getNumElement(introns));
 //      INTRON: 
-        int k;
-        for (k=0; k<Vector_getNumElement(introns); k++) {
-          DNAAlignFeature *intron = Vector_getElementAt(introns, k);
+      int k;
+      for (k=0; k<Vector_getNumElement(introns); k++) {
+        DNAAlignFeature *intron = Vector_getElementAt(introns, k);
 
-          if (DNAAlignFeature_getStrand(intron) != strand) {
-            //fprintf(stderr, "strand continue %d %d\n", DNAAlignFeature_getStrand(intron), strand);
-            continue;
-          } 
-          if (DNAAlignFeature_getLength(intron) <= RefineSolexaGenes_getMinIntronSize(rsg)) {
-            //fprintf(stderr, "min size continue\n");
-            continue;
-          } 
-          if (DNAAlignFeature_getLength(intron) > RefineSolexaGenes_getMaxIntronSize(rsg)) {
-            //fprintf(stderr, "max size continue\n");
-            continue;
-          } 
+        if (DNAAlignFeature_getStrand(intron) != strand) {
+          //fprintf(stderr, "strand continue %d %d\n", DNAAlignFeature_getStrand(intron), strand);
+          continue;
+        } 
+        if (DNAAlignFeature_getLength(intron) <= RefineSolexaGenes_getMinIntronSize(rsg)) {
+          //fprintf(stderr, "min size continue\n");
+          continue;
+        } 
+        if (DNAAlignFeature_getLength(intron) > RefineSolexaGenes_getMaxIntronSize(rsg)) {
+          //fprintf(stderr, "max size continue\n");
+          continue;
+        } 
 
-          // discard introns that splice over our exon
-          if (DNAAlignFeature_getStart(intron) < Exon_getStart(exon) && 
-              DNAAlignFeature_getEnd(intron) > Exon_getEnd(exon)) {
-            intronOverlap++;
-            continue;
-          }
-          //fprintf(stderr,"Got past continues\n");
+        // discard introns that splice over our exon
+        if (DNAAlignFeature_getStart(intron) < Exon_getStart(exon) && 
+            DNAAlignFeature_getEnd(intron) > Exon_getEnd(exon)) {
+          intronOverlap++;
+          continue;
+        }
+        //fprintf(stderr,"Got past continues\n");
 
-          // check to see if this exon contains a retained intron
-          if (DNAAlignFeature_getStart(intron) > Exon_getStart(exon) && 
-              DNAAlignFeature_getEnd(intron) < Exon_getEnd(exon) ) {
-          //fprintf(stderr,"in retained intron if \n");
-            retainedIntron = 1;
+        // check to see if this exon contains a retained intron
+        if (DNAAlignFeature_getStart(intron) > Exon_getStart(exon) && 
+            DNAAlignFeature_getEnd(intron) < Exon_getEnd(exon) ) {
+        //fprintf(stderr,"in retained intron if \n");
+          retainedIntron = 1;
 // Hack hack hack
 
-            Exon_addFlag(exon, RSGEXON_RETAINED);
+          Exon_addFlag(exon, RSGEXON_RETAINED);
 
-            Vector_addElement(retainedIntrons, intron);
-            //fprintf(stderr, "Added retained intron %s %d %d\n", DNAAlignFeature_getHitSeqName(intron), DNAAlignFeature_getStart(intron), DNAAlignFeature_getEnd(intron));
-          } else {
-            //fprintf(stderr, "Added normal intron %s %d %d\n", DNAAlignFeature_getHitSeqName(intron), DNAAlignFeature_getStart(intron), DNAAlignFeature_getEnd(intron));
-          //fprintf(stderr,"in else \n");
-            // we need to know how many consensus introns we have to the 
-            // left and right in order to determine whether to put in 
-            // a non consensus intron
-            if (DNAAlignFeature_getEnd(intron) <= Exon_getEnd(exon)) {
-              //if (strstr(DNAAlignFeature_getHitSeqName(intron), "non canonical")) {
-              if (DNAAlignFeature_getFlags(intron) & RSGINTRON_NONCANON) {
-                if (DNAAlignFeature_getScore(intron) > 1) {
-                  Vector_addElement(leftNonConsIntrons, intron);
-                }
-              } else {
-                Vector_addElement(leftConsIntrons, intron);
+          Vector_addElement(retainedIntrons, intron);
+          //fprintf(stderr, "Added retained intron %s %d %d\n", DNAAlignFeature_getHitSeqName(intron), DNAAlignFeature_getStart(intron), DNAAlignFeature_getEnd(intron));
+        } else {
+          //fprintf(stderr, "Added normal intron %s %d %d\n", DNAAlignFeature_getHitSeqName(intron), DNAAlignFeature_getStart(intron), DNAAlignFeature_getEnd(intron));
+        //fprintf(stderr,"in else \n");
+          // we need to know how many consensus introns we have to the 
+          // left and right in order to determine whether to put in 
+          // a non consensus intron
+          if (DNAAlignFeature_getEnd(intron) <= Exon_getEnd(exon)) {
+            //if (strstr(DNAAlignFeature_getHitSeqName(intron), "non canonical")) {
+            if (DNAAlignFeature_getFlags(intron) & RSGINTRON_NONCANON) {
+              if (DNAAlignFeature_getScore(intron) > 1) {
+                Vector_addElement(leftNonConsIntrons, intron);
               }
+            } else {
+              Vector_addElement(leftConsIntrons, intron);
             }
-            if (DNAAlignFeature_getStart(intron) >= Exon_getStart(exon)) {
-              //if (strstr(DNAAlignFeature_getHitSeqName(intron), "non canonical")) {
-              if (DNAAlignFeature_getFlags(intron) & RSGINTRON_NONCANON) {
-                if (DNAAlignFeature_getScore(intron) > 1) {
-                  Vector_addElement(rightNonConsIntrons, intron);
-                }
-              } else {
-                Vector_addElement(rightConsIntrons, intron);
+          }
+          if (DNAAlignFeature_getStart(intron) >= Exon_getStart(exon)) {
+            //if (strstr(DNAAlignFeature_getHitSeqName(intron), "non canonical")) {
+            if (DNAAlignFeature_getFlags(intron) & RSGINTRON_NONCANON) {
+              if (DNAAlignFeature_getScore(intron) > 1) {
+                Vector_addElement(rightNonConsIntrons, intron);
               }
+            } else {
+              Vector_addElement(rightConsIntrons, intron);
             }
           }
         }
+      }
 
 /*
-        fprintf(stderr, "Have %d left cons %d right cons %d left non cons %d right non cons\n", 
-                Vector_getNumElement(leftConsIntrons),
-                Vector_getNumElement(rightConsIntrons),
-                Vector_getNumElement(leftNonConsIntrons),
-                Vector_getNumElement(rightNonConsIntrons));
+      fprintf(stderr, "Have %d left cons %d right cons %d left non cons %d right non cons\n", 
+              Vector_getNumElement(leftConsIntrons),
+              Vector_getNumElement(rightConsIntrons),
+              Vector_getNumElement(leftNonConsIntrons),
+              Vector_getNumElement(rightNonConsIntrons));
 */
-        
-        // Restrict internal exons splice sites to most common
-        // that way our alt splices will all share the same boundaries
-        // but have different combinations of exons
-        if ( RefineSolexaGenes_strictInternalSpliceSites(rsg) || 
-             // either we apply it equeally to all exons
-             RefineSolexaGenes_strictInternalEndSpliceSites(rsg) ||
-             // only apply to internal exons, leave out end exons
-             ( !RefineSolexaGenes_strictInternalEndSpliceSites(rsg) &&
-               ( Vector_getNumElement(leftConsIntrons)  + Vector_getNumElement(leftNonConsIntrons) ) > 0 &&
-               ( Vector_getNumElement(rightConsIntrons) + Vector_getNumElement(rightNonConsIntrons)) > 0 )) {
-          // pick best left splice
-          long bestLeftSplice;
-          double bestLeftScore = 0;
-
-          int k;
-          for (k=0; k<Vector_getNumElement(leftConsIntrons); k++) {
-            DNAAlignFeature *intron = Vector_getElementAt(leftConsIntrons, k);
-
-            if (bestLeftScore < DNAAlignFeature_getScore(intron)) {
-              bestLeftScore = DNAAlignFeature_getScore(intron);
-              bestLeftSplice = DNAAlignFeature_getEnd(intron);
-            }
+      
+      // Restrict internal exons splice sites to most common
+      // that way our alt splices will all share the same boundaries
+      // but have different combinations of exons
+      if ( RefineSolexaGenes_strictInternalSpliceSites(rsg) || 
+           // either we apply it equeally to all exons
+           RefineSolexaGenes_strictInternalEndSpliceSites(rsg) ||
+           // only apply to internal exons, leave out end exons
+           ( !RefineSolexaGenes_strictInternalEndSpliceSites(rsg) &&
+             ( Vector_getNumElement(leftConsIntrons)  + Vector_getNumElement(leftNonConsIntrons) ) > 0 &&
+             ( Vector_getNumElement(rightConsIntrons) + Vector_getNumElement(rightNonConsIntrons)) > 0 )) {
+        // pick best left splice
+        long bestLeftSplice;
+        double bestLeftScore = 0;
+
+        int k;
+        for (k=0; k<Vector_getNumElement(leftConsIntrons); k++) {
+          DNAAlignFeature *intron = Vector_getElementAt(leftConsIntrons, k);
+
+          if (bestLeftScore < DNAAlignFeature_getScore(intron)) {
+            bestLeftScore = DNAAlignFeature_getScore(intron);
+            bestLeftSplice = DNAAlignFeature_getEnd(intron);
           }
-          for (k=0; k<Vector_getNumElement(leftNonConsIntrons); k++) {
-            DNAAlignFeature *intron = Vector_getElementAt(leftNonConsIntrons, k);
+        }
+        for (k=0; k<Vector_getNumElement(leftNonConsIntrons); k++) {
+          DNAAlignFeature *intron = Vector_getElementAt(leftNonConsIntrons, k);
 
-            if (bestLeftScore < DNAAlignFeature_getScore(intron)) {
-              bestLeftScore = DNAAlignFeature_getScore(intron);
-              bestLeftSplice = DNAAlignFeature_getEnd(intron);
-            }
+          if (bestLeftScore < DNAAlignFeature_getScore(intron)) {
+            bestLeftScore = DNAAlignFeature_getScore(intron);
+            bestLeftSplice = DNAAlignFeature_getEnd(intron);
           }
-          
-          // pick best right  splice
-          long bestRightSplice;
-          double bestRightScore = 0;
+        }
+        
+        // pick best right  splice
+        long bestRightSplice;
+        double bestRightScore = 0;
 
-          for (k=0; k<Vector_getNumElement(rightConsIntrons); k++) {
-            DNAAlignFeature *intron = Vector_getElementAt(rightConsIntrons, k);
+        for (k=0; k<Vector_getNumElement(rightConsIntrons); k++) {
+          DNAAlignFeature *intron = Vector_getElementAt(rightConsIntrons, k);
 
-            if (bestRightScore < DNAAlignFeature_getScore(intron)) {
-              bestRightScore = DNAAlignFeature_getScore(intron);
-              bestRightSplice = DNAAlignFeature_getStart(intron);
-            }
+          if (bestRightScore < DNAAlignFeature_getScore(intron)) {
+            bestRightScore = DNAAlignFeature_getScore(intron);
+            bestRightSplice = DNAAlignFeature_getStart(intron);
           }
-          for (k=0; k<Vector_getNumElement(rightNonConsIntrons); k++) {
-            DNAAlignFeature *intron = Vector_getElementAt(rightNonConsIntrons, k);
+        }
+        for (k=0; k<Vector_getNumElement(rightNonConsIntrons); k++) {
+          DNAAlignFeature *intron = Vector_getElementAt(rightNonConsIntrons, k);
 
-            if (bestRightScore < DNAAlignFeature_getScore(intron)) {
-              bestRightScore = DNAAlignFeature_getScore(intron);
-              bestRightSplice = DNAAlignFeature_getStart(intron);
-            }
+          if (bestRightScore < DNAAlignFeature_getScore(intron)) {
+            bestRightScore = DNAAlignFeature_getScore(intron);
+            bestRightSplice = DNAAlignFeature_getStart(intron);
           }
+        }
 
-          // filter out introns that pick other splice sites
-          for (k=0; k<Vector_getNumElement(leftConsIntrons); k++) {
-            DNAAlignFeature *intron = Vector_getElementAt(leftConsIntrons, k);
+        // filter out introns that pick other splice sites
+        for (k=0; k<Vector_getNumElement(leftConsIntrons); k++) {
+          DNAAlignFeature *intron = Vector_getElementAt(leftConsIntrons, k);
 
-            if (DNAAlignFeature_getEnd(intron) == bestLeftSplice) {
-              Vector_addElement(filteredIntrons, intron);
-            }
+          if (DNAAlignFeature_getEnd(intron) == bestLeftSplice) {
+            Vector_addElement(filteredIntrons, intron);
           }
-          for (k=0; k<Vector_getNumElement(leftNonConsIntrons); k++) {
-            DNAAlignFeature *intron = Vector_getElementAt(leftNonConsIntrons, k);
+        }
+        for (k=0; k<Vector_getNumElement(leftNonConsIntrons); k++) {
+          DNAAlignFeature *intron = Vector_getElementAt(leftNonConsIntrons, k);
 
-            if (DNAAlignFeature_getEnd(intron) == bestLeftSplice) {
-              Vector_addElement(filteredIntrons, intron);
-            }
+          if (DNAAlignFeature_getEnd(intron) == bestLeftSplice) {
+            Vector_addElement(filteredIntrons, intron);
           }
+        }
 
-          for (k=0; k<Vector_getNumElement(rightConsIntrons); k++) {
-            DNAAlignFeature *intron = Vector_getElementAt(rightConsIntrons, k);
+        for (k=0; k<Vector_getNumElement(rightConsIntrons); k++) {
+          DNAAlignFeature *intron = Vector_getElementAt(rightConsIntrons, k);
 
-            if (DNAAlignFeature_getStart(intron) == bestRightSplice) {
-              Vector_addElement(filteredIntrons, intron);
-            }
+          if (DNAAlignFeature_getStart(intron) == bestRightSplice) {
+            Vector_addElement(filteredIntrons, intron);
           }
-          for (k=0; k<Vector_getNumElement(rightNonConsIntrons); k++) {
-            DNAAlignFeature *intron = Vector_getElementAt(rightNonConsIntrons, k);
+        }
+        for (k=0; k<Vector_getNumElement(rightNonConsIntrons); k++) {
+          DNAAlignFeature *intron = Vector_getElementAt(rightNonConsIntrons, k);
 
-            if (DNAAlignFeature_getStart(intron) == bestRightSplice) {
-              Vector_addElement(filteredIntrons, intron);
-            }
+          if (DNAAlignFeature_getStart(intron) == bestRightSplice) {
+            Vector_addElement(filteredIntrons, intron);
           }
-        } else {
-          
-          // add non consensus introns only where there are no consensus introns
-          Vector_append(filteredIntrons, leftConsIntrons);
-          Vector_append(filteredIntrons, rightConsIntrons);
+        }
+      } else {
+        
+        // add non consensus introns only where there are no consensus introns
+        Vector_append(filteredIntrons, leftConsIntrons);
+        Vector_append(filteredIntrons, rightConsIntrons);
 
-          if (Vector_getNumElement(leftConsIntrons) == 0) {
-            Vector_append(filteredIntrons, leftNonConsIntrons);
-          }
-          if (Vector_getNumElement(rightConsIntrons) == 0) {
-            Vector_append(filteredIntrons, rightNonConsIntrons);
-          }
+        if (Vector_getNumElement(leftConsIntrons) == 0) {
+          Vector_append(filteredIntrons, leftNonConsIntrons);
         }
+        if (Vector_getNumElement(rightConsIntrons) == 0) {
+          Vector_append(filteredIntrons, rightNonConsIntrons);
+        }
+      }
 
 /* Does nothing
-        if ( scalar(@left_c_introns)  == 0 && scalar(@left_nc_introns)  > 0) {
-         # print STDERR "using " . scalar(@left_nc_introns) . " NC left \n";
-        } 
-        if ( scalar(@right_c_introns)  == 0 && scalar(@right_nc_introns)  > 0 ) {
-         # print STDERR "using " . scalar(@right_nc_introns) . " NC right \n";
-        }
+      if ( scalar(@left_c_introns)  == 0 && scalar(@left_nc_introns)  > 0) {
+       # print STDERR "using " . scalar(@left_nc_introns) . " NC left \n";
+      } 
+      if ( scalar(@right_c_introns)  == 0 && scalar(@right_nc_introns)  > 0 ) {
+       # print STDERR "using " . scalar(@right_nc_introns) . " NC right \n";
+      }
 */
-        //fprintf(stderr, "Have %d exons %d filteredIntrons and %d retainedIntrons\n",  Vector_getNumElement(exons),
-       //      Vector_getNumElement(filteredIntrons),
-       //      Vector_getNumElement(retainedIntrons));
-        
-        // single exon models are a special case
-        if ( Vector_getNumElement(exons) == 1 && 
-             Vector_getNumElement(filteredIntrons) == 0 &&  
-             Vector_getNumElement(retainedIntrons) == 0 ) {
-          //# at least on this strand this model looks like a single exon
-          singleExon += 1;
-        }
-        
-        // we dont want to allow left and right introns to overlap - 
-        // it leads to -ve length exons
-        
-        // we put all the retained introns in at the end we want to do all the 
-        // entrances and exits to each exon before we look at whether its 
-        // retained or not
-        Vector_sort(retainedIntrons, SeqFeature_startCompFunc);
+      //fprintf(stderr, "Have %d exons %d filteredIntrons and %d retainedIntrons\n",  Vector_getNumElement(exons),
+     //      Vector_getNumElement(filteredIntrons),
+     //      Vector_getNumElement(retainedIntrons));
+      
+      // single exon models are a special case
+      if ( Vector_getNumElement(exons) == 1 && 
+           Vector_getNumElement(filteredIntrons) == 0 &&  
+           Vector_getNumElement(retainedIntrons) == 0 ) {
+        //# at least on this strand this model looks like a single exon
+        singleExon += 1;
+      }
+      
+      // we dont want to allow left and right introns to overlap - 
+      // it leads to -ve length exons
+      
+      // we put all the retained introns in at the end we want to do all the 
+      // entrances and exits to each exon before we look at whether its 
+      // retained or not
+      Vector_sort(retainedIntrons, SeqFeature_startCompFunc);
 
 // Slight difference to perl - allocate a Vector for every exon in exonIntron. It will be empty if no introns for this exon, but easier than having a null pointer
-        Vector *exIntj = NULL;
+      Vector *exIntj = NULL;
 
-        // push @filtered_introns, @retained_introns;
+      // push @filtered_introns, @retained_introns;
 //      INTRON:  
-        for (k=0; k<Vector_getNumElement(filteredIntrons); k++) {
-          DNAAlignFeature *intron = Vector_getElementAt(filteredIntrons, k);
-          //# print STDERR "\t" . $intron->start . " " . $intron->end . " " . $intron->strand . " " . $intron->hseqname . " " . $intron->score . "\n";
-          // becasue we make a new exons where we have a reatained intron to 
-          // stop circular references we need to allow the final 
-          // intron splicing out of the exon to be used more than once
-          // by each new exon in fact
+      for (k=0; k<Vector_getNumElement(filteredIntrons); k++) {
+        DNAAlignFeature *intron = Vector_getElementAt(filteredIntrons, k);
+        //# print STDERR "\t" . $intron->start . " " . $intron->end . " " . $intron->strand . " " . $intron->hseqname . " " . $intron->score . "\n";
+        // becasue we make a new exons where we have a reatained intron to 
+        // stop circular references we need to allow the final 
+        // intron splicing out of the exon to be used more than once
+        // by each new exon in fact
 
 // Doesn't seem to be used          $intron_count{$intron->hseqname}++ unless $retained_intron;
 //          StringHash_add(intronCount, DNAAlignFeature_getHitSeqName(intron),
 
-          if (!StringHash_contains(intronHash, DNAAlignFeature_getHitSeqName(intron))) {
-            StringHash_add(intronHash, DNAAlignFeature_getHitSeqName(intron), intron);
+        // only use each intron twice once at the end and once at the start of
+        // an exon
+        // exon_intron links exons to the intron on their right ignoring strand
+        if (DNAAlignFeature_getEnd(intron) > Exon_getEnd(exon)) {
+          if (exIntj == NULL) {
+            exIntj = Vector_new();
+            Vector_setElementAt(exonIntron, j, exIntj);
           }
+          Vector_addElement(exIntj, intron);
+        }
 
-          // only use each intron twice once at the end and once at the start of
-          // an exon
-          // exon_intron links exons to the intron on their right ignoring strand
-          if (DNAAlignFeature_getEnd(intron) > Exon_getEnd(exon)) {
-            if (exIntj == NULL) {
-              exIntj = Vector_new();
-              Vector_setElementAt(exonIntron, j, exIntj);
-            }
-            Vector_addElement(exIntj, intron);
+        // intron exon links introns to exons on their right ignoring strand
+        if (DNAAlignFeature_getStart(intron) < Exon_getStart(exon)) {
+          if (!StringHash_contains(intronExon, DNAAlignFeature_getHitSeqName(intron))) {
+            Vector *ieVec = Vector_new();
+            Vector_setFreeFunc(ieVec, free);
+            StringHash_add(intronExon, DNAAlignFeature_getHitSeqName(intron), ieVec);
           }
-
-          // intron exon links introns to exons on their right ignoring strand
-          if (DNAAlignFeature_getStart(intron) < Exon_getStart(exon)) {
-            if (!StringHash_contains(intronExon, DNAAlignFeature_getHitSeqName(intron))) {
-              Vector *ieVec = Vector_new();
-              Vector_setFreeFunc(ieVec, free);
-              StringHash_add(intronExon, DNAAlignFeature_getHitSeqName(intron), ieVec);
-            }
-            Vector *ieVec = StringHash_getValue(intronExon, DNAAlignFeature_getHitSeqName(intron));
-            Vector_addElement(ieVec, long_new(j));
-            // exon_prev_intron links exons to introns on their left ignoring strand
+          Vector *ieVec = StringHash_getValue(intronExon, DNAAlignFeature_getHitSeqName(intron));
+          Vector_addElement(ieVec, long_new(j));
+          // exon_prev_intron links exons to introns on their left ignoring strand
 // Doesn't seem to be used push @{ $exon_prev_intron[$j]}  , $intron ;
-          }
         }
-        if (Vector_getNumElement(retainedIntrons) > 0) {
-          //#print STDERR "Dealing with " . scalar( @retained_introns ) . " retained introns \n";
-          //fprintf(stderr,  "Dealing with %d retained introns \n",Vector_getNumElement(retainedIntrons));
-          Vector *newExons = Vector_new();
-          exonUsed = 1;
-          Vector_addElement(newExons, exon);
-
-          // sort first by start then by end where start is the same
-          Vector_sort(retainedIntrons, SeqFeature_startEndCompFunc);
+      }
+      if (Vector_getNumElement(retainedIntrons) > 0) {
+        //#print STDERR "Dealing with " . scalar( @retained_introns ) . " retained introns \n";
+        //fprintf(stderr,  "Dealing with %d retained introns \n",Vector_getNumElement(retainedIntrons));
+        Vector *newExons = Vector_new();
+        exonUsed = 1;
+        Vector_addElement(newExons, exon);
+
+        // sort first by start then by end where start is the same
+        Vector_sort(retainedIntrons, SeqFeature_startEndCompFunc);
 /* This is just sorting by end after doing the start sort, so do that in one in the sort func
-          int m;
+        int m;
 // Think need the -1
-          for (m=0; m < Vector_getNumElement(retainedIntrons)-1; m++) {
-            DNAAlignFeature *retainedIntron = Vector_getElementAt(retainedIntrons, m);
-            DNAAlignFeature *retainedIntronP1 = Vector_getElementAt(retainedIntrons, m+1);
-
-            if (DNAAlignFeature_getStart(retainedIntron) == DNAAlignFeature_getStart(retainedIntronP1) &&
-                DNAAlignFeature_getEnd(retainedIntron) > DNAAlignFeature_getEnd(retainedIntronP1)) {
-              // reverse the order
-              my $temp =  $retained_introns[m];
-              $retained_introns[m] = $retained_introns[m+1];
-              $retained_introns[m+1] = $temp;
-            }
+        for (m=0; m < Vector_getNumElement(retainedIntrons)-1; m++) {
+          DNAAlignFeature *retainedIntron = Vector_getElementAt(retainedIntrons, m);
+          DNAAlignFeature *retainedIntronP1 = Vector_getElementAt(retainedIntrons, m+1);
+
+          if (DNAAlignFeature_getStart(retainedIntron) == DNAAlignFeature_getStart(retainedIntronP1) &&
+              DNAAlignFeature_getEnd(retainedIntron) > DNAAlignFeature_getEnd(retainedIntronP1)) {
+            // reverse the order
+            my $temp =  $retained_introns[m];
+            $retained_introns[m] = $retained_introns[m+1];
+            $retained_introns[m+1] = $temp;
           }
+        }
 */
 
-          // now lets deal with any retained introns we have
+        // now lets deal with any retained introns we have
 //  RETAINED: 
-          int m;
-          for (m=0; m < Vector_getNumElement(retainedIntrons); m++) {
-            DNAAlignFeature *intron = Vector_getElementAt(retainedIntrons, m);
+        int m;
+        for (m=0; m < Vector_getNumElement(retainedIntrons); m++) {
+          DNAAlignFeature *intron = Vector_getElementAt(retainedIntrons, m);
 
-            // we dont need to make all new exons for each alternate splice
-            // check the intron is still retained given the new exons
-            int retained = 1;
-            int n;
-            for (n=0; n<Vector_getNumElement(newExons); n++) {
-              Exon *newExon = Vector_getElementAt(newExons, n);
-              if  (DNAAlignFeature_getStart(intron) > Exon_getStart(newExon) && DNAAlignFeature_getEnd(intron) < Exon_getEnd(newExon)) {
-              } else {
-                retained = 0;
-              }
-              // Use an if instead of this - next RETAINED unless $retained;
+          // we dont need to make all new exons for each alternate splice
+          // check the intron is still retained given the new exons
+          int retained = 1;
+          int n;
+          for (n=0; n<Vector_getNumElement(newExons); n++) {
+            Exon *newExon = Vector_getElementAt(newExons, n);
+            if  (DNAAlignFeature_getStart(intron) > Exon_getStart(newExon) && DNAAlignFeature_getEnd(intron) < Exon_getEnd(newExon)) {
+            } else {
+              retained = 0;
             }
+            // Use an if instead of this - next RETAINED unless $retained;
+          }
 
-            if (retained) {
-              double rejectScore = 0;
-              // intron is within the exon - this is not a true exon but a retained intron
-              if (DNAAlignFeature_getStart(intron) > Exon_getStart(exon) && 
-                  DNAAlignFeature_getEnd(intron) < Exon_getEnd(exon) && 
-                  DNAAlignFeature_getLength(intron) > RefineSolexaGenes_getMinIntronSize(rsg)) {
-                // we are going to make a new exon and chop it up
-                // add intron penalty
-                //fprintf(stderr, "RETAINED INTRON PENALTY for %s before %f", DNAAlignFeature_getHitSeqName(intron), DNAAlignFeature_getScore(intron));
-                rejectScore = DNAAlignFeature_getScore(intron) - RefineSolexaGenes_getRetainedIntronPenalty(rsg);
-                // intron penalty is doubled for nc introns 
-                //if (strstr(DNAAlignFeature_getHitSeqName(intron), "non canonical")) {
-                if (DNAAlignFeature_getFlags(intron) & RSGINTRON_NONCANON) {
-                  rejectScore = rejectScore - RefineSolexaGenes_getRetainedIntronPenalty(rsg);
+          if (retained) {
+            double rejectScore = 0;
+            // intron is within the exon - this is not a true exon but a retained intron
+            if (DNAAlignFeature_getStart(intron) > Exon_getStart(exon) && 
+                DNAAlignFeature_getEnd(intron) < Exon_getEnd(exon) && 
+                DNAAlignFeature_getLength(intron) > RefineSolexaGenes_getMinIntronSize(rsg)) {
+              // we are going to make a new exon and chop it up
+              // add intron penalty
+              //fprintf(stderr, "RETAINED INTRON PENALTY for %s before %f", DNAAlignFeature_getHitSeqName(intron), DNAAlignFeature_getScore(intron));
+              rejectScore = DNAAlignFeature_getScore(intron) - RefineSolexaGenes_getRetainedIntronPenalty(rsg);
+              // intron penalty is doubled for nc introns 
+              //if (strstr(DNAAlignFeature_getHitSeqName(intron), "non canonical")) {
+              if (DNAAlignFeature_getFlags(intron) & RSGINTRON_NONCANON) {
+                rejectScore = rejectScore - RefineSolexaGenes_getRetainedIntronPenalty(rsg);
+              }
+              //fprintf(stderr, " after %f\n",rejectScore);
+              if (rejectScore < 1 ) {
+                // treat as single exon
+                if (Vector_getNumElement(exons) == 1 ) {
+                  // at least on this strand this model looks like a single exon
+                  singleExon += 1;
                 }
-                //fprintf(stderr, " after %f\n",rejectScore);
-                if (rejectScore < 1 ) {
-                  // treat as single exon
-                  if (Vector_getNumElement(exons) == 1 ) {
-                    // at least on this strand this model looks like a single exon
-                    singleExon += 1;
-                  }
-                } else {
-                  //fprintf(stderr, "Exon %ld\t%ld has retained intron: %ld\t%ld\n",Exon_getStart(exon), Exon_getEnd(exon), DNAAlignFeature_getStart(intron), DNAAlignFeature_getEnd(intron));
-                  // dont have circular references to exons or the paths
-                  // will be infinite so clone this exon instead
-                  // I guess we also want to keep the original exon too?
-                  Exon *newExon1 = ExonUtils_cloneExon( exon );
-                  Exon *newExon2 = ExonUtils_cloneExon( exon );
-    
-                  // chop it up a bit so it no longer overlaps the other introns
-                  //fprintf(stderr, "TRIMMING EXON \n");
-                  int length = DNAAlignFeature_getEnd(intron) - DNAAlignFeature_getStart(intron);
-                  Exon_setEnd  (newExon1, DNAAlignFeature_getStart(intron) + ( length / 2 ) - 2);
-                  Exon_setStart(newExon2, DNAAlignFeature_getEnd(intron) - ( length / 2 ) + 2);
-                  
-                  char keKey[1024];
-                  sprintf(keKey,"%ld-%ld-%d",Exon_getStart(newExon1), Exon_getEnd(newExon1), Exon_getStrand(newExon1));
-                  if (!StringHash_contains(knownExons, keKey)) {
-                    Vector_addElement(newExons, newExon1);
-                    StringHash_add(knownExons, keKey, &trueVal);
-                  } else {
-                    Exon_freeImpl(newExon1);
-                  }
+              } else {
+                //fprintf(stderr, "Exon %ld\t%ld has retained intron: %ld\t%ld\n",Exon_getStart(exon), Exon_getEnd(exon), DNAAlignFeature_getStart(intron), DNAAlignFeature_getEnd(intron));
+                // dont have circular references to exons or the paths
+                // will be infinite so clone this exon instead
+                // I guess we also want to keep the original exon too?
+                Exon *newExon1 = ExonUtils_cloneExon( exon );
+                Exon *newExon2 = ExonUtils_cloneExon( exon );
   
-                  sprintf(keKey,"%ld-%ld-%d",Exon_getStart(newExon2), Exon_getEnd(newExon2), Exon_getStrand(newExon2));
-                  if (!StringHash_contains(knownExons, keKey)) {
-                    Vector_addElement(newExons, newExon2);
-                    StringHash_add(knownExons, keKey, &trueVal);
-                  } else {
-                    Exon_freeImpl(newExon2);
-                  }
+                // chop it up a bit so it no longer overlaps the other introns
+                //fprintf(stderr, "TRIMMING EXON \n");
+                int length = DNAAlignFeature_getEnd(intron) - DNAAlignFeature_getStart(intron);
+                Exon_setEnd  (newExon1, DNAAlignFeature_getStart(intron) + ( length / 2 ) - 2);
+                Exon_setStart(newExon2, DNAAlignFeature_getEnd(intron) - ( length / 2 ) + 2);
+                
+                char keKey[1024];
+                sprintf(keKey,"%ld-%ld-%d",Exon_getStart(newExon1), Exon_getEnd(newExon1), Exon_getStrand(newExon1));
+                if (!StringHash_contains(knownExons, keKey)) {
+                  Vector_addElement(newExons, newExon1);
+                  StringHash_add(knownExons, keKey, &trueVal);
+                } else {
+                  Exon_freeImpl(newExon1);
+                }
+
+                sprintf(keKey,"%ld-%ld-%d",Exon_getStart(newExon2), Exon_getEnd(newExon2), Exon_getStrand(newExon2));
+                if (!StringHash_contains(knownExons, keKey)) {
+                  Vector_addElement(newExons, newExon2);
+                  StringHash_add(knownExons, keKey, &trueVal);
+                } else {
+                  Exon_freeImpl(newExon2);
                 }
               }
             }
           }
-          if (Vector_getNumElement(newExons) > 1) {
-            // we want to split the score equally across the new exons
-            
-            for (k=0; k<Vector_getNumElement(newExons); k++) {
-              Exon *e = Vector_getElementAt(newExons, k);
-              int m;
-              Vector *support = Exon_getAllSupportingFeatures(e);
-              for (m=0; m<Vector_getNumElement(support); m++) { 
-                BaseAlignFeature *d = Vector_getElementAt(support, m);
-                BaseAlignFeature_setScore(d, BaseAlignFeature_getScore(d) / Vector_getNumElement(newExons));
-              }
-            }
-            
-            //splice( @exons,$i,1,@new_exons);
-            Exon *removedExon = Vector_removeElementAt(exons, j);
-            //Exon_freeImpl(removedExon);
-            //fprintf(stderr,"Removing exon %p %ld %ld at %d\n", removedExon, Exon_getStart(removedExon), Exon_getEnd(removedExon), j);
-            for (k=0; k<Vector_getNumElement(newExons); k++) {
-              Exon *ex = Vector_getElementAt(newExons, k);
-              Vector_insertElementAt(exons, j+k, ex);
-              //fprintf(stderr,"Adding exon %p %ld %ld at %d\n", ex, Exon_getStart(ex), Exon_getEnd(ex), j+k);
+        }
+        if (Vector_getNumElement(newExons) > 1) {
+          // we want to split the score equally across the new exons
+          
+          for (k=0; k<Vector_getNumElement(newExons); k++) {
+            Exon *e = Vector_getElementAt(newExons, k);
+            int m;
+            Vector *support = Exon_getAllSupportingFeatures(e);
+            for (m=0; m<Vector_getNumElement(support); m++) { 
+              BaseAlignFeature *d = Vector_getElementAt(support, m);
+              BaseAlignFeature_setScore(d, BaseAlignFeature_getScore(d) / Vector_getNumElement(newExons));
             }
+          }
+          
+          //splice( @exons,$i,1,@new_exons);
+          Exon *removedExon = Vector_removeElementAt(exons, j);
+          //Exon_freeImpl(removedExon);
+          //fprintf(stderr,"Removing exon %p %ld %ld at %d\n", removedExon, Exon_getStart(removedExon), Exon_getEnd(removedExon), j);
+          for (k=0; k<Vector_getNumElement(newExons); k++) {
+            Exon *ex = Vector_getElementAt(newExons, k);
+            Vector_insertElementAt(exons, j+k, ex);
+            //fprintf(stderr,"Adding exon %p %ld %ld at %d\n", ex, Exon_getStart(ex), Exon_getEnd(ex), j+k);
+          }
 /*  Doesn't seem to do anything
-            for ( my $i = 0 ; $i<= $#exons ; $i++ ) {
-              my $e = $exons[$i];
-            }
+          for ( my $i = 0 ; $i<= $#exons ; $i++ ) {
+            my $e = $exons[$i];
+          }
 */
 /*
-            for (k=j; k<j+Vector_getNumElement(newExons);k++) {
-              Exon *ex = Vector_getElementAt(exons, k);
-              fprintf(stderr,"Added exon %ld %ld at %d\n", Exon_getStart(ex), Exon_getEnd(ex), k);
-            }
-*/
-            //fprintf(logfp, "ADDED %d new exons\n", Vector_getNumElement(newExons));
-            exonCount += (Vector_getNumElement(newExons) -1); // was $#new_exons;
-            // make sure they are all stil sorted
-            // This needs to sort reverse end for equal start to maintain the location of the retained intron version of
-            // the exon before the cut ones
-            Vector_sort(exons, SeqFeature_startRevEndCompFunc);
+          for (k=j; k<j+Vector_getNumElement(newExons);k++) {
+            Exon *ex = Vector_getElementAt(exons, k);
+            fprintf(stderr,"Added exon %ld %ld at %d\n", Exon_getStart(ex), Exon_getEnd(ex), k);
           }
-          Vector_free(newExons);
-        }
-        Vector_free(introns);
-        Vector_free(leftConsIntrons);
-        Vector_free(rightConsIntrons);
-        Vector_free(leftNonConsIntrons);
-        Vector_free(rightNonConsIntrons);
-        Vector_free(filteredIntrons);
-        Vector_free(retainedIntrons);
-        if (!exonUsed) Exon_freeImpl(exon);
-      }
-      StringHash_free(knownExons, NULL);
-      
-      // replaced with if - next unless @exon_intron;
-
-      if (Vector_getNumElement(exonIntron) > 0) {
-
-        // Loop around the path generation, 
-        // if there are too many paths to process return undef
-        // then re-run the path processing but with increasing strictness
-        // where strictness = elimianating alternate low scoring introns
-        if (verbosity > 1) fprintf(stderr, "STRAND %d BEFORE processPaths NUM EXONS %d num in exonIntron = %d\n", strand, Vector_getNumElement(exons), Vector_getNumElement(exonIntron));
-        StringHash *paths = NULL;
-        int strict = 0;
-        while (paths == NULL) {
-          paths = RefineSolexaGenes_processPaths(rsg, exons, exonIntron, intronExon, strict, &giveUpFlag );
-  
-          if (giveUpFlag) {
-            //next GENE if $paths && $paths eq 'Give up';
-            break; // Will use giveUpFlag to stop anything happening after here for this gene (except any necessary freeing of temp data)
-          }
-          strict++;
+*/
+          //fprintf(logfp, "ADDED %d new exons\n", Vector_getNumElement(newExons));
+          exonCount += (Vector_getNumElement(newExons) -1); // was $#new_exons;
+          // make sure they are all stil sorted
+          // This needs to sort reverse end for equal start to maintain the location of the retained intron version of
+          // the exon before the cut ones
+          Vector_sort(exons, SeqFeature_startRevEndCompFunc);
         }
-  
-        if (!giveUpFlag) {
-          if (verbosity > 0) fprintf(stderr, "STRAND %d BEFORE COLLAPSING NUM PATHS = %d NUM EXONS %d\n", strand, StringHash_getNumValues(paths), Vector_getNumElement(exons));
+        Vector_free(newExons);
+      }
+      Vector_free(introns);
+      Vector_free(leftConsIntrons);
+      Vector_free(rightConsIntrons);
+      Vector_free(leftNonConsIntrons);
+      Vector_free(rightNonConsIntrons);
+      Vector_free(filteredIntrons);
+      Vector_free(retainedIntrons);
+      if (!exonUsed) Exon_freeImpl(exon);
+    }
+    StringHash_free(knownExons, NULL);
     
-          char **pathKeys = StringHash_getKeysNoCopy(paths);
-//          char **pathKeys = StringHash_getKeys(paths);
-
-          int nPath = StringHash_getNumValues(paths);
-
-/*
-          int m;
-          IDType totLen = 0;
-          for (m=0;m<StringHash_getNumValues(paths);m++) {
-            totLen+=strlen(pathKeys[m])+1;
-          }
-          fprintf(stderr,"Total length of path strings  = "IDFMTSTR"\n", totLen);
-*/
-
-          // Note reason for making this array to store the paths to delete is to save space - the path strings can take up a lot of memory
-          // so making a copy of the keys is expensive in both space and time terms. It's difficult to use the uncopied strings because we're
-          // removing elements from the hash, so the key strings are freed, but could be used subsequently leading to a seg fault. By storing 
-          // the ones to removed from the hash, and only removing them after the loop has finsihed executing we can avoid that problem.
-          int nPathsToRemove = 0;
-          char **pathsToRemove;
-          if ((pathsToRemove = (char **)calloc(StringHash_getNumValues(paths), sizeof(char *))) == NULL) {
-            fprintf(stderr, "Failed allocating pathsToRemove\n");
-            exit(1);
-          }
-
-          // Perl sorted them , not sure why - maybe longest first???
-          // I didn't see any difference in results after commenting this out, so do without it (hopefully!)
-          //qsort(pathKeys, nPath, sizeof(char *), StrUtil_stringCompFunc);
-
-          int k;
-          // lets collapse redundant paths
-          for (k=0; k<nPath; k++) {
-            char *path = pathKeys[k];
-
-            char **array;
-            int nArray;
-
-            //fprintf(stderr,"PATHS %s\n", path);
-            StrUtil_tokenizeByDelim(&array, &nArray, path, ".");
-
-            char *startP;
-            char *endP;
-            char *middleP;
-            
-            char *start = (char *)calloc(100000,sizeof(char));
-            char *end = (char *)calloc(100000,sizeof(char));
-            char *middle = (char *)calloc(100000,sizeof(char));
-
-            startP  = start;
-            endP    = end;
-            middleP = middle;
-
-            int m;
-            for (m=0; m<nArray; m++)  {
-              //$start .= $array[m] ."."  unless k < 2;
-              int lenArrayM = strlen(array[m]);
-              
-              
-              //if (m>=2) sprintf(start,"%s%s.", start, array[m]);
-              if (m>=2) {
-                memcpy(startP, array[m], lenArrayM);
-                startP+=lenArrayM;
-                *startP++ = '.';
-              }
-
-              //$middle .= $array[m] ."." unless m < 2  or m >= $#array-1 ;
-              //if (m>=2 && m<nArray-2) sprintf(middle,"%s%s.",middle, array[m]);
-              if (m>=2 && m<nArray-2) {
-                memcpy(middleP, array[m], lenArrayM);
-                middleP+=lenArrayM;
-                *middleP++ = '.';
-              }
-
-              //$end .= $array[m] . "." unless m >= $#array-1;
-              //if (m<nArray-2) sprintf(end,"%s%s.", end, array[m]);
-              if (m<nArray-2) {
-                memcpy(endP, array[m], lenArrayM); // Note +1 is so we copy '\0' 
-                endP+=lenArrayM;
-                *endP++ = '.';
-              }
-            }
-            *startP  = '\0';
-            *endP    = '\0';
-            *middleP = '\0';
-
-            // remove redundancy from the array
-            //delete $paths->{$start} if $start && $paths->{$start};
-            char *keyP;
-            if (start[0] != '\0' && (keyP = StringHash_getKey(paths, start)) != NULL) {
-              //StringHash_remove(paths, start, NULL);
-              //fprintf(stderr,"Adding start path %s\n", keyP);
-              pathsToRemove[nPathsToRemove++] = keyP;
-            }
-
-            // delete $paths->{$end} if $end && $paths->{$end};
-            if (end[0] != '\0' && (keyP = StringHash_getKey(paths, end)) != NULL) {
-              //StringHash_remove(paths, end, NULL);
-              //fprintf(stderr,"Adding end path %s\n", keyP);
-              pathsToRemove[nPathsToRemove++] = keyP;
-            }
-
-            //delete $paths->{$middle} if $middle && $paths->{$middle};
-            if (middle[0] != '\0' && (keyP = StringHash_getKey(paths, middle)) != NULL) {
-              //StringHash_remove(paths, middle, NULL);
-              //fprintf(stderr,"Adding middle path %s\n", keyP);
-              pathsToRemove[nPathsToRemove++] = keyP;
-            }
+    // replaced with if - next unless @exon_intron;
+
+    if (Vector_getNumElement(exonIntron) > 0) {
+
+      // Loop around the path generation, 
+      // if there are too many paths to process return undef
+      // then re-run the path processing but with increasing strictness
+      // where strictness = elimianating alternate low scoring introns
+      if (verbosity > 1) fprintf(stderr, "STRAND %d BEFORE processPaths NUM EXONS %d num in exonIntron = %d\n", strand, Vector_getNumElement(exons), Vector_getNumElement(exonIntron));
+      Vector *paths = NULL;
+      PathGraph *pathGraph = NULL;
+      int strict = 0;
+      while (paths == NULL) {
+        paths = RefineSolexaGenes_processPaths(rsg, exons, exonIntron, intronExon, strict, &pathGraph, &giveUpFlag );
+
+        if (giveUpFlag) {
+          //next GENE if $paths && $paths eq 'Give up';
+          break; // Will use giveUpFlag to stop anything happening after here for this gene (except any necessary freeing of temp data)
+        }
+        strict++;
+      }
 
-            for (m=0;m<nArray;m++) {
-              free(array[m]);
-            }
-            free(array);
-            free(start);
-            free(end);
-            free(middle);
-          }
-          
-          //fprintf(stderr, "Have %d paths to remove\n", nPathsToRemove);
-          qsort(pathsToRemove, nPathsToRemove, sizeof(char *), pointer_compFunc); // Note pointer sort NOT string sort
-          for (k=0; k<nPathsToRemove; k++) {
-            if (!k || pathsToRemove[k] != pathsToRemove[k-1]) {
-              //fprintf(stderr, "Removing path |%s| (pointer %p)\n", pathsToRemove[k], pathsToRemove[k]);
-              StringHash_remove(paths, pathsToRemove[k], NULL);
-            }
-          }
+      if (!giveUpFlag) {
+        // The perl made paths starting at every exon and then removed the ones which were part of a longer path. The paths
+        // from processPaths only start at exons with no intron on their left, so there's nothing to collapse
+        if (verbosity > 0) fprintf(stderr, "STRAND %d NUM PATHS = %d NUM EXONS %d\n", strand, Vector_getNumElement(paths), Vector_getNumElement(exons));
+       
+        Vector *strandModels = RefineSolexaGenes_makeModels(rsg, paths, pathGraph, strand, exons, gene);
 
-          //for (k=0; k<nPath; k++) {
-          //  free(pathKeys[k]);
-          //}
-          free(pathKeys);
-          free(pathsToRemove);
-          
-          if (verbosity > 0) fprintf(stderr, "AFTER COLLAPSING NUM PATHS  = %d NUM EXONS = %d\n", StringHash_getNumValues(paths), Vector_getNumElement(exons));
-         
-          Vector *strandModels = RefineSolexaGenes_makeModels(rsg, paths, strand, exons, gene, intronHash);
+        Vector_append(models, strandModels);
+        Vector_free(strandModels);
   
-          Vector_append(models, strandModels);
-          Vector_free(strandModels);
-    
-          //fprintf(stderr, "Now have %d models\n", Vector_getNumElement(models));
-        }
+        //fprintf(stderr, "Now have %d models\n", Vector_getNumElement(models));
+      }
 
-        if (paths) {
-          StringHash_free(paths, NULL);
-          //fprintf(stderr,"Freeing paths %p\n",paths);
-        }
+      if (paths) {
+        Vector_free(paths);
       }
+      if (pathGraph) {
+        PathGraph_free(pathGraph);
+      }
+    }
 
 // NIY: Things to free
 // exonIntron
-      Vector_setFreeFunc(exonIntron, Vector_free);
-      Vector_free(exonIntron);
+    Vector_setFreeFunc(exonIntron, Vector_free);
+    Vector_free(exonIntron);
 // intronExon
-      StringHash_free(intronExon, Vector_free);
-// intronHash
-      StringHash_free(intronHash, NULL);
+    StringHash_free(intronExon, Vector_free);
 
-      Vector_setFreeFunc(exons, Exon_freeImpl);
-      Vector_free(exons);
-    }
+    Vector_setFreeFunc(exons, Exon_freeImpl);
+    Vector_free(exons);
+  }
 
-    //fprintf(stderr, "Give up flag = %d\n", giveUpFlag);
+  //fprintf(stderr, "Give up flag = %d\n", giveUpFlag);
 
-    // recursively recluster the models to identify 'other' models 
-    // with no overlap to the 'best' model
-    if (!giveUpFlag) {
-      int modelCount = 0;
-      Vector *clusteredModels;
-      Vector *newClusters;
-  
-      clusteredModels = RefineSolexaGenes_reclusterModels(rsg, models, &newClusters);
-  
-      Vector *cleanClusters = Vector_new();
-      
-  // NIY: Nightmare to deal with memory freeing here
-      if (newClusters != NULL && Vector_getNumElement(newClusters)) {
-        while (Vector_getNumElement(newClusters)) {
-          Vector_append(cleanClusters, clusteredModels);
-          Vector_free(clusteredModels);
-          Vector *oldNewClusters = newClusters;
-          clusteredModels = RefineSolexaGenes_reclusterModels(rsg, newClusters, &newClusters);
-          Vector_free(oldNewClusters);
-          //fprintf(stderr, "Now have %d new clusters after reclustering\n", Vector_getNumElement(newClusters));
-        }
-        Vector_free(newClusters);
-      } else if (newClusters != NULL) {
-        Vector_free(newClusters);
-      }
-  
-      if (clusteredModels != NULL) {
-        if (Vector_getNumElement(clusteredModels)) {
-          Vector_append(cleanClusters, clusteredModels);
-        }
+  // recursively recluster the models to identify 'other' models 
+  // with no overlap to the 'best' model
+  if (!giveUpFlag) {
+    int modelCount = 0;
+    Vector *clusteredModels;
+    Vector *newClusters;
+
+    clusteredModels = RefineSolexaGenes_reclusterModels(rsg, models, &newClusters);
+
+    Vector *cleanClusters = Vector_new();
+    
+// NIY: Nightmare to deal with memory freeing here
+    if (newClusters != NULL && Vector_getNumElement(newClusters)) {
+      while (Vector_getNumElement(newClusters)) {
+        Vector_append(cleanClusters, clusteredModels);
         Vector_free(clusteredModels);
+        Vector *oldNewClusters = newClusters;
+        clusteredModels = RefineSolexaGenes_reclusterModels(rsg, newClusters, &newClusters);
+        Vector_free(oldNewClusters);
+        //fprintf(stderr, "Now have %d new clusters after reclustering\n", Vector_getNumElement(newClusters));
       }
-      
-      // filter to identify 'best', 'other' and 'bad' models
-      //fprintf(stderr,"XXXXXXXXXXXXX Have %d in cleanClusters\n", Vector_getNumElement(cleanClusters));
+      Vector_free(newClusters);
+    } else if (newClusters != NULL) {
+      Vector_free(newClusters);
+    }
+
+    if (clusteredModels != NULL) {
+      if (Vector_getNumElement(clusteredModels)) {
+        Vector_append(cleanClusters, clusteredModels);
+      }
+      Vector_free(clusteredModels);
+    }
+    
+    // filter to identify 'best', 'other' and 'bad' models
+    //fprintf(stderr,"XXXXXXXXXXXXX Have %d in cleanClusters\n", Vector_getNumElement(cleanClusters));
 //      int nFinal = 0;
 //      int x;
 //      for (x=0;x<Vector_getNumElement(cleanClusters);x++) {
 //        ModelCluster *mc = Vector_getElementAt(cleanClusters, x);
 //        if (mc->finalModels) nFinal += Vector_getNumElement(mc->finalModels);
 //      }
-      //fprintf(stderr,"Number of final models in CLEAN clusters = %d\n", nFinal);
+    //fprintf(stderr,"Number of final models in CLEAN clusters = %d\n", nFinal);
 
-      RefineSolexaGenes_filterModels(rsg, cleanClusters);
-      //Vector_setFreeFunc(cleanClusters, ModelCluster_free);
-      Vector_free(cleanClusters);
-  
-      // process single exon models
-      // if it has no introns on either strand
-      if (RefineSolexaGenes_getSingleExonModelType(rsg) && singleExon == 2) {
-        Vector *merged = RefineSolexaGenes_mergeExons(rsg, gene, 1);
-        Exon *exon = Vector_getElementAt(merged, 0);
+    RefineSolexaGenes_filterModels(rsg, cleanClusters);
+    //Vector_setFreeFunc(cleanClusters, ModelCluster_free);
+    Vector_free(cleanClusters);
+
+    // process single exon models
+    // if it has no introns on either strand
+    if (RefineSolexaGenes_getSingleExonModelType(rsg) && singleExon == 2) {
+      Vector *merged = RefineSolexaGenes_mergeExons(rsg, gene, 1);
+      Exon *exon = Vector_getElementAt(merged, 0);
+
+      Vector_free(merged);
 
-        Vector_free(merged);
+      Transcript *singleExonModel = NULL;
+      //fprintf(stderr, " Single exon = %d\n", singleExon);
   
-        Transcript *singleExonModel = NULL;
-        //fprintf(stderr, " Single exon = %d\n", singleExon);
-    
-        if (Exon_getLength(exon) + 40 >= RefineSolexaGenes_getMinSingleExonLength(rsg)) {
+      if (Exon_getLength(exon) + 40 >= RefineSolexaGenes_getMinSingleExonLength(rsg)) {
 /*
-          fprintf(stderr, "Passed length filter - exon start %ld end %ld length %ld\n", 
-                  Exon_getStart(exon), Exon_getEnd(exon), Exon_getLength(exon));
+        fprintf(stderr, "Passed length filter - exon start %ld end %ld length %ld\n", 
+                Exon_getStart(exon), Exon_getEnd(exon), Exon_getLength(exon));
 */
-          // trim padding 
-    // ?? Is padding always 20 ??
-          Exon_setStart(exon,  Exon_getStart(exon) + 20);
-          Exon_setEnd(exon,  Exon_getEnd(exon) - 20);
-    
-          // trim away strings of Ns from the start and  end
-          // check start
-          char *exSeq = Exon_getSeqString(exon);
+        // trim padding 
+  // ?? Is padding always 20 ??
+        Exon_setStart(exon,  Exon_getStart(exon) + 20);
+        Exon_setEnd(exon,  Exon_getEnd(exon) - 20);
+  
+        // trim away strings of Ns from the start and  end
+        // check start
+        char *exSeq = Exon_getSeqString(exon);
 
-          int nN;
-          for (nN=0; nN<Exon_getLength(exon) && exSeq[nN] == 'N'; nN++) { }
-          
-          if (nN) {
-            Exon_setStart(exon, Exon_getStart(exon) + nN);
-          }
+        int nN;
+        for (nN=0; nN<Exon_getLength(exon) && exSeq[nN] == 'N'; nN++) { }
+        
+        if (nN) {
+          Exon_setStart(exon, Exon_getStart(exon) + nN);
+        }
 
-          // check end
-          StrUtil_reverseString(exSeq, strlen(exSeq));
-          for (nN=0; nN<Exon_getLength(exon) && exSeq[nN] == 'N'; nN++) { }
-          if (nN) {
-            Exon_setEnd(exon, Exon_getEnd(exon) - nN);
-          }
-          // NIY: Not sure if I need to free exSeq
-         
-          // get the cds
-          Exon *fwdExon =  ExonUtils_cloneExon(exon);
-          Exon_setStrand(fwdExon, 1);
-    
-          Exon *revExon = ExonUtils_cloneExon(exon);
-    
-          Transcript *fwdT = Transcript_new();
-          Transcript_addExon(fwdT, fwdExon, 0);
-          //my $fwd_t =  new Bio::EnsEMBL::Transcript(-EXONS => [$fwd_exon]);
-          
+        // check end
+        StrUtil_reverseString(exSeq, strlen(exSeq));
+        for (nN=0; nN<Exon_getLength(exon) && exSeq[nN] == 'N'; nN++) { }
+        if (nN) {
+          Exon_setEnd(exon, Exon_getEnd(exon) - nN);
+        }
+        // NIY: Not sure if I need to free exSeq
+       
+        // get the cds
+        Exon *fwdExon =  ExonUtils_cloneExon(exon);
+        Exon_setStrand(fwdExon, 1);
+  
+        Exon *revExon = ExonUtils_cloneExon(exon);
+  
+        Transcript *fwdT = Transcript_new();
+        Transcript_addExon(fwdT, fwdExon, 0);
+        //my $fwd_t =  new Bio::EnsEMBL::Transcript(-EXONS => [$fwd_exon]);
+        
 // There were two more rounds of cloning here which seemed a bit excessive - I can't see why I need any 
-       //   my $fwd_tran = TranscriptUtils_computeTranslation(clone_Transcript($fwdT));
-          Transcript *fwdTran = TranslationUtils_computeTranslation(fwdT);
-          
-          long fwdTLen = 0;
-          if (Transcript_getTranslation(fwdTran)) {
-            fwdTLen = Translation_getGenomicEnd(Transcript_getTranslation(fwdTran)) - Translation_getGenomicStart(Transcript_getTranslation(fwdTran));
-          }
+     //   my $fwd_tran = TranscriptUtils_computeTranslation(clone_Transcript($fwdT));
+        Transcript *fwdTran = TranslationUtils_computeTranslation(fwdT);
+        
+        long fwdTLen = 0;
+        if (Transcript_getTranslation(fwdTran)) {
+          fwdTLen = Translation_getGenomicEnd(Transcript_getTranslation(fwdTran)) - Translation_getGenomicStart(Transcript_getTranslation(fwdTran));
+        }
 
-          //fprintf(stderr, "FWD translation length %ld\n", fwdTLen);
-          Transcript *revT = Transcript_new();
-          Transcript_addExon(revT, revExon, 0);
-          //my $rev_t =  new Bio::EnsEMBL::Transcript(-EXONS => [$rev_exon]);
-          
-         // my $rev_tran = compute_translation(clone_Transcript($rev_t));
-          Transcript *revTran = TranslationUtils_computeTranslation(revT);
-          
-          long revTLen = 0;
-          if (Transcript_getTranslation(revTran)) {
-            revTLen = Translation_getGenomicEnd(Transcript_getTranslation(revTran)) - Translation_getGenomicStart(Transcript_getTranslation(revTran));
-          }
-    
-          //fprintf(stderr, "REV translation length %ld\n", revTLen);
-          if ( Transcript_getTranslation(fwdTran) &&  
-               ( (double)fwdTLen / (double)Transcript_getLength(fwdTran)* 100.0 >= RefineSolexaGenes_getMinSingleExonCDSPercLength(rsg) &&
-               fwdTLen >  revTLen )) {
-            // keep this one
-            singleExonModel =  fwdTran;
-
-            Transcript_free(revTran);
-            revTran = NULL;
-          }
-    
-          if ( !singleExonModel && Transcript_getTranslation(revTran) &&  
-               ( (double)revTLen / (double)Transcript_getLength(revTran)* 100.0 >= RefineSolexaGenes_getMinSingleExonCDSPercLength(rsg) &&
-               revTLen >  fwdTLen )) {
-            // keep this one
-            singleExonModel =  revTran;
-
-            Transcript_free(fwdTran);
-            fwdTran = NULL;
-          }
+        //fprintf(stderr, "FWD translation length %ld\n", fwdTLen);
+        Transcript *revT = Transcript_new();
+        Transcript_addExon(revT, revExon, 0);
+        //my $rev_t =  new Bio::EnsEMBL::Transcript(-EXONS => [$rev_exon]);
+        
+       // my $rev_tran = compute_translation(clone_Transcript($rev_t));
+        Transcript *revTran = TranslationUtils_computeTranslation(revT);
+        
+        long revTLen = 0;
+        if (Transcript_getTranslation(revTran)) {
+          revTLen = Translation_getGenomicEnd(Transcript_getTranslation(revTran)) - Translation_getGenomicStart(Transcript_getTranslation(revTran));
+        }
+  
+        //fprintf(stderr, "REV translation length %ld\n", revTLen);
+        if ( Transcript_getTranslation(fwdTran) &&  
+             ( (double)fwdTLen / (double)Transcript_getLength(fwdTran)* 100.0 >= RefineSolexaGenes_getMinSingleExonCDSPercLength(rsg) &&
+             fwdTLen >  revTLen )) {
+          // keep this one
+          singleExonModel =  fwdTran;
+
+          Transcript_free(revTran);
+          revTran = NULL;
+        }
+  
+        if ( !singleExonModel && Transcript_getTranslation(revTran) &&  
+             ( (double)revTLen / (double)Transcript_getLength(revTran)* 100.0 >= RefineSolexaGenes_getMinSingleExonCDSPercLength(rsg) &&
+             revTLen >  fwdTLen )) {
+          // keep this one
+          singleExonModel =  revTran;
+
+          Transcript_free(fwdTran);
+          fwdTran = NULL;
+        }
 
-          if (singleExonModel == NULL) {
-            if (fwdTran != NULL) Transcript_free(fwdTran);
-            if (revTran != NULL) Transcript_free(revTran);
-          }
-    
-          if (singleExonModel != NULL) {
-            //fprintf(stderr, "Making single exon model\n");
-            Transcript_setAnalysis(singleExonModel, RefineSolexaGenes_getAnalysis(rsg));
-            Transcript_setVersion(singleExonModel, 1);
-    
-    // Was convert_to_genes which returned an array ref - make one which just returns a single gene
-            Gene *newGene = TranscriptUtils_convertToGene(singleExonModel, Gene_getAnalysis(gene), NULL);
-    
-            Gene_setBiotype(newGene, RefineSolexaGenes_getSingleExonModelType(rsg));
-    
-            // score comes from exon supporting feature;
-            Vector *support = Exon_getAllSupportingFeatures(exon);
-            double score =  BaseAlignFeature_getScore((BaseAlignFeature *)Vector_getElementAt(support, 0));
-            Exon_flushSupportingFeatures(exon);
-    
-            char stableId[2048];
-            sprintf(stableId, "%s-v1-%d", Gene_getStableId(gene), (int)score);
-            Gene_setStableId(newGene, stableId);
-    
-            //push @{$self->output} , $new_gene;
-            RefineSolexaGenes_addToOutput(rsg, newGene);
-          }
-          Exon_free(exon);
+        if (singleExonModel == NULL) {
+          if (fwdTran != NULL) Transcript_free(fwdTran);
+          if (revTran != NULL) Transcript_free(revTran);
+        }
+  
+        if (singleExonModel != NULL) {
+          //fprintf(stderr, "Making single exon model\n");
+          Transcript_setAnalysis(singleExonModel, RefineSolexaGenes_getAnalysis(rsg));
+          Transcript_setVersion(singleExonModel, 1);
+  
+  // Was convert_to_genes which returned an array ref - make one which just returns a single gene
+          Gene *newGene = TranscriptUtils_convertToGene(singleExonModel, Gene_getAnalysis(gene), NULL);
+  
+          Gene_setBiotype(newGene, RefineSolexaGenes_getSingleExonModelType(rsg));
+  
+          // score comes from exon supporting feature;
+          Vector *support = Exon_getAllSupportingFeatures(exon);
+          double score =  BaseAlignFeature_getScore((BaseAlignFeature *)Vector_getElementAt(support, 0));
+          Exon_flushSupportingFeatures(exon);
+  
+          char stableId[2048];
+          sprintf(stableId, "%s-v1-%d", Gene_getStableId(gene), (int)score);
+          Gene_setStableId(newGene, stableId);
+  
+          //push @{$self->output} , $new_gene;
+          RefineSolexaGenes_addToOutput(rsg, newGene);
         }
+        Exon_free(exon);
       }
     }
+  }
 // NIY: Any freeing/tidying for a gene's worth of processing should go here
 
 // NIY: Do we need to free models contents too??
-    Vector_setFreeFunc(models, ModelCluster_free);
-    //fprintf(stderr,"XXXXXXXXXXXXXXX Have %d in models\n", Vector_getNumElement(models));
+  Vector_setFreeFunc(models, ModelCluster_free);
+  //fprintf(stderr,"XXXXXXXXXXXXXXX Have %d in models\n", Vector_getNumElement(models));
 //    int nFinal = 0;
 //    int x;
 //    for (x=0;x<Vector_getNumElement(models);x++) {
 //      ModelCluster *mc = Vector_getElementAt(models, x);
 //      if (mc->finalModels) nFinal += Vector_getNumElement(mc->finalModels);
 //    }
-    //fprintf(stderr,"Number of final models in all clusters = %d\n", nFinal);
-    Vector_free(models);
-    MallocExtension_ReleaseFreeMemory();
+  //fprintf(stderr,"Number of final models in all clusters = %d\n", nFinal);
+  Vector_free(models);
+  StringHash_free(geneIntrons, DNAAlignFeature_freeImpl);
+  MallocExtension_ReleaseFreeMemory();
+}
+
+/*
+  The intron features are shared by all the genes, which may be being refined
+  in different threads, but processPaths renames the introns it eliminates
+  (adding -REMOVED to the hit seq name). So each gene works on its own copies,
+  made the first time it sees each intron. Replaces the introns in the vector
+  with the gene's copies.
+*/
+Vector *RefineSolexaGenes_localiseIntrons(RefineSolexaGenes *rsg, Vector *introns, StringHash *geneIntrons) {
+  int i;
+
+  for (i=0; i<Vector_getNumElement(introns); i++) {
+    DNAAlignFeature *intron = Vector_getElementAt(introns, i);
+    char *hseqname = DNAAlignFeature_getHitSeqName(intron);
+    DNAAlignFeature *geneIntron;
+
+    if (StringHash_contains(geneIntrons, hseqname)) {
+      geneIntron = StringHash_getValue(geneIntrons, hseqname);
+    } else {
+      geneIntron = DNAAlignFeature_deepCopy(intron);
+      StringHash_add(geneIntrons, hseqname, geneIntron);
+    }
+    Vector_setElementAt(introns, i, geneIntron);
+  }
+
+  return introns;
+}
+
+/*
+  Fills in everything which the gene refining code would otherwise set up
+  lazily the first time it's used, so the refineGene tasks only ever read it.
+  Lazily made DB adaptors and caches would otherwise be created by whichever
+  thread got there first.
+*/
+void RefineSolexaGenes_prepareForThreads(RefineSolexaGenes *rsg) {
+  Slice *chrSlice = RefineSolexaGenes_getChrSlice(rsg);
+  Vector *prelimGenes = RefineSolexaGenes_getPrelimGenes(rsg);
+  int i;
+
+  RefineSolexaGenes_getExtraExonsKeys(rsg);
+  RefineSolexaGenes_getExtraExonsValues(rsg);
+
+  // Codon table, and the sequence cache for the chromosome, used by exon seq fetches and translations
+  Slice_getCodonTableId(chrSlice);
+  DBAdaptor *dba = Slice_getAdaptor(chrSlice)->dba;
+  char *seq = CachingSequenceAdaptor_fetchBySliceStartEndStrand(DBAdaptor_getCachingSequenceAdaptor(dba), chrSlice, 1, 1, 1);
+  free(seq);
+
+  // Supporting features of the prelim gene exons are loaded from the db on first access (in ExonUtils_cloneExon)
+  for (i=0; i<Vector_getNumElement(prelimGenes); i++) {
+    Gene *gene = Vector_getElementAt(prelimGenes, i);
+    int j;
+    for (j=0; j<Gene_getTranscriptCount(gene); j++) {
+      Transcript *trans = Gene_getTranscriptAt(gene, j);
+      int k;
+      for (k=0; k<Transcript_getExonCount(trans); k++) {
+        Exon *exon = Transcript_getExonAt(trans, k);
+        Exon_getAllSupportingFeatures(exon);
+      }
+    }
   }
 }
 
@@ -2671,20 +3549,17 @@ void RefineSolexaGenes_filterModels(RefineSolexaGenes *rsg, Vector *clusters) {
 =cut
 */
 
-Vector *RefineSolexaGenes_makeModels(RefineSolexaGenes *rsg, StringHash *paths, int strand, Vector *exons, Gene *gene, StringHash *intronHash) {
-  // paths are stored as text - turn them into arrays of features "models"
+Vector *RefineSolexaGenes_makeModels(RefineSolexaGenes *rsg, Vector *paths, PathGraph *pathGraph, int strand, Vector *exons, Gene *gene) {
+  // paths are lists of graph node numbers - turn them into arrays of features "models"
   Vector *clusters = Vector_new();
   Vector *models = Vector_new();
 // Unused Vector *genes = Vector_new();
 
-  char **pathKeys = StringHash_getKeys(paths);
-  int nPath = StringHash_getNumValues(paths);
+  int nPath = Vector_getNumElement(paths);
 
   int i;
   for (i=0; i<nPath; i++) {
-    char *path = pathKeys[i];
-
-    char exonUse[8000]; exonUse[0] = '\0';
+    Path *path = Vector_getElementAt(paths, i);
 
     Model *model;
     if ((model = (Model *)calloc(1,sizeof(Model))) == NULL) {
@@ -2692,32 +3567,28 @@ Vector *RefineSolexaGenes_makeModels(RefineSolexaGenes *rsg, StringHash *paths,
       exit(1);
     } 
 
+    // Room for each exon index and its '.'
+    char *exonUse;
+    if ((exonUse = (char *)calloc(path->nNode * 12 + 1, sizeof(char))) == NULL) {
+      fprintf(stderr,"Failed allocating exonUse\n");
+      exit(1);
+    } 
+    char *exonUseP = exonUse;
+
     model->features = Vector_new();
     double exonScore = 0;
     double intronScore = 0;
 
-    char **featureStrings;
-    int nFeatureString;
-
-    StrUtil_tokenizeByDelim(&featureStrings, &nFeatureString, path, ".");
-
-    //fprintf(stderr, "path to make model from is %s\n", path);
-
     int j;
-    for (j=0; j<nFeatureString; j++)  {
-      char *featureString = featureStrings[j];
-      if (strstr(featureString, "canon")) { // Intron
-        DNAAlignFeature *intron = StringHash_getValue(intronHash, featureString);
-        if (intron == NULL) {
-          fprintf(stderr, "Couldn't find intron in intronHash. Key = %s\n",featureString);
-        }
+    for (j=0; j<path->nNode; j++)  {
+      int node = path->nodes[j];
+      if (node >= pathGraph->nExon) { // Intron
+        DNAAlignFeature *intron = pathGraph->introns[node - pathGraph->nExon];
         Vector_addElement(model->features, intron);
         intronScore += DNAAlignFeature_getScore(intron);
       } else { // Exon
-        sprintf(exonUse, "%s%s.",exonUse, featureString);
-        int exonInd;
-        sscanf(featureString, "%d", &exonInd);
-        Exon *exon = Vector_getElementAt(exons, exonInd);
+        exonUseP += sprintf(exonUseP, "%d.", node);
+        Exon *exon = Vector_getElementAt(exons, node);
         Vector_addElement(model->features, exon);
 
         Vector *support = Exon_getAllSupportingFeatures(exon);
@@ -2729,27 +3600,16 @@ Vector *RefineSolexaGenes_makeModels(RefineSolexaGenes *rsg, StringHash *paths,
       }
     }
 
-    for (j=0; j<nFeatureString; j++)  {
-      free(featureStrings[j]);
-    }
-    free(featureStrings);
-
-
     double totalScore = ((int)exonScore)/100 + intronScore;
     // last elements are the strand and score
     
-    StrUtil_copyString(&model->exonUse, exonUse, 0);
+    model->exonUse = exonUse;
     model->totalScore = totalScore;
     Vector_addElement(models, model);
 
     // NIY: Free stuff
   }
 
-  for (i=0; i<nPath; i++) {
-    free(pathKeys[i]);
-  }
-  free(pathKeys);
-
   //fprintf(logfp, "Starting model_cluster\n");
   // now lets cluster the models so that they are non overlapping
   // and return the clusters arranged by score
@@ -3772,145 +4632,484 @@ void RefineSolexaGenes_writeOutput(RefineSolexaGenes *rsg) {
 // Was 'eval'ed
     GeneAdaptor_store(geneAdaptor, gene, 1);
 /*
-    if ($@){
-      warning("Unable to store gene!!\n$@");
-      $fails++;
-    }
+    if ($@){
+      warning("Unable to store gene!!\n$@");
+      $fails++;
+    }
+*/
+    total++;
+  }
+
+// Can't be any currently, but maybe should be possible to trap errors
+  if (fails > 0) {
+    fprintf(stderr, "Not all genes could be written successfully (%d fails out of %d)\n", fails, total);
+  }
+
+  if (verbosity > 0) fprintf(stderr, "Writing dna_align_features\n");
+  if (RefineSolexaGenes_writeIntrons(rsg)) {
+    DNAAlignFeatureAdaptor *intronAdaptor = DBAdaptor_getDNAAlignFeatureAdaptor(outdb);
+    fails = 0;
+    total = 0;
+   
+    Vector *intronFeatures = RefineSolexaGenes_getIntronFeatures(rsg);
+    // Only the introns starting in this unit's core - the padding overlaps the neighbouring units
+    Vector *storeIntrons = Vector_new();
+  
+    for (i=0; i<Vector_getNumElement(intronFeatures); i++) {
+      DNAAlignFeature *intron = Vector_getElementAt(intronFeatures, i);
+
+      // intron features are on the chromosome slice so their coords are seq region coords
+      if (rsg->coreEnd > 0 && (DNAAlignFeature_getStart(intron) < rsg->coreStart || DNAAlignFeature_getStart(intron) > rsg->coreEnd)) {
+        continue;
+      }
+      Vector_addElement(storeIntrons, intron);
+  
+  // SMJS If want to edge match in apollo comment out these two lines
+      DNAAlignFeature_setStart(intron, DNAAlignFeature_getStart(intron) + 1);
+      DNAAlignFeature_setEnd(intron, DNAAlignFeature_getEnd(intron) - 1);
+  //    eval {
+  // tmpVec is just so can use _store method which takes a vector not a feature
+  /* SMJS Perl did one at a time - I'm going to do all in one go after loop, so I don't have to make these temporary vectors
+      Vector *tmpVec = Vector_new();
+      Vector_addElement(tmpVec, intron);
+      DNAAlignFeatureAdaptor_store(intronAdaptor, tmpVec);
+      Vector_free(tmpVec);
+  */
+  //    };
+  
+  //    if ($@){
+  //      warning("Unable to store DnaAlignFeature!!\n$@");
+  //      $fails++;
+  //    }
+      total++;
+    }
+  
+  // SMJS Moved from within loop - store all features in intronFeatures in one call
+    DNAAlignFeatureAdaptor_store(intronAdaptor, storeIntrons);
+    Vector_free(storeIntrons);
+  
+    if (fails > 0) {
+      fprintf(stderr, "Not all introns could be written successfully (%d fails out of %d)\n", fails, total);
+    }
+  } else {
+    fprintf(stderr, "NOTE: Not writing DNAAlignFeatures for introns\n");
+  }
+}
+
+
+/*
+  The possible paths through a gene are worked out on a PathGraph of exons and
+  introns rather than the perl's strings of dot separated exon indexes and intron
+  names. Paths only start at exons which have no intron on their left (the perl
+  started from every exon and collapsed the partial paths afterwards), and the
+  number of paths is counted from the graph before any are made, so a gene with
+  too many possibilities is detected without enumerating them.
+*/
+PathGraph *PathGraph_new(Vector *exons) {
+  PathGraph *pg;
+  int i;
+
+  if ((pg = (PathGraph *)calloc(1,sizeof(PathGraph))) == NULL) {
+    fprintf(stderr,"Failed allocating PathGraph\n");
+    exit(1);
+  }
+
+  pg->nExon = Vector_getNumElement(exons);
+  pg->nNode = pg->nExon;
+  pg->nodeAlloc = pg->nExon + 16;
+
+  if ((pg->introns    = (DNAAlignFeature **)calloc(pg->nodeAlloc, sizeof(DNAAlignFeature *))) == NULL ||
+      (pg->scores     = (double *)calloc(pg->nodeAlloc, sizeof(double))) == NULL ||
+      (pg->nParent    = (int *)calloc(pg->nodeAlloc, sizeof(int))) == NULL ||
+      (pg->nChild     = (int *)calloc(pg->nodeAlloc, sizeof(int))) == NULL ||
+      (pg->childAlloc = (int *)calloc(pg->nodeAlloc, sizeof(int))) == NULL ||
+      (pg->children   = (int **)calloc(pg->nodeAlloc, sizeof(int *))) == NULL) {
+    fprintf(stderr,"Failed allocating PathGraph nodes\n");
+    exit(1);
+  }
+
+  pg->intronNodes = StringHash_new(STRINGHASH_SMALL);
+
+  // Exon scores are on the same basis as the model scores in makeModels
+  for (i=0; i<pg->nExon; i++) {
+    Exon *exon = Vector_getElementAt(exons, i);
+    Vector *support = Exon_getAllSupportingFeatures(exon);
+    double exonScore = 0;
+    int j;
+    for (j=0; j<Vector_getNumElement(support); j++) {
+      BaseAlignFeature *baf = Vector_getElementAt(support, j);
+      exonScore += BaseAlignFeature_getScore(baf);
+    }
+    pg->scores[i] = exonScore / 100;
+  }
+
+  return pg;
+}
+
+/*
+  Returns the node for the intron, adding one if this is the first time this
+  intron (by HitSeqName) has been seen
+*/
+int PathGraph_getIntronNode(PathGraph *pg, DNAAlignFeature *intron) {
+  char *hseqname = DNAAlignFeature_getHitSeqName(intron);
+
+  if (StringHash_contains(pg->intronNodes, hseqname)) {
+    return (int)*((long *)StringHash_getValue(pg->intronNodes, hseqname));
+  }
+
+  if (pg->nNode == pg->nodeAlloc) {
+    int newAlloc = pg->nodeAlloc * 2;
+
+    if ((pg->scores     = (double *)realloc(pg->scores, newAlloc * sizeof(double))) == NULL ||
+        (pg->nParent    = (int *)realloc(pg->nParent, newAlloc * sizeof(int))) == NULL ||
+        (pg->nChild     = (int *)realloc(pg->nChild, newAlloc * sizeof(int))) == NULL ||
+        (pg->childAlloc = (int *)realloc(pg->childAlloc, newAlloc * sizeof(int))) == NULL ||
+        (pg->children   = (int **)realloc(pg->children, newAlloc * sizeof(int *))) == NULL ||
+        (pg->introns    = (DNAAlignFeature **)realloc(pg->introns, (newAlloc - pg->nExon) * sizeof(DNAAlignFeature *))) == NULL) {
+      fprintf(stderr,"Failed reallocating PathGraph nodes\n");
+      exit(1);
+    }
+    pg->nodeAlloc = newAlloc;
+  }
+
+  int node = pg->nNode++;
+
+  pg->introns[node - pg->nExon] = intron;
+  pg->scores[node]     = DNAAlignFeature_getScore(intron);
+  pg->nParent[node]    = 0;
+  pg->nChild[node]     = 0;
+  pg->childAlloc[node] = 0;
+  pg->children[node]   = NULL;
+
+  StringHash_add(pg->intronNodes, hseqname, long_new(node));
+
+  return node;
+}
+
+void PathGraph_addEdge(PathGraph *pg, int from, int to) {
+  int i;
+
+  for (i=0; i<pg->nChild[from]; i++) {
+    if (pg->children[from][i] == to) {
+      return;
+    }
+  }
+
+  if (pg->nChild[from] == pg->childAlloc[from]) {
+    pg->childAlloc[from] = pg->childAlloc[from] ? pg->childAlloc[from] * 2 : 4;
+    if ((pg->children[from] = (int *)realloc(pg->children[from], pg->childAlloc[from] * sizeof(int))) == NULL) {
+      fprintf(stderr,"Failed reallocating PathGraph children\n");
+      exit(1);
+    }
+  }
+
+  pg->children[from][pg->nChild[from]++] = to;
+  pg->nParent[to]++;
+}
+
+/*
+  Returns the nodes ordered so every node comes before all its children, or
+  NULL if the graph has a cycle (which it shouldn't, see PathGraph)
+*/
+int *PathGraph_topologicalOrder(PathGraph *pg) {
+  int *order;
+  int *nParentLeft;
+  int nOrdered = 0;
+  int next = 0;
+  int i;
+
+  if ((order       = (int *)calloc(pg->nNode, sizeof(int))) == NULL ||
+      (nParentLeft = (int *)calloc(pg->nNode, sizeof(int))) == NULL) {
+    fprintf(stderr,"Failed allocating PathGraph order\n");
+    exit(1);
+  }
+
+  for (i=0; i<pg->nNode; i++) {
+    nParentLeft[i] = pg->nParent[i];
+    if (nParentLeft[i] == 0) {
+      order[nOrdered++] = i;
+    }
+  }
+
+  while (next < nOrdered) {
+    int node = order[next++];
+    for (i=0; i<pg->nChild[node]; i++) {
+      int child = pg->children[node][i];
+      if (--nParentLeft[child] == 0) {
+        order[nOrdered++] = child;
+      }
+    }
+  }
+
+  free(nParentLeft);
+
+  if (nOrdered != pg->nNode) {
+    free(order);
+    return NULL;
+  }
+  return order;
+}
+
+/*
+  Number of paths from the exons with no parents to nodes with no children.
+  Counts are memoised per node (number of paths from that node onwards) so
+  this is linear in the size of the graph. Saturates at LONG_MAX.
+*/
+long PathGraph_countPaths(PathGraph *pg, int *order) {
+  long *suffixCounts;
+  long nPath = 0;
+  int i;
+
+  if ((suffixCounts = (long *)calloc(pg->nNode, sizeof(long))) == NULL) {
+    fprintf(stderr,"Failed allocating PathGraph suffix counts\n");
+    exit(1);
+  }
+
+  for (i=pg->nNode-1; i>=0; i--) {
+    int node = order[i];
+
+    if (pg->nChild[node] == 0) {
+      suffixCounts[node] = 1;
+    } else {
+      int j;
+      for (j=0; j<pg->nChild[node]; j++) {
+        long childCount = suffixCounts[pg->children[node][j]];
+        suffixCounts[node] = (suffixCounts[node] > LONG_MAX - childCount) ? LONG_MAX : suffixCounts[node] + childCount;
+      }
+    }
+  }
+
+  for (i=0; i<pg->nExon; i++) {
+    if (pg->nParent[i] == 0) {
+      nPath = (nPath > LONG_MAX - suffixCounts[i]) ? LONG_MAX : nPath + suffixCounts[i];
+    }
+  }
+
+  free(suffixCounts);
+
+  return nPath;
+}
+
+/*
+  Makes every path from the exons with no parents to nodes with no children,
+  in exon order. Uses an explicit stack rather than recursion, and the only
+  allocation per path is the Path itself.
+*/
+Vector *PathGraph_enumeratePaths(PathGraph *pg) {
+  Vector *paths = Vector_new();
+  int *stack;
+  int *nextChild;
+  int i;
+
+  Vector_setFreeFunc(paths, free);
+
+  // A path can't visit a node twice, so can't be longer than nNode
+  if ((stack     = (int *)calloc(pg->nNode, sizeof(int))) == NULL ||
+      (nextChild = (int *)calloc(pg->nNode, sizeof(int))) == NULL) {
+    fprintf(stderr,"Failed allocating PathGraph stack\n");
+    exit(1);
+  }
+
+  for (i=0; i<pg->nExon; i++) {
+    if (pg->nParent[i] != 0) {
+      continue;
+    }
+
+    int depth = 0;
+    stack[0] = i;
+    nextChild[0] = 0;
+
+    while (depth >= 0) {
+      int node = stack[depth];
+
+      if (pg->nChild[node] == 0) {
+        double score = 0;
+        int j;
+        for (j=0; j<=depth; j++) {
+          score += pg->scores[stack[j]];
+        }
+        Vector_addElement(paths, Path_new(stack, depth+1, score));
+        depth--;
+      } else if (nextChild[depth] < pg->nChild[node]) {
+        int child = pg->children[node][nextChild[depth]++];
+        depth++;
+        stack[depth] = child;
+        nextChild[depth] = 0;
+      } else {
+        depth--;
+      }
+    }
+  }
+
+  free(stack);
+  free(nextChild);
+
+  return paths;
+}
+
+int PathRank_reverseScoreCompFunc(const void *a, const void *b) {
+  PathRank *pr1 = (PathRank *)a;
+  PathRank *pr2 = (PathRank *)b;
+
+  if (pr1->score > pr2->score) {
+    return -1;
+  } else if (pr1->score < pr2->score) {
+    return 1;
+  } else if (pr1->child != pr2->child) {
+    return pr1->child - pr2->child;
+  }
+  return pr1->rank - pr2->rank;
+}
+
+/*
+  Makes the k highest scoring paths. For each node (children first) keeps the
+  k best scoring paths from that node onwards, each as its score and which of
+  the child's best paths it continues with, so paths are only made for the k
+  which are kept.
 */
-    total++;
-  }
+Vector *PathGraph_topPaths(PathGraph *pg, int *order, int k) {
+  Vector *paths = Vector_new();
+  PathRank **best;
+  PathRank *candidates = NULL;
+  int *nBest;
+  int *nodes;
+  int nCandidateAlloc = 0;
+  int i;
 
-// Can't be any currently, but maybe should be possible to trap errors
-  if (fails > 0) {
-    fprintf(stderr, "Not all genes could be written successfully (%d fails out of %d)\n", fails, total);
+  Vector_setFreeFunc(paths, free);
+
+  if ((best  = (PathRank **)calloc(pg->nNode, sizeof(PathRank *))) == NULL ||
+      (nBest = (int *)calloc(pg->nNode, sizeof(int))) == NULL ||
+      (nodes = (int *)calloc(pg->nNode, sizeof(int))) == NULL) {
+    fprintf(stderr,"Failed allocating PathGraph best paths\n");
+    exit(1);
   }
 
-  if (verbosity > 0) fprintf(stderr, "Writing dna_align_features\n");
-  if (RefineSolexaGenes_writeIntrons(rsg)) {
-    DNAAlignFeatureAdaptor *intronAdaptor = DBAdaptor_getDNAAlignFeatureAdaptor(outdb);
-    fails = 0;
-    total = 0;
-   
-    Vector *intronFeatures = RefineSolexaGenes_getIntronFeatures(rsg);
-  
-    for (i=0; i<Vector_getNumElement(intronFeatures); i++) {
-      DNAAlignFeature *intron = Vector_getElementAt(intronFeatures, i);
-  
-  // SMJS If want to edge match in apollo comment out these two lines
-      DNAAlignFeature_setStart(intron, DNAAlignFeature_getStart(intron) + 1);
-      DNAAlignFeature_setEnd(intron, DNAAlignFeature_getEnd(intron) - 1);
-  //    eval {
-  // tmpVec is just so can use _store method which takes a vector not a feature
-  /* SMJS Perl did one at a time - I'm going to do all in one go after loop, so I don't have to make these temporary vectors
-      Vector *tmpVec = Vector_new();
-      Vector_addElement(tmpVec, intron);
-      DNAAlignFeatureAdaptor_store(intronAdaptor, tmpVec);
-      Vector_free(tmpVec);
-  */
-  //    };
-  
-  //    if ($@){
-  //      warning("Unable to store DnaAlignFeature!!\n$@");
-  //      $fails++;
-  //    }
-      total++;
+  for (i=pg->nNode-1; i>=0; i--) {
+    int node = order[i];
+    int nCandidate = 0;
+    int j;
+
+    if (pg->nChild[node] == 0) {
+      if ((best[node] = (PathRank *)calloc(1, sizeof(PathRank))) == NULL) {
+        fprintf(stderr,"Failed allocating PathRank\n");
+        exit(1);
+      }
+      best[node][0].score = pg->scores[node];
+      best[node][0].child = -1;
+      best[node][0].rank  = -1;
+      nBest[node] = 1;
+      continue;
     }
-  
-  // SMJS Moved from within loop - store all features in intronFeatures in one call
-    DNAAlignFeatureAdaptor_store(intronAdaptor, intronFeatures);
-  
-    if (fails > 0) {
-      fprintf(stderr, "Not all introns could be written successfully (%d fails out of %d)\n", fails, total);
+
+    for (j=0; j<pg->nChild[node]; j++) {
+      int child = pg->children[node][j];
+      int m;
+
+      if (nCandidate + nBest[child] > nCandidateAlloc) {
+        nCandidateAlloc = nCandidate + nBest[child] + k;
+        if ((candidates = (PathRank *)realloc(candidates, nCandidateAlloc * sizeof(PathRank))) == NULL) {
+          fprintf(stderr,"Failed reallocating PathRank candidates\n");
+          exit(1);
+        }
+      }
+
+      for (m=0; m<nBest[child]; m++) {
+        candidates[nCandidate].score = pg->scores[node] + best[child][m].score;
+        candidates[nCandidate].child = child;
+        candidates[nCandidate].rank  = m;
+        nCandidate++;
+      }
     }
-  } else {
-    fprintf(stderr, "NOTE: Not writing DNAAlignFeatures for introns\n");
+
+    qsort(candidates, nCandidate, sizeof(PathRank), PathRank_reverseScoreCompFunc);
+
+    nBest[node] = nCandidate < k ? nCandidate : k;
+    if ((best[node] = (PathRank *)calloc(nBest[node], sizeof(PathRank))) == NULL) {
+      fprintf(stderr,"Failed allocating PathRank\n");
+      exit(1);
+    }
+    memcpy(best[node], candidates, nBest[node] * sizeof(PathRank));
   }
-}
 
+  // Now choose the best k from all the start exons - child here is the start exon
+  int nCandidate = 0;
+  for (i=0; i<pg->nExon; i++) {
+    if (pg->nParent[i] != 0) {
+      continue;
+    }
+    if (nCandidate + nBest[i] > nCandidateAlloc) {
+      nCandidateAlloc = nCandidate + nBest[i] + k;
+      if ((candidates = (PathRank *)realloc(candidates, nCandidateAlloc * sizeof(PathRank))) == NULL) {
+        fprintf(stderr,"Failed reallocating PathRank candidates\n");
+        exit(1);
+      }
+    }
+    int m;
+    for (m=0; m<nBest[i]; m++) {
+      candidates[nCandidate].score = best[i][m].score;
+      candidates[nCandidate].child = i;
+      candidates[nCandidate].rank  = m;
+      nCandidate++;
+    }
+  }
 
-/*
-=head2 ProcessTree
+  qsort(candidates, nCandidate, sizeof(PathRank), PathRank_reverseScoreCompFunc);
 
-    Title        :   ProcessTree
-    Usage        :   $self->ProcessTree
-    Returns      :   String containing paths through the gene
-    Args         :   A hash reference contianing the possible intron exons
-                 :   Integer key for the hashref
-                 :   String containing keys used up to this point
-                 :   String containing the paths under construction
-    Description  :   Recursive method that creates paths that explore all possible
-                 :   routes through a hashref, uses a configurable recursion limit 
-                 :   to prevent it running out of memory if the paths cannot be solved
-                 :   or are too large to be practical
+  for (i=0; i<nCandidate && i<k; i++) {
+    int node = candidates[i].child;
+    int rank = candidates[i].rank;
+    int nNode = 0;
 
-=cut
-*/
-/*
-hashref contains lists of exon indexes keyed on intron hitseqname AND intron hitseqnames keyed on exon indexes. This allows alternating exon intron lookups with each ProcessTree
-call
-*/
-/* 
-Produces a hash of strings which have the format "exonIndex.intronName.exonIndex.intronName..."
-*/
+    while (node >= 0) {
+      PathRank *pr = &(best[node][rank]);
+      nodes[nNode++] = node;
+      node = pr->child;
+      rank = pr->rank;
+    }
+    Vector_addElement(paths, Path_new(nodes, nNode, candidates[i].score));
+  }
 
-#define PT_ERROR 2
-int RefineSolexaGenes_processTree(RefineSolexaGenes *rsg, StringHash *hashref, char *index, char *soFar, StringHash *paths, int *recLev) {
-  (*recLev)++;
-  // dont let it go on for ever eating memory
-  if (limit > RefineSolexaGenes_getRecursiveLimit(rsg)){
-    fprintf(stderr,"Too many recursive possibilities\n");
-    (*recLev)--;
-    return PT_ERROR;
+  for (i=0; i<pg->nNode; i++) {
+    if (best[i]) free(best[i]);
   }
+  free(best);
+  free(nBest);
+  free(nodes);
+  if (candidates) free(candidates);
+
+  return paths;
+}
 
-// Perl passes sofar by value so makes lots of strings with the different paths
-// To replicate that, make copy of sofar here - must be allocated off heap, pointer to it is on stack, so should emulate the perl way
-  sprintf(soFar,"%s%s.", soFar, index);
-  //fprintf(stderr, "reclev = %d soFar is %s\n", *recLev, soFar);
+void PathGraph_free(PathGraph *pg) {
+  int i;
 
-  int nNode = 0;
-  if (StringHash_contains(hashref, index)) {
-    StringHash *subHash = StringHash_getValue(hashref, index);
-    char **node = StringHash_getKeys(subHash);
+  for (i=0; i<pg->nNode; i++) {
+    if (pg->children[i]) free(pg->children[i]);
+  }
+  free(pg->children);
+  free(pg->childAlloc);
+  free(pg->nChild);
+  free(pg->nParent);
+  free(pg->scores);
+  free(pg->introns);
+  StringHash_free(pg->intronNodes, free);
+  free(pg);
+}
 
-    nNode = StringHash_getNumValues(subHash);
+Path *Path_new(int *nodes, int nNode, double score) {
+  Path *path;
 
-    char *savedSoFar;
-    StrUtil_copyString(&savedSoFar, soFar, 0);
+  if ((path = (Path *)malloc(sizeof(Path) + (nNode-1) * sizeof(int))) == NULL) {
+    fprintf(stderr,"Failed allocating Path\n");
+    exit(1);
+  }
 
-    int i;
-    int failed = 0;
-    for (i=0; i<nNode && !failed; i++) {
-      char *child = node[i];
-
-      limit++;
-//  char tmpStr[512];
-//  sprintf(tmpStr,"%s.",index);
-//  newSoFar = StrUtil_appendString(newSoFar, tmpStr);
-      //fprintf(stderr, "child = %s\n", child);
-      int result = RefineSolexaGenes_processTree(rsg, hashref, child, soFar, paths, recLev);
-      strcpy(soFar,savedSoFar);
-      if (result == PT_ERROR) {
-        limit = 0;
-        (*recLev)--;
-        failed = 1;
-        //return PT_ERROR; 
-      }
-    }
-    free(savedSoFar);
-    for (i=0; i<nNode; i++) {
-      free(node[i]);
-    }
-    free(node);
-// Moved failed return to here so freeing of temporary data happens
-    if (failed) return PT_ERROR;
-  }
-  if (nNode == 0) {
-    //fprintf(stderr, "path key when nNode = 0 is %s\n", soFar);
-    StringHash_add(paths, soFar, &trueVal);
-  }
-  (*recLev)--;
-  return 0;
+  path->score = score;
+  path->nNode = nNode;
+  memcpy(path->nodes, nodes, nNode * sizeof(int));
+
+  return path;
 }
 
 /*
@@ -3933,8 +5132,14 @@ int RefineSolexaGenes_processTree(RefineSolexaGenes *rsg, StringHash *hashref, c
 
 =cut
 */
-StringHash *RefineSolexaGenes_processPaths(RefineSolexaGenes *rsg, Vector *exons, Vector *exonIntron, StringHash *intronExon, int strict, int *giveUpFlag) {
-  StringHash *variants = StringHash_new(STRINGHASH_SMALL);
+/*
+Returns a Vector of Paths through the PathGraph returned in retGraph. If there are more paths than the recursive
+limit, returns NULL (and no graph) so the caller can try again with a higher strictness. If the gene can't be
+simplified any more and TOP_PATHS is set, the TOP_PATHS highest scoring paths are returned rather than giving up.
+*/
+Vector *RefineSolexaGenes_processPaths(RefineSolexaGenes *rsg, Vector *exons, Vector *exonIntron, StringHash *intronExon, int strict, PathGraph **retGraph, int *giveUpFlag) {
+  PathGraph *pg = PathGraph_new(exons);
+  int topPaths = 0;
   int removed = 0;
   int i;
   int j;
@@ -3947,8 +5152,6 @@ StringHash *RefineSolexaGenes_processPaths(RefineSolexaGenes *rsg, Vector *exons
     Exon *exon = Vector_getElementAt(exons, i);
     if (i < Vector_getNumElement(exonIntron)) {
       Vector *exInti = Vector_getElementAt(exonIntron, i);
-      char iStr[50];
-      sprintf(iStr,"%d",i);
       if (exInti != NULL && Vector_getNumElement(exInti)) {
         if (strict) {
           //# Throw out exons that have retained introns for a start
@@ -4014,41 +5217,15 @@ StringHash *RefineSolexaGenes_processPaths(RefineSolexaGenes *rsg, Vector *exons
             for (k=0; k<Vector_getNumElement(intEx); k++) {
               long exonInd = *((long *)Vector_getElementAt(intEx, k));
   
-              char exonIndStr[1024];
-              sprintf(exonIndStr,"%ld", exonInd);
-  
               Exon *exon = Vector_getElementAt(exons, exonInd);
   // Note I inverted the condition
               if (DNAAlignFeature_getEnd(intron) <= Exon_getEnd(exon)) {
                 //# store the possible paths as a hash (splice)variants
-                char *hseqname = DNAAlignFeature_getHitSeqName(intron);
-  
- //               fprintf(stderr,"adding variant for %s and %s\n", iStr, hseqname);
-                //fprintf(stderr,"adding to variants %s hash value %s\n", iStr, hseqname);
                 //$variants->{$i}->{$intron->hseqname} = 1;
-                if (!StringHash_contains(variants, iStr)) {
-                  StringHash_add(variants, iStr, StringHash_new(STRINGHASH_SMALL));
-                }
-//                fprintf(stderr,"adding to variants %s hash value %s\n",iStr, hseqname);
-                StringHash *varEHash = StringHash_getValue(variants, iStr);
-                if (!StringHash_contains(varEHash, hseqname)) {
-                  StringHash_add(varEHash, hseqname, &trueVal);
-                } else {
-                  //fprintf(stderr,"Warning: already added variant %s to %s\n", hseqname, iStr);
-                }
-  
-                //fprintf(stderr,"adding to variants %s hash value %s\n", hseqname, exonIndStr);
                 //$variants->{$intron->hseqname}->{$exon} = 1;
-                if (!StringHash_contains(variants, hseqname)) {
-                  StringHash_add(variants, hseqname, StringHash_new(STRINGHASH_SMALL));
-                }
-                StringHash *varIHash = StringHash_getValue(variants, hseqname);
-
-                if (!StringHash_contains(varIHash, exonIndStr)) {
-                  StringHash_add(varIHash, exonIndStr, &trueVal);
-                } else {
-                  //fprintf(stderr,"Warning: already added variant %s to %s\n", exonIndStr, hseqname);
-                }
+                int intronNode = PathGraph_getIntronNode(pg, intron);
+                PathGraph_addEdge(pg, i, intronNode);
+                PathGraph_addEdge(pg, intronNode, exonInd);
               }
             }
           }
@@ -4057,12 +5234,6 @@ StringHash *RefineSolexaGenes_processPaths(RefineSolexaGenes *rsg, Vector *exons
     }
   }
 
-  if (variants) {
-    //fprintf(stderr, "Have %d values in variants\n", StringHash_getNumValues(variants));
-  } else {
-    fprintf(stderr, "variants is NULL\n");
-  }
-  
 // ??? why &! rather than && ! if ($strict &! $removed ) {
   if (strict && !removed) {
     Exon *firstExon = Vector_getElementAt(exons, 0);
@@ -4073,10 +5244,14 @@ StringHash *RefineSolexaGenes_processPaths(RefineSolexaGenes *rsg, Vector *exons
     if (RefineSolexaGenes_getRecursiveLimit(rsg) < RefineSolexaGenes_getMaxRecursions(rsg)) {
       RefineSolexaGenes_setRecursiveLimit(rsg, RefineSolexaGenes_getRecursiveLimit(rsg) * 10);
       fprintf(stderr, "Upping recursive limit to %d to see if it helps\n", RefineSolexaGenes_getRecursiveLimit(rsg));
+    } else if (RefineSolexaGenes_getTopPaths(rsg) > 0) {
+      topPaths = RefineSolexaGenes_getTopPaths(rsg);
+      fprintf(stderr,"Using the top %d scoring paths for EXON 0: %ld - %ld - %d\n", topPaths,
+              Exon_getStart(firstExon), Exon_getEnd(firstExon), Exon_getStrand(firstExon));
     } else {
       fprintf(stderr,"Giving up on EXON 0: %ld - %ld - %d\n",
               Exon_getStart(firstExon), Exon_getEnd(firstExon), Exon_getStrand(firstExon));
-      StringHash_free(variants, StringHash_freeNoValFree);
+      PathGraph_free(pg);
 //!!!!!!!!!!! NIY What to return
       *giveUpFlag = 1;
       return NULL;
@@ -4084,30 +5259,32 @@ StringHash *RefineSolexaGenes_processPaths(RefineSolexaGenes *rsg, Vector *exons
   }
   
   // work out all the possible paths given the features we have
-  int result = 0;
-  StringHash *paths = StringHash_new(STRINGHASH_LARGE);
-  char *soFar = (char *)calloc(1000000,sizeof(char));
-  for (i=0; i<Vector_getNumElement(exons) && result != PT_ERROR; i++) {
-    limit = 0;
-// Instead of undef for sofar I pass in ""
-    char tmpStr[50];
-    sprintf(tmpStr,"%d",i);
-    int recLev = 0;
-    soFar[0] = '\0';
-    result = RefineSolexaGenes_processTree(rsg, variants, tmpStr, soFar, paths, &recLev);
-
-    if (result == PT_ERROR) {
-      fprintf(stderr, "Could not process cluster %d trying again with simpler cluster\n", i);
-      //fprintf(stderr,"Freeing paths %p\n", paths);
-      StringHash_free(paths, NULL);
-      StringHash_free(variants, StringHash_freeNoValFree);
+  int *order = PathGraph_topologicalOrder(pg);
+  if (order == NULL) {
+    fprintf(stderr, "Exon intron graph has a cycle - giving up on this gene\n");
+    PathGraph_free(pg);
+    *giveUpFlag = 1;
+    return NULL;
+  }
+
+  Vector *paths;
+  if (topPaths) {
+    paths = PathGraph_topPaths(pg, order, topPaths);
+  } else {
+    long nPath = PathGraph_countPaths(pg, order);
+    if (nPath > RefineSolexaGenes_getRecursiveLimit(rsg)) {
+      fprintf(stderr,"Too many recursive possibilities (%ld paths)\n", nPath);
+      fprintf(stderr, "Could not process cluster trying again with simpler cluster\n");
+      free(order);
+      PathGraph_free(pg);
       return NULL;
     }
+    paths = PathGraph_enumeratePaths(pg);
   }
 
-  StringHash_free(variants, StringHash_freeNoValFree);
+  free(order);
 
-  free(soFar);
+  *retGraph = pg;
   return paths;
 }
 
@@ -4484,6 +5661,82 @@ Exon *RefineSolexaGenes_binSearchForOverlap(RefineSolexaGenes *rsg, Vector *exon
   return NULL;
 }
 
+/*
+  Adds the introns (and any potential extra exons) from one read to the junction
+  table, applying the read's file's read group and mixed bam filters.
+*/
+void RefineSolexaGenes_addReadJunctions(RefineSolexaGenes *rsg, IntronBamConfig *intronBamConf, int fileNum, StringHash *readGroups,
+                                        bam1_t *read, JunctionTable *junctionTable, StringHash *extraExons, CigarBlock **mates) {
+  char spliced;
+  int nMate;
+  int i;
+
+  // ignore unspliced reads if the bam file is a mixture of spliced and 
+  // unspliced reads
+  if (intronBamConf->mixedBam) {
+    uint8_t *spliceda = bam_aux_get(read, "XS");
+    if (!spliceda) return;
+    spliced = bam_aux2A(spliceda);
+  }
+
+  // filter by read group if needed
+  if (readGroups != NULL) { 
+    uint8_t *rga = bam_aux_get(read,"RG");
+    if (rga) {
+      char *rg = bam_aux2Z(rga);
+      if (!StringHash_contains(readGroups, rg)) {
+        return;
+      }
+    }
+  }
+
+  // need to recreate the ungapped features code as the
+  // auto splitting code does not seem to work with > 2 features
+  nMate = RefineSolexaGenes_getUngappedFeatures(rsg, intronBamConf->header, read, mates);
+
+  // if mates > 2 then we have a possibility of adding in some extra exons into our rough models
+  // as the read has spliced into and out of an exon
+  // lets make them unique
+  if (nMate > 2) {
+    char keyString[2048]; keyString[0]='\0';
+    long coords[1024]; // Hopefully won't have more than this!
+    int nCoord = 0;
+    int keyLen = 0;
+
+    for (i=0; i<nMate; i++) {
+      CigarBlock *mate = mates[i];
+
+      if (i > 0) {
+        keyLen += sprintf(keyString+keyLen, "%ld:", mate->start);
+        coords[nCoord++] = mate->start;
+      }
+      if (i < nMate-1) {
+        keyLen += sprintf(keyString+keyLen, "%ld:", mate->end);
+        coords[nCoord++] = mate->end;
+      }
+    }
+
+    ExtraExonData *eed = StringHash_getValue(extraExons, keyString);
+    if (!eed) {
+      eed = ExtraExonData_new(coords, nCoord);
+      StringHash_add(extraExons, keyString, eed);
+    }
+    eed->score++;
+  }
+
+  int strand = bam_is_rev(read) == 1 ? -1 : 1;
+  if (intronBamConf->mixedBam) {
+    if (spliced == '+') strand = 1;
+    if (spliced == '-') strand = -1;
+  } 
+
+  // intron reads should be split according to the CIGAR line
+  // we want the ungapped features to make our introns
+  for (i=0; i<nMate-1; i++) {
+    JunctionTable_add(junctionTable, mates[i]->end, mates[i+1]->start, strand, fileNum);
+  }
+}
+
 /*
 =head2 bam_2_intron_features
     Title        :   bam_2_intron_features
@@ -4500,163 +5753,287 @@ Exon *RefineSolexaGenes_binSearchForOverlap(RefineSolexaGenes *rsg, Vector *exon
 
 =cut
 */
-void RefineSolexaGenes_bamToIntronFeatures(RefineSolexaGenes *rsg, IntronBamConfig *intronBamConf, htsFile *sam, bam_hdr_t *header, hts_idx_t *idx, int ref, int begRange, int endRange) {
-  SliceAdaptor *sliceAdaptor = RefineSolexaGenes_getGeneSliceAdaptor(rsg);
-  Vector *ifs = Vector_new();
-  StringHash *extraExons = RefineSolexaGenes_getExtraExons(rsg);
-  StringHash *idList = StringHash_new(STRINGHASH_LARGE);
-  StringHash *readGroups = NULL;
+/*
+  C version reads all the intron bam files in one pass, merging their reads on
+  position, rather than one file at a time. refs has the reference id of the
+  region in each file's header (they needn't have the same order). Each file's
+  read group and depth filters are applied to its own reads, then introns found
+  in more than one file are merged into one feature with the summed score.
+
+  If JUNCTION_INDEX_DIR is set the junctions and extra exons come from the
+  junction index for the seq region instead, which is built from the BAMs the
+  first time it's needed.
+*/
+JunctionTable *RefineSolexaGenes_bamToJunctions(RefineSolexaGenes *rsg, Vector *intronBamFiles, int *refs, int begRange, int endRange, StringHash *extraExons) {
+  int nFile = Vector_getNumElement(intronBamFiles);
+  JunctionTable *junctionTable = JunctionTable_new(65536);
+  StringHash **readGroups;
+  hts_itr_t **iters;
+  bam1_t **reads;
+  int *heap;
+  int nHeap = 0;
 
   CigarBlock blockArray[1024];
   CigarBlock *mates[1024];
-  int nMate;
   int i;
   for (i=0;i<1024;i++) {
     mates[i] = &blockArray[i];
   }
 
+  if ((readGroups = (StringHash **)calloc(nFile, sizeof(StringHash *))) == NULL ||
+      (iters = (hts_itr_t **)calloc(nFile, sizeof(hts_itr_t *))) == NULL ||
+      (reads = (bam1_t **)calloc(nFile, sizeof(bam1_t *))) == NULL ||
+      (heap = (int *)calloc(nFile, sizeof(int))) == NULL) {
+    fprintf(stderr, "Failed allocating bam merge arrays\n");
+    exit(1);
+  }
 
-  if (intronBamConf->groupNames != NULL && Vector_getNumElement(intronBamConf->groupNames) > 0) {
-    
-    fprintf(logfp, "Limiting to read groups ");
-    readGroups = StringHash_new(STRINGHASH_SMALL);
-    for (i=0; i<Vector_getNumElement(intronBamConf->groupNames); i++) {
-      char *group = Vector_getElementAt(intronBamConf->groupNames, i);
-      fprintf(logfp, " %s", group);
-      StringHash_add(readGroups, group, &trueVal); 
+  for (i=0; i<nFile; i++) {
+    IntronBamConfig *intronBamConf = Vector_getElementAt(intronBamFiles, i);
+
+    if (intronBamConf->groupNames != NULL && Vector_getNumElement(intronBamConf->groupNames) > 0) {
+      int j;
+      fprintf(logfp, "Limiting to read groups ");
+      readGroups[i] = StringHash_new(STRINGHASH_SMALL);
+      for (j=0; j<Vector_getNumElement(intronBamConf->groupNames); j++) {
+        char *group = Vector_getElementAt(intronBamConf->groupNames, j);
+        fprintf(logfp, " %s", group);
+        StringHash_add(readGroups[i], group, &trueVal); 
+      }
+      fprintf(logfp, " for %s\n", intronBamConf->fileName);
     }
-    fprintf(logfp, "\n");
-  }
 
-  hts_itr_t *iter = sam_itr_queryi(idx, ref, begRange, endRange);
-  bam1_t *read = bam_init1();
+    iters[i] = sam_itr_queryi(intronBamConf->idx, refs[i], begRange, endRange);
+    reads[i] = bam_init1();
+    if (bam_itr_next(intronBamConf->sam, iters[i], reads[i]) >= 0) {
+      BamMerge_push(heap, &nHeap, reads, i);
+    }
+  }
 
-  int firstRead = 1;
-  char name[1024];
   fprintf(stderr,"before bam read loop\n");
-  while (bam_itr_next(sam, iter, read) >= 0) {
-
-//READ:  
-    char spliced;
-    // ignore unspliced reads if the bam file is a mixture of spliced and 
-    // unspliced reads
-    if (intronBamConf->mixedBam) {
-      uint8_t *spliceda = bam_aux_get(read, "XS");
-      if (!spliceda) continue;
-      spliced = bam_aux2A(spliceda);
-    }
-    // filter by read group if needed
-    
-    // need to recreate the ungapped features code as the
-    // auto splitting code does not seem to work with > 2 features
-    if (readGroups != NULL) { 
-      uint8_t *rga = bam_aux_get(read,"RG");
-      if (rga) {
-        char *rg = bam_aux2Z(rga);
-        if (!StringHash_contains(readGroups, rg)) {
-          continue;
-        }
-      }
+  while (nHeap > 0) {
+    int fileNum = heap[0];
+    IntronBamConfig *intronBamConf = Vector_getElementAt(intronBamFiles, fileNum);
+
+    RefineSolexaGenes_addReadJunctions(rsg, intronBamConf, fileNum, readGroups[fileNum], reads[fileNum], junctionTable, extraExons, mates);
+
+    // Advance this file, dropping it from the merge when it runs out of reads
+    if (bam_itr_next(intronBamConf->sam, iters[fileNum], reads[fileNum]) < 0) {
+      heap[0] = heap[--nHeap];
     }
+    BamMerge_siftDown(heap, nHeap, reads, 0);
+  }
 
-    // Vector *mates = RefineSolexaGenes_getUngappedFeatures(rsg, read);
-    nMate = RefineSolexaGenes_getUngappedFeatures(rsg, header, read, mates);
+  for (i=0; i<nFile; i++) {
+    sam_itr_destroy(iters[i]);
+    bam_destroy1(reads[i]);
+    if (readGroups[i] != NULL) StringHash_free(readGroups[i], NULL);
+  }
+  free(iters);
+  free(reads);
+  free(readGroups);
+  free(heap);
 
-    //qsort(mates, nMate, sizeof(CigarBlock *), CigarBlock_startCompFunc);
+  return junctionTable;
+}
 
-    //Vector_sort(mates, CigarBlock_startCompFunc);
-    //my @mates = sort { $a->[2] <=> $b->[2] } @{$self->ungapped_features($read)};
+/*
+  Key for the junction index: a hash of everything which affects the junctions
+  extracted. Hashing the full contents of the BAMs would mean reading them all,
+  so each file is identified by its name, size, modification time and header text.
+*/
+uint64_t RefineSolexaGenes_junctionIndexKey(RefineSolexaGenes *rsg, Vector *intronBamFiles) {
+  uint64_t key = 0xcbf29ce484222325ULL;
+  char buf[2048];
+  int i;
 
-    // if mates > 2 then we have a possibility of adding in some extra exons into our rough models
-    // as the read has spliced into and out of an exon
-    // lets make them unique
-//    if (Vector_getNumElement(mates) > 2) {
-    if (nMate > 2) {
-      char keyString[2048]; keyString[0]='\0';
-      long coords[1024]; // Hopefully won't have more than this!
-      int nCoord = 0;
+#define JIKEY_ADD(DATA, LEN) { \
+    const unsigned char *ch = (const unsigned char *)(DATA); \
+    size_t n; \
+    for (n=0; n<(LEN); n++) { key ^= ch[n]; key *= 0x100000001b3ULL; } \
+  }
 
-      //for (i=0; i<Vector_getNumElement(mates); i++) {
-      //  CigarBlock *mate = Vector_getElementAt(mates, i);
-      for (i=0; i<nMate; i++) {
-        CigarBlock *mate = mates[i];
+  sprintf(buf, "ucsc_naming=%d\n", RefineSolexaGenes_getUcscNaming(rsg));
+  JIKEY_ADD(buf, strlen(buf));
 
-        long start = mate->start;
-        long end   = mate->end;
+  for (i=0; i<Vector_getNumElement(intronBamFiles); i++) {
+    IntronBamConfig *intronBamConf = Vector_getElementAt(intronBamFiles, i);
+    struct stat st;
 
-//  Unused      my $hstrand = $read->strand;
-        if (i > 0) {
-          sprintf(keyString, "%s%ld:", keyString, start);
-          coords[nCoord++] = start;
-        }
-//        if (i < Vector_getNumElement(mates)-1) {
-        if (i < nMate-1) {
-          sprintf(keyString,"%s%ld:", keyString, end);
-          coords[nCoord++] = end;
-        }
-      }
+    if (stat(intronBamConf->fileName, &st) != 0) {
+      fprintf(stderr, "Error: Failed to stat bam file %s\n", intronBamConf->fileName);
+      exit(1);
+    }
+    sprintf(buf, "%s\t%ld\t%ld\t%d\t%d\n", intronBamConf->fileName, (long)st.st_size, (long)st.st_mtime,
+            intronBamConf->mixedBam, intronBamConf->depth);
+    JIKEY_ADD(buf, strlen(buf));
 
-      ExtraExonData *eed = StringHash_getValue(extraExons, keyString);
-      if (!eed) { //(!StringHash_contains(extraExons, keyString)) {
-        eed = ExtraExonData_new(coords, nCoord);
-      //  fprintf(stderr,"adding eed %s\n",keyString);
-        StringHash_add(extraExons, keyString, eed);
+    if (intronBamConf->groupNames != NULL) {
+      int j;
+      for (j=0; j<Vector_getNumElement(intronBamConf->groupNames); j++) {
+        char *group = Vector_getElementAt(intronBamConf->groupNames, j);
+        JIKEY_ADD(group, strlen(group)+1);
       }
-      //ExtraExonData *eed = StringHash_getValue(extraExons, keyString);
+    }
+    JIKEY_ADD(intronBamConf->header->text, intronBamConf->header->l_text);
+  }
+#undef JIKEY_ADD
 
-      eed->score++;
-      //# print "Not doing extra_exon stuff for now\n";
+  return key;
+}
+
+/*
+  Extracts the junctions and extra exons for the whole of the chromosome slice's
+  seq region from the BAMs and writes them to the junction index file. Written to
+  a temporary file which is then renamed so a partly written index is never used.
+*/
+void RefineSolexaGenes_buildJunctionIndex(RefineSolexaGenes *rsg, Vector *intronBamFiles, int *refs, char *fileName, uint64_t key) {
+  StringHash *extraExons = StringHash_new(STRINGHASH_MEDIUM);
+  JunctionIndexHeader header;
+  char tmpFileName[FILENAME_MAX];
+  int endRange = 0;
+  FILE *fp;
+  int i;
+
+  for (i=0; i<Vector_getNumElement(intronBamFiles); i++) {
+    IntronBamConfig *intronBamConf = Vector_getElementAt(intronBamFiles, i);
+    if (intronBamConf->header->target_len[refs[i]] > endRange) {
+      endRange = intronBamConf->header->target_len[refs[i]];
     }
+  }
 
-    //my $strand = $read->target->strand;
-//    int strand = bam1_strand(read) == 0 ? -1 : 1;
-    int strand = bam_is_rev(read) == 1 ? -1 : 1;
-    if (intronBamConf->mixedBam) {
-      if (spliced == '+') strand = 1;
-      if (spliced == '-') strand = -1;
-    } 
+  fprintf(stderr, "Building junction index %s\n", fileName);
+  JunctionTable *junctionTable = RefineSolexaGenes_bamToJunctions(rsg, intronBamFiles, refs, 0, endRange, extraExons);
+  int nJunction = JunctionTable_collapse(junctionTable, intronBamFiles);
 
-// Moved name setting out of loop
-    if (firstRead == 1) {
-      strcpy(name, header->target_name[read->core.tid]);
-      StrUtil_strReplChr(name, '.', '*');
-      //fprintf(stderr,"got target name %s\n", name);
-      firstRead = 0;
+  memset(&header, 0, sizeof(JunctionIndexHeader));
+  memcpy(header.magic, JUNCTIONINDEX_MAGIC, 8);
+  header.key        = key;
+  header.nJunction  = nJunction;
+  header.nExtraExon = StringHash_getNumValues(extraExons);
+
+  for (i=0; i<nJunction; i++) {
+    Junction *j = &junctionTable->slots[i];
+    if (j->nextExonStart - j->prevExonEnd > header.maxJunctionSpan) {
+      header.maxJunctionSpan = j->nextExonStart - j->prevExonEnd;
     }
+  }
 
-// Not used    long offset;
-    char uniqueId[2048];
-//    for (i=0; i<Vector_getNumElement(mates)-1; i++) {
-//      CigarBlock *mate   = Vector_getElementAt(mates, i);
-//      CigarBlock *mateP1 = Vector_getElementAt(mates, i+1);
-    for (i=0; i<nMate-1; i++) {
-      CigarBlock *mate   = mates[i];
-      CigarBlock *mateP1 = mates[i+1];
+  ExtraExonData **eeValues = StringHash_getValues(extraExons);
+  qsort(eeValues, header.nExtraExon, sizeof(ExtraExonData *), ExtraExonData_startCompFunc);
 
-      // intron reads should be split according to the CIGAR line
-      // the default split function seems to ad
-      // we want the ungapped features to make our introns
-      // we dont allow . in the seq region name as we use them to delimit our paths
-// Removed some unused vars here
+  JunctionIndexExtraExon *jiees;
+  if ((jiees = (JunctionIndexExtraExon *)calloc(header.nExtraExon+1, sizeof(JunctionIndexExtraExon))) == NULL) {
+    fprintf(stderr,"Failed allocating JunctionIndexExtraExons\n");
+    exit(1);
+  }
+  for (i=0; i<header.nExtraExon; i++) {
+    ExtraExonData *eed = eeValues[i];
+    JunctionIndexExtraExon *jiee = &jiees[i];
 
-      sprintf(uniqueId, "%s:%ld:%ld:%d", name, mate->end, mateP1->start, strand);
+    jiee->start       = eed->coords[0];
+    jiee->end         = eed->coords[eed->nCoord-1];
+    jiee->coordOffset = header.nExtraCoord;
+    jiee->nCoord      = eed->nCoord;
+    jiee->score       = eed->score;
 
-      IntronCoords *ic = StringHash_getValue(idList, uniqueId);
-      if (!ic) {
-        ic = IntronCoords_new(mate->end, mateP1->start, strand, -1, 0);
-        StringHash_add(idList,
-                       uniqueId,
-                       ic);
-      }
-      //IntronCoords *ic = StringHash_getValue(idList, uniqueId);
-      ic->score++;
+    header.nExtraCoord += eed->nCoord;
+    if (jiee->end - jiee->start > header.maxExtraExonSpan) {
+      header.maxExtraExonSpan = jiee->end - jiee->start;
+    }
+  }
+
+  sprintf(tmpFileName, "%s.tmp", fileName);
+  if ((fp = fopen(tmpFileName, "w")) == NULL) {
+    fprintf(stderr, "Error: Failed opening junction index file %s for writing\n", tmpFileName);
+    exit(1);
+  }
+
+  int ok = fwrite(&header, sizeof(JunctionIndexHeader), 1, fp) == 1 &&
+           fwrite(junctionTable->slots, sizeof(Junction), nJunction, fp) == nJunction &&
+           fwrite(jiees, sizeof(JunctionIndexExtraExon), header.nExtraExon, fp) == header.nExtraExon;
+
+  for (i=0; ok && i<header.nExtraExon; i++) {
+    ExtraExonData *eed = eeValues[i];
+    int j;
+    for (j=0; ok && j<eed->nCoord; j++) {
+      int64_t coord = eed->coords[j];
+      ok = fwrite(&coord, sizeof(int64_t), 1, fp) == 1;
+    }
+  }
+
+  if (!ok || fflush(fp) != 0 || fsync(fileno(fp)) != 0 || fclose(fp) != 0) {
+    fprintf(stderr, "Error: Failed writing junction index file %s\n", tmpFileName);
+    exit(1);
+  }
+  if (rename(tmpFileName, fileName) != 0) {
+    fprintf(stderr, "Error: Failed renaming %s to %s\n", tmpFileName, fileName);
+    exit(1);
+  }
+
+  fprintf(stderr, "Junction index has %d junctions and %ld extra exons\n", nJunction, (long)header.nExtraExon);
+
+  free(jiees);
+  free(eeValues);
+  StringHash_free(extraExons, ExtraExonData_free);
+  JunctionTable_free(junctionTable);
+}
+
+/*
+  Returns the junction index for the chromosome slice's seq region, building it if
+  there isn't a valid one in JUNCTION_INDEX_DIR. The index stays mapped until the
+  seq region changes (or the intron bams are closed).
+*/
+JunctionIndex *RefineSolexaGenes_getJunctionIndex(RefineSolexaGenes *rsg, Vector *intronBamFiles, int *refs) {
+  char *seqRegionName = Slice_getSeqRegionName(RefineSolexaGenes_getChrSlice(rsg));
+  char fileName[FILENAME_MAX];
+
+  if (rsg->junctionIndex != NULL) {
+    if (!strcmp(rsg->junctionIndex->seqRegionName, seqRegionName)) {
+      return rsg->junctionIndex;
+    }
+    JunctionIndex_close(rsg->junctionIndex);
+    rsg->junctionIndex = NULL;
+  }
+
+  uint64_t key = RefineSolexaGenes_junctionIndexKey(rsg, intronBamFiles);
+  sprintf(fileName, "%s/%016llx_%s.jidx", RefineSolexaGenes_getJunctionIndexDir(rsg), (unsigned long long)key, seqRegionName);
+
+  if ((rsg->junctionIndex = JunctionIndex_open(fileName, key, seqRegionName)) == NULL) {
+    RefineSolexaGenes_buildJunctionIndex(rsg, intronBamFiles, refs, fileName, key);
+
+    if ((rsg->junctionIndex = JunctionIndex_open(fileName, key, seqRegionName)) == NULL) {
+      fprintf(stderr, "Error: Failed opening junction index %s which was just built\n", fileName);
+      exit(1);
     }
-//    Vector_setFreeFunc(mates, CigarBlock_free);
-//    Vector_free(mates);
+  } else {
+    fprintf(stderr, "Using junction index %s\n", fileName);
   }
-  sam_itr_destroy(iter);
 
-  if (readGroups != NULL) StringHash_free(readGroups, NULL);
+  return rsg->junctionIndex;
+}
+
+void RefineSolexaGenes_bamToIntronFeatures(RefineSolexaGenes *rsg, Vector *intronBamFiles, int *refs, int begRange, int endRange) {
+  Vector *ifs = Vector_new();
+  StringHash *extraExons = RefineSolexaGenes_getExtraExons(rsg);
+  char *junctionIndexDir = RefineSolexaGenes_getJunctionIndexDir(rsg);
+  int nFile = Vector_getNumElement(intronBamFiles);
+  JunctionTable *junctionTable = NULL;
+  Junction *junctions;
+  int nJunction;
+  int i;
+
+  if (junctionIndexDir != NULL && junctionIndexDir[0] != '\0') {
+    JunctionIndex *junctionIndex = RefineSolexaGenes_getJunctionIndex(rsg, intronBamFiles, refs);
+
+    // begRange is 0 based, junction coords are 1 based
+    junctions = JunctionIndex_fetchRange(junctionIndex, begRange+1, endRange, &nJunction);
+    JunctionIndex_addExtraExons(junctionIndex, begRange+1, endRange, extraExons);
+  } else {
+    junctionTable = RefineSolexaGenes_bamToJunctions(rsg, intronBamFiles, refs, begRange, endRange, extraExons);
+    nJunction = JunctionTable_collapse(junctionTable, intronBamFiles);
+    junctions = junctionTable->slots;
+  }
 
 /* SMJS These are for testing
   // For param testing store introns with different anal to results
@@ -4667,11 +6044,7 @@ void RefineSolexaGenes_bamToIntronFeatures(RefineSolexaGenes *rsg, IntronBamConf
 
   fprintf(stderr,"before intron loop\n");
   //# collapse them down and make them into simple features
-  IntronCoords **icArray = StringHash_getValues(idList);
-
-  // May help smooth access to sequence to sort these - shouldn't be too costly to do the sort
-  // May remove need for ifs sort below, but for now leave that
-  qsort(icArray, StringHash_getNumValues(idList), sizeof(IntronCoords *), IntronCoords_intronStartCompFunc);
+  // Collapsed junctions are sorted on start which may help smooth access to sequence
 
   Slice *chrSlice = RefineSolexaGenes_getChrSlice(rsg);
   char sliceName[2048];
@@ -4683,16 +6056,10 @@ void RefineSolexaGenes_bamToIntronFeatures(RefineSolexaGenes *rsg, IntronBamConf
   Analysis *analysis = RefineSolexaGenes_getAnalysis(rsg);
   CachingSequenceAdaptor *cachingSeqAdaptor = DBAdaptor_getCachingSequenceAdaptor(Slice_getAdaptor(chrSlice)->dba);
 
-  for (i=0; i<StringHash_getNumValues(idList); i++) {
-    IntronCoords *ic = icArray[i];
+  for (i=0; i<nJunction; i++) {
+    Junction *ic = &junctions[i];
 
-    // filter on score if appropriate
-    if (intronBamConf->depth) {
-      if (intronBamConf->depth > ic->score) {
-        //#print "Rejecting on score " . $id_list{$key} ."\n";
-        continue;
-      }
-    }
+    // Depth filtering was done per file in JunctionTable_collapse
     long length =  ic->nextExonStart - ic->prevExonEnd -1;
 
     char name[2048];
@@ -4790,8 +6157,11 @@ void RefineSolexaGenes_bamToIntronFeatures(RefineSolexaGenes *rsg, IntronBamConf
     }
   }
 
-  StringHash_free(idList, IntronCoords_free);
-  free(icArray);
+  if (junctionTable != NULL) {
+    JunctionTable_free(junctionTable);
+  } else {
+    free(junctions);
+  }
   
   fprintf(stderr,"before filter\n");
 
@@ -4895,11 +6265,12 @@ void RefineSolexaGenes_bamToIntronFeatures(RefineSolexaGenes *rsg, IntronBamConf
 //  RefineSolexaGenes_setExtraExons(rsg, extraExons);
 
   fprintf(stderr,"Got %d unique introns  ", Vector_getNumElement(ifs));
-  fprintf(stderr," and %d potential novel exons from %s\n", StringHash_getNumValues(extraExons), intronBamConf->fileName);
+  fprintf(stderr," and %d potential novel exons from %d bam files\n", StringHash_getNumValues(extraExons), nFile);
   return;
 }
 
 
+
 // Changed algorithm from perl - should have same outcome, but not require all the temporary objects
 /* Aim:
      To get the match blocks at either end of every intron
@@ -5304,7 +6675,9 @@ void RefineSolexaGenes_dnaToIntronFeatures(RefineSolexaGenes *rsg, long start, l
   }
   fprintf(stderr, "Got %d reads\n", Vector_getNumElement(reads));
 
-  StringHash *idList = StringHash_new(STRINGHASH_MEDIUM);
+  StringHash *idList = StringHash_new(STRINGHASH_SMALL);
+  // At most one entry per read
+  StringHash_reserve(idList, Vector_getNumElement(reads));
 
   int i;
   for (i=0; i<Vector_getNumElement(reads); i++) {
@@ -5859,7 +7232,8 @@ void RefineSolexaGenes_setExtraExons(RefineSolexaGenes *rsg, StringHash *extraEx
 
 char **RefineSolexaGenes_getExtraExonsKeys(RefineSolexaGenes *rsg) {
   if (rsg->extraExonsKeys == NULL) {
-    rsg->extraExonsKeys  = StringHash_getKeys(RefineSolexaGenes_getExtraExons(rsg));
+    // The keys stay owned by the hash, which lives as long as rsg
+    rsg->extraExonsKeys  = StringHash_getKeysNoCopy(RefineSolexaGenes_getExtraExons(rsg));
   }
 
   return rsg->extraExonsKeys;
@@ -6033,6 +7407,14 @@ int RefineSolexaGenes_getMaxRecursions(RefineSolexaGenes *rsg) {
   return rsg->maxRecursions;
 }
 
+void RefineSolexaGenes_setTopPaths(RefineSolexaGenes *rsg, int topPaths) {
+  rsg->topPaths = topPaths;
+}
+
+int RefineSolexaGenes_getTopPaths(RefineSolexaGenes *rsg) {
+  return rsg->topPaths;
+}
+
 void RefineSolexaGenes_setMinSingleExonLength(RefineSolexaGenes *rsg, int minSingleExonLength) {
   rsg->minSingleExonLength = minSingleExonLength;
 }
@@ -6219,10 +7601,18 @@ char *RefineSolexaGenes_getTypePrefix(RefineSolexaGenes *rsg) {
   return rsg->typePrefix;
 }
 
+void RefineSolexaGenes_setJunctionIndexDir(RefineSolexaGenes *rsg, char *junctionIndexDir) {
+  rsg->junctionIndexDir = StrUtil_copyString(&rsg->junctionIndexDir, junctionIndexDir, 0);
+}
+
+char *RefineSolexaGenes_getJunctionIndexDir(RefineSolexaGenes *rsg) {
+  return rsg->junctionIndexDir;
+}
+
 Exon *ExonUtils_cloneExon(Exon *exon) {
   Vector *supportingFeatures = NULL;
 
-  nExonClone++;
+  __sync_fetch_and_add(&nExonClone, 1);
 
   Vector *origSupport = Exon_getAllSupportingFeatures(exon);
   if (origSupport != NULL && Vector_getNumElement(origSupport)) {
@@ -6350,7 +7740,16 @@ Vector *TranslationUtils_generateORFRanges(Transcript *transcript, int requireMe
   long codonTableId = 1;
 
   //fprintf(stderr, "translateable seq = %s\n",mRNA);
-  translate(mRNA, aaSeq, lengths, codonTableId, lenmRNA);
+  if (allowReverse) {
+    translate(mRNA, aaSeq, lengths, codonTableId, lenmRNA);
+  } else {
+    // Reverse frames are skipped below so only translate the forward three
+    translate_three(mRNA, aaSeq, lengths, codonTableId, lenmRNA);
+    for (i=3;i<6;i++) {
+      aaSeq[i][0] = '\0';
+      lengths[i] = 0;
+    }
+  }
 
   for (i=0;i<6;i++) {
     endAaSeq[i] = aaSeq[i] + lengths[i];
@@ -6521,7 +7920,16 @@ Vector *TranslationUtils_generateORFRanges(Transcript *transcript, int requireMe
   long codonTableId = 1;
 
   //fprintf(stderr, "translateable seq = %s\n",mRNA);
-  translate(mRNA, aaSeq, lengths, codonTableId, lenmRNA);
+  if (allowReverse) {
+    translate(mRNA, aaSeq, lengths, codonTableId, lenmRNA);
+  } else {
+    // Reverse frames are skipped below so only translate the forward three
+    translate_three(mRNA, aaSeq, lengths, codonTableId, lenmRNA);
+    for (i=3;i<6;i++) {
+      aaSeq[i][0] = '\0';
+      lengths[i] = 0;
+    }
+  }
 
   for (i=0;i<6;i++) {
     endAaSeq[i] = aaSeq[i] + lengths[i];
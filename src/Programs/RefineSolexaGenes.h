@@ -17,6 +17,8 @@
 #ifndef __REFINESOLEXAGENES_H__
 #define __REFINESOLEXAGENES_H__
 
+#include <stdint.h>
+
 #include "DBAdaptor.h"
 #include "Vector.h"
 #include "Slice.h"
@@ -24,6 +26,7 @@
 #include "SliceAdaptor.h"
 #include "Analysis.h"
 #include "Transcript.h"
+#include "DNAAlignFeature.h"
 
 #include "sam.h"
 #include "hts.h"
@@ -54,6 +57,69 @@ typedef struct ExtraExonDataStruct {
   int score;
 } ExtraExonData;
 
+/*
+  Splice junction counts for the streaming BAM intron extraction. Junctions are
+  kept per file (fileNum) so each file's depth filter can be applied before
+  the files are combined. Stored in an open addressing table (linear probing,
+  power of two size) keyed on the integer coords, so no key strings are made
+  per read. An empty slot has score 0.
+*/
+typedef struct JunctionStruct {
+  long prevExonEnd;
+  long nextExonStart;
+  int  strand;
+  int  fileNum;
+  int  score;
+} Junction;
+
+/*
+  Junction index file. Holds the collapsed (depth filtered, merged across files)
+  junctions and the extra exons for one whole seq region from one set of intron
+  BAM files, so they don't have to be extracted from the BAMs again on later runs
+  (for example a sweep over cons/noncons limits). The file is mapped read only.
+
+  Layout, all in native byte order:
+    JunctionIndexHeader
+    nJunction Junctions sorted on prevExonEnd
+    nExtraExon JunctionIndexExtraExons sorted on start
+    nExtraCoord int64_t extra exon coords
+
+  The max spans let a range lookup binary search for the first entry which could
+  overlap the range.
+*/
+#define JUNCTIONINDEX_MAGIC "RSGJIDX1"
+
+// Most coords an extra exon can have
+#define JUNCTIONINDEX_MAXCOORD 1024
+
+typedef struct JunctionIndexHeaderStruct {
+  char     magic[8];
+  uint64_t key;
+  int64_t  nJunction;
+  int64_t  nExtraExon;
+  int64_t  nExtraCoord;
+  int64_t  maxJunctionSpan;
+  int64_t  maxExtraExonSpan;
+} JunctionIndexHeader;
+
+typedef struct JunctionIndexExtraExonStruct {
+  int64_t start;
+  int64_t end;
+  int64_t coordOffset;
+  int32_t nCoord;
+  int32_t score;
+} JunctionIndexExtraExon;
+
+typedef struct JunctionIndexStruct {
+  char *seqRegionName;
+  void *map;
+  size_t mapLen;
+  JunctionIndexHeader *header;
+  Junction *junctions;
+  JunctionIndexExtraExon *extraExons;
+  int64_t *extraCoords;
+} JunctionIndex;
+
 typedef struct RefineSolexaGenesStruct {
   char *badModelsType;
   char *bestScoreType;
@@ -65,6 +131,7 @@ typedef struct RefineSolexaGenesStruct {
   char *otherIsoformsType;
   char *singleExonModelType;
   char *typePrefix;
+  char *junctionIndexDir;
 
   int dryRun;
   int max3PrimeExons;
@@ -83,6 +150,7 @@ typedef struct RefineSolexaGenesStruct {
   int trimUtr;
   int verbosity;
   int threads;
+  int topPaths;
   int ucsc_naming;
   int writeIntrons;
 
@@ -124,6 +192,13 @@ typedef struct RefineSolexaGenesStruct {
 
   long longestIntronLength;
 
+  // When running a work unit, only prelim genes starting in coreStart to coreEnd are used (0 for no restriction)
+  long coreStart;
+  long coreEnd;
+
+  // Mapped junction index for the current seq region when JUNCTION_INDEX_DIR is set
+  struct JunctionIndexStruct *junctionIndex;
+
   config_setting_t *databaseConfig;
 } RefineSolexaGenes;
 
@@ -141,34 +216,124 @@ typedef struct IntronBamConfigStruct {
   int mixedBam;
   Vector *groupNames;
   char *fileName;
+
+  // Opened on first use and kept open so they can be reused for each input id
+  htsFile *sam;
+  bam_hdr_t *header;
+  hts_idx_t *idx;
 } IntronBamConfig;
 
+/*
+  A piece of an assembly for the whole genome mode - inputId is the slice to fetch
+  (padded either side), and only the prelim genes which start within coreStart to
+  coreEnd belong to this unit. The unit boundaries are between gene clusters.
+*/
+typedef struct WorkUnitStruct {
+  int unitNum;
+  char *inputId;
+  long coreStart;
+  long coreEnd;
+} WorkUnit;
+
 typedef struct ORFRangeStruct {
   long length;
   long start;
   long end;
 } ORFRange;
 
+/*
+  Exon/intron connection graph used by processPaths to work out the possible
+  paths through a gene. Nodes 0 to nExon-1 are the exons (indexes into the
+  exons Vector) and nodes nExon upwards are the introns. Edges go from an exon
+  to an intron on its right and from an intron to an exon on its right, so the
+  graph is acyclic.
+*/
+typedef struct PathGraphStruct {
+  int nExon;
+  int nNode;
+  int nodeAlloc;
+  DNAAlignFeature **introns; // Intron feature for node nExon+i is introns[i]
+  StringHash *intronNodes;   // Node number (long *) for each intron, keyed on intron HitSeqName
+  double *scores;            // Each node's contribution to the score of a path through it
+  int *nParent;
+  int *nChild;
+  int *childAlloc;
+  int **children;
+} PathGraph;
+
+// A path through a PathGraph - alternating exon and intron node numbers, starting and ending with an exon
+typedef struct PathStruct {
+  double score;
+  int nNode;
+  int nodes[1]; // Allocated with the struct to be nNode long
+} Path;
+
+// One of the best scoring paths from a node - the rest of the path is entry rank in child's list
+typedef struct PathRankStruct {
+  double score;
+  int child;
+  int rank;
+} PathRank;
+
+// Shared by the refineGenes tasks - each task fills in its gene's entry in geneOutputs
+typedef struct RefineGenesTaskDataStruct {
+  RefineSolexaGenes *rsg;
+  Vector *prelimGenes;
+  Vector **geneOutputs;
+} RefineGenesTaskData;
+
 
 
 RefineSolexaGenes *RefineSolexaGenes_new(char *configFile, char *logicName);
 DBAdaptor *RefineSolexaGenes_getDbAdaptor(RefineSolexaGenes *rsg, char *alias);
 void RefineSolexaGenes_fetchInput(RefineSolexaGenes *rsg);
 void  RefineSolexaGenes_run(RefineSolexaGenes *rsg);
+void RefineSolexaGenes_runInputId(RefineSolexaGenes *rsg, char *logicName, double restartNonConsLim);
+void RefineSolexaGenes_clearInput(RefineSolexaGenes *rsg);
+void RefineSolexaGenes_closeIntronBams(RefineSolexaGenes *rsg);
+Vector *RefineSolexaGenes_makeWorkUnits(RefineSolexaGenes *rsg, long unitSize, long unitPad);
+void RefineSolexaGenes_writeWorkQueue(char *queueFile, Vector *units);
+Vector *RefineSolexaGenes_readWorkQueue(char *queueFile);
+void RefineSolexaGenes_runWorkQueue(RefineSolexaGenes *rsg, char *queueFile, long unitSize, long unitPad, char *logicName, double restartNonConsLim);
+int RefineSolexaGenes_readUnitNumFile(char *fileName, char *flags, int nUnit);
+void RefineSolexaGenes_appendUnitNum(FILE *fp, char *fileName, int unitNum);
+void RefineSolexaGenes_deleteUnitOutput(RefineSolexaGenes *rsg, WorkUnit *unit, char *logicName, double restartNonConsLim);
+void RefineSolexaGenes_makeOutputLogicName(RefineSolexaGenes *rsg, char *typeName, char *logicName, double consLim, double nonConsLim);
+WorkUnit *WorkUnit_new(int unitNum, char *inputId, long coreStart, long coreEnd);
+void WorkUnit_free(WorkUnit *unit);
+ExtraExonData *ExtraExonData_new(long *coords, int nCoord);
+void ExtraExonData_free(ExtraExonData *eed);
+int JunctionIndex_checkCounts(JunctionIndexHeader *header, size_t fileSize);
+JunctionIndex *JunctionIndex_open(char *fileName, uint64_t key, char *seqRegionName);
+void JunctionIndex_close(JunctionIndex *ji);
+Junction *JunctionIndex_fetchRange(JunctionIndex *ji, long start, long end, int *retNJunction);
+void JunctionIndex_addExtraExons(JunctionIndex *ji, long start, long end, StringHash *extraExons);
 void RefineSolexaGenes_refineGenes(RefineSolexaGenes *rsg);
+void RefineSolexaGenes_refineGeneTask(void *data, int taskNum, int workerNum);
+void RefineSolexaGenes_refineGene(RefineSolexaGenes *rsg, Gene *gene);
+void RefineSolexaGenes_prepareForThreads(RefineSolexaGenes *rsg);
+Vector *RefineSolexaGenes_localiseIntrons(RefineSolexaGenes *rsg, Vector *introns, StringHash *geneIntrons);
 Analysis *RefineSolexaGenes_createAnalysisObject(RefineSolexaGenes *rsg, char *logicName);
 Vector *RefineSolexaGenes_reclusterModels(RefineSolexaGenes *rsg, Vector *clusters, Vector **retNewClusters);
 ModelCluster *RefineSolexaGenes_recalculateCluster(RefineSolexaGenes *rsg, Vector *genes);
 void RefineSolexaGenes_filterModels(RefineSolexaGenes *rsg, Vector *clusters);
-Vector *RefineSolexaGenes_makeModels(RefineSolexaGenes *rsg, StringHash *paths, int strand, Vector *exons, Gene *gene, StringHash *intronHash);
+Vector *RefineSolexaGenes_makeModels(RefineSolexaGenes *rsg, Vector *paths, PathGraph *pathGraph, int strand, Vector *exons, Gene *gene);
 Transcript *RefineSolexaGenes_modifyTranscript(RefineSolexaGenes *rsg, Transcript *tran, Vector *exons);
 void RefineSolexaGenes_writeOutput(RefineSolexaGenes *rsg);
-int RefineSolexaGenes_processTree(RefineSolexaGenes *rsg, StringHash *hashref, char *index, char *soFar, StringHash *paths, int *recLev);
-StringHash *RefineSolexaGenes_processPaths(RefineSolexaGenes *rsg, Vector *exons, Vector *exonIntron, StringHash *intronExon, int strict, int *giveUpFlag);
+Vector *RefineSolexaGenes_processPaths(RefineSolexaGenes *rsg, Vector *exons, Vector *exonIntron, StringHash *intronExon, int strict, PathGraph **retGraph, int *giveUpFlag);
+PathGraph *PathGraph_new(Vector *exons);
+int PathGraph_getIntronNode(PathGraph *pg, DNAAlignFeature *intron);
+void PathGraph_addEdge(PathGraph *pg, int from, int to);
+int *PathGraph_topologicalOrder(PathGraph *pg);
+long PathGraph_countPaths(PathGraph *pg, int *order);
+Vector *PathGraph_enumeratePaths(PathGraph *pg);
+Vector *PathGraph_topPaths(PathGraph *pg, int *order, int k);
+void PathGraph_free(PathGraph *pg);
+Path *Path_new(int *nodes, int nNode, double score);
 Vector *RefineSolexaGenes_makeModelClusters(RefineSolexaGenes *rsg, Vector *models, int strand);
 Vector *RefineSolexaGenes_mergeExons(RefineSolexaGenes *rsg, Gene *gene, int strand);
 Exon *RefineSolexaGenes_binSearchForOverlap(RefineSolexaGenes *rsg, Vector *exons, int pos);
-void RefineSolexaGenes_bamToIntronFeatures(RefineSolexaGenes *rsg, IntronBamConfig *intronBamConf, htsFile *sam, bam_hdr_t *header, hts_idx_t *idx, int ref, int begRange, int endRange);
+void RefineSolexaGenes_bamToIntronFeatures(RefineSolexaGenes *rsg, Vector *intronBamFiles, int *refs, int begRange, int endRange);
 int RefineSolexaGenes_getUngappedFeatures(RefineSolexaGenes *rsg, bam_hdr_t *header, bam1_t *b, CigarBlock **ugfs);
 void RefineSolexaGenes_dnaToIntronFeatures(RefineSolexaGenes *rsg, long start, long end);
 Vector *RefineSolexaGenes_fetchIntronFeatures(RefineSolexaGenes *rsg, long start, long end, long *offsetP);
@@ -218,6 +383,8 @@ void RefineSolexaGenes_setMaxNum(RefineSolexaGenes *rsg, int maxNum);
 int RefineSolexaGenes_getMaxNum(RefineSolexaGenes *rsg);
 void RefineSolexaGenes_setMaxRecursions(RefineSolexaGenes *rsg, int maxRecursions);
 int RefineSolexaGenes_getMaxRecursions(RefineSolexaGenes *rsg);
+void RefineSolexaGenes_setTopPaths(RefineSolexaGenes *rsg, int topPaths);
+int RefineSolexaGenes_getTopPaths(RefineSolexaGenes *rsg);
 void RefineSolexaGenes_setMinSingleExonLength(RefineSolexaGenes *rsg, int minSingleExonLength);
 int RefineSolexaGenes_getMinSingleExonLength(RefineSolexaGenes *rsg);
 void RefineSolexaGenes_setMinSingleExonCDSPercLength(RefineSolexaGenes *rsg, double minSingleExonCDSPercLength);
@@ -292,6 +459,8 @@ void RefineSolexaGenes_usage();
   char *RefineSolexaGenes_getInputId(RefineSolexaGenes *rsg);
   void RefineSolexaGenes_setTypePrefix(RefineSolexaGenes *rsg, char *typePrefix);
   char *RefineSolexaGenes_getTypePrefix(RefineSolexaGenes *rsg);
+  void RefineSolexaGenes_setJunctionIndexDir(RefineSolexaGenes *rsg, char *junctionIndexDir);
+  char *RefineSolexaGenes_getJunctionIndexDir(RefineSolexaGenes *rsg);
   Vector *RefineSolexaGenes_getOutput(RefineSolexaGenes *rsg);
   void RefineSolexaGenes_addToOutput(RefineSolexaGenes *rsg, Gene *gene);
   void RefineSolexaGenes_setDb(RefineSolexaGenes *rsg, DBAdaptor *db);
@@ -47,6 +47,7 @@
 #include "StrUtil.h"
 #include "IDHash.h"
 #include "Transcript.h"
+#include "IntervalIndex.h"
 
 #include "bamhelper.h"
 #include "sam.h"
@@ -62,6 +63,7 @@ Vector *   flattenGene(Gene *gene);
 int        geneStartCompFunc(const void *one, const void *two);
 Vector *   getGenes(Slice *slice, int flags);
 IDHash *   makeGeneResultsHash(Vector *genes);
+IntervalIndex *makeCodingExonIndex(Vector *genes, IDHash *geneResultsHash);
 bam1_t    *mateFoundInVectors(bam1_t *b, Vector **vectors);
 
 typedef struct GeneResultsStruct {
@@ -70,6 +72,7 @@ typedef struct GeneResultsStruct {
   Gene *gene;
   Vector *flatFeatures;
   long  flatLength;
+  long  lastReadNum; // Number of the last read counted for this gene, so each read is only counted once per gene
 } GeneResults;
 
 // Flag values
@@ -349,6 +352,57 @@ Vector *flattenGene(Gene *gene) {
   return blockFeatures;
 }
 
+/*
+ Overlap index of the exon blocks to count reads against. Only protein coding
+ transcripts are counted, so each gene's blocks are its protein coding exons
+ merged where they overlap. The data for each block is the gene's GeneResults.
+*/
+IntervalIndex *makeCodingExonIndex(Vector *genes, IDHash *geneResultsHash) {
+  IntervalIndex *exonIndex = IntervalIndex_new();
+
+  int i;
+  for (i=0; i<Vector_getNumElement(genes); i++) {
+    Gene *gene = Vector_getElementAt(genes, i);
+    GeneResults *gr = IDHash_getValue(geneResultsHash, Gene_getDbID(gene));
+    Vector *exons = Vector_new();
+
+    int j;
+    for (j=0; j<Gene_getTranscriptCount(gene); j++) {
+      Transcript *trans = Gene_getTranscriptAt(gene,j);
+      if (strcmp(Transcript_getBiotype(trans),"protein_coding")) {
+        continue;
+      }
+
+      int k;
+      for (k=0; k<Transcript_getExonCount(trans); k++) {
+        Vector_addElement(exons, Transcript_getExonAt(trans,k));
+      }
+    }
+    Vector_sort(exons, SeqFeature_startCompFunc);
+
+    long blockStart = 0;
+    long blockEnd = 0;
+    for (j=0; j<Vector_getNumElement(exons); j++) {
+      Exon *exon = Vector_getElementAt(exons, j);
+
+      if (j > 0 && Exon_getStart(exon) <= blockEnd) {
+        if (Exon_getEnd(exon) > blockEnd) blockEnd = Exon_getEnd(exon);
+      } else {
+        if (j > 0) IntervalIndex_add(exonIndex, blockStart, blockEnd, gr);
+        blockStart = Exon_getStart(exon);
+        blockEnd   = Exon_getEnd(exon);
+      }
+    }
+    if (Vector_getNumElement(exons)) IntervalIndex_add(exonIndex, blockStart, blockEnd, gr);
+
+    Vector_free(exons);
+  }
+
+  IntervalIndex_build(exonIndex);
+
+  return exonIndex;
+}
+
 int countReads(char *fName, Slice *slice, htsFile *in, hts_idx_t *idx, int flags, Vector *origGenesVec, IDHash *geneResultsHash, long long countUsableReads) {
   int  ref;
   int  begRange;
@@ -356,7 +410,8 @@ int countReads(char *fName, Slice *slice, htsFile *in, hts_idx_t *idx, int flags
   char region[1024];
   char region_name[512];
   GeneResults *gr; 
-  Vector *genes = Vector_copy(origGenesVec);
+  int *overlapInds = NULL;
+  int nOverlapAlloc = 0;
 
 
   if (Slice_getSeqRegionStart(slice) != 1) {
@@ -387,10 +442,11 @@ int countReads(char *fName, Slice *slice, htsFile *in, hts_idx_t *idx, int flags
   hts_itr_t *iter = sam_itr_queryi(idx, ref, begRange, endRange);
   bam1_t *b = bam_init1();
 
+  IntervalIndex *exonIndex = makeCodingExonIndex(origGenesVec, geneResultsHash);
+
   long counter = 0;
   long overlapping = 0;
   long bad = 0;
-  int startIndex = 0;
   while (bam_itr_next(in, iter, b) >= 0) {
     if (b->core.flag & (BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL | BAM_FDUP)) {
       bad++;
@@ -413,79 +469,21 @@ int countReads(char *fName, Slice *slice, htsFile *in, hts_idx_t *idx, int flags
       fflush(stdout);
     }
 
-    int j;
-    int done = 0;
-    int hadOverlap = 0;
-    
-    for (j=startIndex; j < Vector_getNumElement(genes) && !done; j++) {
-      Gene *gene = Vector_getElementAt(genes,j); 
-      if (!gene) {
-        continue;
-      }
 // Remember: b->core.pos is zero based!
-      if (b->core.pos < Gene_getEnd(gene) && end >= Gene_getStart(gene)) {
-        int k;
-
-        int doneGene = 0;
-        for (k=0; k<Gene_getTranscriptCount(gene) && !doneGene; k++) {
-          Transcript *trans = Gene_getTranscriptAt(gene,k);
-          if (strcmp(Transcript_getBiotype(trans),"protein_coding")) {
-            continue;
-          }
+    int nOverlap = IntervalIndex_findOverlaps(exonIndex, b->core.pos+1, end, &overlapInds, &nOverlapAlloc);
 
-          if (b->core.pos < Transcript_getEnd(trans) && end >= Transcript_getStart(trans)) {
-            int m;
-     
-            for (m=0; m<Transcript_getExonCount(trans) && !doneGene; m++) {
-              Exon *exon = Transcript_getExonAt(trans,m);
-
-              if (b->core.pos < Exon_getEnd(exon) && end >= Exon_getStart(exon)) {
-
-                // Only count as overlapping once (could be that a read overlaps more than one gene)
-                if (!hadOverlap) {
-                  overlapping++;
-                  hadOverlap = 1;
-                }
-
-                gr = IDHash_getValue(geneResultsHash, Gene_getDbID(gene));
-                gr->score++;
-                
-                doneGene = 1;
-              }
-            }
-          }
-        }
-      } else if (Gene_getStart(gene) > end) {
-        done = 1;
-      } else if (Gene_getEnd(gene) < b->core.pos+1) {
-//        gr = IDHash_getValue(geneResultsHash, Gene_getDbID(gene));
-//        printf("Gene %s (%s) score %ld\n",Gene_getStableId(gene), 
-//                                          Gene_getDisplayXref(gene) ? DBEntry_getDisplayId(Gene_getDisplayXref(gene)) : "", 
-//                                          gr->score);
-
-        if (verbosity > 1) { 
-          printf("Removing gene %s (index %d) with extent %ld to %ld\n", 
-                 Gene_getStableId(gene), 
-                 gr->index,
-                 Gene_getStart(gene),
-                 Gene_getEnd(gene));
-        }
-        Vector_setElementAt(genes,j,NULL);
+    // Only count as overlapping once (could be that a read overlaps more than one gene)
+    if (nOverlap) {
+      overlapping++;
+    }
 
-        // Magic (very important for speed) - move startIndex to first non null gene
-        int n;
-        startIndex = 0;
-        for (n=0;n<Vector_getNumElement(genes);n++) {
-          void *v = Vector_getElementAt(genes,n);
+    int j;
+    for (j=0; j<nOverlap; j++) {
+      gr = IntervalIndex_getIntervalAt(exonIndex, overlapInds[j])->data;
 
-          if (v != NULL) {
-            break;
-          }
-          startIndex++;
-        }
-        if (verbosity > 1) { 
-          printf("startIndex now %d\n",startIndex);
-        }
+      if (gr->lastReadNum != counter) {
+        gr->score++;
+        gr->lastReadNum = counter;
       }
     }
   }
@@ -508,6 +506,9 @@ int countReads(char *fName, Slice *slice, htsFile *in, hts_idx_t *idx, int flags
 
   printf("Read %ld reads. Num overlapping exons %ld. Number of bad reads (unmapped, qc fail, secondary, dup) %ld\n", counter, overlapping, bad);
 
+  IntervalIndex_free(exonIndex);
+  free(overlapInds);
+
   sam_itr_destroy(iter);
   bam_destroy1(b);
 }
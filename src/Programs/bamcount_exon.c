@@ -48,6 +48,7 @@
 #include "StrUtil.h"
 #include "IDHash.h"
 #include "Transcript.h"
+#include "IntervalIndex.h"
 
 #include "bamhelper.h"
 #include "sam.h"
@@ -65,7 +66,9 @@ Vector *   getGenes(Slice *slice, int flags);
 IDHash *   makeGeneResultsHash(Vector *genes);
 bam1_t    *mateFoundInVectors(bam1_t *b, Vector **vectors);
 
-Vector *Bam_cigarToUngapped(bam1_t *b);
+IntervalIndex *makeExonIndex(Vector *genes, IDHash *geneResultsHash);
+
+int Bam_cigarToBlocks(bam1_t *b, long **startsP, long **endsP, int *nAllocP);
 
 typedef struct GeneResultsStruct {
   int   index;
@@ -85,6 +88,8 @@ typedef struct GeneResultsStruct {
 
 int verbosity = 1;
 
+// Tests build this file with BAMCOUNTEXON_NO_DRIVER so they can call its functions without main
+#ifndef BAMCOUNTEXON_NO_DRIVER
 int main(int argc, char *argv[]) {
   DBAdaptor *      dba;
   StatementHandle *sth;
@@ -241,6 +246,7 @@ long long totalUsableReads = 1;
   if (bedFp) fclose(bedFp);
   return 0;
 }
+#endif
 
 /*
  Program usage message
@@ -374,6 +380,29 @@ Vector *flattenGene(Gene *gene) {
   return blockFeatures;
 }
 
+/*
+ Overlap index of the exons of all the genes. The data for each interval is the Exon.
+*/
+IntervalIndex *makeExonIndex(Vector *genes, IDHash *geneResultsHash) {
+  IntervalIndex *exonIndex = IntervalIndex_new();
+
+  int i;
+  for (i=0; i<Vector_getNumElement(genes); i++) {
+    Gene *gene = Vector_getElementAt(genes, i);
+    GeneResults *gr = IDHash_getValue(geneResultsHash, Gene_getDbID(gene));
+
+    int j;
+    for (j=0; j<Vector_getNumElement(gr->exons); j++) {
+      Exon *exon = Vector_getElementAt(gr->exons, j);
+      IntervalIndex_add(exonIndex, Exon_getStart(exon), Exon_getEnd(exon), exon);
+    }
+  }
+
+  IntervalIndex_build(exonIndex);
+
+  return exonIndex;
+}
+
 int countReads(char *fName, Slice *slice, htsFile *in, hts_idx_t *idx, int flags, Vector *origGenesVec, IDHash *geneResultsHash, long long countUsableReads, FILE *bedFp) {
   int  ref;
   int  begRange;
@@ -381,7 +410,11 @@ int countReads(char *fName, Slice *slice, htsFile *in, hts_idx_t *idx, int flags
   char region[1024];
   char region_name[512];
   GeneResults *gr; 
-  Vector *genes = Vector_copy(origGenesVec);
+  int *overlapInds = NULL;
+  int nOverlapAlloc = 0;
+  long *blockStarts = NULL;
+  long *blockEnds = NULL;
+  int nBlockAlloc = 0;
   //IDHash *transExonHash = IDHash_new(IDHASH_MEDIUM);
 
 /*
@@ -414,17 +447,17 @@ int countReads(char *fName, Slice *slice, htsFile *in, hts_idx_t *idx, int flags
   hts_itr_t *iter = sam_itr_queryi(idx, ref, begRange, endRange);
   bam1_t *b = bam_init1();
 
+  IntervalIndex *exonIndex = makeExonIndex(origGenesVec, geneResultsHash);
+
   long counter = 0;
   long overlapping = 0;
   long bad = 0;
-  int startIndex = 0;
   while (bam_itr_next(in, iter, b) >= 0) {
     if (b->core.flag & (BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL | BAM_FDUP)) {
       bad++;
       continue;
     }
 
-    Vector *features = NULL;
     int end;
     //end = bam_calend(&b->core, bam1_cigar(b));
     end = bam_endpos(b);
@@ -441,122 +474,23 @@ int countReads(char *fName, Slice *slice, htsFile *in, hts_idx_t *idx, int flags
       fflush(stdout);
     }
 
+    // Each ungapped block of the read scores every exon it overlaps. Blocks are clipped to the read
+    // end because Bam_cigarToBlocks block ends are one past the aligned bases
+    int nBlock = Bam_cigarToBlocks(b, &blockStarts, &blockEnds, &nBlockAlloc);
     int j;
-    int done = 0;
-    int hadOverlap = 0;
-    
-    for (j=startIndex; j < Vector_getNumElement(genes) && !done; j++) {
-      Gene *gene = Vector_getElementAt(genes,j); 
-      if (!gene) {
+    for (j=0; j<nBlock; j++) {
+      long blockEnd = blockEnds[j] < end ? blockEnds[j] : end;
+      if (blockStarts[j] > blockEnd) {
         continue;
       }
-// Remember: b->core.pos is zero based!
-      if (b->core.pos < Gene_getEnd(gene) && end >= Gene_getStart(gene)) {
-        int k;
-
-        int doneGene = 0;
-
-        gr = IDHash_getValue(geneResultsHash, Gene_getDbID(gene));
-        Vector *geneExons = gr->exons;
-//        Vector *geneExons = Gene_getAllExons(gene);
-        int m;
-        for (m=0; m<Vector_getNumElement(geneExons) && !doneGene; m++) {
-          Exon *exon = Vector_getElementAt(geneExons, m);
-
-          if (b->core.pos < Exon_getEnd(exon) && end >= Exon_getStart(exon)) {
-            if (features == NULL) {
-              features = Bam_cigarToUngapped(b);
-            }
-            int n=0;
-            for (n=0; n<Vector_getNumElement(features); n++) {
-              DNAAlignFeature *daf = Vector_getElementAt(features, n);
-              if (DNAAlignFeature_getStart(daf) <= Exon_getEnd(exon) && 
-                  DNAAlignFeature_getEnd(daf) >= Exon_getStart(exon)) {
-                Exon_setScore(exon, Exon_getScore(exon) + 1);
-              }
-            }
-          }
-        }
-        //Vector_free(geneExons);
-
-/*
-        for (k=0; k<Gene_getTranscriptCount(gene) && !doneGene; k++) {
-          Transcript *trans = Gene_getTranscriptAt(gene,k);
-//          if (strcmp(Transcript_getBiotype(trans),"protein_coding")) {
-//            continue;
-//          }
-
-          if (b->core.pos < Transcript_getEnd(trans) && end >= Transcript_getStart(trans)) {
-            int m;
-     
-            for (m=0; m<Transcript_getExonCount(trans) && !doneGene; m++) {
-              Exon *exon = Transcript_getExonAt(trans,m);
-
-              if (!IDHash_contains(transExonHash, (IDType)exon)) {
-                IDHash_add(transExonHash, (IDType) exon, trans);
-              }
-              if (IDHash_getValue(transExonHash, (IDType)exon) == trans) {
-                if (b->core.pos < Exon_getEnd(exon) && end >= Exon_getStart(exon)) {
-                  if (features == NULL) {
-                    features = Bam_cigarToUngapped(b);
-                  }
-                  int n=0;
-                  for (n=0; n<Vector_getNumElement(features); n++) {
-                    DNAAlignFeature *daf = Vector_getElementAt(features, n);
-                    if (DNAAlignFeature_getStart(daf) <= Exon_getEnd(exon) && 
-                        DNAAlignFeature_getEnd(daf) >= Exon_getStart(exon)) {
-                      Exon_setScore(exon, Exon_getScore(exon) + 1);
-                    }
-                  }
-  
-  //                gr = IDHash_getValue(geneResultsHash, Gene_getDbID(gene));
-  //                gr->score++;
-                  
-                  //doneGene = 1;
-                }
-              }
-            }
-          }
-        }
-*/
-      } else if (Gene_getStart(gene) > end) {
-        done = 1;
-      } else if (Gene_getEnd(gene) < b->core.pos+1) {
-//        gr = IDHash_getValue(geneResultsHash, Gene_getDbID(gene));
-//        printf("Gene %s (%s) score %ld\n",Gene_getStableId(gene), 
-//                                          Gene_getDisplayXref(gene) ? DBEntry_getDisplayId(Gene_getDisplayXref(gene)) : "", 
-//                                          gr->score);
-
-        if (verbosity > 1) { 
-          printf("Removing gene %s (index %d) with extent %ld to %ld\n", 
-                 Gene_getStableId(gene), 
-                 gr->index,
-                 Gene_getStart(gene),
-                 Gene_getEnd(gene));
-        }
-        Vector_setElementAt(genes,j,NULL);
-
-        // Magic (very important for speed) - move startIndex to first non null gene
-        int n;
-        startIndex = 0;
-        for (n=0;n<Vector_getNumElement(genes);n++) {
-          void *v = Vector_getElementAt(genes,n);
 
-          if (v != NULL) {
-            break;
-          }
-          startIndex++;
-        }
-        if (verbosity > 1) { 
-          printf("startIndex now %d\n",startIndex);
-        }
+      int nOverlap = IntervalIndex_findOverlaps(exonIndex, blockStarts[j], blockEnd, &overlapInds, &nOverlapAlloc);
+      int k;
+      for (k=0; k<nOverlap; k++) {
+        Exon *exon = IntervalIndex_getIntervalAt(exonIndex, overlapInds[k])->data;
+        Exon_setScore(exon, Exon_getScore(exon) + 1);
       }
     }
-    if (features) {
-// Temporary - use free to free DNAAlignFeature
-      Vector_setFreeFunc(features, free);
-      Vector_free(features);
-    }
   }
   if (verbosity > 1) { printf("\n"); }
 
@@ -652,6 +586,11 @@ int countReads(char *fName, Slice *slice, htsFile *in, hts_idx_t *idx, int flags
   printf("Read %ld reads. Num overlapping exons %ld. Number of bad reads (unmapped, qc fail, secondary, dup) %ld\n", counter, overlapping, bad);
 */
 
+  IntervalIndex_free(exonIndex);
+  free(overlapInds);
+  free(blockStarts);
+  free(blockEnds);
+
   sam_itr_destroy(iter);
   bam_destroy1(b);
 }
@@ -740,46 +679,43 @@ int findPosInVec(Vector *vec, int pos, char *bqname) {
   return -1;
 }
 
-Vector *Bam_cigarToUngapped(bam1_t *b) {
+/*
+ Fills *startsP and *endsP (reallocated as needed, *nAllocP is their allocated length)
+ with the reference coords of the aligned blocks of the read and returns the number of
+ blocks. Coords are the same as the DNAAlignFeatures this used to make: start is 1 based,
+ end is one past the last aligned base.
+*/
+int Bam_cigarToBlocks(bam1_t *b, long **startsP, long **endsP, int *nAllocP) {
   int cigInd;
   int refPos;
-  int readPos;
+  int nBlock = 0;
   uint32_t *cigar = bam_get_cigar(b);
 
- Vector *features = Vector_new();
+  if (b->core.n_cigar > *nAllocP) {
+    *nAllocP = b->core.n_cigar;
+    if ((*startsP = (long *)realloc(*startsP, *nAllocP * sizeof(long))) == NULL ||
+        (*endsP = (long *)realloc(*endsP, *nAllocP * sizeof(long))) == NULL) {
+      fprintf(stderr,"ERROR: Failed reallocating block arrays\n");
+      exit(1);
+    }
+  }
 
-  for (cigInd = readPos = 0, refPos = b->core.pos; cigInd < b->core.n_cigar; ++cigInd) {
-    int k;
+  for (cigInd = 0, refPos = b->core.pos; cigInd < b->core.n_cigar; ++cigInd) {
     int lenCigBlock = cigar[cigInd]>>4;
     int op          = cigar[cigInd]&0xf;
 
     if (op == BAM_CMATCH || op == BAM_CEQUAL || op == BAM_CDIFF) {
-      DNAAlignFeature *daf = DNAAlignFeature_new();
+      (*startsP)[nBlock] = refPos+1;
+      (*endsP)[nBlock]   = refPos+lenCigBlock+1;
+      nBlock++;
 
-      DNAAlignFeature_setStart(daf, refPos+1);
-      DNAAlignFeature_setEnd(daf, refPos+lenCigBlock+1);
-
-      Vector_addElement(features, daf);
-
-      refPos += lenCigBlock; readPos += lenCigBlock;
-    } else if (op == BAM_CDEL) {
-/* Not sure if I want a feature for this
-      for (k = 0; k < lenCigBlock; ++k) {
-      //  if (ref[refPos+k] == 0) break;
-        coverage[refPos+k].coverage++;
-      }
-      if (k < lenCigBlock) break;
-*/
       refPos += lenCigBlock;
-    } else if (op == BAM_CSOFT_CLIP) {
-      readPos += lenCigBlock;
-    } else if (op == BAM_CHARD_CLIP) {
-    } else if (op == BAM_CINS) {
-       readPos += lenCigBlock;
-    } else if (op == BAM_CREF_SKIP) {
-       refPos += lenCigBlock;
+    } else if (op == BAM_CDEL || op == BAM_CREF_SKIP) {
+      // Deletions and introns use up reference without making a block, as in the
+      // Bam_cigarToUngapped this replaced, so the blocks after them are in the right place
+      refPos += lenCigBlock;
     }
   }
 
-  return features;
+  return nBlock;
 }
@@ -56,6 +56,7 @@
 #include "Basic/Vector.h"
 #include "Slice.h"
 #include "StrUtil.h"
+#include "SeqUtil.h"
 
 #include "bamhelper.h"
 #include "sam.h"
@@ -799,8 +800,6 @@ void clearPairing(bam1_t *b, int end) {
   b->core.flag &= ~(BAM_FPROPER_PAIR);
 }
 
-int8_t seq_comp_table[16] = { 0, 8, 4, 12, 2, 10, 9, 14, 1, 6, 5, 13, 3, 11, 7, 15 };
-
 int mapBam(char *fName, htsFile *out, Mapping *mapping, ReadMapStats *regionStats,
            htsFile *in, hts_idx_t *idx, Vector **mappingVectors, Vector **failedVectors, Vector **remoteMates, int flags, bam_hdr_t *header, bam_hdr_t *outheader) {
   int  ref;
@@ -901,18 +900,14 @@ int mapBam_reverse(Mapping *mapping, bam1_t *b, htsFile *in, htsFile *out, Vecto
     qual = bam_get_qual(b);
 
     int i;
-    uint8_t *revseq  = calloc(1, (b->core.l_qseq+1)/2 + b->core.l_qseq);
-    uint8_t *revqual = revseq + (b->core.l_qseq+1)/2;
-    
-    // make rev com seq and reverse qual at same time
-    for (i=0;i<b->core.l_qseq;i++) {
-      uint8_t ib = seq_comp_table[bam_seqi(seq, b->core.l_qseq-i-1)];
-      revseq[i/2] |= ib << 4*(1-i%2);
-      revqual[i] = qual[b->core.l_qseq-i-1];
-    }
 
-    memcpy(seq, revseq, (b->core.l_qseq+1)/2 + b->core.l_qseq);
-    free(revseq);
+    // rev com seq and reverse qual in place
+    SeqUtil_reverseComplementNt16(seq, b->core.l_qseq);
+    for (i=0;i<b->core.l_qseq/2;i++) {
+      uint8_t tmp = qual[i];
+      qual[i] = qual[b->core.l_qseq-i-1];
+      qual[b->core.l_qseq-i-1] = tmp;
+    }
     
     int *revcig = calloc(1,b->core.n_cigar*4);
     int *cig = bam_get_cigar(b);
@@ -0,0 +1,103 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Arena.h"
+#include "Vector.h"
+
+#include "BaseTest.h"
+#include "EnsC.h"
+
+#include <stdint.h>
+#include <string.h>
+
+int main(int argc, char *argv[]) {
+  char heapByte;
+  int i;
+
+  initEnsC(argc, argv);
+
+  // Small blocks so the tests go over several
+  Arena *arena = Arena_new(1024);
+  ok(1, arena != NULL && Arena_getNumAlloc(arena) == 0);
+
+  char *first = Arena_calloc(arena, 3);
+  char *second = Arena_calloc(arena, 40);
+  ok(2, first[0] == 0 && first[2] == 0 && second[39] == 0 &&
+        ((uintptr_t)first % 16) == 0 && ((uintptr_t)second % 16) == 0 &&
+        Arena_getNumAlloc(arena) == 2);
+
+  // Allocations carry on into new blocks, and everything handed out is in the arena
+  int allIn = 1;
+  for (i=0; i<500; i++) {
+    char *p = Arena_calloc(arena, 24);
+    memset(p, 'x', 24);
+    if (!Arena_contains(arena, p)) allIn = 0;
+  }
+  ok(3, allIn && Arena_contains(arena, first) && !Arena_contains(arena, &heapByte));
+
+  // A big allocation gets its own block, and doesn't waste the current one
+  char *beforeBig = Arena_calloc(arena, 16);
+  char *big = Arena_calloc(arena, 10000);
+  char *afterBig = Arena_calloc(arena, 16);
+  ok(4, Arena_contains(arena, big) && Arena_contains(arena, big + 9999) && afterBig == beforeBig + 16);
+
+  ok(5, !strcmp(Arena_strdup(arena, "ENSE00000000001"), "ENSE00000000001"));
+
+  // Strings for objects in the current arena come from it, others from the heap
+  ok(6, Arena_getCurrent() == NULL && Arena_setCurrent(arena) == NULL && Arena_getCurrent() == arena);
+  char *arenaStr = Arena_copyStringFor(first, 1, "in arena");
+  char *heapStr = Arena_copyStringFor(&heapByte, 0, "on heap");
+  ok(7, Arena_contains(arena, arenaStr) && !Arena_contains(arena, heapStr) && !strcmp(heapStr, "on heap"));
+  free(heapStr);
+
+  // Vectors for arena objects are in the arena, including their element arrays as they
+  // grow, and freeing them does nothing
+  Vector *owner = Vector_newFor(first);
+  ok(8, owner->arena == NULL && !Object_isInArena(owner));
+  Vector_free(owner);
+
+  Object *obj = Arena_calloc(arena, sizeof(Object));
+  Object_setInArena(obj);
+  Vector *v = Vector_newFor(obj);
+  for (i=0; i<100; i++) {
+    Vector_addElement(v, &heapByte);
+  }
+  ok(9, v->arena == arena && Object_isInArena(v) && Arena_contains(arena, v) && Arena_contains(arena, v->elements));
+
+  Vector_free(v);
+  ok(10, Vector_getNumElement(v) == 100 && Object_isInArena(v));
+
+  // memcpy copies take the reference count of the copied object, which has to be put right
+  Vector *heapV = Vector_new();
+  Vector copy;
+  memcpy(&copy, heapV, sizeof(Vector));
+  Object_setInArena(&copy);
+  memcpy(&copy, heapV, sizeof(Vector));
+  Object_setArenaState(&copy, 1);
+  ok(11, Object_isInArena(&copy) && Object_getRefCount(&copy) == OBJECT_ARENAREFCOUNT + 1);
+  Object_setArenaState(&copy, 0);
+  ok(12, !Object_isInArena(&copy) && Object_getRefCount(&copy) == 1);
+  Vector_free(heapV);
+
+  // Reset keeps one block for reuse
+  Arena_reset(arena);
+  ok(13, Arena_getNumAlloc(arena) == 0 && arena->blocks != NULL && arena->blocks->next == NULL && arena->blocks->used == 0);
+
+  Arena_free(arena);
+  ok(14, Arena_getCurrent() == NULL);
+
+  return 0;
+}
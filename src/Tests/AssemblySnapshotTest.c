@@ -0,0 +1,112 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AssemblySnapshot.h"
+
+#include "BaseTest.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+
+int main(int argc, char *argv[]) {
+  char fileName[FILENAME_MAX];
+  char names[] = "chr1\0chr2\0contig_a\0contig_b\0contig_c";
+  AssemblySnapshotRegion regions[] = {
+    { 1, 10, 3000, 0 },
+    { 2, 10, 2000, 5 },
+    { 5, 20, 1000, 10 },
+    { 6, 20, 1000, 19 },
+    { 7, 20, 1000, 28 },
+  };
+  AssemblySnapshotSection sections[] = {
+    { 10, 20, 0, 3 },
+    { 10, 30, 3, 1 },
+  };
+  AssemblySnapshotRow rows[] = {
+    { 0, 1, 1000, 2, 1, 1000, 1 },
+    { 0, 1001, 2000, 3, 1, 1000, -1 },
+    { 1, 1, 1000, 4, 1, 1000, 1 },
+    { 1, 1001, 1500, 4, 1, 500, 1 },
+  };
+  uint64_t key = AssemblySnapshot_makeKey("homo_sapiens_core_70_37\t1\t70\tGRCh37");
+
+  sprintf(fileName, "/tmp/AssemblySnapshotTest.%d.snap", (int)getpid());
+
+  ok(1, AssemblySnapshot_write(fileName, key, regions, 5, sections, 2, rows, 4, names, sizeof(names)) == 0);
+
+  AssemblySnapshot *snap = AssemblySnapshot_open(fileName, key);
+  ok(2, snap != NULL && AssemblySnapshot_getNumRegion(snap) == 5 && AssemblySnapshot_getNumRow(snap) == 4);
+
+  AssemblySnapshotSection *section = AssemblySnapshot_findSection(snap, 10, 20);
+  ok(3, section != NULL && section->firstRow == 0 && section->nRow == 3 &&
+        snap->rows[section->firstRow+1].ori == -1 && snap->rows[section->firstRow+1].asmStart == 1001);
+
+  // No rows between these coord systems
+  ok(4, AssemblySnapshot_findSection(snap, 20, 10) == NULL && AssemblySnapshot_findSection(snap, 10, 25) == NULL);
+
+  long ind = AssemblySnapshot_findRegion(snap, 6);
+  ok(5, ind == 3 && !strcmp(AssemblySnapshot_getRegionName(snap, &snap->regions[ind]), "contig_b") &&
+        AssemblySnapshot_findRegion(snap, 3) == -1 && AssemblySnapshot_findRegion(snap, 8) == -1);
+
+  AssemblySnapshot_close(snap);
+
+  // A different key (another database, or a new version of this one) is stale
+  ok(6, AssemblySnapshot_open(fileName, AssemblySnapshot_makeKey("homo_sapiens_core_71_37\t1\t71\tGRCh37")) == NULL);
+
+  // Not a snapshot file
+  FILE *fp = fopen(fileName, "w");
+  fprintf(fp, "Not a snapshot\n");
+  fclose(fp);
+  ok(7, AssemblySnapshot_open(fileName, key) == NULL);
+
+  // Right size, but indexes pointing outside the arrays
+  regions[2].nameOffset = sizeof(names);
+  AssemblySnapshot_write(fileName, key, regions, 5, sections, 2, rows, 4, names, sizeof(names));
+  ok(8, AssemblySnapshot_open(fileName, key) == NULL);
+  regions[2].nameOffset = 10;
+
+  sections[1].nRow = 2;
+  AssemblySnapshot_write(fileName, key, regions, 5, sections, 2, rows, 4, names, sizeof(names));
+  ok(9, AssemblySnapshot_open(fileName, key) == NULL);
+  sections[1].nRow = 1;
+
+  rows[3].cmpRegion = 5;
+  AssemblySnapshot_write(fileName, key, regions, 5, sections, 2, rows, 4, names, sizeof(names));
+  ok(10, AssemblySnapshot_open(fileName, key) == NULL);
+  rows[3].cmpRegion = -1;
+  AssemblySnapshot_write(fileName, key, regions, 5, sections, 2, rows, 4, names, sizeof(names));
+  ok(11, AssemblySnapshot_open(fileName, key) == NULL);
+  rows[3].cmpRegion = 4;
+
+  // Counts which would overflow the length sum
+  AssemblySnapshot_write(fileName, key, regions, 5, sections, 2, rows, 4, names, sizeof(names));
+  int fd = open(fileName, O_WRONLY);
+  int64_t hugeCount = INT64_MAX / sizeof(AssemblySnapshotRow) + 1;
+  pwrite(fd, &hugeCount, sizeof(int64_t), offsetof(AssemblySnapshotHeader, nRow));
+  close(fd);
+  ok(12, AssemblySnapshot_open(fileName, key) == NULL);
+
+  // Still fine once put right
+  AssemblySnapshot_write(fileName, key, regions, 5, sections, 2, rows, 4, names, sizeof(names));
+  snap = AssemblySnapshot_open(fileName, key);
+  ok(13, snap != NULL);
+  AssemblySnapshot_close(snap);
+
+  unlink(fileName);
+
+  return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+  Exercises bamcount_exon functions which don't need a database or BAM file.
+  bamcount_exon.c is compiled into this test with BAMCOUNTEXON_NO_DRIVER.
+*/
+
+#include "sam.h"
+
+#include "BaseTest.h"
+
+int Bam_cigarToBlocks(bam1_t *b, long **startsP, long **endsP, int *nAllocP);
+
+int main(int argc, char *argv[]) {
+  bam1_t *b = bam_init1();
+  long *starts = NULL;
+  long *ends = NULL;
+  int nAlloc = 0;
+  int nBlock;
+
+  // 10M2D5M3N4M at (0 based) position 99, with no read name so the cigar is at the start of data
+  uint32_t cigar[5] = { 10 << 4 | BAM_CMATCH, 2 << 4 | BAM_CDEL, 5 << 4 | BAM_CMATCH,
+                         3 << 4 | BAM_CREF_SKIP, 4 << 4 | BAM_CMATCH };
+  b->core.pos     = 99;
+  b->core.l_qname = 0;
+  b->core.n_cigar = 5;
+  b->data         = (uint8_t *)cigar;
+
+  nBlock = Bam_cigarToBlocks(b, &starts, &ends, &nAlloc);
+
+  ok(1, nBlock == 3);
+  ok(2, starts[0] == 100 && ends[0] == 110);
+  // Blocks after the deletion and the intron are shifted along the reference by them
+  ok(3, starts[1] == 112 && ends[1] == 117);
+  ok(4, starts[2] == 120 && ends[2] == 124);
+
+  // Insertions and clips don't use up reference
+  uint32_t cigar2[4] = { 3 << 4 | BAM_CSOFT_CLIP, 5 << 4 | BAM_CMATCH, 2 << 4 | BAM_CINS, 5 << 4 | BAM_CMATCH };
+  b->data         = (uint8_t *)cigar2;
+  b->core.n_cigar = 4;
+
+  nBlock = Bam_cigarToBlocks(b, &starts, &ends, &nAlloc);
+  ok(5, nBlock == 2 && starts[0] == 100 && ends[0] == 105 && starts[1] == 105 && ends[1] == 110);
+
+  b->data = NULL;
+  bam_destroy1(b);
+  free(starts);
+  free(ends);
+
+  return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "DBAdaptor.h"
+#include "DBConnection.h"
+#include "BatchInsertWriter.h"
+#include "StringHash.h"
+#include "EnsC.h"
+
+#include "BaseRWDBTest.h"
+
+#define NTESTROW 5
+
+static void setTestDbID(void *obj, IDType dbID) {
+  *((IDType *)obj) = dbID;
+}
+
+/*
+  Writes NTESTROW exon rows with two FROM_UNIXTIME columns through the one row
+  per statement path used when the server can't guarantee consecutive ids.
+  Returns 1 if every row got a distinct non zero id.
+*/
+static int writeRowsSingly(DBAdaptor *dba, BatchInsertMode mode, IDType *ids) {
+  char *columns[] = { "seq_region_id", "seq_region_start", "seq_region_end", "seq_region_strand",
+                      "phase", "end_phase", "is_current", "is_constitutive",
+                      "stable_id", "version", "created_date", "modified_date", NULL };
+  char stableId[64];
+  int i;
+  int j;
+
+  // Pretend the server can't give any multi-row statement consecutive ids, so flush writes rows one at a time
+  if (dba->dbc->autoIncInfoCache == NULL) {
+    dba->dbc->autoIncInfoCache = StringHash_new(STRINGHASH_SMALL);
+  }
+  if (!StringHash_contains(dba->dbc->autoIncInfoCache, "exon")) {
+    StringHash_add(dba->dbc->autoIncInfoCache, "exon", long_new(0));
+  }
+
+  BatchInsertWriter *biw = BatchInsertWriter_new(dba, "exon", columns, NTESTROW);
+  BatchInsertWriter_setMode(biw, mode);
+  BatchInsertWriter_setUnixTimeColumn(biw, 10);
+  BatchInsertWriter_setUnixTimeColumn(biw, 11);
+
+  for (i=0; i<NTESTROW; i++) {
+    ids[i] = 0;
+    sprintf(stableId, "BIWTEST%d_%d", mode, i);
+
+    BatchInsertWriter_startRow(biw);
+    BatchInsertWriter_addLongLong(biw, 1);
+    BatchInsertWriter_addLong(biw, 1000 + i*100);
+    BatchInsertWriter_addLong(biw, 1050 + i*100);
+    BatchInsertWriter_addInt(biw, 1);
+    BatchInsertWriter_addInt(biw, -1);
+    BatchInsertWriter_addInt(biw, -1);
+    BatchInsertWriter_addInt(biw, 1);
+    BatchInsertWriter_addInt(biw, 0);
+    BatchInsertWriter_addString(biw, stableId);
+    BatchInsertWriter_addInt(biw, 1);
+    BatchInsertWriter_addLong(biw, 1400000000);
+    BatchInsertWriter_addLong(biw, 1400000000 + i);
+    BatchInsertWriter_endRow(biw, &(ids[i]), setTestDbID);
+  }
+  // Batch size is NTESTROW so the last endRow flushed
+  int written = (biw->nWritten == NTESTROW);
+  BatchInsertWriter_free(biw);
+
+  for (i=0; i<NTESTROW && written; i++) {
+    if (ids[i] == 0) {
+      return 0;
+    }
+    for (j=0; j<i; j++) {
+      if (ids[j] == ids[i]) {
+        return 0;
+      }
+    }
+  }
+  return written;
+}
+
+static void deleteRows(DBAdaptor *dba, IDType *ids) {
+  char qStr[256];
+  int i;
+
+  for (i=0; i<NTESTROW; i++) {
+    if (ids[i]) {
+      sprintf(qStr, "DELETE FROM exon WHERE exon_id = "IDFMTSTR, ids[i]);
+      DBConnection_do(dba->dbc, qStr, strlen(qStr), NULL);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  DBAdaptor *dba;
+  IDType ids[NTESTROW];
+
+  initEnsC(argc, argv);
+
+  dba = Test_initRWEnsDB();
+
+  ok(1, dba!=NULL);
+
+  ok(2, writeRowsSingly(dba, BATCHINSERT_VALUES, ids));
+  deleteRows(dba, ids);
+
+  ok(3, writeRowsSingly(dba, BATCHINSERT_LOADDATA, ids));
+  deleteRows(dba, ids);
+
+  return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MysqlBinaryResultRow.h"
+
+#include "BaseTest.h"
+
+// Fills the bound buffers by hand as mysql_stmt_fetch would, so no database is needed
+int main(int argc, char *argv[]) {
+  MYSQL_FIELD fields[5];
+  MYSQL_BIND binds[5];
+  ResultRow *row;
+  MysqlBinaryResultRow *b_row;
+  unsigned long len;
+
+  memset(fields, 0, sizeof(fields));
+  fields[0].type  = MYSQL_TYPE_LONG;
+  fields[0].flags = UNSIGNED_FLAG;
+  fields[1].type  = MYSQL_TYPE_FLOAT;
+  fields[2].type  = MYSQL_TYPE_DOUBLE;
+  fields[3].type  = MYSQL_TYPE_VAR_STRING;
+  fields[4].type  = MYSQL_TYPE_LONGLONG;
+
+  b_row = MysqlBinaryResultRow_new(fields, 5, binds);
+  row = (ResultRow *)b_row;
+
+  ok(1, b_row != NULL);
+  ok(2, binds[0].buffer_type == MYSQL_TYPE_LONGLONG && binds[3].buffer_type == MYSQL_TYPE_STRING);
+
+  *((long long *)binds[0].buffer) = 123456789012LL;
+  *((float *)binds[1].buffer)     = 0.3f;
+  *((double *)binds[2].buffer)    = 1e-30;
+  strcpy(binds[3].buffer, "chromosome");
+  *(binds[3].length)              = strlen("chromosome");
+  *(binds[4].is_null)             = 1;
+  MysqlBinaryResultRow_startRow(b_row);
+
+  ok(3, row->getLongLongAt(row, 0) == 123456789012LL);
+  ok(4, row->getDoubleAt(row, 1) == 0.3);
+  ok(5, !strcmp(row->getStringAt(row, 1), "0.3"));
+  ok(6, row->getDoubleAt(row, 2) == 1e-30 && !strcmp(row->getStringAt(row, 2), "1e-30"));
+
+  char *view = row->getStringViewAt(row, 3, &len);
+  ok(7, view == binds[3].buffer && len == 10 && !strcmp(view, "chromosome"));
+
+  ok(8, row->isNullAt(row, 4) && row->col(row, 4) == NULL && row->getLongLongAt(row, 4) == 0);
+  ok(9, !strcmp(row->getStringAt(row, 4), "") && row->getStringAllowNullAt(row, 4) == NULL);
+
+  char *copy = row->getStringCopyAt(row, 3);
+  ok(10, copy != view && !strcmp(copy, "chromosome"));
+  free(copy);
+
+  // Next row - formatted numbers must be refreshed
+  *((long long *)binds[0].buffer) = 42;
+  MysqlBinaryResultRow_startRow(b_row);
+  ok(11, !strcmp(row->getStringAt(row, 0), "42") && row->getIntAt(row, 0) == 42);
+
+  MysqlBinaryResultRow_free(b_row);
+
+  return 0;
+}
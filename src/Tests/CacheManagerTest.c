@@ -0,0 +1,109 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CacheManager.h"
+#include "LRUCache.h"
+#include "FeatureCache.h"
+#include "Vector.h"
+
+#include "BaseTest.h"
+
+#include <limits.h>
+
+int main(int argc, char *argv[]) {
+  FeatureCacheKey key;
+  char keyStr[256];
+  int i;
+
+  CacheManager *cm = CacheManager_new(1000);
+  ok(1, cm != NULL && CacheManager_getSize(cm) == 0);
+
+  // Two caches with no limits of their own, sharing cm's budget. Sequence is
+  // cheap to refetch and features expensive
+  LRUCache *seqCache = LRUCache_new(INT_MAX);
+  LRUCache_setManager(seqCache, cm, "seq", 1.0, NULL);
+  FeatureCache *featCache = FeatureCache_new(1000000);
+  FeatureCache_setManager(featCache, cm, "features", 1000.0);
+
+  ok(2, CacheManager_getNumClient(cm) == 2);
+
+  for (i=0; i<4; i++) {
+    FeatureCacheKey_init(&key, 1, i*100, i*100+99, 1, NULL);
+    FeatureCache_put(featCache, &key, NULL, NULL, 100);
+  }
+  for (i=0; i<6; i++) {
+    sprintf(keyStr, "seq%d", i);
+    LRUCache_put(seqCache, keyStr, NULL, NULL, 100);
+  }
+  ok(3, CacheManager_getSize(cm) == 1000 && seqCache->curSize == 600 && featCache->curSize == 400);
+
+  // Over budget - the cheap sequence goes before the features, even though
+  // the features are older
+  LRUCache_put(seqCache, "seq6", NULL, NULL, 200);
+  ok(4, CacheManager_getSize(cm) <= 1000 && featCache->curSize == 400 &&
+        !LRUCache_contains(seqCache, "seq0") && !LRUCache_contains(seqCache, "seq1") &&
+        LRUCache_contains(seqCache, "seq6"));
+
+  // Uncounted caches count towards the total but nothing is evicted from them
+  CacheManagerClient *fixed = CacheManager_register(cm, "fixed", NULL, 0.0, NULL, NULL);
+  CacheManagerClient_addSize(fixed, 500);
+  ok(5, CacheManager_getSize(cm) <= 1000 && CacheManagerClient_getSize(fixed) == 500);
+
+  // Each cache always keeps its most recently used entry, however tight the budget
+  CacheManager_setMaxSize(cm, 0);
+  ok(6, seqCache->head != NULL && seqCache->head == seqCache->tail &&
+        FeatureCache_getNumElement(featCache) == 1 &&
+        CacheManager_getSize(cm) == 500 + seqCache->curSize + featCache->curSize);
+
+  // Removing from the caches reduces the total
+  LRUCache_empty(seqCache);
+  FeatureCache_empty(featCache);
+  ok(7, CacheManager_getSize(cm) == 500);
+
+  // Stats are counted per cache
+  CacheManager_setMaxSize(cm, 1000000);
+  FeatureCacheKey_init(&key, 2, 1, 100, 1, NULL);
+  FeatureCache_get(featCache, &key);
+  FeatureCache_put(featCache, &key, NULL, NULL, 100);
+  FeatureCache_get(featCache, &key);
+  ok(8, featCache->client->nHit == 1 && featCache->client->nMiss == 1);
+
+  CacheManager_printStats(cm, stderr);
+
+  // Freeing a feature cache takes it out of the manager
+  FeatureCache_free(featCache);
+  ok(9, CacheManager_getNumClient(cm) == 2 && CacheManager_getSize(cm) == 500);
+
+  // A caller holding a reference to a cached vector keeps it through eviction
+  featCache = FeatureCache_new(1000000);
+  FeatureCache_setManager(featCache, cm, "features", 1000.0);
+  Vector *held = Vector_new();
+  Vector_addElement(held, "feature");
+  FeatureCacheKey_init(&key, 3, 1, 100, 1, NULL);
+  FeatureCache_put(featCache, &key, held, (FeatureCache_FreeFunc)Object_freeImpl, 100);
+  Object_incRefCount(held);
+  FeatureCacheKey_init(&key, 3, 101, 200, 1, NULL);
+  FeatureCache_put(featCache, &key, Vector_new(), (FeatureCache_FreeFunc)Object_freeImpl, 100);
+  CacheManager_setMaxSize(cm, 0);
+  ok(10, FeatureCache_getNumElement(featCache) == 1 && Object_getRefCount(held) == 1 &&
+         Vector_getNumElement(held) == 1 && !strcmp(Vector_getElementAt(held, 0), "feature"));
+  Vector_free(held);
+  FeatureCache_free(featCache);
+
+  CacheManager_free(cm);
+
+  return 0;
+}
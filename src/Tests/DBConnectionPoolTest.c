@@ -0,0 +1,90 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "DBAdaptor.h"
+#include "DBConnectionPool.h"
+#include "SliceAdaptor.h"
+#include "EnsC.h"
+
+#include "BaseTest.h"
+
+#define NTHREAD 4
+
+typedef struct PoolTestArgStruct {
+  DBConnectionPool *pool;
+  char *chrName;
+  DBAdaptor *dba;
+  long sliceLen;
+} PoolTestArg;
+
+void *fetchSlice(void *data) {
+  PoolTestArg *arg = data;
+  DBAdaptor *dba = DBConnectionPool_getDBAdaptor(arg->pool);
+  SliceAdaptor *sa = DBAdaptor_getSliceAdaptor(dba);
+  Slice *slice = SliceAdaptor_fetchByRegion(sa, "chromosome", arg->chrName, 1000000, 2000000, 1, NULL, 0);
+
+  arg->dba = dba;
+  arg->sliceLen = slice ? Slice_getLength(slice) : 0;
+
+  DBConnectionPool_releaseConnection(arg->pool);
+
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  DBAdaptor *dba;
+  DBConnectionPool *pool;
+  PoolTestArg args[NTHREAD];
+  pthread_t threads[NTHREAD];
+  char *chrNames[NTHREAD] = { "1", "2", "3", "X" };
+  int i;
+
+  initEnsC(argc, argv);
+
+  dba = DBAdaptor_new("ensembldb.ensembl.org","anonymous",NULL,"homo_sapiens_core_70_37",3306,NULL);
+
+  pool = DBConnectionPool_new(dba, 2);
+
+  ok(1, pool != NULL);
+
+  for (i=0; i<NTHREAD; i++) {
+    args[i].pool    = pool;
+    args[i].chrName = chrNames[i];
+    pthread_create(&threads[i], NULL, fetchSlice, &args[i]);
+  }
+
+  int allOk = 1;
+  int allClones = 1;
+  for (i=0; i<NTHREAD; i++) {
+    pthread_join(threads[i], NULL);
+    if (args[i].sliceLen != 1000001) allOk = 0;
+    if (args[i].dba == dba || args[i].dba->dbc == dba->dbc) allClones = 0;
+  }
+
+  ok(2, allOk);
+  ok(3, allClones);
+  // Released connections are reused rather than opening more than asked for
+  ok(4, DBConnectionPool_getNumConnection(pool) <= 2);
+  // Each clone has its own seq region lookup table
+  ok(5, DBAdaptor_getSeqRegionIdCache(args[0].dba) != DBAdaptor_getSeqRegionIdCache(dba));
+
+  DBConnectionPool_free(pool);
+
+  return 0;
+}
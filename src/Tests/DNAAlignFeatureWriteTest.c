@@ -61,5 +61,16 @@ int main(int argc, char *argv[]) {
 
   DNAAlignFeatureAdaptor_store(dafa, features);
 
+  // Batched store should have set a distinct dbID on every feature
+  failed = 0;
+  for (i=1; i<Vector_getNumElement(features) && !failed; i++) {
+    DNAAlignFeature *prev = Vector_getElementAt(features, i-1);
+    DNAAlignFeature *daf  = Vector_getElementAt(features, i);
+    if (DNAAlignFeature_getDbID(daf) == 0 || DNAAlignFeature_getDbID(daf) == DNAAlignFeature_getDbID(prev)) {
+      failed = 1;
+    }
+  }
+  ok(5, !failed);
+
   return 0;
 }
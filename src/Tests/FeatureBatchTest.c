@@ -0,0 +1,135 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FeatureBatch.h"
+#include "DNAAlignFeatureAdaptor.h"
+#include "DNAAlignFeature.h"
+#include "IDHash.h"
+#include "ProjectionSegment.h"
+
+#include "BaseRODBTest.h"
+
+#include <string.h>
+
+int batchMatchesFeatures(FeatureBatch *batch, Vector *features);
+static int hitNameIs(const char *a, const char *b);
+
+int main(int argc, char *argv[]) {
+  int i;
+
+  initEnsC(argc, argv);
+
+  FeatureBatch *batch = FeatureBatch_new(NULL);
+  ok(1, batch != NULL && FeatureBatch_getNumFeature(batch) == 0);
+
+  // Hit names needn't be NUL terminated (they come straight from the row buffer)
+  int ind = FeatureBatch_add(batch, 11, 1, 100, 200, -1, 55.5, 3, "readAXXXX", 5);
+  ok(2, ind == 0 && FeatureBatch_getNumFeature(batch) == 1 &&
+        FeatureBatch_getDbIDAt(batch, 0) == 11 && FeatureBatch_getSeqRegionIdAt(batch, 0) == 1 &&
+        FeatureBatch_getStartAt(batch, 0) == 100 && FeatureBatch_getEndAt(batch, 0) == 200 &&
+        FeatureBatch_getStrandAt(batch, 0) == -1 && FeatureBatch_getScoreAt(batch, 0) == 55.5 &&
+        FeatureBatch_getAnalysisIdAt(batch, 0) == 3);
+  ok(3, hitNameIs(FeatureBatch_getHitNameAt(batch, 0), "readA"));
+
+  FeatureBatch_add(batch, 12, 1, 150, 160, 1, 0.0, 3, NULL, 0);
+  ok(4, FeatureBatch_getHitNameAt(batch, 1) == NULL);
+
+  // Lots of features - columns and hit names grow, and earlier values are kept
+  char hitName[64];
+  for (i=2; i<100000; i++) {
+    sprintf(hitName, "read%d", i);
+    FeatureBatch_add(batch, i+10, 1, i, i+75, 1, i, 4, hitName, strlen(hitName));
+  }
+  int allRight = FeatureBatch_getNumFeature(batch) == 100000 && hitNameIs(FeatureBatch_getHitNameAt(batch, 0), "readA");
+  for (i=2; i<100000 && allRight; i++) {
+    sprintf(hitName, "read%d", i);
+    allRight = FeatureBatch_getStartAt(batch, i) == i && FeatureBatch_getEndAt(batch, i) == i+75 &&
+               FeatureBatch_getDbIDAt(batch, i) == i+10 && hitNameIs(FeatureBatch_getHitNameAt(batch, i), hitName);
+  }
+  ok(5, allRight);
+
+  // Coverage straight off the columns
+  long covered = 0;
+  for (i=0; i<FeatureBatch_getNumFeature(batch); i++) {
+    covered += FeatureBatch_getEndAt(batch, i) - FeatureBatch_getStartAt(batch, i) + 1;
+  }
+  ok(6, covered == 101 + 11 + 99998L * 76);
+
+  FeatureBatch_free(batch);
+
+  // Reserving up front means no growing
+  batch = FeatureBatch_new(NULL);
+  FeatureBatch_reserve(batch, 1000);
+  IDType *dbIds = batch->dbIds;
+  for (i=0; i<1000; i++) {
+    FeatureBatch_add(batch, i, 1, i, i, 1, 0.0, 1, NULL, 0);
+  }
+  ok(7, batch->dbIds == dbIds && batch->nAlloced == 1000);
+  FeatureBatch_free(batch);
+
+  // Batch fetches get the same features as the object fetch, both when the
+  // rows go straight into the batch (chromosome slice) and when the features
+  // have to be mapped (contig slice)
+  DBAdaptor *dba = Test_initROEnsDB();
+  SliceAdaptor *sa = DBAdaptor_getSliceAdaptor(dba);
+  BaseFeatureAdaptor *dafa = (BaseFeatureAdaptor *)DBAdaptor_getDNAAlignFeatureAdaptor(dba);
+
+  Slice *slice = SliceAdaptor_fetchByRegion(sa, "chromosome", "20", 1000000, 2000000, 1, NULL, 0);
+  batch = BaseFeatureAdaptor_fetchBatchBySlice(dafa, slice, NULL, NULL);
+  Vector *features = BaseFeatureAdaptor_fetchAllBySliceConstraint(dafa, slice, "", NULL);
+  ok(8, FeatureBatch_getNumFeature(batch) > 0 && batchMatchesFeatures(batch, features));
+  FeatureBatch_free(batch);
+  Vector_free(features);
+
+  Vector *projection = Slice_project(slice, "contig", NULL);
+  Slice *ctgSlice = ProjectionSegment_getToSlice((ProjectionSegment *)Vector_getElementAt(projection, 0));
+  batch = BaseFeatureAdaptor_fetchBatchBySlice(dafa, ctgSlice, NULL, NULL);
+  features = BaseFeatureAdaptor_fetchAllBySliceConstraint(dafa, ctgSlice, "", NULL);
+  ok(9, batchMatchesFeatures(batch, features));
+  FeatureBatch_free(batch);
+  Vector_free(features);
+
+  return 0;
+}
+
+int batchMatchesFeatures(FeatureBatch *batch, Vector *features) {
+  IDHash *featHash = IDHash_new(IDHASH_MEDIUM);
+  int matches = FeatureBatch_getNumFeature(batch) == Vector_getNumElement(features);
+  int i;
+
+  for (i=0; i<Vector_getNumElement(features); i++) {
+    SeqFeature *sf = Vector_getElementAt(features, i);
+    IDHash_add(featHash, SeqFeature_getDbID(sf), sf);
+  }
+
+  for (i=0; i<FeatureBatch_getNumFeature(batch) && matches; i++) {
+    DNAAlignFeature *daf = IDHash_getValue(featHash, FeatureBatch_getDbIDAt(batch, i));
+
+    matches = daf != NULL &&
+              FeatureBatch_getStartAt(batch, i) == DNAAlignFeature_getStart(daf) &&
+              FeatureBatch_getEndAt(batch, i) == DNAAlignFeature_getEnd(daf) &&
+              FeatureBatch_getStrandAt(batch, i) == DNAAlignFeature_getStrand(daf) &&
+              hitNameIs(FeatureBatch_getHitNameAt(batch, i), DNAAlignFeature_getHitSeqName(daf));
+  }
+  IDHash_free(featHash, NULL);
+
+  return matches;
+}
+
+// Hit names can be NULL, which only matches another NULL
+static int hitNameIs(const char *a, const char *b) {
+  return a ? (b && !strcmp(a, b)) : b == NULL;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FeatureCache.h"
+
+#include "BaseTest.h"
+
+int nFreed = 0;
+
+void countFree(void *val) {
+  nFreed++;
+}
+
+int main(int argc, char *argv[]) {
+  FeatureCacheKey key;
+  FeatureCacheKey key2;
+  char constraint[256];
+  int i;
+
+  FeatureCache *cache = FeatureCache_new(1000);
+  ok(1, cache!=NULL);
+
+  FeatureCacheKey_init(&key, 1, 100, 200, 1, "a.analysis_id = 3");
+  ok(2, FeatureCache_get(cache, &key) == NULL && FeatureCache_getNumMiss(cache) == 1);
+
+  FeatureCache_put(cache, &key, "first", countFree, 400);
+
+  // Same fields in a different buffer - constraint is compared by value
+  strcpy(constraint, "a.analysis_id = 3");
+  FeatureCacheKey_init(&key2, 1, 100, 200, 1, constraint);
+  ok(3, FeatureCache_get(cache, &key2) != NULL && !strcmp(FeatureCache_get(cache, &key2), "first"));
+
+  // Any field differing is a different key
+  FeatureCacheKey_init(&key2, 1, 100, 200, -1, constraint);
+  ok(4, FeatureCache_get(cache, &key2) == NULL);
+  FeatureCacheKey_init(&key2, 1, 100, 200, 1, "a.analysis_id = 4");
+  ok(5, FeatureCache_get(cache, &key2) == NULL);
+
+  // Sizes add up - third one doesn't fit so least recently used (second) goes
+  FeatureCacheKey_init(&key2, 2, 100, 200, 1, NULL);
+  FeatureCache_put(cache, &key2, "second", countFree, 400);
+  FeatureCache_get(cache, &key);
+  FeatureCacheKey_init(&key2, 3, 100, 200, 1, NULL);
+  FeatureCache_put(cache, &key2, "third", countFree, 400);
+
+  ok(6, FeatureCache_getNumElement(cache) == 2 && FeatureCache_getSize(cache) == 800 &&
+        FeatureCache_getNumEviction(cache) == 1 && nFreed == 1);
+  ok(7, FeatureCache_get(cache, &key) != NULL);
+  FeatureCacheKey_init(&key2, 2, 100, 200, 1, NULL);
+  ok(8, FeatureCache_get(cache, &key2) == NULL);
+
+  // Something bigger than the whole cache replaces everything but is still kept
+  FeatureCache_put(cache, &key2, "huge", countFree, 5000);
+  ok(9, FeatureCache_getNumElement(cache) == 1 && FeatureCache_get(cache, &key2) != NULL && nFreed == 3);
+
+  // Many entries - table grows and everything is still found
+  FeatureCache_free(cache);
+  cache = FeatureCache_new(1000000);
+  for (i=0; i<1000; i++) {
+    sprintf(constraint, "f.seq_region_start > %d", i);
+    FeatureCacheKey_init(&key, i % 7, i, i+100, 1, constraint);
+    FeatureCache_put(cache, &key, NULL, NULL, 10);
+  }
+  int allFound = 1;
+  for (i=0; i<1000; i++) {
+    sprintf(constraint, "f.seq_region_start > %d", i);
+    FeatureCacheKey_init(&key, i % 7, i, i+100, 1, constraint);
+    FeatureCache_get(cache, &key);
+  }
+  allFound = FeatureCache_getNumHit(cache) == 1000 && FeatureCache_getNumElement(cache) == 1000;
+  ok(10, allFound);
+
+  FeatureCache_empty(cache);
+  ok(11, FeatureCache_getNumElement(cache) == 0 && FeatureCache_getSize(cache) == 0);
+  FeatureCache_free(cache);
+
+  return 0;
+}
@@ -18,6 +18,8 @@
 
 #include "SliceAdaptor.h"
 #include "DBAdaptor.h"
+#include "DBEntryAdaptor.h"
+#include "AttributeAdaptor.h"
 #include "EnsC.h"
 #include "Gene.h"
 #include "Attribute.h"
@@ -69,6 +71,49 @@ int main(int argc, char *argv[]) {
   failed = dumpGenes(genes, 1);
   ok(5, !failed);
 
+  // Xrefs for all the genes in one go are the same as fetching them gene by gene
+  DBEntryAdaptor *dbea = DBAdaptor_getDBEntryAdaptor(dba);
+  DBEntryAdaptor_fetchAllByGeneList(dbea, genes);
+
+  int sameXrefs = 1;
+  for (i=0; i<Vector_getNumElement(genes) && sameXrefs; i++) {
+    Gene *g = Vector_getElementAt(genes, i);
+    Vector *batchLinks = g->dbLinks;
+
+    g->dbLinks = NULL;
+    DBEntryAdaptor_fetchAllByGene(dbea, g);
+
+    sameXrefs = batchLinks != NULL &&
+                Vector_getNumElement(batchLinks) == (g->dbLinks ? Vector_getNumElement(g->dbLinks) : 0);
+    Vector_free(batchLinks);
+  }
+  ok(6, sameXrefs);
+
+  // Same for transcript attributes
+  AttributeAdaptor *ata = DBAdaptor_getAttributeAdaptor(dba);
+  Vector *transcripts = Vector_new();
+  for (i=0; i<Vector_getNumElement(genes); i++) {
+    Gene *g = Vector_getElementAt(genes, i);
+    int j;
+    for (j=0; j<Gene_getTranscriptCount(g); j++) {
+      Vector_addElement(transcripts, Gene_getTranscriptAt(g, j));
+    }
+  }
+  AttributeAdaptor_prefetchForTranscripts(ata, transcripts);
+
+  int sameAttribs = 1;
+  for (i=0; i<Vector_getNumElement(transcripts) && sameAttribs; i++) {
+    Transcript *t = Vector_getElementAt(transcripts, i);
+    Vector *attribs = AttributeAdaptor_fetchAllByTranscript(ata, t, NULL);
+
+    sameAttribs = t->attributes != NULL && Vector_getNumElement(t->attributes) == Vector_getNumElement(attribs);
+
+    Vector_setFreeFunc(attribs, Attribute_free);
+    Vector_free(attribs);
+  }
+  Vector_free(transcripts);
+  ok(7, sameAttribs);
+
   //Vector *toplevelSlices = SliceAdaptor_fetchAll(sa, "toplevel", NULL, 0);
   Vector *toplevelSlices = SliceAdaptor_fetchAll(sa, "chromosome", NULL, 0);
 
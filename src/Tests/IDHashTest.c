@@ -0,0 +1,89 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "IDHash.h"
+
+#include "BaseTest.h"
+
+#define NID 100000
+
+int main(int argc, char *argv[]) {
+  IDType id;
+  long i;
+
+  IDHash *hash = IDHash_new(IDHASH_SMALL);
+  ok(1, hash != NULL && IDHash_getNumValues(hash) == 0 && !IDHash_contains(hash, 1));
+
+  // Consecutive ids and ones a table size apart, which all hashed to the
+  // same bucket with the old modulo hash
+  for (i=0; i<NID; i++) {
+    id = (i % 2) ? i : i * 32353;
+    IDHash_add(hash, id, (void *)(i+1));
+  }
+  ok(2, IDHash_getNumValues(hash) == NID);
+
+  int allFound = 1;
+  for (i=0; i<NID; i++) {
+    id = (i % 2) ? i : i * 32353;
+    if (IDHash_getValue(hash, id) != (void *)(i+1)) {
+      allFound = 0;
+    }
+  }
+  ok(3, allFound && !IDHash_contains(hash, 2) && IDHash_getValue(hash, -1) == NULL);
+
+  for (i=0; i<NID; i+=4) {
+    id = (i % 2) ? i : i * 32353;
+    IDHash_remove(hash, id, NULL);
+  }
+  int rightOnesLeft = 1;
+  for (i=0; i<NID; i++) {
+    id = (i % 2) ? i : i * 32353;
+    if (IDHash_contains(hash, id) != (i % 4 != 0)) {
+      rightOnesLeft = 0;
+    }
+  }
+  IDHash_remove(hash, -1, NULL);
+  ok(4, rightOnesLeft && IDHash_getNumValues(hash) == NID - NID/4);
+
+  int iter = 0;
+  int nSeen = 0;
+  while (IDHash_next(hash, &iter, &id, NULL)) {
+    if (IDHash_contains(hash, id)) {
+      nSeen++;
+    }
+  }
+  IDType *keys = IDHash_getKeys(hash);
+  ok(5, nSeen == IDHash_getNumValues(hash) && keys != NULL);
+  free(keys);
+
+  IDHash *copy = IDHash_copy(hash);
+  IDHash_remove(copy, 1, NULL);
+  ok(6, IDHash_contains(hash, 1) && !IDHash_contains(copy, 1));
+
+  IDHash *reserved = IDHash_new(IDHASH_SMALL);
+  IDHash_reserve(reserved, 5000);
+  int reservedSize = reserved->size;
+  for (i=0; i<5000; i++) {
+    IDHash_add(reserved, i, NULL);
+  }
+  ok(7, reserved->size == reservedSize && IDHash_getNumValues(reserved) == 5000);
+
+  IDHash_free(hash, NULL);
+  IDHash_free(copy, NULL);
+  IDHash_free(reserved, NULL);
+
+  return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "IntervalIndex.h"
+
+#include "BaseTest.h"
+
+#define NINTERVAL 1000
+#define NQUERY 2000
+
+// Checks the index search against a brute force scan for random queries
+int checkAgainstScan(IntervalIndex *ii, int nQuery, long maxPos) {
+  int *inds = NULL;
+  int nIndAlloc = 0;
+  int allMatch = 1;
+  int q;
+
+  for (q=0; q<nQuery; q++) {
+    long start = random() % maxPos;
+    long end = start + random() % 500;
+    int nFound = IntervalIndex_findOverlaps(ii, start, end, &inds, &nIndAlloc);
+    int nExpected = 0;
+    int i;
+
+    for (i=0; i<IntervalIndex_getNumInterval(ii); i++) {
+      Interval *iv = IntervalIndex_getIntervalAt(ii, i);
+      if (iv->start <= end && iv->end >= start) {
+        // Results come back in array order so the nth expected should be the nth found
+        if (nExpected >= nFound || inds[nExpected] != i) {
+          allMatch = 0;
+        }
+        nExpected++;
+      }
+    }
+    if (nExpected != nFound) {
+      allMatch = 0;
+    }
+  }
+  free(inds);
+
+  return allMatch;
+}
+
+int main(int argc, char *argv[]) {
+  int *inds = NULL;
+  int nIndAlloc = 0;
+  int nFound;
+  int i;
+
+  IntervalIndex *ii = IntervalIndex_new();
+
+  IntervalIndex_build(ii);
+  ok(1, IntervalIndex_findOverlaps(ii, 1, 100, &inds, &nIndAlloc) == 0);
+  IntervalIndex_free(ii);
+
+  ii = IntervalIndex_new();
+  IntervalIndex_add(ii, 300, 400, "c");
+  IntervalIndex_add(ii, 100, 200, "a");
+  IntervalIndex_add(ii, 150, 1000, "b");
+  IntervalIndex_build(ii);
+
+  ok(2, !strcmp(IntervalIndex_getIntervalAt(ii, 0)->data, "a") &&
+        !strcmp(IntervalIndex_getIntervalAt(ii, 2)->data, "c"));
+
+  // Closed intervals - touching at one base counts as overlapping
+  nFound = IntervalIndex_findOverlaps(ii, 200, 299, &inds, &nIndAlloc);
+  ok(3, nFound == 2 && inds[0] == 0 && inds[1] == 1);
+
+  nFound = IntervalIndex_findOverlaps(ii, 1001, 2000, &inds, &nIndAlloc);
+  ok(4, nFound == 0);
+  IntervalIndex_free(ii);
+
+  // Exon like intervals with a few long ones mixed in, at sizes which aren't 2^n-1
+  srandom(12345);
+  int allMatch = 1;
+  int sizes[] = { 1, 2, 7, 8, 9, 100, NINTERVAL };
+  int s;
+  for (s=0; s<sizeof(sizes)/sizeof(int); s++) {
+    ii = IntervalIndex_new();
+    for (i=0; i<sizes[s]; i++) {
+      long start = random() % 100000;
+      long len = (i % 50) ? random() % 300 : random() % 20000;
+      IntervalIndex_add(ii, start, start + len, NULL);
+    }
+    IntervalIndex_build(ii);
+    if (!checkAgainstScan(ii, NQUERY, 100000)) {
+      allMatch = 0;
+    }
+    IntervalIndex_free(ii);
+  }
+  ok(5, allMatch);
+
+  free(inds);
+
+  return 0;
+}
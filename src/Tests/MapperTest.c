@@ -198,6 +198,73 @@ int main(int argc, char *argv[]) {
     int testOutput[][4] = {{1, 100, 200, 0}};
     testTransform(mapper, 1, 100, 200, 1, "asm1", testOutput, NumOutput(testOutput));
   }
+
+  //
+  // results into a caller supplied buffer
+  //
+
+  mapper = Mapper_new( "rawcontig", "virtualcontig", NULL, NULL );
+  loadSGPDump(mapper, 0 );
+
+  MapperResult results[32];
+  int nResult = Mapper_mapCoordinatesInto(mapper, 1, 383700, 444000, +1, "virtualcontig", results, 32);
+  ok(2, nResult == 3 &&
+        results[0].rangeType == MAPPERRANGE_COORD && results[0].id == 314696 && results[0].start == 31917 && results[0].end == 31937 && results[0].strand == -1 &&
+        results[1].id == 341 && results[1].start == 126 && results[1].end == 59773 &&
+        results[2].id == 315843 && results[2].start == 5332 && results[2].end == 5963 && results[2].strand == 1);
+
+  // Buffer too small - still says how many are needed
+  ok(3, Mapper_mapCoordinatesInto(mapper, 1, 383700, 444000, +1, "virtualcontig", results, 1) == 3 && results[0].id == 314696);
+
+  // Same as the MapperRangeSet version, including the reversal for strand -1 and gaps
+  {
+    MapperRangeSet *mrs = Mapper_mapCoordinates(mapper, 1, 273701, 444000, -1, "virtualcontig");
+    int same;
+    int i;
+
+    nResult = Mapper_mapCoordinatesInto(mapper, 1, 273701, 444000, -1, "virtualcontig", results, 32);
+    same = nResult == MapperRangeSet_getNumRange(mrs);
+    for (i=0; i<nResult && same; i++) {
+      MapperRange *range = MapperRangeSet_getRangeAt(mrs, i);
+      same = range->rangeType == results[i].rangeType && range->start == results[i].start && range->end == results[i].end &&
+             (range->rangeType != MAPPERRANGE_COORD || ((MapperCoordinate *)range)->id == results[i].id);
+    }
+    ok(4, same && results[nResult-1].rangeType == MAPPERRANGE_COORD && results[nResult-1].id == 627011);
+    MapperRangeSet_free(mrs);
+  }
+
+  // fastMap into a result, forward and reverse oriented pairs
+  MapperResult result;
+  ok(5, Mapper_fastMapInto(mapper, 627012, 2, 5, 1, "rawcontig", &result) == 1 &&
+        result.id == 1 && result.start == 2 && result.end == 5 && result.strand == 1);
+  ok(6, Mapper_fastMapInto(mapper, 1, 31377, 31386, 1, "virtualcontig", &result) == 1 &&
+        result.id == 627010 && result.start == 83813 && result.end == 83822 && result.strand == -1);
+
+  // Spanning two pairs doesn't fast map, unknown ids are reported rather than fatal
+  ok(7, Mapper_fastMapInto(mapper, 1, 383700, 444000, 1, "virtualcontig", &result) == 0 && result.rangeType == MAPPERRANGE_GAP &&
+        Mapper_fastMapInto(mapper, 999, 1, 10, 1, "rawcontig", &result) == -1);
+
+  // Many at once
+  {
+    IDType ids[]  = { 1, 1, 1, 999, 1 };
+    long starts[] = { 31377, 383700, 1, 1, 443369 };
+    long ends[]   = { 31386, 444000, 31276, 10, 444727 };
+    int strands[] = { 1, 1, -1, 1, 1 };
+    int nMapped = Mapper_fastMapMany(mapper, "virtualcontig", 5, ids, starts, ends, strands, results);
+
+    ok(8, nMapped == 3 &&
+          results[0].id == 627010 && results[0].start == 83813 &&
+          results[1].rangeType == MAPPERRANGE_GAP && results[1].start == 383700 && results[1].end == 444000 &&
+          results[2].id == 627012 && results[2].start == 1 && results[2].end == 31276 && results[2].strand == -1 &&
+          results[3].rangeType == MAPPERRANGE_GAP &&
+          results[4].id == 315843 && results[4].start == 5332 && results[4].end == 6690);
+  }
+
+  // Adding pairs after mapping is picked up
+  Mapper_addMapCoordinates(mapper, 999, 1, 100, 1, 2, 1001, 1100 );
+  ok(9, Mapper_fastMapInto(mapper, 999, 1, 10, 1, "rawcontig", &result) == 1 && result.id == 2 && result.start == 1001);
+
+  Mapper_free(mapper);
   
   return 0;
 }
@@ -0,0 +1,89 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PackedSeq.h"
+
+#include "BaseTest.h"
+
+#include <unistd.h>
+
+#define SEQLEN 100003
+
+int main(int argc, char *argv[]) {
+  char fileName[FILENAME_MAX];
+  char *seq;
+  char buf[2048];
+  int i;
+
+  sprintf(fileName, "/tmp/PackedSeqTest.%d.2bit", (int)getpid());
+
+  if ((seq = (char *)calloc(SEQLEN+1, sizeof(char))) == NULL) {
+    Test_failAndDie("Failed allocating seq\n");
+  }
+
+  // Random bases with N runs, the odd IUPAC code and some soft masked stretches
+  srandom(4321);
+  for (i=0; i<SEQLEN; i++) {
+    seq[i] = "ACGT"[random() % 4];
+  }
+  memset(&seq[0], 'N', 10);
+  memset(&seq[5000], 'N', 1234);
+  seq[7000] = 'R';
+  seq[7001] = 'Y';
+  for (i=20000; i<20500; i++) seq[i] = seq[i] + ('a' - 'A');
+  for (i=SEQLEN-20; i<SEQLEN; i++) seq[i] = seq[i] + ('a' - 'A');
+  seq[20100] = 'n';
+
+  ok(1, PackedSeq_write(fileName, seq, SEQLEN) == 0);
+
+  PackedSeq *ps = PackedSeq_open(fileName);
+  ok(2, ps != NULL && PackedSeq_getLength(ps) == SEQLEN);
+
+  PackedSeq_fetch(ps, 1, 2000, buf);
+  ok(3, !memcmp(buf, seq, 2000));
+
+  // Random ranges, including ones crossing runs and byte boundaries
+  int allMatch = 1;
+  for (i=0; i<5000; i++) {
+    long start = 1 + random() % SEQLEN;
+    long length = 1 + random() % 2000;
+    if (start + length - 1 > SEQLEN) {
+      length = SEQLEN - start + 1;
+    }
+    PackedSeq_fetch(ps, start, length, buf);
+    if (memcmp(buf, &seq[start-1], length)) {
+      allMatch = 0;
+    }
+  }
+  ok(4, allMatch);
+
+  // Off the end is padded with N
+  PackedSeq_fetch(ps, SEQLEN-1, 5, buf);
+  ok(5, !memcmp(buf, &seq[SEQLEN-2], 2) && !memcmp(&buf[2], "NNN", 3));
+
+  PackedSeq_close(ps);
+
+  // Not a packed sequence file
+  FILE *fp = fopen(fileName, "w");
+  fprintf(fp, "Not packed\n");
+  fclose(fp);
+  ok(6, PackedSeq_open(fileName) == NULL);
+
+  unlink(fileName);
+  free(seq);
+
+  return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+  Exercises RefineSolexaGenes functions which don't need a database or BAM
+  files. RefineSolexaGenes.c is compiled into this test with RSG_NO_DRIVER.
+*/
+
+#include "RefineSolexaGenes.h"
+
+#include "BaseTest.h"
+
+#include <unistd.h>
+
+/* Adds nExon two block extra exons starting at start, as JunctionIndex_addExtraExons would */
+static void addUnitExtraExons(RefineSolexaGenes *rsg, long start, int nExon) {
+  StringHash *extraExons = RefineSolexaGenes_getExtraExons(rsg);
+  int i;
+
+  for (i=0; i<nExon; i++) {
+    long coords[4];
+    char keyString[1024];
+
+    coords[0] = start + i*1000;
+    coords[1] = coords[0] + 100;
+    coords[2] = coords[0] + 500;
+    coords[3] = coords[0] + 600;
+    sprintf(keyString, "%ld:%ld:%ld:%ld:", coords[0], coords[1], coords[2], coords[3]);
+
+    ExtraExonData *eed = ExtraExonData_new(coords, 4);
+    eed->score = 1;
+    StringHash_add(extraExons, keyString, eed);
+  }
+}
+
+/* Returns 1 if the cached extra exon values are the nExon exons added for the unit starting at start */
+static int checkUnitExtraExons(RefineSolexaGenes *rsg, long start, int nExon) {
+  StringHash *extraExons = RefineSolexaGenes_getExtraExons(rsg);
+  ExtraExonData **values = RefineSolexaGenes_getExtraExonsValues(rsg);
+  char **keys = RefineSolexaGenes_getExtraExonsKeys(rsg);
+  int i;
+
+  if (StringHash_getNumValues(extraExons) != nExon || values == NULL || keys == NULL) {
+    return 0;
+  }
+  for (i=0; i<nExon; i++) {
+    if (values[i]->coords[0] != start + i*1000 || StringHash_getValue(extraExons, keys[i]) == NULL) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+  Writes a junction index holding one junction and one two coord extra exon,
+  with the header counts then adjusted by the caller supplied values
+*/
+static void writeJunctionIndex(char *fileName, uint64_t key, int64_t nJunctionAdj, int64_t coordOffset) {
+  JunctionIndexHeader header;
+  Junction junction;
+  JunctionIndexExtraExon extraExon;
+  int64_t coords[2] = { 1000, 1200 };
+  FILE *fp;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, JUNCTIONINDEX_MAGIC, 8);
+  header.key              = key;
+  header.nJunction        = 1 + nJunctionAdj;
+  header.nExtraExon       = 1;
+  header.nExtraCoord      = 2;
+  header.maxJunctionSpan  = 500;
+  header.maxExtraExonSpan = 200;
+
+  memset(&junction, 0, sizeof(junction));
+  junction.prevExonEnd   = 1200;
+  junction.nextExonStart = 1700;
+  junction.strand        = 1;
+  junction.score         = 5;
+
+  memset(&extraExon, 0, sizeof(extraExon));
+  extraExon.start       = 1000;
+  extraExon.end         = 1200;
+  extraExon.coordOffset = coordOffset;
+  extraExon.nCoord      = 2;
+  extraExon.score       = 3;
+
+  fp = fopen(fileName, "w");
+  fwrite(&header, sizeof(header), 1, fp);
+  fwrite(&junction, sizeof(junction), 1, fp);
+  fwrite(&extraExon, sizeof(extraExon), 1, fp);
+  fwrite(coords, sizeof(int64_t), 2, fp);
+  fclose(fp);
+}
+
+int main(int argc, char *argv[]) {
+  initEnsC(argc, argv);
+
+  RefineSolexaGenes *rsg = RefineSolexaGenes_new(NULL, NULL);
+
+  ok(1, rsg != NULL);
+
+  // Two work units on different seq regions - the second has fewer extra exons than the first
+  addUnitExtraExons(rsg, 1000000, 5);
+  ok(2, checkUnitExtraExons(rsg, 1000000, 5));
+
+  RefineSolexaGenes_clearInput(rsg);
+  ok(3, StringHash_getNumValues(RefineSolexaGenes_getExtraExons(rsg)) == 0);
+
+  addUnitExtraExons(rsg, 2000000, 3);
+  ok(4, checkUnitExtraExons(rsg, 2000000, 3));
+
+  RefineSolexaGenes_clearInput(rsg);
+
+  // Junction index counts are checked against the file size before being used
+  char indexFile[] = "/tmp/RefineSolexaGenesTest.jidx";
+  JunctionIndex *ji;
+
+  writeJunctionIndex(indexFile, 42, 0, 0);
+  ji = JunctionIndex_open(indexFile, 42, "1");
+  ok(5, ji != NULL && ji->header->nJunction == 1 && ji->extraCoords[1] == 1200);
+  if (ji) JunctionIndex_close(ji);
+
+  // A count so big that the size sum would wrap round
+  writeJunctionIndex(indexFile, 42, (int64_t)(0x7fffffffffffffffLL / sizeof(Junction)), 0);
+  ok(6, JunctionIndex_open(indexFile, 42, "1") == NULL);
+
+  writeJunctionIndex(indexFile, 42, -2, 0);
+  ok(7, JunctionIndex_open(indexFile, 42, "1") == NULL);
+
+  // Extra exon coords past the end of the coords array
+  writeJunctionIndex(indexFile, 42, 0, 1);
+  ok(8, JunctionIndex_open(indexFile, 42, "1") == NULL);
+
+  unlink(indexFile);
+
+  return 0;
+}
@@ -20,9 +20,33 @@
 #include "DBAdaptor.h"
 #include "EnsC.h"
 #include "RepeatFeature.h"
+#include "RepeatFeatureAdaptor.h"
 
 #include "BaseRODBTest.h"
 
+int sumStarts(SeqFeature *sf, void *userData) {
+  long *sumP = userData;
+
+  *sumP += SeqFeature_getStart(sf);
+  Object_free(sf);
+  return 1;
+}
+
+int stopAtFirst(SeqFeature *sf, void *userData) {
+  Object_free(sf);
+  return 0;
+}
+
+int countInArena(SeqFeature *sf, void *userData) {
+  long *nInArenaP = userData;
+
+  if (Object_isInArena(sf)) {
+    (*nInArenaP)++;
+  }
+  Object_free(sf);
+  return 1;
+}
+
 int main(int argc, char *argv[]) {
   DBAdaptor *dba;
   RepeatFeatureAdaptor *rfa;
@@ -75,5 +99,27 @@ int main(int argc, char *argv[]) {
 */
   }
   ok(5, !failed);
+
+  // Streaming the slice gives the same features
+  long sumFetched = 0;
+  long sumIterated = 0;
+  for (i=0;i<Vector_getNumElement(features);i++) {
+    sumFetched += RepeatFeature_getStart((RepeatFeature *)Vector_getElementAt(features,i));
+  }
+  long nIterated = BaseFeatureAdaptor_iterateBySlice((BaseFeatureAdaptor *)rfa, slice, NULL, NULL, sumStarts, &sumIterated);
+  ok(6, nIterated == Vector_getNumElement(features) && sumIterated == sumFetched);
+
+  // and stops when asked to
+  ok(7, BaseFeatureAdaptor_iterateBySlice((BaseFeatureAdaptor *)rfa, slice, NULL, NULL, stopAtFirst, NULL) == 1);
+
+  // Streamed features are the callback's to free, so don't come from the DBAdaptor's arena
+  Arena *arena = Arena_new(0);
+  long nInArena = 0;
+  DBAdaptor_setArena(dba, arena);
+  BaseFeatureAdaptor_iterateBySlice((BaseFeatureAdaptor *)rfa, slice, NULL, NULL, countInArena, &nInArena);
+  DBAdaptor_setArena(dba, NULL);
+  ok(8, nInArena == 0 && Arena_getCurrent() == NULL);
+  Arena_free(arena);
+
   return 0;
 }
@@ -25,5 +25,48 @@ int main(int argc, char *argv[]) {
   initEnsC(argc, argv);
   SeqUtil_readTransTab("../data/trans0.txt",transTab);
 
+  // Case and IUPAC codes are kept
+  char seq[] = "ACGTNacgtnRYMKSWBVDHrymkswbvdh";
+  SeqUtil_reverseComplement(seq, strlen(seq));
+  ok(1, !strcmp(seq, "dhbvwsmkryDHBVWSMKRYnacgtNACGT"));
+
+  char badSeq[] = "ACGTZ";
+  ok(2, SeqUtil_reverseComplement(badSeq, strlen(badSeq)) == NULL);
+
+  // Long mixed sequences (so any block path is used), checked against a simple reverse and complement
+  char *from = "ACGTNacgtnRYMKSWBVDH";
+  char *to   = "TGCANtgcanYRKMSWVBHD";
+  int allMatch = 1;
+  int len;
+  srandom(1);
+  for (len=0; len<300; len++) {
+    char *longSeq = malloc(len+1);
+    char *expected = malloc(len+1);
+    int i;
+
+    for (i=0; i<len; i++) {
+      // Mostly ACGTN with the occasional ambiguity code
+      int ind = random() % 50 ? random() % 10 : random() % 20;
+      longSeq[i] = from[ind];
+      expected[len-1-i] = to[ind];
+    }
+    longSeq[len] = expected[len] = '\0';
+
+    if (SeqUtil_reverseComplement(longSeq, len) == NULL || strcmp(longSeq, expected)) {
+      allMatch = 0;
+    }
+    free(longSeq);
+    free(expected);
+  }
+  ok(3, allMatch);
+
+  // BAM 4 bit coded - ACGTN (1,2,4,8,15) odd and even lengths
+  uint8_t oddSeq[]  = { 0x12, 0x48, 0xF0 };   // ACGTN
+  uint8_t evenSeq[] = { 0x12, 0x48 };         // ACGT
+  SeqUtil_reverseComplementNt16(oddSeq, 5);
+  SeqUtil_reverseComplementNt16(evenSeq, 4);
+  ok(4, oddSeq[0] == 0xF1 && oddSeq[1] == 0x24 && oddSeq[2] == 0x80);
+  ok(5, evenSeq[0] == 0x12 && evenSeq[1] == 0x48);
+
   return 0;
 }
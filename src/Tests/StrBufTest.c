@@ -0,0 +1,71 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StrBuf.h"
+
+#include "BaseTest.h"
+
+#include <limits.h>
+
+int main(int argc, char *argv[]) {
+  char expected[2048];
+  IDType ids[] = { 1, 22, 333 };
+  int i;
+
+  // Deliberately tiny so appends have to grow it
+  StrBuf *sb = StrBuf_new(4);
+  ok(1, sb != NULL && StrBuf_getLength(sb) == 0 && !strcmp(StrBuf_getString(sb), ""));
+
+  StrBuf_append(sb, "SELECT gene_id FROM gene WHERE gene_id IN (");
+  StrBuf_appendIDList(sb, ids, 3);
+  StrBuf_appendChar(sb, ')');
+  ok(2, !strcmp(StrBuf_getString(sb), "SELECT gene_id FROM gene WHERE gene_id IN (1, 22, 333)") &&
+        StrBuf_getLength(sb) == strlen(StrBuf_getString(sb)));
+
+  // Integers match what printf would give, including the extremes
+  StrBuf_clear(sb);
+  StrBuf_appendLong(sb, 0);
+  StrBuf_appendChar(sb, ' ');
+  StrBuf_appendLong(sb, -42);
+  StrBuf_appendChar(sb, ' ');
+  StrBuf_appendLongLong(sb, LLONG_MAX);
+  StrBuf_appendChar(sb, ' ');
+  StrBuf_appendLongLong(sb, LLONG_MIN);
+  sprintf(expected, "0 -42 %lld %lld", LLONG_MAX, LLONG_MIN);
+  ok(3, !strcmp(StrBuf_getString(sb), expected));
+
+  // Formatted appends which don't fit in the space left
+  StrBuf_clear(sb);
+  for (i=0; i<100; i++) {
+    StrBuf_appendf(sb, "%s.seq_region_start <= %d AND ", "f", i);
+  }
+  expected[0] = '\0';
+  char *chP = expected;
+  for (i=0; i<100 && chP - expected < 1900; i++) {
+    chP += sprintf(chP, "%s.seq_region_start <= %d AND ", "f", i);
+  }
+  ok(4, !strncmp(StrBuf_getString(sb), expected, strlen(expected)));
+
+  // Taking off a trailing separator
+  StrBuf_truncate(sb, StrBuf_getLength(sb) - 5);
+  ok(5, !strcmp(&StrBuf_getString(sb)[StrBuf_getLength(sb)-5], "<= 99"));
+
+  char *str = StrBuf_detach(sb);
+  ok(6, !strncmp(str, "f.seq_region_start <= 0 AND ", 28));
+  free(str);
+
+  return 0;
+}
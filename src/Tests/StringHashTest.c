@@ -0,0 +1,99 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StringHash.h"
+
+#include "BaseTest.h"
+
+#define NKEY 50000
+
+int main(int argc, char *argv[]) {
+  char key[256];
+  long i;
+
+  StringHash *hash = StringHash_new(STRINGHASH_SMALL);
+  ok(1, hash != NULL && StringHash_getNumValues(hash) == 0 && !StringHash_contains(hash, "fred"));
+
+  // Far more than the starting size, so it has to grow several times
+  for (i=0; i<NKEY; i++) {
+    sprintf(key, "chr%ld:%ld-%ld", i % 23, i * 100, i * 100 + 99);
+    StringHash_add(hash, key, (void *)(i+1));
+  }
+  ok(2, StringHash_getNumValues(hash) == NKEY && hash->size >= NKEY);
+
+  int allFound = 1;
+  for (i=0; i<NKEY; i++) {
+    sprintf(key, "chr%ld:%ld-%ld", i % 23, i * 100, i * 100 + 99);
+    if (StringHash_getValue(hash, key) != (void *)(i+1)) {
+      allFound = 0;
+    }
+  }
+  ok(3, allFound && !StringHash_contains(hash, "chr1:0-99") && StringHash_getValue(hash, "") == NULL);
+
+  // Remove every other one - the rest must still be found
+  for (i=0; i<NKEY; i+=2) {
+    sprintf(key, "chr%ld:%ld-%ld", i % 23, i * 100, i * 100 + 99);
+    StringHash_remove(hash, key, NULL);
+  }
+  int rightOnesLeft = 1;
+  for (i=0; i<NKEY; i++) {
+    sprintf(key, "chr%ld:%ld-%ld", i % 23, i * 100, i * 100 + 99);
+    if (StringHash_contains(hash, key) != (i % 2)) {
+      rightOnesLeft = 0;
+    }
+  }
+  ok(4, rightOnesLeft && StringHash_getNumValues(hash) == NKEY/2);
+
+  // Removing something which isn't there changes nothing
+  StringHash_remove(hash, "not there", NULL);
+  ok(5, StringHash_getNumValues(hash) == NKEY/2);
+
+  // Iteration visits each entry once, without copying keys
+  int iter = 0;
+  int nSeen = 0;
+  long valSum = 0;
+  char *iterKey;
+  void *iterVal;
+  while (StringHash_next(hash, &iter, &iterKey, &iterVal)) {
+    if (StringHash_getKey(hash, iterKey) == iterKey) {
+      nSeen++;
+    }
+    valSum += (long)iterVal;
+  }
+  ok(6, nSeen == NKEY/2 && valSum == (long)(NKEY/2) * (NKEY/2 + 1));
+
+  // Copies are independent
+  StringHash *copy = StringHash_copy(hash);
+  StringHash_add(copy, "extra", NULL);
+  ok(7, StringHash_getNumValues(copy) == NKEY/2 + 1 && !StringHash_contains(hash, "extra") &&
+        StringHash_getValue(copy, "chr1:100-199") == (void *)2);
+
+  // Reserving up front means no growing while adding
+  StringHash *reserved = StringHash_new(STRINGHASH_SMALL);
+  StringHash_reserve(reserved, 1000);
+  int reservedSize = reserved->size;
+  for (i=0; i<1000; i++) {
+    sprintf(key, "%ld", i);
+    StringHash_add(reserved, key, NULL);
+  }
+  ok(8, reserved->size == reservedSize && StringHash_getNumValues(reserved) == 1000);
+
+  StringHash_free(hash, NULL);
+  StringHash_free(copy, NULL);
+  StringHash_free(reserved, NULL);
+
+  return 0;
+}
@@ -18,19 +18,134 @@
 
 #include "BaseTest.h"
 
+#include <pthread.h>
+
+#define NTRANSLATETHREAD 8
+
+typedef struct TranslateThreadArgStruct {
+  char *seq;
+  int   len;
+  int   codonTableId;
+  char *expected[6];
+  int   nMismatch;
+} TranslateThreadArg;
+
+/* Translates the same sequence repeatedly, counting results which differ
+   from the single threaded translation */
+static void *translateThread(void *arg) {
+  TranslateThreadArg *ta = arg;
+  char *frm[6];
+  int lengths[6];
+  int i;
+  int j;
+
+  for (i=0;i<6;i++) {
+    frm[i]=malloc(2000);
+  }
+  for (j=0;j<200;j++) {
+    translate(ta->seq,frm,lengths,ta->codonTableId,ta->len);
+    for (i=0;i<6;i++) {
+      if (strcmp(frm[i], ta->expected[i])) {
+        ta->nMismatch++;
+      }
+    }
+  }
+  for (i=0;i<6;i++) {
+    free(frm[i]);
+  }
+  return NULL;
+}
+
 int main(int argc, char *argv[]) {
   char *frm[6];
   int lengths[6];
+  char *seq = "ATGATGATGATG";
   int i;
 
   for (i=0;i<6;i++) {
-    frm[i]=malloc(200);
+    frm[i]=malloc(2000);
   }
 
-  translate("ATGATGATGATG",frm,lengths,1, sizeof("ATGATGATGATG"));
+  translate(seq,frm,lengths,1, strlen(seq));
   for (i=0;i<6;i++) {
     printf("frm %d = %s\n", i+1, frm[i]);
   }
 
+  ok(1, !strcmp(frm[0], "MMMM") && !strcmp(frm[1], "***") && !strcmp(frm[2], "DDD"));
+  ok(2, !strcmp(frm[3], "HHHH") && !strcmp(frm[4], "SSS") && !strcmp(frm[5], "III"));
+  ok(3, lengths[0] == 4 && lengths[1] == 3 && lengths[5] == 3);
+
+  // Vertebrate mitochondrial code reads TGA as W
+  translate_three(seq,frm,lengths,2, strlen(seq));
+  ok(4, !strcmp(frm[1], "WWW"));
+
+  // Codons with any non ACGT base (either case) are X
+  ok(5, translate_frame("ATGnnnAtgRTGAC", frm[0], 0, 1, 14) == 4 && !strcmp(frm[0], "MXMX"));
+
+  // Single frames match the six frame translation, across several encoding chunks
+  char *longSeq = malloc(5001);
+  srandom(1234);
+  for (i=0;i<5000;i++) {
+    longSeq[i] = "ACGTacgtN"[random() % 9];
+  }
+  longSeq[5000] = '\0';
+
+  char *single = malloc(2000);
+  int allMatch = 1;
+  translate(longSeq,frm,lengths,11, 5000);
+  for (i=0;i<6;i++) {
+    if (translate_frame(longSeq, single, i, 11, 5000) != lengths[i] || strcmp(single, frm[i])) {
+      allMatch = 0;
+    }
+  }
+  ok(6, allMatch);
+
+  // Threads translating with different codon tables at the same time don't affect each other
+  pthread_t threads[NTRANSLATETHREAD];
+  TranslateThreadArg threadArgs[NTRANSLATETHREAD];
+  int t;
+  for (t=0;t<NTRANSLATETHREAD;t++) {
+    threadArgs[t].seq          = longSeq;
+    threadArgs[t].len          = 5000;
+    threadArgs[t].codonTableId = (t % 2) ? 2 : 1;
+    threadArgs[t].nMismatch    = 0;
+    for (i=0;i<6;i++) {
+      threadArgs[t].expected[i] = malloc(2000);
+    }
+    translate(longSeq,threadArgs[t].expected,lengths,threadArgs[t].codonTableId, 5000);
+  }
+  for (t=0;t<NTRANSLATETHREAD;t++) {
+    pthread_create(&threads[t], NULL, translateThread, &threadArgs[t]);
+  }
+  int nMismatch = 0;
+  for (t=0;t<NTRANSLATETHREAD;t++) {
+    pthread_join(threads[t], NULL);
+    nMismatch += threadArgs[t].nMismatch;
+    for (i=0;i<6;i++) {
+      free(threadArgs[t].expected[i]);
+    }
+  }
+  ok(7, nMismatch == 0);
+
+  // rev_comp writes x for characters which can't be complemented, including in a block long enough for any block path
+  char revComp[80];
+  rev_comp("ACZTg", revComp, 5);
+  char longBad[65];
+  char longBadExpected[65];
+  memset(longBad, 'A', 64);
+  memset(longBadExpected, 'T', 64);
+  longBad[3] = 'Z';
+  longBadExpected[60] = 'x';
+  longBad[64] = longBadExpected[64] = '\0';
+  ok(8, !strcmp(revComp, "cAxGT"));
+  rev_comp(longBad, revComp, 64);
+  ok(9, !strcmp(revComp, longBadExpected));
+
+  free(single);
+  free(longSeq);
+  for (i=0;i<6;i++) {
+    free(frm[i]);
+  }
+
   return 0;
 }
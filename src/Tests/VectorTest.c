@@ -53,5 +53,55 @@ int main(int argc, char *argv[]) {
 
   ok(4, !strcmp(str,"g"));
 
+  // Small vectors stay in the inline elements, and move to the heap when they outgrow them
+  Vector *small = Vector_new();
+  Vector_addElement(small, "a");
+  ok(5, small->elements == small->inlineElements);
+  int i;
+  for (i=0; i<VECTOR_NINLINE; i++) {
+    Vector_addElement(small, "b");
+  }
+  ok(6, small->elements != small->inlineElements && Vector_getNumElement(small) == VECTOR_NINLINE+1 &&
+        !strcmp(Vector_getElementAt(small, 0), "a"));
+
+  // Insert and remove shuffle the others along
+  Vector_insertElementAt(small, 1, "c");
+  Vector_removeElementAt(small, 0);
+  ok(7, !strcmp(Vector_getElementAt(small, 0), "c") && !strcmp(Vector_getLastElement(small), "b") &&
+        Vector_getNumElement(small) == VECTOR_NINLINE+1);
+  Vector_free(small);
+
+  // Growth is geometric - adding lots only reallocates a few times
+  Vector *big = Vector_new();
+  int nGrow = 0;
+  int lastAlloced = big->nAlloced;
+  for (i=0; i<500000; i++) {
+    Vector_addElement(big, str);
+    if (big->nAlloced != lastAlloced) {
+      nGrow++;
+      lastAlloced = big->nAlloced;
+    }
+  }
+  ok(8, Vector_getNumElement(big) == 500000 && nGrow < 25);
+
+  // Reserving then bulk appending doesn't grow again
+  Vector *bulk = Vector_new();
+  Vector_reserve(bulk, 500007);
+  lastAlloced = bulk->nAlloced;
+  Vector_appendArray(bulk, big->elements, Vector_getNumElement(big));
+  Vector_append(bulk, v1);
+  ok(9, bulk->nAlloced == lastAlloced && Vector_getNumElement(bulk) == 500007 &&
+        !strcmp(Vector_getLastElement(bulk), "a"));
+
+  // Setting past the end fills the gap with NULLs
+  Vector *sparse = Vector_new();
+  Vector_setElementAt(sparse, 20, "x");
+  ok(10, Vector_getNumElement(sparse) == 21 && Vector_getElementAt(sparse, 19) == NULL &&
+         Vector_getElementAt(sparse, 3) == NULL);
+
+  Vector_free(big);
+  Vector_free(bulk);
+  Vector_free(sparse);
+
   return 0;
 }
@@ -0,0 +1,92 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WorkPool.h"
+
+#include "BaseTest.h"
+
+#include <unistd.h>
+
+#define NTASK 1000
+
+typedef struct TestDataStruct {
+  int runCount[NTASK];
+  int workerUsed[NTASK];
+} TestData;
+
+void countTask(void *data, int taskNum, int workerNum) {
+  TestData *td = (TestData *)data;
+
+  // Make the first few tasks slow so the other workers have to steal
+  if (taskNum < 4) {
+    usleep(20000);
+  }
+
+  td->runCount[taskNum]++;
+  td->workerUsed[taskNum] = workerNum;
+}
+
+int main(int argc, char *argv[]) {
+  TestData td;
+  int i;
+  int allOnce;
+
+  WorkPool *pool = WorkPool_new(4);
+
+  ok(1, pool != NULL && WorkPool_getNumWorker(pool) == 4);
+
+  memset(&td, 0, sizeof(TestData));
+  WorkPool_run(pool, NTASK, countTask, &td);
+
+  allOnce = 1;
+  for (i=0; i<NTASK; i++) {
+    if (td.runCount[i] != 1) allOnce = 0;
+  }
+  ok(2, allOnce);
+
+  int nRun = 0;
+  int nStolen = 0;
+  for (i=0; i<WorkPool_getNumWorker(pool); i++) {
+    nRun    += WorkPool_getNumTaskRun(pool, i);
+    nStolen += WorkPool_getNumStolen(pool, i);
+  }
+  ok(3, nRun == NTASK);
+
+  // Worker 0 is held up by the slow tasks at the start of its block
+  ok(4, nStolen > 0);
+
+  // Fewer tasks than workers
+  memset(&td, 0, sizeof(TestData));
+  WorkPool_run(pool, 2, countTask, &td);
+  ok(5, td.runCount[0] == 1 && td.runCount[1] == 1 && td.runCount[2] == 0);
+
+  WorkPool_free(pool);
+
+  // A single worker runs everything in order in this thread
+  pool = WorkPool_new(1);
+  memset(&td, 0, sizeof(TestData));
+  WorkPool_run(pool, 10, countTask, &td);
+
+  allOnce = 1;
+  for (i=0; i<10; i++) {
+    if (td.runCount[i] != 1 || td.workerUsed[i] != 0) allOnce = 0;
+  }
+  ok(6, allOnce && WorkPool_getNumStolen(pool, 0) == 0);
+
+  WorkPool_free(pool);
+
+  return 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Arena.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Everything handed out is aligned for any type, including the block data
+#define ARENA_ALIGN 16
+#define ARENA_ROUNDUP(N) (((N) + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1))
+#define ARENA_HEADERSIZE ARENA_ROUNDUP(sizeof(ArenaBlock))
+
+static __thread Arena *currentArena = NULL;
+
+static ArenaBlock *Arena_newBlock(size_t size);
+
+
+Arena *Arena_new(size_t blockSize) {
+  Arena *arena;
+
+  if ((arena = (Arena *)calloc(1,sizeof(Arena))) == NULL) {
+    fprintf(stderr, "ERROR: Failed allocating Arena\n");
+    exit(1);
+  }
+
+  arena->blockSize = blockSize ? blockSize : ARENA_DEFAULTBLOCKSIZE;
+
+  return arena;
+}
+
+static ArenaBlock *Arena_newBlock(size_t size) {
+  ArenaBlock *block;
+
+  if ((block = (ArenaBlock *)malloc(ARENA_HEADERSIZE + size)) == NULL) {
+    fprintf(stderr, "ERROR: Failed allocating Arena block of %zu bytes\n", size);
+    exit(1);
+  }
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+
+  return block;
+}
+
+/*
+ Returns size bytes of zeroed memory from arena. Blocks are only malloced,
+ so the zeroing happens here for just the bytes handed out. Requests of more
+ than a quarter of a block get a block of their own, put behind the current
+ one so it carries on being filled.
+*/
+void *Arena_calloc(Arena *arena, size_t size) {
+  ArenaBlock *block = arena->blocks;
+  void *ptr;
+
+  size = ARENA_ROUNDUP(size ? size : 1);
+
+  if (block == NULL || block->used + size > block->size) {
+    if (size > arena->blockSize / 4) {
+      ArenaBlock *bigBlock = Arena_newBlock(size);
+      bigBlock->used = size;
+      if (block == NULL) {
+        arena->blocks = bigBlock;
+      } else {
+        bigBlock->next = block->next;
+        block->next = bigBlock;
+      }
+      arena->nAlloc++;
+      arena->allocedSize += size;
+
+      ptr = (char *)bigBlock + ARENA_HEADERSIZE;
+      memset(ptr, 0, size);
+      return ptr;
+    }
+
+    block = Arena_newBlock(arena->blockSize);
+    block->next = arena->blocks;
+    arena->blocks = block;
+  }
+
+  ptr = (char *)block + ARENA_HEADERSIZE + block->used;
+  block->used += size;
+  arena->nAlloc++;
+  arena->allocedSize += size;
+
+  memset(ptr, 0, size);
+  return ptr;
+}
+
+char *Arena_strdup(Arena *arena, char *str) {
+  size_t len = strlen(str);
+  char *copy = Arena_calloc(arena, len+1);
+
+  memcpy(copy, str, len);
+
+  return copy;
+}
+
+/*
+ Is ptr in memory handed out by arena? Blocks are searched newest first, so
+ this is quick for objects which have just been made.
+*/
+int Arena_contains(Arena *arena, void *ptr) {
+  ArenaBlock *block;
+
+  for (block = arena->blocks; block != NULL; block = block->next) {
+    char *start = (char *)block + ARENA_HEADERSIZE;
+    if ((char *)ptr >= start && (char *)ptr < start + block->used) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ Releases everything allocated from arena, keeping its first block to be
+ reused. Anything still pointing into it is left dangling.
+*/
+void Arena_reset(Arena *arena) {
+  ArenaBlock *block = arena->blocks;
+
+  if (block == NULL) {
+    return;
+  }
+
+  while (block->next != NULL) {
+    ArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  block->used = 0;
+  arena->blocks = block;
+
+  arena->nAlloc = 0;
+  arena->allocedSize = 0;
+}
+
+void Arena_free(Arena *arena) {
+  ArenaBlock *block = arena->blocks;
+
+  if (currentArena == arena) {
+    currentArena = NULL;
+  }
+
+  while (block != NULL) {
+    ArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  free(arena);
+}
+
+/*
+ Makes arena (which can be NULL for none) the calling thread's current arena,
+ returning the previous one so nested users can put it back.
+*/
+Arena *Arena_setCurrent(Arena *arena) {
+  Arena *prev = currentArena;
+
+  currentArena = arena;
+
+  return prev;
+}
+
+Arena *Arena_getCurrent(void) {
+  return currentArena;
+}
+
+/*
+ Copy of str to hang off owner: from the current arena if owner came from it
+ (so it goes when the arena does), otherwise malloced as usual. ownerInArena
+ is the owning object's Object_isInArena flag - walking the arena's blocks to
+ find owner is too slow to do per string, so that's only checked with DBG.
+*/
+char *Arena_copyStringFor(void *owner, int ownerInArena, char *str) {
+  char *copy;
+
+  if (currentArena != NULL && ownerInArena) {
+#ifdef DBG
+    if (!Arena_contains(currentArena, owner)) {
+      fprintf(stderr,"ERROR: Arena object %p isn't from the current arena\n", owner);
+      exit(1);
+    }
+#endif
+    return Arena_strdup(currentArena, str);
+  }
+
+  if ((copy = (char *)malloc(strlen(str)+1)) == NULL) {
+    return NULL;
+  }
+  strcpy(copy, str);
+
+  return copy;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+/*
+ Region allocator. Memory is handed out from large blocks by bumping a
+ pointer, is never freed piece by piece, and all of it goes in one
+ Arena_free (or Arena_reset, which keeps the first block for reuse).
+
+ Each thread has a current arena (none to start with). While one is set the
+ Gene, Transcript, Exon, Translation and DNAAlignFeature constructors take
+ their objects, and those objects' vectors and strings, from it instead of
+ the heap. See Object_isInArena in Object.h for how freeing them is handled.
+*/
+
+typedef struct ArenaBlockStruct ArenaBlock;
+
+struct ArenaBlockStruct {
+  ArenaBlock *next;
+  size_t size;
+  size_t used;
+};
+
+typedef struct ArenaStruct {
+  ArenaBlock *blocks;
+  size_t blockSize;
+  size_t nAlloc;
+  size_t allocedSize;
+} Arena;
+
+#define ARENA_DEFAULTBLOCKSIZE (1024 * 1024)
+
+Arena *Arena_new(size_t blockSize);
+void  *Arena_calloc(Arena *arena, size_t size);
+char  *Arena_strdup(Arena *arena, char *str);
+int    Arena_contains(Arena *arena, void *ptr);
+void   Arena_reset(Arena *arena);
+void   Arena_free(Arena *arena);
+
+Arena *Arena_setCurrent(Arena *arena);
+Arena *Arena_getCurrent(void);
+
+char  *Arena_copyStringFor(void *owner, int ownerInArena, char *str);
+
+#define Arena_getNumAlloc(arena) (arena)->nAlloc
+#define Arena_getAllocedSize(arena) (arena)->allocedSize
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AssemblySnapshot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static int AssemblySnapshot_checkIndexes(AssemblySnapshot *snap);
+
+/*
+ FNV-1a hash of str, for the key identifying which database (and version of
+ it) a snapshot was made from
+*/
+uint64_t AssemblySnapshot_makeKey(char *str) {
+  uint64_t hash = 14695981039346656037ULL;
+  unsigned char *chP;
+
+  for (chP = (unsigned char *)str; *chP; chP++) {
+    hash ^= *chP;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/*
+ Writes a snapshot to fileName, via a temporary file which is renamed into
+ place so a partly written file is never seen. The arrays must already be in
+ the order described in AssemblySnapshot.h. Returns 0 on success.
+*/
+int AssemblySnapshot_write(char *fileName, uint64_t key,
+                           AssemblySnapshotRegion *regions, long nRegion,
+                           AssemblySnapshotSection *sections, long nSection,
+                           AssemblySnapshotRow *rows, long nRow,
+                           char *names, long nNameByte) {
+  AssemblySnapshotHeader header;
+  char tmpFileName[FILENAME_MAX];
+  FILE *fp;
+
+  memset(&header, 0, sizeof(AssemblySnapshotHeader));
+  memcpy(header.magic, ASSEMBLYSNAPSHOT_MAGIC, 8);
+  header.version   = ASSEMBLYSNAPSHOT_VERSION;
+  header.key       = key;
+  header.nRegion   = nRegion;
+  header.nSection  = nSection;
+  header.nRow      = nRow;
+  header.nNameByte = nNameByte;
+
+  sprintf(tmpFileName, "%s.tmp%d", fileName, (int)getpid());
+  if ((fp = fopen(tmpFileName, "w")) == NULL) {
+    fprintf(stderr,"Failed opening assembly snapshot file %s for writing\n", tmpFileName);
+    return 1;
+  }
+
+  int ok = fwrite(&header, sizeof(AssemblySnapshotHeader), 1, fp) == 1 &&
+           fwrite(regions, sizeof(AssemblySnapshotRegion), nRegion, fp) == nRegion &&
+           fwrite(sections, sizeof(AssemblySnapshotSection), nSection, fp) == nSection &&
+           fwrite(rows, sizeof(AssemblySnapshotRow), nRow, fp) == nRow &&
+           fwrite(names, sizeof(char), nNameByte, fp) == nNameByte;
+
+  if (fclose(fp) != 0) {
+    ok = 0;
+  }
+  if (ok && rename(tmpFileName, fileName) != 0) {
+    ok = 0;
+  }
+  if (!ok) {
+    fprintf(stderr,"Failed writing assembly snapshot file %s\n", fileName);
+    unlink(tmpFileName);
+  }
+
+  return !ok;
+}
+
+/*
+ Returns NULL if fileName doesn't exist, isn't a valid snapshot file (including
+ one with indexes out of range), or was made with a different key (so is stale)
+*/
+AssemblySnapshot *AssemblySnapshot_open(char *fileName, uint64_t key) {
+  AssemblySnapshot *snap;
+  struct stat st;
+  int fd;
+
+  if ((fd = open(fileName, O_RDONLY)) < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st) != 0 || st.st_size < sizeof(AssemblySnapshotHeader)) {
+    close(fd);
+    return NULL;
+  }
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+
+  AssemblySnapshotHeader *header = (AssemblySnapshotHeader *)map;
+  if (memcmp(header->magic, ASSEMBLYSNAPSHOT_MAGIC, 8) || header->version != ASSEMBLYSNAPSHOT_VERSION) {
+    fprintf(stderr,"Assembly snapshot file %s is not valid - ignoring it\n", fileName);
+    munmap(map, st.st_size);
+    return NULL;
+  }
+
+  // Counts are checked against the file size before multiplying so a corrupt one can't overflow
+  size_t expectedLen = 0;
+  if (header->nRegion >= 0 && header->nRegion <= st.st_size / sizeof(AssemblySnapshotRegion) &&
+      header->nSection >= 0 && header->nSection <= st.st_size / sizeof(AssemblySnapshotSection) &&
+      header->nRow >= 0 && header->nRow <= st.st_size / sizeof(AssemblySnapshotRow) &&
+      header->nNameByte >= 0 && header->nNameByte <= st.st_size) {
+    expectedLen = sizeof(AssemblySnapshotHeader) +
+                  header->nRegion * sizeof(AssemblySnapshotRegion) +
+                  header->nSection * sizeof(AssemblySnapshotSection) +
+                  header->nRow * sizeof(AssemblySnapshotRow) +
+                  header->nNameByte;
+  }
+
+  if (expectedLen != st.st_size) {
+    fprintf(stderr,"Assembly snapshot file %s is not valid - ignoring it\n", fileName);
+    munmap(map, st.st_size);
+    return NULL;
+  }
+  if (header->key != key) {
+    munmap(map, st.st_size);
+    return NULL;
+  }
+
+  if ((snap = (AssemblySnapshot *)calloc(1,sizeof(AssemblySnapshot))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating AssemblySnapshot\n");
+    exit(1);
+  }
+  snap->map       = map;
+  snap->mapLen    = st.st_size;
+  snap->regions   = (AssemblySnapshotRegion *)(header + 1);
+  snap->nRegion   = header->nRegion;
+  snap->sections  = (AssemblySnapshotSection *)(snap->regions + snap->nRegion);
+  snap->nSection  = header->nSection;
+  snap->rows      = (AssemblySnapshotRow *)(snap->sections + snap->nSection);
+  snap->nRow      = header->nRow;
+  snap->names     = (char *)(snap->rows + snap->nRow);
+  snap->nNameByte = header->nNameByte;
+
+  if (!AssemblySnapshot_checkIndexes(snap)) {
+    fprintf(stderr,"Assembly snapshot file %s is not valid - ignoring it\n", fileName);
+    AssemblySnapshot_close(snap);
+    return NULL;
+  }
+
+  return snap;
+}
+
+/*
+ Returns 1 if every name offset, section row range and row region index is
+ inside the file's arrays, so the file can't send lookups out of bounds, and
+ 0 if not
+*/
+static int AssemblySnapshot_checkIndexes(AssemblySnapshot *snap) {
+  long i;
+
+  // Names must be terminated within the name block
+  if (snap->nNameByte > 0 && snap->names[snap->nNameByte-1] != '\0') {
+    return 0;
+  }
+
+  for (i=0; i<snap->nRegion; i++) {
+    if (snap->regions[i].nameOffset < 0 || snap->regions[i].nameOffset >= snap->nNameByte) {
+      return 0;
+    }
+  }
+
+  for (i=0; i<snap->nSection; i++) {
+    AssemblySnapshotSection *section = &snap->sections[i];
+    if (section->firstRow < 0 || section->nRow < 0 || section->firstRow > snap->nRow - section->nRow) {
+      return 0;
+    }
+  }
+
+  for (i=0; i<snap->nRow; i++) {
+    AssemblySnapshotRow *row = &snap->rows[i];
+    if (row->asmRegion < 0 || row->asmRegion >= snap->nRegion ||
+        row->cmpRegion < 0 || row->cmpRegion >= snap->nRegion) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/*
+ Returns the section holding the rows between the two coord systems, or NULL
+ if the assembly table had none
+*/
+AssemblySnapshotSection *AssemblySnapshot_findSection(AssemblySnapshot *snap, int64_t asmCsId, int64_t cmpCsId) {
+  long lo = 0;
+  long hi = snap->nSection;
+
+  while (lo < hi) {
+    long mid = (lo + hi) / 2;
+    AssemblySnapshotSection *section = &snap->sections[mid];
+
+    if (section->asmCsId < asmCsId || (section->asmCsId == asmCsId && section->cmpCsId < cmpCsId)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if (lo < snap->nSection && snap->sections[lo].asmCsId == asmCsId && snap->sections[lo].cmpCsId == cmpCsId) {
+    return &snap->sections[lo];
+  }
+  return NULL;
+}
+
+/*
+ Returns the index of the region with id, or -1 if it isn't in the snapshot
+*/
+long AssemblySnapshot_findRegion(AssemblySnapshot *snap, int64_t id) {
+  long lo = 0;
+  long hi = snap->nRegion;
+
+  while (lo < hi) {
+    long mid = (lo + hi) / 2;
+    if (snap->regions[mid].id < id) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if (lo < snap->nRegion && snap->regions[lo].id == id) {
+    return lo;
+  }
+  return -1;
+}
+
+void AssemblySnapshot_close(AssemblySnapshot *snap) {
+  if (snap == NULL) {
+    return;
+  }
+  munmap(snap->map, snap->mapLen);
+  free(snap);
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ASSEMBLYSNAPSHOT_H__
+#define __ASSEMBLYSNAPSHOT_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ A copy of a database's assembly table, joined to the seq regions on either
+ side, in a file which is mapped read only. Lets AssemblyMapperAdaptor load
+ whole coord system to coord system mappings (and the seq region caches that
+ go with them) without querying the database.
+
+ Each file has a key, made from the server, the database name and its meta
+ schema and assembly versions. A file with a different key is stale, and is ignored in
+ the same way as a missing or damaged one. File layout, in native byte order:
+
+   AssemblySnapshotHeader
+   nRegion AssemblySnapshotRegions, sorted on id
+   nSection AssemblySnapshotSections, sorted on asmCsId then cmpCsId
+   nRow AssemblySnapshotRows, grouped by section
+   nNameByte bytes of '\0' terminated seq region names
+
+ Rows refer to regions by their index in the region array.
+*/
+
+#define ASSEMBLYSNAPSHOT_MAGIC "ENSCASNP"
+#define ASSEMBLYSNAPSHOT_VERSION 1
+
+typedef struct AssemblySnapshotHeaderStruct {
+  char     magic[8];
+  int64_t  version;
+  uint64_t key;
+  int64_t  nRegion;
+  int64_t  nSection;
+  int64_t  nRow;
+  int64_t  nNameByte;
+} AssemblySnapshotHeader;
+
+typedef struct AssemblySnapshotRegionStruct {
+  int64_t id;
+  int64_t csId;
+  int64_t length;
+  int64_t nameOffset;
+} AssemblySnapshotRegion;
+
+typedef struct AssemblySnapshotSectionStruct {
+  int64_t asmCsId;
+  int64_t cmpCsId;
+  int64_t firstRow;
+  int64_t nRow;
+} AssemblySnapshotSection;
+
+typedef struct AssemblySnapshotRowStruct {
+  int64_t asmRegion;
+  int64_t asmStart;
+  int64_t asmEnd;
+  int64_t cmpRegion;
+  int64_t cmpStart;
+  int64_t cmpEnd;
+  int64_t ori;
+} AssemblySnapshotRow;
+
+typedef struct AssemblySnapshotStruct {
+  void *map;
+  size_t mapLen;
+  AssemblySnapshotRegion *regions;
+  long nRegion;
+  AssemblySnapshotSection *sections;
+  long nSection;
+  AssemblySnapshotRow *rows;
+  long nRow;
+  char *names;
+  long nNameByte;
+} AssemblySnapshot;
+
+uint64_t AssemblySnapshot_makeKey(char *str);
+int      AssemblySnapshot_write(char *fileName, uint64_t key,
+                                AssemblySnapshotRegion *regions, long nRegion,
+                                AssemblySnapshotSection *sections, long nSection,
+                                AssemblySnapshotRow *rows, long nRow,
+                                char *names, long nNameByte);
+AssemblySnapshot        *AssemblySnapshot_open(char *fileName, uint64_t key);
+AssemblySnapshotSection *AssemblySnapshot_findSection(AssemblySnapshot *snap, int64_t asmCsId, int64_t cmpCsId);
+long     AssemblySnapshot_findRegion(AssemblySnapshot *snap, int64_t id);
+void     AssemblySnapshot_close(AssemblySnapshot *snap);
+
+#define AssemblySnapshot_getRegionName(snap, region) (&(snap)->names[(region)->nameOffset])
+#define AssemblySnapshot_getNumRegion(snap) (snap)->nRegion
+#define AssemblySnapshot_getNumRow(snap) (snap)->nRow
+
+#endif
@@ -0,0 +1,221 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CacheManager.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "StrUtil.h"
+
+CacheManager *CacheManager_new(size_t maxSize) {
+  CacheManager *cm;
+
+  if ((cm = (CacheManager *)calloc(1,sizeof(CacheManager))) == NULL) {
+    fprintf(stderr, "ERROR: Failed allocating CacheManager\n");
+    exit(1);
+  }
+
+  cm->maxSize = maxSize;
+
+  // Recursive because evicting reports back through CacheManagerClient_addSize
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&cm->lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+
+  return cm;
+}
+
+/*
+ Adds cache to the caches sharing cm's budget. cost is how expensive an entry
+ is to refetch, relative to the other clients' entries. peekFunc and
+ evictFunc can be NULL for a cache which can't give up entries.
+*/
+CacheManagerClient *CacheManager_register(CacheManager *cm, char *name, void *cache, double cost,
+                                          CacheManager_PeekFunc peekFunc, CacheManager_EvictFunc evictFunc) {
+  CacheManagerClient *client;
+
+  if ((client = (CacheManagerClient *)calloc(1,sizeof(CacheManagerClient))) == NULL) {
+    fprintf(stderr, "ERROR: Failed allocating CacheManagerClient\n");
+    exit(1);
+  }
+
+  StrUtil_copyString(&client->name, name, 0);
+  client->cache     = cache;
+  client->cost      = cost;
+  client->peekFunc  = peekFunc;
+  client->evictFunc = evictFunc;
+  client->manager   = cm;
+
+  pthread_mutex_lock(&cm->lock);
+  if ((cm->clients = (CacheManagerClient **)realloc(cm->clients, (cm->nClient+1) * sizeof(CacheManagerClient *))) == NULL) {
+    fprintf(stderr, "ERROR: Failed reallocating CacheManager clients\n");
+    exit(1);
+  }
+  cm->clients[cm->nClient++] = client;
+  pthread_mutex_unlock(&cm->lock);
+
+  return client;
+}
+
+/*
+ Takes client out of cm, dropping its size from the total, and frees it.
+ The cache itself isn't touched.
+*/
+void CacheManager_unregister(CacheManager *cm, CacheManagerClient *client) {
+  int i;
+
+  pthread_mutex_lock(&cm->lock);
+  for (i=0; i<cm->nClient; i++) {
+    if (cm->clients[i] == client) {
+      memmove(&cm->clients[i], &cm->clients[i+1], (cm->nClient-i-1) * sizeof(CacheManagerClient *));
+      cm->nClient--;
+      cm->curSize -= client->curSize;
+
+      free(client->name);
+      free(client);
+      pthread_mutex_unlock(&cm->lock);
+      return;
+    }
+  }
+  pthread_mutex_unlock(&cm->lock);
+  fprintf(stderr, "Tried to unregister a client which isn't in the CacheManager\n");
+}
+
+void CacheManager_setMaxSize(CacheManager *cm, size_t maxSize) {
+  pthread_mutex_lock(&cm->lock);
+  cm->maxSize = maxSize;
+  CacheManager_enforce(cm);
+  pthread_mutex_unlock(&cm->lock);
+}
+
+/*
+ Evicts until the total is back under budget, or nothing more can be evicted.
+ Evicting calls back into the caches, which report their smaller sizes through
+ CacheManagerClient_addSize, so this guards against being reentered from there.
+*/
+void CacheManager_enforce(CacheManager *cm) {
+  pthread_mutex_lock(&cm->lock);
+  if (cm->inEnforce) {
+    pthread_mutex_unlock(&cm->lock);
+    return;
+  }
+  cm->inEnforce = 1;
+
+  while (cm->curSize > cm->maxSize) {
+    CacheManagerClient *victim = NULL;
+    double victimPriority = 0.0;
+    int i;
+
+    for (i=0; i<cm->nClient; i++) {
+      CacheManagerClient *client = cm->clients[i];
+      double priority;
+
+      if (client->peekFunc != NULL && client->evictFunc != NULL &&
+          client->peekFunc(client->cache, &priority) &&
+          (victim == NULL || priority < victimPriority)) {
+        victim = client;
+        victimPriority = priority;
+      }
+    }
+
+    if (victim == NULL) {
+      break;
+    }
+
+    // Give up for now if the entry couldn't be evicted after all (its cache
+    // is busy in another thread) - the next addition will try again
+    if (!victim->evictFunc(victim->cache)) {
+      break;
+    }
+    victim->nEviction++;
+
+    if (victimPriority > cm->clock) {
+      cm->clock = victimPriority;
+    }
+  }
+
+  cm->inEnforce = 0;
+  pthread_mutex_unlock(&cm->lock);
+}
+
+/*
+ Priority for an entry of size bytes being added to or used in client's cache
+*/
+double CacheManagerClient_priority(CacheManagerClient *client, size_t size) {
+  CacheManager *cm = client->manager;
+
+  pthread_mutex_lock(&cm->lock);
+  double priority = cm->clock + client->cost / (double)(size ? size : 1);
+  pthread_mutex_unlock(&cm->lock);
+
+  return priority;
+}
+
+/*
+ Clients call this with the change in their size after adding (positive delta)
+ or removing (negative delta) entries. Adding can cause evictions, from this
+ client or others, so callers must have finished updating their own
+ structures first.
+*/
+void CacheManagerClient_addSize(CacheManagerClient *client, long delta) {
+  CacheManager *cm = client->manager;
+
+  pthread_mutex_lock(&cm->lock);
+  client->curSize += delta;
+  cm->curSize     += delta;
+
+  if (delta > 0) {
+    CacheManager_enforce(cm);
+  }
+  pthread_mutex_unlock(&cm->lock);
+}
+
+void CacheManager_printStats(CacheManager *cm, FILE *fp) {
+  int i;
+
+  pthread_mutex_lock(&cm->lock);
+  fprintf(fp, "CacheManager: %zu of %zu bytes used by %d caches\n", cm->curSize, cm->maxSize, cm->nClient);
+  for (i=0; i<cm->nClient; i++) {
+    CacheManagerClient *client = cm->clients[i];
+    long nLookup = client->nHit + client->nMiss;
+
+    fprintf(fp, "  %-40s %12zu bytes %10ld lookups %10ld hits (%5.1f%%) %8ld evictions%s\n",
+            client->name, client->curSize, nLookup, client->nHit,
+            nLookup ? 100.0 * client->nHit / nLookup : 0.0, client->nEviction,
+            client->evictFunc ? "" : " (not evictable)");
+  }
+  pthread_mutex_unlock(&cm->lock);
+}
+
+/*
+ Frees cm and its clients, but not the caches, which must not report to cm
+ after this.
+*/
+void CacheManager_free(CacheManager *cm) {
+  int i;
+
+  for (i=0; i<cm->nClient; i++) {
+    free(cm->clients[i]->name);
+    free(cm->clients[i]);
+  }
+  free(cm->clients);
+  pthread_mutex_destroy(&cm->lock);
+  free(cm);
+}
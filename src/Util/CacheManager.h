@@ -0,0 +1,101 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CACHEMANAGER_H__
+#define __CACHEMANAGER_H__
+
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/*
+ Shared byte budget for a set of caches.
+
+ Each cache registers as a client, giving a name, the relative cost of
+ refetching one of its entries, and functions to look at and evict its
+ least recently used entry. Clients report their size changes, and once the
+ total is over budget the manager evicts from whichever client's oldest
+ entry has the lowest priority.
+
+ Priorities are GreedyDual-Size: an entry gets clock + cost / size when it's
+ added or used, and the clock moves up to the priority of each entry evicted.
+ So cheap, big and long unused entries go first, whichever cache they're in.
+
+ Clients without evict functions (caches whose entries are referenced from
+ elsewhere) are counted in the total but never evicted from.
+
+ The manager's own bookkeeping is locked, but evicting calls into the caches
+ from whichever thread went over budget. Caches used from several threads
+ must lock in their peek and evict functions, and should only try for their
+ lock (returning 0 if they can't get it) so a thread holding the cache's
+ lock while adding to it can't deadlock with one evicting from it.
+*/
+
+typedef struct CacheManagerStruct CacheManager;
+typedef struct CacheManagerClientStruct CacheManagerClient;
+
+// Returns 1 and sets *priority if the cache has an entry it can give up, 0 if not
+typedef int  (*CacheManager_PeekFunc)(void *cache, double *priority);
+// Evicts the entry peekFunc looked at, returning 0 if it couldn't
+typedef int  (*CacheManager_EvictFunc)(void *cache);
+
+struct CacheManagerClientStruct {
+  char *name;
+  void *cache;
+  double cost;
+  CacheManager_PeekFunc peekFunc;
+  CacheManager_EvictFunc evictFunc;
+  CacheManager *manager;
+
+  size_t curSize;
+  long nHit;
+  long nMiss;
+  long nEviction;
+};
+
+struct CacheManagerStruct {
+  size_t maxSize;
+  size_t curSize;
+  double clock;
+  int inEnforce;
+  pthread_mutex_t lock;
+
+  CacheManagerClient **clients;
+  int nClient;
+};
+
+CacheManager *CacheManager_new(size_t maxSize);
+CacheManagerClient *CacheManager_register(CacheManager *cm, char *name, void *cache, double cost,
+                                          CacheManager_PeekFunc peekFunc, CacheManager_EvictFunc evictFunc);
+void   CacheManager_unregister(CacheManager *cm, CacheManagerClient *client);
+void   CacheManager_setMaxSize(CacheManager *cm, size_t maxSize);
+void   CacheManager_enforce(CacheManager *cm);
+void   CacheManager_printStats(CacheManager *cm, FILE *fp);
+void   CacheManager_free(CacheManager *cm);
+
+double CacheManagerClient_priority(CacheManagerClient *client, size_t size);
+void   CacheManagerClient_addSize(CacheManagerClient *client, long delta);
+
+#define CacheManager_getMaxSize(cm) (cm)->maxSize
+#define CacheManager_getSize(cm) (cm)->curSize
+#define CacheManager_getNumClient(cm) (cm)->nClient
+
+#define CacheManagerClient_addHit(client) (client)->nHit++
+#define CacheManagerClient_addMiss(client) (client)->nMiss++
+#define CacheManagerClient_getSize(client) (client)->curSize
+#define CacheManagerClient_getNumEviction(client) (client)->nEviction
+
+#endif
@@ -23,6 +23,24 @@
 #include "Error.h"
 #include "CHash.h"
 #include "StrUtil.h"
+
+#include <pthread.h>
+
+/*
+  The string table is shared by every thread (ecoSTable is global), so the
+  functions which look at or change it hold this lock. Internally they call
+  the *Unlocked versions of each other.
+*/
+static pthread_mutex_t EcoString_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void EcoString_lock(void) {
+  pthread_mutex_lock(&EcoString_mutex);
+}
+
+static void EcoString_unlock(void) {
+  pthread_mutex_unlock(&EcoString_mutex);
+}
+
 /******************************************************************************/
 /* Routine    :                                                               */
 /*             EcoString_addStr()                                             */
@@ -38,7 +56,7 @@
 /* History    :                                                               */
 /*             31/08/98 SMJS  Initial Implementation                          */
 /******************************************************************************/
-int EcoString_addStr(ECOSTRTABLE *EcoSTabP, char *String, int *StrInd) {
+static int EcoString_addStrUnlocked(ECOSTRTABLE *EcoSTabP, char *String, int *StrInd) {
   int NElement;
 
   if (!CHash_addAllocedStr(EcoSTabP->CHashTab,String)) {
@@ -75,6 +93,16 @@ int EcoString_addStr(ECOSTRTABLE *EcoSTabP, char *String, int *StrInd) {
   return 1;
 }
 
+int EcoString_addStr(ECOSTRTABLE *EcoSTabP, char *String, int *StrInd) {
+  int ret;
+
+  EcoString_lock();
+  ret = EcoString_addStrUnlocked(EcoSTabP,String,StrInd);
+  EcoString_unlock();
+
+  return ret;
+}
+
 /******************************************************************************/
 /* Routine    :                                                               */
 /*             EcoString_changeStr()                                          */
@@ -299,7 +327,7 @@ int EcoString_copyTStr(ECOSTRTABLE *EcoSTabP, ECOSTRING *To, char *From,int Star
 /* History    :                                                               */
 /*             31/08/98 SMJS  Initial Implementation                          */
 /******************************************************************************/
-int EcoString_delStr(ECOSTRTABLE *EcoSTabP, ECOSTRING String,int StrInd) {
+static int EcoString_delStrUnlocked(ECOSTRTABLE *EcoSTabP, ECOSTRING String,int StrInd) {
   int LetInd;
 
   if (EcoSTabP->UseCount[StrInd]>0) {
@@ -325,6 +353,16 @@ int EcoString_delStr(ECOSTRTABLE *EcoSTabP, ECOSTRING String,int StrInd) {
   return 1;
 }
 
+int EcoString_delStr(ECOSTRTABLE *EcoSTabP, ECOSTRING String,int StrInd) {
+  int ret;
+
+  EcoString_lock();
+  ret = EcoString_delStrUnlocked(EcoSTabP,String,StrInd);
+  EcoString_unlock();
+
+  return ret;
+}
+
 /******************************************************************************/
 /* Routine    :                                                               */
 /*             EcoString_freeStr()                                            */
@@ -391,7 +429,7 @@ int EcoString_genCheckSum(char *String) {
 /* History    :                                                               */
 /*             31/08/98 SMJS  Initial Implementation                          */
 /******************************************************************************/
-int EcoString_getInfo(ECOSTRTABLE *EcoSTabP) {
+static int EcoString_getInfoUnlocked(ECOSTRTABLE *EcoSTabP) {
   int i;
   int TotalUsed = 0;
   int TotalSaved = 0;
@@ -422,6 +460,16 @@ int EcoString_getInfo(ECOSTRTABLE *EcoSTabP) {
   return 1;
 }
 
+int EcoString_getInfo(ECOSTRTABLE *EcoSTabP) {
+  int ret;
+
+  EcoString_lock();
+  ret = EcoString_getInfoUnlocked(EcoSTabP);
+  EcoString_unlock();
+
+  return ret;
+}
+
 /******************************************************************************/
 /* Routine    :                                                               */
 /*             EcoString_getPointer()                                         */
@@ -437,13 +485,13 @@ int EcoString_getInfo(ECOSTRTABLE *EcoSTabP) {
 /* History    :                                                               */
 /*             31/08/98 SMJS  Initial Implementation                          */
 /******************************************************************************/
-int EcoString_getPointer(ECOSTRTABLE *EcoSTabP, ECOSTRING *To, char *From) {
+static int EcoString_getPointerUnlocked(ECOSTRTABLE *EcoSTabP, ECOSTRING *To, char *From) {
   int StrInd;
 
 /* Look for it in array */
   if (!CHash_find(From,EcoSTabP->CHashTab,&StrInd)) {
 /* If not found add it to array */
-    if (!EcoString_addStr(EcoSTabP,From,&StrInd)) {
+    if (!EcoString_addStrUnlocked(EcoSTabP,From,&StrInd)) {
       Error_trace("EcoString_getPointer",NULL);
       free(From);
       return 0;
@@ -460,6 +508,16 @@ int EcoString_getPointer(ECOSTRTABLE *EcoSTabP, ECOSTRING *To, char *From) {
   return 1;
 }
 
+int EcoString_getPointer(ECOSTRTABLE *EcoSTabP, ECOSTRING *To, char *From) {
+  int ret;
+
+  EcoString_lock();
+  ret = EcoString_getPointerUnlocked(EcoSTabP,To,From);
+  EcoString_unlock();
+
+  return ret;
+}
+
 /******************************************************************************/
 /* Routine    :                                                               */
 /*             EcoString_initTable()                                          */
@@ -499,7 +557,7 @@ int EcoString_initTable(ECOSTRTABLE **EcoSTabP) {
 /* History    :                                                               */
 /*             31/08/98 SMJS  Initial Implementation                          */
 /******************************************************************************/
-int EcoString_subtractOne(ECOSTRTABLE *EcoSTabP, ECOSTRING String) {
+static int EcoString_subtractOneUnlocked(ECOSTRTABLE *EcoSTabP, ECOSTRING String) {
   int StrInd;
 
 /* Look for it in array */
@@ -516,7 +574,7 @@ int EcoString_subtractOne(ECOSTRTABLE *EcoSTabP, ECOSTRING String) {
     }
     (EcoSTabP->UseCount[StrInd])--;
     if (EcoSTabP->UseCount[StrInd] == 0) {
-      if (!EcoString_delStr(EcoSTabP,String,StrInd)) {
+      if (!EcoString_delStrUnlocked(EcoSTabP,String,StrInd)) {
         Error_trace("EcoString_subtractOne",NULL);
         return 0;
       }
@@ -526,3 +584,13 @@ int EcoString_subtractOne(ECOSTRTABLE *EcoSTabP, ECOSTRING String) {
 /* Return success */
   return 1;
 }
+
+int EcoString_subtractOne(ECOSTRTABLE *EcoSTabP, ECOSTRING String) {
+  int ret;
+
+  EcoString_lock();
+  ret = EcoString_subtractOneUnlocked(EcoSTabP,String);
+  EcoString_unlock();
+
+  return ret;
+}
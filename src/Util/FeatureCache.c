@@ -0,0 +1,309 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FeatureCache.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "StrUtil.h"
+
+#define FEATURECACHE_INITIALBUCKETS 64
+
+static int  FeatureCache_keysEqual(FeatureCacheKey *key1, FeatureCacheKey *key2);
+static void FeatureCache_grow(FeatureCache *cache);
+static void FeatureCache_unlink(FeatureCache *cache, FeatureCacheElement *elem);
+static void FeatureCache_removeElement(FeatureCache *cache, FeatureCacheElement *elem);
+static int  FeatureCache_peekOldest(void *cache, double *priority);
+static int  FeatureCache_evictOldest(void *cache);
+
+
+FeatureCache *FeatureCache_new(size_t maxSize) {
+  FeatureCache *cache;
+
+  if ((cache = (FeatureCache *)calloc(1,sizeof(FeatureCache))) == NULL) {
+    fprintf(stderr, "ERROR: Failed allocating FeatureCache\n");
+    exit(1);
+  }
+
+  cache->nBucket = FEATURECACHE_INITIALBUCKETS;
+  if ((cache->buckets = (FeatureCacheElement **)calloc(cache->nBucket, sizeof(FeatureCacheElement *))) == NULL) {
+    fprintf(stderr, "ERROR: Failed allocating FeatureCache buckets\n");
+    exit(1);
+  }
+
+  cache->maxSize = maxSize;
+
+  return cache;
+}
+
+/*
+ Fills in key, hashing the fields (FNV-1a) so lookups only compare the
+ constraint strings of entries which are probably the same. The constraint
+ isn't copied so must stay valid while key is in use.
+*/
+void FeatureCacheKey_init(FeatureCacheKey *key, IDType seqRegionId, long start, long end, int strand, char *constraint) {
+  uint64_t hash = 14695981039346656037ULL;
+  unsigned char *chP;
+
+  key->seqRegionId = seqRegionId;
+  key->start       = start;
+  key->end         = end;
+  key->strand      = strand;
+  key->constraint  = constraint ? constraint : "";
+
+#define FEATURECACHE_HASHBYTES(P, N) { \
+    int i; \
+    for (i=0; i<(N); i++) { \
+      hash ^= ((unsigned char *)(P))[i]; \
+      hash *= 1099511628211ULL; \
+    } \
+  }
+  FEATURECACHE_HASHBYTES(&seqRegionId, sizeof(IDType));
+  FEATURECACHE_HASHBYTES(&start, sizeof(long));
+  FEATURECACHE_HASHBYTES(&end, sizeof(long));
+  FEATURECACHE_HASHBYTES(&strand, sizeof(int));
+#undef FEATURECACHE_HASHBYTES
+
+  for (chP = (unsigned char *)key->constraint; *chP; chP++) {
+    hash ^= *chP;
+    hash *= 1099511628211ULL;
+  }
+
+  key->hash = hash;
+}
+
+static int FeatureCache_keysEqual(FeatureCacheKey *key1, FeatureCacheKey *key2) {
+  return key1->hash == key2->hash &&
+         key1->seqRegionId == key2->seqRegionId &&
+         key1->start == key2->start &&
+         key1->end == key2->end &&
+         key1->strand == key2->strand &&
+         !strcmp(key1->constraint, key2->constraint);
+}
+
+/*
+ Returns the cached value for key, or NULL if there isn't one. A hit makes
+ the entry the most recently used.
+*/
+void *FeatureCache_get(FeatureCache *cache, FeatureCacheKey *key) {
+  FeatureCacheElement *elem = cache->buckets[key->hash & (cache->nBucket-1)];
+
+  while (elem != NULL && !FeatureCache_keysEqual(&elem->key, key)) {
+    elem = elem->hashNext;
+  }
+
+  if (elem == NULL) {
+    cache->nMiss++;
+    if (cache->client) {
+      CacheManagerClient_addMiss(cache->client);
+    }
+    return NULL;
+  }
+
+  cache->nHit++;
+  if (cache->client) {
+    elem->priority = CacheManagerClient_priority(cache->client, elem->size);
+    CacheManagerClient_addHit(cache->client);
+  }
+
+  if (elem != cache->tail) {
+    FeatureCache_unlink(cache, elem);
+
+    elem->prev = cache->tail;
+    elem->next = NULL;
+    cache->tail->next = elem;
+    cache->tail = elem;
+  }
+
+  return elem->val;
+}
+
+/*
+ Adds val (size bytes) under key, replacing any existing entry for key and
+ evicting least recently used entries until the new one fits. The cache owns
+ val from now on, and calls freeFunc (if not NULL) on it when it's evicted.
+*/
+void FeatureCache_put(FeatureCache *cache, FeatureCacheKey *key, void *val, FeatureCache_FreeFunc freeFunc, size_t size) {
+  FeatureCacheElement *elem = cache->buckets[key->hash & (cache->nBucket-1)];
+
+  while (elem != NULL && !FeatureCache_keysEqual(&elem->key, key)) {
+    elem = elem->hashNext;
+  }
+  if (elem != NULL) {
+    FeatureCache_removeElement(cache, elem);
+  }
+
+  while (cache->head != NULL && cache->curSize + size > cache->maxSize) {
+    FeatureCache_removeElement(cache, cache->head);
+    cache->nEviction++;
+  }
+
+  if ((elem = (FeatureCacheElement *)calloc(1,sizeof(FeatureCacheElement))) == NULL) {
+    fprintf(stderr, "ERROR: Failed allocating FeatureCache element\n");
+    exit(1);
+  }
+
+  elem->key = *key;
+  StrUtil_copyString(&elem->key.constraint, key->constraint, 0);
+  elem->val      = val;
+  elem->size     = size;
+  elem->freeFunc = freeFunc;
+
+  if (cache->nElement >= cache->nBucket) {
+    FeatureCache_grow(cache);
+  }
+
+  int bucketNum = elem->key.hash & (cache->nBucket-1);
+  elem->hashNext = cache->buckets[bucketNum];
+  cache->buckets[bucketNum] = elem;
+
+  if (cache->tail == NULL) {
+    cache->head = cache->tail = elem;
+  } else {
+    elem->prev = cache->tail;
+    cache->tail->next = elem;
+    cache->tail = elem;
+  }
+
+  cache->nElement++;
+  cache->curSize += size;
+
+  // Tell the manager last, as it may evict other entries to make room
+  if (cache->client) {
+    elem->priority = CacheManagerClient_priority(cache->client, size);
+    CacheManagerClient_addSize(cache->client, size);
+  }
+}
+
+static void FeatureCache_grow(FeatureCache *cache) {
+  int newNBucket = cache->nBucket * 2;
+  FeatureCacheElement **newBuckets;
+  int i;
+
+  if ((newBuckets = (FeatureCacheElement **)calloc(newNBucket, sizeof(FeatureCacheElement *))) == NULL) {
+    fprintf(stderr, "ERROR: Failed allocating FeatureCache buckets\n");
+    exit(1);
+  }
+
+  for (i=0; i<cache->nBucket; i++) {
+    FeatureCacheElement *elem = cache->buckets[i];
+    while (elem != NULL) {
+      FeatureCacheElement *next = elem->hashNext;
+      int bucketNum = elem->key.hash & (newNBucket-1);
+
+      elem->hashNext = newBuckets[bucketNum];
+      newBuckets[bucketNum] = elem;
+      elem = next;
+    }
+  }
+
+  free(cache->buckets);
+  cache->buckets = newBuckets;
+  cache->nBucket = newNBucket;
+}
+
+// Takes elem out of the recently used list
+static void FeatureCache_unlink(FeatureCache *cache, FeatureCacheElement *elem) {
+  if (elem->prev != NULL) {
+    elem->prev->next = elem->next;
+  } else {
+    cache->head = elem->next;
+  }
+  if (elem->next != NULL) {
+    elem->next->prev = elem->prev;
+  } else {
+    cache->tail = elem->prev;
+  }
+  elem->prev = elem->next = NULL;
+}
+
+static void FeatureCache_removeElement(FeatureCache *cache, FeatureCacheElement *elem) {
+  FeatureCacheElement **elemP = &cache->buckets[elem->key.hash & (cache->nBucket-1)];
+
+  while (*elemP != elem) {
+    elemP = &(*elemP)->hashNext;
+  }
+  *elemP = elem->hashNext;
+
+  FeatureCache_unlink(cache, elem);
+
+  cache->nElement--;
+  cache->curSize -= elem->size;
+  if (cache->client) {
+    CacheManagerClient_addSize(cache->client, -(long)elem->size);
+  }
+
+  if (elem->freeFunc) {
+    elem->freeFunc(elem->val);
+  }
+  free(elem->key.constraint);
+  free(elem);
+}
+
+void FeatureCache_empty(FeatureCache *cache) {
+  while (cache->head != NULL) {
+    FeatureCache_removeElement(cache, cache->head);
+  }
+}
+
+void FeatureCache_free(FeatureCache *cache) {
+  FeatureCache_empty(cache);
+  if (cache->client) {
+    CacheManager_unregister(cache->client->manager, cache->client);
+  }
+  free(cache->buckets);
+  free(cache);
+}
+
+/*
+ Makes cache share cm's budget, as well as keeping to its own maxSize. As
+ with the cache's own limit, the most recently used entry is never given up.
+*/
+void FeatureCache_setManager(FeatureCache *cache, CacheManager *cm, char *name, double cost) {
+  cache->client = CacheManager_register(cm, name, cache, cost, FeatureCache_peekOldest, FeatureCache_evictOldest);
+  CacheManagerClient_addSize(cache->client, cache->curSize);
+}
+
+static int FeatureCache_peekOldest(void *cache, double *priority) {
+  FeatureCache *featCache = cache;
+
+  if (featCache->head == NULL || featCache->head == featCache->tail) {
+    return 0;
+  }
+  *priority = featCache->head->priority;
+  return 1;
+}
+
+static int FeatureCache_evictOldest(void *cache) {
+  FeatureCache *featCache = cache;
+
+  if (featCache->head == NULL || featCache->head == featCache->tail) {
+    return 0;
+  }
+  FeatureCache_removeElement(featCache, featCache->head);
+  featCache->nEviction++;
+  return 1;
+}
+
+void FeatureCache_printStats(FeatureCache *cache, FILE *fp) {
+  long nLookup = cache->nHit + cache->nMiss;
+
+  fprintf(fp, "FeatureCache: %d entries using %zu of %zu bytes. %ld lookups, %ld hits (%.1f%%), %ld evictions\n",
+          cache->nElement, cache->curSize, cache->maxSize, nLookup, cache->nHit,
+          nLookup ? 100.0 * cache->nHit / nLookup : 0.0, cache->nEviction);
+}
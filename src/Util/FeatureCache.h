@@ -0,0 +1,99 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FEATURECACHE_H__
+#define __FEATURECACHE_H__
+
+#include "EnsC.h"
+#include "CacheManager.h"
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ Cache of feature fetch results keyed on the region fetched and the SQL
+ constraint used. Lookups are hashed, and entries are evicted least recently
+ used first once the total size (in bytes, as given by the caller) goes over
+ the limit. The most recently added entry is always kept, even if it's bigger
+ than the limit on its own.
+
+ Once the cache has a manager, a put into any of the manager's caches can
+ evict any other entry, so a value the caller wants to keep past its next
+ cache call needs a reference of its own (as BaseFeatureAdaptor takes on the
+ result vectors it caches).
+*/
+
+typedef struct FeatureCacheStruct FeatureCache;
+typedef struct FeatureCacheKeyStruct FeatureCacheKey;
+typedef struct FeatureCacheElementStruct FeatureCacheElement;
+
+typedef void (*FeatureCache_FreeFunc)(void *);
+
+struct FeatureCacheKeyStruct {
+  IDType   seqRegionId;
+  long     start;
+  long     end;
+  int      strand;
+  uint64_t hash;
+  char    *constraint;
+};
+
+struct FeatureCacheElementStruct {
+  FeatureCacheKey key;
+  void *val;
+  size_t size;
+  double priority;
+  FeatureCache_FreeFunc freeFunc;
+  FeatureCacheElement *hashNext;
+  FeatureCacheElement *prev;
+  FeatureCacheElement *next;
+};
+
+struct FeatureCacheStruct {
+  FeatureCacheElement **buckets;
+  int nBucket;
+  int nElement;
+  size_t curSize;
+  size_t maxSize;
+
+  // Least recently used at head
+  FeatureCacheElement *head;
+  FeatureCacheElement *tail;
+
+  long nHit;
+  long nMiss;
+  long nEviction;
+
+  CacheManagerClient *client;
+};
+
+FeatureCache *FeatureCache_new(size_t maxSize);
+void *FeatureCache_get(FeatureCache *cache, FeatureCacheKey *key);
+void  FeatureCache_put(FeatureCache *cache, FeatureCacheKey *key, void *val, FeatureCache_FreeFunc freeFunc, size_t size);
+void  FeatureCache_empty(FeatureCache *cache);
+void  FeatureCache_free(FeatureCache *cache);
+void  FeatureCache_printStats(FeatureCache *cache, FILE *fp);
+void  FeatureCache_setManager(FeatureCache *cache, CacheManager *cm, char *name, double cost);
+
+void FeatureCacheKey_init(FeatureCacheKey *key, IDType seqRegionId, long start, long end, int strand, char *constraint);
+
+#define FeatureCache_getNumElement(cache) (cache)->nElement
+#define FeatureCache_getSize(cache) (cache)->curSize
+#define FeatureCache_getNumHit(cache) (cache)->nHit
+#define FeatureCache_getNumMiss(cache) (cache)->nMiss
+#define FeatureCache_getNumEviction(cache) (cache)->nEviction
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "IntervalIndex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Subtrees at or below this level are scanned linearly rather than descended
+#define INTERVALINDEX_SCANLEVEL 3
+
+static int IntervalIndex_startCompFunc(const void *a, const void *b);
+
+
+IntervalIndex *IntervalIndex_new(void) {
+  IntervalIndex *ii;
+
+  if ((ii = (IntervalIndex *)calloc(1,sizeof(IntervalIndex))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating IntervalIndex\n");
+    exit(1);
+  }
+
+  return ii;
+}
+
+void IntervalIndex_add(IntervalIndex *ii, long start, long end, void *data) {
+  if (ii->isBuilt) {
+    fprintf(stderr,"ERROR: Can't add to an IntervalIndex after it's been built\n");
+    exit(1);
+  }
+
+  if (ii->nInterval == ii->nAlloc) {
+    ii->nAlloc = ii->nAlloc ? ii->nAlloc * 2 : 64;
+    if ((ii->intervals = (Interval *)realloc(ii->intervals, ii->nAlloc * sizeof(Interval))) == NULL) {
+      fprintf(stderr,"ERROR: Failed reallocating IntervalIndex intervals\n");
+      exit(1);
+    }
+  }
+
+  Interval *iv = &ii->intervals[ii->nInterval++];
+  iv->start  = start;
+  iv->end    = end;
+  iv->maxEnd = end;
+  iv->data   = data;
+}
+
+static int IntervalIndex_startCompFunc(const void *a, const void *b) {
+  const Interval *iv1 = (const Interval *)a;
+  const Interval *iv2 = (const Interval *)b;
+
+  if (iv1->start != iv2->start) {
+    return iv1->start < iv2->start ? -1 : 1;
+  }
+  if (iv1->end != iv2->end) {
+    return iv1->end < iv2->end ? -1 : 1;
+  }
+  return 0;
+}
+
+/*
+ Fills in maxEnd bottom up, one level at a time. A node's right child can be
+ past the end of the array when n isn't a power of 2 minus 1, in which case the
+ max end of the last complete subtree on the left edge of the missing part
+ (lastMaxEnd) stands in for it.
+*/
+void IntervalIndex_build(IntervalIndex *ii) {
+  Interval *a = ii->intervals;
+  int n = ii->nInterval;
+  long lastMaxEnd = 0;
+  int lastInd = 0;
+  int level;
+  int i;
+
+  ii->isBuilt = 1;
+
+  if (n == 0) {
+    ii->maxLevel = -1;
+    return;
+  }
+
+  qsort(a, n, sizeof(Interval), IntervalIndex_startCompFunc);
+
+  for (i=0; i<n; i+=2) {
+    a[i].maxEnd = a[i].end;
+    lastInd = i;
+    lastMaxEnd = a[i].end;
+  }
+
+  for (level=1; (1L << level) <= n; level++) {
+    long half = 1L << (level-1);
+    long step = half << 2;
+    long ind;
+
+    for (ind = (half << 1) - 1; ind < n; ind += step) {
+      long leftMax  = a[ind - half].maxEnd;
+      long rightMax = ind + half < n ? a[ind + half].maxEnd : lastMaxEnd;
+      long maxEnd   = a[ind].end;
+
+      if (leftMax > maxEnd) maxEnd = leftMax;
+      if (rightMax > maxEnd) maxEnd = rightMax;
+      a[ind].maxEnd = maxEnd;
+    }
+
+    lastInd = (lastInd >> level) & 1 ? lastInd : lastInd + (half << 1);
+    if (lastInd < n && a[lastInd].maxEnd > lastMaxEnd) {
+      lastMaxEnd = a[lastInd].maxEnd;
+    }
+  }
+  ii->maxLevel = level - 1;
+}
+
+/*
+ Finds the intervals overlapping start to end (inclusive). The indexes of the
+ overlapping intervals are put in *indsP, which is reallocated as needed
+ (*nIndAllocP is its allocated length) so one array can be reused for many
+ queries. Returns the number of overlapping intervals.
+*/
+int IntervalIndex_findOverlaps(IntervalIndex *ii, long start, long end, int **indsP, int *nIndAllocP) {
+  struct {
+    long ind;
+    int  level;
+    int  leftDone;
+  } stack[64];
+  Interval *a = ii->intervals;
+  long n = ii->nInterval;
+  int nStack = 0;
+  int nFound = 0;
+
+  if (!ii->isBuilt) {
+    fprintf(stderr,"ERROR: IntervalIndex must be built before it can be searched\n");
+    exit(1);
+  }
+  if (n == 0) {
+    return 0;
+  }
+
+#define INTERVALINDEX_ADDFOUND(IND) { \
+    if (nFound == *nIndAllocP) { \
+      *nIndAllocP = *nIndAllocP ? *nIndAllocP * 2 : 16; \
+      if ((*indsP = (int *)realloc(*indsP, *nIndAllocP * sizeof(int))) == NULL) { \
+        fprintf(stderr,"ERROR: Failed reallocating IntervalIndex overlap array\n"); \
+        exit(1); \
+      } \
+    } \
+    (*indsP)[nFound++] = (IND); \
+  }
+
+  stack[nStack].ind = (1L << ii->maxLevel) - 1;
+  stack[nStack].level = ii->maxLevel;
+  stack[nStack++].leftDone = 0;
+
+  while (nStack) {
+    long ind = stack[--nStack].ind;
+    int level = stack[nStack].level;
+    int leftDone = stack[nStack].leftDone;
+
+    if (level <= INTERVALINDEX_SCANLEVEL) {
+      // Small subtree - scan its elements in order
+      long i;
+      long first = ind >> level << level;
+      long last = first + (1L << (level+1)) - 1;
+
+      if (last > n) last = n;
+      for (i=first; i<last && a[i].start <= end; i++) {
+        if (a[i].end >= start) {
+          INTERVALINDEX_ADDFOUND(i);
+        }
+      }
+    } else if (!leftDone) {
+      long left = ind - (1L << (level-1));
+
+      // Come back to this node after the left subtree
+      stack[nStack].ind = ind;
+      stack[nStack].level = level;
+      stack[nStack++].leftDone = 1;
+
+      if (left >= n || a[left].maxEnd >= start) {
+        stack[nStack].ind = left;
+        stack[nStack].level = level-1;
+        stack[nStack++].leftDone = 0;
+      }
+    } else if (ind < n && a[ind].start <= end) {
+      if (a[ind].end >= start) {
+        INTERVALINDEX_ADDFOUND(ind);
+      }
+      stack[nStack].ind = ind + (1L << (level-1));
+      stack[nStack].level = level-1;
+      stack[nStack++].leftDone = 0;
+    }
+  }
+#undef INTERVALINDEX_ADDFOUND
+
+  return nFound;
+}
+
+void IntervalIndex_free(IntervalIndex *ii) {
+  free(ii->intervals);
+  free(ii);
+}
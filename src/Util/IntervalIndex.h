@@ -0,0 +1,58 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __INTERVALINDEX_H__
+#define __INTERVALINDEX_H__
+
+/*
+ Static overlap index for a set of closed intervals (start and end inclusive,
+ as for features).
+
+ Intervals are added, then IntervalIndex_build sorts them on start and lays
+ an implicit interval tree over the sorted array: element i is a node whose
+ level is the number of trailing 1 bits in i, and each node stores the max
+ end in its subtree. There are no child pointers, so the index is one flat
+ array, and the leaves near a query are scanned linearly.
+
+ Queries return indexes into the sorted array, in start order. Nothing can
+ be added after the index is built.
+*/
+
+typedef struct IntervalStruct {
+  long  start;
+  long  end;
+  long  maxEnd;  // Max end in the subtree rooted at this element
+  void *data;
+} Interval;
+
+typedef struct IntervalIndexStruct {
+  Interval *intervals;
+  int nInterval;
+  int nAlloc;
+  int maxLevel;
+  int isBuilt;
+} IntervalIndex;
+
+IntervalIndex *IntervalIndex_new(void);
+void           IntervalIndex_add(IntervalIndex *ii, long start, long end, void *data);
+void           IntervalIndex_build(IntervalIndex *ii);
+int            IntervalIndex_findOverlaps(IntervalIndex *ii, long start, long end, int **indsP, int *nIndAllocP);
+void           IntervalIndex_free(IntervalIndex *ii);
+
+#define IntervalIndex_getNumInterval(ii) (ii)->nInterval
+#define IntervalIndex_getIntervalAt(ii, ind) (&(ii)->intervals[(ind)])
+
+#endif
@@ -23,6 +23,9 @@
 
 #include "StrUtil.h"
 
+static int LRUCache_peekOldest(void *cache, double *priority);
+static int LRUCache_evictOldest(void *cache);
+
 LRUCache *LRUCache_new(int size) {
   LRUCache *cache;
 
@@ -84,6 +87,12 @@ int LRUCache_put(LRUCache *cache, char *key, void *data, LRUCache_FreeFunc freeF
   // Add to size
   cache->curSize += size;
 
+  // Tell the manager last, as it may evict other entries to make room
+  if (cache->client) {
+    cacheElem->priority = CacheManagerClient_priority(cache->client, size);
+    CacheManagerClient_addSize(cache->client, size);
+  }
+
   return 1;
 }
 
@@ -91,7 +100,14 @@ int LRUCache_put(LRUCache *cache, char *key, void *data, LRUCache_FreeFunc freeF
 int LRUCache_contains(LRUCache *cache, char *key) {
 
   // Check hash for key
-  return StringHash_contains(cache->hash, key);
+  int contains = StringHash_contains(cache->hash, key);
+
+  // Callers check before getting, so a miss is counted here and a hit in get
+  if (!contains && cache->client) {
+    CacheManagerClient_addMiss(cache->client);
+  }
+
+  return contains;
 }
 
 void *LRUCache_get(LRUCache *cache, char *key) {
@@ -128,6 +144,11 @@ void *LRUCache_get(LRUCache *cache, char *key) {
     }
     cacheElem->nAccess++;
 
+    if (cache->client) {
+      cacheElem->priority = CacheManagerClient_priority(cache->client, cacheElem->size);
+      CacheManagerClient_addHit(cache->client);
+    }
+
     return cacheElem->val;
 
   } else {
@@ -203,6 +224,9 @@ void LRUCache_remove(LRUCache *cache, char *key) {
   
     // Reduce size
     cache->curSize -= cacheElem->size;
+    if (cache->client) {
+      CacheManagerClient_addSize(cache->client, -cacheElem->size);
+    }
 
     // Free element
     LRUCacheElement_free(cacheElem);
@@ -212,6 +236,57 @@ void LRUCache_remove(LRUCache *cache, char *key) {
   }
 }
 
+/*
+ Makes cache share cm's budget, as well as keeping to its own maxSize. The
+ most recently used entry is never given up to the manager, so a value just
+ put or got stays valid however far over budget cm is.
+ If cache is used from several threads, lock is the (recursive) mutex its
+ users hold, and the manager only evicts when it can get it.
+*/
+void LRUCache_setManager(LRUCache *cache, CacheManager *cm, char *name, double cost, pthread_mutex_t *lock) {
+  cache->lock   = lock;
+  cache->client = CacheManager_register(cm, name, cache, cost, LRUCache_peekOldest, LRUCache_evictOldest);
+  CacheManagerClient_addSize(cache->client, cache->curSize);
+}
+
+static int LRUCache_peekOldest(void *cache, double *priority) {
+  LRUCache *lruCache = cache;
+  int canEvict;
+
+  if (lruCache->lock && pthread_mutex_trylock(lruCache->lock) != 0) {
+    return 0;
+  }
+
+  canEvict = lruCache->head != NULL && lruCache->head != lruCache->tail;
+  if (canEvict) {
+    *priority = lruCache->head->priority;
+  }
+
+  if (lruCache->lock) {
+    pthread_mutex_unlock(lruCache->lock);
+  }
+  return canEvict;
+}
+
+static int LRUCache_evictOldest(void *cache) {
+  LRUCache *lruCache = cache;
+  int canEvict;
+
+  if (lruCache->lock && pthread_mutex_trylock(lruCache->lock) != 0) {
+    return 0;
+  }
+
+  canEvict = lruCache->head != NULL && lruCache->head != lruCache->tail;
+  if (canEvict) {
+    LRUCache_remove(lruCache, lruCache->head->key);
+  }
+
+  if (lruCache->lock) {
+    pthread_mutex_unlock(lruCache->lock);
+  }
+  return canEvict;
+}
+
 void LRUCacheElement_free(LRUCacheElement *ce) {
   if (ce->freeFunc) {
     ce->freeFunc(ce->val);
@@ -18,6 +18,7 @@
 #define __LRUCACHE_H__
 
 #include "StringHash.h"
+#include "CacheManager.h"
 #include <stdio.h>
 
 typedef struct LRUCacheStruct LRUCache;
@@ -31,6 +32,8 @@ struct LRUCacheStruct {
   StringHash *hash;
   LRUCacheElement *head;
   LRUCacheElement *tail;
+  CacheManagerClient *client;
+  pthread_mutex_t *lock;
 };
 
 struct LRUCacheElementStruct {
@@ -38,6 +41,7 @@ struct LRUCacheElementStruct {
   char *key;
   int nAccess;
   int size;
+  double priority;
   LRUCacheElement *prev;
   LRUCacheElement *next;
   LRUCache_FreeFunc freeFunc; 
@@ -50,6 +54,7 @@ void *LRUCache_get(LRUCache *cache, char *key);
 int LRUCache_put(LRUCache *cache, char *key, void *data, LRUCache_FreeFunc freeFunc, int size);
 void LRUCache_remove(LRUCache *cache, char *key);
 int LRUCache_getSize(LRUCache *cache, char *key);
+void LRUCache_setManager(LRUCache *cache, CacheManager *cm, char *name, double cost, pthread_mutex_t *lock);
 
 void LRUCacheElement_free(LRUCacheElement *ce);
 LRUCacheElement *LRUCacheElement_new(char *key, void *data, LRUCache_FreeFunc freeFunc, int size);
@@ -0,0 +1,251 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PackedSeq.h"
+#include "SeqUtil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char PackedSeq_bases[] = "ACGT";
+
+static PackedSeqRun *PackedSeq_makeRuns(char *seq, long length, int isMask, long *nRunP);
+static long PackedSeq_firstRunEndingAfter(PackedSeqRun *runs, long nRun, long pos);
+
+
+/*
+ Runs of non ACGT bases (isMask == 0) or of lower case bases (isMask == 1)
+*/
+static PackedSeqRun *PackedSeq_makeRuns(char *seq, long length, int isMask, long *nRunP) {
+  PackedSeqRun *runs = NULL;
+  long nAlloc = 0;
+  long nRun = 0;
+  long i;
+
+  for (i=0; i<length; i++) {
+    int inRun = isMask ? islower((unsigned char)seq[i]) : nucToIntArray[(unsigned char)seq[i]] < 0;
+    long c = isMask ? 0 : toupper((unsigned char)seq[i]);
+
+    if (!inRun) {
+      continue;
+    }
+
+    if (nRun > 0 && runs[nRun-1].end == i && runs[nRun-1].c == c) {
+      runs[nRun-1].end = i+1;
+    } else {
+      if (nRun == nAlloc) {
+        nAlloc = nAlloc ? nAlloc * 2 : 64;
+        if ((runs = (PackedSeqRun *)realloc(runs, nAlloc * sizeof(PackedSeqRun))) == NULL) {
+          fprintf(stderr,"ERROR: Failed reallocating PackedSeq runs\n");
+          exit(1);
+        }
+      }
+      runs[nRun].start = i+1;
+      runs[nRun].end   = i+1;
+      runs[nRun].c     = c;
+      nRun++;
+    }
+  }
+
+  *nRunP = nRun;
+  return runs;
+}
+
+/*
+ Writes seq to fileName, via a temporary file which is renamed into place so a
+ partly written file is never seen. Returns 0 on success.
+*/
+int PackedSeq_write(char *fileName, char *seq, long length) {
+  PackedSeqHeader header;
+  char tmpFileName[FILENAME_MAX];
+  unsigned char *bases;
+  long nByte = (length+3)/4;
+  long i;
+  FILE *fp;
+
+  memset(&header, 0, sizeof(PackedSeqHeader));
+  memcpy(header.magic, PACKEDSEQ_MAGIC, 8);
+  header.length = length;
+
+  long nOtherRun;
+  long nMaskRun;
+  PackedSeqRun *otherRuns = PackedSeq_makeRuns(seq, length, 0, &nOtherRun);
+  PackedSeqRun *maskRuns  = PackedSeq_makeRuns(seq, length, 1, &nMaskRun);
+  header.nOtherRun = nOtherRun;
+  header.nMaskRun  = nMaskRun;
+
+  if ((bases = (unsigned char *)calloc(nByte+1, sizeof(unsigned char))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating PackedSeq bases\n");
+    exit(1);
+  }
+  // Non ACGT bases are packed as A - they're replaced from the other runs on fetch
+  for (i=0; i<length; i++) {
+    int code = nucToIntArray[(unsigned char)seq[i]];
+    if (code > 0) {
+      bases[i>>2] |= code << (6 - 2*(i&3));
+    }
+  }
+
+  sprintf(tmpFileName, "%s.tmp%d", fileName, (int)getpid());
+  if ((fp = fopen(tmpFileName, "w")) == NULL) {
+    fprintf(stderr,"Failed opening packed sequence file %s for writing\n", tmpFileName);
+    free(otherRuns);
+    free(maskRuns);
+    free(bases);
+    return 1;
+  }
+
+  int ok = fwrite(&header, sizeof(PackedSeqHeader), 1, fp) == 1 &&
+           fwrite(otherRuns, sizeof(PackedSeqRun), nOtherRun, fp) == nOtherRun &&
+           fwrite(maskRuns, sizeof(PackedSeqRun), nMaskRun, fp) == nMaskRun &&
+           fwrite(bases, sizeof(unsigned char), nByte, fp) == nByte;
+
+  if (fclose(fp) != 0) {
+    ok = 0;
+  }
+  if (ok && rename(tmpFileName, fileName) != 0) {
+    ok = 0;
+  }
+  if (!ok) {
+    fprintf(stderr,"Failed writing packed sequence file %s\n", fileName);
+    unlink(tmpFileName);
+  }
+
+  free(otherRuns);
+  free(maskRuns);
+  free(bases);
+
+  return !ok;
+}
+
+/*
+ Returns NULL if fileName doesn't exist or isn't a valid packed sequence file
+*/
+PackedSeq *PackedSeq_open(char *fileName) {
+  PackedSeq *ps;
+  struct stat st;
+  int fd;
+
+  if ((fd = open(fileName, O_RDONLY)) < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st) != 0 || st.st_size < sizeof(PackedSeqHeader)) {
+    close(fd);
+    return NULL;
+  }
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+
+  PackedSeqHeader *header = (PackedSeqHeader *)map;
+  size_t expectedLen = sizeof(PackedSeqHeader) +
+                       (header->nOtherRun + header->nMaskRun) * sizeof(PackedSeqRun) +
+                       (header->length+3)/4;
+
+  if (memcmp(header->magic, PACKEDSEQ_MAGIC, 8) || expectedLen != st.st_size) {
+    fprintf(stderr,"Packed sequence file %s is not valid - ignoring it\n", fileName);
+    munmap(map, st.st_size);
+    return NULL;
+  }
+
+  if ((ps = (PackedSeq *)calloc(1,sizeof(PackedSeq))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating PackedSeq\n");
+    exit(1);
+  }
+  ps->map       = map;
+  ps->mapLen    = st.st_size;
+  ps->length    = header->length;
+  ps->otherRuns = (PackedSeqRun *)(header + 1);
+  ps->nOtherRun = header->nOtherRun;
+  ps->maskRuns  = ps->otherRuns + ps->nOtherRun;
+  ps->nMaskRun  = header->nMaskRun;
+  ps->bases     = (unsigned char *)(ps->maskRuns + ps->nMaskRun);
+
+  return ps;
+}
+
+static long PackedSeq_firstRunEndingAfter(PackedSeqRun *runs, long nRun, long pos) {
+  long lo = 0;
+  long hi = nRun;
+
+  while (lo < hi) {
+    long mid = (lo + hi) / 2;
+    if (runs[mid].end < pos) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/*
+ Puts length bases starting at start (1 based) into buf (which isn't '\0'
+ terminated). Any part of the range off the end of the sequence is filled
+ with N.
+*/
+void PackedSeq_fetch(PackedSeq *ps, long start, long length, char *buf) {
+  long end = start + length - 1;
+  long seqEnd = end < ps->length ? end : ps->length;
+  long pos;
+  long i;
+
+  for (pos=start; pos<=seqEnd; pos++) {
+    long ind = pos-1;
+    *buf++ = PackedSeq_bases[(ps->bases[ind>>2] >> (6 - 2*(ind&3))) & 3];
+  }
+  for (; pos<=end; pos++) {
+    *buf++ = 'N';
+  }
+  buf -= length;
+
+  for (i=PackedSeq_firstRunEndingAfter(ps->otherRuns, ps->nOtherRun, start);
+       i<ps->nOtherRun && ps->otherRuns[i].start <= seqEnd; i++) {
+    PackedSeqRun *run = &ps->otherRuns[i];
+    long runStart = run->start > start ? run->start : start;
+    long runEnd = run->end < seqEnd ? run->end : seqEnd;
+
+    memset(&buf[runStart-start], (int)run->c, runEnd-runStart+1);
+  }
+
+  for (i=PackedSeq_firstRunEndingAfter(ps->maskRuns, ps->nMaskRun, start);
+       i<ps->nMaskRun && ps->maskRuns[i].start <= seqEnd; i++) {
+    PackedSeqRun *run = &ps->maskRuns[i];
+    long runStart = run->start > start ? run->start : start;
+    long runEnd = run->end < seqEnd ? run->end : seqEnd;
+
+    for (pos=runStart; pos<=runEnd; pos++) {
+      buf[pos-start] = tolower((unsigned char)buf[pos-start]);
+    }
+  }
+}
+
+void PackedSeq_close(PackedSeq *ps) {
+  if (ps == NULL) {
+    return;
+  }
+  munmap(ps->map, ps->mapLen);
+  free(ps);
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PACKEDSEQ_H__
+#define __PACKEDSEQ_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ A DNA sequence stored 2 bits per base in a file which is mapped read only,
+ so sub sequences are decoded straight from the page cache.
+
+ Bases which aren't A, C, G or T (N and other IUPAC codes) are stored as runs
+ of the same character in a side table, as are soft masked (lower case)
+ regions, so any sequence round trips exactly. File layout, in native byte
+ order:
+
+   PackedSeqHeader
+   nOtherRun PackedSeqRuns (the base is in the run's c)
+   nMaskRun PackedSeqRuns
+   (length+3)/4 bytes of packed bases, first base in the high bits
+
+ Runs are sorted on start and don't overlap. Coords are 1 based.
+*/
+
+#define PACKEDSEQ_MAGIC "ENSC2BIT"
+
+typedef struct PackedSeqHeaderStruct {
+  char    magic[8];
+  int64_t length;
+  int64_t nOtherRun;
+  int64_t nMaskRun;
+} PackedSeqHeader;
+
+typedef struct PackedSeqRunStruct {
+  int64_t start;
+  int64_t end;
+  int64_t c;
+} PackedSeqRun;
+
+typedef struct PackedSeqStruct {
+  void *map;
+  size_t mapLen;
+  long length;
+  PackedSeqRun *otherRuns;
+  long nOtherRun;
+  PackedSeqRun *maskRuns;
+  long nMaskRun;
+  unsigned char *bases;
+} PackedSeq;
+
+int        PackedSeq_write(char *fileName, char *seq, long length);
+PackedSeq *PackedSeq_open(char *fileName);
+void       PackedSeq_fetch(PackedSeq *ps, long start, long length, char *buf);
+void       PackedSeq_close(PackedSeq *ps);
+
+#define PackedSeq_getLength(ps) (ps)->length
+
+#endif
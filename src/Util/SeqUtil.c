@@ -26,67 +26,220 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+/*
+ Complement of each character, case preserved, covering the IUPAC codes.
+ 0 means the character can't be complemented.
+*/
+static const char compTable[256] = {
+  ['A'] = 'T', ['C'] = 'G', ['G'] = 'C', ['T'] = 'A', ['U'] = 'A', ['N'] = 'N',
+  ['R'] = 'Y', ['Y'] = 'R', ['M'] = 'K', ['K'] = 'M', ['S'] = 'S', ['W'] = 'W',
+  ['B'] = 'V', ['V'] = 'B', ['D'] = 'H', ['H'] = 'D', ['X'] = 'X',
+  ['a'] = 't', ['c'] = 'g', ['g'] = 'c', ['t'] = 'a', ['u'] = 'a', ['n'] = 'n',
+  ['r'] = 'y', ['y'] = 'r', ['m'] = 'k', ['k'] = 'm', ['s'] = 's', ['w'] = 'w',
+  ['b'] = 'v', ['v'] = 'b', ['d'] = 'h', ['h'] = 'd', ['x'] = 'x',
+  ['-'] = '-', ['.'] = '.', ['*'] = '*', ['~'] = '~'
+};
+
+/*
+ Complement of a byte holding two 4 bit (BAM nt16) coded bases, with the
+ two bases swapped over
+*/
+static const uint8_t nt16PairCompTable[256] = {
+  0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x90, 0xe0, 0x10, 0x60, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
+  0x08, 0x88, 0x48, 0xc8, 0x28, 0xa8, 0x98, 0xe8, 0x18, 0x68, 0x58, 0xd8, 0x38, 0xb8, 0x78, 0xf8,
+  0x04, 0x84, 0x44, 0xc4, 0x24, 0xa4, 0x94, 0xe4, 0x14, 0x64, 0x54, 0xd4, 0x34, 0xb4, 0x74, 0xf4,
+  0x0c, 0x8c, 0x4c, 0xcc, 0x2c, 0xac, 0x9c, 0xec, 0x1c, 0x6c, 0x5c, 0xdc, 0x3c, 0xbc, 0x7c, 0xfc,
+  0x02, 0x82, 0x42, 0xc2, 0x22, 0xa2, 0x92, 0xe2, 0x12, 0x62, 0x52, 0xd2, 0x32, 0xb2, 0x72, 0xf2,
+  0x0a, 0x8a, 0x4a, 0xca, 0x2a, 0xaa, 0x9a, 0xea, 0x1a, 0x6a, 0x5a, 0xda, 0x3a, 0xba, 0x7a, 0xfa,
+  0x09, 0x89, 0x49, 0xc9, 0x29, 0xa9, 0x99, 0xe9, 0x19, 0x69, 0x59, 0xd9, 0x39, 0xb9, 0x79, 0xf9,
+  0x0e, 0x8e, 0x4e, 0xce, 0x2e, 0xae, 0x9e, 0xee, 0x1e, 0x6e, 0x5e, 0xde, 0x3e, 0xbe, 0x7e, 0xfe,
+  0x01, 0x81, 0x41, 0xc1, 0x21, 0xa1, 0x91, 0xe1, 0x11, 0x61, 0x51, 0xd1, 0x31, 0xb1, 0x71, 0xf1,
+  0x06, 0x86, 0x46, 0xc6, 0x26, 0xa6, 0x96, 0xe6, 0x16, 0x66, 0x56, 0xd6, 0x36, 0xb6, 0x76, 0xf6,
+  0x05, 0x85, 0x45, 0xc5, 0x25, 0xa5, 0x95, 0xe5, 0x15, 0x65, 0x55, 0xd5, 0x35, 0xb5, 0x75, 0xf5,
+  0x0d, 0x8d, 0x4d, 0xcd, 0x2d, 0xad, 0x9d, 0xed, 0x1d, 0x6d, 0x5d, 0xdd, 0x3d, 0xbd, 0x7d, 0xfd,
+  0x03, 0x83, 0x43, 0xc3, 0x23, 0xa3, 0x93, 0xe3, 0x13, 0x63, 0x53, 0xd3, 0x33, 0xb3, 0x73, 0xf3,
+  0x0b, 0x8b, 0x4b, 0xcb, 0x2b, 0xab, 0x9b, 0xeb, 0x1b, 0x6b, 0x5b, 0xdb, 0x3b, 0xbb, 0x7b, 0xfb,
+  0x07, 0x87, 0x47, 0xc7, 0x27, 0xa7, 0x97, 0xe7, 0x17, 0x67, 0x57, 0xd7, 0x37, 0xb7, 0x77, 0xf7,
+  0x0f, 0x8f, 0x4f, 0xcf, 0x2f, 0xaf, 0x9f, 0xef, 0x1f, 0x6f, 0x5f, 0xdf, 0x3f, 0xbf, 0x7f, 0xff
+};
+
+#if defined(__AVX2__)
+/*
+ Reverse complements a 32 byte block if it's only ACGTN (either case).
+ Returns 0, leaving out untouched, if it isn't. For those characters the
+ complement is an xor of the character with a value which depends only on
+ its low nibble (0x15 swaps A and T, 0x04 swaps C and G, 0 keeps N), which
+ keeps the case bit and can be looked up with a byte shuffle.
+*/
+static int revCompBlock32(const char *in, char *out) {
+  const __m256i caseMask = _mm256_set1_epi8((char)0xDF);
+  const __m256i xorTable = _mm256_setr_epi8(0, 0x15, 0, 0x04, 0x15, 0, 0, 0x04, 0, 0, 0, 0, 0, 0, 0, 0,
+                                            0, 0x15, 0, 0x04, 0x15, 0, 0, 0x04, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i revIndex = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                            15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+  __m256i c = _mm256_loadu_si256((const __m256i *)in);
+  __m256i u = _mm256_and_si256(c, caseMask);
+  __m256i valid = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(u, _mm256_set1_epi8('A')),
+                                    _mm256_cmpeq_epi8(u, _mm256_set1_epi8('C'))),
+                    _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(u, _mm256_set1_epi8('G')),
+                                                    _mm256_cmpeq_epi8(u, _mm256_set1_epi8('T'))),
+                                    _mm256_cmpeq_epi8(u, _mm256_set1_epi8('N'))));
+
+  if (_mm256_movemask_epi8(valid) != -1) {
+    return 0;
+  }
+
+  __m256i comp = _mm256_xor_si256(c, _mm256_shuffle_epi8(xorTable, _mm256_and_si256(c, _mm256_set1_epi8(0x0F))));
+  // Shuffles are within 128 bit lanes so reverse each lane then swap the lanes
+  __m256i rev = _mm256_shuffle_epi8(comp, revIndex);
+  _mm256_storeu_si256((__m256i *)out, _mm256_permute2x128_si256(rev, rev, 0x01));
+
+  return 1;
+}
+#define SEQUTIL_REVCOMP_BLOCK 32
+#define revCompBlock revCompBlock32
+
+#elif defined(__SSSE3__)
+/*
+ Reverse complements a 16 byte block if it's only ACGTN (either case) - see
+ revCompBlock32 for how
+*/
+static int revCompBlock16(const char *in, char *out) {
+  const __m128i caseMask = _mm_set1_epi8((char)0xDF);
+  const __m128i xorTable = _mm_setr_epi8(0, 0x15, 0, 0x04, 0x15, 0, 0, 0x04, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i revIndex = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+  __m128i c = _mm_loadu_si128((const __m128i *)in);
+  __m128i u = _mm_and_si128(c, caseMask);
+  __m128i valid = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(u, _mm_set1_epi8('A')),
+                                 _mm_cmpeq_epi8(u, _mm_set1_epi8('C'))),
+                    _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(u, _mm_set1_epi8('G')),
+                                              _mm_cmpeq_epi8(u, _mm_set1_epi8('T'))),
+                                 _mm_cmpeq_epi8(u, _mm_set1_epi8('N'))));
+
+  if (_mm_movemask_epi8(valid) != 0xFFFF) {
+    return 0;
+  }
+
+  __m128i comp = _mm_xor_si128(c, _mm_shuffle_epi8(xorTable, _mm_and_si128(c, _mm_set1_epi8(0x0F))));
+  _mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(comp, revIndex));
+
+  return 1;
+}
+#define SEQUTIL_REVCOMP_BLOCK 16
+#define revCompBlock revCompBlock16
+#endif
+
+static char *reverseComplementImpl(char *seqStr, int lenSeqStr, char invalidChar);
+
+/*
+ Reverse complements seqStr in place, keeping the case of each base (so soft
+ masking survives) and complementing IUPAC ambiguity codes. Returns NULL if
+ seqStr contains a character which can't be complemented.
+*/
 char *SeqUtil_reverseComplement(char *seqStr, int lenSeqStr) {
-  int i;
+  return reverseComplementImpl(seqStr, lenSeqStr, 0);
+}
+
+/*
+ As SeqUtil_reverseComplement, but characters which can't be complemented
+ are replaced by invalidChar rather than failing
+*/
+char *SeqUtil_reverseComplementMarkInvalid(char *seqStr, int lenSeqStr, char invalidChar) {
+  return reverseComplementImpl(seqStr, lenSeqStr, invalidChar);
+}
 
-  StrUtil_reverseString(seqStr,lenSeqStr);
-
-  for (i=0;i<lenSeqStr;i++) {
-    switch (toupper(seqStr[i])) {
-      case 'A':
-        seqStr[i]='T';
-        break;
-      case 'C':
-        seqStr[i]='G';
-        break;
-      case 'G':
-        seqStr[i]='C';
-        break;
-      case 'T':
-        seqStr[i]='A';
-        break;
-      case 'N':
-        seqStr[i]='N';
-        break;
-      case 'R':
-        seqStr[i]='Y';
-        break;
-      case 'Y':
-        seqStr[i]='R';
-        break;
-      case 'M':
-        seqStr[i]='K';
-        break;
-      case 'K':
-        seqStr[i]='M';
-        break;
-      case 'S':
-        seqStr[i]='W';
-        break;
-      case 'W':
-        seqStr[i]='S';
-        break;
-      case 'H':
-        seqStr[i]='D';
-        break;
-      case 'D':
-        seqStr[i]='H';
-        break;
-      case 'B':
-        seqStr[i]='V';
-        break;
-      case 'V':
-        seqStr[i]='B';
-        break;
-      default:
-        fprintf(stderr,"ERROR: Failed reverse complementing char = %c\n", seqStr[i]);
-        return NULL;
+/*
+ Works in from both ends at once, a block at a time when built with SSSE3 or
+ AVX2, falling back to the table for blocks containing anything other than
+ ACGTN. An invalidChar of 0 means fail on characters which can't be
+ complemented.
+*/
+static char *reverseComplementImpl(char *seqStr, int lenSeqStr, char invalidChar) {
+  char *lo = seqStr;
+  char *hi = seqStr + lenSeqStr - 1;
+
+#ifdef SEQUTIL_REVCOMP_BLOCK
+  while (hi - lo + 1 >= 2 * SEQUTIL_REVCOMP_BLOCK) {
+    char loBlock[SEQUTIL_REVCOMP_BLOCK];
+    char *hiStart = hi - SEQUTIL_REVCOMP_BLOCK + 1;
+
+    if (revCompBlock(lo, loBlock) && revCompBlock(hiStart, lo)) {
+      memcpy(hiStart, loBlock, SEQUTIL_REVCOMP_BLOCK);
+      lo += SEQUTIL_REVCOMP_BLOCK;
+      hi -= SEQUTIL_REVCOMP_BLOCK;
+    } else {
+      // Do this pair of blocks (which are untouched if revCompBlock failed) with the table
+      int i;
+      for (i=0; i<SEQUTIL_REVCOMP_BLOCK; i++, lo++, hi--) {
+        char loComp = compTable[(unsigned char)*lo];
+        char hiComp = compTable[(unsigned char)*hi];
+        if (invalidChar) {
+          if (!loComp) loComp = invalidChar;
+          if (!hiComp) hiComp = invalidChar;
+        } else if (!loComp || !hiComp) {
+          fprintf(stderr,"ERROR: Failed reverse complementing char = %c\n", loComp ? *hi : *lo);
+          return NULL;
+        }
+        *lo = hiComp;
+        *hi = loComp;
+      }
     }
   }
+#endif
+
+  while (lo <= hi) {
+    char loComp = compTable[(unsigned char)*lo];
+    char hiComp = compTable[(unsigned char)*hi];
+    if (invalidChar) {
+      if (!loComp) loComp = invalidChar;
+      if (!hiComp) hiComp = invalidChar;
+    } else if (!loComp || !hiComp) {
+      fprintf(stderr,"ERROR: Failed reverse complementing char = %c\n", loComp ? *hi : *lo);
+      return NULL;
+    }
+    *lo++ = hiComp;
+    *hi-- = loComp;
+  }
   
   return seqStr;
 }
 
+/*
+ Reverse complements lenSeq bases of BAM style 4 bit coded sequence (two
+ bases per byte, first in the high nibble) in place
+*/
+void SeqUtil_reverseComplementNt16(uint8_t *seq, int lenSeq) {
+  int nByte = (lenSeq+1)/2;
+  int i;
+
+  for (i=0; i<nByte/2; i++) {
+    uint8_t tmp = nt16PairCompTable[seq[i]];
+    seq[i] = nt16PairCompTable[seq[nByte-1-i]];
+    seq[nByte-1-i] = tmp;
+  }
+  if (nByte & 1) {
+    seq[nByte/2] = nt16PairCompTable[seq[nByte/2]];
+  }
+
+  // For odd lengths the empty low nibble of the last byte is now at the start, so shift it out
+  if (lenSeq & 1) {
+    for (i=0; i<nByte-1; i++) {
+      seq[i] = (seq[i] << 4) | (seq[i+1] >> 4);
+    }
+    seq[nByte-1] <<= 4;
+  }
+}
+
 char *SeqUtil_addGaps(char *seq, int length) {
   return SeqUtil_addRes(seq,length,'-');
 }
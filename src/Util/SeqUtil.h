@@ -19,8 +19,11 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
 
 char *SeqUtil_reverseComplement(char *seq, int len);
+char *SeqUtil_reverseComplementMarkInvalid(char *seq, int len, char invalidChar);
+void SeqUtil_reverseComplementNt16(uint8_t *seq, int lenSeq);
 char *SeqUtil_addNs(char *seq, int length);
 char *SeqUtil_addGaps(char *seq, int length);
 char *SeqUtil_addRes(char *seq, int length, char res);
@@ -0,0 +1,170 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StrBuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+StrBuf *StrBuf_new(size_t initialSize) {
+  StrBuf *sb;
+
+  if ((sb = (StrBuf *)calloc(1,sizeof(StrBuf))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating StrBuf\n");
+    exit(1);
+  }
+
+  sb->nAlloc = initialSize > 0 ? initialSize : STRBUF_DEFAULTSIZE;
+  if ((sb->str = (char *)malloc(sb->nAlloc)) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating StrBuf string\n");
+    exit(1);
+  }
+  sb->str[0] = '\0';
+
+  return sb;
+}
+
+/*
+ Makes room for nExtra more characters (plus the terminating '\0')
+*/
+void StrBuf_reserve(StrBuf *sb, size_t nExtra) {
+  size_t needed = sb->len + nExtra + 1;
+
+  if (needed <= sb->nAlloc) {
+    return;
+  }
+  while (sb->nAlloc < needed) {
+    sb->nAlloc *= 2;
+  }
+  if ((sb->str = (char *)realloc(sb->str, sb->nAlloc)) == NULL) {
+    fprintf(stderr,"ERROR: Failed reallocating StrBuf string\n");
+    exit(1);
+  }
+}
+
+void StrBuf_appendN(StrBuf *sb, const char *str, size_t len) {
+  StrBuf_reserve(sb, len);
+  memcpy(&sb->str[sb->len], str, len);
+  sb->len += len;
+  sb->str[sb->len] = '\0';
+}
+
+void StrBuf_append(StrBuf *sb, const char *str) {
+  StrBuf_appendN(sb, str, strlen(str));
+}
+
+void StrBuf_appendChar(StrBuf *sb, char ch) {
+  StrBuf_reserve(sb, 1);
+  sb->str[sb->len++] = ch;
+  sb->str[sb->len] = '\0';
+}
+
+void StrBuf_appendLongLong(StrBuf *sb, long long val) {
+  char digits[24];
+  int nDigit = 0;
+  // Negate as unsigned so LLONG_MIN works
+  unsigned long long uval = val < 0 ? -(unsigned long long)val : (unsigned long long)val;
+
+  do {
+    digits[nDigit++] = '0' + (uval % 10);
+    uval /= 10;
+  } while (uval);
+
+  StrBuf_reserve(sb, nDigit + 1);
+  if (val < 0) {
+    sb->str[sb->len++] = '-';
+  }
+  while (nDigit) {
+    sb->str[sb->len++] = digits[--nDigit];
+  }
+  sb->str[sb->len] = '\0';
+}
+
+void StrBuf_appendLong(StrBuf *sb, long val) {
+  StrBuf_appendLongLong(sb, val);
+}
+
+void StrBuf_vappendf(StrBuf *sb, const char *format, va_list args) {
+  va_list argsCopy;
+  int nChar;
+
+  // Try in the space there is, and if it didn't fit grow to the size vsnprintf said it needed
+  va_copy(argsCopy, args);
+  nChar = vsnprintf(&sb->str[sb->len], sb->nAlloc - sb->len, format, argsCopy);
+  va_end(argsCopy);
+
+  if (nChar < 0) {
+    fprintf(stderr,"ERROR: vsnprintf failed in StrBuf_vappendf for format %s\n", format);
+    exit(1);
+  }
+
+  if (sb->len + nChar >= sb->nAlloc) {
+    StrBuf_reserve(sb, nChar);
+    vsnprintf(&sb->str[sb->len], sb->nAlloc - sb->len, format, args);
+  }
+  sb->len += nChar;
+}
+
+void StrBuf_appendf(StrBuf *sb, const char *format, ...) {
+  va_list args;
+
+  va_start(args, format);
+  StrBuf_vappendf(sb, format, args);
+  va_end(args);
+}
+
+/*
+ Appends ids separated by ", " - the body of an IN list
+*/
+void StrBuf_appendIDList(StrBuf *sb, IDType *ids, int nId) {
+  int i;
+
+  for (i=0; i<nId; i++) {
+    if (i) {
+      StrBuf_appendN(sb, ", ", 2);
+    }
+    StrBuf_appendID(sb, ids[i]);
+  }
+}
+
+/*
+ Shortens the string to len characters (no effect if it's already that short)
+*/
+void StrBuf_truncate(StrBuf *sb, size_t len) {
+  if (len < sb->len) {
+    sb->len = len;
+    sb->str[len] = '\0';
+  }
+}
+
+/*
+ Frees sb but not its string, which is returned and is the caller's to free
+*/
+char *StrBuf_detach(StrBuf *sb) {
+  char *str = sb->str;
+
+  free(sb);
+  return str;
+}
+
+void StrBuf_free(StrBuf *sb) {
+  if (sb == NULL) {
+    return;
+  }
+  free(sb->str);
+  free(sb);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __STRBUF_H__
+#define __STRBUF_H__
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#include "EnsC.h"
+
+/*
+ Growable string for building SQL. Appends are amortised constant time (the
+ buffer doubles when it fills) and nothing is zeroed, so a builder can start
+ small and be cleared and reused for the next statement. The string is always
+ '\0' terminated.
+
+ Integers are formatted directly rather than through sprintf, as they make up
+ most of a long IN list.
+*/
+
+typedef struct StrBufStruct {
+  char  *str;
+  size_t len;
+  size_t nAlloc;
+} StrBuf;
+
+#define STRBUF_DEFAULTSIZE 1024
+
+StrBuf *StrBuf_new(size_t initialSize);
+void    StrBuf_reserve(StrBuf *sb, size_t nExtra);
+void    StrBuf_appendN(StrBuf *sb, const char *str, size_t len);
+void    StrBuf_append(StrBuf *sb, const char *str);
+void    StrBuf_appendChar(StrBuf *sb, char ch);
+void    StrBuf_appendLong(StrBuf *sb, long val);
+void    StrBuf_appendLongLong(StrBuf *sb, long long val);
+void    StrBuf_appendf(StrBuf *sb, const char *format, ...);
+void    StrBuf_vappendf(StrBuf *sb, const char *format, va_list args);
+void    StrBuf_appendIDList(StrBuf *sb, IDType *ids, int nId);
+void    StrBuf_truncate(StrBuf *sb, size_t len);
+char   *StrBuf_detach(StrBuf *sb);
+void    StrBuf_free(StrBuf *sb);
+
+#define StrBuf_appendID(sb, id) StrBuf_appendLongLong((sb), (long long)(id))
+#define StrBuf_clear(sb) StrBuf_truncate((sb), 0)
+#define StrBuf_getString(sb) (sb)->str
+#define StrBuf_getLength(sb) (sb)->len
+
+#endif
@@ -16,6 +16,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "StringHash.h"
 #include "StrUtil.h"
@@ -23,17 +24,46 @@
 
 #include "ProcUtil.h"
 
+// Grow once more than MAXLOAD_NUM/MAXLOAD_DEN of the slots are in use
+#define STRINGHASH_MAXLOAD_NUM 4
+#define STRINGHASH_MAXLOAD_DEN 5
+// Longest probe length a slot can record, before the table is grown instead
+#define STRINGHASH_MAXPROBELEN 255
 
-unsigned int StringHash_getBucketNum(StringHash *stringHash, char *key, int keyLen) {
-  unsigned int hash, i;
-  unsigned int hashCode;
+static int  StringHash_findSlot(StringHash *stringHash, char *key, int keyLen, unsigned int hash);
+static void StringHash_insert(StringHash *stringHash, KeyValuePair *kvp);
+static void StringHash_resize(StringHash *stringHash, int newSize);
 
-  for (hash=keyLen, i=0; i<keyLen; ++i) {
-    hash = (hash<<5)^(hash>>27)^key[i];
+
+static inline uint64_t StringHash_mix(uint64_t a, uint64_t b) {
+  __uint128_t r = (__uint128_t)a * b;
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+/*
+ Multiply-fold hash (as used by wyhash), reading the key 8 bytes at a time
+*/
+unsigned long long StringHash_hashKey(char *key, int keyLen) {
+  const uint64_t p0 = 0xa0761d6478bd642fULL;
+  const uint64_t p1 = 0xe7037ed1a0b428dbULL;
+  const uint64_t p2 = 0x8ebc6af09c88c6e3ULL;
+  const unsigned char *chP = (const unsigned char *)key;
+  uint64_t hash = p0 ^ (uint64_t)keyLen;
+  uint64_t word;
+  int nLeft = keyLen;
+
+  while (nLeft >= 8) {
+    memcpy(&word, chP, 8);
+    hash = StringHash_mix(hash ^ word, p1);
+    chP   += 8;
+    nLeft -= 8;
   }
-  hashCode = (hash%stringHash->size);
 
-  return hashCode;
+  word = 0;
+  memcpy(&word, chP, nLeft);
+  hash = StringHash_mix(hash ^ word ^ p2, p1 ^ (uint64_t)keyLen);
+
+  return StringHash_mix(hash, p2);
 }
 
 StringHash *StringHash_new(StringHashSizes size) {
@@ -44,37 +74,151 @@ StringHash *StringHash_new(StringHashSizes size) {
     return NULL;
   }
 
+  // Only starting sizes now as the table grows as needed
   switch (size) {
     case STRINGHASH_SMALL:
-      stringHash->size = 257; 
+      stringHash->size = 16; 
       break;
     case STRINGHASH_LARGE:
-      stringHash->size = 104711; 
+      stringHash->size = 4096; 
       break;
     case STRINGHASH_HUGE:
-      stringHash->size = 1000039; 
+      stringHash->size = 65536; 
       break;
     case STRINGHASH_MEDIUM:
     default:
-      stringHash->size = 32353; 
+      stringHash->size = 256; 
   }
 
-  if ((stringHash->buckets = (KeyValuePair **)calloc(stringHash->size,sizeof(KeyValuePair *))) == NULL) {
-    fprintf(stderr,"ERROR: Failed allocating space for stringHash->buckets\n");
+  if ((stringHash->slots = (KeyValuePair *)calloc(stringHash->size,sizeof(KeyValuePair))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating space for stringHash->slots\n");
     return NULL;
   }
 
-  if ((stringHash->bucketCounts = (int *)calloc(stringHash->size,sizeof(int))) == NULL) {
-    fprintf(stderr,"ERROR: Failed allocating space for stringHash->bucketCounts\n");
+  if ((stringHash->probeLens = (unsigned char *)calloc(stringHash->size,sizeof(unsigned char))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating space for stringHash->probeLens\n");
     return NULL;
   }
 
   return stringHash;
 }
 
+/*
+ Makes room for nValue keys in total, so adding up to that many doesn't
+ have to grow the table step by step
+*/
+void StringHash_reserve(StringHash *stringHash, int nValue) {
+  long newSize = stringHash->size;
+
+  while (nValue * (long)STRINGHASH_MAXLOAD_DEN > newSize * STRINGHASH_MAXLOAD_NUM) {
+    newSize *= 2;
+  }
+  if (newSize != stringHash->size) {
+    StringHash_resize(stringHash, newSize);
+  }
+}
+
+static void StringHash_resize(StringHash *stringHash, int newSize) {
+  KeyValuePair  *oldSlots     = stringHash->slots;
+  unsigned char *oldProbeLens = stringHash->probeLens;
+  int            oldSize      = stringHash->size;
+  int i;
+
+  if ((stringHash->slots = (KeyValuePair *)calloc(newSize,sizeof(KeyValuePair))) == NULL ||
+      (stringHash->probeLens = (unsigned char *)calloc(newSize,sizeof(unsigned char))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating space for resized stringHash\n");
+    exit(1);
+  }
+  stringHash->size = newSize;
+
+  for (i=0; i<oldSize; i++) {
+    if (oldProbeLens[i]) {
+      StringHash_insert(stringHash, &oldSlots[i]);
+    }
+  }
+
+  free(oldSlots);
+  free(oldProbeLens);
+}
+
+/*
+ Puts kvp (whose key mustn't already be in the hash) into the table, moving
+ along any entries it passes which are nearer their home slot than it is
+*/
+static void StringHash_insert(StringHash *stringHash, KeyValuePair *kvp) {
+  KeyValuePair cur = *kvp;
+  int mask = stringHash->size - 1;
+  int slot = cur.hash & mask;
+  int probeLen = 1;
+
+  while (stringHash->probeLens[slot]) {
+    if (stringHash->probeLens[slot] < probeLen) {
+      KeyValuePair tmp = stringHash->slots[slot];
+      int tmpProbeLen = stringHash->probeLens[slot];
+
+      stringHash->slots[slot]     = cur;
+      stringHash->probeLens[slot] = probeLen;
+      cur      = tmp;
+      probeLen = tmpProbeLen;
+    }
+    slot = (slot + 1) & mask;
+    probeLen++;
+
+    if (probeLen == STRINGHASH_MAXPROBELEN) {
+      // Very unlikely with a decent hash, but the probe length can't be stored
+      StringHash_resize(stringHash, stringHash->size * 2);
+      StringHash_insert(stringHash, &cur);
+      return;
+    }
+  }
+
+  stringHash->slots[slot]     = cur;
+  stringHash->probeLens[slot] = probeLen;
+}
+
+// Returns the slot holding key, or -1 if it isn't there
+static int StringHash_findSlot(StringHash *stringHash, char *key, int keyLen, unsigned int hash) {
+  int mask = stringHash->size - 1;
+  int slot = hash & mask;
+  int probeLen = 1;
+
+  // Once an entry is nearer its home than key would be, key can't be further on
+  while (stringHash->probeLens[slot] >= probeLen) {
+    KeyValuePair *kvp = &stringHash->slots[slot];
+    if (kvp->hash == hash && kvp->keyLen == keyLen && !memcmp(kvp->key, key, keyLen)) {
+      return slot;
+    }
+    slot = (slot + 1) & mask;
+    probeLen++;
+  }
+
+  return -1;
+}
+
+/*
+ Steps through the entries without copying anything. Start with *iterP = 0;
+ returns 0 when there are no more.
+   int iter = 0;
+   while (StringHash_next(hash, &iter, &key, &val)) { ... }
+*/
+int StringHash_next(StringHash *stringHash, int *iterP, char **keyP, void **valP) {
+  int i;
+
+  for (i=*iterP; i<stringHash->size; i++) {
+    if (stringHash->probeLens[i]) {
+      if (keyP) *keyP = stringHash->slots[i].key;
+      if (valP) *valP = stringHash->slots[i].value;
+      *iterP = i+1;
+      return 1;
+    }
+  }
+  *iterP = stringHash->size;
+
+  return 0;
+}
+
 char **StringHash_getKeys(StringHash *stringHash) {
   int i;
-  int j;
   char **keys;
   int keyCnt = 0;
 
@@ -89,10 +233,8 @@ char **StringHash_getKeys(StringHash *stringHash) {
   }
 
   for (i=0; i<stringHash->size; i++) {
-    if (stringHash->bucketCounts[i]) {
-      for (j=0; j<stringHash->bucketCounts[i]; j++) {
-        StrUtil_copyString(&(keys[keyCnt++]),stringHash->buckets[i][j].key,0);
-      }
+    if (stringHash->probeLens[i]) {
+      StrUtil_copyString(&(keys[keyCnt++]),stringHash->slots[i].key,0);
     }
   }
   if (keyCnt != stringHash->nValue) {
@@ -104,7 +246,6 @@ char **StringHash_getKeys(StringHash *stringHash) {
 
 char **StringHash_getKeysNoCopy(StringHash *stringHash) {
   int i;
-  int j;
   char **keys;
   int keyCnt = 0;
 
@@ -119,10 +260,8 @@ char **StringHash_getKeysNoCopy(StringHash *stringHash) {
   }
 
   for (i=0; i<stringHash->size; i++) {
-    if (stringHash->bucketCounts[i]) {
-      for (j=0; j<stringHash->bucketCounts[i]; j++) {
-        keys[keyCnt++] = stringHash->buckets[i][j].key;
-      }
+    if (stringHash->probeLens[i]) {
+      keys[keyCnt++] = stringHash->slots[i].key;
     }
   }
   if (keyCnt != stringHash->nValue) {
@@ -140,7 +279,6 @@ int StringHash_getNumValues(StringHash *stringHash) {
 
 void *StringHash_getValues(StringHash *stringHash) {
   int i;
-  int j;
   void **values;
   int valCnt = 0;
   
@@ -154,10 +292,8 @@ void *StringHash_getValues(StringHash *stringHash) {
   }
 
   for (i=0; i<stringHash->size; i++) {
-    if (stringHash->bucketCounts[i]) {
-      for (j=0; j<stringHash->bucketCounts[i]; j++) {
-        values[valCnt++] = stringHash->buckets[i][j].value;
-      }
+    if (stringHash->probeLens[i]) {
+      values[valCnt++] = stringHash->slots[i].value;
     }
   }
   if (valCnt != stringHash->nValue) {
@@ -167,208 +303,167 @@ void *StringHash_getValues(StringHash *stringHash) {
 }
 
 void StringHash_printHashStats(StringHash *stringHash, char *hashDesc) {
-  int nOccupiedBuckets = 0;
-  int nMultipleOccupied = 0;
-  int maxInBucket = 0;
+  int nDisplaced = 0;
+  int maxProbeLen = 0;
+  long totProbeLen = 0;
   int nValues = 0;
 
   int i;
   for (i=0; i<stringHash->size; i++) {
-    if (stringHash->bucketCounts[i]) {
-      nOccupiedBuckets++;
-      if (stringHash->bucketCounts[i] > 1) {
-        nMultipleOccupied++;
+    int probeLen = stringHash->probeLens[i];
+    if (probeLen) {
+      nValues++;
+      totProbeLen += probeLen;
+      if (probeLen > 1) {
+        nDisplaced++;
       }
-      if (stringHash->bucketCounts[i] > maxInBucket) {
-        maxInBucket = stringHash->bucketCounts[i];
+      if (probeLen > maxProbeLen) {
+        maxProbeLen = probeLen;
       }
-      nValues += stringHash->bucketCounts[i];
     }
   }
 
   fprintf(stderr, "\nString Hash statistics for %s hash\n", hashDesc);
-  fprintf(stderr, "   Size of hash (number of buckets)    = %d\n", stringHash->size);
+  fprintf(stderr, "   Size of hash (number of slots)      = %d\n", stringHash->size);
   fprintf(stderr, "   Number of values stored             = %d\n", nValues);
   fprintf(stderr, "   Load factor                         = %f\n", (float)nValues/(float)stringHash->size);
-  fprintf(stderr, "   Number of buckets used              = %d\n", nOccupiedBuckets);
-  fprintf(stderr, "   Number of multiply occupied buckets = %d\n", nMultipleOccupied);
-  fprintf(stderr, "   Max num value in a single bucket    = %d\n\n", maxInBucket);
+  fprintf(stderr, "   Number not in their home slot       = %d\n", nDisplaced);
+  fprintf(stderr, "   Mean probe length                   = %f\n", nValues ? (float)totProbeLen/(float)nValues : 0.0);
+  fprintf(stderr, "   Max probe length                    = %d\n\n", maxProbeLen);
 }
 
 void *StringHash_getValue(StringHash *stringHash, char *key) {
   int keyLen = strlen(key);
-  int bucketNum = StringHash_getBucketNum(stringHash,key,keyLen);
-  int i;
-
-  for (i=0; i<stringHash->bucketCounts[bucketNum]; i++) {
-    
-    if (keyLen == stringHash->buckets[bucketNum][i].keyLen) {
-      //fprintf(stderr,"equal keylen %d %d\n",keyLen, stringHash->buckets[bucketNum][i].keyLen);
-      if (!memcmp(key, stringHash->buckets[bucketNum][i].key,keyLen)) {
-      //if (!strcmp(key, stringHash->buckets[bucketNum][i].key)) {
-        return stringHash->buckets[bucketNum][i].value;
-      }
-    }
-  }
+  int slot = StringHash_findSlot(stringHash, key, keyLen, StringHash_hashKey(key, keyLen));
 
+  if (slot < 0) {
 //  fprintf(stderr,"ERROR: Didn't find key %s in StringHash\n",key);
-  //fprintf(stderr,"keylen %d\n",keyLen);
-  //for (i=0; i<stringHash->bucketCounts[bucketNum]; i++) {
-  //  fprintf(stderr,"bucket key %s keylen %d\n",stringHash->buckets[bucketNum][i].key, stringHash->buckets[bucketNum][i].keyLen);
-  //}
-  return NULL;
+    return NULL;
+  }
+  return stringHash->slots[slot].value;
 }
 
 int StringHash_contains(StringHash *stringHash, char *key) {
   int keyLen = strlen(key);
-  int bucketNum = StringHash_getBucketNum(stringHash,key, keyLen);
-  int i;
-
-  for (i=0; i<stringHash->bucketCounts[bucketNum]; i++) {
-    //if (!strcmp(key,stringHash->buckets[bucketNum][i].key)) {
-    if (keyLen == stringHash->buckets[bucketNum][i].keyLen) {
-      if (!memcmp(key, stringHash->buckets[bucketNum][i].key,keyLen)) {
-        return 1;
-      }
-    }
-  }
 
-  return 0;
+  return StringHash_findSlot(stringHash, key, keyLen, StringHash_hashKey(key, keyLen)) >= 0;
 }
 
 char *StringHash_getKey(StringHash *stringHash, char *key) {
   int keyLen = strlen(key);
-  int bucketNum = StringHash_getBucketNum(stringHash,key, keyLen);
-  int i;
-
-  for (i=0; i<stringHash->bucketCounts[bucketNum]; i++) {
-    //if (!strcmp(key,stringHash->buckets[bucketNum][i].key)) {
-    if (keyLen == stringHash->buckets[bucketNum][i].keyLen) {
-      if (!memcmp(key, stringHash->buckets[bucketNum][i].key,keyLen)) {
-        return stringHash->buckets[bucketNum][i].key;
-      }
-    }
-  }
+  int slot = StringHash_findSlot(stringHash, key, keyLen, StringHash_hashKey(key, keyLen));
 
-  return NULL;
+  return slot < 0 ? NULL : stringHash->slots[slot].key;
 }
 
 int StringHash_add(StringHash *stringHash, char *key, void *val) {
   int keyLen = strlen(key);
-  int bucketNum = StringHash_getBucketNum(stringHash,key,keyLen);
-  int count = stringHash->bucketCounts[bucketNum];
-
-  if (StringHash_contains(stringHash,key)) {
-    int i;
+  unsigned int hash = StringHash_hashKey(key, keyLen);
+  int slot = StringHash_findSlot(stringHash, key, keyLen, hash);
 
+  if (slot >= 0) {
     fprintf(stderr,"WARNING: Duplicate key %s - value will be overwritten\n",key);
-    for (i=0; i<stringHash->bucketCounts[bucketNum]; i++) {
-      if (!strcmp(key,stringHash->buckets[bucketNum][i].key)) {
-        stringHash->buckets[bucketNum][i].value = val;
-        return 1;
-      }
-    }
-    
-  } else {
-    if (!count || !(count%10)) {
-      if ((stringHash->buckets[bucketNum] = 
-           (KeyValuePair *)realloc(stringHash->buckets[bucketNum],
-                                   (count+10) * sizeof(KeyValuePair))) == NULL) {
-        fprintf(stderr,"ERROR: Failed allocating space for stringHash bucket\n");
-        return 0;
-      }
-    }
-    
-    StrUtil_copyString(&(stringHash->buckets[bucketNum][count].key), key, 0);
-    if (!stringHash->buckets[bucketNum][count].key) {
-      Error_trace("StringHash_add",NULL);
-      return 0;
-    }
-    stringHash->buckets[bucketNum][count].value = val;
-    stringHash->buckets[bucketNum][count].keyLen = keyLen;
+    stringHash->slots[slot].value = val;
+    return 1;
+  }
 
-    stringHash->nValue++;
-    stringHash->bucketCounts[bucketNum]++;
+  KeyValuePair kvp;
+  StrUtil_copyString(&(kvp.key), key, 0);
+  if (!kvp.key) {
+    Error_trace("StringHash_add",NULL);
+    return 0;
   }
+  kvp.keyLen = keyLen;
+  kvp.hash   = hash;
+  kvp.value  = val;
+
+  StringHash_reserve(stringHash, stringHash->nValue+1);
+  StringHash_insert(stringHash, &kvp);
+  stringHash->nValue++;
 
   return 1; 
 }
 
-void StringHash_free(StringHash *stringHash, void freeFunc()) {
+/*
+  Makes a new hash with the same keys and values as stringHash. The keys are
+  copied (as StringHash_add does) but the values are shared, so the new hash
+  can be added to independently of stringHash.
+*/
+StringHash *StringHash_copy(StringHash *stringHash) {
+  StringHash *copy;
   int i;
-  int j;
-  
-  for (i=0; i<stringHash->size; i++) {
-    if (stringHash->bucketCounts[i]) {
-      for (j=0; j<stringHash->bucketCounts[i]; j++) {
-        free(stringHash->buckets[i][j].key);
-        if (freeFunc) {
-          freeFunc(stringHash->buckets[i][j].value);
-        }
-      }
-      free(stringHash->buckets[i]);
+
+  if ((copy = (StringHash *)calloc(1,sizeof(StringHash))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating space for stringHash copy\n");
+    return NULL;
+  }
+
+  copy->size   = stringHash->size;
+  copy->nValue = stringHash->nValue;
+
+  if ((copy->slots = (KeyValuePair *)malloc(copy->size * sizeof(KeyValuePair))) == NULL ||
+      (copy->probeLens = (unsigned char *)malloc(copy->size * sizeof(unsigned char))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating space for stringHash copy slots\n");
+    return NULL;
+  }
+
+  // Same size so every entry goes in the same slot
+  memcpy(copy->slots, stringHash->slots, copy->size * sizeof(KeyValuePair));
+  memcpy(copy->probeLens, stringHash->probeLens, copy->size * sizeof(unsigned char));
+
+  for (i=0; i<copy->size; i++) {
+    if (copy->probeLens[i]) {
+      StrUtil_copyString(&(copy->slots[i].key), stringHash->slots[i].key, 0);
     }
   }
-  
-  free(stringHash->buckets);
-  free(stringHash->bucketCounts);
-  free(stringHash);
+
+  return copy;
 }
 
-void StringHash_freeNoValFree(StringHash *stringHash) {
+void StringHash_free(StringHash *stringHash, void freeFunc()) {
   int i;
-  int j;
   
   for (i=0; i<stringHash->size; i++) {
-    if (stringHash->bucketCounts[i]) {
-      for (j=0; j<stringHash->bucketCounts[i]; j++) {
-        free(stringHash->buckets[i][j].key);
+    if (stringHash->probeLens[i]) {
+      free(stringHash->slots[i].key);
+      if (freeFunc) {
+        freeFunc(stringHash->slots[i].value);
       }
-      free(stringHash->buckets[i]);
     }
   }
   
-  free(stringHash->buckets);
-  free(stringHash->bucketCounts);
+  free(stringHash->slots);
+  free(stringHash->probeLens);
   free(stringHash);
 }
 
+void StringHash_freeNoValFree(StringHash *stringHash) {
+  StringHash_free(stringHash, NULL);
+}
+
 int StringHash_remove(StringHash *stringHash, char *key, void freeFunc()) {
   int keyLen = strlen(key);
-  int bucketNum = StringHash_getBucketNum(stringHash, key, keyLen);
-  int i;
-  int cnt = 0;
-  char *toRemoveKey = NULL;
-  void *toRemoveVal = NULL;
-
-  for (i=0; i<stringHash->bucketCounts[bucketNum]; i++) {
-    if (!strcmp(stringHash->buckets[bucketNum][i].key, key)) {
-      if (toRemoveVal) {
-        fprintf(stderr,"Error: %s found more than once in hash\n", key);
-        exit(1);
-      }
-      toRemoveKey = stringHash->buckets[bucketNum][i].key;
-      toRemoveVal = stringHash->buckets[bucketNum][i].value;
-    } else {
-      stringHash->buckets[bucketNum][cnt].key   = stringHash->buckets[bucketNum][i].key;
-      stringHash->buckets[bucketNum][cnt].value = stringHash->buckets[bucketNum][i].value;
-      stringHash->buckets[bucketNum][cnt].keyLen = stringHash->buckets[bucketNum][i].keyLen;
-      cnt++;
-    }
-  }
+  int slot = StringHash_findSlot(stringHash, key, keyLen, StringHash_hashKey(key, keyLen));
+  int mask = stringHash->size - 1;
 
-  if (toRemoveVal) {
-    stringHash->bucketCounts[bucketNum]--;
+  if (slot < 0) {
+    return 0;
+  }
 
-    if (freeFunc) {
-      freeFunc(toRemoveVal);
-    }
-    free(toRemoveKey);
-    if (!stringHash->bucketCounts[bucketNum]) {
-       free(stringHash->buckets[bucketNum]);
-       stringHash->buckets[bucketNum] = NULL;
-    }
+  if (freeFunc) {
+    freeFunc(stringHash->slots[slot].value);
+  }
+  free(stringHash->slots[slot].key);
+
+  // Shift following displaced entries back one, so there's no gap in their probe sequences
+  int next = (slot + 1) & mask;
+  while (stringHash->probeLens[next] > 1) {
+    stringHash->slots[slot]     = stringHash->slots[next];
+    stringHash->probeLens[slot] = stringHash->probeLens[next] - 1;
+    slot = next;
+    next = (next + 1) & mask;
   }
+  stringHash->probeLens[slot] = 0;
 
   stringHash->nValue--;
   
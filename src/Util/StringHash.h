@@ -19,6 +19,19 @@
 
 #include <string.h>
 
+/*
+ Open addressing (Robin Hood) hash from strings to pointers. The table is a
+ power of 2 size, and doubles whenever it gets more than 80% full, so the
+ size passed to StringHash_new is only a starting point - StringHash_reserve
+ makes room for a known number of keys in one go.
+
+ Each slot has a probe length byte (0 for empty, otherwise 1 + how far the
+ entry is from the slot its hash points at). Insertion moves entries which
+ are closer to home than the one being inserted along, which keeps probe
+ lengths short, and removal shifts the following entries back so there are
+ no tombstones.
+*/
+
 typedef enum StringHashSizesEnum {
   STRINGHASH_SMALL,
   STRINGHASH_MEDIUM,
@@ -29,12 +42,13 @@ typedef enum StringHashSizesEnum {
 typedef struct KeyValuePairStruct {
   char *key;
   int keyLen;
+  unsigned int hash;
   void *value;
 } KeyValuePair;
 
 typedef struct StringHashStruct {
-  KeyValuePair **buckets;
-  int  *bucketCounts;
+  KeyValuePair  *slots;
+  unsigned char *probeLens;
   int   size;
   int   nValue;
 } StringHash;
@@ -42,8 +56,10 @@ typedef struct StringHashStruct {
 
 void StringHash_printHashStats(StringHash *stringHash, char *hashDesc);
 StringHash *StringHash_new(StringHashSizes size);
+void    StringHash_reserve(StringHash *stringHash, int nValue);
 int     StringHash_add(StringHash *stringHash, char *string, void *val);
 int     StringHash_contains(StringHash *stringHash, char *string);
+StringHash *StringHash_copy(StringHash *stringHash);
 void    StringHash_free(StringHash *stringHash, void freeFunc());
 void StringHash_freeNoValFree(StringHash *stringHash);
 //int     StringHash_getNumValues(StringHash *stringHash);
@@ -54,9 +70,10 @@ void *  StringHash_getValues(StringHash *stringHash);
 char ** StringHash_getKeys(StringHash *stringHash);
 char ** StringHash_getKeysNoCopy(StringHash *stringHash);
 char *  StringHash_getKey(StringHash *stringHash, char *key);
+int     StringHash_next(StringHash *stringHash, int *iterP, char **keyP, void **valP);
 int     StringHash_remove(StringHash *stringHash, char *key, void freeFunc());
 
-unsigned int StringHash_getBucketNum(StringHash *stringHash, char *key, int keyLen);
+unsigned long long StringHash_hashKey(char *key, int keyLen);
 
 
 #endif
@@ -0,0 +1,194 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WorkPool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void *WorkPool_workerMain(void *arg);
+static int WorkPool_takeOwn(WorkPool *pool, int workerNum);
+static int WorkPool_steal(WorkPool *pool, int workerNum);
+
+
+WorkPool *WorkPool_new(int nWorker) {
+  WorkPool *pool;
+  int i;
+
+  if (nWorker < 1) {
+    nWorker = 1;
+  }
+
+  if ((pool = (WorkPool *)calloc(1,sizeof(WorkPool))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating WorkPool\n");
+    exit(1);
+  }
+
+  if ((pool->queues = (WorkPoolQueue *)calloc(nWorker, sizeof(WorkPoolQueue))) == NULL ||
+      (pool->workers = (WorkPoolWorker *)calloc(nWorker, sizeof(WorkPoolWorker))) == NULL) {
+    fprintf(stderr,"ERROR: Failed allocating WorkPool queues\n");
+    exit(1);
+  }
+
+  pool->nWorker = nWorker;
+
+  for (i=0; i<nWorker; i++) {
+    pthread_mutex_init(&(pool->queues[i].lock), NULL);
+    pool->workers[i].pool      = pool;
+    pool->workers[i].workerNum = i;
+  }
+
+  return pool;
+}
+
+/*
+  Runs func(data, taskNum, workerNum) for every taskNum from 0 to nTask-1 and
+  returns once they have all finished.
+*/
+void WorkPool_run(WorkPool *pool, int nTask, WorkPool_TaskFunc func, void *data) {
+  pthread_t *threads = NULL;
+  int nThread;
+  int i;
+
+  pool->func = func;
+  pool->data = data;
+
+  // Deal out the tasks in contiguous blocks, so each worker starts on
+  // neighbouring tasks
+  for (i=0; i<pool->nWorker; i++) {
+    pool->queues[i].next = (int)(((long)nTask * i) / pool->nWorker);
+    pool->queues[i].end  = (int)(((long)nTask * (i+1)) / pool->nWorker);
+
+    pool->workers[i].nTaskRun = 0;
+    pool->workers[i].nStolen  = 0;
+  }
+
+  // No point starting more threads than there are tasks
+  nThread = pool->nWorker < nTask ? pool->nWorker : nTask;
+
+  if (nThread > 1) {
+    if ((threads = (pthread_t *)calloc(nThread, sizeof(pthread_t))) == NULL) {
+      fprintf(stderr,"ERROR: Failed allocating WorkPool threads\n");
+      exit(1);
+    }
+    for (i=1; i<nThread; i++) {
+      if (pthread_create(&threads[i], NULL, WorkPool_workerMain, &(pool->workers[i])) != 0) {
+        fprintf(stderr,"ERROR: Failed starting WorkPool thread %d\n", i);
+        exit(1);
+      }
+    }
+  }
+
+  WorkPool_workerMain(&(pool->workers[0]));
+
+  // If there were fewer tasks than workers, any queued for a worker which
+  // didn't get a thread have been stolen by the others by now
+  for (i=1; i<nThread; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  if (threads) free(threads);
+
+  pool->func = NULL;
+  pool->data = NULL;
+}
+
+static void *WorkPool_workerMain(void *arg) {
+  WorkPoolWorker *worker = (WorkPoolWorker *)arg;
+  WorkPool *pool = worker->pool;
+  int taskNum;
+
+  while (1) {
+    if ((taskNum = WorkPool_takeOwn(pool, worker->workerNum)) < 0) {
+      if ((taskNum = WorkPool_steal(pool, worker->workerNum)) < 0) {
+        break;
+      }
+      worker->nStolen++;
+    }
+
+    pool->func(pool->data, taskNum, worker->workerNum);
+    worker->nTaskRun++;
+  }
+
+  return NULL;
+}
+
+static int WorkPool_takeOwn(WorkPool *pool, int workerNum) {
+  WorkPoolQueue *queue = &(pool->queues[workerNum]);
+  int taskNum = -1;
+
+  pthread_mutex_lock(&(queue->lock));
+  if (queue->next < queue->end) {
+    taskNum = queue->next++;
+  }
+  pthread_mutex_unlock(&(queue->lock));
+
+  return taskNum;
+}
+
+/*
+  Takes the last task from the queue with the most left in it. Tasks are
+  never added once WorkPool_run has started, so if every queue is empty
+  there's nothing more to do.
+*/
+static int WorkPool_steal(WorkPool *pool, int workerNum) {
+  int taskNum = -1;
+
+  while (taskNum < 0) {
+    int victim = -1;
+    int mostLeft = 0;
+    int i;
+
+    for (i=1; i<pool->nWorker; i++) {
+      int candidate = (workerNum + i) % pool->nWorker;
+      WorkPoolQueue *queue = &(pool->queues[candidate]);
+      int nLeft;
+
+      pthread_mutex_lock(&(queue->lock));
+      nLeft = queue->end - queue->next;
+      pthread_mutex_unlock(&(queue->lock));
+
+      if (nLeft > mostLeft) {
+        mostLeft = nLeft;
+        victim = candidate;
+      }
+    }
+
+    if (victim < 0) {
+      return -1;
+    }
+
+    // Victim may have emptied since we looked, in which case go round again
+    WorkPoolQueue *queue = &(pool->queues[victim]);
+    pthread_mutex_lock(&(queue->lock));
+    if (queue->next < queue->end) {
+      taskNum = --queue->end;
+    }
+    pthread_mutex_unlock(&(queue->lock));
+  }
+
+  return taskNum;
+}
+
+void WorkPool_free(WorkPool *pool) {
+  int i;
+
+  for (i=0; i<pool->nWorker; i++) {
+    pthread_mutex_destroy(&(pool->queues[i].lock));
+  }
+  free(pool->queues);
+  free(pool->workers);
+  free(pool);
+}
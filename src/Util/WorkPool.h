@@ -0,0 +1,72 @@
+/*
+ * Copyright [1999-2015] Wellcome Trust Sanger Institute and the EMBL-European Bioinformatics Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WORKPOOL_H__
+#define __WORKPOOL_H__
+
+#include <pthread.h>
+
+/*
+ Runs a fixed set of independent tasks, numbered 0 to nTask-1, on a pool
+ of worker threads.
+
+ Each worker starts with a contiguous block of the task numbers in its own
+ queue and works through it from the front. A worker which runs out steals
+ from the back of another worker's queue, so a few slow tasks don't leave
+ the other workers idle. The calling thread is worker 0, so a pool with one
+ worker runs every task in order in the calling thread.
+
+ The task function is given the worker number as well as the task number
+ so it can use per worker scratch space. Tasks can finish in any order, so
+ results should be stored by task number and combined after WorkPool_run
+ returns.
+*/
+
+typedef void (*WorkPool_TaskFunc)(void *data, int taskNum, int workerNum);
+
+typedef struct WorkPoolQueueStruct {
+  pthread_mutex_t lock;
+  int next;   // Next task for the owning worker
+  int end;    // One past the last task in the queue - thieves take end-1
+} WorkPoolQueue;
+
+typedef struct WorkPoolStruct WorkPool;
+
+typedef struct WorkPoolWorkerStruct {
+  WorkPool *pool;
+  int workerNum;
+  int nTaskRun;
+  int nStolen;
+} WorkPoolWorker;
+
+struct WorkPoolStruct {
+  int nWorker;
+  WorkPoolQueue *queues;
+  WorkPoolWorker *workers;
+
+  WorkPool_TaskFunc func;
+  void *data;
+};
+
+WorkPool *WorkPool_new(int nWorker);
+void      WorkPool_run(WorkPool *pool, int nTask, WorkPool_TaskFunc func, void *data);
+void      WorkPool_free(WorkPool *pool);
+
+#define WorkPool_getNumWorker(pool) (pool)->nWorker
+#define WorkPool_getNumTaskRun(pool, workerNum) (pool)->workers[(workerNum)].nTaskRun
+#define WorkPool_getNumStolen(pool, workerNum) (pool)->workers[(workerNum)].nStolen
+
+#endif
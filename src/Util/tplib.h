@@ -22,17 +22,22 @@
 
 #include <limits.h>
 
-/* Translation matrix */
-typedef char txmatrix[4][4][4];
-extern txmatrix matrix;
+/* Translation tables for one NCBI genetic code. aa is indexed by codon,
+   2 bits per base (A=0, C=1, G=2, T=3) with the first base in the high
+   bits. revAa is indexed the same way but gives the amino acid for the
+   reverse complement of the codon. */
+typedef struct CodonTableStruct {
+  int  id;
+  char aa[64];
+  char revAa[64];
+} CodonTable;
 
 /* Functions in translate.c */
-void make_revmatrix(void);
-void initbasebits(void);
-int compilemx(char *);
-//void translate(char *in, char **out, int *l, int codonTableId);
+void CodonTable_init(CodonTable *ct, int codonTableId);
+int compilemx(char *filename, CodonTable *ct);
+int translate_frame(char *in, char *out, int frame, int codonTableId, int lenIn);
+void translate_three(char *in, char **out, int *l, int codonTableId, int lenIn);
 void translate(char *in, char **out, int *l, int codonTableId, int lenIn);
-//void translate(char *, char **, int*);
 void rev_comp(char *in, char *out, int length);
 
 /* Error stuff in error.c */
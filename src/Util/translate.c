@@ -21,40 +21,73 @@
 */
 
 #include "tplib.h"
+#include "SeqUtil.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 
-/* The following matrix encodes the Universal genetic code.  During
-   execution any matrix supplied via the -m option will overwrite it */
-
-txmatrix matrix;
-
-txmatrix standard_matrix = {
-  { "KNKN", "TTTT", "RSRS", "IIMI" },
-  { "QHQH", "PPPP", "RRRR", "LLLL" },
-  { "EDED", "AAAA", "GGGG", "VVVV" },
-  { "*Y*Y", "SSSS", "*CWC", "LFLF" }
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* The NCBI genetic codes (ncbieaa strings from gc.prt), with codons in
+   NCBI's TCAG order. They're only read, so can be shared between threads;
+   CodonTable_init() turns one into the lookup tables translation uses. */
+
+static const struct {
+  int   id;
+  char *aas;
+} ncbiCodes[] = {
+  {  1, "FFLLSSSSYY**CC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  {  2, "FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIMMTTTTNNKKSS**VVVVAAAADDEEGGGG" },
+  {  3, "FFLLSSSSYY**CCWWTTTTPPPPHHQQRRRRIIMMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  {  4, "FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  {  5, "FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIMMTTTTNNKKSSSSVVVVAAAADDEEGGGG" },
+  {  6, "FFLLSSSSYYQQCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  {  9, "FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNNKSSSSVVVVAAAADDEEGGGG" },
+  { 10, "FFLLSSSSYY**CCCWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  { 11, "FFLLSSSSYY**CC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  { 12, "FFLLSSSSYY**CC*WLLLSPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  { 13, "FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIMMTTTTNNKKSSGGVVVVAAAADDEEGGGG" },
+  { 14, "FFLLSSSSYYY*CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNNKSSSSVVVVAAAADDEEGGGG" },
+  { 15, "FFLLSSSSYY*QCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  { 16, "FFLLSSSSYY*LCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  { 21, "FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIMMTTTTNNNKSSSSVVVVAAAADDEEGGGG" },
+  { 22, "FFLLSS*SYY*LCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  { 23, "FF*LSSSSYY**CC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  { 24, "FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSSKVVVVAAAADDEEGGGG" },
+  { 25, "FFLLSSSSYY**CCGWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  { 26, "FFLLSSSSYY**CC*WLLLAPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  { 27, "FFLLSSSSYYQQCCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  { 28, "FFLLSSSSYYQQCCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  { 29, "FFLLSSSSYYYYCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  { 30, "FFLLSSSSYYEECC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  { 31, "FFLLSSSSYYEECCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG" },
+  { 33, "FFLLSSSSYYY*CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSSKVVVVAAAADDEEGGGG" },
+  {  0, NULL }
 };
 
-txmatrix ct2id_matrix = {
-  { "KNKN", "TTTT", "*S*S", "MIMI" },
-  { "QHQH", "PPPP", "RRRR", "LLLL" },
-  { "EDED", "AAAA", "GGGG", "VVVV" },
-  { "*Y*Y", "SSSS", "WCWC", "LFLF" }
-};
+/* Position of A, C, G and T in NCBI's TCAG ordering */
+static const int ncbiBaseOrder[4] = { 2, 1, 3, 0 };
 
-txmatrix revmatrix;
+/* Bases per chunk when encoding - a multiple of 3 so chunks start on
+   codon boundaries in every frame */
+#define TRANSLATE_CHUNK 3072
 
-static int initTable = 0;
+/* Base code used for anything other than A, C, G, T or U. Codons
+   containing one translate to X */
+#define TRANSLATE_BADBASE 4
 
-/* make_revmatrix() creates the reverse complemented matrix by
+/* make_revtable() fills in the reverse complement lookup from the
+   forward one. The reverse complement of a codon index is made by
    swapping bits 4 and 5 with bits 0 and 1, inverting the bits, and
    then keeping only bits 0-5 */
 
-void make_revmatrix(void) {
+static void make_revtable(CodonTable *ct) {
   int n, r;
 
   for (n = 0; n<64; n++) {
@@ -62,16 +95,39 @@ void make_revmatrix(void) {
           ((n & 0x03) << 4) |
           ((n >> 4) & 0x03))) & 0x3F;
 
-    ((char *)revmatrix)[r] = ((char*)matrix)[n];
+    ct->revAa[r] = ct->aa[n];
   }
+}
+
+/* CodonTable_init() fills in ct for NCBI genetic code codonTableId.
+   ct is owned by the caller (usually on its stack), so there's no shared
+   state to protect when several threads translate with different
+   codes. */
 
+void CodonTable_init(CodonTable *ct, int codonTableId) {
+  int i;
+  int n;
+
+  for (i=0; ncbiCodes[i].aas != NULL && ncbiCodes[i].id != codonTableId; i++);
+
+  if (ncbiCodes[i].aas == NULL) {
+    fprintf(stderr,"Error: Currently unsupported codon table id (%d)\n", codonTableId);
+    exit(1);
+  }
+
+  for (n = 0; n<64; n++) {
+    int ncbiIndex = ncbiBaseOrder[n >> 4] * 16 + ncbiBaseOrder[(n >> 2) & 3] * 4 + ncbiBaseOrder[n & 3];
+    ct->aa[n] = ncbiCodes[i].aas[ncbiIndex];
+  }
+
+  make_revtable(ct);
+  ct->id = codonTableId;
 }
 
 /* compilemx() reads a file of codon -> amino acid translations and
-   places them in matrix, above, for later use by the translate()
-   function */
+   places them in ct, for codes which aren't built in */
 
-int compilemx(char *filename) {
+int compilemx(char *filename, CodonTable *ct) {
   char buf[80];
   char path[PATH_MAX];
 
@@ -114,226 +170,182 @@ int compilemx(char *filename) {
           res = sscanf(buf, "%c%c%c %c", &ta, &tb, &tc, &tx);
         } while (res!=4);
 
-        matrix[a][b][c]=tx;
+        ct->aa[(a << 4) | (b << 2) | c]=tx;
       }
     }
   }
 
   fclose(f);
-  return 0;
-}
 
-/* initbasebits() initialises the lookup table for the translate()
-   function */
-
-int basebits[256];
-
-int comphash[256];
-
-void initbasebits(void)
-{
-
-  /* First of all the hash for N->P translation */
-
-  memset(basebits, 255, sizeof(int)*256);
-  basebits['A'] = 0;
-  basebits['C'] = 1;
-  basebits['G'] = 2;
-  basebits['T'] = 3;
-  basebits['U'] = 3;
-  basebits['a'] = 0;
-  basebits['c'] = 1;
-  basebits['g'] = 2;
-  basebits['t'] = 3;
-  basebits['u'] = 3;
-
-  /* And now the hash for reverse complementation */
-  memset(comphash, 'x', sizeof(int)*256);
-  comphash['A'] = 'T';
-  comphash['B'] = 'V';
-  comphash['C'] = 'G';
-  comphash['D'] = 'H';
-  comphash['G'] = 'C';
-  comphash['H'] = 'D';
-  comphash['K'] = 'M';
-  comphash['M'] = 'K';
-  comphash['N'] = 'N';
-  comphash['R'] = 'Y';
-  comphash['S'] = 'S';
-  comphash['T'] = 'A';
-  comphash['U'] = 'A';
-  comphash['V'] = 'B';
-  comphash['X'] = 'X';
-  comphash['Y'] = 'Y';
-  comphash['.'] = '.';
-  comphash['~'] = '~';
+  make_revtable(ct);
+  ct->id = 0;
 
+  return 0;
 }
 
-/* translate() a nucleic acid sequence in all six reading frames
-   simultaneously.  out should be an array of six (char *) pointers,
-   all of which must be large enough to hold the translated sequence.
-   No sanity checking is performed here. l is an array of six
-   integers, which will take the lengths of the translated sequences.
-
-   Thanks to Peter Benie for help optimising the code */
-
-void translate(char *in, char **out, int *l, int codonTableId, int lenIn) {
-  int n, rem, index;
-  char *p, *end, *r3, *r4, *r5;
-  char *r0 = out[0];
-  char *r1 = out[1];
-  char *r2 = out[2];
-
-  if (initTable != codonTableId) {
- // Hack for now
-    switch (codonTableId) {
-      case 1:
-        memcpy(matrix, standard_matrix, sizeof(txmatrix));
-        break;
-      case 2:
-        memcpy(matrix, ct2id_matrix, sizeof(txmatrix));
-        break;
-      default:
-        fprintf(stderr,"Error: Currently unsupported codon table id (%d)\n", codonTableId);
-        exit(1);
-    }
-
-    initbasebits();
-    make_revmatrix();
-    initTable = codonTableId;
+/* encodebases() converts len bases to 2 bit codes (A=0, C=1, G=2,
+   T/U=3, either case) with anything else as TRANSLATE_BADBASE. The code
+   comes from bits 1 and 2 of the character: ((c >> 1) ^ (c >> 2)) & 3
+   gives 0, 1, 2 and 3 for A, C, G and T (and U), so it can be done 16
+   or 32 bases at a time with no table lookup. */
+
+static void encodebases(char *in, unsigned char *codes, int len) {
+  int i = 0;
+
+#if defined(__AVX2__)
+  const __m256i caseMask32 = _mm256_set1_epi8((char)0xDF);
+  const __m256i three32    = _mm256_set1_epi8(3);
+  const __m256i bad32      = _mm256_set1_epi8(TRANSLATE_BADBASE);
+
+  for (; i+32 <= len; i+=32) {
+    __m256i c = _mm256_loadu_si256((const __m256i *)&in[i]);
+    __m256i u = _mm256_and_si256(c, caseMask32);
+    __m256i valid = _mm256_or_si256(
+                      _mm256_or_si256(_mm256_cmpeq_epi8(u, _mm256_set1_epi8('A')),
+                                      _mm256_cmpeq_epi8(u, _mm256_set1_epi8('C'))),
+                      _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(u, _mm256_set1_epi8('G')),
+                                                      _mm256_cmpeq_epi8(u, _mm256_set1_epi8('T'))),
+                                      _mm256_cmpeq_epi8(u, _mm256_set1_epi8('U'))));
+    // 16 bit shifts pull bits in from the neighbouring byte, but only into bits masked off by the & 3
+    __m256i code = _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi16(c, 1), _mm256_srli_epi16(c, 2)), three32);
+
+    _mm256_storeu_si256((__m256i *)&codes[i], _mm256_blendv_epi8(bad32, code, valid));
   }
-
-  //n = strlen(in);
-  n = lenIn;
-  if (n == 0) {
-    fprintf(stderr,"Warning: 0 length sequence in translate - returning\n");
-    return;
+#endif
+
+#if defined(__SSE2__)
+  const __m128i caseMask = _mm_set1_epi8((char)0xDF);
+  const __m128i three    = _mm_set1_epi8(3);
+  const __m128i bad      = _mm_set1_epi8(TRANSLATE_BADBASE);
+
+  for (; i+16 <= len; i+=16) {
+    __m128i c = _mm_loadu_si128((const __m128i *)&in[i]);
+    __m128i u = _mm_and_si128(c, caseMask);
+    __m128i valid = _mm_or_si128(
+                      _mm_or_si128(_mm_cmpeq_epi8(u, _mm_set1_epi8('A')),
+                                   _mm_cmpeq_epi8(u, _mm_set1_epi8('C'))),
+                      _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(u, _mm_set1_epi8('G')),
+                                                _mm_cmpeq_epi8(u, _mm_set1_epi8('T'))),
+                                   _mm_cmpeq_epi8(u, _mm_set1_epi8('U'))));
+    __m128i code = _mm_and_si128(_mm_xor_si128(_mm_srli_epi16(c, 1), _mm_srli_epi16(c, 2)), three);
+
+    _mm_storeu_si128((__m128i *)&codes[i], _mm_or_si128(_mm_and_si128(valid, code), _mm_andnot_si128(valid, bad)));
   }
-  end = &in[n]-5;
-
-  /* How much of a part codon do we have at the end */
-  rem = n % 3;
-
-  /* How many residues long will the frame 0 sequence be? */
-  n /= 3;
+#endif
 
-  l[0] = l[1] = l[2] = l[3] = l[4] = l[5] = n;
+  for (; i<len; i++) {
+    unsigned char c = in[i];
+    unsigned char u = c & 0xDF;
 
-  /* Position the reverse reading frame pointers where the
-     protein sequences will end */
-
-  r3 = &out[3][n];
-  r4 = &out[4][n];
-  r5 = &out[5][n];
-
-  /* If there aren't two bases at the end, the translations
-     will not all be the same length; one or two of them
-     will be one residue shorter */
-
-  if (rem != 2) {
-    r5--;
-    l[5]--;
-    l[2]--;
-    if (rem == 0) {
-      r4--;
-      l[4]--;
-      l[1]--;
+    if (u == 'A' || u == 'C' || u == 'G' || u == 'T' || u == 'U') {
+      codes[i] = ((c >> 1) ^ (c >> 2)) & 3;
+    } else {
+      codes[i] = TRANSLATE_BADBASE;
     }
   }
+}
 
-  *r3 = *r4 = *r5 = '\0';
-  r3--; r4--; r5--;
-
-  index = (basebits[(int)in[0]] << 2) | basebits[(int)in[1]];
-
-  for (p = in; p<=end; p+=3) {
-    /* Frame 0/3 */
-
-    index = ((index << 2) & 0x3C) | basebits[(int)p[2]];
-
-// Hack for N's
-    if (p[0] == 'N' || p[1] == 'N' || p[2] == 'N') index = index | 0x80;
-
-    if (index & 0x80) {
-      *r0++ = 'X';
-      *r3-- = 'X';
-    } else {
-      *r0++ = ((char *)matrix)[index];
-      *r3-- = ((char *)revmatrix)[index];
+/* translateframes() translates the frames whose bits are set in
+   frameMask. Frames 0-2 are the forward frames starting at bases 0, 1
+   and 2. Frames 3-5 are their reverse complements, so frame 3+n is read
+   from the same codons as frame n (and is the same length). out[frame]
+   must have room for lenIn/3 + 1 characters. */
+
+static void translateframes(char *in, char **out, int *l, int frameMask, int codonTableId, int lenIn) {
+  unsigned char codes[TRANSLATE_CHUNK+2];
+  CodonTable ct;
+  int chunkStart;
+  int frame;
+
+  CodonTable_init(&ct, codonTableId);
+
+  for (frame=0; frame<6; frame++) {
+    if (frameMask & (1 << frame)) {
+      int offset = frame % 3;
+      l[frame] = lenIn >= offset+3 ? (lenIn-offset) / 3 : 0;
+      out[frame][l[frame]] = '\0';
     }
-    /* Frame 1/4 */
-
-    index = ((index << 2) & 0x3C) | basebits[(int)p[3]];
+  }
 
-    if (index & 0x80) {
-      *r1++ = 'X';
-      *r4-- = 'X';
-    } else {
-      *r1++ = ((char *)matrix)[index];
-      *r4-- = ((char *)revmatrix)[index];
+  for (chunkStart=0; chunkStart<lenIn; chunkStart+=TRANSLATE_CHUNK) {
+    // The extra 2 bases are for codons which start in this chunk and end in the next
+    int nCode = lenIn-chunkStart < TRANSLATE_CHUNK+2 ? lenIn-chunkStart : TRANSLATE_CHUNK+2;
+    int offset;
+
+    encodebases(&in[chunkStart], codes, nCode);
+
+    for (offset=0; offset<3; offset++) {
+      char *fwd = (frameMask & (1 << offset)) ? out[offset] : NULL;
+      char *rev = (frameMask & (1 << (offset+3))) && l[offset+3] > 0 ? &out[offset+3][l[offset+3]-1] : NULL;
+      int codonNum = chunkStart/3;
+      int p;
+
+      if (fwd == NULL && rev == NULL) continue;
+
+      for (p=offset; p+2<nCode && p<TRANSLATE_CHUNK; p+=3, codonNum++) {
+        unsigned char c0 = codes[p];
+        unsigned char c1 = codes[p+1];
+        unsigned char c2 = codes[p+2];
+
+        if ((c0 | c1 | c2) & TRANSLATE_BADBASE) {
+          if (fwd) fwd[codonNum] = 'X';
+          if (rev) rev[-codonNum] = 'X';
+        } else {
+          int index = (c0 << 4) | (c1 << 2) | c2;
+          if (fwd) fwd[codonNum] = ct.aa[index];
+          if (rev) rev[-codonNum] = ct.revAa[index];
+        }
+      }
     }
+  }
+}
 
-    /* Frame 2/5 */
+/* translate_frame() translates a single reading frame of in (numbered
+   as for translate()) into out, which must have room for lenIn/3 + 1
+   characters. Returns the length of the translation */
 
-    index = ((index << 2) & 0x3C) | basebits[(int)p[4]];
+int translate_frame(char *in, char *out, int frame, int codonTableId, int lenIn) {
+  char *frames[6];
+  int l[6];
 
-    if (index & 0x80) {
-      *r2++ = 'X';
-      *r5-- = 'X';
-    } else {
-      *r2++ = ((char *)matrix)[index];
-      *r5-- = ((char *)revmatrix)[index];
-    }
+  if (frame < 0 || frame > 5) {
+    fprintf(stderr,"Error: Invalid frame %d in translate_frame\n", frame);
+    exit(1);
   }
 
-  /* We may, at this point, have one or two codons still untranslated,
-     so we need to deal with those */
+  frames[frame] = out;
+  translateframes(in, frames, l, 1 << frame, codonTableId, lenIn);
 
-  if (rem<2) {
-    index = ((index << 2) & 0x3C) | basebits[(int)p[2]];
+  return l[frame];
+}
 
-    if (index & 0x80) {
-      *r0++ = 'X';
-      *r3-- = 'X';
-    } else {
-      *r0++ = ((char *)matrix)[index];
-      *r3-- = ((char *)revmatrix)[index];
-    }
+/* translate_three() translates the three forward reading frames of
+   in into out[0] - out[2], putting their lengths in l[0] - l[2] */
 
-    if (rem==1) {
-      index = ((index << 2) & 0x3C) | basebits[(int)p[3]];
+void translate_three(char *in, char **out, int *l, int codonTableId, int lenIn) {
+  translateframes(in, out, l, 0x07, codonTableId, lenIn);
+}
 
-      if (index & 0x80) {
-        *r1++ = 'X';
-        *r4-- = 'X';
-      } else {
-        *r1++ = ((char *)matrix)[index];
-        *r4-- = ((char *)revmatrix)[index];
-      }
-    }
-  }
-    
-  *r0 = *r1 = *r2 = '\0';
+/* translate() a nucleic acid sequence in all six reading frames
+   simultaneously.  out should be an array of six (char *) pointers,
+   all of which must be large enough to hold the translated sequence.
+   No sanity checking is performed here. l is an array of six
+   integers, which will take the lengths of the translated sequences.
+   Frames 3-5 are the reverse complements of frames 0-2, so the last
+   residue of frame 3 comes from the first codon of frame 0 */
+
+void translate(char *in, char **out, int *l, int codonTableId, int lenIn) {
+  translateframes(in, out, l, 0x3F, codonTableId, lenIn);
 }
 
 /* rev_comp() produces the reverse complement of a nucleic acid
-   sequence.  It is only used when comparing a nucleotide pattern
-   against a nucleotide db */
+   sequence in out, which must have room for length+1 characters.
+   Characters which can't be complemented come out as 'x'. The work is
+   done by SeqUtil_reverseComplementMarkInvalid() */
 
 void rev_comp(char *in, char *out, int length) {
-  register char *p = in;
-  register char *q;
+  memcpy(out, in, length);
+  out[length] = '\0';
 
-  if (initTable == 0) {
- // Hack for now
-    initbasebits();
-    initTable = -1;
-  }
-  
-  q = &out[length];
-  *q-- ='\0';
-  
-  while (q>=out)
-    *q-- = comphash[*p++];
+  SeqUtil_reverseComplementMarkInvalid(out, length, 'x');
 }